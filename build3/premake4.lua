@@ -607,6 +607,7 @@ end
 		include "../examples/OpenGLWindow"
 		include "../examples/ThirdPartyLibs/Gwen"
 		include "../examples/HelloWorld"
+		include "../examples/TaskSchedulerBenchmark"
 		include "../examples/SharedMemory"
 		include "../examples/ThirdPartyLibs/BussIK"
 
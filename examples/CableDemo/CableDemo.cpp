@@ -2275,6 +2275,154 @@ static void Init_Growth(CableDemo* pdemo)
 	cable->setCollisionParameters(1, 1, 0);
 }
 
+// Node state of a cable, used to run several solver modes from the same start
+struct CableBenchmarkState
+{
+	btAlignedObjectArray<btVector3> x, q, v;
+
+	void save(btCable* cable)
+	{
+		x.resize(0);
+		q.resize(0);
+		v.resize(0);
+		for (int i = 0; i < cable->m_nodes.size(); ++i)
+		{
+			x.push_back(cable->m_nodes[i].m_x);
+			q.push_back(cable->m_nodes[i].m_q);
+			v.push_back(cable->m_nodes[i].m_v);
+		}
+	}
+
+	void restore(btCable* cable) const
+	{
+		for (int i = 0; i < cable->m_nodes.size(); ++i)
+		{
+			cable->m_nodes[i].m_x = x[i];
+			cable->m_nodes[i].m_q = q[i];
+			cable->m_nodes[i].m_v = v[i];
+		}
+	}
+};
+
+// Largest relative stretch of the links
+static btScalar cableLinkResidual(btCable* cable)
+{
+	btScalar residual = 0;
+	for (int i = 0; i < cable->m_links.size(); ++i)
+	{
+		const btSoftBody::Link& l = cable->m_links[i];
+		const btScalar error = btFabs(l.m_n[0]->m_x.distance(l.m_n[1]->m_x) - l.m_rl) / l.m_rl;
+		residual = btMax(residual, error);
+	}
+	return residual;
+}
+
+static btCable* createBenchmarkCable(CableDemo* pdemo, int resolution, int iterations, btScalar offsetZ)
+{
+	btTransform transformLeft = btTransform();
+	transformLeft.setIdentity();
+	transformLeft.setOrigin(btVector3(-10, 10, offsetZ));
+	btRigidBody* bodyLeftAnchor = pdemo->createRigidBody(0, transformLeft, new btBoxShape(btVector3(0.5, 0.5, 0.5)));
+
+	btTransform transformRight = btTransform();
+	transformRight.setIdentity();
+	transformRight.setOrigin(btVector3(10, 10, offsetZ));
+	btRigidBody* bodyRightAnchor = pdemo->createRigidBody(0, transformRight, new btBoxShape(btVector3(0.5, 0.5, 0.5)));
+
+	btCable* cable = pdemo->createCable(resolution, iterations, 10, transformLeft.getOrigin(), transformRight.getOrigin(), bodyRightAnchor, bodyLeftAnchor);
+	cable->setUseCollision(false);
+	cable->setUseBending(true);
+	cable->setBendingStiffness(0.1);
+	return cable;
+}
+
+// Times the cable solver with and without the compact node mode on the same initial state
+static void Init_BenchmarkCompactNodes(CableDemo* pdemo)
+{
+	const int resolutions[] = {250, 1000, 2000};
+	const int iterations = 100;
+	const int steps = 30;
+	const btScalar dt = 1.0 / 60.0;
+
+	for (int r = 0; r < 3; ++r)
+	{
+		btCable* cable = createBenchmarkCable(pdemo, resolutions[r], iterations, r * 2.0);
+		CableBenchmarkState state;
+		state.save(cable);
+
+		double timeMs[2];
+		btScalar length[2];
+		for (int mode = 0; mode < 2; ++mode)
+		{
+			state.restore(cable);
+			cable->setUseCompactNodes(mode == 1);
+
+			// Step the cable alone, through the btSoftBody interface
+			btSoftBody* body = cable;
+			auto start = std::chrono::high_resolution_clock::now();
+			for (int s = 0; s < steps; ++s)
+			{
+				body->predictMotion(dt);
+				body->solveConstraints();
+			}
+			auto end = std::chrono::high_resolution_clock::now();
+			timeMs[mode] = std::chrono::duration<double, std::milli>(end - start).count() / steps;
+			length[mode] = cable->getLength();
+		}
+
+		b3Printf("Compact nodes benchmark: %i nodes, %i iterations | default %f ms/step | compact %f ms/step | speedup %f | length %f / %f (rest %f)",
+				 resolutions[r], iterations, timeMs[0], timeMs[1], timeMs[0] / timeMs[1], length[0], length[1], cable->getRestLength());
+	}
+	pdemo->SetCameraPosition(btVector3(0, 10, 0));
+}
+
+// Convergence per millisecond of the sequential and the parallel (even/odd links) solve.
+// The residual is the largest relative link stretch, measured after predictMotion and after solveConstraints
+static void Init_BenchmarkParallelLinks(CableDemo* pdemo)
+{
+	const int resolutions[] = {1000, 4000};
+	const int iterations = 50;
+	const int steps = 20;
+	const btScalar dt = 1.0 / 60.0;
+	const char* modeNames[] = {"sequential", "parallel links", "compact", "compact + parallel links"};
+
+	for (int r = 0; r < 2; ++r)
+	{
+		btCable* cable = createBenchmarkCable(pdemo, resolutions[r], iterations, r * 2.0);
+		CableBenchmarkState state;
+		state.save(cable);
+
+		for (int mode = 0; mode < 4; ++mode)
+		{
+			state.restore(cable);
+			cable->setUseParallelLinks(mode == 1 || mode == 3);
+			cable->setUseCompactNodes(mode >= 2);
+
+			btSoftBody* body = cable;
+			double solveMs = 0;
+			double orders = 0;
+			btScalar residual = 0;
+			for (int s = 0; s < steps; ++s)
+			{
+				body->predictMotion(dt);
+				const btScalar residualBefore = cableLinkResidual(cable);
+				auto start = std::chrono::high_resolution_clock::now();
+				body->solveConstraints();
+				auto end = std::chrono::high_resolution_clock::now();
+				solveMs += std::chrono::duration<double, std::milli>(end - start).count();
+				residual = cableLinkResidual(cable);
+				if (residualBefore > 0 && residual > 0)
+					orders += log10(residualBefore / residual);
+			}
+
+			b3Printf("Parallel links benchmark: %i nodes, %i iterations, %s | %f ms/step | residual %e | %f orders of magnitude per ms",
+					 resolutions[r], iterations, modeNames[mode], solveMs / steps, residual, orders / solveMs);
+		}
+		cable->setUseCompactNodes(false);
+	}
+	pdemo->SetCameraPosition(btVector3(0, 10, 0));
+}
+
 void (*demofncs[])(CableDemo*) =
 {
 		Init_CableForceDown,
@@ -2297,7 +2445,9 @@ void (*demofncs[])(CableDemo*) =
 		Init_TestClaw,
 		Init_TestConstraintClawA18,
 		Init_Growth,
-		Init_TestCableCollisionMt
+		Init_TestCableCollisionMt,
+		Init_BenchmarkCompactNodes,
+		Init_BenchmarkParallelLinks
 };
 
 ////////////////////////////////////
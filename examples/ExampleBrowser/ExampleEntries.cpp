@@ -304,6 +304,8 @@ static ExampleEntry gDefaultExamples[] =
 		ExampleEntry(1, " Test Constraint & Claw", " Test a constraint and collision with a cable", CableDemoCreateFunc, 18),
 		ExampleEntry(1, " Test Growth Speed", " Test duration of cable growth", CableDemoCreateFunc, 19),
 		ExampleEntry(1, "Test Cable CollisionMt", " Test multi threaded collisions with two cables", CableDemoCreateFunc, 20),
+		ExampleEntry(1, "Benchmark Compact Nodes", "Compare the cable solver with and without the compact (SoA/SIMD) node mode", CableDemoCreateFunc, 21),
+		ExampleEntry(1, "Benchmark Parallel Links", "Convergence per millisecond of the sequential and the parallel (even/odd links) cable solve", CableDemoCreateFunc, 22),
 
 #endif  //INCLUDE_CLOTH_DEMOS
 
@@ -295,6 +295,11 @@ public:
 			m_allocatedTaskSchedulers.push_back(ts);
 			addTaskScheduler(ts);
 		}
+		if (btITaskScheduler* ts = btCreateWorkStealingTaskScheduler())
+		{
+			m_allocatedTaskSchedulers.push_back(ts);
+			addTaskScheduler(ts);
+		}
 		addTaskScheduler(btGetOpenMPTaskScheduler());
 		addTaskScheduler(btGetTBBTaskScheduler());
 		addTaskScheduler(btGetPPLTaskScheduler());
@@ -766,6 +771,8 @@ void CommonRigidBodyMTBase::createDefaultParameters()
 			{
 				sBatchingMethodComboBoxItems[btBatchedConstraints::BATCHING_METHOD_SPATIAL_GRID_2D] = "Batching: 2D Grid";
 				sBatchingMethodComboBoxItems[btBatchedConstraints::BATCHING_METHOD_SPATIAL_GRID_3D] = "Batching: 3D Grid";
+				sBatchingMethodComboBoxItems[btBatchedConstraints::BATCHING_METHOD_INCREMENTAL_SPATIAL_GRID_2D] = "Batching: Incremental 2D Grid";
+				sBatchingMethodComboBoxItems[btBatchedConstraints::BATCHING_METHOD_INCREMENTAL_SPATIAL_GRID_3D] = "Batching: Incremental 3D Grid";
 			};
 			ComboBoxParams comboParams;
 			comboParams.m_userPointer = sBatchingMethodComboBoxItems;
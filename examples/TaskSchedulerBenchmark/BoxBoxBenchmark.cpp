@@ -0,0 +1,257 @@
+/*
+Bullet Continuous Collision Detection and Physics Library
+Copyright (c) 2003-2018 Erwin Coumans  https://bulletphysics.org
+
+This software is provided 'as-is', without any express or implied warranty.
+In no event will the authors be held liable for any damages arising from the use of this software.
+Permission is granted to anyone to use this software for any purpose,
+including commercial applications, and to alter it and redistribute it freely,
+subject to the following restrictions:
+
+1. The origin of this software must not be misrepresented; you must not claim that you wrote the original software. If you use this software in a product, an acknowledgment in the product documentation would be appreciated but is not required.
+2. Altered source versions must be plainly marked as such, and must not be misrepresented as being the original software.
+3. This notice may not be removed or altered from any source distribution.
+*/
+
+/// Box-box narrowphase benchmark on the box stacks of BenchmarkDemo (test 1, 8x8 columns of 47 boxes).
+/// The stacks are dropped and left to collapse, then the touching box pairs are run through
+///   scalar  : btBoxBoxDetector::getClosestPoints, one pair at a time
+///   batched : btBoxBoxDetector::getSeparatingAxes on btBoxBoxDetector::BATCH_SIZE pairs, then the contacts of each pair
+/// and the collision detection of the whole world is timed with btCollisionDispatcherMt box-box batching off and on.
+
+#include "BoxBoxBenchmark.h"
+#include "btBulletDynamicsCommon.h"
+#include "BulletCollision/CollisionDispatch/btCollisionDispatcherMt.h"
+#include "BulletCollision/CollisionDispatch/btBoxBoxDetector.h"
+#include "LinearMath/btThreads.h"
+#include "LinearMath/btQuickprof.h"
+#include <stdio.h>
+#include <stdlib.h>
+
+// counts the contacts, so that the work can't be optimized away
+struct BoxBoxCountResult : public btDiscreteCollisionDetectorInterface::Result
+{
+	int m_numContacts;
+	btScalar m_depthSum;
+
+	BoxBoxCountResult() : m_numContacts(0), m_depthSum(0) {}
+
+	virtual void setShapeIdentifiersA(int partId0, int index0) {}
+	virtual void setShapeIdentifiersB(int partId1, int index1) {}
+	virtual void addContactPoint(const btVector3& normalOnBInWorld, const btVector3& pointInWorld, btScalar depth)
+	{
+		m_numContacts++;
+		m_depthSum += depth;
+	}
+};
+
+struct BoxBoxBenchmarkScene
+{
+	btDefaultCollisionConfiguration* m_collisionConfiguration;
+	btCollisionDispatcherMt* m_dispatcher;
+	btDbvtBroadphase* m_broadphase;
+	btSequentialImpulseConstraintSolver* m_solver;
+	btDiscreteDynamicsWorld* m_world;
+	btBoxShape* m_groundShape;
+	btBoxShape* m_boxShape;
+
+	BoxBoxBenchmarkScene()
+	{
+		btDefaultCollisionConstructionInfo cci;
+		cci.m_defaultMaxPersistentManifoldPoolSize = 80000;
+		cci.m_defaultMaxCollisionAlgorithmPoolSize = 80000;
+		m_collisionConfiguration = new btDefaultCollisionConfiguration(cci);
+		m_dispatcher = new btCollisionDispatcherMt(m_collisionConfiguration, 40);
+		m_broadphase = new btDbvtBroadphase();
+		m_solver = new btSequentialImpulseConstraintSolver();
+		m_world = new btDiscreteDynamicsWorld(m_dispatcher, m_broadphase, m_solver, m_collisionConfiguration);
+		m_world->setGravity(btVector3(0, -10, 0));
+
+		m_groundShape = new btBoxShape(btVector3(250, 50, 250));
+		addBody(m_groundShape, 0, btVector3(0, -50, 0));
+
+		// the stacks of BenchmarkDemo::createTest1
+		int size = 8;
+		const btScalar cubeSize = 1.0f;
+		btScalar spacing = cubeSize;
+		btVector3 pos(0.0f, cubeSize * 2, 0.f);
+		btScalar offset = -size * (cubeSize * 2.0f + spacing) * 0.5f;
+		m_boxShape = new btBoxShape(btVector3(cubeSize - btScalar(0.04), cubeSize - btScalar(0.04), cubeSize - btScalar(0.04)));
+		for (int k = 0; k < 47; k++)
+		{
+			for (int j = 0; j < size; j++)
+			{
+				pos[2] = offset + btScalar(j) * (cubeSize * 2.0f + spacing);
+				for (int i = 0; i < size; i++)
+				{
+					pos[0] = offset + btScalar(i) * (cubeSize * 2.0f + spacing);
+					addBody(m_boxShape, 2, pos);
+				}
+			}
+			offset -= btScalar(0.05) * spacing * (size - 1);
+			pos[1] += (cubeSize * 2.0f + spacing);
+		}
+	}
+
+	~BoxBoxBenchmarkScene()
+	{
+		for (int i = m_world->getNumCollisionObjects() - 1; i >= 0; --i)
+		{
+			btCollisionObject* obj = m_world->getCollisionObjectArray()[i];
+			btRigidBody* body = btRigidBody::upcast(obj);
+			if (body && body->getMotionState())
+			{
+				delete body->getMotionState();
+			}
+			m_world->removeCollisionObject(obj);
+			delete obj;
+		}
+		delete m_world;
+		delete m_solver;
+		delete m_broadphase;
+		delete m_dispatcher;
+		delete m_collisionConfiguration;
+		delete m_groundShape;
+		delete m_boxShape;
+	}
+
+	void addBody(btCollisionShape* shape, btScalar mass, const btVector3& origin)
+	{
+		btVector3 localInertia(0, 0, 0);
+		if (mass != btScalar(0))
+		{
+			shape->calculateLocalInertia(mass, localInertia);
+		}
+		btTransform transform;
+		transform.setIdentity();
+		transform.setOrigin(origin);
+		btDefaultMotionState* motionState = new btDefaultMotionState(transform);
+		btRigidBody::btRigidBodyConstructionInfo rbInfo(mass, motionState, shape, localInertia);
+		btRigidBody* body = new btRigidBody(rbInfo);
+		body->setActivationState(DISABLE_DEACTIVATION);
+		m_world->addRigidBody(body);
+	}
+
+	void stepSimulation()
+	{
+		m_world->stepSimulation(btScalar(1. / 60.), 0, btScalar(1. / 60.));
+		// the dispatcher keeps a copy of every manifold that collided during the step
+		m_dispatcher->ClearManifoldsCache();
+	}
+};
+
+static void timeDetector(BoxBoxBenchmarkScene& scene, int numRepeats)
+{
+	btOverlappingPairCache* pairCache = scene.m_world->getPairCache();
+	btAlignedObjectArray<btBoxBoxDetector::BatchInput> inputs;
+	btManifoldArray manifolds;
+	for (int i = 0; i < pairCache->getNumOverlappingPairs(); ++i)
+	{
+		const btBroadphasePair& pair = pairCache->getOverlappingPairArray()[i];
+		// the pairs the dispatcher batches, the ones that touched on the last step
+		manifolds.resize(0);
+		if (pair.m_algorithm)
+		{
+			pair.m_algorithm->getAllContactManifolds(manifolds);
+		}
+		if (manifolds.size() != 1 || manifolds[0]->getNumContacts() == 0)
+		{
+			continue;
+		}
+		const btCollisionObject* colObj0 = (btCollisionObject*)pair.m_pProxy0->m_clientObject;
+		const btCollisionObject* colObj1 = (btCollisionObject*)pair.m_pProxy1->m_clientObject;
+		btBoxBoxDetector::BatchInput input;
+		input.m_box1 = (const btBoxShape*)colObj0->getCollisionShape();
+		input.m_box2 = (const btBoxShape*)colObj1->getCollisionShape();
+		input.m_transformA = &colObj0->getWorldTransform();
+		input.m_transformB = &colObj1->getWorldTransform();
+		inputs.push_back(input);
+	}
+
+	btClock clock;
+	BoxBoxCountResult scalarResult;
+	for (int iRepeat = 0; iRepeat < numRepeats; ++iRepeat)
+	{
+		for (int i = 0; i < inputs.size(); ++i)
+		{
+			btDiscreteCollisionDetectorInterface::ClosestPointInput input;
+			input.m_transformA = *inputs[i].m_transformA;
+			input.m_transformB = *inputs[i].m_transformB;
+			btBoxBoxDetector detector(inputs[i].m_box1, inputs[i].m_box2);
+			detector.getClosestPoints(input, scalarResult, NULL);
+		}
+	}
+	unsigned long long scalarTime = clock.getTimeMicroseconds();
+
+	clock.reset();
+	BoxBoxCountResult batchedResult;
+	btBoxBoxDetector::SeparatingAxis axes[btBoxBoxDetector::BATCH_SIZE];
+	for (int iRepeat = 0; iRepeat < numRepeats; ++iRepeat)
+	{
+		for (int iBatch = 0; iBatch < inputs.size(); iBatch += btBoxBoxDetector::BATCH_SIZE)
+		{
+			int numPairs = btMin(int(btBoxBoxDetector::BATCH_SIZE), inputs.size() - iBatch);
+			btBoxBoxDetector::getSeparatingAxes(&inputs[iBatch], numPairs, axes);
+			for (int i = 0; i < numPairs; ++i)
+			{
+				if (axes[i].m_code)
+				{
+					btDiscreteCollisionDetectorInterface::ClosestPointInput input;
+					input.m_transformA = *inputs[iBatch + i].m_transformA;
+					input.m_transformB = *inputs[iBatch + i].m_transformB;
+					btBoxBoxDetector detector(inputs[iBatch + i].m_box1, inputs[iBatch + i].m_box2);
+					detector.getClosestPoints(input, axes[i], batchedResult);
+				}
+			}
+		}
+	}
+	unsigned long long batchedTime = clock.getTimeMicroseconds();
+
+	printf("%d touching box pairs, %d contacts (%d batched)\n", inputs.size(), scalarResult.m_numContacts / numRepeats, batchedResult.m_numContacts / numRepeats);
+	printf("%14s %16s\n", "detector", "ns/pair");
+	printf("%14s %16.1f\n", "scalar", 1000.0 * double(scalarTime) / (double(numRepeats) * inputs.size()));
+	printf("%14s %16.1f\n", "batched", 1000.0 * double(batchedTime) / (double(numRepeats) * inputs.size()));
+}
+
+static void timeDispatcher(BoxBoxBenchmarkScene& scene, int numSteps)
+{
+	printf("%14s %8s %24s\n", "dispatcher", "threads", "collision detection ms");
+	btITaskScheduler* scheduler = btGetTaskScheduler();
+	for (int batched = 0; batched < 2; ++batched)
+	{
+		scene.m_dispatcher->setBatchBoxBoxPairs(batched != 0);
+		unsigned long long time = 0;
+		for (int i = 0; i < numSteps; ++i)
+		{
+			btClock clock;
+			scene.m_world->performDiscreteCollisionDetection();
+			time += clock.getTimeMicroseconds();
+		}
+		printf("%14s %8d %24.3f\n", batched ? "batched" : "per pair", scheduler->getNumThreads(), double(time) / (1000.0 * numSteps));
+	}
+}
+
+int runBoxBoxBenchmark(int argc, char** argv)
+{
+	int numSettleSteps = argc > 0 ? atoi(argv[0]) : 150;
+	int numRepeats = argc > 1 ? atoi(argv[1]) : 20;
+
+	btITaskScheduler* scheduler = btCreateDefaultTaskScheduler();
+	if (scheduler)
+	{
+		btSetTaskScheduler(scheduler);
+	}
+
+	BoxBoxBenchmarkScene scene;
+	for (int i = 0; i < numSettleSteps; ++i)
+	{
+		scene.stepSimulation();
+	}
+	printf("%d bodies after %d steps\n", scene.m_world->getNumCollisionObjects(), numSettleSteps);
+	timeDetector(scene, numRepeats);
+	timeDispatcher(scene, numRepeats);
+
+	btSetTaskScheduler(btGetSequentialTaskScheduler());
+	delete scheduler;
+	return 0;
+}
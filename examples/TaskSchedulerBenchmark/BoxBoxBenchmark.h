@@ -0,0 +1,7 @@
+#ifndef BOX_BOX_BENCHMARK_H
+#define BOX_BOX_BENCHMARK_H
+
+// compares the box-box detector one pair at a time with the batched separating axis tests
+int runBoxBoxBenchmark(int argc, char** argv);
+
+#endif  //BOX_BOX_BENCHMARK_H
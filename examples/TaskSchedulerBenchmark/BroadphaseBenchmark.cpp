@@ -0,0 +1,211 @@
+/*
+Bullet Continuous Collision Detection and Physics Library
+Copyright (c) 2003-2018 Erwin Coumans  https://bulletphysics.org
+
+This software is provided 'as-is', without any express or implied warranty.
+In no event will the authors be held liable for any damages arising from the use of this software.
+Permission is granted to anyone to use this software for any purpose,
+including commercial applications, and to alter it and redistribute it freely,
+subject to the following restrictions:
+
+1. The origin of this software must not be misrepresented; you must not claim that you wrote the original software. If you use this software in a product, an acknowledgment in the product documentation would be appreciated but is not required.
+2. Altered source versions must be plainly marked as such, and must not be misrepresented as being the original software.
+3. This notice may not be removed or altered from any source distribution.
+*/
+
+/// btDbvtBroadphase optimization budget benchmark.
+/// A field of boxes where a few boxes move every step, and every 'burst interval' steps an eighth of
+/// the boxes jump to a new place (an explosion, a level streaming in). The bursts make the tree optimization
+/// and pair cleanup of btDbvtBroadphase::collide spike. The median and 99th percentile of the collide time
+/// and of the optimization and cleanup time are reported without a budget and with a few budgets,
+/// together with the share of stale pairs (pairs whose boxes no longer overlap) left in the pair cache.
+
+#include "BroadphaseBenchmark.h"
+#include "btBulletCollisionCommon.h"
+#include "LinearMath/btQuickprof.h"
+#include <stdio.h>
+#include <stdlib.h>
+
+struct BroadphaseBenchmarkScene
+{
+	btDefaultCollisionConfiguration* m_collisionConfiguration;
+	btCollisionDispatcher* m_dispatcher;
+	btDbvtBroadphase* m_broadphase;
+	btAlignedObjectArray<btBroadphaseProxy*> m_proxies;
+	btAlignedObjectArray<btVector3> m_centers;
+	unsigned int m_seed;
+
+	BroadphaseBenchmarkScene(int numBoxes, int dynamicUpdates) : m_seed(1)
+	{
+		m_collisionConfiguration = new btDefaultCollisionConfiguration();
+		m_dispatcher = new btCollisionDispatcher(m_collisionConfiguration);
+		m_broadphase = new btDbvtBroadphase();
+		m_broadphase->m_dupdates = dynamicUpdates;
+		for (int i = 0; i < numBoxes; ++i)
+		{
+			btVector3 center = randomPoint();
+			m_centers.push_back(center);
+			btVector3 aabbMin, aabbMax;
+			getAabb(center, aabbMin, aabbMax);
+			m_proxies.push_back(m_broadphase->createProxy(aabbMin, aabbMax, BOX_SHAPE_PROXYTYPE, NULL, btBroadphaseProxy::DefaultFilter, btBroadphaseProxy::AllFilter, m_dispatcher));
+		}
+	}
+
+	~BroadphaseBenchmarkScene()
+	{
+		for (int i = 0; i < m_proxies.size(); ++i)
+		{
+			m_broadphase->destroyProxy(m_proxies[i], m_dispatcher);
+		}
+		delete m_broadphase;
+		delete m_dispatcher;
+		delete m_collisionConfiguration;
+	}
+
+	// deterministic, so that every budget sees the same motion
+	btScalar unitRand()
+	{
+		m_seed = m_seed * 1664525u + 1013904223u;
+		return btScalar(m_seed >> 8) / btScalar(1 << 24);
+	}
+
+	btVector3 randomPoint()
+	{
+		btScalar extent = btPow(btScalar(m_proxies.size() + 1), btScalar(1) / 3) * btScalar(1.6) + 10;
+		return btVector3(unitRand(), unitRand(), unitRand()) * extent;
+	}
+
+	void getAabb(const btVector3& center, btVector3& aabbMin, btVector3& aabbMax) const
+	{
+		btVector3 halfExtents(1, 1, 1);
+		aabbMin = center - halfExtents;
+		aabbMax = center + halfExtents;
+	}
+
+	void moveBox(int index, const btVector3& center)
+	{
+		m_centers[index] = center;
+		btVector3 aabbMin, aabbMax;
+		getAabb(center, aabbMin, aabbMax);
+		m_broadphase->setAabb(m_proxies[index], aabbMin, aabbMax, m_dispatcher);
+	}
+
+	void move(bool burst)
+	{
+		for (int i = 0; i < m_proxies.size(); ++i)
+		{
+			if (burst && (i & 7) == 0)
+			{
+				moveBox(i, randomPoint());
+			}
+			else if ((i % 50) == 0)
+			{
+				btVector3 delta(unitRand() - btScalar(0.5), unitRand() - btScalar(0.5), unitRand() - btScalar(0.5));
+				moveBox(i, m_centers[i] + delta * btScalar(0.2));
+			}
+		}
+	}
+
+	int countStalePairs() const
+	{
+		const btBroadphasePairArray& pairs = m_broadphase->getOverlappingPairCache()->getOverlappingPairArray();
+		int numStale = 0;
+		for (int i = 0; i < pairs.size(); ++i)
+		{
+			// the test of the pair cleanup, on the leaf volumes with the margin
+			const btDbvtProxy* pa = (const btDbvtProxy*)pairs[i].m_pProxy0;
+			const btDbvtProxy* pb = (const btDbvtProxy*)pairs[i].m_pProxy1;
+			if (!Intersect(pa->leaf->volume, pb->leaf->volume))
+			{
+				numStale++;
+			}
+		}
+		return numStale;
+	}
+};
+
+struct ScalarLess
+{
+	bool operator()(btScalar a, btScalar b) const { return a < b; }
+};
+
+static btScalar percentile(btAlignedObjectArray<btScalar>& samples, int percent)
+{
+	samples.quickSort(ScalarLess());
+	return samples[btMin(samples.size() - 1, (samples.size() * percent) / 100)];
+}
+
+static void runBroadphaseBudget(int numBoxes, int dynamicUpdates, int numSteps, int burstInterval, int budget)
+{
+	BroadphaseBenchmarkScene scene(numBoxes, dynamicUpdates);
+	btDbvtBroadphase* broadphase = scene.m_broadphase;
+	broadphase->setOptimizationBudget(budget);
+	// settle, lets the proxies reach the fixed tree and the cost model learn
+	for (int i = 0; i < 20; ++i)
+	{
+		scene.move(false);
+		broadphase->calculateOverlappingPairs(scene.m_dispatcher);
+	}
+
+	btAlignedObjectArray<btScalar> collideTimes;
+	btAlignedObjectArray<btScalar> optimizeTimes;
+	double stale = 0;
+	int numPairs = 0;
+	btClock clock;
+	for (int iStep = 0; iStep < numSteps; ++iStep)
+	{
+		scene.move(iStep % burstInterval == 0);
+		unsigned long long start = clock.getTimeNanoseconds();
+		broadphase->calculateOverlappingPairs(scene.m_dispatcher);
+		collideTimes.push_back(btScalar(clock.getTimeNanoseconds() - start) / 1000);
+		optimizeTimes.push_back(broadphase->getOptimizationTime());
+		numPairs = broadphase->getOverlappingPairCache()->getNumOverlappingPairs();
+		stale += numPairs ? double(scene.countStalePairs()) / numPairs : 0.0;
+	}
+
+	char budgetName[32];
+	if (budget > 0)
+	{
+		sprintf(budgetName, "%d", budget);
+	}
+	else
+	{
+		sprintf(budgetName, "none");
+	}
+	btScalar optimizeMax = percentile(optimizeTimes, 100);
+	btScalar collideMax = percentile(collideTimes, 100);
+	printf("%8s %12.1f %12.1f %12.1f %12.1f %12.1f %12.1f %8d %8.2f %10.3f %10.3f\n",
+		   budgetName,
+		   percentile(optimizeTimes, 50),
+		   percentile(optimizeTimes, 99),
+		   optimizeMax,
+		   percentile(collideTimes, 50),
+		   percentile(collideTimes, 99),
+		   collideMax,
+		   numPairs,
+		   100.0 * stale / numSteps,
+		   broadphase->m_optimizecost,
+		   broadphase->m_cleanupcost);
+}
+
+int runBroadphaseBenchmark(int argc, char** argv)
+{
+	int numSteps = argc > 0 ? atoi(argv[0]) : 600;
+	int numBoxes = argc > 1 ? atoi(argv[1]) : 8000;
+	int burstInterval = argc > 2 ? atoi(argv[2]) : 30;
+	int dynamicUpdates = argc > 3 ? atoi(argv[3]) : 5;
+	if (burstInterval < 1)
+	{
+		burstInterval = 1;
+	}
+
+	printf("%d steps, %d boxes, an eighth of them jump every %d steps, %d%% dynamic updates\n", numSteps, numBoxes, burstInterval, dynamicUpdates);
+	printf("%8s %12s %12s %12s %12s %12s %12s %8s %8s %10s %10s\n", "budget", "opt us p50", "opt us p99", "opt us max",
+		   "coll us p50", "coll us p99", "coll us max", "pairs", "stale %", "us/pass", "us/test");
+	const int budgets[] = {0, 200, 100, 50};
+	for (int i = 0; i < int(sizeof(budgets) / sizeof(budgets[0])); ++i)
+	{
+		runBroadphaseBudget(numBoxes, dynamicUpdates, numSteps, burstInterval, budgets[i]);
+	}
+	return 0;
+}
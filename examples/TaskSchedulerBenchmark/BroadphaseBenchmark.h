@@ -0,0 +1,7 @@
+#ifndef BROADPHASE_BENCHMARK_H
+#define BROADPHASE_BENCHMARK_H
+
+// collide and optimization time percentiles of btDbvtBroadphase with and without an optimization budget
+int runBroadphaseBenchmark(int argc, char** argv);
+
+#endif  //BROADPHASE_BENCHMARK_H
@@ -0,0 +1,255 @@
+/*
+Bullet Continuous Collision Detection and Physics Library
+Copyright (c) 2003-2018 Erwin Coumans  https://bulletphysics.org
+
+This software is provided 'as-is', without any express or implied warranty.
+In no event will the authors be held liable for any damages arising from the use of this software.
+Permission is granted to anyone to use this software for any purpose,
+including commercial applications, and to alter it and redistribute it freely,
+subject to the following restrictions:
+
+1. The origin of this software must not be misrepresented; you must not claim that you wrote the original software. If you use this software in a product, an acknowledgment in the product documentation would be appreciated but is not required.
+2. Altered source versions must be plainly marked as such, and must not be misrepresented as being the original software.
+3. This notice may not be removed or altered from any source distribution.
+*/
+
+/// Contact solver benchmark on two scenes of BenchmarkDemo:
+///   pyramid : the box pyramid of test 2, 12 boxes on a side
+///   taru    : 10x10x10 Taru convex hulls of test 6, stacked tightly into one pile
+/// Both scenes are one big island solved by btSequentialImpulseConstraintSolverMt. The solver iterations
+/// are timed for 1, 2, 4... threads, a baseline for changes to the batched contact solve.
+///
+/// The batching benchmark runs the same scenes with the spatial grid batching of btBatchedConstraints
+/// and with the incremental batching, and reports the setup time and the quality of the contact batches.
+
+#include "ContactSolverBenchmark.h"
+#include "btBulletDynamicsCommon.h"
+#include "BulletCollision/CollisionDispatch/btCollisionDispatcherMt.h"
+#include "BulletDynamics/Dynamics/btDiscreteDynamicsWorldMt.h"
+#include "BulletDynamics/ConstraintSolver/btSequentialImpulseConstraintSolverMt.h"
+#include "LinearMath/btThreads.h"
+#include "LinearMath/btQuickprof.h"
+#include "../Benchmarks/TaruData.h"
+#include <stdio.h>
+#include <stdlib.h>
+
+// times the solver iterations only, leaving out the setup and the write back
+class TimedSequentialImpulseConstraintSolverMt : public btSequentialImpulseConstraintSolverMt
+{
+public:
+	unsigned long long m_iterationTime;
+	int m_numIterations;
+
+	TimedSequentialImpulseConstraintSolverMt() : m_iterationTime(0), m_numIterations(0) {}
+
+	virtual btScalar solveSingleIteration(int iteration, btCollisionObject** bodies, int numBodies, btPersistentManifold** manifoldPtr, int numManifolds, btTypedConstraint** constraints, int numConstraints, const btContactSolverInfo& infoGlobal, btIDebugDraw* debugDrawer) BT_OVERRIDE
+	{
+		btClock clock;
+		btScalar residual = btSequentialImpulseConstraintSolverMt::solveSingleIteration(iteration, bodies, numBodies, manifoldPtr, numManifolds, constraints, numConstraints, infoGlobal, debugDrawer);
+		m_iterationTime += clock.getTimeNanoseconds();
+		m_numIterations++;
+		return residual;
+	}
+};
+
+enum ContactSolverScene
+{
+	kScenePyramid,
+	kSceneTaru,
+	kSceneCount
+};
+
+static const char* sSceneNames[kSceneCount] = {"pyramid", "taru"};
+
+struct ContactSolverBenchmarkScene
+{
+	btDefaultCollisionConfiguration* m_collisionConfiguration;
+	btCollisionDispatcherMt* m_dispatcher;
+	btDbvtBroadphase* m_broadphase;
+	btConstraintSolverPoolMt* m_solverPool;
+	TimedSequentialImpulseConstraintSolverMt* m_solver;
+	btDiscreteDynamicsWorldMt* m_world;
+	btAlignedObjectArray<btCollisionShape*> m_shapes;
+
+	ContactSolverBenchmarkScene(ContactSolverScene scene)
+	{
+		btDefaultCollisionConstructionInfo cci;
+		cci.m_defaultMaxPersistentManifoldPoolSize = 80000;
+		cci.m_defaultMaxCollisionAlgorithmPoolSize = 80000;
+		m_collisionConfiguration = new btDefaultCollisionConfiguration(cci);
+		m_dispatcher = new btCollisionDispatcherMt(m_collisionConfiguration, 40);
+		m_broadphase = new btDbvtBroadphase();
+		m_solverPool = new btConstraintSolverPoolMt(BT_MAX_THREAD_COUNT);
+		m_solver = new TimedSequentialImpulseConstraintSolverMt();
+		m_world = new btDiscreteDynamicsWorldMt(m_dispatcher, m_broadphase, m_solverPool, m_solver, m_collisionConfiguration);
+		m_world->setGravity(btVector3(0, -10, 0));
+
+		btBoxShape* groundShape = new btBoxShape(btVector3(250, 50, 250));
+		m_shapes.push_back(groundShape);
+		addBody(groundShape, 0, btVector3(0, -50, 0));
+
+		if (scene == kScenePyramid)
+		{
+			createPyramid(12);
+		}
+		else
+		{
+			createTaruStack();
+		}
+	}
+
+	~ContactSolverBenchmarkScene()
+	{
+		for (int i = m_world->getNumCollisionObjects() - 1; i >= 0; --i)
+		{
+			btCollisionObject* obj = m_world->getCollisionObjectArray()[i];
+			btRigidBody* body = btRigidBody::upcast(obj);
+			if (body && body->getMotionState())
+			{
+				delete body->getMotionState();
+			}
+			m_world->removeCollisionObject(obj);
+			delete obj;
+		}
+		delete m_world;
+		delete m_solver;
+		delete m_solverPool;
+		delete m_broadphase;
+		delete m_dispatcher;
+		delete m_collisionConfiguration;
+		for (int i = 0; i < m_shapes.size(); ++i)
+		{
+			delete m_shapes[i];
+		}
+	}
+
+	// BenchmarkDemo::createPyramid
+	void createPyramid(int stackSize)
+	{
+		const btScalar collisionRadius = btScalar(0.0);
+		btVector3 boxSize(1, 1, 1);
+		btScalar space = btScalar(0.0001);
+		btVector3 pos(0, boxSize[1], 0);
+		btBoxShape* blockShape = new btBoxShape(boxSize - btVector3(collisionRadius, collisionRadius, collisionRadius));
+		m_shapes.push_back(blockShape);
+
+		btScalar diffX = boxSize[0] * btScalar(1.02);
+		btScalar diffY = boxSize[1] * btScalar(1.02);
+		btScalar diffZ = boxSize[2] * btScalar(1.02);
+		btScalar offsetX = -stackSize * (diffX * 2 + space) * btScalar(0.5);
+		btScalar offsetZ = -stackSize * (diffZ * 2 + space) * btScalar(0.5);
+		while (stackSize)
+		{
+			for (int j = 0; j < stackSize; j++)
+			{
+				pos[2] = offsetZ + btScalar(j) * (diffZ * 2 + space);
+				for (int i = 0; i < stackSize; i++)
+				{
+					pos[0] = offsetX + btScalar(i) * (diffX * 2 + space);
+					addBody(blockShape, 1, pos);
+				}
+			}
+			offsetX += diffX;
+			offsetZ += diffZ;
+			pos[1] += (diffY * 2 + space);
+			stackSize--;
+		}
+	}
+
+	// the Taru convex hull of BenchmarkDemo::createTest6, in one tight 10x10x10 stack of upright barrels
+	// instead of the spread out columns of the demo, so that the whole stack ends up in one island
+	void createTaruStack()
+	{
+		btConvexHullShape* convexHullShape = new btConvexHullShape();
+		m_shapes.push_back(convexHullShape);
+		for (int i = 0; i < TaruVtxCount; i++)
+		{
+			convexHullShape->addPoint(btVector3(TaruVtx[i * 3], TaruVtx[i * 3 + 1], TaruVtx[i * 3 + 2]));
+		}
+		int size = 10;
+		int height = 10;
+		btScalar spacing = btScalar(3.7);
+		btScalar layerHeight = btScalar(4.05);
+		btScalar offset = -(size - 1) * spacing * btScalar(0.5);
+		for (int k = 0; k < height; k++)
+		{
+			for (int j = 0; j < size; j++)
+			{
+				for (int i = 0; i < size; i++)
+				{
+					addBody(convexHullShape, 1, btVector3(offset + i * spacing, 2 + k * layerHeight, offset + j * spacing));
+				}
+			}
+		}
+	}
+
+	void addBody(btCollisionShape* shape, btScalar mass, const btVector3& origin)
+	{
+		btVector3 localInertia(0, 0, 0);
+		if (mass != btScalar(0))
+		{
+			shape->calculateLocalInertia(mass, localInertia);
+		}
+		btTransform transform;
+		transform.setIdentity();
+		transform.setOrigin(origin);
+		btDefaultMotionState* motionState = new btDefaultMotionState(transform);
+		btRigidBody::btRigidBodyConstructionInfo rbInfo(mass, motionState, shape, localInertia);
+		btRigidBody* body = new btRigidBody(rbInfo);
+		// keep the workload the same for the whole run
+		body->setActivationState(DISABLE_DEACTIVATION);
+		m_world->addRigidBody(body);
+	}
+
+	void stepSimulation()
+	{
+		m_world->stepSimulation(btScalar(1. / 60.), 0, btScalar(1. / 60.));
+		// the dispatcher keeps a copy of every manifold that collided during the step
+		m_dispatcher->ClearManifoldsCache();
+	}
+};
+
+int runContactSolverBenchmark(int argc, char** argv)
+{
+	int numSteps = argc > 0 ? atoi(argv[0]) : 300;
+	int numSettleSteps = argc > 1 ? atoi(argv[1]) : 60;
+
+	btITaskScheduler* scheduler = btCreateDefaultTaskScheduler();
+	if (scheduler == NULL)
+	{
+		printf("The default task scheduler is not available, build with BULLET2_MULTITHREADING.\n");
+		return 1;
+	}
+	btSetTaskScheduler(scheduler);
+	// solve the big island with the batched solver even with a single thread
+	btSequentialImpulseConstraintSolverMt::s_minimumContactManifoldsForBatching = 1;
+
+	printf("%d steps after %d settle steps, max %d threads\n", numSteps, numSettleSteps, scheduler->getMaxNumThreads());
+	printf("%8s %8s %10s %16s\n", "scene", "threads", "manifolds", "iterations/sec");
+	for (int iScene = 0; iScene < kSceneCount; ++iScene)
+	{
+		for (int numThreads = 1; numThreads <= scheduler->getMaxNumThreads(); numThreads *= 2)
+		{
+			scheduler->setNumThreads(numThreads);
+			ContactSolverBenchmarkScene scene((ContactSolverScene)iScene);
+			for (int i = 0; i < numSettleSteps; ++i)
+			{
+				scene.stepSimulation();
+			}
+			scene.m_solver->m_iterationTime = 0;
+			scene.m_solver->m_numIterations = 0;
+			for (int i = 0; i < numSteps; ++i)
+			{
+				scene.stepSimulation();
+			}
+			printf("%8s %8d %10d %16.0f\n",
+				   sSceneNames[iScene],
+				   scheduler->getNumThreads(),
+				   scene.m_dispatcher->getNumManifolds(),
+				   scene.m_solver->m_iterationTime ? double(scene.m_solver->m_numIterations) * 1000000000.0 / double(scene.m_solver->m_iterationTime) : 0.0);
+		}
+	}
+	btSetTaskScheduler(btGetSequentialTaskScheduler());
+	delete scheduler;
+	return 0;
+}
@@ -0,0 +1,10 @@
+#ifndef CONTACT_SOLVER_BENCHMARK_H
+#define CONTACT_SOLVER_BENCHMARK_H
+
+// solver iterations per second of btSequentialImpulseConstraintSolverMt on one big island, for 1, 2, 4... threads
+int runContactSolverBenchmark(int argc, char** argv);
+
+// compares the setup time and the batch quality of the spatial grid batching with the incremental batching
+int runBatchingBenchmark(int argc, char** argv);
+
+#endif  //CONTACT_SOLVER_BENCHMARK_H
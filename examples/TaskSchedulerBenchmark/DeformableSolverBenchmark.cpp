@@ -0,0 +1,228 @@
+/*
+Bullet Continuous Collision Detection and Physics Library
+Copyright (c) 2003-2018 Erwin Coumans  https://bulletphysics.org
+
+This software is provided 'as-is', without any express or implied warranty.
+In no event will the authors be held liable for any damages arising from the use of this software.
+Permission is granted to anyone to use this software for any purpose,
+including commercial applications, and to alter it and redistribute it freely,
+subject to the following restrictions:
+
+1. The origin of this software must not be misrepresented; you must not claim that you wrote the original software. If you use this software in a product, an acknowledgment in the product documentation would be appreciated but is not required.
+2. Altered source versions must be plainly marked as such, and must not be misrepresented as being the original software.
+3. This notice may not be removed or altered from any source distribution.
+*/
+
+/// Deformable solver benchmark. Headless versions of three DeformableDemo scenes are stepped with each preconditioner
+/// of btDeformableBodySolver:
+///   VolumetricDeformable : a linear elastic cube dropped on the ground, implicit, 1/240 s steps
+///   LargeDeformation     : a linear elastic cube starting from random node positions, implicit, 1/60 s steps
+///   Pinch                : a neo-Hookean cube dropped on the ground without the grippers, explicit elasticity, 1/240 s steps
+/// Several cubes are placed next to each other to make the systems larger. All runs multiply with the assembled matrix.
+/// For each preconditioner the Krylov iterations per solve, the step time and the largest node distance to the mass
+/// preconditioned run are reported. The solvers stop at a tolerance in the norm of the preconditioner, the distance shows
+/// that the runs agree, except on LargeDeformation where the tangled start makes small differences grow.
+
+#include "DeformableSolverBenchmark.h"
+#include "btBulletDynamicsCommon.h"
+#include "BulletSoftBody/btDeformableMultiBodyDynamicsWorld.h"
+#include "BulletSoftBody/btDeformableMultiBodyConstraintSolver.h"
+#include "BulletSoftBody/btDeformableBodySolver.h"
+#include "BulletSoftBody/btSoftBodyHelpers.h"
+#include "BulletSoftBody/btSoftBodyRigidBodyCollisionConfiguration.h"
+#include "LinearMath/btThreads.h"
+#include "LinearMath/btQuickprof.h"
+#include <stdio.h>
+#include <stdlib.h>
+
+struct TetraCube
+{
+#include "../SoftDemo/cube.inl"
+};
+
+enum DeformableBenchmarkScene
+{
+	VOLUMETRIC_DEFORMABLE,
+	LARGE_DEFORMATION,
+	PINCH,
+	NUM_DEFORMABLE_BENCHMARK_SCENES
+};
+
+static const char* gDeformableBenchmarkSceneNames[NUM_DEFORMABLE_BENCHMARK_SCENES] = {"VolumetricDeformable", "LargeDeformation", "Pinch"};
+
+struct DeformableBenchmarkWorld
+{
+	btSoftBodyRigidBodyCollisionConfiguration m_config;
+	btCollisionDispatcher m_dispatcher;
+	btDbvtBroadphase m_broadphase;
+	btDeformableBodySolver m_deformableSolver;
+	btDeformableMultiBodyConstraintSolver m_solver;
+	btDeformableMultiBodyDynamicsWorld* m_world;
+	btBoxShape m_groundShape;
+	btRigidBody* m_ground;
+	btAlignedObjectArray<btSoftBody*> m_softBodies;
+	btAlignedObjectArray<btDeformableLagrangianForce*> m_forces;
+	btScalar m_timeStep;
+
+	DeformableBenchmarkWorld(DeformableBenchmarkScene scene, int numCubes, int preconditioner)
+		: m_dispatcher(&m_config), m_groundShape(btVector3(150, 25, 150))
+	{
+		m_solver.setDeformableSolver(&m_deformableSolver);
+		m_world = new btDeformableMultiBodyDynamicsWorld(&m_dispatcher, &m_broadphase, &m_solver, &m_config, &m_deformableSolver);
+		btVector3 gravity(0, -10, 0);
+		m_world->setGravity(gravity);
+		m_world->getWorldInfo().m_gravity = gravity;
+		m_world->getWorldInfo().m_sparsesdf.setDefaultVoxelsz(0.25);
+		m_world->getWorldInfo().m_sparsesdf.Initialize();
+
+		btTransform groundTransform;
+		groundTransform.setIdentity();
+		groundTransform.setOrigin(btVector3(0, -25, 0));
+		m_ground = new btRigidBody(0, 0, &m_groundShape);
+		m_ground->setWorldTransform(groundTransform);
+		m_ground->setFriction(4);
+		m_world->addRigidBody(m_ground);
+
+		srand(1234);
+		btDeformableGravityForce* gravityForce = new btDeformableGravityForce(gravity);
+		m_forces.push_back(gravityForce);
+		for (int i = 0; i < numCubes; ++i)
+		{
+			btSoftBody* psb = btSoftBodyHelpers::CreateFromTetGenData(m_world->getWorldInfo(), TetraCube::getElements(), 0, TetraCube::getNodes(), false, true, true);
+			m_world->addSoftBody(psb);
+			psb->scale(btVector3(2, 2, 2));
+			psb->translate(btVector3(btScalar(i * 6), scene == PINCH ? 4 : 5, 0));
+			psb->getCollisionShape()->setMargin(scene == PINCH ? btScalar(0.01) : btScalar(0.1));
+			psb->setTotalMass(scene == PINCH ? 1 : btScalar(0.5));
+			psb->m_cfg.kKHR = 1;
+			psb->m_cfg.kCHR = 1;
+			psb->m_cfg.kDF = (scene == VOLUMETRIC_DEFORMABLE) ? 2 : btScalar(0.5);
+			psb->m_cfg.collisions = btSoftBody::fCollision::SDF_RD | (scene == PINCH ? btSoftBody::fCollision::SDF_RDF : btSoftBody::fCollision::SDF_RDN);
+			psb->m_sleepingThreshold = 0;
+			btSoftBodyHelpers::generateBoundaryFaces(psb);
+			if (scene == LARGE_DEFORMATION)
+			{
+				for (int j = 0; j < psb->m_nodes.size(); ++j)
+				{
+					for (int d = 0; d < 3; ++d)
+					{
+						psb->m_nodes[j].m_x[d] = btScalar(2 * rand()) / RAND_MAX - 1;
+					}
+					psb->m_nodes[j].m_x += btVector3(btScalar(i * 6), 8, 0);
+				}
+			}
+			else
+			{
+				m_world->addForce(psb, gravityForce);
+			}
+			btDeformableLagrangianForce* elasticity;
+			if (scene == PINCH)
+			{
+				btDeformableNeoHookeanForce* neohookean = new btDeformableNeoHookeanForce(8, 3, btScalar(0.02));
+				neohookean->setPoissonRatio(btScalar(0.3));
+				neohookean->setYoungsModulus(25);
+				neohookean->setDamping(btScalar(0.01));
+				psb->m_cfg.drag = btScalar(0.001);
+				elasticity = neohookean;
+			}
+			else
+			{
+				elasticity = new btDeformableLinearElasticityForce(100, 100, btScalar(0.01));
+			}
+			m_world->addForce(psb, elasticity);
+			m_forces.push_back(elasticity);
+			m_softBodies.push_back(psb);
+		}
+		m_world->setImplicit(scene != PINCH);
+		m_world->setLineSearch(false);
+		m_world->setUseProjection(true);
+		m_timeStep = (scene == LARGE_DEFORMATION) ? btScalar(1. / 60.) : btScalar(1. / 240.);
+		m_deformableSolver.setPreconditionerOverride(preconditioner);
+		m_deformableSolver.setUseAssembledMatrix(true);
+	}
+
+	~DeformableBenchmarkWorld()
+	{
+		for (int i = 0; i < m_softBodies.size(); ++i)
+		{
+			m_world->removeSoftBody(m_softBodies[i]);
+			delete m_softBodies[i];
+		}
+		for (int i = 0; i < m_forces.size(); ++i)
+		{
+			delete m_forces[i];
+		}
+		m_world->removeRigidBody(m_ground);
+		delete m_ground;
+		delete m_world;
+	}
+
+	void step(int numSteps)
+	{
+		for (int i = 0; i < numSteps; ++i)
+		{
+			m_world->stepSimulation(m_timeStep, 0);
+		}
+	}
+
+	btScalar maxDistance(const DeformableBenchmarkWorld& other) const
+	{
+		btScalar distance = 0;
+		for (int i = 0; i < m_softBodies.size(); ++i)
+		{
+			for (int j = 0; j < m_softBodies[i]->m_nodes.size(); ++j)
+			{
+				distance = btMax(distance, m_softBodies[i]->m_nodes[j].m_x.distance(other.m_softBodies[i]->m_nodes[j].m_x));
+			}
+		}
+		return distance;
+	}
+};
+
+int runDeformableSolverBenchmark(int argc, char** argv)
+{
+	int numSteps = argc > 0 ? atoi(argv[0]) : 240;
+	int numCubes = argc > 1 ? atoi(argv[1]) : 4;
+	if (numCubes < 1)
+	{
+		numCubes = 1;
+	}
+
+	btITaskScheduler* scheduler = btCreateDefaultTaskScheduler();
+	if (scheduler)
+	{
+		btSetTaskScheduler(scheduler);
+	}
+
+	const int preconditioners[] = {
+		btDeformableBackwardEulerObjective::Mass_preconditioner,
+		btDeformableBackwardEulerObjective::Block_Jacobi_preconditioner,
+		btDeformableBackwardEulerObjective::Incomplete_Cholesky_preconditioner,
+		btDeformableBackwardEulerObjective::Multigrid_preconditioner};
+	const char* preconditionerNames[] = {"mass", "block Jacobi", "incomplete Cholesky", "multigrid"};
+	const int numPreconditioners = sizeof(preconditioners) / sizeof(preconditioners[0]);
+
+	printf("%d steps, %d cubes of %d nodes, %d threads\n", numSteps, numCubes, 400, btGetTaskScheduler()->getNumThreads());
+	printf("%22s %20s %10s %10s %12s %12s\n", "scene", "preconditioner", "solves", "it/solve", "ms/step", "max dist");
+	for (int scene = 0; scene < NUM_DEFORMABLE_BENCHMARK_SCENES; ++scene)
+	{
+		DeformableBenchmarkWorld reference(DeformableBenchmarkScene(scene), numCubes, preconditioners[0]);
+		reference.step(numSteps);
+		for (int i = 0; i < numPreconditioners; ++i)
+		{
+			DeformableBenchmarkWorld world(DeformableBenchmarkScene(scene), numCubes, preconditioners[i]);
+			world.m_deformableSolver.resetKrylovStatistics();
+			btClock clock;
+			world.step(numSteps);
+			double ms = clock.getTimeMicroseconds() / 1000.0;
+			int numSolves = world.m_deformableSolver.getNumKrylovSolves();
+			int numIterations = world.m_deformableSolver.getNumKrylovIterations();
+			printf("%22s %20s %10d %10.1f %12.3f %12.2g\n", gDeformableBenchmarkSceneNames[scene], preconditionerNames[i], numSolves,
+				   numSolves ? double(numIterations) / numSolves : 0.0, ms / numSteps, double(world.maxDistance(reference)));
+		}
+	}
+
+	btSetTaskScheduler(btGetSequentialTaskScheduler());
+	delete scheduler;
+	return 0;
+}
@@ -0,0 +1,7 @@
+#ifndef DEFORMABLE_SOLVER_BENCHMARK_H
+#define DEFORMABLE_SOLVER_BENCHMARK_H
+
+// Krylov iterations and step time of btDeformableBodySolver with each preconditioner on the DeformableDemo scenes
+int runDeformableSolverBenchmark(int argc, char** argv);
+
+#endif  //DEFORMABLE_SOLVER_BENCHMARK_H
@@ -0,0 +1,196 @@
+/*
+Bullet Continuous Collision Detection and Physics Library
+Copyright (c) 2003-2018 Erwin Coumans  https://bulletphysics.org
+
+This software is provided 'as-is', without any express or implied warranty.
+In no event will the authors be held liable for any damages arising from the use of this software.
+Permission is granted to anyone to use this software for any purpose,
+including commercial applications, and to alter it and redistribute it freely,
+subject to the following restrictions:
+
+1. The origin of this software must not be misrepresented; you must not claim that you wrote the original software. If you use this software in a product, an acknowledgment in the product documentation would be appreciated but is not required.
+2. Altered source versions must be plainly marked as such, and must not be misrepresented as being the original software.
+3. This notice may not be removed or altered from any source distribution.
+*/
+
+/// Island solve benchmark: one big pile of boxes (a single large island) next to many
+/// resting pairs of boxes (lots of tiny islands). btSimulationIslandManagerMt solves the
+/// islands with btParallelFor, so one thread gets stuck on the pile while the others share the
+/// small islands. The time spent in the island dispatch is reported per task scheduler and thread count.
+
+#include "IslandBenchmark.h"
+#include "btBulletDynamicsCommon.h"
+#include "BulletCollision/CollisionDispatch/btCollisionDispatcherMt.h"
+#include "BulletDynamics/Dynamics/btDiscreteDynamicsWorldMt.h"
+#include "BulletDynamics/Dynamics/btSimulationIslandManagerMt.h"
+#include "LinearMath/btThreads.h"
+#include "LinearMath/btQuickprof.h"
+#include <stdio.h>
+#include <stdlib.h>
+
+static unsigned long long sIslandDispatchTime = 0;
+
+static void timedIslandDispatch(btAlignedObjectArray<btSimulationIslandManagerMt::Island*>* islands, const btSimulationIslandManagerMt::SolverParams& solverParams)
+{
+	btClock clock;
+	btSimulationIslandManagerMt::parallelIslandDispatch(islands, solverParams);
+	sIslandDispatchTime += clock.getTimeMicroseconds();
+}
+
+struct IslandBenchmarkScene
+{
+	btDefaultCollisionConfiguration* m_collisionConfiguration;
+	btCollisionDispatcherMt* m_dispatcher;
+	btDbvtBroadphase* m_broadphase;
+	btConstraintSolverPoolMt* m_solverPool;
+	btDiscreteDynamicsWorldMt* m_world;
+	btBoxShape* m_groundShape;
+	btBoxShape* m_boxShape;
+
+	IslandBenchmarkScene(int numPileBodies, int numRestingPairs)
+	{
+		btDefaultCollisionConstructionInfo cci;
+		cci.m_defaultMaxPersistentManifoldPoolSize = 80000;
+		cci.m_defaultMaxCollisionAlgorithmPoolSize = 80000;
+		m_collisionConfiguration = new btDefaultCollisionConfiguration(cci);
+		m_dispatcher = new btCollisionDispatcherMt(m_collisionConfiguration, 40);
+		m_broadphase = new btDbvtBroadphase();
+		m_solverPool = new btConstraintSolverPoolMt(BT_MAX_THREAD_COUNT);
+		m_world = new btDiscreteDynamicsWorldMt(m_dispatcher, m_broadphase, m_solverPool, NULL, m_collisionConfiguration);
+		m_world->setGravity(btVector3(0, -10, 0));
+		btSimulationIslandManagerMt* islandManager = static_cast<btSimulationIslandManagerMt*>(m_world->getSimulationIslandManager());
+		islandManager->setIslandDispatchFunction(timedIslandDispatch);
+
+		m_groundShape = new btBoxShape(btVector3(500, 1, 500));
+		m_boxShape = new btBoxShape(btVector3(btScalar(0.5), btScalar(0.5), btScalar(0.5)));
+
+		addBody(m_groundShape, 0, btVector3(0, -1, 0));
+
+		// the pile, columns of touching boxes so all of them end up in the same island
+		int side = 10;
+		for (int i = 0; i < numPileBodies; ++i)
+		{
+			int column = i % (side * side);
+			int level = i / (side * side);
+			addBody(m_boxShape, 1, btVector3(btScalar(column % side), btScalar(0.5) + level, btScalar(column / side)));
+		}
+		// resting pairs, each one a small island of its own
+		int pairsPerRow = 20;
+		for (int i = 0; i < numRestingPairs; ++i)
+		{
+			btScalar x = btScalar(20 + 3 * (i % pairsPerRow));
+			btScalar z = btScalar(3 * (i / pairsPerRow));
+			addBody(m_boxShape, 1, btVector3(x, btScalar(0.5), z));
+			addBody(m_boxShape, 1, btVector3(x, btScalar(1.5), z));
+		}
+	}
+
+	~IslandBenchmarkScene()
+	{
+		for (int i = m_world->getNumCollisionObjects() - 1; i >= 0; --i)
+		{
+			btCollisionObject* obj = m_world->getCollisionObjectArray()[i];
+			btRigidBody* body = btRigidBody::upcast(obj);
+			if (body && body->getMotionState())
+			{
+				delete body->getMotionState();
+			}
+			m_world->removeCollisionObject(obj);
+			delete obj;
+		}
+		delete m_world;
+		delete m_solverPool;
+		delete m_broadphase;
+		delete m_dispatcher;
+		delete m_collisionConfiguration;
+		delete m_groundShape;
+		delete m_boxShape;
+	}
+
+	void addBody(btCollisionShape* shape, btScalar mass, const btVector3& origin)
+	{
+		btVector3 localInertia(0, 0, 0);
+		if (mass != btScalar(0))
+		{
+			shape->calculateLocalInertia(mass, localInertia);
+		}
+		btTransform transform;
+		transform.setIdentity();
+		transform.setOrigin(origin);
+		btDefaultMotionState* motionState = new btDefaultMotionState(transform);
+		btRigidBody::btRigidBodyConstructionInfo rbInfo(mass, motionState, shape, localInertia);
+		btRigidBody* body = new btRigidBody(rbInfo);
+		// keep the workload the same for the whole run
+		body->setActivationState(DISABLE_DEACTIVATION);
+		m_world->addRigidBody(body);
+	}
+};
+
+int runIslandBenchmark(int argc, char** argv)
+{
+	int numSteps = argc > 0 ? atoi(argv[0]) : 100;
+	int numPileBodies = argc > 1 ? atoi(argv[1]) : 2000;
+	int numRestingPairs = argc > 2 ? atoi(argv[2]) : 300;
+
+	btITaskScheduler* schedulers[5];
+	const char* labels[5] = {"default", "work stealing", "OpenMP", "TBB", "PPL"};
+	schedulers[0] = btCreateDefaultTaskScheduler();
+	schedulers[1] = btCreateWorkStealingTaskScheduler();
+	schedulers[2] = btGetOpenMPTaskScheduler();
+	schedulers[3] = btGetTBBTaskScheduler();
+	schedulers[4] = btGetPPLTaskScheduler();
+	if (schedulers[0] == NULL)
+	{
+		printf("The default task scheduler is not available, build with BULLET2_MULTITHREADING.\n");
+		return 1;
+	}
+
+	printf("%d steps, %d bodies in the pile, %d resting pairs, max %d threads\n",
+		   numSteps, numPileBodies, numRestingPairs, schedulers[0]->getMaxNumThreads());
+	printf("%14s %8s %16s %16s %10s\n", "scheduler", "threads", "island ms/step", "total ms/step", "steals");
+
+	for (int iScheduler = 0; iScheduler < 5; ++iScheduler)
+	{
+		btITaskScheduler* scheduler = schedulers[iScheduler];
+		if (scheduler == NULL)
+		{
+			continue;
+		}
+		btSetTaskScheduler(scheduler);
+		for (int numThreads = 1; numThreads <= BT_MAX_THREAD_COUNT; numThreads *= 2)
+		{
+			if (numThreads > scheduler->getMaxNumThreads())
+			{
+				break;
+			}
+			scheduler->setNumThreads(numThreads);
+			IslandBenchmarkScene scene(numPileBodies, numRestingPairs);
+			// let the pile settle a bit
+			for (int i = 0; i < 20; ++i)
+			{
+				scene.m_world->stepSimulation(btScalar(1. / 60.), 0, btScalar(1. / 60.));
+			}
+			sIslandDispatchTime = 0;
+			scheduler->resetStats();
+			btClock clock;
+			for (int i = 0; i < numSteps; ++i)
+			{
+				scene.m_world->stepSimulation(btScalar(1. / 60.), 0, btScalar(1. / 60.));
+			}
+			unsigned long long totalTime = clock.getTimeMicroseconds();
+			btTaskSchedulerStats stats;
+			scheduler->getStats(stats);
+			printf("%14s %8d %16.3f %16.3f %10llu\n",
+				   labels[iScheduler],
+				   scheduler->getNumThreads(),
+				   double(sIslandDispatchTime) / (1000.0 * numSteps),
+				   double(totalTime) / (1000.0 * numSteps),
+				   stats.m_numSteals);
+		}
+		btSetTaskScheduler(btGetSequentialTaskScheduler());
+	}
+
+	delete schedulers[0];
+	delete schedulers[1];
+	return 0;
+}
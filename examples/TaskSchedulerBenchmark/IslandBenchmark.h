@@ -0,0 +1,7 @@
+#ifndef ISLAND_BENCHMARK_H
+#define ISLAND_BENCHMARK_H
+
+// times the parallel island solve of btSimulationIslandManagerMt with every available task scheduler
+int runIslandBenchmark(int argc, char** argv);
+
+#endif  //ISLAND_BENCHMARK_H
@@ -0,0 +1,244 @@
+/*
+Bullet Continuous Collision Detection and Physics Library
+Copyright (c) 2003-2018 Erwin Coumans  https://bulletphysics.org
+
+This software is provided 'as-is', without any express or implied warranty.
+In no event will the authors be held liable for any damages arising from the use of this software.
+Permission is granted to anyone to use this software for any purpose,
+including commercial applications, and to alter it and redistribute it freely,
+subject to the following restrictions:
+
+1. The origin of this software must not be misrepresented; you must not claim that you wrote the original software. If you use this software in a product, an acknowledgment in the product documentation would be appreciated but is not required.
+2. Altered source versions must be plainly marked as such, and must not be misrepresented as being the original software.
+3. This notice may not be removed or altered from any source distribution.
+*/
+
+/// Pair cache benchmark: a broadphase-like frame that reports a large set of overlapping pairs, most of them
+/// already in the cache, some new, and removes the pairs that stopped overlapping. The frame is timed with
+/// btHashedOverlappingPairCache on one thread and with btHashedOverlappingPairCacheMt from 1 to 16 threads
+/// (the concurrent phase and the flush separately).
+
+#include "PairCacheBenchmark.h"
+#include "BulletCollision/BroadphaseCollision/btHashedOverlappingPairCacheMt.h"
+#include "LinearMath/btThreads.h"
+#include "LinearMath/btQuickprof.h"
+#include <stdio.h>
+#include <stdlib.h>
+
+struct PairCacheBenchmarkData
+{
+	btAlignedObjectArray<btBroadphaseProxy*> m_proxies;
+	btAlignedObjectArray<int> m_frames;  // proxy index pairs of every frame, a negative first index removes the pair
+	btAlignedObjectArray<int> m_frameStart;
+	btAlignedObjectArray<unsigned char> m_used;  // per proxy and neighbour offset, so no pair is listed twice
+	unsigned int m_seed;
+
+	PairCacheBenchmarkData(int numProxies, int numPairs, int numFrames, int changePercent) : m_seed(1)
+	{
+		for (int i = 0; i < numProxies; ++i)
+		{
+			btBroadphaseProxy* proxy = new btBroadphaseProxy(btVector3(0, 0, 0), btVector3(1, 1, 1), NULL, btBroadphaseProxy::DefaultFilter, btBroadphaseProxy::AllFilter);
+			proxy->m_uniqueId = i + 2;
+			m_proxies.push_back(proxy);
+		}
+		m_used.resize(numProxies * 16, 0);
+		// each proxy overlaps a few neighbours by index, every frame some of the pairs are replaced
+		btAlignedObjectArray<int> pairs;
+		for (int i = 0; i < numPairs; ++i)
+		{
+			randomPair(pairs);
+		}
+		for (int frame = 0; frame < numFrames; ++frame)
+		{
+			m_frameStart.push_back(m_frames.size());
+			// a pair is not removed and added in the same frame, the slots of the removed pairs are freed after the frame
+			btAlignedObjectArray<int> freed;
+			for (int i = 0; i < pairs.size(); i += 2)
+			{
+				if (int(rand() % 100) < changePercent)
+				{
+					m_frames.push_back(-1 - pairs[i]);
+					m_frames.push_back(pairs[i + 1]);
+					freed.push_back(pairs[i] * 16 + (pairs[i + 1] - pairs[i] - 1 + m_proxies.size()) % m_proxies.size());
+					pairs.swap(i, pairs.size() - 2);
+					pairs.swap(i + 1, pairs.size() - 1);
+					pairs.resize(pairs.size() - 2);
+					randomPair(pairs);
+				}
+			}
+			for (int i = 0; i < pairs.size(); ++i)
+			{
+				m_frames.push_back(pairs[i]);
+			}
+			for (int i = 0; i < freed.size(); ++i)
+			{
+				m_used[freed[i]] = 0;
+			}
+		}
+		m_frameStart.push_back(m_frames.size());
+	}
+
+	~PairCacheBenchmarkData()
+	{
+		for (int i = 0; i < m_proxies.size(); ++i)
+		{
+			delete m_proxies[i];
+		}
+	}
+
+	unsigned int rand()
+	{
+		m_seed = m_seed * 1664525u + 1013904223u;
+		return m_seed >> 8;
+	}
+
+	void randomPair(btAlignedObjectArray<int>& pairs)
+	{
+		for (;;)
+		{
+			int a = int(rand() % unsigned(m_proxies.size()));
+			int offset = int(rand() % 16);
+			if (!m_used[a * 16 + offset])
+			{
+				m_used[a * 16 + offset] = 1;
+				pairs.push_back(a);
+				pairs.push_back((a + 1 + offset) % m_proxies.size());
+				return;
+			}
+		}
+	}
+};
+
+struct PairCacheBenchmarkLoop : public btIParallelForBody
+{
+	btHashedOverlappingPairCacheMt* m_cache;
+	const PairCacheBenchmarkData* m_data;
+	int m_begin;
+
+	PairCacheBenchmarkLoop(btHashedOverlappingPairCacheMt* cache, const PairCacheBenchmarkData* data, int begin)
+		: m_cache(cache), m_data(data), m_begin(begin)
+	{
+	}
+	void forLoop(int iBegin, int iEnd) const BT_OVERRIDE
+	{
+		const btAlignedObjectArray<int>& frames = m_data->m_frames;
+		for (int i = iBegin; i < iEnd; ++i)
+		{
+			int a = frames[m_begin + 2 * i];
+			btBroadphaseProxy* proxy1 = m_data->m_proxies[frames[m_begin + 2 * i + 1]];
+			if (a < 0)
+			{
+				m_cache->removeOverlappingPairConcurrent(m_data->m_proxies[-1 - a], proxy1);
+			}
+			else
+			{
+				m_cache->addOverlappingPairConcurrent(m_data->m_proxies[a], proxy1);
+			}
+		}
+	}
+};
+
+static unsigned long long runSerial(const PairCacheBenchmarkData& data, int& numPairs)
+{
+	btHashedOverlappingPairCache cache;
+	btClock clock;
+	unsigned long long time = 0;
+	for (int frame = 0; frame + 1 < data.m_frameStart.size(); ++frame)
+	{
+		unsigned long long start = clock.getTimeMicroseconds();
+		for (int i = data.m_frameStart[frame]; i < data.m_frameStart[frame + 1]; i += 2)
+		{
+			int a = data.m_frames[i];
+			btBroadphaseProxy* proxy1 = data.m_proxies[data.m_frames[i + 1]];
+			if (a < 0)
+			{
+				cache.removeOverlappingPair(data.m_proxies[-1 - a], proxy1, NULL);
+			}
+			else
+			{
+				cache.addOverlappingPair(data.m_proxies[a], proxy1);
+			}
+		}
+		if (frame > 0)
+		{
+			time += clock.getTimeMicroseconds() - start;
+		}
+	}
+	numPairs = cache.getNumOverlappingPairs();
+	return time;
+}
+
+static void runConcurrent(const PairCacheBenchmarkData& data, unsigned long long& concurrentTime, unsigned long long& flushTime, int& numPairs)
+{
+	btHashedOverlappingPairCacheMt cache;
+	btClock clock;
+	concurrentTime = 0;
+	flushTime = 0;
+	for (int frame = 0; frame + 1 < data.m_frameStart.size(); ++frame)
+	{
+		int begin = data.m_frameStart[frame];
+		int count = (data.m_frameStart[frame + 1] - begin) / 2;
+		unsigned long long start = clock.getTimeMicroseconds();
+		PairCacheBenchmarkLoop loop(&cache, &data, begin);
+		btParallelFor(0, count, 256, loop);
+		unsigned long long mid = clock.getTimeMicroseconds();
+		cache.flushConcurrentPairs(NULL);
+		// the first frame fills the empty cache
+		if (frame > 0)
+		{
+			concurrentTime += mid - start;
+			flushTime += clock.getTimeMicroseconds() - mid;
+		}
+	}
+	numPairs = cache.getNumOverlappingPairs();
+}
+
+int runPairCacheBenchmark(int argc, char** argv)
+{
+	int numFrames = argc > 0 ? atoi(argv[0]) : 20;
+	int numPairs = argc > 1 ? atoi(argv[1]) : 200000;
+	int changePercent = argc > 2 ? atoi(argv[2]) : 5;
+	if (numFrames < 2)
+	{
+		numFrames = 2;
+	}
+
+	PairCacheBenchmarkData data(numPairs / 4, numPairs, numFrames, changePercent);
+	int serialPairs = 0;
+	unsigned long long serialTime = runSerial(data, serialPairs);
+
+	btITaskScheduler* scheduler = btCreateDefaultTaskScheduler();
+	if (scheduler == NULL)
+	{
+		printf("The default task scheduler is not available, build with BULLET2_MULTITHREADING.\n");
+		return 1;
+	}
+	btSetTaskScheduler(scheduler);
+
+	printf("%d frames, %d pairs, %d%% of them replaced every frame, max %d threads\n", numFrames, numPairs, changePercent, scheduler->getMaxNumThreads());
+	printf("%24s %8s %14s %14s %14s %10s %8s\n", "cache", "threads", "add ms/frame", "flush ms/frame", "total ms/frame", "speedup", "same");
+	printf("%24s %8d %14s %14s %14.3f %10.2f %8s\n", "btHashedOverlapping", 1, "", "", serialTime / (1000.0 * (numFrames - 1)), 1.0, "");
+	for (int numThreads = 1; numThreads <= 16; numThreads *= 2)
+	{
+		if (numThreads > scheduler->getMaxNumThreads())
+		{
+			break;
+		}
+		scheduler->setNumThreads(numThreads);
+		unsigned long long concurrentTime, flushTime;
+		int concurrentPairs = 0;
+		runConcurrent(data, concurrentTime, flushTime, concurrentPairs);
+		unsigned long long totalTime = concurrentTime + flushTime;
+		printf("%24s %8d %14.3f %14.3f %14.3f %10.2f %8s\n",
+			   "btHashedOverlappingMt",
+			   numThreads,
+			   concurrentTime / (1000.0 * (numFrames - 1)),
+			   flushTime / (1000.0 * (numFrames - 1)),
+			   totalTime / (1000.0 * (numFrames - 1)),
+			   totalTime ? double(serialTime) / totalTime : 0.0,
+			   concurrentPairs == serialPairs ? "yes" : "NO");
+	}
+	btSetTaskScheduler(btGetSequentialTaskScheduler());
+	delete scheduler;
+	return 0;
+}
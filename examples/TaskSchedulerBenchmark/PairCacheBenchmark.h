@@ -0,0 +1,7 @@
+#ifndef PAIR_CACHE_BENCHMARK_H
+#define PAIR_CACHE_BENCHMARK_H
+
+// times btHashedOverlappingPairCache against btHashedOverlappingPairCacheMt on 1 to 16 threads
+int runPairCacheBenchmark(int argc, char** argv);
+
+#endif  //PAIR_CACHE_BENCHMARK_H
@@ -0,0 +1,378 @@
+/*
+Bullet Continuous Collision Detection and Physics Library
+Copyright (c) 2003-2018 Erwin Coumans  https://bulletphysics.org
+
+This software is provided 'as-is', without any express or implied warranty.
+In no event will the authors be held liable for any damages arising from the use of this software.
+Permission is granted to anyone to use this software for any purpose,
+including commercial applications, and to alter it and redistribute it freely,
+subject to the following restrictions:
+
+1. The origin of this software must not be misrepresented; you must not claim that you wrote the original software. If you use this software in a product, an acknowledgment in the product documentation would be appreciated but is not required.
+2. Altered source versions must be plainly marked as such, and must not be misrepresented as being the original software.
+3. This notice may not be removed or altered from any source distribution.
+*/
+
+/// Sweep and prune and grid benchmark. The aabbs of every step are recorded or generated first, then replayed into each
+/// broadphase (setAabb of every box and calculateOverlappingPairs), so that all of them see the same motion:
+///   3000 boxes : the collapsing box stacks of BenchmarkDemo test 1, simulated with btDbvtBroadphase
+///   field      : boxes spread over a large area, a tenth of them moving a little every step
+///   explosion  : the same field where every box jumps to a new place every 30 steps
+///   granular   : a bed of small spheres that all shake a little every step, generated step by step
+/// btSapBroadphase and btGridBroadphase are run on 1 to 16 threads, next to btDbvtBroadphase and bt32BitAxisSweep3 (not
+/// on the granular scene).
+
+#include "SapBenchmark.h"
+#include "btBulletDynamicsCommon.h"
+#include "BulletCollision/BroadphaseCollision/btSapBroadphase.h"
+#include "BulletCollision/BroadphaseCollision/btGridBroadphase.h"
+#include "LinearMath/btThreads.h"
+#include "LinearMath/btQuickprof.h"
+#include <stdio.h>
+#include <stdlib.h>
+
+struct SapBenchmarkTrace
+{
+	const char* m_name;
+	int m_numBoxes;
+	btVector3 m_worldMin;
+	btVector3 m_worldMax;
+
+	SapBenchmarkTrace(const char* name) : m_name(name), m_numBoxes(0), m_worldMin(BT_LARGE_FLOAT, BT_LARGE_FLOAT, BT_LARGE_FLOAT), m_worldMax(-BT_LARGE_FLOAT, -BT_LARGE_FLOAT, -BT_LARGE_FLOAT)
+	{
+	}
+	virtual ~SapBenchmarkTrace()
+	{
+	}
+
+	virtual int getNumSteps() const = 0;
+	// min and max of every box at 'step'
+	virtual void getAabbs(int step, btAlignedObjectArray<btVector3>& aabbs) const = 0;
+};
+
+struct SapRecordedTrace : public SapBenchmarkTrace
+{
+	btAlignedObjectArray<btVector3> m_aabbs;  // min and max of every box, step after step
+
+	SapRecordedTrace(const char* name) : SapBenchmarkTrace(name)
+	{
+	}
+
+	virtual int getNumSteps() const
+	{
+		return m_numBoxes ? m_aabbs.size() / (2 * m_numBoxes) : 0;
+	}
+
+	virtual void getAabbs(int step, btAlignedObjectArray<btVector3>& aabbs) const
+	{
+		aabbs.resizeNoInitialize(2 * m_numBoxes);
+		for (int i = 0; i < 2 * m_numBoxes; ++i)
+		{
+			aabbs[i] = m_aabbs[2 * step * m_numBoxes + i];
+		}
+	}
+
+	void add(const btVector3& aabbMin, const btVector3& aabbMax)
+	{
+		m_aabbs.push_back(aabbMin);
+		m_aabbs.push_back(aabbMax);
+		m_worldMin.setMin(aabbMin);
+		m_worldMax.setMax(aabbMax);
+	}
+};
+
+// spheres of radius 0.05 on a loose lattice, 100 by 100 wide, each shaking by up to 0.01 around its place
+struct SapGranularTrace : public SapBenchmarkTrace
+{
+	int m_numSteps;
+	btAlignedObjectArray<btVector3> m_centers;
+
+	SapGranularTrace(int numSpheres, int numSteps) : SapBenchmarkTrace("granular"), m_numSteps(numSteps)
+	{
+		m_numBoxes = numSpheres;
+		const btScalar spacing = btScalar(0.105);
+		for (int i = 0; i < numSpheres; ++i)
+		{
+			btVector3 center(btScalar(i % 100), btScalar(i / 10000), btScalar((i / 100) % 100));
+			m_centers.push_back(center * spacing);
+		}
+		btVector3 margin(1, 1, 1);
+		m_worldMin = -margin;
+		m_worldMax = btVector3(100, btScalar(numSpheres / 10000 + 1), 100) * spacing + margin;
+	}
+
+	virtual int getNumSteps() const
+	{
+		return m_numSteps;
+	}
+
+	virtual void getAabbs(int step, btAlignedObjectArray<btVector3>& aabbs) const
+	{
+		aabbs.resizeNoInitialize(2 * m_numBoxes);
+		const btVector3 radius(btScalar(0.05), btScalar(0.05), btScalar(0.05));
+		for (int i = 0; i < m_numBoxes; ++i)
+		{
+			unsigned int seed = unsigned(i) * 2654435761u + unsigned(step) * 40503u;
+			btScalar r[3];
+			for (int k = 0; k < 3; ++k)
+			{
+				seed = seed * 1664525u + 1013904223u;
+				r[k] = btScalar(seed >> 8) / btScalar(1 << 24) - btScalar(0.5);
+			}
+			btVector3 center = m_centers[i] + btVector3(r[0], r[1], r[2]) * btScalar(0.02);
+			aabbs[2 * i] = center - radius;
+			aabbs[2 * i + 1] = center + radius;
+		}
+	}
+};
+
+// the stacks of BenchmarkDemo::createTest1 on a ground box
+static void recordBoxStacks(SapRecordedTrace& trace, int numSteps)
+{
+	btDefaultCollisionConstructionInfo cci;
+	cci.m_defaultMaxPersistentManifoldPoolSize = 80000;
+	cci.m_defaultMaxCollisionAlgorithmPoolSize = 80000;
+	btDefaultCollisionConfiguration collisionConfiguration(cci);
+	btCollisionDispatcher dispatcher(&collisionConfiguration);
+	btDbvtBroadphase broadphase;
+	btSequentialImpulseConstraintSolver solver;
+	btDiscreteDynamicsWorld world(&dispatcher, &broadphase, &solver, &collisionConfiguration);
+	world.setGravity(btVector3(0, -10, 0));
+	world.getSolverInfo().m_numIterations = 5;
+
+	btBoxShape groundShape(btVector3(250, 50, 250));
+	const btScalar cubeSize = 1.0f;
+	btBoxShape boxShape(btVector3(cubeSize - btScalar(0.04), cubeSize - btScalar(0.04), cubeSize - btScalar(0.04)));
+	btAlignedObjectArray<btRigidBody*> bodies;
+	btTransform transform;
+	transform.setIdentity();
+	transform.setOrigin(btVector3(0, -50, 0));
+	bodies.push_back(new btRigidBody(0, NULL, &groundShape));
+	bodies[0]->setWorldTransform(transform);
+
+	int size = 8;
+	btScalar spacing = cubeSize;
+	btVector3 pos(0.0f, cubeSize * 2, 0.f);
+	btScalar offset = -size * (cubeSize * 2.0f + spacing) * 0.5f;
+	btVector3 localInertia;
+	boxShape.calculateLocalInertia(2, localInertia);
+	for (int k = 0; k < 47; k++)
+	{
+		for (int j = 0; j < size; j++)
+		{
+			pos[2] = offset + btScalar(j) * (cubeSize * 2.0f + spacing);
+			for (int i = 0; i < size; i++)
+			{
+				pos[0] = offset + btScalar(i) * (cubeSize * 2.0f + spacing);
+				transform.setOrigin(pos);
+				btRigidBody* body = new btRigidBody(2, NULL, &boxShape, localInertia);
+				body->setWorldTransform(transform);
+				bodies.push_back(body);
+			}
+		}
+		offset -= btScalar(0.05) * spacing * (size - 1);
+		pos[1] += (cubeSize * 2.0f + spacing);
+	}
+	for (int i = 0; i < bodies.size(); ++i)
+	{
+		world.addRigidBody(bodies[i]);
+	}
+
+	trace.m_numBoxes = bodies.size();
+	for (int step = 0; step < numSteps; ++step)
+	{
+		world.stepSimulation(btScalar(1. / 60.), 0, btScalar(1. / 60.));
+		// the dispatcher keeps a copy of every manifold that collided during the step
+		dispatcher.ClearManifoldsCache();
+		for (int i = 0; i < bodies.size(); ++i)
+		{
+			btBroadphaseProxy* proxy = bodies[i]->getBroadphaseHandle();
+			trace.add(proxy->m_aabbMin, proxy->m_aabbMax);
+		}
+	}
+	for (int i = 0; i < bodies.size(); ++i)
+	{
+		world.removeRigidBody(bodies[i]);
+		delete bodies[i];
+	}
+}
+
+// boxes over a field, a tenth of them moving a little every step, and all of them jumping every 'burstInterval' steps
+static void recordField(SapRecordedTrace& trace, int numBoxes, int numSteps, int burstInterval)
+{
+	unsigned int seed = 1;
+	btScalar extent = btSqrt(btScalar(numBoxes)) * btScalar(2.5);
+	btAlignedObjectArray<btVector3> centers;
+	trace.m_numBoxes = numBoxes;
+	for (int step = 0; step < numSteps; ++step)
+	{
+		const bool burst = (step == 0) || (burstInterval > 0 && step % burstInterval == 0);
+		for (int i = 0; i < numBoxes; ++i)
+		{
+			btScalar r[3];
+			for (int k = 0; k < 3; ++k)
+			{
+				seed = seed * 1664525u + 1013904223u;
+				r[k] = btScalar(seed >> 8) / btScalar(1 << 24);
+			}
+			if (burst)
+			{
+				btVector3 center(r[0] * extent, r[1] * 10, r[2] * extent);
+				if (step == 0)
+				{
+					centers.push_back(center);
+				}
+				centers[i] = center;
+			}
+			else if ((i % 10) == step % 10)
+			{
+				centers[i] += btVector3(r[0] - btScalar(0.5), r[1] - btScalar(0.5), r[2] - btScalar(0.5)) * btScalar(0.3);
+			}
+			btVector3 halfExtents(1, 1, 1);
+			trace.add(centers[i] - halfExtents, centers[i] + halfExtents);
+		}
+	}
+}
+
+struct ScalarLess
+{
+	bool operator()(btScalar a, btScalar b) const { return a < b; }
+};
+
+struct RemoveAllPairsCallback : public btOverlapCallback
+{
+	virtual bool processOverlap(btBroadphasePair& pair) { return true; }
+};
+
+// replays the trace into 'broadphase' and prints the mean and the 99th percentile of the step time
+static void replay(const SapBenchmarkTrace& trace, btBroadphaseInterface* broadphase, const char* name, int numThreads)
+{
+	btAlignedObjectArray<btVector3> aabbs;
+	trace.getAabbs(0, aabbs);
+	btAlignedObjectArray<btBroadphaseProxy*> proxies;
+	for (int i = 0; i < trace.m_numBoxes; ++i)
+	{
+		proxies.push_back(broadphase->createProxy(aabbs[2 * i], aabbs[2 * i + 1], BOX_SHAPE_PROXYTYPE, NULL, btBroadphaseProxy::DefaultFilter, btBroadphaseProxy::AllFilter, NULL));
+	}
+	broadphase->calculateOverlappingPairs(NULL);
+
+	btAlignedObjectArray<btScalar> times;
+	btScalar total = 0;
+	btClock clock;
+	for (int step = 1; step < trace.getNumSteps(); ++step)
+	{
+		trace.getAabbs(step, aabbs);
+		unsigned long long start = clock.getTimeNanoseconds();
+		for (int i = 0; i < trace.m_numBoxes; ++i)
+		{
+			broadphase->setAabb(proxies[i], aabbs[2 * i], aabbs[2 * i + 1], NULL);
+		}
+		broadphase->calculateOverlappingPairs(NULL);
+		btScalar time = btScalar(clock.getTimeNanoseconds() - start) / 1000;
+		times.push_back(time);
+		total += time;
+	}
+	times.quickSort(ScalarLess());
+	btScalar p99 = times.size() ? times[btMin(times.size() - 1, (times.size() * 99) / 100)] : 0;
+	printf("%12s %24s %8d %12.1f %12.1f %10d\n", trace.m_name, name, numThreads, times.size() ? total / times.size() : 0, p99,
+		   broadphase->getOverlappingPairCache()->getNumOverlappingPairs());
+
+	// the pairs go first, destroyProxy looks for the pairs of the proxy in the whole pair cache
+	RemoveAllPairsCallback removeAll;
+	broadphase->getOverlappingPairCache()->processAllOverlappingPairs(&removeAll, NULL);
+	for (int i = 0; i < proxies.size(); ++i)
+	{
+		broadphase->destroyProxy(proxies[i], NULL);
+	}
+}
+
+static void runTrace(const SapBenchmarkTrace& trace, btITaskScheduler* scheduler, bool runAxisSweep = true)
+{
+	{
+		btDbvtBroadphase broadphase;
+		replay(trace, &broadphase, "btDbvtBroadphase", 1);
+	}
+	if (runAxisSweep)
+	{
+		btVector3 margin(10, 10, 10);
+		bt32BitAxisSweep3 broadphase(trace.m_worldMin - margin, trace.m_worldMax + margin, trace.m_numBoxes + 2);
+		replay(trace, &broadphase, "bt32BitAxisSweep3", 1);
+	}
+	for (int numThreads = 1; numThreads <= 16; numThreads *= 2)
+	{
+		if (numThreads > scheduler->getMaxNumThreads())
+		{
+			break;
+		}
+		scheduler->setNumThreads(numThreads);
+		btSapBroadphase broadphase;
+		replay(trace, &broadphase, "btSapBroadphase", numThreads);
+		if (numThreads == 1)
+		{
+			printf("%12s %24s %8s %d rebuilds, %d incremental updates\n", "", "", "", broadphase.m_numRebuilds, broadphase.m_numIncrementalUpdates);
+		}
+	}
+	for (int numThreads = 1; numThreads <= 16; numThreads *= 2)
+	{
+		if (numThreads > scheduler->getMaxNumThreads())
+		{
+			break;
+		}
+		scheduler->setNumThreads(numThreads);
+		btGridBroadphase broadphase;
+		replay(trace, &broadphase, "btGridBroadphase", numThreads);
+		if (numThreads == 1)
+		{
+			printf("%12s %24s %8s cell size %g, %d cells\n", "", "", "", double(broadphase.m_gridCellSize), broadphase.getNumCells());
+		}
+	}
+	scheduler->setNumThreads(1);
+}
+
+int runSapBenchmark(int argc, char** argv)
+{
+	int numSteps = argc > 0 ? atoi(argv[0]) : 300;
+	int numFieldBoxes = argc > 1 ? atoi(argv[1]) : 20000;
+	int numSpheres = argc > 2 ? atoi(argv[2]) : 200000;
+	if (numSteps < 2)
+	{
+		numSteps = 2;
+	}
+
+	btITaskScheduler* scheduler = btCreateDefaultTaskScheduler();
+	if (scheduler == NULL)
+	{
+		printf("The default task scheduler is not available, build with BULLET2_MULTITHREADING.\n");
+		return 1;
+	}
+	btSetTaskScheduler(scheduler);
+	scheduler->setNumThreads(1);
+
+	printf("%d steps, %d field boxes, %d spheres, max %d threads\n", numSteps, numFieldBoxes, numSpheres, scheduler->getMaxNumThreads());
+	printf("%12s %24s %8s %12s %12s %10s\n", "scene", "broadphase", "threads", "us/step", "us p99", "pairs");
+	{
+		SapRecordedTrace trace("3000 boxes");
+		recordBoxStacks(trace, numSteps);
+		runTrace(trace, scheduler);
+	}
+	{
+		SapRecordedTrace trace("field");
+		recordField(trace, numFieldBoxes, numSteps, 0);
+		runTrace(trace, scheduler);
+	}
+	{
+		SapRecordedTrace trace("explosion");
+		recordField(trace, numFieldBoxes, numSteps, 30);
+		runTrace(trace, scheduler);
+	}
+	if (numSpheres > 0)
+	{
+		// every sphere moves every step, a tenth of the steps is enough, and the incremental updates of
+		// bt32BitAxisSweep3 take seconds per step with so many proxies crossing each other
+		SapGranularTrace trace(numSpheres, btMax(2, numSteps / 10));
+		runTrace(trace, scheduler, false);
+	}
+	btSetTaskScheduler(btGetSequentialTaskScheduler());
+	delete scheduler;
+	return 0;
+}
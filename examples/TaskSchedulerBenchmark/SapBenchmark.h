@@ -0,0 +1,7 @@
+#ifndef SAP_BENCHMARK_H
+#define SAP_BENCHMARK_H
+
+// btSapBroadphase and btGridBroadphase against btDbvtBroadphase and bt32BitAxisSweep3 on recorded box motion
+int runSapBenchmark(int argc, char** argv);
+
+#endif  //SAP_BENCHMARK_H
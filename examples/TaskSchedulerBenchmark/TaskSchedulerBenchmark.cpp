@@ -0,0 +1,256 @@
+/*
+Bullet Continuous Collision Detection and Physics Library
+Copyright (c) 2003-2018 Erwin Coumans  https://bulletphysics.org
+
+This software is provided 'as-is', without any express or implied warranty.
+In no event will the authors be held liable for any damages arising from the use of this software.
+Permission is granted to anyone to use this software for any purpose,
+including commercial applications, and to alter it and redistribute it freely,
+subject to the following restrictions:
+
+1. The origin of this software must not be misrepresented; you must not claim that you wrote the original software. If you use this software in a product, an acknowledgment in the product documentation would be appreciated but is not required.
+2. Altered source versions must be plainly marked as such, and must not be misrepresented as being the original software.
+3. This notice may not be removed or altered from any source distribution.
+*/
+
+/// Task scheduler benchmarks.
+///
+/// App_TaskSchedulerBenchmark [overhead] [steps] [sections per step] [serial us]
+/// Measures the overhead of a btParallelFor call with the default and the work stealing task schedulers.
+/// Each simulated step runs a few small parallel sections separated by serial work,
+/// like a physics step at a high control rate. The per-call time is reported for
+/// 1 to 64 threads (limited by the hardware) with the scheduler's wakeup settings:
+///   sleep    : fixed spin time, workers told to sleep after each step (the old behaviour)
+///   adaptive : adaptive spin time, workers told to sleep after each step
+///   keep hot : adaptive spin time, workers woken before each step and never told to sleep
+///
+/// App_TaskSchedulerBenchmark islands [steps] [pile bodies] [resting pairs]
+/// Times the island solve of btSimulationIslandManagerMt for every available task scheduler,
+/// see IslandBenchmark.cpp.
+///
+/// App_TaskSchedulerBenchmark boxbox [settle steps] [repeats]
+/// Compares the box-box detector one pair at a time with the batched separating axis tests, see BoxBoxBenchmark.cpp.
+///
+/// App_TaskSchedulerBenchmark contacts [steps] [settle steps]
+/// Solver iterations per second of btSequentialImpulseConstraintSolverMt for 1, 2, 4... threads,
+/// on the pyramid and Taru scenes of BenchmarkDemo, see ContactSolverBenchmark.cpp.
+///
+/// App_TaskSchedulerBenchmark batching [steps] [settle steps]
+/// Setup time and batch quality of the contact batches with the spatial grid and the incremental batching of
+/// btBatchedConstraints, on the same scenes.
+///
+/// App_TaskSchedulerBenchmark broadphase [steps] [boxes] [burst interval] [% dynamic updates]
+/// p50/p99 of the btDbvtBroadphase collide time and of its tree optimization and pair cleanup time, without and with
+/// an optimization budget, see BroadphaseBenchmark.cpp.
+///
+/// App_TaskSchedulerBenchmark paircache [frames] [pairs] [% replaced per frame]
+/// Pair updates per frame with btHashedOverlappingPairCache and with btHashedOverlappingPairCacheMt on 1 to 16 threads,
+/// see PairCacheBenchmark.cpp.
+///
+/// App_TaskSchedulerBenchmark sap [steps] [field boxes] [granular spheres]
+/// Step time of btSapBroadphase and btGridBroadphase on 1 to 16 threads, btDbvtBroadphase and bt32BitAxisSweep3 on the
+/// box stacks of BenchmarkDemo, on a field of boxes with and without explosions and on a bed of shaking spheres,
+/// see SapBenchmark.cpp.
+///
+/// App_TaskSchedulerBenchmark deformable [steps] [cubes]
+/// Krylov iterations per solve and step time of btDeformableBodySolver with the mass, block Jacobi, incomplete Cholesky
+/// and multigrid preconditioners on the VolumetricDeformable, LargeDeformation and Pinch scenes, see DeformableSolverBenchmark.cpp.
+
+#include "LinearMath/btThreads.h"
+#include "LinearMath/btQuickprof.h"
+#include "LinearMath/btAlignedObjectArray.h"
+#include "IslandBenchmark.h"
+#include "BoxBoxBenchmark.h"
+#include "ContactSolverBenchmark.h"
+#include "BroadphaseBenchmark.h"
+#include "PairCacheBenchmark.h"
+#include "SapBenchmark.h"
+#include "DeformableSolverBenchmark.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+struct BenchmarkBody : public btIParallelForBody
+{
+	btAlignedObjectArray<btScalar>* m_values;
+
+	virtual void forLoop(int iBegin, int iEnd) const
+	{
+		btAlignedObjectArray<btScalar>& values = *m_values;
+		for (int i = iBegin; i < iEnd; ++i)
+		{
+			values[i] = values[i] * btScalar(0.5) + btScalar(1);
+		}
+	}
+};
+
+enum BenchmarkMode
+{
+	kModeSleep,
+	kModeAdaptive,
+	kModeKeepHot,
+	kModeCount
+};
+
+static const char* sModeNames[kModeCount] = {"sleep", "adaptive", "keep hot"};
+
+static void busyWait(btClock& clock, unsigned long long microseconds)
+{
+	unsigned long long start = clock.getTimeMicroseconds();
+	while (clock.getTimeMicroseconds() - start < microseconds)
+	{
+	}
+}
+
+static void runBenchmark(btITaskScheduler* scheduler, int numThreads, BenchmarkMode mode, int numSteps, int sectionsPerStep, unsigned long long serialMicroseconds)
+{
+	scheduler->setNumThreads(numThreads);
+	if (mode == kModeSleep)
+	{
+		scheduler->setWorkerSpinTime(100, 100);
+	}
+	else
+	{
+		scheduler->setWorkerSpinTime(50, 2000);
+	}
+
+	btAlignedObjectArray<btScalar> values;
+	values.resize(numThreads * 64, btScalar(0));
+	BenchmarkBody body;
+	body.m_values = &values;
+	int grainSize = 64;
+
+	btClock clock;
+	// warm up, lets the adaptive spin time settle
+	for (int i = 0; i < 100; ++i)
+	{
+		btParallelFor(0, values.size(), grainSize, body);
+	}
+	scheduler->sleepWorkerThreadsHint();
+	scheduler->resetStats();
+
+	unsigned long long parallelTime = 0;
+	for (int iStep = 0; iStep < numSteps; ++iStep)
+	{
+		if (mode == kModeKeepHot)
+		{
+			scheduler->wakeWorkerThreadsHint();
+		}
+		for (int iSection = 0; iSection < sectionsPerStep; ++iSection)
+		{
+			busyWait(clock, serialMicroseconds);
+			unsigned long long start = clock.getTimeNanoseconds();
+			btParallelFor(0, values.size(), grainSize, body);
+			parallelTime += clock.getTimeNanoseconds() - start;
+		}
+		if (mode != kModeKeepHot)
+		{
+			scheduler->sleepWorkerThreadsHint();
+		}
+		// time between steps, 1 ms minus the serial work of the step
+		unsigned long long stepMicroseconds = serialMicroseconds * sectionsPerStep;
+		if (stepMicroseconds < 1000)
+		{
+			busyWait(clock, 1000 - stepMicroseconds);
+		}
+	}
+
+	btTaskSchedulerStats stats;
+	scheduler->getStats(stats);
+	int numCalls = numSteps * sectionsPerStep;
+	printf("%14s %8d %10s %14.2f %10llu %10llu %10llu %12.1f\n",
+		   scheduler->getName(),
+		   scheduler->getNumThreads(),
+		   sModeNames[mode],
+		   double(parallelTime) / (1000.0 * numCalls),
+		   stats.m_numWakeups,
+		   stats.m_numSpinHits,
+		   stats.m_numSleeps,
+		   double(stats.m_idleMicroseconds) / numSteps);
+	scheduler->sleepWorkerThreadsHint();
+}
+
+static int runOverheadBenchmark(int argc, char** argv)
+{
+	int numSteps = argc > 0 ? atoi(argv[0]) : 500;
+	int sectionsPerStep = argc > 1 ? atoi(argv[1]) : 8;
+	int serialMicroseconds = argc > 2 ? atoi(argv[2]) : 20;
+
+	btITaskScheduler* schedulers[2] = {btCreateDefaultTaskScheduler(), btCreateWorkStealingTaskScheduler()};
+	if (schedulers[0] == NULL)
+	{
+		printf("The default task scheduler is not available, build with BULLET2_MULTITHREADING.\n");
+		return 1;
+	}
+
+	printf("%d steps, %d parallel sections per step, %d us serial work between sections, max %d threads\n",
+		   numSteps, sectionsPerStep, serialMicroseconds, schedulers[0]->getMaxNumThreads());
+	printf("%14s %8s %10s %14s %10s %10s %10s %12s\n", "scheduler", "threads", "mode", "us/parallelFor", "wakeups", "spin hits", "sleeps", "idle us/step");
+
+	for (int iScheduler = 0; iScheduler < 2; ++iScheduler)
+	{
+		btITaskScheduler* scheduler = schedulers[iScheduler];
+		if (scheduler == NULL)
+		{
+			continue;
+		}
+		btSetTaskScheduler(scheduler);
+		for (int numThreads = 1; numThreads <= BT_MAX_THREAD_COUNT; numThreads *= 2)
+		{
+			if (numThreads > scheduler->getMaxNumThreads())
+			{
+				break;
+			}
+			for (int mode = 0; mode < kModeCount; ++mode)
+			{
+				runBenchmark(scheduler, numThreads, BenchmarkMode(mode), numSteps, sectionsPerStep, serialMicroseconds);
+			}
+		}
+		btSetTaskScheduler(btGetSequentialTaskScheduler());
+	}
+
+	delete schedulers[0];
+	delete schedulers[1];
+	return 0;
+}
+
+int main(int argc, char** argv)
+{
+	if (argc > 1 && strcmp(argv[1], "islands") == 0)
+	{
+		return runIslandBenchmark(argc - 2, argv + 2);
+	}
+	if (argc > 1 && strcmp(argv[1], "boxbox") == 0)
+	{
+		return runBoxBoxBenchmark(argc - 2, argv + 2);
+	}
+	if (argc > 1 && strcmp(argv[1], "contacts") == 0)
+	{
+		return runContactSolverBenchmark(argc - 2, argv + 2);
+	}
+	if (argc > 1 && strcmp(argv[1], "batching") == 0)
+	{
+		return runBatchingBenchmark(argc - 2, argv + 2);
+	}
+	if (argc > 1 && strcmp(argv[1], "broadphase") == 0)
+	{
+		return runBroadphaseBenchmark(argc - 2, argv + 2);
+	}
+	if (argc > 1 && strcmp(argv[1], "paircache") == 0)
+	{
+		return runPairCacheBenchmark(argc - 2, argv + 2);
+	}
+	if (argc > 1 && strcmp(argv[1], "sap") == 0)
+	{
+		return runSapBenchmark(argc - 2, argv + 2);
+	}
+	if (argc > 1 && strcmp(argv[1], "deformable") == 0)
+	{
+		return runDeformableSolverBenchmark(argc - 2, argv + 2);
+	}
+	if (argc > 1 && strcmp(argv[1], "overhead") == 0)
+	{
+		return runOverheadBenchmark(argc - 2, argv + 2);
+	}
+	return runOverheadBenchmark(argc - 1, argv + 1);
+}
@@ -0,0 +1,22 @@
+
+project "App_TaskSchedulerBenchmark"
+
+if _OPTIONS["ios"] then
+	kind "WindowedApp"
+else	
+	kind "ConsoleApp"
+end
+
+includedirs {"../../src"}
+
+links {
+	"BulletSoftBody", "BulletDynamics","BulletCollision", "LinearMath"
+}
+
+language "C++"
+
+files {
+	"**.cpp",
+	"**.h",
+}
+
@@ -251,6 +251,8 @@ sources = ["examples/pybullet/pybullet.c"]\
 +["src/BulletSoftBody/btSoftMultiBodyDynamicsWorld.cpp"]\
 +["src/BulletSoftBody/btSoftSoftCollisionAlgorithm.cpp"]\
 +["src/BulletSoftBody/btDeformableBackwardEulerObjective.cpp"]\
++["src/BulletSoftBody/btDeformableBlockMatrix.cpp"]\
++["src/BulletSoftBody/btPreconditioner.cpp"]\
 +["src/BulletSoftBody/btDeformableBodySolver.cpp"]\
 +["src/BulletSoftBody/btDeformableContactProjection.cpp"]\
 +["src/BulletSoftBody/btDeformableContactConstraint.cpp"]\
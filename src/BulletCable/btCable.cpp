@@ -15,12 +15,40 @@
 #include "BulletCollision/NarrowPhaseCollision/btGjkConvexCast.h"
 #include <BulletCollision/NarrowPhaseCollision/btGjkPairDetector.h>
 #include <tuple>
+#include <LinearMath/btThreads.h>
+#include <BulletCollision/CollisionDispatch/btCollisionObjectWrapper.h>
+#include "btCableSimd.h"
 
 
 
+// btParallelFor needs a BT_THREADSAFE build and a task scheduler, otherwise the loop runs inline
+static void btCableParallelFor(int iBegin, int iEnd, int grainSize, const btIParallelForBody& body)
+{
+#if BT_THREADSAFE
+	if (btGetTaskScheduler())
+	{
+		btParallelFor(iBegin, iEnd, grainSize, body);
+		return;
+	}
+#endif
+	body.forLoop(iBegin, iEnd);
+}
+
+static btScalar btCableParallelSum(int iBegin, int iEnd, int grainSize, const btIParallelSumBody& body)
+{
+#if BT_THREADSAFE
+	if (btGetTaskScheduler())
+	{
+		return btParallelSum(iBegin, iEnd, grainSize, body);
+	}
+#endif
+	return body.sumLoop(iBegin, iEnd);
+}
+
 btCable::btCable(btSoftBodyWorldInfo* worldInfo, btCollisionWorld* world, int node_count,int section_count, const btVector3* x, const btScalar* m) : btSoftBody(worldInfo, node_count, x, m)
 {
 	m_world = world;
+	m_cableModel = true;
 	m_solverSubStep = worldInfo->numIteration;
 	m_cpt = 0;
 
@@ -121,6 +149,7 @@ void setNodeBoundingBox(btVector3 mx, btVector3 mq, btScalar margin, btVector3*
 
 void btCable::solveConstraints()
 {
+	BT_PROFILE("btCable::solveConstraints");
 	int i, ni;
 	// SolveConstraint could be called more than once per frame
 	// To keep contact manifold during all these iteration we had to them a certain lifetime
@@ -222,6 +251,7 @@ void btCable::solveConstraints()
 
 	if (useCollision)
 	{
+		BT_PROFILE("btCable::collisionPairs");
 		btScalar marginNode = m_collisionMargin;
 		btScalar margin;
 		ni = m_nodes.size();
@@ -275,7 +305,11 @@ void btCable::solveConstraints()
 		
 
 		// NarrowPhase
-		if (potentialCollisionObjectListSize > 0)
+		if (potentialCollisionObjectListSize > 0 && m_useBroadphaseCache)
+		{
+			cachedBroadPhase(BroadPhaseOutput, &nodePairContact, &indexNodeContact);
+		}
+		else if (potentialCollisionObjectListSize > 0)
 		{
 			for (int i = 0; i < ni; i++)
 			{
@@ -352,28 +386,44 @@ void btCable::solveConstraints()
 	}
 
 	bool impacted = false;
-	for (int i = 0; i < m_cfg.piterations; ++i)
+	if (m_useCompactNodes && gatherCompactNodes())
+	{
+		impacted = solveConstraintsCompact(&nodePairContact, &indexNodeContact);
+	}
+	else
 	{
-		updateNodeDeltaPos(i);
+		BT_PROFILE("btCable::solveIterations");
+		// The sets are built from the link indices, they are only independent along a simple chain
+		const bool parallelLinks = m_useParallelLinks && linksFormChain();
+		for (int i = 0; i < m_cfg.piterations; ++i)
+		{
+			updateNodeDeltaPos(i);
 
-		impacted = anchorConstraint();
+			impacted = anchorConstraint();
 		
-		distanceConstraint();
+			if (parallelLinks)
+				distanceConstraintParallel();
+			else
+				distanceConstraint();
 		
-		if (useBending && i % 2 == 0)
-		{
-			bendingConstraintDistance();
-		}
+			if (useBending && i % 2 == 0)
+			{
+				bendingConstraintDistance();
+			}
 
-		if (useLRA)
-		{
-			LRAHierachique();
-			LRAConstraint();
-		}
+			if (useLRA)
+			{
+				if (parallelLinks)
+					LRAHierachiqueParallel();
+				else
+					LRAHierachique();
+				LRAConstraint();
+			}
 
-		if (useCollision && (i % m_substepDelayCollision == 0 || i == m_cfg.piterations - 1))
-		{
-			solveContact(&nodePairContact, &indexNodeContact);
+			if (useCollision && (i % m_substepDelayCollision == 0 || i == m_cfg.piterations - 1))
+			{
+				solveContact(&nodePairContact, &indexNodeContact);
+			}
 		}
 	}
 
@@ -480,6 +530,7 @@ void btCable::solveConstraints()
 
 void btCable::ResolveConflitZone(btAlignedObjectArray<NodePairNarrowPhase>* nodePairContact, btAlignedObjectArray<int>* indexNodeContact)
 {
+	BT_PROFILE("btCable::ResolveConflitZone");
 	Node* node;
 	int distSectorMax = 5;
 	Node* nodeAfter;
@@ -525,6 +576,7 @@ void btCable::ResolveConflitZone(btAlignedObjectArray<NodePairNarrowPhase>* node
 
 void btCable::updateLength(btScalar dt)
 {
+	BT_PROFILE("btCable::updateLength");
 	if (WantedSpeed > 0)
 	{
 		if (WantedDistance > 0)
@@ -545,51 +597,71 @@ void btCable::updateLength(btScalar dt)
 	}
 }
 
+// Nodes are independent, each one only reads the positions of its neighbours
+struct btCable::NodeDataLoop : public btIParallelForBody
+{
+	btCable* cable;
+	btScalar vc;
+
+	NodeDataLoop(btCable* c, btScalar v) : cable(c), vc(v) {}
+
+	void forLoop(int iBegin, int iEnd) const BT_OVERRIDE
+	{
+		for (int i = iBegin; i < iEnd; ++i)
+		{
+			cable->updateNodeData(i, vc);
+		}
+	}
+};
+
 void btCable::updateNodeData() 
 {
+	BT_PROFILE("btCable::updateNodeData");
 	const btScalar vc = m_sst.isdt * (1 - m_cfg.kDP);
 
-	int ni { m_nodes.size() };
-	for (int i = 0; i < ni; ++i)
-	{
-		
- 		Node& n = m_nodes[i];
-		n.m_v = (n.m_x - n.m_q) * vc;
-		n.m_f = btVector3(0, 0, 0);
+	NodeDataLoop loop(this, vc);
+	btCableParallelFor(0, m_nodes.size(), m_parallelLinksGrainSize, loop);
+}
 
-		// Update NodePos
-		m_nodePos[i].x = m_nodes[i].m_x.getX();
-		m_nodePos[i].y = m_nodes[i].m_x.getY();
-		m_nodePos[i].z = m_nodes[i].m_x.getZ();
+void btCable::updateNodeData(int i, btScalar vc)
+{
+	Node& n = m_nodes[i];
+	n.m_v = (n.m_x - n.m_q) * vc;
+	n.m_f = btVector3(0, 0, 0);
 
-		// Update NodeData
-		m_nodeData[i].velocity_x = m_nodes[i].m_v.getX();
-		m_nodeData[i].velocity_y = m_nodes[i].m_v.getY();
-		m_nodeData[i].velocity_z = m_nodes[i].m_v.getZ();
+	// Update NodePos
+	m_nodePos[i].x = m_nodes[i].m_x.getX();
+	m_nodePos[i].y = m_nodes[i].m_x.getY();
+	m_nodePos[i].z = m_nodes[i].m_x.getZ();
 
-		// Calculate Volume
-		float sizeElement = 0;
+	// Update NodeData
+	m_nodeData[i].velocity_x = m_nodes[i].m_v.getX();
+	m_nodeData[i].velocity_y = m_nodes[i].m_v.getY();
+	m_nodeData[i].velocity_z = m_nodes[i].m_v.getZ();
 
-		if (i == 0)
-		{
-			sizeElement = (m_nodes[i].m_x - m_nodes[i + 1].m_x).length();
-		}
-		else if (i == m_nodes.size() - 1)
-		{
-			sizeElement = (m_nodes[i].m_x - m_nodes[i - 1].m_x).length();
-		}
-		else
-		{
-			sizeElement = (m_nodes[i].m_x - m_nodes[i - 1].m_x).length();
-			sizeElement += (m_nodes[i].m_x - m_nodes[i + 1].m_x).length();
-		}
+	// Calculate Volume
+	float sizeElement = 0;
 
-		// Using a cylinder volume calculation and divide by 2
-		m_nodeData[i].volume = SIMD_PI * m_cableData->radius * m_cableData->radius * sizeElement * 0.5;
+	if (i == 0)
+	{
+		sizeElement = (m_nodes[i].m_x - m_nodes[i + 1].m_x).length();
 	}
+	else if (i == m_nodes.size() - 1)
+	{
+		sizeElement = (m_nodes[i].m_x - m_nodes[i - 1].m_x).length();
+	}
+	else
+	{
+		sizeElement = (m_nodes[i].m_x - m_nodes[i - 1].m_x).length();
+		sizeElement += (m_nodes[i].m_x - m_nodes[i + 1].m_x).length();
+	}
+
+	// Using a cylinder volume calculation and divide by 2
+	m_nodeData[i].volume = SIMD_PI * m_cableData->radius * m_cableData->radius * sizeElement * 0.5;
 }
 
 void btCable::UpdateManifoldBroadphase(btAlignedObjectArray<BroadPhasePair*> broadphasePair) {
+	BT_PROFILE("btCable::UpdateManifoldBroadphase");
 	int count = manifolds.size();
 	for (int i = 0; i < count; i++)
 	{
@@ -630,6 +702,7 @@ void btCable::updateNodeDeltaPos(int iteration)
 
 void btCable::clearManifoldContact()
 {
+	BT_PROFILE("btCable::clearManifoldContact");
 	int count = manifolds.size();
 	// Remove the body that have no contact point and lifeTime = 0
 	for (int i = 0; i < count; i++)
@@ -688,6 +761,258 @@ void btCable::recursiveBroadPhase(BroadPhasePair* obj, Node* n, btCompoundShape*
 }
 
 
+struct btCable::BroadPhaseCandidateSortPredicate
+{
+	bool operator()(const BroadPhaseCandidate& a, const BroadPhaseCandidate& b) const
+	{
+		if (a.node != b.node)
+			return a.node < b.node;
+		return a.target < b.target;
+	}
+};
+
+struct btCable::NodeTreeCollider : public btDbvt::ICollide
+{
+	btAlignedObjectArray<int>* nodes;
+
+	NodeTreeCollider(btAlignedObjectArray<int>* n) : nodes(n) {}
+
+	void Process(const btDbvtNode* leaf) BT_OVERRIDE
+	{
+		nodes->push_back(leaf->dataAsInt);
+	}
+};
+
+// Bounds of |velB - velA| <= |velA| + |velB| are rounded, the conservative boxes are grown by this much
+static const btScalar btCableBroadPhaseSlack = btScalar(1e-6);
+
+// Same traversal and transforms as recursiveBroadPhase, once per body instead of once per node
+void btCable::gatherBroadPhaseTargets(const BroadPhaseTarget& parent, btCompoundShape* shape, btTransform transformLocal)
+{
+	int subShapes = shape->getNumChildShapes();
+	for (int i = 0; i < subShapes; i++)
+	{
+		btCollisionShape* temp = shape->getChildShape(i);
+		if (temp->getShapeType() == COMPOUND_SHAPE_PROXYTYPE)
+		{
+			btCompoundShape* compound = (btCompoundShape*)temp;
+			btTransform newTransform = btTransform();
+			newTransform.mult(shape->getChildTransform(i), transformLocal);
+			gatherBroadPhaseTargets(parent, compound, newTransform);
+		}
+		else
+		{
+			BroadPhaseTarget target = parent;
+			target.shape = temp;
+			target.transform = shape->getChildTransform(i);
+			target.transform.mult(transformLocal, target.transform);
+			temp->getAabb(target.transform, target.mins, target.maxs);
+			target.childIndex = 0;
+			if (m_broadphaseTargets.size() > 0 && m_broadphaseTargets[m_broadphaseTargets.size() - 1].pairIndex == parent.pairIndex)
+				target.childIndex = m_broadphaseTargets[m_broadphaseTargets.size() - 1].childIndex + 1;
+			m_broadphaseTargets.push_back(target);
+		}
+	}
+}
+
+// Refit the node leaves whose box left their fat box, the other leaves are left untouched
+void btCable::updateNodeTree()
+{
+	const int numNodes = m_nodes.size();
+	if (m_nodeLeaves.size() != numNodes)
+	{
+		clearBroadphaseCache();
+		m_nodeLeaves.resize(numNodes, 0);
+		m_nodeMovedStep.resize(numNodes, -1);
+	}
+
+	// Nodes moving less than the sleeping threshold never touch the tree
+	const btScalar fatMargin = btMax(m_broadphaseFatMargin, m_collisionSleepingThreshold);
+	const btVector3 fat(fatMargin, fatMargin, fatMargin);
+
+	m_broadphaseStep++;
+	m_movedNodes.resize(0);
+	for (int i = 0; i < numNodes; ++i)
+	{
+		Node& n = m_nodes[i];
+		btVector3 velA = n.m_v * m_sst.sdt;
+		btScalar margin = m_collisionMargin + velA.length() + 0.05 + btCableBroadPhaseSlack;
+
+		btVector3 minLink, maxLink;
+		setNodeBoundingBox(n.m_x, n.m_q, margin, &minLink, &maxLink);
+		const btDbvtVolume volume = btDbvtVolume::FromMM(minLink, maxLink);
+
+		btDbvtNode*& leaf = m_nodeLeaves[i];
+		if (leaf && leaf->volume.Contain(volume))
+			continue;
+
+		btDbvtVolume fatVolume = btDbvtVolume::FromMM(minLink - fat, maxLink + fat);
+		if (leaf)
+		{
+			m_nodeTree.update(leaf, fatVolume);
+		}
+		else
+		{
+			leaf = m_nodeTree.insert(fatVolume, 0);
+			leaf->dataAsInt = i;
+		}
+		m_nodeMovedStep[i] = m_broadphaseStep;
+		m_movedNodes.push_back(i);
+	}
+	m_nodeTree.optimizeIncremental(1);
+}
+
+btCable::BroadPhaseCacheEntry& btCable::findBroadPhaseCacheEntry(btCollisionObject* body, const BroadPhaseTarget& target, int targetIndex)
+{
+	// Targets usually come in the same order every step
+	for (int i = targetIndex; i < m_broadphaseCache.size(); ++i)
+	{
+		BroadPhaseCacheEntry& entry = m_broadphaseCache[i];
+		if (entry.body == body && entry.shape == target.shape && entry.childIndex == target.childIndex)
+		{
+			if (i != targetIndex)
+				m_broadphaseCache.swap(i, targetIndex);
+			return m_broadphaseCache[targetIndex];
+		}
+	}
+
+	if (targetIndex == m_broadphaseCache.size())
+		m_broadphaseCache.expand();
+	BroadPhaseCacheEntry& entry = m_broadphaseCache[targetIndex];
+	entry.body = body;
+	entry.shape = target.shape;
+	entry.childIndex = target.childIndex;
+	entry.fatVolume = btDbvtVolume::FromMM(btVector3(1, 1, 1), btVector3(-1, -1, -1));
+	entry.nodes.resize(0);
+	return entry;
+}
+
+// Same node/body pairs, in the same order, as the per node traversal of solveConstraints
+void btCable::cachedBroadPhase(btAlignedObjectArray<BroadPhasePair*>& broadphasePair, btAlignedObjectArray<NodePairNarrowPhase>* nodePairContact, btAlignedObjectArray<int>* indexNodeContact)
+{
+	BT_PROFILE("btCable::cachedBroadPhase");
+	updateNodeTree();
+
+	m_broadphaseTargets.resize(0);
+	for (int j = 0; j < broadphasePair.size(); j++)
+	{
+		btCollisionObject* obj = broadphasePair[j]->body;
+		BroadPhaseTarget target = BroadPhaseTarget();
+		target.pairIndex = j;
+		target.childIndex = 0;
+		target.shape = obj->getCollisionShape();
+		target.transform = obj->getWorldTransform();
+		target.velocity = obj->getInterpolationLinearVelocity() * m_sst.sdt;
+		target.shapeMargin = 0;
+		if (obj->getCollisionShape()->getShapeType() != SPHERE_SHAPE_PROXYTYPE)
+			target.shapeMargin = obj->getCollisionShape()->getMargin();
+
+		if (obj->getCollisionShape()->getShapeType() == COMPOUND_SHAPE_PROXYTYPE)
+		{
+			gatherBroadPhaseTargets(target, (btCompoundShape*)obj->getCollisionShape(), btTransform(obj->getWorldTransform()));
+		}
+		else
+		{
+			obj->getCollisionShape()->getAabb(obj->getWorldTransform(), target.mins, target.maxs);
+			m_broadphaseTargets.push_back(target);
+		}
+	}
+
+	// When most of the cable moved, querying the tree is cheaper than testing every moved node
+	const bool incremental = m_movedNodes.size() * 4 <= m_nodes.size();
+	const btScalar fatMargin = btMax(m_broadphaseFatMargin, m_collisionSleepingThreshold);
+	const btVector3 fat(fatMargin, fatMargin, fatMargin);
+	const btScalar marginNode = m_collisionMargin;
+
+	m_broadphaseCandidates.resize(0);
+	for (int t = 0; t < m_broadphaseTargets.size(); ++t)
+	{
+		const BroadPhaseTarget& target = m_broadphaseTargets[t];
+		btCollisionObject* obj = broadphasePair[target.pairIndex]->body;
+		BroadPhaseCacheEntry& entry = findBroadPhaseCacheEntry(obj, target, t);
+
+		const btScalar bodyMargin = target.velocity.length() + target.shapeMargin + btCableBroadPhaseSlack;
+		const btVector3 grow(bodyMargin, bodyMargin, bodyMargin);
+		const btDbvtVolume volume = btDbvtVolume::FromMM(target.mins - grow, target.maxs + grow);
+
+		if (incremental && entry.fatVolume.Contain(volume))
+		{
+			// Only the nodes refitted this step can enter or leave the cached list
+			int count = 0;
+			for (int i = 0; i < entry.nodes.size(); ++i)
+			{
+				if (m_nodeMovedStep[entry.nodes[i]] != m_broadphaseStep)
+					entry.nodes[count++] = entry.nodes[i];
+			}
+			entry.nodes.resize(count);
+			for (int i = 0; i < m_movedNodes.size(); ++i)
+			{
+				if (Intersect(m_nodeLeaves[m_movedNodes[i]]->volume, entry.fatVolume))
+					entry.nodes.push_back(m_movedNodes[i]);
+			}
+		}
+		else
+		{
+			entry.fatVolume = btDbvtVolume::FromMM(volume.Mins() - fat, volume.Maxs() + fat);
+			entry.nodes.resize(0);
+			NodeTreeCollider collider(&entry.nodes);
+			m_nodeTree.collideTV(m_nodeTree.m_root, entry.fatVolume, collider);
+		}
+
+		// Exact test with the margin of the pair
+		for (int i = 0; i < entry.nodes.size(); ++i)
+		{
+			Node& n = m_nodes[entry.nodes[i]];
+			btVector3 velA = n.m_v * m_sst.sdt;
+			btScalar deltavelocity = (target.velocity - velA).length();
+			btScalar margin = marginNode + deltavelocity + 0.05;
+			margin += target.shapeMargin;
+
+			btVector3 minLink, maxLink;
+			setNodeBoundingBox(n.m_x, n.m_q, margin, &minLink, &maxLink);
+			if (minLink.x() <= target.maxs.x() && maxLink.x() >= target.mins.x() &&
+				minLink.y() <= target.maxs.y() && maxLink.y() >= target.mins.y() &&
+				minLink.z() <= target.maxs.z() && maxLink.z() >= target.mins.z())
+			{
+				BroadPhaseCandidate candidate;
+				candidate.node = entry.nodes[i];
+				candidate.target = t;
+				m_broadphaseCandidates.push_back(candidate);
+			}
+		}
+	}
+	m_broadphaseCache.resize(m_broadphaseTargets.size());
+
+	m_broadphaseCandidates.quickSort(BroadPhaseCandidateSortPredicate());
+	for (int i = 0; i < m_broadphaseCandidates.size(); ++i)
+	{
+		const BroadPhaseCandidate& candidate = m_broadphaseCandidates[i];
+		const BroadPhaseTarget& target = m_broadphaseTargets[candidate.target];
+		Node& n = m_nodes[candidate.node];
+
+		auto nodePair = NodePairNarrowPhase();
+		nodePair.worldToLocal = target.transform;
+		nodePair.pair = broadphasePair[target.pairIndex];
+		nodePair.collisionShape = target.shape;
+		nodePair.node = &n;
+		nodePair.node->m_nbCollidingObjectPotential++;
+		nodePair.m_Xout = PositionStartRayCalculation(&n, nodePair.pair->body);
+		nodePairContact->push_back(nodePair);
+
+		if (i + 1 == m_broadphaseCandidates.size() || m_broadphaseCandidates[i + 1].node != candidate.node)
+			indexNodeContact->push_back(n.index);
+	}
+}
+
+void btCable::clearBroadphaseCache()
+{
+	m_nodeTree.clear();
+	m_nodeLeaves.resize(0);
+	m_nodeMovedStep.resize(0);
+	m_movedNodes.resize(0);
+	m_broadphaseCache.resize(0);
+}
+
 // todo compute Velocity to move mq out of the box
 btVector3 btCable::PositionStartRayCalculation(Node *n, btCollisionObject * obj)
 {
@@ -842,16 +1167,22 @@ btScalar btCable::computeCollisionMargin(btCollisionShape* shape)
 	return margin;
 }
 
-btCollisionWorld::ClosestRayResultCallback btCable::castRay(btVector3 positionStart, btVector3 positionEnd, NodePairNarrowPhase* contact, btScalar margin)
+void btCable::computeRaySegment(const btVector3& positionStart, const btVector3& positionEnd, btVector3& rayFrom, btVector3& rayTo)
 {
 	btVector3 dir = positionStart - positionEnd;
 	btScalar len = dir.length();
 	dir = (positionEnd - positionStart) / len;
-	
+
 	// Correction depends on the link movement
 	btScalar distanceOut = 0.003;
-	btVector3 startRay = positionStart - dir * distanceOut;
-	btVector3 endRay = positionEnd;
+	rayFrom = positionStart - dir * distanceOut;
+	rayTo = positionEnd;
+}
+
+btCollisionWorld::ClosestRayResultCallback btCable::castRay(btVector3 positionStart, btVector3 positionEnd, NodePairNarrowPhase* contact, btScalar margin)
+{
+	btVector3 startRay, endRay;
+	computeRaySegment(positionStart, positionEnd, startRay, endRay);
 
 	btTransform m_rayFromTrans;
 	btTransform m_rayToTrans;
@@ -874,10 +1205,144 @@ btCollisionWorld::ClosestRayResultCallback btCable::castRay(btVector3 positionSt
 	
 }
 
+struct btCable::RayQuerySortPredicate
+{
+	const RayQuery* m_queries;
+
+	RayQuerySortPredicate(const RayQuery* queries) : m_queries(queries)
+	{
+	}
+
+	// Rays on the same body and shape end up next to each other
+	bool operator()(const int& a, const int& b) const
+	{
+		const NodePairNarrowPhase* ca = m_queries[a].contact;
+		const NodePairNarrowPhase* cb = m_queries[b].contact;
+		if (ca->pair->body != cb->pair->body)
+			return ca->pair->body < cb->pair->body;
+		if (ca->collisionShape != cb->collisionShape)
+			return ca->collisionShape < cb->collisionShape;
+		return a < b;
+	}
+};
+
+struct btCable::RayBatchLoop : public btIParallelForBody
+{
+	RayQuery* m_queries;
+	const int* m_order;
+
+	RayBatchLoop(RayQuery* queries, const int* order) : m_queries(queries), m_order(order)
+	{
+	}
+
+	void forLoop(int iBegin, int iEnd) const BT_OVERRIDE
+	{
+		// One proxy object per chunk, only the shape and the transform change between rays
+		btCollisionObject colObj;
+		const btCollisionShape* currentShape = 0;
+
+		btTransform rayFromTrans;
+		btTransform rayToTrans;
+		rayFromTrans.setIdentity();
+		rayToTrans.setIdentity();
+
+		for (int i = iBegin; i < iEnd; ++i)
+		{
+			RayQuery& query = m_queries[m_order[i]];
+			const NodePairNarrowPhase* contact = query.contact;
+
+			if (contact->collisionShape != currentShape)
+			{
+				currentShape = contact->collisionShape;
+				colObj.setCollisionShape(contact->collisionShape);
+			}
+			colObj.setWorldTransform(contact->worldToLocal);
+
+			rayFromTrans.setOrigin(query.rayFrom);
+			rayToTrans.setOrigin(query.rayTo);
+
+			btCollisionWorld::ClosestRayResultCallback resultCallback(query.rayFrom, query.rayTo);
+			btCollisionObjectWrapper colObjWrap(0, contact->collisionShape, &colObj, contact->worldToLocal, -1, -1);
+			btCollisionWorld::rayTestSingleInternal(rayFromTrans, rayToTrans, &colObjWrap, resultCallback, query.margin);
+
+			query.hasHit = resultCallback.hasHit();
+			if (query.hasHit)
+			{
+				query.hitPointWorld = resultCallback.m_hitPointWorld;
+				query.hitNormalWorld = resultCallback.m_hitNormalWorld;
+			}
+		}
+	}
+};
+
+// Collect the rays of one collision sub-iteration for the nodes in [limitLow, limitHigh)
+// The filtering is the same as the one done pair by pair in solveContact
+void btCable::gatherRayQueries(btAlignedObjectArray<NodePairNarrowPhase>* nodePairContact, int step, int limitLow, int limitHigh, bool skipSleepingNodes)
+{
+	m_rayQueries.resize(0);
+
+	int nbContactPairPotential = nodePairContact->size();
+	for (int i = 0; i < nbContactPairPotential; i++)
+	{
+		NodePairNarrowPhase* temp = &nodePairContact->at(i);
+		temp->hitInIteration = false;
+		Node* n = temp->node;
+
+		if (n->index < limitLow || n->index >= limitHigh)
+			continue;
+
+		// Update contact index for in the node structure
+		updateContactPos(n, i, step);
+
+		if (skipSleepingNodes && !n->computeNodeConstraint)
+			continue;
+
+		// Check if collision is possible
+		if (!checkCondition(n, step))
+			continue;
+
+		btVector3 positionStart = temp->m_Xout;
+		btVector3 positionEnd = n->m_x;
+
+		btScalar len = (positionEnd - positionStart).length();
+
+		if (btFuzzyZero(len) || len <= m_collisionSleepingThreshold)
+			continue;
+
+		RayQuery query;
+		query.contactIndex = i;
+		query.contact = temp;
+		// SphereShape margin is sphereShape Radius, not a safe margin
+		query.margin = computeCollisionMargin(temp->collisionShape);
+		query.hasHit = false;
+		computeRaySegment(positionStart, positionEnd, query.rayFrom, query.rayTo);
+		m_rayQueries.push_back(query);
+	}
+}
+
+void btCable::castRayBatch(btAlignedObjectArray<RayQuery>& queries)
+{
+	BT_PROFILE("btCable::castRayBatch");
+	int numQueries = queries.size();
+	if (numQueries == 0)
+		return;
+
+	m_rayQueryOrder.resize(numQueries);
+	for (int i = 0; i < numQueries; i++)
+	{
+		m_rayQueryOrder[i] = i;
+	}
+	m_rayQueryOrder.quickSort(RayQuerySortPredicate(&queries[0]));
+
+	RayBatchLoop rayLoop(&queries[0], &m_rayQueryOrder[0]);
+	btCableParallelFor(0, numQueries, m_rayBatchGrainSize, rayLoop);
+}
+
 // Resolve iteratively all the contact constraint
 // Do nbSubStep times the resolution to valid a good collision
 void btCable::solveContact(btAlignedObjectArray<NodePairNarrowPhase>* nodePairContact, btAlignedObjectArray<int>* indexNodeContact)
 {
+	BT_PROFILE("btCable::solveContact");
 	int nbSubStep = m_subIterationCollision;
 	int nbContactPairPotential = nodePairContact->size();
 	if (nbContactPairPotential == 0) return;
@@ -908,49 +1373,30 @@ void btCable::solveContact(btAlignedObjectArray<NodePairNarrowPhase>* nodePairCo
 		resetNormalAndHitPosition(indexNodeContact);
 
 		// Collision Resolution
-		for (int i = 0; i < nbContactPairPotential; i++)
+		// All the rays of the sub-iteration are cast in one batch, then resolved in contact order
+		gatherRayQueries(nodePairContact, j, 0, m_nodes.size(), true);
+		castRayBatch(m_rayQueries);
+		if (m_rayQueries.size() > 0)
+			shape = m_rayQueries[m_rayQueries.size() - 1].contact->collisionShape;
+
+		for (int q = 0; q < m_rayQueries.size(); q++)
 		{
-			NodePairNarrowPhase* temp = &nodePairContact->at(i);
-			temp->hitInIteration = false;
+			const RayQuery& query = m_rayQueries[q];
+			NodePairNarrowPhase* temp = query.contact;
 			n = temp->node;
-			
-			
-			// Update contact index for in the node structure
-			updateContactPos(n, i, j);
-
-			if (!n->computeNodeConstraint)
-				continue;
-
-			// Check if collision is possible
-			if (!checkCondition(n, j)) 
-				continue;
-			
 			obj = temp->pair->body;
-			shape = temp->collisionShape;
-			indexNode = n->index;
-			
-			// SphereShape margin is sphereShape Radius, not a safe margin
-			margin = computeCollisionMargin(shape);
-
+			margin = query.margin;
 			positionStart = temp->m_Xout;
-			positionEnd = n->m_x;
 
-			btScalar len = (positionEnd - positionStart).length();
-
-			if (btFuzzyZero(len) || len <= m_collisionSleepingThreshold)
-				continue;
-			
-			btCollisionWorld::ClosestRayResultCallback m_resultCallback = castRay(positionStart, positionEnd, temp, margin);
-			
-			if (m_resultCallback.hasHit())
+			if (query.hasHit)
 			{
  				n->collide = true;
 				if (n->topMargin < margin)
 					n->topMargin = margin;
-				
 
-				btVector3 contactPoint = m_resultCallback.m_hitPointWorld;
-				btVector3 normal = m_resultCallback.m_hitNormalWorld;
+
+				btVector3 contactPoint = query.hitPointWorld;
+				btVector3 normal = query.hitNormalWorld;
 				
 				btScalar distanceOut = 0.001;
 				btVector3 outMouvementPos = normal * distanceOut;
@@ -1099,6 +1545,7 @@ void btCable::solveContact(btAlignedObjectArray<NodePairNarrowPhase>* nodePairCo
 
 void btCable::solveContactLimited(btAlignedObjectArray<NodePairNarrowPhase>* nodePairContact, int limitLow, int limitHigh)
 {
+	BT_PROFILE("btCable::solveContactLimited");
 	int nbSubStep = m_subIterationCollision;
 	int nbContactPairPotential = nodePairContact->size();
 	if (nbContactPairPotential == 0) return;
@@ -1152,46 +1599,27 @@ void btCable::solveContactLimited(btAlignedObjectArray<NodePairNarrowPhase>* nod
 		}
 
 		// Collision Resolution
-		for (int i = 0; i < nbContactPairPotential; i++)
+		gatherRayQueries(nodePairContact, j, limitLow, limitHigh, false);
+		castRayBatch(m_rayQueries);
+		if (m_rayQueries.size() > 0)
+			shape = m_rayQueries[m_rayQueries.size() - 1].contact->collisionShape;
+
+		for (int q = 0; q < m_rayQueries.size(); q++)
 		{
-			NodePairNarrowPhase* temp = &nodePairContact->at(i);
-			temp->hitInIteration = false;
+			const RayQuery& query = m_rayQueries[q];
+			NodePairNarrowPhase* temp = query.contact;
 			n = temp->node;
+			margin = query.margin;
+			positionStart = temp->m_Xout;
 
-			if (n->index < limitLow || n->index >= limitHigh)
-				continue;
-			// Update contact index for in the node structure
-			updateContactPos(n, i, j);
+			if (query.hasHit)
+			{
+				n->collide = true;
+				if (n->topMargin < margin)
+					n->topMargin = margin;
 
-			// Check if collision is possible
-			if (!checkCondition(n, j))
-				continue;
-
-			obj = temp->pair->body;
-			shape = temp->collisionShape;
-			indexNode = n->index;
-
-			// SphereShape margin is sphereShape Radius, not a safe margin
-			margin = computeCollisionMargin(shape);
-
-			positionStart = temp->m_Xout;
-			positionEnd = n->m_x;
-
-			btScalar len = (positionEnd - positionStart).length();
-
-			if (btFuzzyZero(len) || len <= m_collisionSleepingThreshold)
-				continue;
-
-			btCollisionWorld::ClosestRayResultCallback m_resultCallback = castRay(positionStart, positionEnd, temp, margin);
-
-			if (m_resultCallback.hasHit())
-			{
-				n->collide = true;
-				if (n->topMargin < margin)
-					n->topMargin = margin;
-
-				btVector3 contactPoint = m_resultCallback.m_hitPointWorld;
-				btVector3 normal = m_resultCallback.m_hitNormalWorld;
+				btVector3 contactPoint = query.hitPointWorld;
+				btVector3 normal = query.hitNormalWorld;
 
 				btScalar distanceOut = 0.001;
 				btVector3 outMouvementPos = normal * distanceOut;
@@ -1390,6 +1818,7 @@ btVector3 btCable::calculateBodyImpulse(btRigidBody* obj, btScalar margin, Node*
 
 void btCable::LRAConstraint()
 {
+	BT_PROFILE("PSolve_LRA");
 	btScalar distance = 0;
 
 	Node& a = m_nodes[m_nodes.size() - 1];
@@ -1415,6 +1844,7 @@ void btCable::LRAConstraint()
 }
 
 void btCable::LRAHierachique() {
+	BT_PROFILE("PSolve_LRAHierachique");
 	int level = 2;
 	int size = m_nodes.size();
 	// iteration on node
@@ -1437,6 +1867,50 @@ void btCable::LRAHierachique() {
 }
 
 
+// Pair of nodes c-h and c+h with c in [h, size-h), pairs whose centers are 2h apart share a node,
+// so the centers are split in blocks of 2h and the even blocks are solved before the odd ones
+struct btCable::HierarchySetLoop : public btIParallelForBody
+{
+	btCable* cable;
+	int halfSpan;
+	int set;
+
+	HierarchySetLoop(btCable* c, int h, int s) : cable(c), halfSpan(h), set(s) {}
+
+	void forLoop(int iBegin, int iEnd) const BT_OVERRIDE
+	{
+		const int blockSize = 2 * halfSpan;
+		const int size = cable->m_nodes.size();
+		for (int block = iBegin; block < iEnd; ++block)
+		{
+			const int first = btMax((2 * block + set) * blockSize, halfSpan);
+			const int last = btMin((2 * block + set + 1) * blockSize, size - halfSpan);
+			for (int c = first; c < last; ++c)
+			{
+				cable->DistanceHierachy(c - halfSpan, c + halfSpan);
+			}
+		}
+	}
+};
+
+void btCable::LRAHierachiqueParallel()
+{
+	BT_PROFILE("PSolve_LRAHierachiqueParallel");
+
+	const int size = m_nodes.size();
+	for (int halfSpan = 1; halfSpan <= 2; ++halfSpan)
+	{
+		const int blockSize = 2 * halfSpan;
+		const int numBlocks = (size + blockSize - 1) / blockSize;
+		for (int set = 0; set < 2; ++set)
+		{
+			HierarchySetLoop loop(this, halfSpan, set);
+			const int grainSize = btMax(m_parallelLinksGrainSize / blockSize, 1);
+			btCableParallelFor(0, (numBlocks - set + 1) / 2, grainSize, loop);
+		}
+	}
+}
+
 // IndexMain is the node we treat
 void btCable::DistanceHierachy(int indexMain, int indexCheck)
 {
@@ -1530,6 +2004,7 @@ btVector3 btCable::fastTrigoPositionCompute(Node* n)
 
 void btCable::bendingConstraintDistance()
 {
+	BT_PROFILE("PSolve_Bending");
 	int size = m_nodes.size();
 	float stiffness = this->bendingStiffness;
 	float iterationFactor = stiffness * stiffness;
@@ -1610,38 +2085,68 @@ void btCable::distanceConstraint()
 {
 	BT_PROFILE("PSolve_Links");
 
-	Link* l;
-	Node* a;
-	Node* b;
 	for (int i = 0; i < m_links.size(); ++i)
 	{
-		l = &m_links[i];
-		a = l->m_n[0];
-		b = l->m_n[1];
-		if (!a->computeNodeConstraint && !b->computeNodeConstraint)
-			continue;
+		solveLink(m_links[i]);
+	}
+}
+
+void btCable::solveLink(Link& l)
+{
+	Node* a = l.m_n[0];
+	Node* b = l.m_n[1];
+	if (!a->computeNodeConstraint && !b->computeNodeConstraint)
+		return;
 
-		a->computeNodeConstraint = true;
-		b->computeNodeConstraint = true;
+	a->computeNodeConstraint = true;
+	b->computeNodeConstraint = true;
 
-		btVector3 AB = b->m_x - a->m_x;
-		
-		if (AB.fuzzyZero())
-		{
-			continue;
-		}
-		btVector3 ABNormalized = AB.normalized();
-		btScalar normAB = AB.length();
-		btScalar k = m_materials[0]->m_kLST;
+	btVector3 AB = b->m_x - a->m_x;
+	
+	if (AB.fuzzyZero())
+	{
+		return;
+	}
+	btVector3 ABNormalized = AB.normalized();
+	btScalar normAB = AB.length();
+	btScalar k = m_materials[0]->m_kLST;
 
-		btScalar sumInvMass = a->m_im + b->m_im;
-		if (sumInvMass >= SIMD_EPSILON)
+	btScalar sumInvMass = a->m_im + b->m_im;
+	if (sumInvMass >= SIMD_EPSILON)
+	{
+		btVector3 denom = 1 / sumInvMass * (normAB - l.m_rl) * ABNormalized;
+		a->m_x += (a->m_im * denom) * k;
+		b->m_x -= (b->m_im * denom) * k;
+	}
+}
+
+// Link 2k+set joins nodes 2k+set and 2k+set+1, links of the same set share no node
+struct btCable::LinkSetLoop : public btIParallelForBody
+{
+	btCable* cable;
+	int set;
+
+	LinkSetLoop(btCable* c, int s) : cable(c), set(s) {}
+
+	void forLoop(int iBegin, int iEnd) const BT_OVERRIDE
+	{
+		for (int k = iBegin; k < iEnd; ++k)
 		{
-			btVector3 denom = 1 / sumInvMass * (normAB - l->m_rl) * ABNormalized;
-			a->m_x += (a->m_im * denom) * k;
-			b->m_x -= (b->m_im * denom) * k;
+			cable->solveLink(cable->m_links[2 * k + set]);
 		}
 	}
+};
+
+void btCable::distanceConstraintParallel()
+{
+	BT_PROFILE("PSolve_LinksParallel");
+
+	const int numLinks = m_links.size();
+	for (int set = 0; set < 2; ++set)
+	{
+		LinkSetLoop loop(this, set);
+		btCableParallelFor(0, (numLinks - set + 1) / 2, m_parallelLinksGrainSize, loop);
+	}
 }
 
 void btCable::distanceConstraintLock(int limMin, int limMax)
@@ -1681,6 +2186,7 @@ void btCable::distanceConstraintLock(int limMin, int limMax)
 
 void btCable::predictMotion(btScalar dt)
 {
+	BT_PROFILE("btCable::predictMotion");
 	cableState = Valid;
 	int i, ni;
 
@@ -1742,6 +2248,7 @@ void btCable::predictMotion(btScalar dt)
 
 void btCable::Grows(float dt)
 {
+	BT_PROFILE("btCable::Grows");
 	btSoftRigidDynamicsWorld* world = (btSoftRigidDynamicsWorld*)m_world;
 	if (!world)
 		return;
@@ -1865,6 +2372,7 @@ void btCable::Grows(float dt)
 
 void btCable::Shrinks(float dt)
 {
+	BT_PROFILE("btCable::Shrinks");
 
 
 	int linkSize = m_links.size();
@@ -2014,6 +2522,624 @@ void btCable::setCollisionMode(int mode)
 
 #pragma endregion
 
+#pragma region Compact nodes
+
+// Runs a kernel over [begin, end), whole SIMD lanes first then the scalar tail
+template <class Kernel>
+static void btCableRunLanes(const Kernel& kernel, int begin, int end)
+{
+	int i = begin;
+	for (; i + int(btCableLaneSimd::Width) <= end; i += int(btCableLaneSimd::Width))
+	{
+		kernel.template run<btCableLaneSimd>(i);
+	}
+	for (; i < end; ++i)
+	{
+		kernel.template run<btCableLaneScalar>(i);
+	}
+}
+
+template <class Kernel>
+struct btCableKernelLoop : public btIParallelForBody
+{
+	const Kernel& kernel;
+
+	btCableKernelLoop(const Kernel& k) : kernel(k) {}
+
+	void forLoop(int iBegin, int iEnd) const BT_OVERRIDE
+	{
+		btCableRunLanes(kernel, iBegin, iEnd);
+	}
+};
+
+// Kernels write disjoint entries, so [begin, end) can be split across the workers
+template <class Kernel>
+static void btCableRunKernel(const Kernel& kernel, int begin, int end, bool parallel, int grainSize)
+{
+	if (parallel)
+	{
+		btCableKernelLoop<Kernel> loop(kernel);
+		btCableParallelFor(begin, end, grainSize, loop);
+	}
+	else
+	{
+		btCableRunLanes(kernel, begin, end);
+	}
+}
+
+// Link i joins node i and node i+1, the correction is written at i+1
+struct btCableLinkCorrectionKernel
+{
+	const btScalar* x[3];
+	const btScalar* invMass;
+	const btScalar* restLength;
+	const btScalar* color;
+	btScalar stiffness;
+	btScalar* correction[3];
+
+	template <class L>
+	SIMD_FORCE_INLINE void run(int i) const
+	{
+		typedef typename L::Lane Lane;
+		Lane d[3];
+		Lane len2 = L::splat(0);
+		for (int k = 0; k < 3; ++k)
+		{
+			d[k] = L::sub(L::load(x[k] + i + 1), L::load(x[k] + i));
+			len2 = L::add(len2, L::mul(d[k], d[k]));
+		}
+		const Lane len = L::sqrt(len2);
+		const Lane sumInvMass = L::add(L::load(invMass + i), L::load(invMass + i + 1));
+
+		typename L::Mask valid = L::maskAnd(L::greaterEqual(len2, L::splat(SIMD_EPSILON * SIMD_EPSILON)),
+											L::greaterEqual(sumInvMass, L::splat(SIMD_EPSILON)));
+		valid = L::maskAnd(valid, L::greater(L::load(color + i), L::splat(0)));
+
+		Lane f = L::div(L::mul(L::splat(stiffness), L::sub(len, L::load(restLength + i))), L::mul(sumInvMass, len));
+		f = L::select(valid, f, L::splat(0));
+		for (int k = 0; k < 3; ++k)
+		{
+			L::store(correction[k] + i + 1, L::mul(f, d[k]));
+		}
+	}
+};
+
+struct btCableLinkApplyKernel
+{
+	btScalar* x[3];
+	const btScalar* invMass;
+	const btScalar* correction[3];
+
+	template <class L>
+	SIMD_FORCE_INLINE void run(int j) const
+	{
+		const typename L::Lane im = L::load(invMass + j);
+		for (int k = 0; k < 3; ++k)
+		{
+			const typename L::Lane delta = L::sub(L::load(correction[k] + j + 1), L::load(correction[k] + j));
+			L::store(x[k] + j, L::add(L::load(x[k] + j), L::mul(im, delta)));
+		}
+	}
+};
+
+// Bending around node c, the corrections of nodes c-1, c and c+1 are written at c+1
+struct btCableBendingCorrectionKernel
+{
+	const btScalar* x[3];
+	const btScalar* invMass;
+	const btScalar* color;
+	const btScalar* scale;
+	btScalar stiffness;
+	btScalar iterationFactor;
+	btScalar* before[3];
+	btScalar* current[3];
+	btScalar* after[3];
+
+	template <class L>
+	SIMD_FORCE_INLINE void run(int c) const
+	{
+		typedef typename L::Lane Lane;
+		Lane b[3], m[3], a[3];
+		Lane delta1Len2 = L::splat(0), delta2Len2 = L::splat(0), rr = L::splat(0), d1 = L::splat(0), d2 = L::splat(0);
+		for (int k = 0; k < 3; ++k)
+		{
+			b[k] = L::load(x[k] + c - 1);
+			m[k] = L::load(x[k] + c);
+			a[k] = L::load(x[k] + c + 1);
+			const Lane delta1 = L::sub(m[k], b[k]);
+			const Lane delta2 = L::sub(a[k], m[k]);
+			const Lane r = L::sub(a[k], b[k]);
+			delta1Len2 = L::add(delta1Len2, L::mul(delta1, delta1));
+			delta2Len2 = L::add(delta2Len2, L::mul(delta2, delta2));
+			rr = L::add(rr, L::mul(r, r));
+			d1 = L::add(d1, L::mul(delta1, r));
+			d2 = L::add(d2, L::mul(delta2, r));
+		}
+		d1 = L::minv(L::maxv(d1, L::splat(0)), rr);
+		d2 = L::minv(L::maxv(d2, L::splat(0)), rr);
+		const Lane alpha1 = L::div(d2, rr);
+		const Lane alpha2 = L::div(d1, rr);
+
+		Lane d[3];
+		Lane dLen2 = L::splat(0);
+		for (int k = 0; k < 3; ++k)
+		{
+			d[k] = L::sub(L::add(L::mul(alpha1, b[k]), L::mul(alpha2, a[k])), m[k]);
+			dLen2 = L::add(dLen2, L::mul(d[k], d[k]));
+		}
+
+		const Lane imBefore = L::load(invMass + c - 1);
+		const Lane imCurrent = L::load(invMass + c);
+		const Lane imAfter = L::load(invMass + c + 1);
+		const Lane sum = L::add(L::add(L::mul(imBefore, L::mul(alpha1, alpha1)), imCurrent), L::mul(imAfter, L::mul(alpha2, alpha2)));
+
+		const Lane eps2 = L::splat(SIMD_EPSILON * SIMD_EPSILON);
+		typename L::Mask valid = L::maskAnd(L::greaterEqual(delta1Len2, eps2), L::greaterEqual(delta2Len2, eps2));
+		valid = L::maskAnd(valid, L::greaterEqual(dLen2, eps2));
+		valid = L::maskAnd(valid, L::greater(sum, L::splat(DBL_EPSILON)));
+		valid = L::maskAnd(valid, L::greater(L::load(color + c), L::splat(0)));
+
+		// impulse * dNorm simplifies to -stiffness * iterationFactor / sum * d
+		const Lane s = scale ? L::mul(L::load(scale + c), L::splat(stiffness)) : L::splat(stiffness);
+		Lane f = L::div(L::mul(s, L::splat(-iterationFactor)), sum);
+		f = L::select(valid, f, L::splat(0));
+		// Invalid lanes can hold NaN (rr == 0), the stores below select them out
+		const Lane fBefore = L::mul(imBefore, L::mul(f, alpha1));
+		const Lane fCurrent = L::mul(imCurrent, L::sub(L::splat(0), f));
+		const Lane fAfter = L::mul(imAfter, L::mul(f, alpha2));
+		for (int k = 0; k < 3; ++k)
+		{
+			L::store(before[k] + c + 1, L::select(valid, L::mul(fBefore, d[k]), L::splat(0)));
+			L::store(current[k] + c + 1, L::select(valid, L::mul(fCurrent, d[k]), L::splat(0)));
+			L::store(after[k] + c + 1, L::select(valid, L::mul(fAfter, d[k]), L::splat(0)));
+		}
+	}
+};
+
+struct btCableBendingApplyKernel
+{
+	btScalar* x[3];
+	const btScalar* before[3];
+	const btScalar* current[3];
+	const btScalar* after[3];
+
+	template <class L>
+	SIMD_FORCE_INLINE void run(int j) const
+	{
+		for (int k = 0; k < 3; ++k)
+		{
+			const typename L::Lane delta = L::add(L::add(L::load(before[k] + j + 2), L::load(current[k] + j + 1)), L::load(after[k] + j));
+			L::store(x[k] + j, L::add(L::load(x[k] + j), delta));
+		}
+	}
+};
+
+// Every node is kept within its rest distance along the cable to the last node
+struct btCableLRAKernel
+{
+	btScalar* x[3];
+	const btScalar* restPrefix;
+	btScalar totalRestLength;
+	btScalar root[3];
+
+	template <class L>
+	SIMD_FORCE_INLINE void run(int i) const
+	{
+		typedef typename L::Lane Lane;
+		Lane p[3], v[3];
+		Lane len2 = L::splat(0);
+		for (int k = 0; k < 3; ++k)
+		{
+			p[k] = L::load(x[k] + i);
+			v[k] = L::sub(p[k], L::splat(root[k]));
+			len2 = L::add(len2, L::mul(v[k], v[k]));
+		}
+		const Lane len = L::sqrt(len2);
+		const Lane maxDist = L::sub(L::splat(totalRestLength), L::load(restPrefix + i));
+		const typename L::Mask stretched = L::greater(len, maxDist);
+		const Lane f = L::div(maxDist, len);
+		for (int k = 0; k < 3; ++k)
+		{
+			const Lane clamped = L::add(L::splat(root[k]), L::mul(v[k], f));
+			L::store(x[k] + i, L::select(stretched, clamped, p[k]));
+		}
+	}
+};
+
+// Pair of nodes c-h and c+h, the correction is written at c+2
+struct btCableLRAPairCorrectionKernel
+{
+	const btScalar* x[3];
+	const btScalar* restPrefix;
+	const btScalar* color;
+	int h;
+	btScalar* correction[3];
+
+	template <class L>
+	SIMD_FORCE_INLINE void run(int c) const
+	{
+		typedef typename L::Lane Lane;
+		Lane d[3];
+		Lane dist2 = L::splat(0);
+		for (int k = 0; k < 3; ++k)
+		{
+			d[k] = L::sub(L::load(x[k] + c + h), L::load(x[k] + c - h));
+			dist2 = L::add(dist2, L::mul(d[k], d[k]));
+		}
+		const Lane dist = L::sqrt(dist2);
+		const Lane maxDist = L::sub(L::load(restPrefix + c + h), L::load(restPrefix + c - h));
+		const typename L::Mask valid = L::maskAnd(L::greater(dist, maxDist), L::greater(L::load(color + c), L::splat(0)));
+		Lane f = L::div(L::mul(L::splat(btScalar(0.5)), L::sub(dist, maxDist)), dist);
+		f = L::select(valid, f, L::splat(0));
+		for (int k = 0; k < 3; ++k)
+		{
+			L::store(correction[k] + c + 2, L::mul(f, d[k]));
+		}
+	}
+};
+
+struct btCableLRAPairApplyKernel
+{
+	btScalar* x[3];
+	const btScalar* correction[3];
+	int h;
+
+	template <class L>
+	SIMD_FORCE_INLINE void run(int j) const
+	{
+		for (int k = 0; k < 3; ++k)
+		{
+			const typename L::Lane delta = L::sub(L::load(correction[k] + j + h + 2), L::load(correction[k] + j - h + 2));
+			L::store(x[k] + j, L::add(L::load(x[k] + j), delta));
+		}
+	}
+};
+
+static void btCableSetColor(btAlignedObjectArray<btScalar>& color, int size, int period, int blockSize, int value)
+{
+	color.resize(size);
+	for (int i = 0; i < size; ++i)
+	{
+		color[i] = ((i / blockSize) % period) == value ? btScalar(1) : btScalar(0);
+	}
+}
+
+static void btCableSetZero(btAlignedObjectArray<btScalar>& array, int size)
+{
+	array.resize(size);
+	for (int i = 0; i < size; ++i)
+	{
+		array[i] = 0;
+	}
+}
+
+// True if link i joins node i and node i+1 for every link
+bool btCable::linksFormChain()
+{
+	const int numNodes = m_nodes.size();
+	const int numLinks = m_links.size();
+	if (numNodes < 2 || numLinks != numNodes - 1)
+		return false;
+	for (int i = 0; i < numLinks; ++i)
+	{
+		if (m_links[i].m_n[0] != &m_nodes[i] || m_links[i].m_n[1] != &m_nodes[i + 1])
+			return false;
+	}
+	return true;
+}
+
+// Copy the nodes into the compact arrays, returns false if the links are not a simple chain
+bool btCable::gatherCompactNodes()
+{
+	BT_PROFILE("btCable::gatherCompactNodes");
+	if (!linksFormChain())
+		return false;
+	const int numNodes = m_nodes.size();
+	const int numLinks = m_links.size();
+
+	CompactNodes& c = m_compact;
+	for (int k = 0; k < 3; ++k)
+	{
+		c.x[k].resize(numNodes);
+	}
+	c.invMass.resize(numNodes);
+	c.restPrefix.resize(numNodes);
+	c.restLength.resize(numLinks);
+
+	btScalar restPrefix = 0;
+	for (int i = 0; i < numNodes; ++i)
+	{
+		const Node& n = m_nodes[i];
+		c.x[0][i] = n.m_x.x();
+		c.x[1][i] = n.m_x.y();
+		c.x[2][i] = n.m_x.z();
+		c.invMass[i] = n.m_im;
+		c.restPrefix[i] = restPrefix;
+		if (i < numLinks)
+		{
+			c.restLength[i] = m_links[i].m_rl;
+			restPrefix += m_links[i].m_rl;
+		}
+	}
+
+	// The sets and the padded correction arrays only depend on the number of nodes
+	if (c.colorNodeCount != numNodes)
+	{
+		c.colorNodeCount = numNodes;
+		for (int color = 0; color < 2; ++color)
+		{
+			btCableSetColor(c.linkColor[color], numLinks, 2, 1, color);
+			btCableSetColor(c.lraColor[0][color], numNodes, 2, 2, color);
+			btCableSetColor(c.lraColor[1][color], numNodes, 2, 4, color);
+		}
+		for (int color = 0; color < 3; ++color)
+		{
+			btCableSetColor(c.bendingColor[color], numNodes, 3, 1, color);
+		}
+		for (int k = 0; k < 3; ++k)
+		{
+			btCableSetZero(c.linkCorrection[k], numLinks + 2);
+			for (int j = 0; j < 3; ++j)
+			{
+				btCableSetZero(c.bendingCorrection[j][k], numNodes + 2);
+			}
+			for (int level = 0; level < 2; ++level)
+			{
+				btCableSetZero(c.lraCorrection[level][k], numNodes + 4);
+			}
+		}
+		c.bendingScale.resize(numNodes, btScalar(1));
+	}
+
+	c.lastNodeAnchor = -1;
+	for (int i = 0; i < m_anchors.size(); ++i)
+	{
+		if (m_anchors[i].m_node->index == numNodes - 1)
+			c.lastNodeAnchor = i;
+	}
+	return true;
+}
+
+// Write the compact positions back into the nodes
+void btCable::scatterCompactNodes()
+{
+	BT_PROFILE("btCable::scatterCompactNodes");
+	const CompactNodes& c = m_compact;
+	for (int i = 0; i < m_nodes.size(); ++i)
+	{
+		m_nodes[i].m_x.setValue(c.x[0][i], c.x[1][i], c.x[2][i]);
+	}
+}
+
+void btCable::syncCompactAnchors(bool toCompact)
+{
+	CompactNodes& c = m_compact;
+	for (int i = 0; i < m_anchors.size(); ++i)
+	{
+		Node& n = *m_anchors[i].m_node;
+		const int index = n.index;
+		if (toCompact)
+		{
+			c.x[0][index] = n.m_x.x();
+			c.x[1][index] = n.m_x.y();
+			c.x[2][index] = n.m_x.z();
+		}
+		else
+		{
+			n.m_x.setValue(c.x[0][index], c.x[1][index], c.x[2][index]);
+		}
+	}
+}
+
+// Only the nodes close to a body go through the contact solver, the other ones stay compact
+void btCable::syncCompactContacts(btAlignedObjectArray<int>* indexNodeContact, bool toCompact)
+{
+	CompactNodes& c = m_compact;
+	for (int i = 0; i < indexNodeContact->size(); ++i)
+	{
+		const int index = indexNodeContact->at(i);
+		Node& n = m_nodes[index];
+		if (toCompact)
+		{
+			c.x[0][index] = n.m_x.x();
+			c.x[1][index] = n.m_x.y();
+			c.x[2][index] = n.m_x.z();
+		}
+		else
+		{
+			// The compact kernels never put a node to sleep
+			n.m_x.setValue(c.x[0][index], c.x[1][index], c.x[2][index]);
+			n.computeNodeConstraint = true;
+		}
+	}
+}
+
+bool btCable::solveConstraintsCompact(btAlignedObjectArray<NodePairNarrowPhase>* nodePairContact, btAlignedObjectArray<int>* indexNodeContact)
+{
+	BT_PROFILE("btCable::solveConstraintsCompact");
+	bool impacted = false;
+	for (int i = 0; i < m_cfg.piterations; ++i)
+	{
+		syncCompactAnchors(false);
+		impacted = anchorConstraint();
+		syncCompactAnchors(true);
+
+		distanceConstraintCompact();
+
+		if (useBending && i % 2 == 0)
+		{
+			bendingConstraintCompact();
+		}
+
+		if (useLRA)
+		{
+			LRAHierachiqueCompact();
+			LRAConstraintCompact();
+		}
+
+		if (useCollision && (i % m_substepDelayCollision == 0 || i == m_cfg.piterations - 1))
+		{
+			syncCompactContacts(indexNodeContact, false);
+			solveContact(nodePairContact, indexNodeContact);
+			syncCompactContacts(indexNodeContact, true);
+		}
+	}
+	scatterCompactNodes();
+	return impacted;
+}
+
+// Gauss-Seidel along the chain is serial, so the links are solved as two independent sets (even and odd)
+void btCable::distanceConstraintCompact()
+{
+	BT_PROFILE("PSolve_LinksCompact");
+	CompactNodes& c = m_compact;
+	const int numNodes = m_nodes.size();
+
+	btCableLinkCorrectionKernel correction;
+	btCableLinkApplyKernel apply;
+	for (int k = 0; k < 3; ++k)
+	{
+		correction.x[k] = &c.x[k][0];
+		correction.correction[k] = &c.linkCorrection[k][0];
+		apply.x[k] = &c.x[k][0];
+		apply.correction[k] = &c.linkCorrection[k][0];
+	}
+	correction.invMass = &c.invMass[0];
+	correction.restLength = &c.restLength[0];
+	correction.stiffness = m_materials[0]->m_kLST;
+	apply.invMass = &c.invMass[0];
+
+	for (int color = 0; color < 2; ++color)
+	{
+		correction.color = &c.linkColor[color][0];
+		btCableRunKernel(correction, 0, numNodes - 1, m_useParallelLinks, m_parallelLinksGrainSize);
+		btCableRunKernel(apply, 0, numNodes, m_useParallelLinks, m_parallelLinksGrainSize);
+	}
+}
+
+void btCable::bendingConstraintCompact()
+{
+	BT_PROFILE("PSolve_BendingCompact");
+	CompactNodes& c = m_compact;
+	const int numNodes = m_nodes.size();
+	if (numNodes < 3)
+		return;
+
+	btCableBendingCorrectionKernel correction;
+	btCableBendingApplyKernel apply;
+	for (int k = 0; k < 3; ++k)
+	{
+		correction.x[k] = &c.x[k][0];
+		correction.before[k] = &c.bendingCorrection[0][k][0];
+		correction.current[k] = &c.bendingCorrection[1][k][0];
+		correction.after[k] = &c.bendingCorrection[2][k][0];
+		apply.x[k] = &c.x[k][0];
+		apply.before[k] = &c.bendingCorrection[0][k][0];
+		apply.current[k] = &c.bendingCorrection[1][k][0];
+		apply.after[k] = &c.bendingCorrection[2][k][0];
+	}
+	correction.invMass = &c.invMass[0];
+	correction.stiffness = bendingStiffness;
+	correction.iterationFactor = bendingStiffness * bendingStiffness;
+	correction.scale = 0;
+
+	for (int color = 0; color < 3; ++color)
+	{
+		// Below maxAngle the stiffness is scaled by the bending angle, acos has no SIMD version
+		if (maxAngle != 0)
+		{
+			for (int i = 1; i < numNodes - 1; ++i)
+			{
+				if (c.bendingColor[color][i] == 0)
+					continue;
+				const btVector3 before(c.x[0][i - 1], c.x[1][i - 1], c.x[2][i - 1]);
+				const btVector3 current(c.x[0][i], c.x[1][i], c.x[2][i]);
+				const btVector3 after(c.x[0][i + 1], c.x[1][i + 1], c.x[2][i + 1]);
+				const btVector3 delta1 = current - before;
+				const btVector3 delta2 = after - current;
+				btScalar scale = 1;
+				if (!btFuzzyZero(delta1.length()) && !btFuzzyZero(delta2.length()))
+				{
+					btScalar dot = delta1.normalized().dot(delta2.normalized());
+					btClamp(dot, btScalar(-1), btScalar(1));
+					const btScalar phi = btAcos(dot);
+					if (phi <= maxAngle)
+						scale = phi / maxAngle;
+				}
+				c.bendingScale[i] = scale;
+			}
+			correction.scale = &c.bendingScale[0];
+		}
+
+		correction.color = &c.bendingColor[color][0];
+		btCableRunKernel(correction, 1, numNodes - 1, m_useParallelLinks, m_parallelLinksGrainSize);
+		btCableRunKernel(apply, 0, numNodes, m_useParallelLinks, m_parallelLinksGrainSize);
+	}
+}
+
+void btCable::LRAConstraintCompact()
+{
+	BT_PROFILE("PSolve_LRACompact");
+	CompactNodes& c = m_compact;
+	const int last = m_nodes.size() - 1;
+
+	if (c.lastNodeAnchor >= 0)
+	{
+		const Anchor& a = m_anchors[c.lastNodeAnchor];
+		const btVector3 p = a.m_c1 + a.m_body->getCenterOfMassPosition();
+		c.x[0][last] = p.x();
+		c.x[1][last] = p.y();
+		c.x[2][last] = p.z();
+	}
+
+	btCableLRAKernel lra;
+	for (int k = 0; k < 3; ++k)
+	{
+		lra.x[k] = &c.x[k][0];
+		lra.root[k] = c.x[k][last];
+	}
+	lra.restPrefix = &c.restPrefix[0];
+	lra.totalRestLength = c.restPrefix[last];
+	btCableRunKernel(lra, 0, last, m_useParallelLinks, m_parallelLinksGrainSize);
+}
+
+void btCable::LRAHierachiqueCompact()
+{
+	BT_PROFILE("PSolve_LRAHierachiqueCompact");
+	CompactNodes& c = m_compact;
+	const int numNodes = m_nodes.size();
+
+	for (int level = 0; level < 2; ++level)
+	{
+		// Pairs of nodes c-h and c+h, two pairs share a node when their centers are 2h apart
+		const int h = level + 1;
+		if (numNodes <= 2 * h)
+			break;
+
+		btCableLRAPairCorrectionKernel correction;
+		btCableLRAPairApplyKernel apply;
+		for (int k = 0; k < 3; ++k)
+		{
+			correction.x[k] = &c.x[k][0];
+			correction.correction[k] = &c.lraCorrection[level][k][0];
+			apply.x[k] = &c.x[k][0];
+			apply.correction[k] = &c.lraCorrection[level][k][0];
+		}
+		correction.restPrefix = &c.restPrefix[0];
+		correction.h = h;
+		apply.h = h;
+
+		for (int color = 0; color < 2; ++color)
+		{
+			correction.color = &c.lraColor[level][color][0];
+			btCableRunKernel(correction, h, numNodes - h, m_useParallelLinks, m_parallelLinksGrainSize);
+			btCableRunKernel(apply, 0, numNodes, m_useParallelLinks, m_parallelLinksGrainSize);
+		}
+	}
+}
+
+#pragma endregion
+
 #pragma region Getter/Setter
 
 btScalar btCable::getRestLength()
@@ -2024,12 +3150,25 @@ btScalar btCable::getRestLength()
 	return length;
 }
 
+struct btCable::LinkLengthSum : public btIParallelSumBody
+{
+	const btCable* cable;
+
+	LinkLengthSum(const btCable* c) : cable(c) {}
+
+	btScalar sumLoop(int iBegin, int iEnd) const BT_OVERRIDE
+	{
+		btScalar length = 0;
+		for (int i = iBegin; i < iEnd; ++i)
+			length += cable->m_links[i].m_n[0]->m_x.distance(cable->m_links[i].m_n[1]->m_x);
+		return length;
+	}
+};
+
 btScalar btCable::getLength()
 {
-	btScalar length = 0;
-	for (int i = 0; i < m_links.size(); ++i)
-		length += m_links[i].m_n[0]->m_x.distance(m_links[i].m_n[1]->m_x);
-	return length;
+	LinkLengthSum sum(this);
+	return btCableParallelSum(0, m_links.size(), m_parallelLinksGrainSize, sum);
 }
 
 btVector3 btCable::getTensionAt(int index)
@@ -2181,6 +3320,69 @@ void btCable::setCollisionParameters(int substepDelayCollision, int subIteration
 	m_collisionSleepingThreshold = collisionSleepingThreshold;
 }
 
+void btCable::setUseCompactNodes(bool active)
+{
+	m_useCompactNodes = active;
+}
+
+bool btCable::getUseCompactNodes()
+{
+	return m_useCompactNodes;
+}
+
+void btCable::setUseBroadphaseCache(bool active)
+{
+	m_useBroadphaseCache = active;
+	if (!active)
+		clearBroadphaseCache();
+}
+
+bool btCable::getUseBroadphaseCache()
+{
+	return m_useBroadphaseCache;
+}
+
+void btCable::setBroadphaseFatMargin(btScalar margin)
+{
+	m_broadphaseFatMargin = btMax(margin, btScalar(0));
+	clearBroadphaseCache();
+}
+
+btScalar btCable::getBroadphaseFatMargin()
+{
+	return m_broadphaseFatMargin;
+}
+
+void btCable::setUseParallelLinks(bool active)
+{
+	m_useParallelLinks = active;
+}
+
+bool btCable::getUseParallelLinks()
+{
+	return m_useParallelLinks;
+}
+
+void btCable::setParallelLinksGrainSize(int grainSize)
+{
+	m_parallelLinksGrainSize = btMax(grainSize, 1);
+}
+
+int btCable::getParallelLinksGrainSize()
+{
+	return m_parallelLinksGrainSize;
+}
+
+void btCable::setRayBatchGrainSize(int grainSize)
+{
+	m_rayBatchGrainSize = btMax(grainSize, 1);
+}
+
+int btCable::getRayBatchGrainSize()
+{
+	return m_rayBatchGrainSize;
+}
+
 void btCable::setCollisionMargin(float colMargin) {
 	this->m_collisionMargin = colMargin;
 }
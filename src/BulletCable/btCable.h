@@ -17,7 +17,6 @@
 #include <BulletCollision/CollisionShapes/btCompoundShape.h>
 #include <list>
 #include <vector>
-#include <omp.h>
 #include <iostream>
 
 #include "cubic_spline.hpp"
@@ -66,7 +65,23 @@ class btCable : public btSoftBody
 		bool hit = false;
 		bool hitInIteration = false;
 	};
-	
+
+	// One node-vs-shape ray of a batch, the result is written back in place
+	struct RayQuery
+	{
+		int contactIndex;
+		NodePairNarrowPhase* contact;
+		btVector3 rayFrom;
+		btVector3 rayTo;
+		btScalar margin;
+
+		bool hasHit;
+		btVector3 hitPointWorld;
+		btVector3 hitNormalWorld;
+	};
+	struct RayBatchLoop;
+	struct RayQuerySortPredicate;
+
 	enum class CollisionMode
 	{
 		Linear = 0,
@@ -165,6 +180,7 @@ private:
 	float m_collisionMargin = 0;
 
 	void distanceConstraint();
+	void solveLink(Link& l);
 	void distanceConstraintLock(int limMin, int limMax);
 	void LRAConstraint();
 	void LRAHierachique();
@@ -196,16 +212,121 @@ private:
 	btScalar computeCollisionMargin(btCollisionShape* shape);
 	btCollisionWorld::ClosestRayResultCallback castRay(btVector3 positionStart, btVector3 positionEnd, NodePairNarrowPhase* contact, btScalar margin);
 
+	// Batched ray queries, rays are grouped by target object and cast across the task scheduler workers
+	void computeRaySegment(const btVector3& positionStart, const btVector3& positionEnd, btVector3& rayFrom, btVector3& rayTo);
+	void gatherRayQueries(btAlignedObjectArray<NodePairNarrowPhase>* nodePairContact, int step, int limitLow, int limitHigh, bool skipSleepingNodes);
+	void castRayBatch(btAlignedObjectArray<RayQuery>& queries);
+	btAlignedObjectArray<RayQuery> m_rayQueries;
+	btAlignedObjectArray<int> m_rayQueryOrder;
+	int m_rayBatchGrainSize = 16;
+
 
 	void recursiveBroadPhase(BroadPhasePair* obj, Node* n, btCompoundShape* shape, btAlignedObjectArray<NodePairNarrowPhase>* nodePairContact, btVector3 minLink, btVector3 maxLink, btTransform transform);
 	//void recursiveBroadPhase(BroadPhasePair* obj, Node* n, Node* n1, btCompoundShape* shape, btAlignedObjectArray<NodePairNarrowPhase>* nodePairContact, btVector3 minLink, btVector3 maxLink, btTransform transform);
 
+	// Broadphase cache: a btDbvt over the fattened node boxes, updated only for the nodes leaving their fat box,
+	// and for each body (or compound child) the nodes whose fat box overlapped its own fat box at the last query
+	struct BroadPhaseTarget
+	{
+		int pairIndex;
+		int childIndex;
+		btCollisionShape* shape;
+		btTransform transform;
+		btVector3 mins;
+		btVector3 maxs;
+		btVector3 velocity;
+		btScalar shapeMargin;
+	};
+	struct BroadPhaseCacheEntry
+	{
+		btCollisionObject* body;
+		btCollisionShape* shape;
+		int childIndex;
+		btDbvtVolume fatVolume;
+		btAlignedObjectArray<int> nodes;
+	};
+	struct BroadPhaseCandidate
+	{
+		int node;
+		int target;
+	};
+	struct BroadPhaseCandidateSortPredicate;
+	struct NodeTreeCollider;
+	bool m_useBroadphaseCache = true;
+	btScalar m_broadphaseFatMargin = 0.05;
+	btDbvt m_nodeTree;
+	btAlignedObjectArray<btDbvtNode*> m_nodeLeaves;
+	btAlignedObjectArray<int> m_movedNodes;
+	btAlignedObjectArray<int> m_nodeMovedStep;
+	int m_broadphaseStep = 0;
+	btAlignedObjectArray<BroadPhaseTarget> m_broadphaseTargets;
+	btAlignedObjectArray<BroadPhaseCacheEntry> m_broadphaseCache;
+	btAlignedObjectArray<BroadPhaseCandidate> m_broadphaseCandidates;
+	void gatherBroadPhaseTargets(const BroadPhaseTarget& parent, btCompoundShape* shape, btTransform transformLocal);
+	void updateNodeTree();
+	BroadPhaseCacheEntry& findBroadPhaseCacheEntry(btCollisionObject* body, const BroadPhaseTarget& target, int targetIndex);
+	void cachedBroadPhase(btAlignedObjectArray<BroadPhasePair*>& broadphasePair, btAlignedObjectArray<NodePairNarrowPhase>* nodePairContact, btAlignedObjectArray<int>* indexNodeContact);
+	void clearBroadphaseCache();
+
 	void resetManifoldLifeTime();
 	void clearManifoldContact();
 	void UpdateManifoldBroadphase(btAlignedObjectArray<BroadPhasePair*> broadphasePair);
 
 	void updateNodeDeltaPos(int iteration);
 
+	// Compact mode: the solver iterations run on contiguous arrays mirrored from m_nodes.
+	// The previous positions m_q are not mirrored, they do not change during the iterations and are only read
+	// by anchorConstraint and solveContact, which run on m_nodes after the positions they use are synced back.
+	struct CompactNodes
+	{
+		// Node data
+		btAlignedObjectArray<btScalar> x[3];
+		btAlignedObjectArray<btScalar> invMass;
+		// restPrefix[k] is the rest length of the cable between node 0 and node k
+		btAlignedObjectArray<btScalar> restPrefix;
+		btAlignedObjectArray<btScalar> restLength;
+
+		// Independent sets, 1 for the constraints of the set and 0 elsewhere
+		btAlignedObjectArray<btScalar> linkColor[2];
+		btAlignedObjectArray<btScalar> bendingColor[3];
+		btAlignedObjectArray<btScalar> lraColor[2][2];
+		btAlignedObjectArray<btScalar> bendingScale;
+
+		// Position corrections of a set, padded with zeros at both ends
+		btAlignedObjectArray<btScalar> linkCorrection[3];
+		btAlignedObjectArray<btScalar> bendingCorrection[3][3];
+		btAlignedObjectArray<btScalar> lraCorrection[2][3];
+
+		int colorNodeCount = 0;
+		int lastNodeAnchor = -1;
+	};
+	bool m_useCompactNodes = false;
+	CompactNodes m_compact;
+
+	bool linksFormChain();
+	bool gatherCompactNodes();
+	void scatterCompactNodes();
+	void syncCompactAnchors(bool toCompact);
+	void syncCompactContacts(btAlignedObjectArray<int>* indexNodeContact, bool toCompact);
+	bool solveConstraintsCompact(btAlignedObjectArray<NodePairNarrowPhase>* nodePairContact, btAlignedObjectArray<int>* indexNodeContact);
+	void distanceConstraintCompact();
+	void bendingConstraintCompact();
+	void LRAConstraintCompact();
+	void LRAHierachiqueCompact();
+
+	// Parallel links mode: the even links and the odd links (and the hierarchical LRA pairs) form
+	// independent sets, each set is split across the task scheduler workers
+	struct LinkSetLoop;
+	struct HierarchySetLoop;
+	bool m_useParallelLinks = false;
+	int m_parallelLinksGrainSize = 128;
+	void distanceConstraintParallel();
+	void LRAHierachiqueParallel();
+
+	struct NodeDataLoop;
+	struct LinkLengthSum;
+	void updateNodeData(int index, btScalar vc);
+
 	btScalar getLinkRestLength(int index);
 
 public:
@@ -308,6 +429,22 @@ public:
 
 	void setCollisionParameters(int substepDelayCollision, int subIterationCollision, btScalar sleepingThreshold);
 
+	void setUseCompactNodes(bool active);
+	bool getUseCompactNodes();
+
+	void setUseBroadphaseCache(bool active);
+	bool getUseBroadphaseCache();
+	void setBroadphaseFatMargin(btScalar margin);
+	btScalar getBroadphaseFatMargin();
+
+	void setUseParallelLinks(bool active);
+	bool getUseParallelLinks();
+	void setParallelLinksGrainSize(int grainSize);
+	int getParallelLinksGrainSize();
+
+	void setRayBatchGrainSize(int grainSize);
+	int getRayBatchGrainSize();
+
     bool getUseHydroAero();
 	void setUseHydroAero(bool active);
 	
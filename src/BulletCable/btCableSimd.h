@@ -0,0 +1,160 @@
+#ifndef _BT_CABLE_SIMD_H
+#define _BT_CABLE_SIMD_H
+
+#include "LinearMath/btScalar.h"
+
+// Lanes used by the compact (structure of arrays) cable kernels.
+// btCableLaneSimd processes Width consecutive btScalar of a node array at once,
+// btCableLaneScalar has the same interface and is used for the array tails.
+// Loads and stores are unaligned, the node arrays can start anywhere.
+
+#if defined(__AVX__)
+#include <immintrin.h>
+#define BT_CABLE_SIMD_AVX
+#elif defined(__SSE2__) || defined(_M_X64) || defined(_M_AMD64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define BT_CABLE_SIMD_SSE
+#endif
+
+struct btCableLaneScalar
+{
+	typedef btScalar Lane;
+	typedef bool Mask;
+	enum
+	{
+		Width = 1
+	};
+
+	static SIMD_FORCE_INLINE Lane load(const btScalar* p) { return *p; }
+	static SIMD_FORCE_INLINE void store(btScalar* p, Lane v) { *p = v; }
+	static SIMD_FORCE_INLINE Lane splat(btScalar s) { return s; }
+	static SIMD_FORCE_INLINE Lane add(Lane a, Lane b) { return a + b; }
+	static SIMD_FORCE_INLINE Lane sub(Lane a, Lane b) { return a - b; }
+	static SIMD_FORCE_INLINE Lane mul(Lane a, Lane b) { return a * b; }
+	static SIMD_FORCE_INLINE Lane div(Lane a, Lane b) { return a / b; }
+	static SIMD_FORCE_INLINE Lane sqrt(Lane a) { return btSqrt(a); }
+	static SIMD_FORCE_INLINE Lane minv(Lane a, Lane b) { return a < b ? a : b; }
+	static SIMD_FORCE_INLINE Lane maxv(Lane a, Lane b) { return a > b ? a : b; }
+	static SIMD_FORCE_INLINE Mask greater(Lane a, Lane b) { return a > b; }
+	static SIMD_FORCE_INLINE Mask greaterEqual(Lane a, Lane b) { return a >= b; }
+	static SIMD_FORCE_INLINE Mask maskAnd(Mask a, Mask b) { return a && b; }
+	static SIMD_FORCE_INLINE Lane select(Mask m, Lane a, Lane b) { return m ? a : b; }
+};
+
+#if defined(BT_CABLE_SIMD_AVX) && defined(BT_USE_DOUBLE_PRECISION)
+
+struct btCableLaneSimd
+{
+	typedef __m256d Lane;
+	typedef __m256d Mask;
+	enum
+	{
+		Width = 4
+	};
+
+	static SIMD_FORCE_INLINE Lane load(const btScalar* p) { return _mm256_loadu_pd(p); }
+	static SIMD_FORCE_INLINE void store(btScalar* p, Lane v) { _mm256_storeu_pd(p, v); }
+	static SIMD_FORCE_INLINE Lane splat(btScalar s) { return _mm256_set1_pd(s); }
+	static SIMD_FORCE_INLINE Lane add(Lane a, Lane b) { return _mm256_add_pd(a, b); }
+	static SIMD_FORCE_INLINE Lane sub(Lane a, Lane b) { return _mm256_sub_pd(a, b); }
+	static SIMD_FORCE_INLINE Lane mul(Lane a, Lane b) { return _mm256_mul_pd(a, b); }
+	static SIMD_FORCE_INLINE Lane div(Lane a, Lane b) { return _mm256_div_pd(a, b); }
+	static SIMD_FORCE_INLINE Lane sqrt(Lane a) { return _mm256_sqrt_pd(a); }
+	static SIMD_FORCE_INLINE Lane minv(Lane a, Lane b) { return _mm256_min_pd(a, b); }
+	static SIMD_FORCE_INLINE Lane maxv(Lane a, Lane b) { return _mm256_max_pd(a, b); }
+	static SIMD_FORCE_INLINE Mask greater(Lane a, Lane b) { return _mm256_cmp_pd(a, b, _CMP_GT_OQ); }
+	static SIMD_FORCE_INLINE Mask greaterEqual(Lane a, Lane b) { return _mm256_cmp_pd(a, b, _CMP_GE_OQ); }
+	static SIMD_FORCE_INLINE Mask maskAnd(Mask a, Mask b) { return _mm256_and_pd(a, b); }
+	static SIMD_FORCE_INLINE Lane select(Mask m, Lane a, Lane b) { return _mm256_blendv_pd(b, a, m); }
+};
+
+#elif defined(BT_CABLE_SIMD_AVX)
+
+struct btCableLaneSimd
+{
+	typedef __m256 Lane;
+	typedef __m256 Mask;
+	enum
+	{
+		Width = 8
+	};
+
+	static SIMD_FORCE_INLINE Lane load(const btScalar* p) { return _mm256_loadu_ps(p); }
+	static SIMD_FORCE_INLINE void store(btScalar* p, Lane v) { _mm256_storeu_ps(p, v); }
+	static SIMD_FORCE_INLINE Lane splat(btScalar s) { return _mm256_set1_ps(s); }
+	static SIMD_FORCE_INLINE Lane add(Lane a, Lane b) { return _mm256_add_ps(a, b); }
+	static SIMD_FORCE_INLINE Lane sub(Lane a, Lane b) { return _mm256_sub_ps(a, b); }
+	static SIMD_FORCE_INLINE Lane mul(Lane a, Lane b) { return _mm256_mul_ps(a, b); }
+	static SIMD_FORCE_INLINE Lane div(Lane a, Lane b) { return _mm256_div_ps(a, b); }
+	static SIMD_FORCE_INLINE Lane sqrt(Lane a) { return _mm256_sqrt_ps(a); }
+	static SIMD_FORCE_INLINE Lane minv(Lane a, Lane b) { return _mm256_min_ps(a, b); }
+	static SIMD_FORCE_INLINE Lane maxv(Lane a, Lane b) { return _mm256_max_ps(a, b); }
+	static SIMD_FORCE_INLINE Mask greater(Lane a, Lane b) { return _mm256_cmp_ps(a, b, _CMP_GT_OQ); }
+	static SIMD_FORCE_INLINE Mask greaterEqual(Lane a, Lane b) { return _mm256_cmp_ps(a, b, _CMP_GE_OQ); }
+	static SIMD_FORCE_INLINE Mask maskAnd(Mask a, Mask b) { return _mm256_and_ps(a, b); }
+	static SIMD_FORCE_INLINE Lane select(Mask m, Lane a, Lane b) { return _mm256_blendv_ps(b, a, m); }
+};
+
+#elif defined(BT_CABLE_SIMD_SSE) && defined(BT_USE_DOUBLE_PRECISION)
+
+struct btCableLaneSimd
+{
+	typedef __m128d Lane;
+	typedef __m128d Mask;
+	enum
+	{
+		Width = 2
+	};
+
+	static SIMD_FORCE_INLINE Lane load(const btScalar* p) { return _mm_loadu_pd(p); }
+	static SIMD_FORCE_INLINE void store(btScalar* p, Lane v) { _mm_storeu_pd(p, v); }
+	static SIMD_FORCE_INLINE Lane splat(btScalar s) { return _mm_set1_pd(s); }
+	static SIMD_FORCE_INLINE Lane add(Lane a, Lane b) { return _mm_add_pd(a, b); }
+	static SIMD_FORCE_INLINE Lane sub(Lane a, Lane b) { return _mm_sub_pd(a, b); }
+	static SIMD_FORCE_INLINE Lane mul(Lane a, Lane b) { return _mm_mul_pd(a, b); }
+	static SIMD_FORCE_INLINE Lane div(Lane a, Lane b) { return _mm_div_pd(a, b); }
+	static SIMD_FORCE_INLINE Lane sqrt(Lane a) { return _mm_sqrt_pd(a); }
+	static SIMD_FORCE_INLINE Lane minv(Lane a, Lane b) { return _mm_min_pd(a, b); }
+	static SIMD_FORCE_INLINE Lane maxv(Lane a, Lane b) { return _mm_max_pd(a, b); }
+	static SIMD_FORCE_INLINE Mask greater(Lane a, Lane b) { return _mm_cmpgt_pd(a, b); }
+	static SIMD_FORCE_INLINE Mask greaterEqual(Lane a, Lane b) { return _mm_cmpge_pd(a, b); }
+	static SIMD_FORCE_INLINE Mask maskAnd(Mask a, Mask b) { return _mm_and_pd(a, b); }
+	static SIMD_FORCE_INLINE Lane select(Mask m, Lane a, Lane b) { return _mm_or_pd(_mm_and_pd(m, a), _mm_andnot_pd(m, b)); }
+};
+
+#elif defined(BT_CABLE_SIMD_SSE)
+
+struct btCableLaneSimd
+{
+	typedef __m128 Lane;
+	typedef __m128 Mask;
+	enum
+	{
+		Width = 4
+	};
+
+	static SIMD_FORCE_INLINE Lane load(const btScalar* p) { return _mm_loadu_ps(p); }
+	static SIMD_FORCE_INLINE void store(btScalar* p, Lane v) { _mm_storeu_ps(p, v); }
+	static SIMD_FORCE_INLINE Lane splat(btScalar s) { return _mm_set1_ps(s); }
+	static SIMD_FORCE_INLINE Lane add(Lane a, Lane b) { return _mm_add_ps(a, b); }
+	static SIMD_FORCE_INLINE Lane sub(Lane a, Lane b) { return _mm_sub_ps(a, b); }
+	static SIMD_FORCE_INLINE Lane mul(Lane a, Lane b) { return _mm_mul_ps(a, b); }
+	static SIMD_FORCE_INLINE Lane div(Lane a, Lane b) { return _mm_div_ps(a, b); }
+	static SIMD_FORCE_INLINE Lane sqrt(Lane a) { return _mm_sqrt_ps(a); }
+	static SIMD_FORCE_INLINE Lane minv(Lane a, Lane b) { return _mm_min_ps(a, b); }
+	static SIMD_FORCE_INLINE Lane maxv(Lane a, Lane b) { return _mm_max_ps(a, b); }
+	static SIMD_FORCE_INLINE Mask greater(Lane a, Lane b) { return _mm_cmpgt_ps(a, b); }
+	static SIMD_FORCE_INLINE Mask greaterEqual(Lane a, Lane b) { return _mm_cmpge_ps(a, b); }
+	static SIMD_FORCE_INLINE Mask maskAnd(Mask a, Mask b) { return _mm_and_ps(a, b); }
+	static SIMD_FORCE_INLINE Lane select(Mask m, Lane a, Lane b) { return _mm_or_ps(_mm_and_ps(m, a), _mm_andnot_ps(m, b)); }
+};
+
+#else
+
+struct btCableLaneSimd : public btCableLaneScalar
+{
+};
+
+#endif
+
+#endif  //_BT_CABLE_SIMD_H
@@ -0,0 +1,174 @@
+/*
+Bullet Continuous Collision Detection and Physics Library
+Copyright (c) 2003-2018 Erwin Coumans  https://bulletphysics.org
+
+This software is provided 'as-is', without any express or implied warranty.
+In no event will the authors be held liable for any damages arising from the use of this software.
+Permission is granted to anyone to use this software for any purpose,
+including commercial applications, and to alter it and redistribute it freely,
+subject to the following restrictions:
+
+1. The origin of this software must not be misrepresented; you must not claim that you wrote the original software. If you use this software in a product, an acknowledgment in the product documentation would be appreciated but is not required.
+2. Altered source versions must be plainly marked as such, and must not be misrepresented as being the original software.
+3. This notice may not be removed or altered from any source distribution.
+*/
+
+#include "btBroadphaseHandleTable.h"
+#include "btOverlappingPairCache.h"
+#include "LinearMath/btQuickprof.h"
+#include <float.h>
+#include <math.h>
+
+// float bounds that contain the btScalar bounds, the float tests of the broadphases then find every pair the exact test finds
+static SIMD_FORCE_INLINE float handleFloatDown(btScalar x)
+{
+#ifdef BT_USE_DOUBLE_PRECISION
+	float f = float(x);
+	return (btScalar(f) > x) ? nextafterf(f, -FLT_MAX) : f;
+#else
+	return x;
+#endif
+}
+
+static SIMD_FORCE_INLINE float handleFloatUp(btScalar x)
+{
+#ifdef BT_USE_DOUBLE_PRECISION
+	float f = float(x);
+	return (btScalar(f) < x) ? nextafterf(f, FLT_MAX) : f;
+#else
+	return x;
+#endif
+}
+
+// removes the pairs of proxies that moved and no longer overlap
+class btSeparatedHandlePairCallback : public btOverlapCallback
+{
+public:
+	const btBroadphaseHandleTable::HandleBounds* m_bounds;
+	int m_frame;
+
+	virtual bool processOverlap(btBroadphasePair& pair)
+	{
+		const btBroadphaseHandleProxy* proxy0 = static_cast<const btBroadphaseHandleProxy*>(pair.m_pProxy0);
+		const btBroadphaseHandleProxy* proxy1 = static_cast<const btBroadphaseHandleProxy*>(pair.m_pProxy1);
+		if (m_bounds[proxy0->m_handle].m_movedFrame != m_frame && m_bounds[proxy1->m_handle].m_movedFrame != m_frame)
+		{
+			return false;
+		}
+		return !btBroadphaseHandleTable::aabbOverlap(proxy0, proxy1);
+	}
+};
+
+btBroadphaseHandleTable::~btBroadphaseHandleTable()
+{
+	for (int i = 0; i < m_handles.size(); ++i)
+	{
+		if (m_handles[i])
+		{
+			m_handles[i]->~btBroadphaseHandleProxy();
+			btAlignedFree(m_handles[i]);
+		}
+	}
+}
+
+btBroadphaseHandleProxy* btBroadphaseHandleTable::createProxy(const btVector3& aabbMin, const btVector3& aabbMax, void* userPtr, int collisionFilterGroup, int collisionFilterMask, int frame)
+{
+	void* mem = btAlignedAlloc(sizeof(btBroadphaseHandleProxy), 16);
+	btBroadphaseHandleProxy* proxy = new (mem) btBroadphaseHandleProxy(aabbMin, aabbMax, userPtr, collisionFilterGroup, collisionFilterMask);
+	int handle;
+	if (m_freeHandles.size())
+	{
+		handle = m_freeHandles[m_freeHandles.size() - 1];
+		m_freeHandles.pop_back();
+		m_handles[handle] = proxy;
+	}
+	else
+	{
+		handle = m_handles.size();
+		m_handles.push_back(proxy);
+		m_handleBounds.expand().m_movedFrame = 0;
+	}
+	proxy->m_handle = handle;
+	proxy->m_uniqueId = handle + 2;
+	setHandleBounds(handle, aabbMin, aabbMax, frame);
+	return proxy;
+}
+
+void btBroadphaseHandleTable::destroyProxy(btBroadphaseHandleProxy* proxy)
+{
+	m_handles[proxy->m_handle] = 0;
+	m_pendingFreeHandles.push_back(proxy->m_handle);
+	proxy->~btBroadphaseHandleProxy();
+	btAlignedFree(proxy);
+}
+
+bool btBroadphaseHandleTable::setAabb(btBroadphaseHandleProxy* proxy, const btVector3& aabbMin, const btVector3& aabbMax, int frame)
+{
+	if (proxy->m_aabbMin == aabbMin && proxy->m_aabbMax == aabbMax)
+	{
+		return false;
+	}
+	proxy->m_aabbMin = aabbMin;
+	proxy->m_aabbMax = aabbMax;
+	return setHandleBounds(proxy->m_handle, aabbMin, aabbMax, frame);
+}
+
+bool btBroadphaseHandleTable::setHandleBounds(int handle, const btVector3& aabbMin, const btVector3& aabbMax, int frame)
+{
+	HandleBounds& bounds = m_handleBounds[handle];
+	for (int k = 0; k < 3; ++k)
+	{
+		bounds.m_min[k] = handleFloatDown(aabbMin[k]);
+		bounds.m_max[k] = handleFloatUp(aabbMax[k]);
+	}
+	if (bounds.m_movedFrame == frame)
+	{
+		return false;
+	}
+	bounds.m_movedFrame = frame;
+	return true;
+}
+
+void btBroadphaseHandleTable::releasePendingHandles()
+{
+	for (int i = 0; i < m_pendingFreeHandles.size(); ++i)
+	{
+		m_freeHandles.push_back(m_pendingFreeHandles[i]);
+	}
+	m_pendingFreeHandles.resize(0);
+}
+
+void btBroadphaseHandleTable::clear()
+{
+	btAssert(getNumProxies() == 0);
+	m_handles.clear();
+	m_handleBounds.clear();
+	m_freeHandles.clear();
+	m_pendingFreeHandles.clear();
+}
+
+void btBroadphaseHandleTable::removeSeparatedPairs(btOverlappingPairCache* pairCache, int frame, btDispatcher* dispatcher)
+{
+	BT_PROFILE("btBroadphaseHandleTable::removeSeparatedPairs");
+	btSeparatedHandlePairCallback callback;
+	callback.m_bounds = m_handleBounds.size() ? &m_handleBounds[0] : 0;
+	callback.m_frame = frame;
+	pairCache->processAllOverlappingPairs(&callback, dispatcher);
+}
+
+void btBroadphaseHandleTable::addBlockPairs(btOverlappingPairCache* pairCache, const btAlignedObjectArray<btAlignedObjectArray<btBroadphaseHandleProxy*> >& blockPairs, int numBlocks)
+{
+	const bool checkDuplicates = pairCache->hasDeferredRemoval();
+	for (int i = 0; i < numBlocks; ++i)
+	{
+		const btAlignedObjectArray<btBroadphaseHandleProxy*>& pairs = blockPairs[i];
+		for (int j = 0; j < pairs.size(); j += 2)
+		{
+			// btSortedOverlappingPairCache does not look for the pair itself
+			if (!checkDuplicates || !pairCache->findPair(pairs[j], pairs[j + 1]))
+			{
+				pairCache->addOverlappingPair(pairs[j], pairs[j + 1]);
+			}
+		}
+	}
+}
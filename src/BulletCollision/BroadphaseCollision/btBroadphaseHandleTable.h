@@ -0,0 +1,115 @@
+/*
+Bullet Continuous Collision Detection and Physics Library
+Copyright (c) 2003-2018 Erwin Coumans  https://bulletphysics.org
+
+This software is provided 'as-is', without any express or implied warranty.
+In no event will the authors be held liable for any damages arising from the use of this software.
+Permission is granted to anyone to use this software for any purpose,
+including commercial applications, and to alter it and redistribute it freely,
+subject to the following restrictions:
+
+1. The origin of this software must not be misrepresented; you must not claim that you wrote the original software. If you use this software in a product, an acknowledgment in the product documentation would be appreciated but is not required.
+2. Altered source versions must be plainly marked as such, and must not be misrepresented as being the original software.
+3. This notice may not be removed or altered from any source distribution.
+*/
+
+#ifndef BT_BROADPHASE_HANDLE_TABLE_H
+#define BT_BROADPHASE_HANDLE_TABLE_H
+
+#include "btBroadphaseProxy.h"
+#include "btHashedOverlappingPairCacheMt.h"
+#include "LinearMath/btAlignedObjectArray.h"
+
+struct btBroadphaseHandleProxy : public btBroadphaseProxy
+{
+	int m_handle;  // index in btBroadphaseHandleTable::m_handles
+
+	btBroadphaseHandleProxy(const btVector3& aabbMin, const btVector3& aabbMax, void* userPtr, int collisionFilterGroup, int collisionFilterMask)
+		: btBroadphaseProxy(aabbMin, aabbMax, userPtr, collisionFilterGroup, collisionFilterMask), m_handle(-1)
+	{
+	}
+};
+
+///The btBroadphaseHandleTable keeps the proxies of btSapBroadphase and btGridBroadphase by handle, with their aabbs as floats
+///next to each other so that the sorts of the broadphases do not visit the proxies.
+///The handle of a destroyed proxy stays pending until the broadphase dropped it from its sorted arrays in the next update,
+///only then it is reused.
+class btBroadphaseHandleTable
+{
+public:
+	// the aabb of a proxy as floats that contain it
+	struct HandleBounds
+	{
+		float m_min[3];
+		float m_max[3];
+		int m_movedFrame;  // frame of the last aabb change
+		int m_padding;
+	};
+
+	btAlignedObjectArray<btBroadphaseHandleProxy*> m_handles;  // NULL where a proxy was destroyed
+	btAlignedObjectArray<HandleBounds> m_handleBounds;
+	btAlignedObjectArray<int> m_freeHandles;
+	btAlignedObjectArray<int> m_pendingFreeHandles;  // destroyed since the last update
+
+	~btBroadphaseHandleTable();
+
+	btBroadphaseHandleProxy* createProxy(const btVector3& aabbMin, const btVector3& aabbMax, void* userPtr, int collisionFilterGroup, int collisionFilterMask, int frame);
+
+	///the pairs of the proxy have to be removed first
+	void destroyProxy(btBroadphaseHandleProxy* proxy);
+
+	///returns true when the proxy had not moved in 'frame' yet
+	bool setAabb(btBroadphaseHandleProxy* proxy, const btVector3& aabbMin, const btVector3& aabbMax, int frame);
+
+	///makes the handles destroyed since the last update free for reuse
+	void releasePendingHandles();
+
+	///empties the table, which must not hold proxies
+	void clear();
+
+	int getNumProxies() const
+	{
+		return m_handles.size() - m_freeHandles.size() - m_pendingFreeHandles.size();
+	}
+
+	///removes the pairs of the proxies that moved in 'frame' and no longer overlap
+	void removeSeparatedPairs(btOverlappingPairCache* pairCache, int frame, btDispatcher* dispatcher);
+
+	///adds the pairs that the tasks of an update collected when the pair cache is not concurrent, in block order
+	static void addBlockPairs(btOverlappingPairCache* pairCache, const btAlignedObjectArray<btAlignedObjectArray<btBroadphaseHandleProxy*> >& blockPairs, int numBlocks);
+
+	static bool aabbOverlap(const btBroadphaseProxy* proxy0, const btBroadphaseProxy* proxy1)
+	{
+		return proxy0->m_aabbMin[0] <= proxy1->m_aabbMax[0] && proxy1->m_aabbMin[0] <= proxy0->m_aabbMax[0] &&
+			   proxy0->m_aabbMin[1] <= proxy1->m_aabbMax[1] && proxy1->m_aabbMin[1] <= proxy0->m_aabbMax[1] &&
+			   proxy0->m_aabbMin[2] <= proxy1->m_aabbMax[2] && proxy1->m_aabbMin[2] <= proxy0->m_aabbMax[2];
+	}
+
+	///adds a pair found by a task of an update, whose float bounds overlap, to the concurrent pair cache or to the
+	///pairs of the task. Returns false when the exact bounds do not overlap.
+	static SIMD_FORCE_INLINE bool addPair(btHashedOverlappingPairCacheMt* cache, btBroadphaseHandleProxy* proxy0, btBroadphaseHandleProxy* proxy1, btAlignedObjectArray<btBroadphaseHandleProxy*>& pairs)
+	{
+#ifdef BT_USE_DOUBLE_PRECISION
+		// the float bounds are a little larger
+		if (!aabbOverlap(proxy0, proxy1))
+		{
+			return false;
+		}
+#endif
+		if (cache)
+		{
+			cache->addOverlappingPairConcurrent(proxy0, proxy1);
+		}
+		else
+		{
+			pairs.push_back(proxy0);
+			pairs.push_back(proxy1);
+		}
+		return true;
+	}
+
+protected:
+	bool setHandleBounds(int handle, const btVector3& aabbMin, const btVector3& aabbMax, int frame);
+};
+
+#endif  //BT_BROADPHASE_HANDLE_TABLE_H
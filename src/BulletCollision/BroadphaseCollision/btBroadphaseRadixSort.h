@@ -0,0 +1,159 @@
+/*
+Bullet Continuous Collision Detection and Physics Library
+Copyright (c) 2003-2018 Erwin Coumans  https://bulletphysics.org
+
+This software is provided 'as-is', without any express or implied warranty.
+In no event will the authors be held liable for any damages arising from the use of this software.
+Permission is granted to anyone to use this software for any purpose,
+including commercial applications, and to alter it and redistribute it freely,
+subject to the following restrictions:
+
+1. The origin of this software must not be misrepresented; you must not claim that you wrote the original software. If you use this software in a product, an acknowledgment in the product documentation would be appreciated but is not required.
+2. Altered source versions must be plainly marked as such, and must not be misrepresented as being the original software.
+3. This notice may not be removed or altered from any source distribution.
+*/
+
+#ifndef BT_BROADPHASE_RADIX_SORT_H
+#define BT_BROADPHASE_RADIX_SORT_H
+
+#include "LinearMath/btAlignedObjectArray.h"
+#include "LinearMath/btThreads.h"
+#include <string.h>
+
+static const int kBroadphaseRadixBits = 8;
+static const int kBroadphaseRadixSize = 1 << kBroadphaseRadixBits;
+static const int kBroadphaseRadixBlockSize = 2048;  // keys per task
+
+// btParallelFor needs a BT_THREADSAFE build and a task scheduler, otherwise the loop runs inline
+static inline void btBroadphaseParallelFor(int iBegin, int iEnd, const btIParallelForBody& body)
+{
+#if BT_THREADSAFE
+	if (btGetTaskScheduler())
+	{
+		btParallelFor(iBegin, iEnd, 1, body);
+		return;
+	}
+#endif
+	body.forLoop(iBegin, iEnd);
+}
+
+template <class SortKey>
+struct btBroadphaseRadixHistogramLoop : public btIParallelForBody
+{
+	const SortKey* m_keys;
+	int m_numKeys;
+	int m_shift;
+	int* m_counts;  // kBroadphaseRadixSize counts per block
+
+	void forLoop(int iBegin, int iEnd) const BT_OVERRIDE
+	{
+		for (int iBlock = iBegin; iBlock < iEnd; ++iBlock)
+		{
+			int* counts = &m_counts[iBlock * kBroadphaseRadixSize];
+			for (int iDigit = 0; iDigit < kBroadphaseRadixSize; ++iDigit)
+			{
+				counts[iDigit] = 0;
+			}
+			int iKeyEnd = btMin(m_numKeys, (iBlock + 1) * kBroadphaseRadixBlockSize);
+			for (int i = iBlock * kBroadphaseRadixBlockSize; i < iKeyEnd; ++i)
+			{
+				counts[int(m_keys[i].m_key >> m_shift) & (kBroadphaseRadixSize - 1)]++;
+			}
+		}
+	}
+};
+
+template <class SortKey>
+struct btBroadphaseRadixScatterLoop : public btIParallelForBody
+{
+	const SortKey* m_src;
+	SortKey* m_dest;
+	int m_numKeys;
+	int m_shift;
+	const int* m_offsets;  // kBroadphaseRadixSize offsets per block
+
+	void forLoop(int iBegin, int iEnd) const BT_OVERRIDE
+	{
+		int offsets[kBroadphaseRadixSize];
+		for (int iBlock = iBegin; iBlock < iEnd; ++iBlock)
+		{
+			for (int iDigit = 0; iDigit < kBroadphaseRadixSize; ++iDigit)
+			{
+				offsets[iDigit] = m_offsets[iBlock * kBroadphaseRadixSize + iDigit];
+			}
+			int iKeyEnd = btMin(m_numKeys, (iBlock + 1) * kBroadphaseRadixBlockSize);
+			for (int i = iBlock * kBroadphaseRadixBlockSize; i < iKeyEnd; ++i)
+			{
+				const SortKey& key = m_src[i];
+				m_dest[offsets[int(key.m_key >> m_shift) & (kBroadphaseRadixSize - 1)]++] = key;
+			}
+		}
+	}
+};
+
+///Stable sort of the keys of btSapBroadphase and btGridBroadphase by their unsigned integer m_key, in btParallelFor tasks.
+///The passes where all keys have the same digit are skipped.
+template <class SortKey>
+void btBroadphaseRadixSort(btAlignedObjectArray<SortKey>& keys, btAlignedObjectArray<SortKey>& sortBuffer, btAlignedObjectArray<int>& radixCounts)
+{
+	const int numKeys = keys.size();
+	if (numKeys < 2)
+	{
+		return;
+	}
+	const int keyBits = int(sizeof(keys[0].m_key)) * 8;
+	int numBlocks = (numKeys + kBroadphaseRadixBlockSize - 1) / kBroadphaseRadixBlockSize;
+	sortBuffer.resizeNoInitialize(numKeys);
+	radixCounts.resizeNoInitialize(numBlocks * kBroadphaseRadixSize);
+	int* counts = &radixCounts[0];
+	SortKey* src = &keys[0];
+	SortKey* dest = &sortBuffer[0];
+	for (int shift = 0; shift < keyBits; shift += kBroadphaseRadixBits)
+	{
+		btBroadphaseRadixHistogramLoop<SortKey> histogramLoop;
+		histogramLoop.m_keys = src;
+		histogramLoop.m_numKeys = numKeys;
+		histogramLoop.m_shift = shift;
+		histogramLoop.m_counts = counts;
+		btBroadphaseParallelFor(0, numBlocks, histogramLoop);
+
+		// turn the counts into offsets, digit major so that each block keeps its keys in order
+		int sum = 0;
+		bool trivial = false;
+		for (int iDigit = 0; iDigit < kBroadphaseRadixSize; ++iDigit)
+		{
+			int digitStart = sum;
+			for (int iBlock = 0; iBlock < numBlocks; ++iBlock)
+			{
+				int count = counts[iBlock * kBroadphaseRadixSize + iDigit];
+				counts[iBlock * kBroadphaseRadixSize + iDigit] = sum;
+				sum += count;
+			}
+			if (sum - digitStart == numKeys)
+			{
+				trivial = true;
+				break;
+			}
+		}
+		if (trivial)
+		{
+			continue;
+		}
+
+		btBroadphaseRadixScatterLoop<SortKey> scatterLoop;
+		scatterLoop.m_src = src;
+		scatterLoop.m_dest = dest;
+		scatterLoop.m_numKeys = numKeys;
+		scatterLoop.m_shift = shift;
+		scatterLoop.m_offsets = counts;
+		btBroadphaseParallelFor(0, numBlocks, scatterLoop);
+
+		btSwap(src, dest);
+	}
+	if (src != &keys[0])
+	{
+		memcpy(&keys[0], src, sizeof(SortKey) * numKeys);
+	}
+}
+
+#endif  //BT_BROADPHASE_RADIX_SORT_H
@@ -16,6 +16,7 @@ subject to the following restrictions:
 ///btDbvtBroadphase implementation by Nathanael Presson
 
 #include "btDbvtBroadphase.h"
+#include "btHashedOverlappingPairCacheMt.h"
 #include "LinearMath/btThreads.h"
 btScalar gDbvtMargin = btScalar(0.05);
 //
@@ -93,6 +94,47 @@ static inline void clear(T& value)
 	value = zerodummy;
 }
 
+//
+// Time budget
+//
+
+// optimization passes and cleanup tests run between two looks at the clock
+static const int optimizeSlice = 16;
+static const int cleanupSlice = 64;
+
+// number of work items of 'cost' microseconds that fit before 'end'
+static inline int budgetfit(btClock& clock, btScalar cost, unsigned long long end)
+{
+	const unsigned long long now = clock.getTimeNanoseconds();
+	if (now >= end) return (0);
+	return ((int)btMin<btScalar>(btScalar(end - now) / (cost * 1000), btScalar(1 << 30)));
+}
+
+// running average of the cost of one work item, small samples are mostly clock resolution and are ignored
+static inline void updatecost(btScalar& cost, unsigned long long nanoseconds, int count)
+{
+	if (count >= 8)
+	{
+		cost += (btScalar(nanoseconds) / (btScalar(1000) * count) - cost) * btScalar(0.125);
+		cost = btMax(cost, btScalar(0.001));
+	}
+}
+
+// runs up to 'passes' incremental optimization passes in slices, while the predicted cost fits before 'end'.
+// One pass always runs, so the tree keeps improving when the budget is used up.
+static inline int optimizebudgeted(btDbvt& tree, int passes, btClock& clock, btScalar cost, unsigned long long end)
+{
+	int done = 0;
+	while (tree.m_root && (done < passes))
+	{
+		const int count = btMin(btMin(passes - done, optimizeSlice), btMax(budgetfit(clock, cost, end), done ? 0 : 1));
+		if (count <= 0) break;
+		tree.optimizeIncremental(count);
+		done += count;
+	}
+	return (done);
+}
+
 //
 // Colliders
 //
@@ -123,6 +165,114 @@ struct btDbvtTreeCollider : btDbvt::ICollide
 	}
 };
 
+/* Pair collector of the parallel collide	*/
+struct btDbvtPairCollector : btDbvt::ICollide
+{
+	btAlignedObjectArray<btDbvtProxy*>* pairs;
+	btHashedOverlappingPairCacheMt* cache;
+	int count;
+	btDbvtPairCollector(btAlignedObjectArray<btDbvtProxy*>* p, btHashedOverlappingPairCacheMt* c) : pairs(p), cache(c), count(0) {}
+	void Process(const btDbvtNode* na, const btDbvtNode* nb)
+	{
+		if (na != nb)
+		{
+			btDbvtProxy* pa = (btDbvtProxy*)na->data;
+			btDbvtProxy* pb = (btDbvtProxy*)nb->data;
+#if DBVT_BP_SORTPAIRS
+			if (pa->m_uniqueId > pb->m_uniqueId)
+				btSwap(pa, pb);
+#endif
+			if (cache)
+			{
+				cache->addOverlappingPairConcurrent(pa, pb);
+			}
+			else
+			{
+				pairs->push_back(pa);
+				pairs->push_back(pb);
+			}
+			++count;
+		}
+	}
+};
+
+/* Parallel collide tasks	*/
+struct btDbvtCollideLoop : public btIParallelForBody
+{
+	btDbvtBroadphase* m_broadphase;
+	btHashedOverlappingPairCacheMt* m_cache;
+
+	btDbvtCollideLoop(btDbvtBroadphase* broadphase, btHashedOverlappingPairCacheMt* cache)
+	{
+		m_broadphase = broadphase;
+		m_cache = cache;
+	}
+	void forLoop(int iBegin, int iEnd) const BT_OVERRIDE
+	{
+		for (int i = iBegin; i < iEnd; ++i)
+		{
+			btAlignedObjectArray<btDbvtProxy*>& pairs = m_broadphase->m_collidepairs[i];
+			pairs.resize(0);
+			btDbvtPairCollector collector(&pairs, m_cache);
+			const btDbvt::sStkNN& task = m_broadphase->m_collidetasks[i];
+			m_broadphase->m_sets[0].collideTT(task.a, task.b, collector);
+			m_broadphase->m_collidecounts[i] = collector.count;
+		}
+	}
+};
+
+// one level of the collideTT descent on every node pair of 'tasks', pairs of leaves are kept as they are.
+// Returns false when nothing was left to split.
+static bool splitcollidetasks(btAlignedObjectArray<btDbvt::sStkNN>& tasks, btAlignedObjectArray<btDbvt::sStkNN>& split)
+{
+	bool more = false;
+	split.resize(0);
+	for (int i = 0; i < tasks.size(); ++i)
+	{
+		const btDbvtNode* a = tasks[i].a;
+		const btDbvtNode* b = tasks[i].b;
+		if (a == b)
+		{
+			if (a->isinternal())
+			{
+				split.push_back(btDbvt::sStkNN(a->childs[0], a->childs[0]));
+				split.push_back(btDbvt::sStkNN(a->childs[1], a->childs[1]));
+				split.push_back(btDbvt::sStkNN(a->childs[0], a->childs[1]));
+				more = true;
+			}
+		}
+		else if (Intersect(a->volume, b->volume))
+		{
+			if (a->isinternal() && b->isinternal())
+			{
+				split.push_back(btDbvt::sStkNN(a->childs[0], b->childs[0]));
+				split.push_back(btDbvt::sStkNN(a->childs[1], b->childs[0]));
+				split.push_back(btDbvt::sStkNN(a->childs[0], b->childs[1]));
+				split.push_back(btDbvt::sStkNN(a->childs[1], b->childs[1]));
+				more = true;
+			}
+			else if (a->isinternal())
+			{
+				split.push_back(btDbvt::sStkNN(a->childs[0], b));
+				split.push_back(btDbvt::sStkNN(a->childs[1], b));
+				more = true;
+			}
+			else if (b->isinternal())
+			{
+				split.push_back(btDbvt::sStkNN(a, b->childs[0]));
+				split.push_back(btDbvt::sStkNN(a, b->childs[1]));
+				more = true;
+			}
+			else
+			{
+				split.push_back(tasks[i]);
+			}
+		}
+	}
+	tasks.copyFromArray(split);
+	return (more);
+}
+
 //
 // btDbvtBroadphase
 //
@@ -132,6 +282,7 @@ btDbvtBroadphase::btDbvtBroadphase(btOverlappingPairCache* paircache)
 {
 	m_deferedcollide = false;
 	m_needcleanup = true;
+	m_parallelcollide = false;
 	m_releasepaircache = (paircache != 0) ? false : true;
 	m_prediction = 0;
 	m_stageCurrent = 0;
@@ -143,6 +294,12 @@ btDbvtBroadphase::btDbvtBroadphase(btOverlappingPairCache* paircache)
 	m_updates_call = 0;
 	m_updates_done = 0;
 	m_updates_ratio = 0;
+	m_budget = 0;
+	m_dynamicleft = 0;
+	m_cleanupleft = 0;
+	m_optimizecost = btScalar(0.5);
+	m_cleanupcost = btScalar(0.02);
+	m_budgetused = 0;
 	m_paircache = paircache ? paircache : new (btAlignedAlloc(sizeof(btHashedOverlappingPairCache), 16)) btHashedOverlappingPairCache();
 	m_gid = 0;
 	m_pid = 0;
@@ -527,13 +684,44 @@ void btDbvtBroadphase::collide(btDispatcher* dispatcher)
 */
 
 	SPC(m_profiling.m_total);
+	const bool budgeted = m_budget > 0;
+	const unsigned long long budget = (unsigned long long)m_budget * 1000;
+	unsigned long long used = 0;
 	/* optimize				*/
-	m_sets[0].optimizeIncremental(1 + (m_sets[0].m_leaves * m_dupdates) / 100);
-	if (m_fixedleft)
+	unsigned long long start = m_budgetclock.getTimeNanoseconds();
+	if (budgeted)
 	{
-		const int count = 1 + (m_sets[1].m_leaves * m_fupdates) / 100;
-		m_sets[1].optimizeIncremental(1 + (m_sets[1].m_leaves * m_fupdates) / 100);
-		m_fixedleft = btMax<int>(0, m_fixedleft - count);
+		/* the cleanup goes first, stale pairs cost more than a slightly worse tree	*/
+		unsigned long long reserve = 0;
+		if (m_needcleanup || m_cleanupleft)
+		{
+			const int npairs = m_paircache->getNumOverlappingPairs();
+			const int pending = btMin(npairs, btMax<int>(m_newpairs, (npairs * m_cupdates) / 100) + m_cleanupleft);
+			reserve = btMin(budget, (unsigned long long)(pending * m_cleanupcost * 1000));
+		}
+		const unsigned long long end = start + budget - reserve;
+		const int passes = 1 + (m_sets[0].m_leaves * m_dupdates) / 100 + m_dynamicleft;
+		int done = optimizebudgeted(m_sets[0], passes, m_budgetclock, m_optimizecost, end);
+		m_dynamicleft = btMin(passes - done, m_sets[0].m_leaves);
+		if (m_fixedleft)
+		{
+			const int count = optimizebudgeted(m_sets[1], 1 + (m_sets[1].m_leaves * m_fupdates) / 100, m_budgetclock, m_optimizecost, end);
+			m_fixedleft = btMax<int>(0, m_fixedleft - count);
+			done += count;
+		}
+		used = m_budgetclock.getTimeNanoseconds() - start;
+		updatecost(m_optimizecost, used, done);
+	}
+	else
+	{
+		m_sets[0].optimizeIncremental(1 + (m_sets[0].m_leaves * m_dupdates) / 100);
+		if (m_fixedleft)
+		{
+			const int count = 1 + (m_sets[1].m_leaves * m_fupdates) / 100;
+			m_sets[1].optimizeIncremental(1 + (m_sets[1].m_leaves * m_fupdates) / 100);
+			m_fixedleft = btMax<int>(0, m_fixedleft - count);
+		}
+		used = m_budgetclock.getTimeNanoseconds() - start;
 	}
 	/* dynamic -> fixed set	*/
 	m_stageCurrent = (m_stageCurrent + 1) % STAGECOUNT;
@@ -565,6 +753,11 @@ void btDbvtBroadphase::collide(btDispatcher* dispatcher)
 		m_needcleanup = true;
 	}
 	/* collide dynamics		*/
+	if (m_deferedcollide && m_parallelcollide && (m_sets[0].m_leaves >= DBVT_BP_PARALLEL_MINLEAVES))
+	{
+		collideParallel(dispatcher);
+	}
+	else
 	{
 		btDbvtTreeCollider collider(this);
 		if (m_deferedcollide)
@@ -579,15 +772,28 @@ void btDbvtBroadphase::collide(btDispatcher* dispatcher)
 		}
 	}
 	/* clean up				*/
-	if (m_needcleanup)
+	if (m_needcleanup || m_cleanupleft)
 	{
 		SPC(m_profiling.m_cleanup);
 		btBroadphasePairArray& pairs = m_paircache->getOverlappingPairArray();
+		const int left = m_cleanupleft;
+		m_cleanupleft = 0;
 		if (pairs.size() > 0)
 		{
-			int ni = btMin(pairs.size(), btMax<int>(m_newpairs, (pairs.size() * m_cupdates) / 100));
+			start = m_budgetclock.getTimeNanoseconds();
+			const unsigned long long end = start + (budget > used ? budget - used : 0);
+			int ni = btMin(pairs.size(), btMax<int>(m_newpairs, (pairs.size() * m_cupdates) / 100) + left);
+			int tests = 0;
 			for (int i = 0; i < ni; ++i)
 			{
+				/* stop when the next slice is not predicted to fit, the rest is left to the next calls	*/
+				if (budgeted && (tests > 0) && (tests % cleanupSlice) == 0 && budgetfit(m_budgetclock, m_cleanupcost, end) < cleanupSlice)
+				{
+					m_cleanupleft = ni - i;
+					ni = i;
+					break;
+				}
+				++tests;
 				btBroadphasePair& p = pairs[(m_cid + i) % pairs.size()];
 				btDbvtProxy* pa = (btDbvtProxy*)p.m_pProxy0;
 				btDbvtProxy* pb = (btDbvtProxy*)p.m_pProxy1;
@@ -606,8 +812,12 @@ void btDbvtBroadphase::collide(btDispatcher* dispatcher)
 				m_cid = (m_cid + ni) % pairs.size();
 			else
 				m_cid = 0;
+			const unsigned long long elapsed = m_budgetclock.getTimeNanoseconds() - start;
+			if (budgeted) updatecost(m_cleanupcost, elapsed, tests);
+			used += elapsed;
 		}
 	}
+	m_budgetused = btScalar(used) / 1000;
 	++m_pid;
 	m_newpairs = 1;
 	m_needcleanup = false;
@@ -623,6 +833,51 @@ void btDbvtBroadphase::collide(btDispatcher* dispatcher)
 	m_updates_call /= 2;
 }
 
+//
+// Splits the top levels of the dynamic/fixed and dynamic/dynamic descents into DBVT_BP_PARALLEL_TASKS node pairs
+// and collides them in btParallelFor tasks. A btHashedOverlappingPairCacheMt takes the pairs from the tasks directly,
+// any other pair cache gets the pairs of each task in task order. Either way the pair cache ends up the same whatever
+// the number of threads.
+void btDbvtBroadphase::collideParallel(btDispatcher* dispatcher)
+{
+	BT_PROFILE("btDbvtBroadphase::collideParallel");
+	m_collidetasks.resize(0);
+	if (m_sets[0].m_root)
+	{
+		if (m_sets[1].m_root)
+		{
+			m_collidetasks.push_back(btDbvt::sStkNN(m_sets[0].m_root, m_sets[1].m_root));
+		}
+		m_collidetasks.push_back(btDbvt::sStkNN(m_sets[0].m_root, m_sets[0].m_root));
+	}
+	btAlignedObjectArray<btDbvt::sStkNN> split;
+	while ((m_collidetasks.size() < DBVT_BP_PARALLEL_TASKS) && splitcollidetasks(m_collidetasks, split))
+	{
+	}
+	const int numTasks = m_collidetasks.size();
+	if (m_collidepairs.size() < numTasks)
+	{
+		m_collidepairs.resize(numTasks);
+	}
+	m_collidecounts.resize(numTasks);
+	btHashedOverlappingPairCacheMt* cache = m_paircache->getConcurrentPairCache();
+	btDbvtCollideLoop loop(this, cache);
+	btParallelFor(0, numTasks, 1, loop);
+	if (cache)
+	{
+		cache->flushConcurrentPairs(dispatcher);
+	}
+	for (int i = 0; i < numTasks; ++i)
+	{
+		const btAlignedObjectArray<btDbvtProxy*>& pairs = m_collidepairs[i];
+		for (int j = 0; j < pairs.size(); j += 2)
+		{
+			m_paircache->addOverlappingPair(pairs[j], pairs[j + 1]);
+		}
+		m_newpairs += m_collidecounts[i];
+	}
+}
+
 //
 void btDbvtBroadphase::optimize()
 {
@@ -682,6 +937,8 @@ void btDbvtBroadphase::resetPool(btDispatcher* dispatcher)
 		m_updates_call = 0;
 		m_updates_done = 0;
 		m_updates_ratio = 0;
+		m_dynamicleft = 0;
+		m_cleanupleft = 0;
 
 		m_gid = 0;
 		m_pid = 0;
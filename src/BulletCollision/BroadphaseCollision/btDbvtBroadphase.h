@@ -19,6 +19,7 @@ subject to the following restrictions:
 
 #include "BulletCollision/BroadphaseCollision/btDbvt.h"
 #include "BulletCollision/BroadphaseCollision/btOverlappingPairCache.h"
+#include "LinearMath/btQuickprof.h"
 
 //
 // Compile time config
@@ -29,12 +30,13 @@ subject to the following restrictions:
 #define DBVT_BP_PREVENTFALSEUPDATE 0
 #define DBVT_BP_ACCURATESLEEPING 0
 #define DBVT_BP_ENABLE_BENCHMARK 0
+#define DBVT_BP_PARALLEL_TASKS 128			// Node pairs the parallel collide is split into
+#define DBVT_BP_PARALLEL_MINLEAVES 1024		// Smaller dynamic sets collide on the calling thread
 //#define DBVT_BP_MARGIN					(btScalar)0.05
 extern btScalar gDbvtMargin;
 
 #if DBVT_BP_PROFILE
 #define DBVT_BP_PROFILING_RATE 256
-#include "LinearMath/btQuickprof.h"
 #endif
 
 //
@@ -88,6 +90,17 @@ struct btDbvtBroadphase : btBroadphaseInterface
 	bool m_releasepaircache;                    // Release pair cache on delete
 	bool m_deferedcollide;                      // Defere dynamic/static collision to collide call
 	bool m_needcleanup;                         // Need to run cleanup?
+	bool m_parallelcollide;                     // Run the defered collision in btParallelFor tasks
+	int m_budget;                               // Max. microseconds of optimization and cleanup per collide, 0 for no limit
+	int m_dynamicleft;                          // Dynamic optimization left (budgeted)
+	int m_cleanupleft;                          // Cleanup left (budgeted)
+	btScalar m_optimizecost;                    // Estimated microseconds per optimization pass
+	btScalar m_cleanupcost;                     // Estimated microseconds per cleanup test
+	btScalar m_budgetused;                      // Microseconds of optimization and cleanup in the last collide
+	btClock m_budgetclock;                      // Clock of the cost model
+	btAlignedObjectArray<btDbvt::sStkNN> m_collidetasks;                 // Node pairs of the parallel collide
+	btAlignedObjectArray<btAlignedObjectArray<btDbvtProxy*> > m_collidepairs;  // Proxy pairs found by each parallel collide task
+	btAlignedObjectArray<int> m_collidecounts;                          // Number of pairs found by each parallel collide task
 	btAlignedObjectArray<btAlignedObjectArray<const btDbvtNode*> > m_rayTestStacks;
 #if DBVT_BP_PROFILE
 	btClock m_clock;
@@ -104,6 +117,7 @@ struct btDbvtBroadphase : btBroadphaseInterface
 	btDbvtBroadphase(btOverlappingPairCache* paircache = 0);
 	~btDbvtBroadphase();
 	void collide(btDispatcher* dispatcher);
+	void collideParallel(btDispatcher* dispatcher);
 	void optimize();
 
 	/* btBroadphaseInterface Implementation	*/
@@ -134,6 +148,23 @@ struct btDbvtBroadphase : btBroadphaseInterface
 		return m_prediction;
 	}
 
+	///limits the time collide spends on incremental tree optimization and pair cleanup to about 'microseconds' per call.
+	///The work that does not fit is carried over to the next calls, the number of optimization passes and cleanup tests
+	///that fit is predicted from their measured cost. 0 (the default) only uses the m_fupdates/m_dupdates/m_cupdates percentages.
+	void setOptimizationBudget(int microseconds)
+	{
+		m_budget = microseconds;
+	}
+	int getOptimizationBudget() const
+	{
+		return m_budget;
+	}
+	///microseconds spent on tree optimization and pair cleanup by the last collide
+	btScalar getOptimizationTime() const
+	{
+		return m_budgetused;
+	}
+
 	///this setAabbForceUpdate is similar to setAabb but always forces the aabb update.
 	///it is not part of the btBroadphaseInterface but specific to btDbvtBroadphase.
 	///it bypasses certain optimizations that prevent aabb updates (when the aabb shrinks), see
@@ -0,0 +1,905 @@
+/*
+Bullet Continuous Collision Detection and Physics Library
+Copyright (c) 2003-2018 Erwin Coumans  https://bulletphysics.org
+
+This software is provided 'as-is', without any express or implied warranty.
+In no event will the authors be held liable for any damages arising from the use of this software.
+Permission is granted to anyone to use this software for any purpose,
+including commercial applications, and to alter it and redistribute it freely,
+subject to the following restrictions:
+
+1. The origin of this software must not be misrepresented; you must not claim that you wrote the original software. If you use this software in a product, an acknowledgment in the product documentation would be appreciated but is not required.
+2. Altered source versions must be plainly marked as such, and must not be misrepresented as being the original software.
+3. This notice may not be removed or altered from any source distribution.
+*/
+
+#include "btGridBroadphase.h"
+#include "btBroadphaseRadixSort.h"
+#include "btHashedOverlappingPairCacheMt.h"
+#include "LinearMath/btAabbUtil2.h"
+#include "LinearMath/btThreads.h"
+#include "LinearMath/btQuickprof.h"
+#include <math.h>
+#include <string.h>
+
+static const int kGridBlockSize = 1024;     // proxies per task for the key and grid proxy loops
+static const int kGridCellBlockSize = 256;  // cells per task for the pair search
+static const int kGridTopLevel = btGridBroadphase::MAX_LEVELS;
+static const int kGridCoordLimit = 1 << 30;  // cell coordinates of level 0 are clamped to this, the keys wrap them to 20 bits
+static const int kGridWrapBits = 20;
+// a proxy goes into a level when it is smaller than this fraction of the cell size, the rest covers the rounding of the
+// cell coordinates and of the ray steps
+static const double kGridLevelFill = 0.999;
+static const unsigned long long kGridDeadKey = ~0ull;
+
+// cell coordinate of level 0, the coordinates of level L are this shifted by L
+static SIMD_FORCE_INLINE int gridCoord(double x, double invCellSize)
+{
+	double c = floor(x * invCellSize);
+	if (!(c >= -kGridCoordLimit))
+	{
+		return -kGridCoordLimit;
+	}
+	return c < kGridCoordLimit - 1 ? int(c) : kGridCoordLimit - 1;
+}
+
+// floor(c / 2^shift), also for the negative coordinates
+static SIMD_FORCE_INLINE int gridShift(int c, int shift)
+{
+	return c >= 0 ? (c >> shift) : ~((~c) >> shift);
+}
+
+// the 20 low bits of x, two zero bits after each
+static SIMD_FORCE_INLINE unsigned long long gridSpreadBits(unsigned int x)
+{
+	unsigned long long v = x & ((1u << kGridWrapBits) - 1);
+	v = (v | (v << 32)) & 0x1f00000000ffffull;
+	v = (v | (v << 16)) & 0x1f0000ff0000ffull;
+	v = (v | (v << 8)) & 0x100f00f00f00f00full;
+	v = (v | (v << 4)) & 0x10c30c30c30c30c3ull;
+	v = (v | (v << 2)) & 0x1249249249249249ull;
+	return v;
+}
+
+// the level in the top 4 bits and the Morton code of the coordinates, wrapped to 20 bits, below. The cells that wrap to the
+// same key share it, which only costs a few more aabb tests.
+static SIMD_FORCE_INLINE unsigned long long gridCellKey(int level, int x, int y, int z)
+{
+	const unsigned int offset = 1u << (kGridWrapBits - 1);
+	return (((unsigned long long)level) << 60) |
+		   gridSpreadBits(unsigned(x) + offset) |
+		   (gridSpreadBits(unsigned(y) + offset) << 1) |
+		   (gridSpreadBits(unsigned(z) + offset) << 2);
+}
+
+// the level and the cell of a proxy, by the center of its bounds
+static SIMD_FORCE_INLINE unsigned long long gridProxyCell(const btBroadphaseHandleTable::HandleBounds& bounds, double cellSize, double invCellSize, int* level, int* coords)
+{
+	double extent = 0;
+	for (int k = 0; k < 3; ++k)
+	{
+		extent = btMax(extent, double(bounds.m_max[k]) - double(bounds.m_min[k]));
+	}
+	int l = 0;
+	double size = kGridLevelFill * cellSize;
+	while (l < kGridTopLevel && !(extent <= size))
+	{
+		size *= 2;
+		++l;
+	}
+	*level = l;
+	if (l == kGridTopLevel)
+	{
+		coords[0] = coords[1] = coords[2] = 0;
+		return ((unsigned long long)kGridTopLevel) << 60;
+	}
+	for (int k = 0; k < 3; ++k)
+	{
+		double center = (double(bounds.m_min[k]) + double(bounds.m_max[k])) * 0.5;
+		coords[k] = gridShift(gridCoord(center, invCellSize), l);
+	}
+	return gridCellKey(l, coords[0], coords[1], coords[2]);
+}
+
+static SIMD_FORCE_INLINE int gridHash(unsigned long long key, int mask)
+{
+	unsigned long long h = key * 0x9e3779b97f4a7c15ull;
+	return int((h ^ (h >> 29)) & (unsigned long long)mask);
+}
+
+struct btGridExponentLoop : public btIParallelForBody
+{
+	btGridBroadphase* m_broadphase;
+
+	void forLoop(int iBegin, int iEnd) const BT_OVERRIDE
+	{
+		btGridBroadphase* bp = m_broadphase;
+		const int numHandles = bp->m_handleTable.m_handles.size();
+		for (int iBlock = iBegin; iBlock < iEnd; ++iBlock)
+		{
+			int sum = 0;
+			int count = 0;
+			int iEndHandle = btMin(numHandles, (iBlock + 1) * kGridBlockSize);
+			for (int i = iBlock * kGridBlockSize; i < iEndHandle; ++i)
+			{
+				if (!bp->m_handleTable.m_handles[i])
+				{
+					continue;
+				}
+				const btBroadphaseHandleTable::HandleBounds& b = bp->m_handleTable.m_handleBounds[i];
+				float extent = btMax(b.m_max[0] - b.m_min[0], btMax(b.m_max[1] - b.m_min[1], b.m_max[2] - b.m_min[2]));
+				unsigned int bits;
+				memcpy(&bits, &extent, sizeof(bits));
+				sum += btMax(int((bits >> 23) & 0xff) - 127, -20);
+				count++;
+			}
+			bp->m_blockExponents[iBlock * 2] = sum;
+			bp->m_blockExponents[iBlock * 2 + 1] = count;
+		}
+	}
+};
+
+struct btGridKeyLoop : public btIParallelForBody
+{
+	btGridBroadphase* m_broadphase;
+	double m_cellSize;
+	double m_invCellSize;
+
+	void forLoop(int iBegin, int iEnd) const BT_OVERRIDE
+	{
+		btGridBroadphase* bp = m_broadphase;
+		const int numHandles = bp->m_handleTable.m_handles.size();
+		for (int iBlock = iBegin; iBlock < iEnd; ++iBlock)
+		{
+			int iEndHandle = btMin(numHandles, (iBlock + 1) * kGridBlockSize);
+			for (int i = iBlock * kGridBlockSize; i < iEndHandle; ++i)
+			{
+				btGridBroadphase::SortKey& key = bp->m_keys[i];
+				key.m_handle = i;
+				if (bp->m_handleTable.m_handles[i])
+				{
+					int level;
+					int coords[3];
+					key.m_key = gridProxyCell(bp->m_handleTable.m_handleBounds[i], m_cellSize, m_invCellSize, &level, coords);
+				}
+				else
+				{
+					key.m_key = kGridDeadKey;
+				}
+			}
+		}
+	}
+};
+
+struct btGridProxyLoop : public btIParallelForBody
+{
+	btGridBroadphase* m_broadphase;
+	int m_numProxies;
+	double m_cellSize;
+	double m_invCellSize;
+
+	void forLoop(int iBegin, int iEnd) const BT_OVERRIDE
+	{
+		btGridBroadphase* bp = m_broadphase;
+		const int frame = bp->m_frame;
+		for (int iBlock = iBegin; iBlock < iEnd; ++iBlock)
+		{
+			int iEndProxy = btMin(m_numProxies, (iBlock + 1) * kGridBlockSize);
+			for (int i = iBlock * kGridBlockSize; i < iEndProxy; ++i)
+			{
+				const int handle = bp->m_keys[i].m_handle;
+				const btBroadphaseHandleTable::HandleBounds& b = bp->m_handleTable.m_handleBounds[handle];
+				btGridBroadphase::GridProxy& proxy = bp->m_gridProxies[i];
+				for (int k = 0; k < 3; ++k)
+				{
+					proxy.m_min[k] = b.m_min[k];
+					proxy.m_max[k] = b.m_max[k];
+				}
+				proxy.m_handle = handle;
+				proxy.m_moved = (b.m_movedFrame == frame) ? 1 : 0;
+				gridProxyCell(b, m_cellSize, m_invCellSize, &proxy.m_level, proxy.m_coords);
+			}
+		}
+	}
+};
+
+struct btGridPairLoop : public btIParallelForBody
+{
+	btGridBroadphase* m_broadphase;
+	btHashedOverlappingPairCacheMt* m_cache;
+	int m_levelMoved[kGridTopLevel + 1];   // 1 for the levels with a cell that moved
+	int m_levelStatic[kGridTopLevel + 1];  // 1 for the levels with a cell that did not move
+
+	SIMD_FORCE_INLINE void testPair(int i, int j, btAlignedObjectArray<btBroadphaseHandleProxy*>& pairs, int& numPairs) const
+	{
+		const btGridBroadphase::GridProxy& a = m_broadphase->m_gridProxies[i];
+		const btGridBroadphase::GridProxy& b = m_broadphase->m_gridProxies[j];
+		if (!(a.m_moved | b.m_moved))
+		{
+			return;
+		}
+		if (a.m_min[0] > b.m_max[0] || a.m_max[0] < b.m_min[0] ||
+			a.m_min[1] > b.m_max[1] || a.m_max[1] < b.m_min[1] ||
+			a.m_min[2] > b.m_max[2] || a.m_max[2] < b.m_min[2])
+		{
+			return;
+		}
+		const btAlignedObjectArray<btBroadphaseHandleProxy*>& handles = m_broadphase->m_handleTable.m_handles;
+		if (btBroadphaseHandleTable::addPair(m_cache, handles[a.m_handle], handles[b.m_handle], pairs))
+		{
+			++numPairs;
+		}
+	}
+
+	SIMD_FORCE_INLINE void testCells(int cell0, int cell1, btAlignedObjectArray<btBroadphaseHandleProxy*>& pairs, int& numPairs) const
+	{
+		const int* starts = &m_broadphase->m_cellStarts[0];
+		for (int i = starts[cell0]; i < starts[cell0 + 1]; ++i)
+		{
+			for (int j = starts[cell1]; j < starts[cell1 + 1]; ++j)
+			{
+				testPair(i, j, pairs, numPairs);
+			}
+		}
+	}
+
+	void forLoop(int iBegin, int iEnd) const BT_OVERRIDE
+	{
+		const btGridBroadphase* bp = m_broadphase;
+		const int numCells = bp->m_cellKeys.size();
+		const int* starts = &bp->m_cellStarts[0];
+		const int* cellMoved = &bp->m_cellMoved[0];
+		const btGridBroadphase::GridProxy* gridProxies = &bp->m_gridProxies[0];
+		const bool hasTopCell = bp->m_levelCellStarts[kGridTopLevel + 1] > bp->m_levelCellStarts[kGridTopLevel];
+		const int topCell = bp->m_levelCellStarts[kGridTopLevel];
+		for (int iBlock = iBegin; iBlock < iEnd; ++iBlock)
+		{
+			btAlignedObjectArray<btBroadphaseHandleProxy*>& pairs = m_broadphase->m_blockPairs[iBlock];
+			pairs.resize(0);
+			int numPairs = 0;
+			int iEndCell = btMin(numCells, (iBlock + 1) * kGridCellBlockSize);
+			for (int c = iBlock * kGridCellBlockSize; c < iEndCell; ++c)
+			{
+				const int level = int(bp->m_cellKeys[c] >> 60);
+				const int s = starts[c];
+				const int e = starts[c + 1];
+				if (cellMoved[c])
+				{
+					for (int i = s; i < e; ++i)
+					{
+						for (int j = i + 1; j < e; ++j)
+						{
+							testPair(i, j, pairs, numPairs);
+						}
+					}
+					if (level == kGridTopLevel)
+					{
+						continue;
+					}
+					// each pair of neighbor cells on the same level is tested once: a cell that moved tests the cells
+					// after it, and the cells before it that did not move
+					const int* coords = gridProxies[s].m_coords;
+					const bool hasStaticCells = m_levelStatic[level] != 0;
+					for (int dz = -1; dz <= 1; ++dz)
+					{
+						for (int dy = -1; dy <= 1; ++dy)
+						{
+							for (int dx = -1; dx <= 1; ++dx)
+							{
+								const bool forward = dz > 0 || (dz == 0 && (dy > 0 || (dy == 0 && dx > 0)));
+								const bool backward = hasStaticCells && (dz < 0 || (dz == 0 && (dy < 0 || (dy == 0 && dx < 0))));
+								if (!forward && !backward)
+								{
+									continue;
+								}
+								int n = bp->findCell(gridCellKey(level, coords[0] + dx, coords[1] + dy, coords[2] + dz));
+								if (n >= 0 && (forward || !cellMoved[n]))
+								{
+									testCells(c, n, pairs, numPairs);
+								}
+							}
+						}
+					}
+				}
+				if (level == kGridTopLevel)
+				{
+					continue;
+				}
+				// the proxies of the coarser levels whose cells are next to the cells of these proxies on that level
+				for (int coarse = level + 1; coarse < kGridTopLevel; ++coarse)
+				{
+					if (bp->m_levelCellStarts[coarse + 1] == bp->m_levelCellStarts[coarse] || !(cellMoved[c] || m_levelMoved[coarse]))
+					{
+						continue;
+					}
+					int neighbors[27];
+					int parent[3] = {0, 0, 0};
+					for (int i = s; i < e; ++i)
+					{
+						const btGridBroadphase::GridProxy& proxy = gridProxies[i];
+						int p[3];
+						for (int k = 0; k < 3; ++k)
+						{
+							p[k] = gridShift(proxy.m_coords[k], coarse - level);
+						}
+						// the proxies of a cell usually share the parent cell, unless their cells only share the key
+						if (i == s || p[0] != parent[0] || p[1] != parent[1] || p[2] != parent[2])
+						{
+							int numNeighbors = 0;
+							for (int dz = -1; dz <= 1; ++dz)
+							{
+								for (int dy = -1; dy <= 1; ++dy)
+								{
+									for (int dx = -1; dx <= 1; ++dx)
+									{
+										neighbors[numNeighbors++] = bp->findCell(gridCellKey(coarse, p[0] + dx, p[1] + dy, p[2] + dz));
+									}
+								}
+							}
+							parent[0] = p[0];
+							parent[1] = p[1];
+							parent[2] = p[2];
+						}
+						for (int n = 0; n < 27; ++n)
+						{
+							if (neighbors[n] >= 0 && (proxy.m_moved || cellMoved[neighbors[n]]))
+							{
+								for (int j = starts[neighbors[n]]; j < starts[neighbors[n] + 1]; ++j)
+								{
+									testPair(i, j, pairs, numPairs);
+								}
+							}
+						}
+					}
+				}
+				if (hasTopCell && (cellMoved[c] || cellMoved[topCell]))
+				{
+					testCells(c, topCell, pairs, numPairs);
+				}
+			}
+			m_broadphase->m_blockCounts[iBlock] = numPairs;
+		}
+	}
+};
+
+// the queries visit the proxies of the grid, except the ones that moved since it was built, and then those one by one
+template <typename Visitor>
+static void gridVisitProxies(const btGridBroadphase& bp, int iBegin, int iEnd, Visitor& visitor)
+{
+	for (int i = iBegin; i < iEnd; ++i)
+	{
+		const int handle = bp.m_gridProxies[i].m_handle;
+		btBroadphaseHandleProxy* proxy = bp.m_handleTable.m_handles[handle];
+		if (proxy && bp.m_handleTable.m_handleBounds[handle].m_movedFrame != bp.m_frame)
+		{
+			visitor.visit(proxy);
+		}
+	}
+}
+
+template <typename Visitor>
+static void gridVisitCell(const btGridBroadphase& bp, unsigned long long key, Visitor& visitor)
+{
+	int cell = bp.findCell(key);
+	if (cell >= 0)
+	{
+		gridVisitProxies(bp, bp.m_cellStarts[cell], bp.m_cellStarts[cell + 1], visitor);
+	}
+}
+
+template <typename Visitor>
+static void gridVisitLevel(const btGridBroadphase& bp, int level, Visitor& visitor)
+{
+	gridVisitProxies(bp, bp.m_cellStarts[bp.m_levelCellStarts[level]], bp.m_cellStarts[bp.m_levelCellStarts[level + 1]], visitor);
+}
+
+template <typename Visitor>
+static void gridVisitDirty(const btGridBroadphase& bp, Visitor& visitor)
+{
+	for (int i = 0; i < bp.m_dirtyHandles.size(); ++i)
+	{
+		btBroadphaseHandleProxy* proxy = bp.m_handleTable.m_handles[bp.m_dirtyHandles[i]];
+		if (proxy)
+		{
+			visitor.visit(proxy);
+		}
+	}
+}
+
+// the cells of 'level' with coordinates in [lo, hi]
+template <typename Visitor>
+static void gridVisitCells(const btGridBroadphase& bp, int level, const int* lo, const int* hi, Visitor& visitor)
+{
+	for (int z = lo[2]; z <= hi[2]; ++z)
+	{
+		for (int y = lo[1]; y <= hi[1]; ++y)
+		{
+			for (int x = lo[0]; x <= hi[0]; ++x)
+			{
+				gridVisitCell(bp, gridCellKey(level, x, y, z), visitor);
+			}
+		}
+	}
+}
+
+static int gridLevelSize(const btGridBroadphase& bp, int level)
+{
+	return bp.m_cellStarts[bp.m_levelCellStarts[level + 1]] - bp.m_cellStarts[bp.m_levelCellStarts[level]];
+}
+
+struct btGridAabbVisitor
+{
+	btVector3 m_aabbMin;
+	btVector3 m_aabbMax;
+	btBroadphaseAabbCallback* m_callback;
+
+	void visit(btBroadphaseProxy* proxy)
+	{
+		if (TestAabbAgainstAabb2(m_aabbMin, m_aabbMax, proxy->m_aabbMin, proxy->m_aabbMax))
+		{
+			m_callback->process(proxy);
+		}
+	}
+};
+
+struct btGridRayVisitor
+{
+	btVector3 m_rayFrom;
+	btVector3 m_aabbMin;
+	btVector3 m_aabbMax;
+	btBroadphaseRayCallback* m_callback;
+
+	void visit(btBroadphaseProxy* proxy)
+	{
+		btVector3 bounds[2];
+		bounds[0] = proxy->m_aabbMin - m_aabbMax;
+		bounds[1] = proxy->m_aabbMax - m_aabbMin;
+		btScalar tmin = 1.f;
+		if (btRayAabb2(m_rayFrom, m_callback->m_rayDirectionInverse, m_callback->m_signs, bounds, tmin, 0, m_callback->m_lambda_max))
+		{
+			m_callback->process(proxy);
+		}
+	}
+};
+
+// visits the cells of 'level' that can hold a proxy hit by the ray, in the order the ray reaches them. A proxy hit at
+// the point x has its center within half a cell of [x + aabbMin, x + aabbMax], so the cells in that range are tracked
+// per axis as the ray moves and each cell is visited once, when it enters the range.
+static void gridRayTestLevel(const btGridBroadphase& bp, int level, const btVector3& rayFrom, const btVector3& direction, btGridRayVisitor& visitor)
+{
+	const double cellSize = double(bp.m_gridCellSize) * double(1 << level);
+	const double invCellSize = 1.0 / double(bp.m_gridCellSize);
+	const double halfCell = cellSize * 0.5;
+	const btBroadphaseRayCallback& callback = *visitor.m_callback;
+
+	// long rays and rays far out go through the level proxy by proxy
+	double numSteps = 3;
+	double sweepCells = 0;
+	double reach = 0;
+	for (int k = 0; k < 3; ++k)
+	{
+		double length = btFabs(direction[k]) * double(callback.m_lambda_max);
+		numSteps += length / cellSize;
+		sweepCells = btMax(sweepCells, double(visitor.m_aabbMax[k] - visitor.m_aabbMin[k]) / cellSize);
+		reach = btMax(reach, btFabs(double(rayFrom[k])) + length + btFabs(double(visitor.m_aabbMin[k])) + btFabs(double(visitor.m_aabbMax[k])) + cellSize);
+	}
+	double numCells = numSteps * (sweepCells + 2) * (sweepCells + 2);
+	if (!(numCells <= gridLevelSize(bp, level) && numCells < (1 << (kGridWrapBits - 1)) && reach * invCellSize < (kGridCoordLimit >> 1)))
+	{
+		gridVisitLevel(bp, level, visitor);
+		return;
+	}
+
+	double lower[3];  // the range of centers at the ray start
+	double upper[3];
+	int lo[3];
+	int hi[3];
+	for (int k = 0; k < 3; ++k)
+	{
+		lower[k] = double(rayFrom[k]) + double(visitor.m_aabbMin[k]) - halfCell;
+		upper[k] = double(rayFrom[k]) + double(visitor.m_aabbMax[k]) + halfCell;
+		lo[k] = gridShift(gridCoord(lower[k], invCellSize), level);
+		hi[k] = gridShift(gridCoord(upper[k], invCellSize), level);
+	}
+	gridVisitCells(bp, level, lo, hi, visitor);
+
+	const int maxSteps = int(numSteps) * 6 + 6;
+	for (int step = 0; step < maxSteps; ++step)
+	{
+		// the next cell boundary that the range crosses, growing it on one side or shrinking it on the other
+		double tNext = BT_LARGE_FLOAT;
+		int axis = -1;
+		bool grow = false;
+		for (int k = 0; k < 3; ++k)
+		{
+			const double d = direction[k];
+			if (d > 0)
+			{
+				double tGrow = ((hi[k] + 1) * cellSize - upper[k]) / d;
+				double tShrink = ((lo[k] + 1) * cellSize - lower[k]) / d;
+				if (tShrink < tNext)
+				{
+					tNext = tShrink;
+					axis = k;
+					grow = false;
+				}
+				if (tGrow < tNext)
+				{
+					tNext = tGrow;
+					axis = k;
+					grow = true;
+				}
+			}
+			else if (d < 0)
+			{
+				double tGrow = (lo[k] * cellSize - lower[k]) / d;
+				double tShrink = (hi[k] * cellSize - upper[k]) / d;
+				if (tShrink < tNext)
+				{
+					tNext = tShrink;
+					axis = k;
+					grow = false;
+				}
+				if (tGrow < tNext)
+				{
+					tNext = tGrow;
+					axis = k;
+					grow = true;
+				}
+			}
+		}
+		if (axis < 0 || tNext > callback.m_lambda_max)
+		{
+			break;
+		}
+		const bool positive = direction[axis] > 0;
+		if (!grow)
+		{
+			if (positive)
+			{
+				lo[axis]++;
+			}
+			else
+			{
+				hi[axis]--;
+			}
+			continue;
+		}
+		int sliceLo[3] = {lo[0], lo[1], lo[2]};
+		int sliceHi[3] = {hi[0], hi[1], hi[2]};
+		if (positive)
+		{
+			hi[axis]++;
+			sliceLo[axis] = sliceHi[axis] = hi[axis];
+		}
+		else
+		{
+			lo[axis]--;
+			sliceLo[axis] = sliceHi[axis] = lo[axis];
+		}
+		gridVisitCells(bp, level, sliceLo, sliceHi, visitor);
+	}
+}
+
+btGridBroadphase::btGridBroadphase(btScalar cellSize, btOverlappingPairCache* pairCache)
+{
+	m_pairCache = pairCache;
+	m_ownsPairCache = false;
+	if (!m_pairCache)
+	{
+		void* mem = btAlignedAlloc(sizeof(btHashedOverlappingPairCache), 16);
+		m_pairCache = new (mem) btHashedOverlappingPairCache();
+		m_ownsPairCache = true;
+	}
+	m_cellSize = cellSize;
+	m_gridCellSize = cellSize > 0 ? cellSize : btScalar(1);
+	m_frame = 1;
+	m_numNewPairs = 0;
+	for (int i = 0; i < MAX_LEVELS + 2; ++i)
+	{
+		m_levelCellStarts[i] = 0;
+	}
+}
+
+btGridBroadphase::~btGridBroadphase()
+{
+	if (m_ownsPairCache)
+	{
+		m_pairCache->~btOverlappingPairCache();
+		btAlignedFree(m_pairCache);
+	}
+}
+
+btBroadphaseProxy* btGridBroadphase::createProxy(const btVector3& aabbMin, const btVector3& aabbMax, int /*shapeType*/, void* userPtr, int collisionFilterGroup, int collisionFilterMask, btDispatcher* /*dispatcher*/)
+{
+	btBroadphaseHandleProxy* proxy = m_handleTable.createProxy(aabbMin, aabbMax, userPtr, collisionFilterGroup, collisionFilterMask, m_frame);
+	m_dirtyHandles.push_back(proxy->m_handle);
+	return proxy;
+}
+
+void btGridBroadphase::destroyProxy(btBroadphaseProxy* proxy, btDispatcher* dispatcher)
+{
+	m_pairCache->removeOverlappingPairsContainingProxy(proxy, dispatcher);
+	// the handle is still in the grid, it is reused after the next update
+	m_handleTable.destroyProxy(static_cast<btBroadphaseHandleProxy*>(proxy));
+}
+
+void btGridBroadphase::setAabb(btBroadphaseProxy* proxyOrg, const btVector3& aabbMin, const btVector3& aabbMax, btDispatcher* /*dispatcher*/)
+{
+	btBroadphaseHandleProxy* proxy = static_cast<btBroadphaseHandleProxy*>(proxyOrg);
+	if (m_handleTable.setAabb(proxy, aabbMin, aabbMax, m_frame))
+	{
+		m_dirtyHandles.push_back(proxy->m_handle);
+	}
+}
+
+void btGridBroadphase::getAabb(btBroadphaseProxy* proxy, btVector3& aabbMin, btVector3& aabbMax) const
+{
+	aabbMin = proxy->m_aabbMin;
+	aabbMax = proxy->m_aabbMax;
+}
+
+int btGridBroadphase::findCell(unsigned long long key) const
+{
+	const int mask = m_cellTable.size() - 1;
+	for (int i = gridHash(key, mask);; i = (i + 1) & mask)
+	{
+		const int cell = m_cellTable[i];
+		if (cell < 0 || m_cellKeys[cell] == key)
+		{
+			return cell;
+		}
+	}
+}
+
+void btGridBroadphase::rayTest(const btVector3& rayFrom, const btVector3& rayTo, btBroadphaseRayCallback& rayCallback, const btVector3& aabbMin, const btVector3& aabbMax)
+{
+	btGridRayVisitor visitor;
+	visitor.m_rayFrom = rayFrom;
+	visitor.m_aabbMin = aabbMin;
+	visitor.m_aabbMax = aabbMax;
+	visitor.m_callback = &rayCallback;
+	if (m_cellKeys.size())
+	{
+		btVector3 direction = rayTo - rayFrom;
+		btScalar length = direction.length();
+		direction = (length > SIMD_EPSILON) ? direction / length : btVector3(0, 0, 0);
+		for (int level = 0; level < kGridTopLevel; ++level)
+		{
+			if (m_levelCellStarts[level + 1] > m_levelCellStarts[level])
+			{
+				gridRayTestLevel(*this, level, rayFrom, direction, visitor);
+			}
+		}
+		gridVisitLevel(*this, kGridTopLevel, visitor);
+	}
+	gridVisitDirty(*this, visitor);
+}
+
+void btGridBroadphase::aabbTest(const btVector3& aabbMin, const btVector3& aabbMax, btBroadphaseAabbCallback& callback)
+{
+	btGridAabbVisitor visitor;
+	visitor.m_aabbMin = aabbMin;
+	visitor.m_aabbMax = aabbMax;
+	visitor.m_callback = &callback;
+	if (m_cellKeys.size())
+	{
+		const double invCellSize = 1.0 / double(m_gridCellSize);
+		for (int level = 0; level < kGridTopLevel; ++level)
+		{
+			if (m_levelCellStarts[level + 1] == m_levelCellStarts[level])
+			{
+				continue;
+			}
+			// the centers of the proxies that overlap the box are within half a cell of it
+			const double halfCell = double(m_gridCellSize) * double(1 << level) * 0.5;
+			int lo[3];
+			int hi[3];
+			double numCells = 1;
+			for (int k = 0; k < 3; ++k)
+			{
+				lo[k] = gridShift(gridCoord(double(aabbMin[k]) - halfCell, invCellSize), level);
+				hi[k] = gridShift(gridCoord(double(aabbMax[k]) + halfCell, invCellSize), level);
+				numCells *= double(hi[k]) - double(lo[k]) + 1;
+			}
+			if (numCells <= gridLevelSize(*this, level) && numCells < (1 << (kGridWrapBits - 1)))
+			{
+				gridVisitCells(*this, level, lo, hi, visitor);
+			}
+			else
+			{
+				gridVisitLevel(*this, level, visitor);
+			}
+		}
+		gridVisitLevel(*this, kGridTopLevel, visitor);
+	}
+	gridVisitDirty(*this, visitor);
+}
+
+// a power of two near the typical size of the proxies, from the mean of the exponents of their sizes so that a few
+// large proxies do not change it
+btScalar btGridBroadphase::chooseCellSize()
+{
+	if (m_cellSize > 0)
+	{
+		return m_cellSize;
+	}
+	const int numBlocks = (m_handleTable.m_handles.size() + kGridBlockSize - 1) / kGridBlockSize;
+	m_blockExponents.resizeNoInitialize(numBlocks * 2);
+	btGridExponentLoop loop;
+	loop.m_broadphase = this;
+	btBroadphaseParallelFor(0, numBlocks, loop);
+	int sum = 0;
+	int count = 0;
+	for (int i = 0; i < numBlocks; ++i)
+	{
+		sum += m_blockExponents[i * 2];
+		count += m_blockExponents[i * 2 + 1];
+	}
+	if (count == 0)
+	{
+		return m_gridCellSize;
+	}
+	// the sizes with the mean exponent are between half and the whole cell
+	int exponent = int(floor(double(sum) / count + 0.5)) + 1;
+	return btScalar(ldexp(1.0, exponent));
+}
+
+void btGridBroadphase::buildGrid()
+{
+	const int numHandles = m_handleTable.m_handles.size();
+	const double cellSize = double(m_gridCellSize);
+	const double invCellSize = 1.0 / cellSize;
+	const int numBlocks = (numHandles + kGridBlockSize - 1) / kGridBlockSize;
+	m_keys.resizeNoInitialize(numHandles);
+	{
+		btGridKeyLoop loop;
+		loop.m_broadphase = this;
+		loop.m_cellSize = cellSize;
+		loop.m_invCellSize = invCellSize;
+		btBroadphaseParallelFor(0, numBlocks, loop);
+	}
+	btBroadphaseRadixSort(m_keys, m_sortBuffer, m_radixCounts);
+
+	// the destroyed proxies sort last
+	int numProxies = numHandles;
+	while (numProxies > 0 && m_keys[numProxies - 1].m_key == kGridDeadKey)
+	{
+		numProxies--;
+	}
+	m_gridProxies.resizeNoInitialize(numProxies);
+	{
+		btGridProxyLoop loop;
+		loop.m_broadphase = this;
+		loop.m_numProxies = numProxies;
+		loop.m_cellSize = cellSize;
+		loop.m_invCellSize = invCellSize;
+		btBroadphaseParallelFor(0, (numProxies + kGridBlockSize - 1) / kGridBlockSize, loop);
+	}
+
+	m_cellKeys.resize(0);
+	m_cellStarts.resize(0);
+	m_cellMoved.resize(0);
+	for (int i = 0; i < numProxies; ++i)
+	{
+		const unsigned long long key = m_keys[i].m_key;
+		if (i == 0 || key != m_keys[i - 1].m_key)
+		{
+			m_cellKeys.push_back(key);
+			m_cellStarts.push_back(i);
+			m_cellMoved.push_back(0);
+		}
+		m_cellMoved[m_cellMoved.size() - 1] |= m_gridProxies[i].m_moved;
+	}
+	const int numCells = m_cellKeys.size();
+	m_cellStarts.push_back(numProxies);
+	m_cellMoved.push_back(0);
+
+	int cell = 0;
+	for (int level = 0; level <= kGridTopLevel + 1; ++level)
+	{
+		while (cell < numCells && int(m_cellKeys[cell] >> 60) < level)
+		{
+			cell++;
+		}
+		m_levelCellStarts[level] = cell;
+	}
+
+	int tableSize = 16;
+	while (tableSize < 2 * numCells)
+	{
+		tableSize *= 2;
+	}
+	m_cellTable.resizeNoInitialize(tableSize);
+	for (int i = 0; i < tableSize; ++i)
+	{
+		m_cellTable[i] = -1;
+	}
+	const int mask = tableSize - 1;
+	for (int c = 0; c < numCells; ++c)
+	{
+		int i = gridHash(m_cellKeys[c], mask);
+		while (m_cellTable[i] >= 0)
+		{
+			i = (i + 1) & mask;
+		}
+		m_cellTable[i] = c;
+	}
+}
+
+void btGridBroadphase::findPairs(btDispatcher* dispatcher)
+{
+	BT_PROFILE("btGridBroadphase::findPairs");
+	const int numBlocks = (m_cellKeys.size() + kGridCellBlockSize - 1) / kGridCellBlockSize;
+	if (m_blockPairs.size() < numBlocks)
+	{
+		m_blockPairs.resize(numBlocks);
+	}
+	m_blockCounts.resizeNoInitialize(numBlocks);
+	btHashedOverlappingPairCacheMt* cache = m_pairCache->getConcurrentPairCache();
+	btGridPairLoop loop;
+	loop.m_broadphase = this;
+	loop.m_cache = cache;
+	for (int level = 0; level <= kGridTopLevel; ++level)
+	{
+		loop.m_levelMoved[level] = 0;
+		loop.m_levelStatic[level] = 0;
+		for (int c = m_levelCellStarts[level]; c < m_levelCellStarts[level + 1]; ++c)
+		{
+			loop.m_levelMoved[level] |= m_cellMoved[c];
+			loop.m_levelStatic[level] |= 1 - m_cellMoved[c];
+		}
+	}
+	btBroadphaseParallelFor(0, numBlocks, loop);
+	if (cache)
+	{
+		cache->flushConcurrentPairs(dispatcher);
+	}
+	btBroadphaseHandleTable::addBlockPairs(m_pairCache, m_blockPairs, numBlocks);
+	m_numNewPairs = 0;
+	for (int i = 0; i < numBlocks; ++i)
+	{
+		m_numNewPairs += m_blockCounts[i];
+	}
+}
+
+void btGridBroadphase::calculateOverlappingPairs(btDispatcher* dispatcher)
+{
+	BT_PROFILE("btGridBroadphase::calculateOverlappingPairs");
+	if (m_dirtyHandles.size() || m_handleTable.m_pendingFreeHandles.size())
+	{
+		{
+			BT_PROFILE("btGridBroadphase::buildGrid");
+			m_gridCellSize = chooseCellSize();
+			buildGrid();
+		}
+		findPairs(dispatcher);
+		m_handleTable.removeSeparatedPairs(m_pairCache, m_frame, dispatcher);
+		m_handleTable.releasePendingHandles();
+		m_dirtyHandles.resize(0);
+	}
+	else
+	{
+		m_numNewPairs = 0;
+	}
+	m_frame++;
+}
+
+void btGridBroadphase::resetPool(btDispatcher* /*dispatcher*/)
+{
+	if (getNumProxies() == 0)
+	{
+		m_handleTable.clear();
+		m_dirtyHandles.clear();
+		m_keys.clear();
+		m_gridProxies.clear();
+		m_cellKeys.clear();
+		m_cellStarts.clear();
+		m_cellMoved.clear();
+		m_cellTable.clear();
+		for (int i = 0; i < MAX_LEVELS + 2; ++i)
+		{
+			m_levelCellStarts[i] = 0;
+		}
+	}
+}
@@ -0,0 +1,142 @@
+/*
+Bullet Continuous Collision Detection and Physics Library
+Copyright (c) 2003-2018 Erwin Coumans  https://bulletphysics.org
+
+This software is provided 'as-is', without any express or implied warranty.
+In no event will the authors be held liable for any damages arising from the use of this software.
+Permission is granted to anyone to use this software for any purpose,
+including commercial applications, and to alter it and redistribute it freely,
+subject to the following restrictions:
+
+1. The origin of this software must not be misrepresented; you must not claim that you wrote the original software. If you use this software in a product, an acknowledgment in the product documentation would be appreciated but is not required.
+2. Altered source versions must be plainly marked as such, and must not be misrepresented as being the original software.
+3. This notice may not be removed or altered from any source distribution.
+*/
+
+#ifndef BT_GRID_BROADPHASE_H
+#define BT_GRID_BROADPHASE_H
+
+#include "btBroadphaseInterface.h"
+#include "btBroadphaseHandleTable.h"
+#include "btOverlappingPairCache.h"
+#include "LinearMath/btAlignedObjectArray.h"
+
+///The btGridBroadphase is a hierarchical hashed grid on the cpu, for scenes with many small objects of similar size, like
+///granular material, where it is cheaper than the tree updates of btDbvtBroadphase. It is the cpu counterpart of
+///b3GpuGridBroadphase and does not need a world size.
+///Each proxy goes, by the center of its aabb, into a cell of the first level whose cells are larger than the proxy. The cells
+///of level 0 have the size given to the constructor, or a power of two near the typical proxy size when it is 0, and each
+///level doubles it. Proxies too large for all levels share a single cell that overlaps everything.
+///calculateOverlappingPairs rebuilds the grid: the proxies are sorted by level and by the Morton code of their cell with a
+///parallel radix sort, so the cells close in space are close in memory, and a hash table maps the cells to their proxies.
+///Each cell is then tested, in btParallelFor tasks, against itself, half of its neighbor cells and the neighbor cells on the
+///coarser levels; only pairs with a proxy that moved since the last update are added. The pairs go to the pair cache in the
+///same order whatever the number of threads.
+///rayTest and aabbTest visit the cells along the ray or in the box on each level, the proxies created or moved since the last
+///update are tested one by one.
+class btGridBroadphase : public btBroadphaseInterface
+{
+public:
+	enum
+	{
+		MAX_LEVELS = 15,  // levels of cells, the level MAX_LEVELS is the single cell of the large proxies
+	};
+
+	struct SortKey
+	{
+		unsigned long long m_key;  // level in the top 4 bits, then the Morton code of the cell
+		int m_handle;
+		int m_padding;
+	};
+
+	// a proxy in the grid, in cell order
+	struct GridProxy
+	{
+		float m_min[3];
+		int m_handle;
+		float m_max[3];
+		int m_moved;
+		int m_coords[3];  // cell on its level
+		int m_level;
+	};
+
+	btBroadphaseHandleTable m_handleTable;     // the destroyed proxies stay in the grid until the next update
+	btAlignedObjectArray<int> m_dirtyHandles;  // created or moved since the last update, tested one by one by the queries
+
+	btAlignedObjectArray<SortKey> m_keys;
+	btAlignedObjectArray<SortKey> m_sortBuffer;
+	btAlignedObjectArray<int> m_radixCounts;
+	btAlignedObjectArray<GridProxy> m_gridProxies;             // the proxies of the grid, sorted by cell
+	btAlignedObjectArray<unsigned long long> m_cellKeys;       // the occupied cells, sorted
+	btAlignedObjectArray<int> m_cellStarts;                    // first proxy of each cell, and the number of proxies at the end
+	btAlignedObjectArray<int> m_cellMoved;                     // 1 for the cells with a proxy that moved
+	btAlignedObjectArray<int> m_cellTable;                     // open addressing hash table of the cell indices
+	int m_levelCellStarts[MAX_LEVELS + 2];                     // first cell of each level
+	btAlignedObjectArray<btAlignedObjectArray<btBroadphaseHandleProxy*> > m_blockPairs;  // per search block
+	btAlignedObjectArray<int> m_blockCounts;
+	btAlignedObjectArray<int> m_blockExponents;  // per block sums of the size exponents, for the automatic cell size
+
+	btOverlappingPairCache* m_pairCache;
+	bool m_ownsPairCache;
+	btScalar m_cellSize;         // cell size of level 0 given to the constructor, 0 for automatic
+	btScalar m_gridCellSize;     // cell size of level 0 of the current grid
+	int m_frame;                 // number of the next update
+	int m_numNewPairs;           // pairs found by the last update, including the ones already in the cache
+
+	btGridBroadphase(btScalar cellSize = 0, btOverlappingPairCache* pairCache = 0);
+	virtual ~btGridBroadphase();
+
+	virtual btBroadphaseProxy* createProxy(const btVector3& aabbMin, const btVector3& aabbMax, int shapeType, void* userPtr, int collisionFilterGroup, int collisionFilterMask, btDispatcher* dispatcher);
+	virtual void destroyProxy(btBroadphaseProxy* proxy, btDispatcher* dispatcher);
+	virtual void setAabb(btBroadphaseProxy* proxy, const btVector3& aabbMin, const btVector3& aabbMax, btDispatcher* dispatcher);
+	virtual void getAabb(btBroadphaseProxy* proxy, btVector3& aabbMin, btVector3& aabbMax) const;
+
+	virtual void rayTest(const btVector3& rayFrom, const btVector3& rayTo, btBroadphaseRayCallback& rayCallback, const btVector3& aabbMin = btVector3(0, 0, 0), const btVector3& aabbMax = btVector3(0, 0, 0));
+	virtual void aabbTest(const btVector3& aabbMin, const btVector3& aabbMax, btBroadphaseAabbCallback& callback);
+
+	///rebuilds the grid, adds the new overlapping pairs and removes the pairs that stopped overlapping
+	virtual void calculateOverlappingPairs(btDispatcher* dispatcher);
+
+	virtual btOverlappingPairCache* getOverlappingPairCache()
+	{
+		return m_pairCache;
+	}
+	virtual const btOverlappingPairCache* getOverlappingPairCache() const
+	{
+		return m_pairCache;
+	}
+
+	///getAabb returns the axis aligned bounding box in the 'global' coordinate frame
+	virtual void getBroadphaseAabb(btVector3& aabbMin, btVector3& aabbMax) const
+	{
+		aabbMin.setValue(-BT_LARGE_FLOAT, -BT_LARGE_FLOAT, -BT_LARGE_FLOAT);
+		aabbMax.setValue(BT_LARGE_FLOAT, BT_LARGE_FLOAT, BT_LARGE_FLOAT);
+	}
+
+	///reset broadphase internal structures, to ensure determinism/reproducability
+	virtual void resetPool(btDispatcher* dispatcher);
+
+	virtual void printStats()
+	{
+	}
+
+	int getNumProxies() const
+	{
+		return m_handleTable.getNumProxies();
+	}
+
+	int getNumCells() const
+	{
+		return m_cellKeys.size();
+	}
+
+	///index of the cell in m_cellKeys, -1 when it is empty
+	int findCell(unsigned long long key) const;
+
+protected:
+	btScalar chooseCellSize();
+	void buildGrid();
+	void findPairs(btDispatcher* dispatcher);
+};
+
+#endif  //BT_GRID_BROADPHASE_H
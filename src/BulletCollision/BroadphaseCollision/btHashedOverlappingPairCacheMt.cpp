@@ -0,0 +1,221 @@
+/*
+Bullet Continuous Collision Detection and Physics Library
+Copyright (c) 2003-2018 Erwin Coumans  https://bulletphysics.org
+
+This software is provided 'as-is', without any express or implied warranty.
+In no event will the authors be held liable for any damages arising from the use of this software.
+Permission is granted to anyone to use this software for any purpose,
+including commercial applications, and to alter it and redistribute it freely,
+subject to the following restrictions:
+
+1. The origin of this software must not be misrepresented; you must not claim that you wrote the original software. If you use this software in a product, an acknowledgment in the product documentation would be appreciated but is not required.
+2. Altered source versions must be plainly marked as such, and must not be misrepresented as being the original software.
+3. This notice may not be removed or altered from any source distribution.
+*/
+
+#include "btHashedOverlappingPairCacheMt.h"
+#include "LinearMath/btQuickprof.h"
+
+// entries a thread takes from the shared pool at once, so the pool counter is not hit for every pair
+static const int kConcurrentPairBlockSize = 64;
+
+static SIMD_FORCE_INLINE unsigned int concurrentPairHash(unsigned int proxyId1, unsigned int proxyId2)
+{
+	unsigned int key = proxyId1 * 73856093u ^ proxyId2 * 19349663u;
+	// Thomas Wang's hash, as in btHashedOverlappingPairCache
+	key += ~(key << 15);
+	key ^= (key >> 10);
+	key += (key << 3);
+	key ^= (key >> 6);
+	key += ~(key << 11);
+	key ^= (key >> 16);
+	return key;
+}
+
+// removals first, then additions, each in order of the proxy uids
+struct ConcurrentPairSortPredicate
+{
+	template <typename T>
+	bool operator()(const T& a, const T& b) const
+	{
+		if (a.m_remove != b.m_remove)
+		{
+			return a.m_remove > b.m_remove;
+		}
+		if (a.m_pProxy0->m_uniqueId != b.m_pProxy0->m_uniqueId)
+		{
+			return a.m_pProxy0->m_uniqueId < b.m_pProxy0->m_uniqueId;
+		}
+		return a.m_pProxy1->m_uniqueId < b.m_pProxy1->m_uniqueId;
+	}
+};
+
+btHashedOverlappingPairCacheMt::btHashedOverlappingPairCacheMt(int concurrentCapacity)
+{
+	m_numConcurrentPairs = 0;
+	m_numOverflows = 0;
+	for (int i = 0; i < int(BT_MAX_THREAD_COUNT); ++i)
+	{
+		m_threadEntries[i].m_next = 0;
+		m_threadEntries[i].m_end = 0;
+	}
+	reserveConcurrentPairs(concurrentCapacity);
+}
+
+btHashedOverlappingPairCacheMt::~btHashedOverlappingPairCacheMt()
+{
+}
+
+void btHashedOverlappingPairCacheMt::reserveConcurrentPairs(int count)
+{
+	btAssert(m_numConcurrentPairs == 0);
+	if (count <= m_concurrentPairs.size())
+	{
+		return;
+	}
+	m_concurrentPairs.resize(count);
+	// at least twice the entries, so the probing always finds an empty slot
+	int numSlots = 1;
+	while (numSlots < 2 * count)
+	{
+		numSlots <<= 1;
+	}
+	m_concurrentSlots.resize(0);
+	m_concurrentSlots.resize(numSlots, 0);
+}
+
+int btHashedOverlappingPairCacheMt::allocateConcurrentPair()
+{
+	ThreadEntries& entries = m_threadEntries[btGetCurrentThreadIndex()];
+	if (entries.m_next >= entries.m_end)
+	{
+		const int capacity = m_concurrentPairs.size();
+		int begin;
+		do
+		{
+			begin = m_numConcurrentPairs;
+			if (begin >= capacity)
+			{
+				return -1;
+			}
+		} while (!btAtomicCompareAndSwap(&m_numConcurrentPairs, begin, begin + kConcurrentPairBlockSize));
+		entries.m_next = begin;
+		entries.m_end = btMin(begin + kConcurrentPairBlockSize, capacity);
+		for (int i = entries.m_next; i < entries.m_end; ++i)
+		{
+			m_concurrentPairs[i].m_slot = -1;
+		}
+	}
+	return entries.m_next++;
+}
+
+void btHashedOverlappingPairCacheMt::recordConcurrentPair(btBroadphaseProxy* proxy0, btBroadphaseProxy* proxy1, int remove)
+{
+	if (proxy0->m_uniqueId > proxy1->m_uniqueId)
+		btSwap(proxy0, proxy1);
+
+	int index = allocateConcurrentPair();
+	if (index < 0)
+	{
+		ConcurrentPair overflow;
+		overflow.m_pProxy0 = proxy0;
+		overflow.m_pProxy1 = proxy1;
+		overflow.m_remove = remove;
+		overflow.m_slot = -1;
+		btMutexLock(&m_overflowMutex);
+		m_overflowPairs.push_back(overflow);
+		m_numOverflows++;
+		btMutexUnlock(&m_overflowMutex);
+		return;
+	}
+	ConcurrentPair& pair = m_concurrentPairs[index];
+	pair.m_pProxy0 = proxy0;
+	pair.m_pProxy1 = proxy1;
+	pair.m_remove = remove;
+
+	// linear probing, the compare and swap publishes the entry written above
+	const unsigned int mask = static_cast<unsigned int>(m_concurrentSlots.size() - 1);
+	unsigned int slot = concurrentPairHash(static_cast<unsigned int>(proxy0->getUid()), static_cast<unsigned int>(proxy1->getUid())) & mask;
+	for (;;)
+	{
+		if (btAtomicCompareAndSwap(&m_concurrentSlots[slot], 0, index + 1))
+		{
+			pair.m_slot = static_cast<int>(slot);
+			return;
+		}
+		// a claimed slot never changes until the flush
+		ConcurrentPair& other = m_concurrentPairs[m_concurrentSlots[slot] - 1];
+		if (other.m_pProxy0 == proxy0 && other.m_pProxy1 == proxy1)
+		{
+			// already recorded by another call, our entry stays unused
+			if (other.m_remove != remove)
+			{
+				other.m_remove = remove;
+			}
+			return;
+		}
+		slot = (slot + 1) & mask;
+	}
+}
+
+void btHashedOverlappingPairCacheMt::addOverlappingPairConcurrent(btBroadphaseProxy* proxy0, btBroadphaseProxy* proxy1)
+{
+	if (!needsBroadphaseCollision(proxy0, proxy1))
+		return;
+	// findPair only reads the pair array, which does not change until the flush
+	if (findPair(proxy0, proxy1))
+		return;
+	recordConcurrentPair(proxy0, proxy1, 0);
+}
+
+void btHashedOverlappingPairCacheMt::removeOverlappingPairConcurrent(btBroadphaseProxy* proxy0, btBroadphaseProxy* proxy1)
+{
+	if (!findPair(proxy0, proxy1))
+		return;
+	recordConcurrentPair(proxy0, proxy1, 1);
+}
+
+void btHashedOverlappingPairCacheMt::flushConcurrentPairs(btDispatcher* dispatcher)
+{
+	BT_PROFILE("flushConcurrentPairs");
+	m_flushPairs.resize(0);
+	const int numPairs = btMin(m_numConcurrentPairs, m_concurrentPairs.size());
+	for (int i = 0; i < numPairs; ++i)
+	{
+		const ConcurrentPair& pair = m_concurrentPairs[i];
+		if (pair.m_slot >= 0)
+		{
+			m_concurrentSlots[pair.m_slot] = 0;
+			m_flushPairs.push_back(pair);
+		}
+	}
+	for (int i = 0; i < m_overflowPairs.size(); ++i)
+	{
+		m_flushPairs.push_back(m_overflowPairs[i]);
+	}
+	m_flushPairs.quickSort(ConcurrentPairSortPredicate());
+	for (int i = 0; i < m_flushPairs.size(); ++i)
+	{
+		const ConcurrentPair& pair = m_flushPairs[i];
+		if (pair.m_remove)
+		{
+			removeOverlappingPair(pair.m_pProxy0, pair.m_pProxy1, dispatcher);
+		}
+		else
+		{
+			addOverlappingPair(pair.m_pProxy0, pair.m_pProxy1);
+		}
+	}
+
+	m_numConcurrentPairs = 0;
+	for (int i = 0; i < int(BT_MAX_THREAD_COUNT); ++i)
+	{
+		m_threadEntries[i].m_next = 0;
+		m_threadEntries[i].m_end = 0;
+	}
+	if (m_overflowPairs.size())
+	{
+		reserveConcurrentPairs(2 * (m_concurrentPairs.size() + m_overflowPairs.size()));
+		m_overflowPairs.resize(0);
+	}
+}
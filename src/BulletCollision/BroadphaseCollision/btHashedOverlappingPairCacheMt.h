@@ -0,0 +1,99 @@
+/*
+Bullet Continuous Collision Detection and Physics Library
+Copyright (c) 2003-2018 Erwin Coumans  https://bulletphysics.org
+
+This software is provided 'as-is', without any express or implied warranty.
+In no event will the authors be held liable for any damages arising from the use of this software.
+Permission is granted to anyone to use this software for any purpose,
+including commercial applications, and to alter it and redistribute it freely,
+subject to the following restrictions:
+
+1. The origin of this software must not be misrepresented; you must not claim that you wrote the original software. If you use this software in a product, an acknowledgment in the product documentation would be appreciated but is not required.
+2. Altered source versions must be plainly marked as such, and must not be misrepresented as being the original software.
+3. This notice may not be removed or altered from any source distribution.
+*/
+
+#ifndef BT_HASHED_OVERLAPPING_PAIR_CACHE_MT_H
+#define BT_HASHED_OVERLAPPING_PAIR_CACHE_MT_H
+
+#include "btOverlappingPairCache.h"
+#include "LinearMath/btThreads.h"
+
+///
+/// btHashedOverlappingPairCacheMt -- btHashedOverlappingPairCache that can add and remove pairs from several threads at once.
+///
+/// Between two calls of flushConcurrentPairs, any number of threads may call addOverlappingPairConcurrent and
+/// removeOverlappingPairConcurrent. These only read the pair array, changes are recorded in an open addressing hash table
+/// whose slots are claimed with an atomic compare and swap, no locks are taken. flushConcurrentPairs is the sync point:
+/// called from one thread when the concurrent work is done, it applies the removed pairs and then the added pairs in
+/// order of the proxy uids, so the pair array ends up the same whatever the number of threads and their timing.
+///
+/// During the concurrent phase the other methods must not be called, the overlap filter callback must be thread safe,
+/// and a pair is either added or removed, not both. When more changes are recorded than fit in the table, the rest go to
+/// an overflow list behind a spin mutex and the table grows at the next flush, see reserveConcurrentPairs.
+///
+ATTRIBUTE_ALIGNED16(class)
+btHashedOverlappingPairCacheMt : public btHashedOverlappingPairCache
+{
+	struct ConcurrentPair
+	{
+		btBroadphaseProxy* m_pProxy0;  // lower uid
+		btBroadphaseProxy* m_pProxy1;
+		int m_remove;                  // 0 to add the pair, 1 to remove it
+		int m_slot;                    // hash table slot, -1 if the entry is not used
+	};
+	struct ThreadEntries
+	{
+		int m_next;
+		int m_end;
+		char m_padding[64 - 2 * sizeof(int)];  // one cache line per thread
+	};
+
+	btAlignedObjectArray<ConcurrentPair> m_concurrentPairs;
+	btAlignedObjectArray<int> m_concurrentSlots;  // 0 if empty, else index into m_concurrentPairs + 1
+	int m_numConcurrentPairs;                     // entries handed out to the threads, in blocks
+	ThreadEntries m_threadEntries[BT_MAX_THREAD_COUNT];
+	btAlignedObjectArray<ConcurrentPair> m_overflowPairs;
+	btSpinMutex m_overflowMutex;
+	int m_numOverflows;
+	btAlignedObjectArray<ConcurrentPair> m_flushPairs;
+
+	int allocateConcurrentPair();
+	void recordConcurrentPair(btBroadphaseProxy * proxy0, btBroadphaseProxy * proxy1, int remove);
+
+public:
+	BT_DECLARE_ALIGNED_ALLOCATOR();
+
+	btHashedOverlappingPairCacheMt(int concurrentCapacity = 1024);
+	virtual ~btHashedOverlappingPairCacheMt();
+
+	virtual btHashedOverlappingPairCacheMt* getConcurrentPairCache()
+	{
+		return this;
+	}
+
+	///thread safe, the pair is added by the next flushConcurrentPairs unless it is already in the pair array
+	void addOverlappingPairConcurrent(btBroadphaseProxy * proxy0, btBroadphaseProxy * proxy1);
+
+	///thread safe, the pair is removed by the next flushConcurrentPairs
+	void removeOverlappingPairConcurrent(btBroadphaseProxy * proxy0, btBroadphaseProxy * proxy1);
+
+	///applies the recorded pairs, call from one thread when no concurrent calls are running
+	void flushConcurrentPairs(btDispatcher * dispatcher);
+
+	///makes room for 'count' pairs recorded between two flushes, call from one thread outside of the concurrent phase
+	void reserveConcurrentPairs(int count);
+
+	int getConcurrentCapacity() const
+	{
+		return m_concurrentPairs.size();
+	}
+
+	///number of pairs that went to the overflow list since the cache was created
+	int getNumConcurrentOverflows() const
+	{
+		return m_numOverflows;
+	}
+};
+
+#endif  //BT_HASHED_OVERLAPPING_PAIR_CACHE_MT_H
@@ -22,6 +22,7 @@ subject to the following restrictions:
 
 #include "LinearMath/btAlignedObjectArray.h"
 class btDispatcher;
+class btHashedOverlappingPairCacheMt;
 
 typedef btAlignedObjectArray<btBroadphasePair> btBroadphasePairArray;
 
@@ -80,6 +81,12 @@ public:
 	virtual void setInternalGhostPairCallback(btOverlappingPairCallback* ghostPairCallback) = 0;
 
 	virtual void sortOverlappingPairs(btDispatcher* dispatcher) = 0;
+
+	///returns this cache if pairs can be added and removed from several threads, see btHashedOverlappingPairCacheMt
+	virtual btHashedOverlappingPairCacheMt* getConcurrentPairCache()
+	{
+		return 0;
+	}
 };
 
 /// Hash-space based Pair Cache, thanks to Erin Catto, Box2D, http://www.box2d.org, and Pierre Terdiman, Codercorner, http://codercorner.com
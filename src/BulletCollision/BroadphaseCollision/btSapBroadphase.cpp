@@ -0,0 +1,561 @@
+/*
+Bullet Continuous Collision Detection and Physics Library
+Copyright (c) 2003-2018 Erwin Coumans  https://bulletphysics.org
+
+This software is provided 'as-is', without any express or implied warranty.
+In no event will the authors be held liable for any damages arising from the use of this software.
+Permission is granted to anyone to use this software for any purpose,
+including commercial applications, and to alter it and redistribute it freely,
+subject to the following restrictions:
+
+1. The origin of this software must not be misrepresented; you must not claim that you wrote the original software. If you use this software in a product, an acknowledgment in the product documentation would be appreciated but is not required.
+2. Altered source versions must be plainly marked as such, and must not be misrepresented as being the original software.
+3. This notice may not be removed or altered from any source distribution.
+*/
+
+#include "btSapBroadphase.h"
+#include "btBroadphaseRadixSort.h"
+#include "btHashedOverlappingPairCacheMt.h"
+#include "LinearMath/btAabbUtil2.h"
+#include "LinearMath/btThreads.h"
+#include "LinearMath/btQuickprof.h"
+#include <float.h>
+#include <string.h>
+
+static const int kSapBlockSize = 1024;      // proxies per task for the key and sorted array loops
+static const int kSapSweepBlockSize = 256;  // proxies per task for the sweep
+static const btScalar kSapAxisHysteresis = btScalar(1.2);  // the sort axis changes when another axis spreads this much more
+static const btScalar kSapSmallExtentFactor = btScalar(4);  // proxies up to this times the mean length on the sort axis are small
+
+// unsigned bits that sort like the float
+static SIMD_FORCE_INLINE unsigned int sapSortableBits(float f)
+{
+	unsigned int bits;
+	memcpy(&bits, &f, sizeof(bits));
+	return (bits & 0x80000000u) ? ~bits : (bits | 0x80000000u);
+}
+
+struct btSapKeyLoop : public btIParallelForBody
+{
+	btSapBroadphase* m_broadphase;
+
+	void forLoop(int iBegin, int iEnd) const BT_OVERRIDE
+	{
+		btSapBroadphase::SortKey* keys = &m_broadphase->m_keys[0];
+		const int numKeys = m_broadphase->m_keys.size();
+		const int axis = m_broadphase->m_axis;
+		const int frame = m_broadphase->m_frame;
+		const btBroadphaseHandleTable::HandleBounds* bounds = &m_broadphase->m_handleTable.m_handleBounds[0];
+		for (int iBlock = iBegin; iBlock < iEnd; ++iBlock)
+		{
+			int numMoved = 0;
+			int iEndKey = btMin(numKeys, (iBlock + 1) * kSapBlockSize);
+			for (int i = iBlock * kSapBlockSize; i < iEndKey; ++i)
+			{
+				const btBroadphaseHandleTable::HandleBounds& b = bounds[keys[i].m_handle];
+				keys[i].m_key = sapSortableBits(b.m_min[axis]);
+				numMoved += (b.m_movedFrame == frame) ? 1 : 0;
+			}
+			m_broadphase->m_blockCounts[iBlock] = numMoved;
+		}
+	}
+};
+
+struct btSapSortKeyPredicate
+{
+	bool operator()(const btSapBroadphase::SortKey& a, const btSapBroadphase::SortKey& b) const
+	{
+		return a.m_key < b.m_key || (a.m_key == b.m_key && a.m_handle < b.m_handle);
+	}
+};
+
+// sorts the first numKeys keys, returns false, with the keys still a permutation of the input, when more than
+// maxShifts shifts were needed
+static bool sapInsertionSort(btAlignedObjectArray<btSapBroadphase::SortKey>& keys, int numKeys, int maxShifts)
+{
+	int numShifts = 0;
+	for (int i = 1; i < numKeys; ++i)
+	{
+		btSapBroadphase::SortKey key = keys[i];
+		int j = i;
+		while (j > 0 && keys[j - 1].m_key > key.m_key)
+		{
+			keys[j] = keys[j - 1];
+			--j;
+		}
+		keys[j] = key;
+		numShifts += i - j;
+		if (numShifts > maxShifts)
+		{
+			return false;
+		}
+	}
+	return true;
+}
+
+// sorts the last numNewKeys keys on their own and merges them into the sorted keys before them
+static void sapMergeNewKeys(btAlignedObjectArray<btSapBroadphase::SortKey>& keys, int numNewKeys, btAlignedObjectArray<btSapBroadphase::SortKey>& sortBuffer)
+{
+	const int numKeys = keys.size();
+	const int numOldKeys = numKeys - numNewKeys;
+	sortBuffer.resizeNoInitialize(numNewKeys);
+	for (int i = 0; i < numNewKeys; ++i)
+	{
+		sortBuffer[i] = keys[numOldKeys + i];
+	}
+	sortBuffer.quickSort(btSapSortKeyPredicate());
+	// from the back, the old keys move up by at most numNewKeys
+	int iOld = numOldKeys - 1;
+	int iNew = numNewKeys - 1;
+	for (int i = numKeys - 1; iNew >= 0; --i)
+	{
+		if (iOld >= 0 && keys[iOld].m_key > sortBuffer[iNew].m_key)
+		{
+			keys[i] = keys[iOld--];
+		}
+		else
+		{
+			keys[i] = sortBuffer[iNew--];
+		}
+	}
+}
+
+struct btSapSortedArraysLoop : public btIParallelForBody
+{
+	btSapBroadphase* m_broadphase;
+
+	void forLoop(int iBegin, int iEnd) const BT_OVERRIDE
+	{
+		btSapBroadphase* bp = m_broadphase;
+		const int numKeys = bp->m_keys.size();
+		const int frame = bp->m_frame;
+		const int axis0 = bp->m_axis;
+		const int axis1 = (axis0 + 1) % 3;
+		const int axis2 = (axis0 + 2) % 3;
+		const btBroadphaseHandleTable::HandleBounds* bounds = &bp->m_handleTable.m_handleBounds[0];
+		for (int iBlock = iBegin; iBlock < iEnd; ++iBlock)
+		{
+			btScalar sums[7] = {0, 0, 0, 0, 0, 0, 0};
+			int iEndKey = btMin(numKeys, (iBlock + 1) * kSapBlockSize);
+			for (int i = iBlock * kSapBlockSize; i < iEndKey; ++i)
+			{
+				const btBroadphaseHandleTable::HandleBounds& b = bounds[bp->m_keys[i].m_handle];
+				bp->m_sortedMin[0][i] = b.m_min[axis0];
+				bp->m_sortedMax[0][i] = b.m_max[axis0];
+				bp->m_sortedMin[1][i] = b.m_min[axis1];
+				bp->m_sortedMax[1][i] = b.m_max[axis1];
+				bp->m_sortedMin[2][i] = b.m_min[axis2];
+				bp->m_sortedMax[2][i] = b.m_max[axis2];
+				bp->m_sortedMoved[i] = (b.m_movedFrame == frame) ? 1 : 0;
+				for (int k = 0; k < 3; ++k)
+				{
+					btScalar center = btScalar(b.m_min[k] + b.m_max[k]) * btScalar(0.5);
+					sums[k] += center;
+					sums[3 + k] += center * center;
+				}
+				sums[6] += b.m_max[axis0] - b.m_min[axis0];
+			}
+			for (int k = 0; k < 7; ++k)
+			{
+				bp->m_blockSums[iBlock * 7 + k] = sums[k];
+			}
+		}
+	}
+};
+
+struct btSapSweepLoop : public btIParallelForBody
+{
+	btSapBroadphase* m_broadphase;
+	btHashedOverlappingPairCacheMt* m_cache;
+
+	SIMD_FORCE_INLINE void addPair(int i, int j, btAlignedObjectArray<btBroadphaseHandleProxy*>& pairs, int& numPairs) const
+	{
+		const btAlignedObjectArray<btBroadphaseHandleProxy*>& handles = m_broadphase->m_handleTable.m_handles;
+		if (btBroadphaseHandleTable::addPair(m_cache, handles[m_broadphase->m_keys[i].m_handle], handles[m_broadphase->m_keys[j].m_handle], pairs))
+		{
+			++numPairs;
+		}
+	}
+
+	void forLoop(int iBegin, int iEnd) const BT_OVERRIDE
+	{
+		enum
+		{
+			BATCH_SIZE = btSapBroadphase::BATCH_SIZE
+		};
+		btSapBroadphase* bp = m_broadphase;
+		const int numKeys = bp->m_keys.size();
+		const float* minA = &bp->m_sortedMin[0][0];
+		const float* maxA = &bp->m_sortedMax[0][0];
+		const float* minB = &bp->m_sortedMin[1][0];
+		const float* maxB = &bp->m_sortedMax[1][0];
+		const float* minC = &bp->m_sortedMin[2][0];
+		const float* maxC = &bp->m_sortedMax[2][0];
+		const int* moved = &bp->m_sortedMoved[0];
+		const int* nextMoved = &bp->m_nextMoved[0];
+		const float* staticMax = &bp->m_staticMax[0];
+		const float smallExtent = bp->m_smallExtent;
+		for (int iBlock = iBegin; iBlock < iEnd; ++iBlock)
+		{
+			btAlignedObjectArray<btBroadphaseHandleProxy*>& pairs = bp->m_sweepPairs[iBlock];
+			pairs.resize(0);
+			int numPairs = 0;
+			int iEndKey = btMin(numKeys, (iBlock + 1) * kSapSweepBlockSize);
+			for (int i = iBlock * kSapSweepBlockSize; i < iEndKey; ++i)
+			{
+				const float maxAi = maxA[i];
+				const float minBi = minB[i];
+				const float maxBi = maxB[i];
+				const float minCi = minC[i];
+				const float maxCi = maxC[i];
+				// the proxies after i start at or after its minimum, they overlap on the sort axis until one starts after its maximum
+				if (!moved[i])
+				{
+					if (maxAi - minA[i] <= smallExtent)
+					{
+						// found by the backward pass of the moved proxies
+						continue;
+					}
+					// only the proxies that moved can make new pairs with this one
+					for (int j = nextMoved[i + 1]; j < numKeys && minA[j] <= maxAi; j = nextMoved[j + 1])
+					{
+						if (minB[j] <= maxBi && maxB[j] >= minBi && minC[j] <= maxCi && maxC[j] >= minCi)
+						{
+							addPair(i, j, pairs, numPairs);
+						}
+					}
+					continue;
+				}
+				for (int j = i + 1; j < numKeys; j += BATCH_SIZE)
+				{
+					int overlap[BATCH_SIZE];
+					for (int k = 0; k < BATCH_SIZE; ++k)
+					{
+						const int l = j + k;
+						overlap[k] = int(l < numKeys) & int(minA[l] <= maxAi) &
+									 int(minB[l] <= maxBi) & int(maxB[l] >= minBi) &
+									 int(minC[l] <= maxCi) & int(maxC[l] >= minCi);
+					}
+					for (int k = 0; k < BATCH_SIZE; ++k)
+					{
+						if (overlap[k])
+						{
+							addPair(i, j + k, pairs, numPairs);
+						}
+					}
+					if (!(minA[j + BATCH_SIZE - 1] <= maxAi))
+					{
+						break;
+					}
+				}
+				// the small proxies before i that did not move, until none of them reaches its minimum
+				const float minAi = minA[i];
+				for (int j = i - 1; j >= 0 && staticMax[j] >= minAi; j -= BATCH_SIZE)
+				{
+					int overlap[BATCH_SIZE];
+					for (int k = 0; k < BATCH_SIZE; ++k)
+					{
+						const int l = btMax(j - k, 0);
+						overlap[k] = int(j - k >= 0) & int(moved[l] == 0) & int(maxA[l] - minA[l] <= smallExtent) & int(maxA[l] >= minAi) &
+									 int(minB[l] <= maxBi) & int(maxB[l] >= minBi) &
+									 int(minC[l] <= maxCi) & int(maxC[l] >= minCi);
+					}
+					for (int k = 0; k < BATCH_SIZE; ++k)
+					{
+						if (overlap[k])
+						{
+							addPair(j - k, i, pairs, numPairs);
+						}
+					}
+				}
+			}
+			bp->m_blockCounts[iBlock] = numPairs;
+		}
+	}
+};
+
+btSapBroadphase::btSapBroadphase(btOverlappingPairCache* pairCache)
+{
+	m_pairCache = pairCache;
+	m_ownsPairCache = false;
+	if (!m_pairCache)
+	{
+		void* mem = btAlignedAlloc(sizeof(btHashedOverlappingPairCache), 16);
+		m_pairCache = new (mem) btHashedOverlappingPairCache();
+		m_ownsPairCache = true;
+	}
+	m_axis = 0;
+	m_frame = 1;
+	m_rebuildFraction = btScalar(0.25);
+	m_insertionShiftsPerProxy = 4;
+	m_numRebuilds = 0;
+	m_numIncrementalUpdates = 0;
+	m_numNewPairs = 0;
+	m_smallExtent = 0;
+}
+
+btSapBroadphase::~btSapBroadphase()
+{
+	if (m_ownsPairCache)
+	{
+		m_pairCache->~btOverlappingPairCache();
+		btAlignedFree(m_pairCache);
+	}
+}
+
+btBroadphaseProxy* btSapBroadphase::createProxy(const btVector3& aabbMin, const btVector3& aabbMax, int /*shapeType*/, void* userPtr, int collisionFilterGroup, int collisionFilterMask, btDispatcher* /*dispatcher*/)
+{
+	btBroadphaseHandleProxy* proxy = m_handleTable.createProxy(aabbMin, aabbMax, userPtr, collisionFilterGroup, collisionFilterMask, m_frame);
+	m_newHandles.push_back(proxy->m_handle);
+	return proxy;
+}
+
+void btSapBroadphase::destroyProxy(btBroadphaseProxy* proxy, btDispatcher* dispatcher)
+{
+	m_pairCache->removeOverlappingPairsContainingProxy(proxy, dispatcher);
+	// the handle is still in m_keys or m_newHandles, it is reused after the next update
+	m_handleTable.destroyProxy(static_cast<btBroadphaseHandleProxy*>(proxy));
+}
+
+void btSapBroadphase::setAabb(btBroadphaseProxy* proxy, const btVector3& aabbMin, const btVector3& aabbMax, btDispatcher* /*dispatcher*/)
+{
+	m_handleTable.setAabb(static_cast<btBroadphaseHandleProxy*>(proxy), aabbMin, aabbMax, m_frame);
+}
+
+void btSapBroadphase::getAabb(btBroadphaseProxy* proxy, btVector3& aabbMin, btVector3& aabbMax) const
+{
+	aabbMin = proxy->m_aabbMin;
+	aabbMax = proxy->m_aabbMax;
+}
+
+void btSapBroadphase::rayTest(const btVector3& rayFrom, const btVector3& /*rayTo*/, btBroadphaseRayCallback& rayCallback, const btVector3& aabbMin, const btVector3& aabbMax)
+{
+	for (int i = 0; i < m_handleTable.m_handles.size(); ++i)
+	{
+		btBroadphaseHandleProxy* proxy = m_handleTable.m_handles[i];
+		if (!proxy)
+		{
+			continue;
+		}
+		btVector3 bounds[2];
+		bounds[0] = proxy->m_aabbMin - aabbMax;
+		bounds[1] = proxy->m_aabbMax - aabbMin;
+		btScalar tmin = 1.f;
+		if (btRayAabb2(rayFrom, rayCallback.m_rayDirectionInverse, rayCallback.m_signs, bounds, tmin, 0, rayCallback.m_lambda_max))
+		{
+			rayCallback.process(proxy);
+		}
+	}
+}
+
+void btSapBroadphase::aabbTest(const btVector3& aabbMin, const btVector3& aabbMax, btBroadphaseAabbCallback& callback)
+{
+	for (int i = 0; i < m_handleTable.m_handles.size(); ++i)
+	{
+		btBroadphaseHandleProxy* proxy = m_handleTable.m_handles[i];
+		if (proxy && TestAabbAgainstAabb2(aabbMin, aabbMax, proxy->m_aabbMin, proxy->m_aabbMax))
+		{
+			callback.process(proxy);
+		}
+	}
+}
+
+// drops the destroyed proxies from m_keys, keeping the order of the others, appends the new ones and
+// computes the keys along m_axis. Returns the number of proxies that moved, new proxies included.
+int btSapBroadphase::updateKeys(int* numNewKeys)
+{
+	if (m_handleTable.m_pendingFreeHandles.size())
+	{
+		int numKeys = 0;
+		for (int i = 0; i < m_keys.size(); ++i)
+		{
+			if (m_handleTable.m_handles[m_keys[i].m_handle])
+			{
+				m_keys[numKeys++] = m_keys[i];
+			}
+		}
+		m_keys.resize(numKeys);
+		m_handleTable.releasePendingHandles();
+	}
+	*numNewKeys = 0;
+	for (int i = 0; i < m_newHandles.size(); ++i)
+	{
+		if (m_handleTable.m_handles[m_newHandles[i]])
+		{
+			SortKey key;
+			key.m_key = 0;
+			key.m_handle = m_newHandles[i];
+			m_keys.push_back(key);
+			(*numNewKeys)++;
+		}
+	}
+	m_newHandles.resize(0);
+
+	const int numBlocks = (m_keys.size() + kSapBlockSize - 1) / kSapBlockSize;
+	m_blockCounts.resizeNoInitialize(numBlocks);
+	btSapKeyLoop loop;
+	loop.m_broadphase = this;
+	btBroadphaseParallelFor(0, numBlocks, loop);
+	int numMoved = 0;
+	for (int i = 0; i < numBlocks; ++i)
+	{
+		numMoved += m_blockCounts[i];
+	}
+	return numMoved;
+}
+
+// the new proxies can go anywhere, they are sorted on their own and merged in after the insertion sort of the others
+void btSapBroadphase::sortKeys(bool rebuild, int numNewKeys)
+{
+	if (!rebuild && sapInsertionSort(m_keys, m_keys.size() - numNewKeys, m_insertionShiftsPerProxy * m_keys.size()))
+	{
+		if (numNewKeys)
+		{
+			sapMergeNewKeys(m_keys, numNewKeys, m_sortBuffer);
+		}
+		m_numIncrementalUpdates++;
+		return;
+	}
+	BT_PROFILE("btSapBroadphase::rebuild");
+	btBroadphaseRadixSort(m_keys, m_sortBuffer, m_radixCounts);
+	m_numRebuilds++;
+}
+
+void btSapBroadphase::buildSortedArrays()
+{
+	const int numKeys = m_keys.size();
+	for (int k = 0; k < 3; ++k)
+	{
+		m_sortedMin[k].resizeNoInitialize(numKeys + BATCH_SIZE);
+		m_sortedMax[k].resizeNoInitialize(numKeys + BATCH_SIZE);
+	}
+	m_sortedMoved.resizeNoInitialize(numKeys + BATCH_SIZE);
+	for (int i = numKeys; i < numKeys + BATCH_SIZE; ++i)
+	{
+		for (int k = 0; k < 3; ++k)
+		{
+			m_sortedMin[k][i] = FLT_MAX;
+			m_sortedMax[k][i] = -FLT_MAX;
+		}
+		m_sortedMoved[i] = 0;
+	}
+	const int numBlocks = (numKeys + kSapBlockSize - 1) / kSapBlockSize;
+	m_blockSums.resizeNoInitialize(numBlocks * 7);
+	btSapSortedArraysLoop loop;
+	loop.m_broadphase = this;
+	btBroadphaseParallelFor(0, numBlocks, loop);
+
+	// the proxies longer than a few times the mean on the sort axis look for their pairs forwards even when they did not move,
+	// so that the backward passes stay short
+	btScalar extentSum = 0;
+	for (int i = 0; i < numBlocks; ++i)
+	{
+		extentSum += m_blockSums[i * 7 + 6];
+	}
+	m_smallExtent = numKeys ? float(extentSum / numKeys * kSapSmallExtentFactor) : 0.f;
+	m_staticMax.resizeNoInitialize(numKeys);
+	float staticMax = -FLT_MAX;
+	for (int i = 0; i < numKeys; ++i)
+	{
+		if (!m_sortedMoved[i] && m_sortedMax[0][i] - m_sortedMin[0][i] <= m_smallExtent)
+		{
+			staticMax = btMax(staticMax, m_sortedMax[0][i]);
+		}
+		m_staticMax[i] = staticMax;
+	}
+
+	m_nextMoved.resizeNoInitialize(numKeys + 1);
+	m_nextMoved[numKeys] = numKeys;
+	for (int i = numKeys - 1; i >= 0; --i)
+	{
+		m_nextMoved[i] = m_sortedMoved[i] ? i : m_nextMoved[i + 1];
+	}
+}
+
+void btSapBroadphase::sweep(btDispatcher* dispatcher)
+{
+	BT_PROFILE("btSapBroadphase::sweep");
+	const int numBlocks = (m_keys.size() + kSapSweepBlockSize - 1) / kSapSweepBlockSize;
+	if (m_sweepPairs.size() < numBlocks)
+	{
+		m_sweepPairs.resize(numBlocks);
+	}
+	m_blockCounts.resizeNoInitialize(numBlocks);
+	btHashedOverlappingPairCacheMt* cache = m_pairCache->getConcurrentPairCache();
+	btSapSweepLoop loop;
+	loop.m_broadphase = this;
+	loop.m_cache = cache;
+	btBroadphaseParallelFor(0, numBlocks, loop);
+	if (cache)
+	{
+		cache->flushConcurrentPairs(dispatcher);
+	}
+	btBroadphaseHandleTable::addBlockPairs(m_pairCache, m_sweepPairs, numBlocks);
+	m_numNewPairs = 0;
+	for (int i = 0; i < numBlocks; ++i)
+	{
+		m_numNewPairs += m_blockCounts[i];
+	}
+}
+
+// the axis with the largest variance of the proxy centers at the last update, if it is clearly larger than
+// the variance along the current axis
+int btSapBroadphase::chooseAxis() const
+{
+	const int numKeys = m_keys.size();
+	if (numKeys < 2)
+	{
+		return m_axis;
+	}
+	btScalar sums[6] = {0, 0, 0, 0, 0, 0};
+	for (int i = 0; i < m_blockSums.size(); ++i)
+	{
+		if (i % 7 < 6)
+		{
+			sums[i % 7] += m_blockSums[i];
+		}
+	}
+	btScalar variance[3];
+	for (int k = 0; k < 3; ++k)
+	{
+		btScalar mean = sums[k] / numKeys;
+		variance[k] = sums[3 + k] / numKeys - mean * mean;
+	}
+	int axis = variance[0] > variance[1] ? (variance[0] > variance[2] ? 0 : 2) : (variance[1] > variance[2] ? 1 : 2);
+	return (variance[axis] > variance[m_axis] * kSapAxisHysteresis) ? axis : m_axis;
+}
+
+void btSapBroadphase::calculateOverlappingPairs(btDispatcher* dispatcher)
+{
+	BT_PROFILE("btSapBroadphase::calculateOverlappingPairs");
+	const int axis = chooseAxis();
+	const bool axisChanged = (axis != m_axis);
+	m_axis = axis;
+	int numNewKeys;
+	const int numMoved = updateKeys(&numNewKeys);
+	const int numKeys = m_keys.size();
+	if (numMoved > 0 || axisChanged)
+	{
+		sortKeys(axisChanged || numMoved > m_rebuildFraction * numKeys, numNewKeys);
+		buildSortedArrays();
+		sweep(dispatcher);
+		m_handleTable.removeSeparatedPairs(m_pairCache, m_frame, dispatcher);
+	}
+	else
+	{
+		m_numNewPairs = 0;
+	}
+	m_frame++;
+}
+
+void btSapBroadphase::resetPool(btDispatcher* /*dispatcher*/)
+{
+	if (getNumProxies() == 0)
+	{
+		m_handleTable.clear();
+		m_newHandles.clear();
+		m_keys.clear();
+		m_blockSums.clear();
+		m_axis = 0;
+	}
+}
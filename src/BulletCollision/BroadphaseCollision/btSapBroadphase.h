@@ -0,0 +1,126 @@
+/*
+Bullet Continuous Collision Detection and Physics Library
+Copyright (c) 2003-2018 Erwin Coumans  https://bulletphysics.org
+
+This software is provided 'as-is', without any express or implied warranty.
+In no event will the authors be held liable for any damages arising from the use of this software.
+Permission is granted to anyone to use this software for any purpose,
+including commercial applications, and to alter it and redistribute it freely,
+subject to the following restrictions:
+
+1. The origin of this software must not be misrepresented; you must not claim that you wrote the original software. If you use this software in a product, an acknowledgment in the product documentation would be appreciated but is not required.
+2. Altered source versions must be plainly marked as such, and must not be misrepresented as being the original software.
+3. This notice may not be removed or altered from any source distribution.
+*/
+
+#ifndef BT_SAP_BROADPHASE_H
+#define BT_SAP_BROADPHASE_H
+
+#include "btBroadphaseInterface.h"
+#include "btBroadphaseHandleTable.h"
+#include "btOverlappingPairCache.h"
+#include "LinearMath/btAlignedObjectArray.h"
+
+///The btSapBroadphase is a sweep and prune broadphase that keeps the proxies sorted along one axis without quantization
+///and without a world size, unlike btAxisSweep3.
+///Each calculateOverlappingPairs sorts the proxies by their minimum on the axis of the largest spread. When few proxies moved
+///the order of the last frame is fixed with an insertion sort; when many moved, or the insertion sort runs over its budget,
+///the axis is rebuilt with a parallel radix sort, so a scene where everything moves far at once does not degrade like the
+///incremental updates of btAxisSweep3. The sweep prunes on the two other axes in batches of BATCH_SIZE proxies, with
+///branch free loops over float arrays that the compiler vectorizes. Pairs are only looked for where at least one proxy moved,
+///a proxy that moved also looks backwards for the proxies that did not move and reach its minimum, a long proxy that did
+///not move visits the proxies that moved in its range.
+///The sweep runs in btParallelFor tasks, the pairs go to the pair cache in the same order whatever the number of threads.
+class btSapBroadphase : public btBroadphaseInterface
+{
+public:
+	enum
+	{
+		BATCH_SIZE = 8
+	};
+
+	struct SortKey
+	{
+		unsigned int m_key;  // minimum on the sort axis, as sortable bits
+		int m_handle;
+	};
+
+	btBroadphaseHandleTable m_handleTable;  // the destroyed proxies stay in m_keys until the next update
+	btAlignedObjectArray<int> m_newHandles;  // created since the last update, not in m_keys yet
+	btAlignedObjectArray<SortKey> m_keys;            // the proxies sorted along m_axis at the last update
+	btAlignedObjectArray<SortKey> m_sortBuffer;
+	btAlignedObjectArray<int> m_radixCounts;
+
+	// the sorted proxies as float arrays, padded with BATCH_SIZE entries that overlap nothing
+	btAlignedObjectArray<float> m_sortedMin[3];  // [0] is the sort axis
+	btAlignedObjectArray<float> m_sortedMax[3];
+	btAlignedObjectArray<int> m_sortedMoved;
+	btAlignedObjectArray<int> m_nextMoved;       // index of the first moved proxy at or after each sorted index
+	btAlignedObjectArray<float> m_staticMax;     // largest maximum of the small proxies that did not move, up to each sorted index
+	btAlignedObjectArray<btScalar> m_blockSums;  // per block center sums and squares, and length sums on the sort axis
+	btAlignedObjectArray<int> m_blockCounts;     // per block moved proxies, then pairs found
+
+	btAlignedObjectArray<btAlignedObjectArray<btBroadphaseHandleProxy*> > m_sweepPairs;  // per sweep block
+
+	btOverlappingPairCache* m_pairCache;
+	bool m_ownsPairCache;
+	int m_axis;                        // sort axis
+	int m_frame;                       // number of the next update
+	btScalar m_rebuildFraction;        // fraction of moved proxies from which the axis is rebuilt, default 0.25
+	int m_insertionShiftsPerProxy;     // the insertion sort gives up after this many shifts per proxy, default 4
+	int m_numRebuilds;                 // updates that used the radix sort
+	int m_numIncrementalUpdates;       // updates that used the insertion sort
+	int m_numNewPairs;                 // pairs found by the last sweep, including the ones already in the cache
+	float m_smallExtent;               // longest proxy on the sort axis that is found by the backward pass of the moved proxies
+
+	btSapBroadphase(btOverlappingPairCache* pairCache = 0);
+	virtual ~btSapBroadphase();
+
+	virtual btBroadphaseProxy* createProxy(const btVector3& aabbMin, const btVector3& aabbMax, int shapeType, void* userPtr, int collisionFilterGroup, int collisionFilterMask, btDispatcher* dispatcher);
+	virtual void destroyProxy(btBroadphaseProxy* proxy, btDispatcher* dispatcher);
+	virtual void setAabb(btBroadphaseProxy* proxy, const btVector3& aabbMin, const btVector3& aabbMax, btDispatcher* dispatcher);
+	virtual void getAabb(btBroadphaseProxy* proxy, btVector3& aabbMin, btVector3& aabbMax) const;
+
+	virtual void rayTest(const btVector3& rayFrom, const btVector3& rayTo, btBroadphaseRayCallback& rayCallback, const btVector3& aabbMin = btVector3(0, 0, 0), const btVector3& aabbMax = btVector3(0, 0, 0));
+	virtual void aabbTest(const btVector3& aabbMin, const btVector3& aabbMax, btBroadphaseAabbCallback& callback);
+
+	///sorts the proxies, adds the new overlapping pairs and removes the pairs that stopped overlapping
+	virtual void calculateOverlappingPairs(btDispatcher* dispatcher);
+
+	virtual btOverlappingPairCache* getOverlappingPairCache()
+	{
+		return m_pairCache;
+	}
+	virtual const btOverlappingPairCache* getOverlappingPairCache() const
+	{
+		return m_pairCache;
+	}
+
+	///getAabb returns the axis aligned bounding box in the 'global' coordinate frame
+	virtual void getBroadphaseAabb(btVector3& aabbMin, btVector3& aabbMax) const
+	{
+		aabbMin.setValue(-BT_LARGE_FLOAT, -BT_LARGE_FLOAT, -BT_LARGE_FLOAT);
+		aabbMax.setValue(BT_LARGE_FLOAT, BT_LARGE_FLOAT, BT_LARGE_FLOAT);
+	}
+
+	///reset broadphase internal structures, to ensure determinism/reproducability
+	virtual void resetPool(btDispatcher* dispatcher);
+
+	virtual void printStats()
+	{
+	}
+
+	int getNumProxies() const
+	{
+		return m_handleTable.getNumProxies();
+	}
+
+protected:
+	int updateKeys(int* numNewKeys);
+	void sortKeys(bool rebuild, int numNewKeys);
+	void buildSortedArrays();
+	void sweep(btDispatcher* dispatcher);
+	int chooseAxis() const;
+};
+
+#endif  //BT_SAP_BROADPHASE_H
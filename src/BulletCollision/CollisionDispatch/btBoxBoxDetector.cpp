@@ -264,6 +264,11 @@ void cullPoints2(int n, btScalar p[], int m, int i0, int iret[])
 	}
 }
 
+static int dBoxBoxContacts(const btVector3& p1, const dMatrix3 R1, const btScalar* A,
+						   const btVector3& p2, const dMatrix3 R2, const btScalar* B,
+						   const btVector3& normal, btScalar depth, int code,
+						   int maxc, btDiscreteCollisionDetectorInterface::Result& output);
+
 int dBoxBox2(const btVector3& p1, const dMatrix3 R1,
 			 const btVector3& side1, const btVector3& p2,
 			 const dMatrix3 R2, const btVector3& side2,
@@ -280,7 +285,7 @@ int dBoxBox2(const btVector3& p1, const dMatrix3 R1,
 	const btScalar* normalR = 0;
 	btScalar A[3], B[3], R11, R12, R13, R21, R22, R23, R31, R32, R33,
 		Q11, Q12, Q13, Q21, Q22, Q23, Q31, Q32, Q33, s, s2, l;
-	int i, j, invert_normal, code;
+	int invert_normal, code;
 
 	// get vector from centers of box 1 to box 2, relative to box 1
 	p = p2 - p1;
@@ -425,6 +430,23 @@ int dBoxBox2(const btVector3& p1, const dMatrix3 R1,
 	}
 	*depth = -s;
 
+	int cnum = dBoxBoxContacts(p1, R1, A, p2, R2, B, normal, *depth, code, maxc, output);
+	if (cnum)
+	{
+		*return_code = code;
+	}
+	return cnum;
+}
+
+// generate the contact point(s) of two interpenetrating boxes from the separating axis with the
+// smallest depth found by dBoxBox2. A and B are the half side lengths.
+static int dBoxBoxContacts(const btVector3& p1, const dMatrix3 R1, const btScalar* A,
+						   const btVector3& p2, const dMatrix3 R2, const btScalar* B,
+						   const btVector3& normal, btScalar depth, int code,
+						   int maxc, btDiscreteCollisionDetectorInterface::Result& output)
+{
+	int i, j;
+
 	// compute contact point(s)
 
 	if (code > 6)
@@ -466,12 +488,11 @@ int dBoxBox2(const btVector3& p1, const dMatrix3 R1,
 #ifdef USE_CENTER_POINT
 			for (i = 0; i < 3; i++)
 				pointInWorld[i] = (pa[i] + pb[i]) * btScalar(0.5);
-			output.addContactPoint(-normal, pointInWorld, -*depth);
+			output.addContactPoint(-normal, pointInWorld, -depth);
 #else
-			output.addContactPoint(-normal, pb, -*depth);
+			output.addContactPoint(-normal, pb, -depth);
 
 #endif  //
-			*return_code = code;
 		}
 		return 1;
 	}
@@ -723,7 +744,6 @@ int dBoxBox2(const btVector3& p1, const dMatrix3 R1,
 		cnum = maxc;
 	}
 
-	*return_code = code;
 	return cnum;
 }
 
@@ -765,3 +785,326 @@ void btBoxBoxDetector::getClosestPoints(const ClosestPointInput& input, Result&
 			 maxc, contact, skip,
 			 output);
 }
+
+// the separating axis test of dBoxBox2 without its early outs: every axis of every pair is tested, one pair
+// per lane, and the lane loops are branch free so that the compiler can turn them into SIMD code. The axis
+// code and sign are kept as btScalar for the same reason.
+struct btBoxBoxLanes
+{
+	enum
+	{
+		N = btBoxBoxDetector::BATCH_SIZE
+	};
+	btScalar pp[3][N];  // center of box 2 relative to box 1
+	btScalar q[3][N];   // same, along the axes of box 2
+	btScalar A[3][N];
+	btScalar B[3][N];
+	btScalar R[9][N];       // R1'*R2
+	btScalar Q[9][N];       // absolute values of R
+	btScalar length[9][N];  // lengths of the cross product axes, 1 if degenerate
+	btScalar penalty[9][N]; // infinite if degenerate, 0 otherwise
+	btScalar edgeDepth[9][N];
+	btScalar edgeInvert[9][N];
+	btScalar s[N];
+	btScalar maxFace[N];
+	btScalar maxEdge[N];
+	btScalar code[N];
+	btScalar invertNormal[N];
+};
+
+static SIMD_FORCE_INLINE void btBoxBoxTestFaceAxis(btBoxBoxLanes& lanes, int k, btScalar expr1, btScalar expr2, btScalar cc)
+{
+	btScalar s2 = btFabs(expr1) - expr2;
+	lanes.maxFace[k] = lanes.maxFace[k] > s2 ? lanes.maxFace[k] : s2;
+	btScalar invert = expr1 < 0 ? btScalar(1) : btScalar(0);
+	bool better = s2 > lanes.s[k];
+	lanes.s[k] = better ? s2 : lanes.s[k];
+	lanes.invertNormal[k] = better ? invert : lanes.invertNormal[k];
+	lanes.code[k] = better ? cc : lanes.code[k];
+}
+
+// the cross product axes take three passes: their depth, the scaling by the length of the axis and picking the
+// best one. A division that is only needed when the axis wins keeps the compiler from if-converting the loop,
+// for the same reason the normal of the winning edge axis is only built when scattering.
+static SIMD_FORCE_INLINE void btBoxBoxEdgeAxisDepth(btBoxBoxLanes& lanes, int axis, int k, btScalar expr1, btScalar expr2)
+{
+	btScalar s2 = btFabs(expr1) - expr2;
+	lanes.maxEdge[k] = lanes.maxEdge[k] > s2 ? lanes.maxEdge[k] : s2;
+	lanes.edgeDepth[axis][k] = s2;
+	lanes.edgeInvert[axis][k] = expr1 < 0 ? btScalar(1) : btScalar(0);
+}
+
+static SIMD_FORCE_INLINE void btBoxBoxTestEdgeAxis(btBoxBoxLanes& lanes, int axis, int k)
+{
+	const btScalar fudge_factor = btScalar(1.05);
+	btScalar s2 = lanes.edgeDepth[axis][k];
+	// a degenerate axis can't win
+	btScalar bestSoFar = lanes.s[k] + lanes.penalty[axis][k];
+	bool better = s2 * fudge_factor > bestSoFar;
+	lanes.s[k] = better ? s2 : lanes.s[k];
+	lanes.invertNormal[k] = better ? lanes.edgeInvert[axis][k] : lanes.invertNormal[k];
+	lanes.code[k] = better ? btScalar(7 + axis) : lanes.code[k];
+}
+
+void btBoxBoxDetector::getSeparatingAxes(const BatchInput* inputs, int numPairs, SeparatingAxis* axesOut)
+{
+	btAssert(numPairs <= BATCH_SIZE);
+	const int N = btBoxBoxLanes::N;
+	btBoxBoxLanes lanes;
+	int k;
+
+	// gather, unused lanes get a copy of the first pair
+	for (k = 0; k < N; k++)
+	{
+		const BatchInput& input = inputs[k < numPairs ? k : 0];
+		const btMatrix3x3& basisA = input.m_transformA->getBasis();
+		const btMatrix3x3& basisB = input.m_transformB->getBasis();
+		btVector3 p = input.m_transformB->getOrigin() - input.m_transformA->getOrigin();
+		btVector3 halfA = input.m_box1->getHalfExtentsWithMargin();
+		btVector3 halfB = input.m_box2->getHalfExtentsWithMargin();
+		for (int i = 0; i < 3; i++)
+		{
+			lanes.pp[i][k] = basisA[0][i] * p[0] + basisA[1][i] * p[1] + basisA[2][i] * p[2];
+			lanes.q[i][k] = basisB[0][i] * p[0] + basisB[1][i] * p[1] + basisB[2][i] * p[2];
+			// same rounding as the side lengths passed to dBoxBox2
+			lanes.A[i][k] = (btScalar(2.) * halfA[i]) * btScalar(0.5);
+			lanes.B[i][k] = (btScalar(2.) * halfB[i]) * btScalar(0.5);
+			for (int j = 0; j < 3; j++)
+			{
+				lanes.R[i * 3 + j][k] = basisA[0][i] * basisB[0][j] + basisA[1][i] * basisB[1][j] + basisA[2][i] * basisB[2][j];
+			}
+		}
+	}
+
+	const btScalar(*A)[N] = lanes.A;
+	const btScalar(*B)[N] = lanes.B;
+	const btScalar(*R)[N] = lanes.R;
+	btScalar(*Q)[N] = lanes.Q;
+	const btScalar(*pp)[N] = lanes.pp;
+	const btScalar(*q)[N] = lanes.q;
+
+	for (int i = 0; i < 9; i++)
+	{
+		for (k = 0; k < N; k++)
+		{
+			Q[i][k] = btFabs(R[i][k]);
+		}
+	}
+	// the axis u(i) x v(j) is (0, -R(3,j), R(2,j)) for i = 1 and so on, its length only depends on the other two rows
+	for (int i = 0; i < 3; i++)
+	{
+		int row1 = (i + 1) % 3;
+		int row2 = (i + 2) % 3;
+		for (int j = 0; j < 3; j++)
+		{
+			for (k = 0; k < N; k++)
+			{
+				btScalar a = R[row1 * 3 + j][k];
+				btScalar b = R[row2 * 3 + j][k];
+				lanes.length[i * 3 + j][k] = a * a + b * b;
+			}
+		}
+	}
+	// kept out of the lane loops below, btSqrt can be a library call
+	for (int i = 0; i < 9; i++)
+	{
+		for (k = 0; k < N; k++)
+		{
+			lanes.length[i][k] = btSqrt(lanes.length[i][k]);
+		}
+	}
+	// worked out up front, dividing by a length picked in the loops below gets compiled into a branch
+	for (int i = 0; i < 9; i++)
+	{
+		for (k = 0; k < N; k++)
+		{
+			bool valid = lanes.length[i][k] > SIMD_EPSILON;
+			lanes.penalty[i][k] = valid ? btScalar(0) : SIMD_INFINITY;
+			lanes.length[i][k] = valid ? lanes.length[i][k] : btScalar(1);
+		}
+	}
+
+	for (k = 0; k < N; k++)
+	{
+		lanes.s[k] = -dInfinity;
+		lanes.maxFace[k] = -dInfinity;
+		lanes.maxEdge[k] = -dInfinity;
+		lanes.code[k] = 0;
+		lanes.invertNormal[k] = 0;
+	}
+
+	// separating axis = u1,u2,u3
+	for (k = 0; k < N; k++)
+	{
+		btBoxBoxTestFaceAxis(lanes, k, pp[0][k], (A[0][k] + B[0][k] * Q[0][k] + B[1][k] * Q[1][k] + B[2][k] * Q[2][k]), 1);
+		btBoxBoxTestFaceAxis(lanes, k, pp[1][k], (A[1][k] + B[0][k] * Q[3][k] + B[1][k] * Q[4][k] + B[2][k] * Q[5][k]), 2);
+		btBoxBoxTestFaceAxis(lanes, k, pp[2][k], (A[2][k] + B[0][k] * Q[6][k] + B[1][k] * Q[7][k] + B[2][k] * Q[8][k]), 3);
+	}
+	// separating axis = v1,v2,v3
+	for (k = 0; k < N; k++)
+	{
+		btBoxBoxTestFaceAxis(lanes, k, q[0][k], (A[0][k] * Q[0][k] + A[1][k] * Q[3][k] + A[2][k] * Q[6][k] + B[0][k]), 4);
+		btBoxBoxTestFaceAxis(lanes, k, q[1][k], (A[0][k] * Q[1][k] + A[1][k] * Q[4][k] + A[2][k] * Q[7][k] + B[1][k]), 5);
+		btBoxBoxTestFaceAxis(lanes, k, q[2][k], (A[0][k] * Q[2][k] + A[1][k] * Q[5][k] + A[2][k] * Q[8][k] + B[2][k]), 6);
+	}
+
+	btScalar fudge2(1.0e-5f);
+	for (int i = 0; i < 9; i++)
+	{
+		for (k = 0; k < N; k++)
+		{
+			Q[i][k] += fudge2;
+		}
+	}
+
+	// separating axis = u1 x (v1,v2,v3)
+	for (k = 0; k < N; k++)
+	{
+		btBoxBoxEdgeAxisDepth(lanes, 0, k, pp[2][k] * R[3][k] - pp[1][k] * R[6][k], (A[1][k] * Q[6][k] + A[2][k] * Q[3][k] + B[1][k] * Q[2][k] + B[2][k] * Q[1][k]));
+	}
+	for (k = 0; k < N; k++)
+	{
+		btBoxBoxEdgeAxisDepth(lanes, 1, k, pp[2][k] * R[4][k] - pp[1][k] * R[7][k], (A[1][k] * Q[7][k] + A[2][k] * Q[4][k] + B[0][k] * Q[2][k] + B[2][k] * Q[0][k]));
+	}
+	for (k = 0; k < N; k++)
+	{
+		btBoxBoxEdgeAxisDepth(lanes, 2, k, pp[2][k] * R[5][k] - pp[1][k] * R[8][k], (A[1][k] * Q[8][k] + A[2][k] * Q[5][k] + B[0][k] * Q[1][k] + B[1][k] * Q[0][k]));
+	}
+	// separating axis = u2 x (v1,v2,v3)
+	for (k = 0; k < N; k++)
+	{
+		btBoxBoxEdgeAxisDepth(lanes, 3, k, pp[0][k] * R[6][k] - pp[2][k] * R[0][k], (A[0][k] * Q[6][k] + A[2][k] * Q[0][k] + B[1][k] * Q[5][k] + B[2][k] * Q[4][k]));
+	}
+	for (k = 0; k < N; k++)
+	{
+		btBoxBoxEdgeAxisDepth(lanes, 4, k, pp[0][k] * R[7][k] - pp[2][k] * R[1][k], (A[0][k] * Q[7][k] + A[2][k] * Q[1][k] + B[0][k] * Q[5][k] + B[2][k] * Q[3][k]));
+	}
+	for (k = 0; k < N; k++)
+	{
+		btBoxBoxEdgeAxisDepth(lanes, 5, k, pp[0][k] * R[8][k] - pp[2][k] * R[2][k], (A[0][k] * Q[8][k] + A[2][k] * Q[2][k] + B[0][k] * Q[4][k] + B[1][k] * Q[3][k]));
+	}
+	// separating axis = u3 x (v1,v2,v3)
+	for (k = 0; k < N; k++)
+	{
+		btBoxBoxEdgeAxisDepth(lanes, 6, k, pp[1][k] * R[0][k] - pp[0][k] * R[3][k], (A[0][k] * Q[3][k] + A[1][k] * Q[0][k] + B[1][k] * Q[8][k] + B[2][k] * Q[7][k]));
+	}
+	for (k = 0; k < N; k++)
+	{
+		btBoxBoxEdgeAxisDepth(lanes, 7, k, pp[1][k] * R[1][k] - pp[0][k] * R[4][k], (A[0][k] * Q[4][k] + A[1][k] * Q[1][k] + B[0][k] * Q[8][k] + B[2][k] * Q[6][k]));
+	}
+	for (k = 0; k < N; k++)
+	{
+		btBoxBoxEdgeAxisDepth(lanes, 8, k, pp[1][k] * R[2][k] - pp[0][k] * R[5][k], (A[0][k] * Q[5][k] + A[1][k] * Q[2][k] + B[0][k] * Q[7][k] + B[1][k] * Q[6][k]));
+	}
+
+	for (int axis = 0; axis < 9; axis++)
+	{
+		for (k = 0; k < N; k++)
+		{
+			lanes.edgeDepth[axis][k] /= lanes.length[axis][k];
+		}
+	}
+	for (int axis = 0; axis < 9; axis++)
+	{
+		for (k = 0; k < N; k++)
+		{
+			btBoxBoxTestEdgeAxis(lanes, axis, k);
+		}
+	}
+
+	// scatter, the normal is computed in global coordinates like dBoxBox2 does
+	for (k = 0; k < numPairs; k++)
+	{
+		SeparatingAxis& axis = axesOut[k];
+		int code = int(lanes.code[k]);
+		if (lanes.maxFace[k] > 0 || lanes.maxEdge[k] > SIMD_EPSILON)
+		{
+			code = 0;
+		}
+		axis.m_code = code;
+		if (!code)
+		{
+			axis.m_normal.setValue(0, 0, 0);
+			axis.m_depth = 0;
+			continue;
+		}
+		const btMatrix3x3& basisA = inputs[k].m_transformA->getBasis();
+		const btMatrix3x3& basisB = inputs[k].m_transformB->getBasis();
+		btVector3 normal;
+		if (code <= 3)
+		{
+			normal.setValue(basisA[0][code - 1], basisA[1][code - 1], basisA[2][code - 1]);
+		}
+		else if (code <= 6)
+		{
+			normal.setValue(basisB[0][code - 4], basisB[1][code - 4], basisB[2][code - 4]);
+		}
+		else
+		{
+			// the cross product axis relative to box 1, as in dBoxBox2
+			int i = (code - 7) / 3;
+			int j = (code - 7) % 3;
+			btScalar l = lanes.length[code - 7][k];
+			btVector3 normalC;
+			if (i == 0)
+			{
+				normalC.setValue(0, -lanes.R[6 + j][k], lanes.R[3 + j][k]);
+			}
+			else if (i == 1)
+			{
+				normalC.setValue(lanes.R[6 + j][k], 0, -lanes.R[j][k]);
+			}
+			else
+			{
+				normalC.setValue(-lanes.R[3 + j][k], lanes.R[j][k], 0);
+			}
+			normalC[0] /= l;
+			normalC[1] /= l;
+			normalC[2] /= l;
+			normal.setValue(basisA[0].dot(normalC), basisA[1].dot(normalC), basisA[2].dot(normalC));
+		}
+		if (lanes.invertNormal[k] != 0)
+		{
+			normal = -normal;
+		}
+		axis.m_normal = normal;
+		axis.m_depth = -lanes.s[k];
+	}
+}
+
+void btBoxBoxDetector::getClosestPoints(const ClosestPointInput& input, const SeparatingAxis& axis, Result& output)
+{
+	if (!axis.m_code)
+	{
+		return;
+	}
+	const btTransform& transformA = input.m_transformA;
+	const btTransform& transformB = input.m_transformB;
+
+	dMatrix3 R1;
+	dMatrix3 R2;
+
+	for (int j = 0; j < 3; j++)
+	{
+		R1[0 + 4 * j] = transformA.getBasis()[j].x();
+		R2[0 + 4 * j] = transformB.getBasis()[j].x();
+
+		R1[1 + 4 * j] = transformA.getBasis()[j].y();
+		R2[1 + 4 * j] = transformB.getBasis()[j].y();
+
+		R1[2 + 4 * j] = transformA.getBasis()[j].z();
+		R2[2 + 4 * j] = transformB.getBasis()[j].z();
+	}
+
+	btVector3 side1 = 2.f * m_box1->getHalfExtentsWithMargin();
+	btVector3 side2 = 2.f * m_box2->getHalfExtentsWithMargin();
+	btScalar A[3], B[3];
+	for (int i = 0; i < 3; i++)
+	{
+		A[i] = side1[i] * btScalar(0.5);
+		B[i] = side2[i] * btScalar(0.5);
+	}
+	int maxc = 4;
+
+	dBoxBoxContacts(transformA.getOrigin(), R1, A, transformB.getOrigin(), R2, B, axis.m_normal, axis.m_depth, axis.m_code, maxc, output);
+}
@@ -35,6 +35,36 @@ public:
 	virtual ~btBoxBoxDetector(){};
 
 	virtual void getClosestPoints(const ClosestPointInput& input, Result& output, class btIDebugDraw* debugDraw, bool swapResults = false);
+
+	///number of box pairs getSeparatingAxes works on side by side
+	enum
+	{
+		BATCH_SIZE = 8
+	};
+
+	struct BatchInput
+	{
+		const btBoxShape* m_box1;
+		const btBoxShape* m_box2;
+		const btTransform* m_transformA;
+		const btTransform* m_transformB;
+	};
+
+	///result of the separating axis test of a box pair. m_code is 0 if the boxes are apart, 1..6 for a face
+	///of box 1 or 2 and 7..15 for an edge-edge contact, m_normal points from box 1 to box 2
+	struct SeparatingAxis
+	{
+		btVector3 m_normal;
+		btScalar m_depth;
+		int m_code;
+	};
+
+	///runs the 15 separating axis tests of up to BATCH_SIZE box pairs at once, laid out so that the compiler can
+	///keep every pair in its own SIMD lane. Gives the same result as getClosestPoints does internally.
+	static void getSeparatingAxes(const BatchInput* inputs, int numPairs, SeparatingAxis* axesOut);
+
+	///generates the contact points of the boxes from the result of getSeparatingAxes
+	void getClosestPoints(const ClosestPointInput& input, const SeparatingAxis& axis, Result& output);
 };
 
 #endif  //BT_BOX_BOX_DETECTOR_H
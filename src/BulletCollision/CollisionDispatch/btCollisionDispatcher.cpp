@@ -30,6 +30,9 @@ subject to the following restrictions:
 #endif
 #include <BulletCable/btCable.h>
 
+// the points of a manifold start on a cache line
+static const int kManifoldPointAlignment = 64;
+
 btCollisionDispatcher::btCollisionDispatcher(btCollisionConfiguration* collisionConfiguration) : m_dispatcherFlags(btCollisionDispatcher::CD_USE_RELATIVE_CONTACT_BREAKING_THRESHOLD),
 																								 m_collisionConfiguration(collisionConfiguration)
 {
@@ -41,6 +44,11 @@ btCollisionDispatcher::btCollisionDispatcher(btCollisionConfiguration* collision
 
 	m_persistentManifoldPoolAllocator = collisionConfiguration->getPersistentManifoldPool();
 
+	// one element per manifold of the manifold pool, for the MANIFOLD_CACHE_SIZE points of a rigid body manifold
+	int pointsSize = (MANIFOLD_CACHE_SIZE * sizeof(btManifoldPoint) + kManifoldPointAlignment - 1) & ~(kManifoldPointAlignment - 1);
+	void* mem = btAlignedAlloc(sizeof(btPoolAllocator), 16);
+	m_manifoldPointPoolAllocator = new (mem) btPoolAllocator(pointsSize, m_persistentManifoldPoolAllocator->getMaxCount(), kManifoldPointAlignment);
+
 	for (i = 0; i < MAX_BROADPHASE_COLLISION_TYPES; i++)
 	{
 		for (int j = 0; j < MAX_BROADPHASE_COLLISION_TYPES; j++)
@@ -64,6 +72,37 @@ void btCollisionDispatcher::registerClosestPointsCreateFunc(int proxyType0, int
 
 btCollisionDispatcher::~btCollisionDispatcher()
 {
+	m_manifoldPointPoolAllocator->~btPoolAllocator();
+	btAlignedFree(m_manifoldPointPoolAllocator);
+}
+
+btPersistentManifold* btCollisionDispatcher::constructManifold(void* mem, const btCollisionObject* body0, const btCollisionObject* body1, btScalar contactBreakingThreshold, btScalar contactProcessingThreshold, int cacheSize)
+{
+	void* pointMem = 0;
+	if ((m_dispatcherFlags & CD_DISABLE_MANIFOLD_POINT_POOL) == 0 && cacheSize * int(sizeof(btManifoldPoint)) <= m_manifoldPointPoolAllocator->getElementSize())
+	{
+		pointMem = m_manifoldPointPoolAllocator->allocate(cacheSize * sizeof(btManifoldPoint));
+	}
+	if (NULL == pointMem)
+	{
+		return new (mem) btPersistentManifold(body0, body1, 0, contactBreakingThreshold, contactProcessingThreshold, cacheSize);
+	}
+	btManifoldPoint* points = (btManifoldPoint*)pointMem;
+	for (int i = 0; i < cacheSize; i++)
+	{
+		new (&points[i]) btManifoldPoint();
+	}
+	return new (mem) btPersistentManifold(body0, body1, 0, contactBreakingThreshold, contactProcessingThreshold, points, cacheSize);
+}
+
+void btCollisionDispatcher::freeManifoldPoints(btPersistentManifold* manifold)
+{
+	btManifoldPoint* points = manifold->getPointCache();
+	manifold->freeContactPoint();
+	if (m_manifoldPointPoolAllocator->validPtr(points))
+	{
+		m_manifoldPointPoolAllocator->freeMemory(points);
+	}
 }
 
 btPersistentManifold* btCollisionDispatcher::getNewManifold(const btCollisionObject* body0, const btCollisionObject* body1)
@@ -94,12 +133,12 @@ btPersistentManifold* btCollisionDispatcher::getNewManifold(const btCollisionObj
 	}
 	btPersistentManifold* manifold;
 	if (body0->getInternalType() == 2 && body1->getInternalType() == 2)
-		manifold = new (mem) btPersistentManifold(body0, body1, 0, contactBreakingThreshold, contactProcessingThreshold);
+		manifold = constructManifold(mem, body0, body1, contactBreakingThreshold, contactProcessingThreshold, MANIFOLD_CACHE_SIZE);
 	else
 	{
 		// Softbody always first
 		btSoftBody* temp = (btSoftBody*)body0;
-		manifold = new (mem) btPersistentManifold(body0, body1, 0, contactBreakingThreshold, contactProcessingThreshold,1024);
+		manifold = constructManifold(mem, body0, body1, contactBreakingThreshold, contactProcessingThreshold, 1024);
 	
 	}
 
@@ -124,7 +163,7 @@ void btCollisionDispatcher::releaseManifold(btPersistentManifold* manifold)
 	m_manifoldsPtr[findIndex]->m_hasCollided = false;
 	m_manifoldsPtr.pop_back();
 
-	manifold->freeContactPoint();
+	freeManifoldPoints(manifold);
 	if (m_persistentManifoldPoolAllocator->validPtr(manifold))
 	{
 		m_persistentManifoldPoolAllocator->freeMemory(manifold);
@@ -54,18 +54,29 @@ protected:
 
 	btPoolAllocator* m_persistentManifoldPoolAllocator;
 
+	///cache line aligned storage of the contact points of the manifolds, so the points of the manifolds are packed together
+	///instead of in separate heap blocks
+	btPoolAllocator* m_manifoldPointPoolAllocator;
+
 	btCollisionAlgorithmCreateFunc* m_doubleDispatchContactPoints[MAX_BROADPHASE_COLLISION_TYPES][MAX_BROADPHASE_COLLISION_TYPES];
 
 	btCollisionAlgorithmCreateFunc* m_doubleDispatchClosestPoints[MAX_BROADPHASE_COLLISION_TYPES][MAX_BROADPHASE_COLLISION_TYPES];
 
 	btCollisionConfiguration* m_collisionConfiguration;
 
+	///constructs a manifold in mem with cacheSize points from the point pool, or from the heap when they do not fit
+	btPersistentManifold* constructManifold(void* mem, const btCollisionObject* body0, const btCollisionObject* body1, btScalar contactBreakingThreshold, btScalar contactProcessingThreshold, int cacheSize);
+
+	///frees the contact points of a manifold, to the point pool when they came from it
+	void freeManifoldPoints(btPersistentManifold* manifold);
+
 public:
 	enum DispatcherFlags
 	{
 		CD_STATIC_STATIC_REPORTED = 1,
 		CD_USE_RELATIVE_CONTACT_BREAKING_THRESHOLD = 2,
-		CD_DISABLE_CONTACTPOOL_DYNAMIC_ALLOCATION = 4
+		CD_DISABLE_CONTACTPOOL_DYNAMIC_ALLOCATION = 4,
+		CD_DISABLE_MANIFOLD_POINT_POOL = 8  // allocate the points of each new manifold on the heap
 	};
 
 	int getDispatcherFlags() const
@@ -167,6 +178,16 @@ public:
 		return m_persistentManifoldPoolAllocator;
 	}
 
+	btPoolAllocator* getInternalManifoldPointPool()
+	{
+		return m_manifoldPointPoolAllocator;
+	}
+
+	const btPoolAllocator* getInternalManifoldPointPool() const
+	{
+		return m_manifoldPointPoolAllocator;
+	}
+
 	virtual void releaseAllCachedManifolds() override;
 	virtual void releaseCachedManifold(btPersistentManifold* manifold) override;
 	virtual int getNumManifoldsCache() const override;
@@ -24,6 +24,9 @@ subject to the following restrictions:
 #include "LinearMath/btPoolAllocator.h"
 #include "BulletCollision/CollisionDispatch/btCollisionConfiguration.h"
 #include "BulletCollision/CollisionDispatch/btCollisionObjectWrapper.h"
+#include "BulletCollision/CollisionDispatch/btManifoldResult.h"
+#include "BulletCollision/CollisionDispatch/btBoxBoxDetector.h"
+#include "BulletCollision/CollisionShapes/btBoxShape.h"
 #include <BulletCable/btCable.h>
 
 btCollisionDispatcherMt::btCollisionDispatcherMt(btCollisionConfiguration* config, int grainSize)
@@ -34,6 +37,7 @@ btCollisionDispatcherMt::btCollisionDispatcherMt(btCollisionConfiguration* confi
 
 	m_batchUpdating = false;
 	m_grainSize = grainSize;  // iterations per task
+	m_batchBoxBoxPairs = false;
 }
 
 btPersistentManifold* btCollisionDispatcherMt::getNewManifold(const btCollisionObject* body0, const btCollisionObject* body1)
@@ -63,12 +67,12 @@ btPersistentManifold* btCollisionDispatcherMt::getNewManifold(const btCollisionO
 	// RigidBody only
 	btPersistentManifold* manifold;
 	if (body0->getInternalType() == 2 && body1->getInternalType() == 2) 
- 		manifold = new (mem) btPersistentManifold(body0, body1, 0, contactBreakingThreshold, contactProcessingThreshold);
+ 		manifold = constructManifold(mem, body0, body1, contactBreakingThreshold, contactProcessingThreshold, MANIFOLD_CACHE_SIZE);
 	else
 	{
 		// Softbody always first
 		btSoftBody* temp = (btSoftBody*)body0;
-		manifold = new (mem) btPersistentManifold(body0, body1, 0, contactBreakingThreshold, contactProcessingThreshold, temp->m_nodes.size());
+		manifold = constructManifold(mem, body0, body1, contactBreakingThreshold, contactProcessingThreshold, temp->m_nodes.size());
 	}
 	if (!m_batchUpdating)
 	{
@@ -106,7 +110,7 @@ void btCollisionDispatcherMt::releaseManifold(btPersistentManifold* manifold)
 		return;
 	}
 
-	manifold->freeContactPoint();
+	freeManifoldPoints(manifold);
 	if (m_persistentManifoldPoolAllocator->validPtr(manifold))
 	{
 		m_persistentManifoldPoolAllocator->freeMemory(manifold);
@@ -203,6 +207,7 @@ struct CollisionDispatcherUpdater : public btIParallelForBody
 	btNearCallback mCallback;
 	btCollisionDispatcher* mDispatcher;
 	const btDispatcherInfo* mInfo;
+	bool mBatchBoxBoxPairs;
 
 	CollisionDispatcherUpdater()
 	{
@@ -210,13 +215,95 @@ struct CollisionDispatcherUpdater : public btIParallelForBody
 		mCallback = NULL;
 		mDispatcher = NULL;
 		mInfo = NULL;
+		mBatchBoxBoxPairs = false;
 	}
+
+	// same as btCollisionDispatcher::defaultNearCallback followed by btBoxBoxCollisionAlgorithm::processCollision,
+	// for a batch of box-box pairs that already have their algorithm and manifold
+	void processBoxBoxPairs(btBroadphasePair** pairs, btPersistentManifold** manifolds, int numPairs) const
+	{
+		btBoxBoxDetector::BatchInput inputs[btBoxBoxDetector::BATCH_SIZE];
+		btBoxBoxDetector::SeparatingAxis axes[btBoxBoxDetector::BATCH_SIZE];
+		for (int i = 0; i < numPairs; ++i)
+		{
+			const btCollisionObject* colObj0 = (btCollisionObject*)pairs[i]->m_pProxy0->m_clientObject;
+			const btCollisionObject* colObj1 = (btCollisionObject*)pairs[i]->m_pProxy1->m_clientObject;
+			inputs[i].m_box1 = (const btBoxShape*)colObj0->getCollisionShape();
+			inputs[i].m_box2 = (const btBoxShape*)colObj1->getCollisionShape();
+			inputs[i].m_transformA = &colObj0->getWorldTransform();
+			inputs[i].m_transformB = &colObj1->getWorldTransform();
+		}
+		btBoxBoxDetector::getSeparatingAxes(inputs, numPairs, axes);
+
+		for (int i = 0; i < numPairs; ++i)
+		{
+			const btCollisionObject* colObj0 = (btCollisionObject*)pairs[i]->m_pProxy0->m_clientObject;
+			const btCollisionObject* colObj1 = (btCollisionObject*)pairs[i]->m_pProxy1->m_clientObject;
+			btCollisionObjectWrapper obj0Wrap(0, colObj0->getCollisionShape(), colObj0, colObj0->getWorldTransform(), -1, -1);
+			btCollisionObjectWrapper obj1Wrap(0, colObj1->getCollisionShape(), colObj1, colObj1->getWorldTransform(), -1, -1);
+			btManifoldResult contactPointResult(&obj0Wrap, &obj1Wrap);
+			contactPointResult.setPersistentManifold(manifolds[i]);
+
+			btDiscreteCollisionDetectorInterface::ClosestPointInput input;
+			input.m_maximumDistanceSquared = BT_LARGE_FLOAT;
+			input.m_transformA = colObj0->getWorldTransform();
+			input.m_transformB = colObj1->getWorldTransform();
+			btBoxBoxDetector detector(inputs[i].m_box1, inputs[i].m_box2);
+			detector.getClosestPoints(input, axes[i], contactPointResult);
+
+			contactPointResult.refreshContactPoints();
+		}
+	}
+
 	void forLoop(int iBegin, int iEnd) const
 	{
+		if (!mBatchBoxBoxPairs)
+		{
+			for (int i = iBegin; i < iEnd; ++i)
+			{
+				btBroadphasePair* pair = &mPairArray[i];
+				mCallback(*pair, *mDispatcher, *mInfo);
+			}
+			return;
+		}
+
+		btBroadphasePair* boxBoxPairs[btBoxBoxDetector::BATCH_SIZE];
+		btPersistentManifold* boxBoxManifolds[btBoxBoxDetector::BATCH_SIZE];
+		int numBoxBoxPairs = 0;
+		btManifoldArray manifolds;
 		for (int i = iBegin; i < iEnd; ++i)
 		{
 			btBroadphasePair* pair = &mPairArray[i];
-			mCallback(*pair, *mDispatcher, *mInfo);
+			btCollisionObject* colObj0 = (btCollisionObject*)pair->m_pProxy0->m_clientObject;
+			btCollisionObject* colObj1 = (btCollisionObject*)pair->m_pProxy1->m_clientObject;
+			manifolds.resizeNoInitialize(0);
+			if (pair->m_algorithm &&
+				colObj0->getCollisionShape()->getShapeType() == BOX_SHAPE_PROXYTYPE &&
+				colObj1->getCollisionShape()->getShapeType() == BOX_SHAPE_PROXYTYPE &&
+				mDispatcher->needsCollision(colObj0, colObj1))
+			{
+				pair->m_algorithm->getAllContactManifolds(manifolds);
+			}
+			// only boxes that touched on the last step are batched, the others are likely apart and
+			// the one pair version stops at the first axis that separates them. New pairs go through
+			// the near callback once to get their algorithm.
+			if (manifolds.size() != 1 || manifolds[0]->getNumContacts() == 0)
+			{
+				mCallback(*pair, *mDispatcher, *mInfo);
+				continue;
+			}
+			boxBoxPairs[numBoxBoxPairs] = pair;
+			boxBoxManifolds[numBoxBoxPairs] = manifolds[0];
+			numBoxBoxPairs++;
+			if (numBoxBoxPairs == btBoxBoxDetector::BATCH_SIZE)
+			{
+				processBoxBoxPairs(boxBoxPairs, boxBoxManifolds, numBoxBoxPairs);
+				numBoxBoxPairs = 0;
+			}
+		}
+		if (numBoxBoxPairs)
+		{
+			processBoxBoxPairs(boxBoxPairs, boxBoxManifolds, numBoxBoxPairs);
 		}
 	}
 };
@@ -233,6 +320,11 @@ void btCollisionDispatcherMt::dispatchAllCollisionPairs(btOverlappingPairCache*
 	updater.mPairArray = pairCache->getOverlappingPairArrayPtr();
 	updater.mDispatcher = this;
 	updater.mInfo = &info;
+	// the batch writes the contacts into the manifold of the pair's algorithm, so it needs the default near callback
+	// and the BOX/BOX create function of the collision configuration, not one registered with registerCollisionCreateFunc
+	updater.mBatchBoxBoxPairs = m_batchBoxBoxPairs && updater.mCallback == defaultNearCallback &&
+								info.m_dispatchFunc == btDispatcherInfo::DISPATCH_DISCRETE &&
+								m_doubleDispatchContactPoints[BOX_SHAPE_PROXYTYPE][BOX_SHAPE_PROXYTYPE] == m_collisionConfiguration->getCollisionAlgorithmCreateFunc(BOX_SHAPE_PROXYTYPE, BOX_SHAPE_PROXYTYPE);
 
 	m_batchUpdating = true;
 	btParallelFor(0, pairCount, m_grainSize, updater);
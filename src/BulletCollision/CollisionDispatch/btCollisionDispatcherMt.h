@@ -35,12 +35,26 @@ public:
 
 	virtual void dispatchAllCollisionPairs(btOverlappingPairCache* pairCache, const btDispatcherInfo& info, btDispatcher* dispatcher) BT_OVERRIDE;
 
+	///run the separating axis tests of box-box pairs that were touching on the last step btBoxBoxDetector::BATCH_SIZE pairs
+	///at a time instead of one by one. The contacts go straight into the manifold of the pair's algorithm, so box-box pairs
+	///must use btBoxBoxCollisionAlgorithm (the btDefaultCollisionConfiguration default). Ignored with a custom near callback
+	///or a BOX/BOX create function registered with registerCollisionCreateFunc, these pairs go through the near callback.
+	void setBatchBoxBoxPairs(bool batchBoxBoxPairs)
+	{
+		m_batchBoxBoxPairs = batchBoxBoxPairs;
+	}
+	bool getBatchBoxBoxPairs() const
+	{
+		return m_batchBoxBoxPairs;
+	}
+
 	bool m_batchUpdating;
 
 protected:
 	btAlignedObjectArray<btAlignedObjectArray<btPersistentManifold*> > m_batchManifoldsPtr;
 	btAlignedObjectArray<btAlignedObjectArray<btPersistentManifold*> > m_batchReleasePtr;
 	int m_grainSize;
+	bool m_batchBoxBoxPairs;
 };
 
 #endif  //BT_COLLISION_DISPATCHER_MT_H
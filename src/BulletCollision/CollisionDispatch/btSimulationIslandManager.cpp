@@ -24,12 +24,35 @@ subject to the following restrictions:
 //#include <stdio.h>
 #include "LinearMath/btQuickprof.h"
 
-btSimulationIslandManager::btSimulationIslandManager() : m_splitIslands(true)
+///a simulation island that is kept from one step to the next, see btSimulationIslandManager::setPersistentIslands
+struct btPersistentIsland
+{
+	btAlignedObjectArray<int> m_bodies;  // body slots, empty if the island is free
+	int m_numEdges;                      // number of pairs inside the island on the last step
+	unsigned long long m_edgeHash;       // xor of the hashes of these pairs
+	int m_stepNumEdges;                  // same, being gathered for the current step
+	unsigned long long m_stepEdgeHash;
+	int m_stepsSinceSplit;
+	int m_root;  // union find root of the island, only valid while storing
+	bool m_edgesValid;
+	bool m_needsSplit;
+	bool m_isSleeping;
+};
+
+btSimulationIslandManager::btSimulationIslandManager() : m_splitIslands(true),
+															 m_persistentIslands(false),
+															 m_persistentIslandSplitInterval(60)
 {
 }
 
 btSimulationIslandManager::~btSimulationIslandManager()
 {
+	clearPersistentIslands();
+	for (int i = 0; i < m_persistentIslandPool.size(); i++)
+	{
+		m_persistentIslandPool[i]->~btPersistentIsland();
+		btAlignedFree(m_persistentIslandPool[i]);
+	}
 }
 
 void btSimulationIslandManager::initUnionFind(int n)
@@ -66,6 +89,11 @@ void btSimulationIslandManager::findUnions(btDispatcher* /* dispatcher */, btCol
 #ifdef STATIC_SIMULATION_ISLAND_OPTIMIZATION
 void btSimulationIslandManager::updateActivationState(btCollisionWorld* colWorld, btDispatcher* dispatcher)
 {
+	if (m_persistentIslands)
+	{
+		updatePersistentIslands(colWorld);
+		return;
+	}
 	// put the index into m_controllers into m_tag
 	int index = 0;
 	{
@@ -91,6 +119,11 @@ void btSimulationIslandManager::updateActivationState(btCollisionWorld* colWorld
 
 void btSimulationIslandManager::storeIslandActivationState(btCollisionWorld* colWorld)
 {
+	if (m_persistentIslands)
+	{
+		storePersistentIslands(colWorld);
+		return;
+	}
 	// put the islandId ('find' value) into m_tag
 	{
 		int index = 0;
@@ -164,6 +197,385 @@ void btSimulationIslandManager::storeIslandActivationState(btCollisionWorld* col
 
 #endif  //STATIC_SIMULATION_ISLAND_OPTIMIZATION
 
+// hash of a pair of objects, independent of their order. The hashes of the pairs of an island are xor-ed together,
+// so losing a pair changes the result even if another pair was added at the same time.
+static SIMD_FORCE_INLINE unsigned long long btPersistentIslandEdgeHash(int index0, int index1)
+{
+	unsigned long long key = index0 < index1 ? ((unsigned long long)index0 << 32) | (unsigned int)index1 : ((unsigned long long)index1 << 32) | (unsigned int)index0;
+	key ^= key >> 33;
+	key *= 0xff51afd7ed558ccdULL;
+	key ^= key >> 33;
+	key *= 0xc4ceb9fe1a85ec53ULL;
+	key ^= key >> 33;
+	return key;
+}
+
+void btSimulationIslandManager::setPersistentIslands(bool persistentIslands)
+{
+#ifdef STATIC_SIMULATION_ISLAND_OPTIMIZATION
+	if (persistentIslands != m_persistentIslands)
+	{
+		clearPersistentIslands();
+		m_persistentIslands = persistentIslands;
+	}
+#else
+	btAssert(!persistentIslands);  // persistent islands need STATIC_SIMULATION_ISLAND_OPTIMIZATION
+	(void)persistentIslands;
+#endif  //STATIC_SIMULATION_ISLAND_OPTIMIZATION
+}
+
+int btSimulationIslandManager::allocatePersistentIsland()
+{
+	int islandSlot;
+	if (m_freePersistentIslands.size())
+	{
+		islandSlot = m_freePersistentIslands[m_freePersistentIslands.size() - 1];
+		m_freePersistentIslands.pop_back();
+	}
+	else
+	{
+		void* mem = btAlignedAlloc(sizeof(btPersistentIsland), 16);
+		islandSlot = m_persistentIslandPool.size();
+		m_persistentIslandPool.push_back(new (mem) btPersistentIsland());
+	}
+	btPersistentIsland* island = m_persistentIslandPool[islandSlot];
+	btAssert(island->m_bodies.size() == 0);
+	island->m_numEdges = 0;
+	island->m_edgeHash = 0;
+	island->m_stepNumEdges = 0;
+	island->m_stepEdgeHash = 0;
+	island->m_stepsSinceSplit = 0;
+	island->m_root = -1;
+	island->m_edgesValid = false;
+	island->m_needsSplit = false;
+	island->m_isSleeping = false;
+	return islandSlot;
+}
+
+void btSimulationIslandManager::freePersistentIsland(int islandSlot)
+{
+	m_persistentIslandPool[islandSlot]->m_bodies.resize(0);
+	m_freePersistentIslands.push_back(islandSlot);
+}
+
+int btSimulationIslandManager::addPersistentBody(btCollisionObject* colObj)
+{
+	int bodySlot;
+	if (m_freeBodySlots.size())
+	{
+		bodySlot = m_freeBodySlots[m_freeBodySlots.size() - 1];
+		m_freeBodySlots.pop_back();
+		m_bodyObjects[bodySlot] = colObj;
+	}
+	else
+	{
+		bodySlot = m_bodyObjects.size();
+		m_bodyObjects.push_back(colObj);
+		m_bodyIslands.push_back(-1);
+	}
+	// new bodies start out in an island of their own, the pairs they are in merge them with the others
+	int islandSlot = allocatePersistentIsland();
+	m_persistentIslandPool[islandSlot]->m_bodies.push_back(bodySlot);
+	m_bodyIslands[bodySlot] = islandSlot;
+	colObj->setIslandTag(islandSlot);
+	return bodySlot;
+}
+
+void btSimulationIslandManager::removePersistentBody(int bodySlot)
+{
+	int islandSlot = m_bodyIslands[bodySlot];
+	btPersistentIsland* island = m_persistentIslandPool[islandSlot];
+	int index = island->m_bodies.findLinearSearch(bodySlot);
+	btAssert(index < island->m_bodies.size());
+	island->m_bodies[index] = island->m_bodies[island->m_bodies.size() - 1];
+	island->m_bodies.pop_back();
+	if (island->m_bodies.size() == 0)
+	{
+		freePersistentIsland(islandSlot);
+	}
+	else
+	{
+		// the body may have been holding the island together
+		island->m_needsSplit = true;
+	}
+	m_bodyObjects[bodySlot] = NULL;
+	m_bodyIslands[bodySlot] = -1;
+	m_freeBodySlots.push_back(bodySlot);
+}
+
+void btSimulationIslandManager::clearPersistentIslands()
+{
+	for (int i = 0; i < m_persistentIslandPool.size(); i++)
+	{
+		m_persistentIslandPool[i]->m_bodies.resize(0);
+	}
+	m_freePersistentIslands.resize(0);
+	for (int i = m_persistentIslandPool.size() - 1; i >= 0; i--)
+	{
+		m_freePersistentIslands.push_back(i);
+	}
+	m_bodyObjects.resize(0);
+	m_bodyIslands.resize(0);
+	m_freeBodySlots.resize(0);
+	m_trackedObjects.resize(0);
+	m_trackedBodySlots.resize(0);
+	m_splitBodies.resize(0);
+	m_rootCounts.resize(0);
+	m_rootIslands.resize(0);
+}
+
+void btSimulationIslandManager::compactPersistentIslands()
+{
+	// island ids must stay below the number of bodies, move the islands down into the free slots
+	int numBodies = m_bodyObjects.size() - m_freeBodySlots.size();
+	if (m_persistentIslandPool.size() <= numBodies)
+	{
+		return;
+	}
+	int numIslands = 0;
+	for (int i = 0; i < m_persistentIslandPool.size(); i++)
+	{
+		if (m_persistentIslandPool[i]->m_bodies.size() == 0)
+		{
+			continue;
+		}
+		if (i != numIslands)
+		{
+			m_persistentIslandPool.swap(i, numIslands);
+			btPersistentIsland* island = m_persistentIslandPool[numIslands];
+			for (int j = 0; j < island->m_bodies.size(); j++)
+			{
+				m_bodyIslands[island->m_bodies[j]] = numIslands;
+				m_bodyObjects[island->m_bodies[j]]->setIslandTag(numIslands);
+			}
+		}
+		numIslands++;
+	}
+	for (int i = numIslands; i < m_persistentIslandPool.size(); i++)
+	{
+		m_persistentIslandPool[i]->~btPersistentIsland();
+		btAlignedFree(m_persistentIslandPool[i]);
+	}
+	m_persistentIslandPool.resize(numIslands);
+	m_freePersistentIslands.resize(0);
+}
+
+void btSimulationIslandManager::updatePersistentIslands(btCollisionWorld* colWorld)
+{
+	BT_PROFILE("updatePersistentIslands");
+	btCollisionObjectArray& collisionObjects = colWorld->getCollisionObjectArray();
+	int numObjects = collisionObjects.size();
+
+	// catch up with objects that were added, removed or changed from static to dynamic since the last step.
+	// Removing objects moves others around in the collision object array, these are simply added again.
+	for (int i = numObjects; i < m_trackedObjects.size(); i++)
+	{
+		if (m_trackedBodySlots[i] >= 0)
+		{
+			removePersistentBody(m_trackedBodySlots[i]);
+		}
+	}
+	m_trackedObjects.resize(numObjects, NULL);
+	m_trackedBodySlots.resize(numObjects, -1);
+	for (int i = 0; i < numObjects; i++)
+	{
+		btCollisionObject* collisionObject = collisionObjects[i];
+		bool isDynamic = !collisionObject->isStaticOrKinematicObject();
+		int bodySlot = m_trackedBodySlots[i];
+		if (m_trackedObjects[i] != collisionObject || (bodySlot >= 0) != isDynamic)
+		{
+			if (bodySlot >= 0)
+			{
+				removePersistentBody(bodySlot);
+			}
+			m_trackedObjects[i] = collisionObject;
+			m_trackedBodySlots[i] = isDynamic ? addPersistentBody(collisionObject) : -1;
+			if (!isDynamic)
+			{
+				collisionObject->setIslandTag(-1);
+			}
+		}
+		// the tags of the objects are only written when their island changes
+		collisionObject->setCompanionId(isDynamic ? -1 : -2);
+		collisionObject->setHitFraction(btScalar(1.));
+	}
+
+	// the tag of a body is the slot of its island, which is also its union find index. The bodies of
+	// the islands that are being split get a union find index of their own after the island slots.
+	int numIslandSlots = m_persistentIslandPool.size();
+	m_splitBodies.resize(0);
+	for (int i = 0; i < numIslandSlots; i++)
+	{
+		btPersistentIsland* island = m_persistentIslandPool[i];
+		if (island->m_bodies.size() == 0)
+		{
+			continue;
+		}
+		island->m_stepNumEdges = 0;
+		island->m_stepEdgeHash = 0;
+		island->m_isSleeping = m_bodyObjects[island->m_bodies[0]]->getActivationState() == ISLAND_SLEEPING;
+		if (island->m_needsSplit)
+		{
+			for (int j = 0; j < island->m_bodies.size(); j++)
+			{
+				m_bodyObjects[island->m_bodies[j]]->setIslandTag(numIslandSlots + m_splitBodies.size());
+				m_splitBodies.push_back(island->m_bodies[j]);
+			}
+		}
+	}
+	int numElements = numIslandSlots + m_splitBodies.size();
+	initUnionFind(numElements);
+	m_rootCounts.resize(numElements, 0);
+	m_rootIslands.resize(numElements, -1);
+
+	// merge islands connected by pairs, pairs inside an island cost nothing but a check for lost pairs
+	btOverlappingPairCache* pairCachePtr = colWorld->getPairCache();
+	const int numOverlappingPairs = pairCachePtr->getNumOverlappingPairs();
+	if (numOverlappingPairs)
+	{
+		btBroadphasePair* pairPtr = pairCachePtr->getOverlappingPairArrayPtr();
+
+		for (int i = 0; i < numOverlappingPairs; i++)
+		{
+			const btBroadphasePair& collisionPair = pairPtr[i];
+			btCollisionObject* colObj0 = (btCollisionObject*)collisionPair.m_pProxy0->m_clientObject;
+			btCollisionObject* colObj1 = (btCollisionObject*)collisionPair.m_pProxy1->m_clientObject;
+
+			if (((colObj0) && ((colObj0)->mergesSimulationIslands())) &&
+				((colObj1) && ((colObj1)->mergesSimulationIslands())))
+			{
+				int tag0 = colObj0->getIslandTag();
+				int tag1 = colObj1->getIslandTag();
+				if (tag0 != tag1)
+				{
+					m_unionFind.unite(tag0, tag1);
+				}
+				else
+				{
+					// objects keep their place in the collision object array as long as their island isn't
+					// taken apart, so their world array indices identify the pair
+					btPersistentIsland* island = m_persistentIslandPool[tag0];
+					if (!island->m_isSleeping)
+					{
+						island->m_stepNumEdges++;
+						island->m_stepEdgeHash ^= btPersistentIslandEdgeHash(colObj0->getWorldArrayIndex(), colObj1->getWorldArrayIndex());
+					}
+				}
+			}
+		}
+	}
+}
+
+void btSimulationIslandManager::storePersistentIslands(btCollisionWorld* colWorld)
+{
+	BT_PROFILE("storePersistentIslands");
+	int numIslandSlots = m_persistentIslandPool.size();
+
+	// count the islands that ended up under each union find root, the bodies of islands being split
+	// count double so that anything they touch is regrouped
+	int splitIndex = numIslandSlots;
+	for (int i = 0; i < numIslandSlots; i++)
+	{
+		btPersistentIsland* island = m_persistentIslandPool[i];
+		if (island->m_bodies.size() == 0)
+		{
+			continue;
+		}
+		if (island->m_needsSplit)
+		{
+			for (int j = 0; j < island->m_bodies.size(); j++)
+			{
+				m_rootCounts[m_unionFind.find(splitIndex++)] += 2;
+			}
+		}
+		else
+		{
+			island->m_root = m_unionFind.find(i);
+			m_rootCounts[island->m_root]++;
+		}
+	}
+
+	// islands alone under their root keep their bodies and tags, the others are taken apart
+	m_regroupBodies.resize(0);
+	splitIndex = numIslandSlots;
+	for (int i = 0; i < numIslandSlots; i++)
+	{
+		btPersistentIsland* island = m_persistentIslandPool[i];
+		if (island->m_bodies.size() == 0)
+		{
+			continue;
+		}
+		if (!island->m_needsSplit && m_rootCounts[island->m_root] == 1)
+		{
+			m_rootCounts[island->m_root] = 0;
+			if (island->m_isSleeping)
+			{
+				island->m_edgesValid = false;
+				continue;
+			}
+			// if the pairs of the island changed it may have come apart, split it on the next step
+			if (island->m_edgesValid && (island->m_stepNumEdges != island->m_numEdges || island->m_stepEdgeHash != island->m_edgeHash))
+			{
+				island->m_needsSplit = true;
+			}
+			else if (++island->m_stepsSinceSplit >= m_persistentIslandSplitInterval)
+			{
+				island->m_needsSplit = true;
+			}
+			island->m_numEdges = island->m_stepNumEdges;
+			island->m_edgeHash = island->m_stepEdgeHash;
+			island->m_edgesValid = true;
+			continue;
+		}
+		for (int j = 0; j < island->m_bodies.size(); j++)
+		{
+			btElement element;
+			element.m_id = island->m_needsSplit ? m_unionFind.find(splitIndex++) : island->m_root;
+			element.m_sz = island->m_bodies[j];
+			m_regroupBodies.push_back(element);
+		}
+		freePersistentIsland(i);
+	}
+
+	// build new islands from the bodies that were taken apart, one per union find root
+	for (int i = 0; i < m_regroupBodies.size(); i++)
+	{
+		int root = m_regroupBodies[i].m_id;
+		int bodySlot = m_regroupBodies[i].m_sz;
+		if (m_rootIslands[root] < 0)
+		{
+			m_rootIslands[root] = allocatePersistentIsland();
+		}
+		m_persistentIslandPool[m_rootIslands[root]]->m_bodies.push_back(bodySlot);
+		m_bodyIslands[bodySlot] = m_rootIslands[root];
+		m_bodyObjects[bodySlot]->setIslandTag(m_rootIslands[root]);
+	}
+	for (int i = 0; i < m_regroupBodies.size(); i++)
+	{
+		m_rootCounts[m_regroupBodies[i].m_id] = 0;
+		m_rootIslands[m_regroupBodies[i].m_id] = -1;
+	}
+
+	compactPersistentIslands();
+}
+
+void btSimulationIslandManager::sortPersistentIslands()
+{
+	m_unionFind.allocate(m_bodyObjects.size() - m_freeBodySlots.size());
+	int index = 0;
+	for (int i = 0; i < m_persistentIslandPool.size(); i++)
+	{
+		btPersistentIsland* island = m_persistentIslandPool[i];
+		for (int j = 0; j < island->m_bodies.size(); j++)
+		{
+			btElement& element = m_unionFind.getElement(index++);
+			element.m_id = i;
+			element.m_sz = m_bodyObjects[island->m_bodies[j]]->getWorldArrayIndex();
+		}
+	}
+	btAssert(index == m_unionFind.getNumElements());
+}
+
 inline int getIslandId(const btPersistentManifold* lhs)
 {
 	int islandId;
@@ -204,7 +616,14 @@ void btSimulationIslandManager::buildIslands(btDispatcher* dispatcher, btCollisi
 	//we are going to sort the unionfind array, and store the element id in the size
 	//afterwards, we clean unionfind, to make sure no-one uses it anymore
 
-	getUnionFind().sortIslands();
+	if (m_persistentIslands)
+	{
+		sortPersistentIslands();
+	}
+	else
+	{
+		getUnionFind().sortIslands();
+	}
 	int numElem = getUnionFind().getNumElements();
 
 	int endIslandIndex = 1;
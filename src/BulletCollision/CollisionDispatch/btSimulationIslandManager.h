@@ -25,6 +25,7 @@ class btCollisionObject;
 class btCollisionWorld;
 class btDispatcher;
 class btPersistentManifold;
+struct btPersistentIsland;
 
 ///SimulationIslandManager creates and handles simulation islands, using btUnionFind
 class btSimulationIslandManager
@@ -36,6 +37,35 @@ class btSimulationIslandManager
 
 	bool m_splitIslands;
 
+	// persistent islands, see setPersistentIslands
+	bool m_persistentIslands;
+	int m_persistentIslandSplitInterval;
+	btAlignedObjectArray<btPersistentIsland*> m_persistentIslandPool;  // indexed by island slot (the island id), empty islands are free
+	btAlignedObjectArray<int> m_freePersistentIslands;
+	btAlignedObjectArray<btCollisionObject*> m_bodyObjects;  // indexed by body slot, NULL if free
+	btAlignedObjectArray<int> m_bodyIslands;                 // island slot of each body slot, -1 if free
+	btAlignedObjectArray<int> m_freeBodySlots;
+	btAlignedObjectArray<btCollisionObject*> m_trackedObjects;  // collision object array as of the last step
+	btAlignedObjectArray<int> m_trackedBodySlots;               // body slot of each tracked object, -1 if static or kinematic
+	btAlignedObjectArray<int> m_splitBodies;                    // bodies of the islands being split this step
+	btAlignedObjectArray<int> m_rootCounts;
+	btAlignedObjectArray<int> m_rootIslands;
+	btAlignedObjectArray<btElement> m_regroupBodies;
+
+	int allocatePersistentIsland();
+	void freePersistentIsland(int islandSlot);
+	int addPersistentBody(btCollisionObject* colObj);
+	void removePersistentBody(int bodySlot);
+	void clearPersistentIslands();
+	void compactPersistentIslands();
+	void updatePersistentIslands(btCollisionWorld* colWorld);
+	void storePersistentIslands(btCollisionWorld* colWorld);
+
+protected:
+	//fills the union find with the bodies of the persistent islands, grouped by island with ascending island ids,
+	//the way btUnionFind::sortIslands leaves it (but without sorting anything)
+	void sortPersistentIslands();
+
 public:
 	btSimulationIslandManager();
 	virtual ~btSimulationIslandManager();
@@ -70,6 +100,26 @@ public:
 	{
 		m_splitIslands = doSplitIslands;
 	}
+
+	///Keep the islands from one step to the next instead of rebuilding them from scratch with a full union find and sort.
+	///Islands are merged as soon as a new pair connects them. They are split lazily: on the step after one of their pairs
+	///went away, and every getPersistentIslandSplitInterval() steps while awake (this also catches removed constraints).
+	///Until then an island can be bigger than needed, which is harmless for the solver.
+	///Sleeping islands are never merged or split unless something touches them.
+	///Needs STATIC_SIMULATION_ISLAND_OPTIMIZATION (btUnionFind.h), without it the islands are always rebuilt and enabling asserts.
+	void setPersistentIslands(bool persistentIslands);
+	bool getPersistentIslands() const
+	{
+		return m_persistentIslands;
+	}
+	void setPersistentIslandSplitInterval(int numSteps)
+	{
+		m_persistentIslandSplitInterval = numSteps;
+	}
+	int getPersistentIslandSplitInterval() const
+	{
+		return m_persistentIslandSplitInterval;
+	}
 };
 
 #endif  //BT_SIMULATION_ISLAND_MANAGER_H
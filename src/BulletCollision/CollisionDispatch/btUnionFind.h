@@ -17,6 +17,7 @@ subject to the following restrictions:
 #define BT_UNION_FIND_H
 
 #include "LinearMath/btAlignedObjectArray.h"
+#include "LinearMath/btThreads.h"
 
 #define USE_PATH_COMPRESSION 1
 
@@ -118,6 +119,48 @@ public:
 		}
 		return x;
 	}
+
+	// lock-free versions of find and unite, can be called from several threads at once.
+	// uniteConcurrent always links the root with the larger index below the other root, so as long as only
+	// uniteConcurrent is used the root of a set is its smallest element, whatever order the calls are made in.
+	// m_sz is not maintained.
+	int findConcurrent(int x)
+	{
+		while (true)
+		{
+			int parent = m_elements[x].m_id;
+			if (parent == x)
+			{
+				return x;
+			}
+			int grandParent = m_elements[parent].m_id;
+			if (grandParent != parent)
+			{
+				// path halving, it doesn't matter if another thread got there first
+				btAtomicCompareAndSwap(&m_elements[x].m_id, parent, grandParent);
+			}
+			x = grandParent;
+		}
+	}
+
+	void uniteConcurrent(int p, int q)
+	{
+		while (true)
+		{
+			int i = findConcurrent(p), j = findConcurrent(q);
+			if (i == j)
+				return;
+			if (i < j)
+			{
+				btSwap(i, j);
+			}
+			// link root i below root j, fails if i was linked by another thread in the meantime
+			if (btAtomicCompareAndSwap(&m_elements[i].m_id, i, j))
+				return;
+			p = i;
+			q = j;
+		}
+	}
 };
 
 #endif  //BT_UNION_FIND_H
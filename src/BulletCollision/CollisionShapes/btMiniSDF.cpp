@@ -9,7 +9,14 @@
 //Copyright (c) 2017 Dan Koschier
 //
 
+#include "BulletCollision/CollisionShapes/btConvexShape.h"
+#include "BulletCollision/CollisionShapes/btConcaveShape.h"
+#include "BulletCollision/CollisionShapes/btTriangleCallback.h"
+#include "BulletCollision/NarrowPhaseCollision/btGjkEpa2.h"
+#include "LinearMath/btThreads.h"
+#include <float.h>
 #include <limits.h>
+#include <math.h>
 #include <string.h>  //memcpy
 
 struct btSdfDataStream
@@ -520,3 +527,355 @@ bool btMiniSDF::interpolate(unsigned int field_id, double& dist, btVector3 const
 	dist = phi;
 	return true;
 }
+
+static const int kSdfNodesPerTask = 64;
+
+// btParallelFor needs a BT_THREADSAFE build and a task scheduler, otherwise the loop runs inline
+static void btSdfParallelFor(int iBegin, int iEnd, const btIParallelForBody& body)
+{
+#if BT_THREADSAFE
+	if (btGetTaskScheduler() && iEnd - iBegin > kSdfNodesPerTask)
+	{
+		btParallelFor(iBegin, iEnd, kSdfNodesPerTask, body);
+		return;
+	}
+#endif
+	body.forLoop(iBegin, iEnd);
+}
+
+// Ericson, Real-Time Collision Detection, 5.1.5
+static btVector3 btSdfClosestPointOnTriangle(const btVector3& p, const btVector3& a, const btVector3& b, const btVector3& c)
+{
+	const btVector3 ab = b - a;
+	const btVector3 ac = c - a;
+	const btVector3 ap = p - a;
+	const btScalar d1 = ab.dot(ap);
+	const btScalar d2 = ac.dot(ap);
+	if (d1 <= 0 && d2 <= 0)
+		return a;
+	const btVector3 bp = p - b;
+	const btScalar d3 = ab.dot(bp);
+	const btScalar d4 = ac.dot(bp);
+	if (d3 >= 0 && d4 <= d3)
+		return b;
+	const btScalar vc = d1 * d4 - d3 * d2;
+	if (vc <= 0 && d1 >= 0 && d3 <= 0)
+		return a + ab * (d1 / (d1 - d3));
+	const btVector3 cp = p - c;
+	const btScalar d5 = ab.dot(cp);
+	const btScalar d6 = ac.dot(cp);
+	if (d6 >= 0 && d5 <= d6)
+		return c;
+	const btScalar vb = d5 * d2 - d1 * d6;
+	if (vb <= 0 && d2 >= 0 && d6 <= 0)
+		return a + ac * (d2 / (d2 - d6));
+	const btScalar va = d3 * d6 - d5 * d4;
+	if (va <= 0 && (d4 - d3) >= 0 && (d5 - d6) >= 0)
+		return b + (c - b) * ((d4 - d3) / ((d4 - d3) + (d5 - d6)));
+	const btScalar denom = btScalar(1) / (va + vb + vc);
+	return a + ab * (vb * denom) + ac * (vc * denom);
+}
+
+struct btSdfClosestTriangleCallback : public btTriangleCallback
+{
+	btVector3 m_point;
+	btScalar m_distance2;
+
+	virtual void processTriangle(btVector3* triangle, int partId, int triangleIndex)
+	{
+		const btVector3 q = btSdfClosestPointOnTriangle(m_point, triangle[0], triangle[1], triangle[2]);
+		m_distance2 = btMin(m_distance2, q.distance2(m_point));
+	}
+};
+
+// counts the triangles crossed by the ray from m_point along m_direction times the axis m_axis
+struct btSdfRayCrossingCallback : public btTriangleCallback
+{
+	btVector3 m_point;
+	int m_axis;
+	btScalar m_direction;
+	int m_numCrossings;
+
+	virtual void processTriangle(btVector3* triangle, int partId, int triangleIndex)
+	{
+		const int u = (m_axis + 1) % 3;
+		const int v = (m_axis + 2) % 3;
+		btScalar w[3];
+		for (int i = 0; i < 3; ++i)
+		{
+			const btVector3& a = triangle[(i + 1) % 3];
+			const btVector3& b = triangle[(i + 2) % 3];
+			w[i] = (b[u] - a[u]) * (m_point[v] - a[v]) - (b[v] - a[v]) * (m_point[u] - a[u]);
+		}
+		const bool inside = (w[0] >= 0 && w[1] >= 0 && w[2] >= 0) || (w[0] <= 0 && w[1] <= 0 && w[2] <= 0);
+		const btScalar sum = w[0] + w[1] + w[2];
+		if (!inside || sum == 0)
+		{
+			return;
+		}
+		const btScalar hit = (w[0] * triangle[0][m_axis] + w[1] * triangle[1][m_axis] + w[2] * triangle[2][m_axis]) / sum;
+		if ((hit - m_point[m_axis]) * m_direction > 0)
+		{
+			++m_numCrossings;
+		}
+	}
+};
+
+struct btSdfBuildLoop : public btIParallelForBody
+{
+	const btCollisionShape* m_shape;
+	const btVector3* m_positions;
+	double* m_values;
+	btVector3 m_shapeMin;
+	btVector3 m_shapeMax;
+	btScalar m_cellDiagonal;
+	btScalar m_maxRadius;
+
+	btScalar convexDistance(const btVector3& x) const
+	{
+		btTransform unit;
+		unit.setIdentity();
+		btGjkEpaSolver2::sResults res;
+		return btGjkEpaSolver2::SignedDistance(x, 0, static_cast<const btConvexShape*>(m_shape), unit, res);
+	}
+
+	bool insideConcave(const btVector3& x) const
+	{
+		const btConcaveShape* concave = static_cast<const btConcaveShape*>(m_shape);
+		// the rays are moved off the node a little, so that they do not run along the edges of grid aligned meshes,
+		// and vote, so that a ray through an edge shared by two triangles does not flip the sign
+		const btVector3 jitter = btVector3(btScalar(0.4142135), btScalar(0.7320508), btScalar(0.2360679)) * (m_cellDiagonal * btScalar(1e-3));
+		const btScalar thin = m_cellDiagonal * btScalar(1e-2);
+		static const int axes[3] = {0, 0, 2};
+		static const btScalar directions[3] = {1, -1, 1};
+		int numInside = 0;
+		for (int r = 0; r < 3; ++r)
+		{
+			btSdfRayCrossingCallback callback;
+			callback.m_point = x + jitter;
+			callback.m_axis = axes[r];
+			callback.m_direction = directions[r];
+			callback.m_numCrossings = 0;
+			btVector3 aabbMin = callback.m_point - btVector3(thin, thin, thin);
+			btVector3 aabbMax = callback.m_point + btVector3(thin, thin, thin);
+			if (directions[r] > 0)
+				aabbMax[axes[r]] = btMax(aabbMax[axes[r]], m_shapeMax[axes[r]] + thin);
+			else
+				aabbMin[axes[r]] = btMin(aabbMin[axes[r]], m_shapeMin[axes[r]] - thin);
+			concave->processAllTriangles(&callback, aabbMin, aabbMax);
+			numInside += callback.m_numCrossings & 1;
+		}
+		return numInside >= 2;
+	}
+
+	btScalar concaveDistance(const btVector3& x) const
+	{
+		const btConcaveShape* concave = static_cast<const btConcaveShape*>(m_shape);
+		btSdfClosestTriangleCallback callback;
+		callback.m_point = x;
+		btScalar radius = m_cellDiagonal;
+		for (;;)
+		{
+			// a triangle closer than radius overlaps the box, so the closest one found in it is the closest of all
+			callback.m_distance2 = BT_LARGE_FLOAT;
+			const btVector3 extent(radius, radius, radius);
+			concave->processAllTriangles(&callback, x - extent, x + extent);
+			if (callback.m_distance2 <= radius * radius || radius >= m_maxRadius)
+			{
+				break;
+			}
+			radius *= 2;
+		}
+		const btScalar distance = btMin(btSqrt(callback.m_distance2), m_maxRadius);
+		return insideConcave(x) ? -distance : distance;
+	}
+
+	void forLoop(int iBegin, int iEnd) const BT_OVERRIDE
+	{
+		const bool convex = m_shape->isConvex();
+		for (int i = iBegin; i < iEnd; ++i)
+		{
+			m_values[i] = convex ? convexDistance(m_positions[i]) : concaveDistance(m_positions[i]);
+		}
+	}
+};
+
+bool btMiniSDF::buildFromShape(const btCollisionShape* shape, int resolution, btScalar padding)
+{
+	m_isValid = false;
+	if (!shape->isConvex() && !shape->isConcave())
+	{
+		return false;
+	}
+	btTransform unit;
+	unit.setIdentity();
+	btVector3 shapeMin, shapeMax;
+	shape->getAabb(unit, shapeMin, shapeMax);
+	const btVector3 domainMin = shapeMin - btVector3(padding, padding, padding);
+	const btVector3 extent = shapeMax - shapeMin + btVector3(padding, padding, padding) * 2;
+	const btScalar h = extent[extent.maxAxis()] / btScalar(btMax(resolution, 1));
+	if (!(h > 0))
+	{
+		return false;
+	}
+
+	// cubic cells, the domain is grown to a whole number of them
+	unsigned int r[3];
+	for (int d = 0; d < 3; ++d)
+	{
+		r[d] = btMax(1u, (unsigned int)ceil(extent[d] / h - btScalar(1e-6)));
+		m_resolution[d] = r[d];
+	}
+	const unsigned long long int numVertices = (unsigned long long int)(r[0] + 1) * (r[1] + 1) * (r[2] + 1);
+	const unsigned long long int numEdgesX = (unsigned long long int)r[0] * (r[1] + 1) * (r[2] + 1);
+	const unsigned long long int numEdgesY = (unsigned long long int)(r[0] + 1) * r[1] * (r[2] + 1);
+	const unsigned long long int numEdgesZ = (unsigned long long int)(r[0] + 1) * (r[1] + 1) * r[2];
+	const unsigned long long int numNodes = numVertices + 2 * (numEdgesX + numEdgesY + numEdgesZ);
+	if (numNodes >= (unsigned long long int)INT_MAX)
+	{
+		return false;
+	}
+
+	m_domain.m_min = domainMin;
+	m_domain.m_max = domainMin + btVector3(btScalar(r[0]), btScalar(r[1]), btScalar(r[2])) * h;
+	m_domain.m_min[3] = 0;
+	m_domain.m_max[3] = 0;
+	m_cell_size = btVector3(h, h, h);
+	m_inv_cell_size = btVector3(1 / h, 1 / h, 1 / h);
+	m_n_cells = std::size_t(r[0]) * r[1] * r[2];
+	m_n_fields = 1;
+
+	// the nodes are the cell vertices, followed by the two inner nodes of the x, y and z edges, at 1/3 and 2/3
+	const unsigned int edgeXBase = (unsigned int)numVertices;
+	const unsigned int edgeYBase = (unsigned int)(edgeXBase + 2 * numEdgesX);
+	const unsigned int edgeZBase = (unsigned int)(edgeYBase + 2 * numEdgesY);
+	btAlignedObjectArray<btVector3> positions;
+	positions.resize((int)numNodes);
+	int n = 0;
+	for (unsigned int k = 0; k <= r[2]; ++k)
+		for (unsigned int j = 0; j <= r[1]; ++j)
+			for (unsigned int i = 0; i <= r[0]; ++i)
+				positions[n++] = domainMin + btVector3(btScalar(i), btScalar(j), btScalar(k)) * h;
+	for (int axis = 0; axis < 3; ++axis)
+	{
+		const unsigned int e[3] = {r[0] + (axis != 0), r[1] + (axis != 1), r[2] + (axis != 2)};
+		for (unsigned int k = 0; k < e[2]; ++k)
+			for (unsigned int j = 0; j < e[1]; ++j)
+				for (unsigned int i = 0; i < e[0]; ++i)
+					for (int s = 1; s <= 2; ++s)
+					{
+						btVector3 p = btVector3(btScalar(i), btScalar(j), btScalar(k));
+						p[axis] += btScalar(s) / 3;
+						positions[n++] = domainMin + p * h;
+					}
+	}
+	btAssert(n == positions.size());
+
+	m_nodes.resize(1);
+	m_nodes[0].resize(positions.size());
+	btSdfBuildLoop loop;
+	loop.m_shape = shape;
+	loop.m_positions = &positions[0];
+	loop.m_values = &m_nodes[0][0];
+	loop.m_shapeMin = shapeMin;
+	loop.m_shapeMax = shapeMax;
+	loop.m_cellDiagonal = h * btSqrt(btScalar(3));
+	loop.m_maxRadius = (m_domain.m_max - m_domain.m_min).length() + (shapeMax - shapeMin).length();
+	btSdfParallelFor(0, positions.size(), loop);
+
+	// node numbers of every cell, in the order of shape_function_
+	m_cells.resize(1);
+	m_cells[0].resize((int)m_n_cells);
+	m_cell_map.resize(1);
+	m_cell_map[0].resize((int)m_n_cells);
+	const unsigned int vx = r[0] + 1;
+	const unsigned int vxy = (r[0] + 1) * (r[1] + 1);
+	for (unsigned int k = 0; k < r[2]; ++k)
+	{
+		for (unsigned int j = 0; j < r[1]; ++j)
+		{
+			for (unsigned int i = 0; i < r[0]; ++i)
+			{
+				btMultiIndex mi;
+				mi.ijk[0] = i;
+				mi.ijk[1] = j;
+				mi.ijk[2] = k;
+				const unsigned int l = multiToSingleIndex(mi);
+				unsigned int* c = m_cells[0][l].m_cells;
+				for (int v = 0; v < 8; ++v)
+				{
+					c[v] = (i + (v & 1)) + (j + ((v >> 1) & 1)) * vx + (k + ((v >> 2) & 1)) * vxy;
+				}
+				// edges along x at (y, z) = (-,-), (-,+), (+,-), (+,+)
+				for (int e = 0; e < 4; ++e)
+				{
+					const unsigned int edge = i + r[0] * ((j + (e >> 1)) + (r[1] + 1) * (k + (e & 1)));
+					c[8 + 2 * e] = edgeXBase + 2 * edge;
+					c[9 + 2 * e] = edgeXBase + 2 * edge + 1;
+				}
+				// edges along y at (x, z) = (-,-), (+,-), (-,+), (+,+)
+				for (int e = 0; e < 4; ++e)
+				{
+					const unsigned int edge = (i + (e & 1)) + (r[0] + 1) * (j + r[1] * (k + (e >> 1)));
+					c[16 + 2 * e] = edgeYBase + 2 * edge;
+					c[17 + 2 * e] = edgeYBase + 2 * edge + 1;
+				}
+				// edges along z at (x, y) = (-,-), (-,+), (+,-), (+,+)
+				for (int e = 0; e < 4; ++e)
+				{
+					const unsigned int edge = (i + (e >> 1)) + (r[0] + 1) * ((j + (e & 1)) + (r[1] + 1) * k);
+					c[24 + 2 * e] = edgeZBase + 2 * edge;
+					c[25 + 2 * e] = edgeZBase + 2 * edge + 1;
+				}
+				m_cell_map[0][l] = l;
+			}
+		}
+	}
+	m_isValid = true;
+	return true;
+}
+
+template <class T>
+static void btSdfWrite(btAlignedObjectArray<char>& data, const T& val)
+{
+	const int offset = data.size();
+	data.resize(offset + int(sizeof(T)));
+	memcpy(&data[offset], &val, sizeof(T));
+}
+
+void btMiniSDF::serialize(btAlignedObjectArray<char>& data) const
+{
+	data.resize(0);
+	for (int i = 0; i < 3; ++i)
+		btSdfWrite(data, double(m_domain.m_min[i]));
+	for (int i = 0; i < 3; ++i)
+		btSdfWrite(data, double(m_domain.m_max[i]));
+	btSdfWrite(data, m_resolution);
+	for (int i = 0; i < 3; ++i)
+		btSdfWrite(data, double(m_cell_size[i]));
+	for (int i = 0; i < 3; ++i)
+		btSdfWrite(data, double(m_inv_cell_size[i]));
+	btSdfWrite(data, (unsigned long long int)m_n_cells);
+	btSdfWrite(data, (unsigned long long int)m_n_fields);
+	btSdfWrite(data, (unsigned long long int)m_nodes.size());
+	for (int i = 0; i < m_nodes.size(); ++i)
+	{
+		btSdfWrite(data, (unsigned long long int)m_nodes[i].size());
+		for (int j = 0; j < m_nodes[i].size(); ++j)
+			btSdfWrite(data, m_nodes[i][j]);
+	}
+	btSdfWrite(data, (unsigned long long int)m_cells.size());
+	for (int i = 0; i < m_cells.size(); ++i)
+	{
+		btSdfWrite(data, (unsigned long long int)m_cells[i].size());
+		for (int j = 0; j < m_cells[i].size(); ++j)
+			btSdfWrite(data, m_cells[i][j]);
+	}
+	btSdfWrite(data, (unsigned long long int)m_cell_map.size());
+	for (int i = 0; i < m_cell_map.size(); ++i)
+	{
+		btSdfWrite(data, (unsigned long long int)m_cell_map[i].size());
+		for (int j = 0; j < m_cell_map[i].size(); ++j)
+			btSdfWrite(data, m_cell_map[i][j]);
+	}
+}
@@ -5,6 +5,8 @@
 #include "LinearMath/btAabbUtil2.h"
 #include "LinearMath/btAlignedObjectArray.h"
 
+class btCollisionShape;
+
 struct btMultiIndex
 {
 	unsigned int ijk[3];
@@ -106,6 +108,16 @@ struct btMiniSDF
 	{
 	}
 	bool load(const char* data, int size);
+
+	// Bake the signed distance to a convex or concave shape, in shape space, on the aabb of the shape grown by padding,
+	// with resolution cells along its longest side. Convex shapes use GJK like btSparseSdf. The sign of a concave shape
+	// comes from counting ray crossings, so its triangles must form a closed mesh. The nodes are computed in
+	// btParallelFor tasks. Returns false for other shapes.
+	bool buildFromShape(const btCollisionShape* shape, int resolution, btScalar padding);
+
+	// Write the data that load reads, to bake a field offline
+	void serialize(btAlignedObjectArray<char>& data) const;
+
 	bool isValid() const
 	{
 		return m_isValid;
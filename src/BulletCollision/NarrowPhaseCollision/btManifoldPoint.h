@@ -48,12 +48,13 @@ enum btContactPointFlags
 
 /// ManifoldContactPoint collects and maintains persistent contactpoints.
 /// used to improve stability and performance of rigidbody dynamics response.
+/// The fields read by the constraint solvers come first and the ones only used by the narrowphase and the contact callbacks
+/// last, so converting the contacts to solver constraints touches fewer cache lines per point.
 class btManifoldPoint
 {
 public:
 	btManifoldPoint()
-		: m_userPersistentData(0),
-		  m_contactPointFlags(0),
+		: m_contactPointFlags(0),
 		  m_appliedImpulse(0.f),
 		  m_prevRHS(0.f),
 		  m_appliedImpulseLateral1(0.f),
@@ -63,27 +64,24 @@ public:
 		  m_contactCFM(0.f),
 		  m_contactERP(0.f),
 		  m_frictionCFM(0.f),
-		  m_lifeTime(0)
+		  m_userPersistentData(0),
+		  m_lifeTime(0),
+		  m_hasCollided(false)
 	{
 	}
 
 	btManifoldPoint(const btVector3& pointA, const btVector3& pointB,
 					const btVector3& normal,
-					btScalar distance) : m_localPointA(pointA),
-										 m_localPointB(pointB),
-										 m_positionWorldOnB(0,0,0),
+					btScalar distance) : m_positionWorldOnB(0,0,0),
 										 m_positionWorldOnA(0,0,0),
 										 m_normalWorldOnB(normal),
+										 m_lateralFrictionDir1(0,0,0),
+										 m_lateralFrictionDir2(0,0,0),
 										 m_distance1(distance),
 										 m_combinedFriction(btScalar(0.)),
 										 m_combinedRollingFriction(btScalar(0.)),
 										 m_combinedSpinningFriction(btScalar(0.)),
 										 m_combinedRestitution(btScalar(0.)),
-										 m_partId0(-1),
-										 m_partId1(-1),
-										 m_index0(-1),
-										 m_index1(-1),
-										 m_userPersistentData(0),
 										 m_contactPointFlags(0),
 										 m_appliedImpulse(0.f),
 										 m_prevRHS(0.f),
@@ -94,18 +92,24 @@ public:
 										 m_contactCFM(0.f),
 										 m_contactERP(0.f),
 										 m_frictionCFM(0.f),
+										 m_localPointA(pointA),
+										 m_localPointB(pointB),
+										 m_partId0(-1),
+										 m_partId1(-1),
+										 m_index0(-1),
+										 m_index1(-1),
+										 m_userPersistentData(0),
 										 m_lifeTime(0),
-										 m_lateralFrictionDir1(0,0,0),
-										 m_lateralFrictionDir2(0,0,0)
+										 m_hasCollided(false)
 	{
 	}
 
-	btVector3 m_localPointA;
-	btVector3 m_localPointB;
 	btVector3 m_positionWorldOnB;
 	///m_positionWorldOnA is redundant information, see getPositionWorldOnA(), but for clarity
 	btVector3 m_positionWorldOnA;
 	btVector3 m_normalWorldOnB;
+	btVector3 m_lateralFrictionDir1;
+	btVector3 m_lateralFrictionDir2;
 
 	btScalar m_distance1;
 	btScalar m_combinedFriction;
@@ -113,13 +117,6 @@ public:
 	btScalar m_combinedSpinningFriction;  //torsional friction around contact normal, useful for grasping objects
 	btScalar m_combinedRestitution;
 
-	//BP mod, store contact triangles.
-	int m_partId0;
-	int m_partId1;
-	int m_index0;
-	int m_index1;
-
-	mutable void* m_userPersistentData;
 	//bool			m_lateralFrictionInitialized;
 	int m_contactPointFlags;
 
@@ -142,11 +139,21 @@ public:
 
 	btScalar m_frictionCFM;
 
+	// not used by the constraint solvers
+
+	btVector3 m_localPointA;
+	btVector3 m_localPointB;
+
+	//BP mod, store contact triangles.
+	int m_partId0;
+	int m_partId1;
+	int m_index0;
+	int m_index1;
+
+	mutable void* m_userPersistentData;
+
 	int m_lifeTime;  //lifetime of the contactpoint in frames
 	bool m_hasCollided;
-	
-	btVector3 m_lateralFrictionDir1;
-	btVector3 m_lateralFrictionDir2;
 
 	btScalar getDistance() const
 	{
@@ -34,9 +34,12 @@ bool gContactCalcArea3Points = true;
 
 btPersistentManifold::btPersistentManifold()
 	: btTypedObject(BT_PERSISTENT_MANIFOLD_TYPE),
+	  m_pointCache(0),
 	  m_body0(0),
 	  m_body1(0),
 	  m_cachedPoints(0),
+	  m_cacheSize(0),
+	  m_ownsPointCache(false),
 	  m_companionIdA(0),
 	  m_companionIdB(0),
 	  m_index1a(0)
@@ -60,6 +63,7 @@ void btPersistentManifold::DebugPersistency()
 void btPersistentManifold::CopyContactsFromManifold(btPersistentManifold* mfPtr)
 {
 	m_pointCache = new btManifoldPoint[mfPtr->getNumContacts()];
+	m_ownsPointCache = true;
 	for (int i = 0; i < mfPtr->getNumContacts(); i++)
 	{
 		btManifoldPoint* srcPt = &mfPtr->getContactPoint(i);
@@ -104,7 +108,12 @@ void btPersistentManifold::clearUserCache(btManifoldPoint& pt)
 
 void btPersistentManifold::freeContactPoint()
 {
-	delete (m_pointCache);
+	if (m_ownsPointCache)
+	{
+		delete[] m_pointCache;
+	}
+	m_pointCache = 0;
+	m_ownsPointCache = false;
 }
 
 static inline btScalar calcArea4Points(const btVector3& p0, const btVector3& p1, const btVector3& p2, const btVector3& p3)
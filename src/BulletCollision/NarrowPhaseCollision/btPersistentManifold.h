@@ -71,6 +71,7 @@ btPersistentManifold : public btTypedObject
 
 	int m_cachedPoints;
 	int m_cacheSize;
+	bool m_ownsPointCache;  // false when the points were given to the constructor
 
 	btScalar m_contactBreakingThreshold;
 	btScalar m_contactProcessingThreshold;
@@ -107,6 +108,24 @@ public:
 	{
 		m_cacheSize = cacheSize;
 		m_pointCache = new btManifoldPoint[cacheSize];
+		m_ownsPointCache = true;
+	}
+
+	///the manifold uses the cacheSize points of pointCache, that stay owned by the caller, see btCollisionDispatcher::getNewManifold
+	btPersistentManifold(const btCollisionObject* body0, const btCollisionObject* body1, int, btScalar contactBreakingThreshold, btScalar contactProcessingThreshold, btManifoldPoint* pointCache, int cacheSize)
+		: btTypedObject(BT_PERSISTENT_MANIFOLD_TYPE),
+		  m_pointCache(pointCache),
+		  m_body0(body0),
+		  m_body1(body1),
+		  m_cachedPoints(0),
+		  m_cacheSize(cacheSize),
+		  m_ownsPointCache(false),
+		  m_contactBreakingThreshold(contactBreakingThreshold),
+		  m_contactProcessingThreshold(contactProcessingThreshold),
+		  m_companionIdA(0),
+		  m_companionIdB(0),
+		  m_index1a(0)
+	{
 	}
 
 	SIMD_FORCE_INLINE const btCollisionObject* getBody0() const { return m_body0; }
@@ -118,6 +137,17 @@ public:
 		m_body1 = body1;
 	}
 
+	///storage of the contact points, the caller frees it after freeContactPoint when it was given to the constructor
+	btManifoldPoint* getPointCache()
+	{
+		return m_pointCache;
+	}
+
+	int getCacheSize() const
+	{
+		return m_cacheSize;
+	}
+
 	void clearUserCache(btManifoldPoint & pt);
 
 	void btPersistentManifold::CopyContactsFromManifold(btPersistentManifold* mfPtr);
@@ -27,6 +27,9 @@ subject to the following restrictions:
 const int kNoMerge = -1;
 
 bool btBatchedConstraints::s_debugDrawBatches = false;
+int btBatchedConstraints::s_incrementalRebuildInterval = 120;
+int btBatchedConstraints::s_incrementalMaxExtraPhases = 2;
+btScalar btBatchedConstraints::s_incrementalMaxReassignedFraction = btScalar(0.25);
 
 struct btBatchedConstraintInfo
 {
@@ -1033,6 +1036,445 @@ static void setupSpatialGridBatchesMt(
 	btAssert(batchedConstraints->validate(constraints, bodies));
 }
 
+typedef btBatchedConstraints::CachedAssignment CachedAssignment;
+
+static const int kNoBatch = -1;
+static const int kNoRun = -1;
+
+static unsigned int hashBodyPair(const void* body0, const void* body1)
+{
+	// the low bits of the pointers are mostly zero, so mix them into the high bits and use those
+	unsigned long long key = static_cast<unsigned long long>(reinterpret_cast<size_t>(body0)) * 31 + reinterpret_cast<size_t>(body1);
+	key *= 0x9E3779B97F4A7C15ULL;
+	return static_cast<unsigned int>(key >> 32);
+}
+
+static int getRunTableSize(int numRuns)
+{
+	// keep the table at most half full so every probe ends on an empty slot
+	int tableSize = 64;
+	while (tableSize < numRuns * 2)
+	{
+		tableSize *= 2;
+	}
+	return tableSize;
+}
+
+// open addressing hash table from the bodies of a cached run to its index
+static void buildRunTable(int* runTable, int tableSize, const btAlignedObjectArray<CachedAssignment>& runs)
+{
+	BT_PROFILE("buildRunTable");
+	int mask = tableSize - 1;
+	for (int i = 0; i < tableSize; ++i)
+	{
+		runTable[i] = kNoRun;
+	}
+	for (int iRun = 0; iRun < runs.size(); ++iRun)
+	{
+		const CachedAssignment& run = runs[iRun];
+		int i = hashBodyPair(run.bodies[0], run.bodies[1]) & mask;
+		while (runTable[i] != kNoRun)
+		{
+			const CachedAssignment& other = runs[runTable[i]];
+			if (other.bodies[0] == run.bodies[0] && other.bodies[1] == run.bodies[1])
+			{
+				// the first run wins when the same bodies show up more than once
+				break;
+			}
+			i = (i + 1) & mask;
+		}
+		if (runTable[i] == kNoRun)
+		{
+			runTable[i] = iRun;
+		}
+	}
+}
+
+static int findRun(const int* runTable, int tableSize, const btAlignedObjectArray<CachedAssignment>& runs, const void* body0, const void* body1)
+{
+	int mask = tableSize - 1;
+	int i = hashBodyPair(body0, body1) & mask;
+	while (runTable[i] != kNoRun)
+	{
+		const CachedAssignment& run = runs[runTable[i]];
+		if (run.bodies[0] == body0 && run.bodies[1] == body1)
+		{
+			return runTable[i];
+		}
+		i = (i + 1) & mask;
+	}
+	return kNoRun;
+}
+
+//
+// cacheBatchAssignments -- remember the phase and batch of every run of rows for the next incremental setup
+//
+// The original bodies of a run identify the manifold of a contact and the constraint of a joint (several manifolds
+// or joints between the same two bodies share them, but they can always share a batch too).
+// The runs are kept in constraint order, which hardly changes from one step to the next.
+//
+static void cacheBatchAssignments(btBatchedConstraints* bc,
+								  btAlignedObjectArray<char>* scratchMemory,
+								  btConstraintArray* constraints,
+								  const btAlignedObjectArray<btSolverBody>& bodies)
+{
+	BT_PROFILE("cacheBatchAssignments");
+	typedef btBatchedConstraints::Range Range;
+	int numConstraintRows = constraints->size();
+	int* rowBatchIds = NULL;
+	int* batchPhases = NULL;
+	{
+		PreallocatedMemoryHelper<2> memHelper;
+		memHelper.addChunk((void**)&rowBatchIds, sizeof(int) * numConstraintRows);
+		memHelper.addChunk((void**)&batchPhases, sizeof(int) * bc->m_batches.size());
+		size_t scratchSize = memHelper.getSizeToAllocate();
+		if (static_cast<size_t>(scratchMemory->capacity()) < scratchSize)
+		{
+			scratchMemory->reserve(scratchSize + scratchSize / 16);
+		}
+		scratchMemory->resizeNoInitialize(scratchSize);
+		memHelper.setChunkPointers(&scratchMemory->at(0));
+	}
+	for (int iPhase = 0; iPhase < bc->m_phases.size(); ++iPhase)
+	{
+		const Range& phase = bc->m_phases[iPhase];
+		for (int iBatch = phase.begin; iBatch < phase.end; ++iBatch)
+		{
+			const Range& batch = bc->m_batches[iBatch];
+			batchPhases[iBatch] = iPhase;
+			for (int i = batch.begin; i < batch.end; ++i)
+			{
+				rowBatchIds[bc->m_constraintIndices[i]] = iBatch;
+			}
+		}
+	}
+	btAlignedObjectArray<CachedAssignment>& runs = bc->m_cachedAssignments;
+	runs.resizeNoInitialize(0);
+	int prevBodyIds[2] = {-1, -1};
+	for (int iRow = 0; iRow < numConstraintRows; ++iRow)
+	{
+		const btSolverConstraint& con = constraints->at(iRow);
+		if (con.m_solverBodyIdA != prevBodyIds[0] || con.m_solverBodyIdB != prevBodyIds[1])
+		{
+			prevBodyIds[0] = con.m_solverBodyIdA;
+			prevBodyIds[1] = con.m_solverBodyIdB;
+			CachedAssignment run;
+			run.bodies[0] = bodies[con.m_solverBodyIdA].m_originalBody;
+			run.bodies[1] = bodies[con.m_solverBodyIdB].m_originalBody;
+			run.batch = rowBatchIds[iRow];
+			run.phase = batchPhases[run.batch];
+			runs.push_back(run);
+		}
+	}
+}
+
+// puts the dynamic bodies of a constraint into a batch of the given phase, unless one of them is already in another batch of that phase
+static bool claimBodies(int* bodyBatchIds, const bool* bodyDynamicFlags, int numPhases, const btBatchedConstraintInfo& con, int iPhase, int iBatch)
+{
+	int* batchId0 = &bodyBatchIds[con.bodyIds[0] * numPhases + iPhase];
+	int* batchId1 = &bodyBatchIds[con.bodyIds[1] * numPhases + iPhase];
+	bool isDynamic0 = bodyDynamicFlags[con.bodyIds[0]];
+	bool isDynamic1 = bodyDynamicFlags[con.bodyIds[1]];
+	if ((isDynamic0 && *batchId0 != kNoBatch && *batchId0 != iBatch) || (isDynamic1 && *batchId1 != kNoBatch && *batchId1 != iBatch))
+	{
+		return false;
+	}
+	if (isDynamic0)
+	{
+		*batchId0 = iBatch;
+	}
+	if (isDynamic1)
+	{
+		*batchId1 = iBatch;
+	}
+	return true;
+}
+
+//
+// setupIncrementalBatchesMt -- generate batches starting from the assignment of the previous setup
+//
+/*
+
+In a scene that is mostly at rest, most constraints are between the same bodies as in the previous step, and the
+batches of the previous step are still valid for them. Only the dynamic bodies matter (see setupSpatialGridBatchesMt),
+so a batch stays valid as long as none of its dynamic bodies is used by another batch of the same phase.
+
+1. Every run of constraint rows between the same two bodies takes the phase and batch it had in the previous setup
+   (see cacheBatchAssignments), in constraint order, if its dynamic bodies are not in another batch of that phase yet.
+2. The rows that are new or conflict take the first phase where at most one batch uses their dynamic bodies: they join
+   that batch, or the smallest batch of the phase (a new one, when it is full) if neither body is used yet.
+3. The batches are written out like those of the spatial grid.
+
+Returns false, leaving the batches untouched, if too many rows got a new batch since the last full rebuild or some
+of them do not fit into the phases of the last full rebuild plus s_incrementalMaxExtraPhases. The caller then does a
+full rebuild.
+*/
+//
+static bool setupIncrementalBatchesMt(
+	btBatchedConstraints* bc,
+	btAlignedObjectArray<char>* scratchMemory,
+	btConstraintArray* constraints,
+	const btAlignedObjectArray<btSolverBody>& bodies,
+	int maxBatchSize)
+{
+	BT_PROFILE("setupIncrementalBatchesMt");
+	typedef btBatchedConstraints::Range Range;
+	const int numPhases = bc->m_numFullRebuildPhases + btBatchedConstraints::s_incrementalMaxExtraPhases;
+	const int numBodies = bodies.size();
+	const int numConstraintRows = constraints->size();
+	const int numPrevBatches = bc->m_batches.size();
+	const int runTableSize = getRunTableSize(bc->m_cachedAssignments.size());
+	// every run of rows adds at most one batch
+	const int maxNumBatches = numPrevBatches + numConstraintRows;
+	if (bc->m_phases.size() > numPhases)
+	{
+		return false;
+	}
+
+	const void** bodyKeys = NULL;
+	bool* bodyDynamicFlags = NULL;
+	int* bodyBatchIds = NULL;
+	btBatchedConstraintInfo* conInfos = NULL;
+	int* constraintBatchIds = NULL;
+	int* batchPhases = NULL;
+	int* batchRows = NULL;
+	int* batchBegins = NULL;
+	int* openBatchIds = NULL;
+	int* outBatchPhases = NULL;
+	int* rowOutBatchIds = NULL;
+	int* runTable = NULL;
+	{
+		PreallocatedMemoryHelper<12> memHelper;
+		memHelper.addChunk((void**)&bodyKeys, sizeof(void*) * numBodies);
+		memHelper.addChunk((void**)&bodyBatchIds, sizeof(int) * numBodies * numPhases);
+		memHelper.addChunk((void**)&conInfos, sizeof(btBatchedConstraintInfo) * numConstraintRows);
+		memHelper.addChunk((void**)&constraintBatchIds, sizeof(int) * numConstraintRows);
+		memHelper.addChunk((void**)&batchPhases, sizeof(int) * maxNumBatches);
+		memHelper.addChunk((void**)&batchRows, sizeof(int) * maxNumBatches);
+		memHelper.addChunk((void**)&batchBegins, sizeof(int) * maxNumBatches);
+		memHelper.addChunk((void**)&openBatchIds, sizeof(int) * numPhases);
+		memHelper.addChunk((void**)&outBatchPhases, sizeof(int) * maxNumBatches);
+		memHelper.addChunk((void**)&rowOutBatchIds, sizeof(int) * numConstraintRows);
+		memHelper.addChunk((void**)&runTable, sizeof(int) * runTableSize);
+		memHelper.addChunk((void**)&bodyDynamicFlags, sizeof(bool) * numBodies);
+		size_t scratchSize = memHelper.getSizeToAllocate();
+		// if we need to reallocate
+		if (static_cast<size_t>(scratchMemory->capacity()) < scratchSize)
+		{
+			// allocate 6.25% extra to avoid repeated reallocs
+			scratchMemory->reserve(scratchSize + scratchSize / 16);
+		}
+		scratchMemory->resizeNoInitialize(scratchSize);
+		char* memPtr = &scratchMemory->at(0);
+		memHelper.setChunkPointers(memPtr);
+	}
+
+	int numConstraints = initBatchedConstraintInfo(conInfos, constraints);
+
+	for (int i = 0; i < numBodies; ++i)
+	{
+		bodyKeys[i] = bodies[i].m_originalBody;
+		bodyDynamicFlags[i] = (bodies[i].internalGetInvMass().x() > btScalar(0));
+	}
+	for (int i = 0; i < numBodies * numPhases; ++i)
+	{
+		bodyBatchIds[i] = kNoBatch;
+	}
+	for (int iPhase = 0; iPhase < bc->m_phases.size(); ++iPhase)
+	{
+		const Range& phase = bc->m_phases[iPhase];
+		for (int iBatch = phase.begin; iBatch < phase.end; ++iBatch)
+		{
+			batchPhases[iBatch] = iPhase;
+			batchRows[iBatch] = 0;
+		}
+	}
+
+	// 1. keep the batches of the previous setup. The runs are matched with the cached runs one after the other,
+	//    and looked up by their bodies where the order changed
+	btAlignedObjectArray<CachedAssignment>& runs = bc->m_cachedAssignments;
+	bool runTableBuilt = false;
+	int iNextRun = 0;
+	int numReusedRows = 0;
+	int numReassignedRows = 0;
+	for (int iCon = 0; iCon < numConstraints; ++iCon)
+	{
+		const btBatchedConstraintInfo& con = conInfos[iCon];
+		const void* body0 = bodyKeys[con.bodyIds[0]];
+		const void* body1 = bodyKeys[con.bodyIds[1]];
+		int iRun = kNoRun;
+		if (iNextRun < runs.size() && runs[iNextRun].bodies[0] == body0 && runs[iNextRun].bodies[1] == body1)
+		{
+			iRun = iNextRun;
+		}
+		else
+		{
+			if (!runTableBuilt)
+			{
+				buildRunTable(runTable, runTableSize, runs);
+				runTableBuilt = true;
+			}
+			iRun = findRun(runTable, runTableSize, runs, body0, body1);
+		}
+		int iBatch = kNoBatch;
+		if (iRun != kNoRun)
+		{
+			iNextRun = iRun + 1;
+			const CachedAssignment& run = runs[iRun];
+			if (run.phase < numPhases && run.batch < numPrevBatches && claimBodies(bodyBatchIds, bodyDynamicFlags, numPhases, con, run.phase, run.batch))
+			{
+				iBatch = run.batch;
+			}
+		}
+		if (iBatch != kNoBatch)
+		{
+			batchRows[iBatch] += con.numConstraintRows;
+			numReusedRows += con.numConstraintRows;
+		}
+		else
+		{
+			numReassignedRows += con.numConstraintRows;
+		}
+		constraintBatchIds[iCon] = iBatch;
+	}
+	// the batches drift away from the spatial grid with every row that is assigned incrementally
+	if (bc->m_numReassignedRows + numReassignedRows > btBatchedConstraints::s_incrementalMaxReassignedFraction * numConstraintRows)
+	{
+		return false;
+	}
+
+	// 2. assign the new and the conflicting rows
+	for (int iPhase = 0; iPhase < numPhases; ++iPhase)
+	{
+		openBatchIds[iPhase] = kNoBatch;
+	}
+	for (int iBatch = 0; iBatch < numPrevBatches; ++iBatch)
+	{
+		int& openBatch = openBatchIds[batchPhases[iBatch]];
+		if (openBatch == kNoBatch || batchRows[iBatch] < batchRows[openBatch])
+		{
+			openBatch = iBatch;
+		}
+	}
+	int numBatches = numPrevBatches;
+	for (int iCon = 0; iCon < numConstraints; ++iCon)
+	{
+		if (constraintBatchIds[iCon] != kNoBatch)
+		{
+			continue;
+		}
+		const btBatchedConstraintInfo& con = conInfos[iCon];
+		for (int iPhase = 0; iPhase < numPhases; ++iPhase)
+		{
+			int batchId0 = bodyDynamicFlags[con.bodyIds[0]] ? bodyBatchIds[con.bodyIds[0] * numPhases + iPhase] : kNoBatch;
+			int batchId1 = bodyDynamicFlags[con.bodyIds[1]] ? bodyBatchIds[con.bodyIds[1] * numPhases + iPhase] : kNoBatch;
+			if (batchId0 != kNoBatch && batchId1 != kNoBatch && batchId0 != batchId1)
+			{
+				continue;
+			}
+			int iBatch = (batchId0 != kNoBatch) ? batchId0 : batchId1;
+			if (iBatch == kNoBatch)
+			{
+				iBatch = openBatchIds[iPhase];
+				if (iBatch == kNoBatch || batchRows[iBatch] + con.numConstraintRows > maxBatchSize)
+				{
+					iBatch = numBatches++;
+					batchPhases[iBatch] = iPhase;
+					batchRows[iBatch] = 0;
+					openBatchIds[iPhase] = iBatch;
+				}
+			}
+			else if (batchRows[iBatch] + con.numConstraintRows > maxBatchSize * 2)
+			{
+				// don't let a batch grow without bounds, try the next phase
+				continue;
+			}
+			claimBodies(bodyBatchIds, bodyDynamicFlags, numPhases, con, iPhase, iBatch);
+			batchRows[iBatch] += con.numConstraintRows;
+			constraintBatchIds[iCon] = iBatch;
+			break;
+		}
+		if (constraintBatchIds[iCon] == kNoBatch)
+		{
+			return false;
+		}
+	}
+
+	// 3. write out the batches phase by phase, and remember where every run ended up for the next setup
+	bc->m_batches.resizeNoInitialize(0);
+	bc->m_phases.resizeNoInitialize(0);
+	int iConstraint = 0;
+	for (int iPhase = 0; iPhase < numPhases; ++iPhase)
+	{
+		int curPhaseBegin = bc->m_batches.size();
+		for (int iBatch = 0; iBatch < numBatches; ++iBatch)
+		{
+			if (batchPhases[iBatch] == iPhase && batchRows[iBatch] > 0)
+			{
+				batchBegins[iBatch] = iConstraint;
+				iConstraint += batchRows[iBatch];
+				bc->m_batches.push_back(Range(batchBegins[iBatch], iConstraint));
+			}
+		}
+		// if any batches were emitted this phase,
+		if (bc->m_batches.size() > curPhaseBegin)
+		{
+			// output phase
+			bc->m_phases.push_back(Range(curPhaseBegin, bc->m_batches.size()));
+		}
+	}
+	btAssert(iConstraint == numConstraintRows);
+	for (int iPhase = 0; iPhase < bc->m_phases.size(); ++iPhase)
+	{
+		// sort the batches from largest to smallest (can be helpful to some task schedulers)
+		const Range& curBatches = bc->m_phases[iPhase];
+		bc->m_batches.quickSortInternal(BatchCompare, curBatches.begin, curBatches.end - 1);
+		// the batches are found by their first row after sorting
+		for (int iOutBatch = curBatches.begin; iOutBatch < curBatches.end; ++iOutBatch)
+		{
+			rowOutBatchIds[bc->m_batches[iOutBatch].begin] = iOutBatch;
+			outBatchPhases[iOutBatch] = iPhase;
+		}
+	}
+	bc->m_constraintIndices.resizeNoInitialize(numConstraintRows);
+	runs.resizeNoInitialize(numConstraints);
+	// batchRows is the next free row of each batch from here on
+	for (int iBatch = 0; iBatch < numBatches; ++iBatch)
+	{
+		if (batchRows[iBatch] > 0)
+		{
+			batchRows[iBatch] = batchBegins[iBatch];
+		}
+	}
+	for (int iCon = 0; iCon < numConstraints; ++iCon)
+	{
+		const btBatchedConstraintInfo& con = conInfos[iCon];
+		int iBatch = constraintBatchIds[iCon];
+		int iOutBatch = rowOutBatchIds[batchBegins[iBatch]];
+		int& iDest = batchRows[iBatch];
+		for (int i = 0; i < con.numConstraintRows; ++i)
+		{
+			bc->m_constraintIndices[iDest++] = con.constraintIndex + i;
+		}
+		CachedAssignment& run = runs[iCon];
+		run.bodies[0] = bodyKeys[con.bodyIds[0]];
+		run.bodies[1] = bodyKeys[con.bodyIds[1]];
+		run.phase = outBatchPhases[iOutBatch];
+		run.batch = iOutBatch;
+	}
+	bc->m_phaseOrder.resize(bc->m_phases.size());
+	for (int i = 0; i < bc->m_phases.size(); ++i)
+	{
+		bc->m_phaseOrder[i] = i;
+	}
+	writeGrainSizes(bc);
+	bc->m_numReassignedRows += numReassignedRows;
+	bc->m_stats.numReusedRows = numReusedRows;
+	bc->m_stats.numReassignedRows = numReassignedRows;
+	btAssert(bc->validate(constraints, bodies));
+	return true;
+}
+
 static void setupSingleBatch(
 	btBatchedConstraints* bc,
 	int numConstraints)
@@ -1060,6 +1502,22 @@ static void setupSingleBatch(
 	}
 }
 
+static void writeStats(btBatchedConstraints* bc)
+{
+	btBatchedConstraints::Stats& stats = bc->m_stats;
+	stats.numPhases = bc->m_phases.size();
+	stats.numBatches = bc->m_batches.size();
+	stats.minBatchRows = 0;
+	stats.maxBatchRows = 0;
+	for (int iBatch = 0; iBatch < bc->m_batches.size(); ++iBatch)
+	{
+		const btBatchedConstraints::Range& batch = bc->m_batches[iBatch];
+		int numRows = batch.end - batch.begin;
+		stats.minBatchRows = (iBatch == 0) ? numRows : btMin(stats.minBatchRows, numRows);
+		stats.maxBatchRows = btMax(stats.maxBatchRows, numRows);
+	}
+}
+
 void btBatchedConstraints::setup(
 	btConstraintArray* constraints,
 	const btAlignedObjectArray<btSolverBody>& bodies,
@@ -1068,10 +1526,33 @@ void btBatchedConstraints::setup(
 	int maxBatchSize,
 	btAlignedObjectArray<char>* scratchMemory)
 {
+	btClock clock;
+	m_stats = Stats();
+	m_stats.numConstraintRows = constraints->size();
 	if (constraints->size() >= minBatchSize * 4)
 	{
-		bool use2DGrid = batchingMethod == BATCHING_METHOD_SPATIAL_GRID_2D;
-		setupSpatialGridBatchesMt(this, scratchMemory, constraints, bodies, minBatchSize, maxBatchSize, use2DGrid);
+		bool incremental = batchingMethod == BATCHING_METHOD_INCREMENTAL_SPATIAL_GRID_2D || batchingMethod == BATCHING_METHOD_INCREMENTAL_SPATIAL_GRID_3D;
+		bool use2DGrid = batchingMethod == BATCHING_METHOD_SPATIAL_GRID_2D || batchingMethod == BATCHING_METHOD_INCREMENTAL_SPATIAL_GRID_2D;
+		bool done = false;
+		if (incremental && m_numFullRebuildPhases > 0 && (s_incrementalRebuildInterval <= 0 || m_numIncrementalSetups < s_incrementalRebuildInterval))
+		{
+			done = setupIncrementalBatchesMt(this, scratchMemory, constraints, bodies, maxBatchSize);
+			m_numIncrementalSetups++;
+		}
+		if (!done)
+		{
+			setupSpatialGridBatchesMt(this, scratchMemory, constraints, bodies, minBatchSize, maxBatchSize, use2DGrid);
+			m_stats.fullRebuild = true;
+			m_numIncrementalSetups = 0;
+			m_numReassignedRows = 0;
+			m_numFullRebuildPhases = 0;
+			if (incremental)
+			{
+				// the incremental setup keeps the cache up to date itself
+				cacheBatchAssignments(this, scratchMemory, constraints, bodies);
+				m_numFullRebuildPhases = m_phases.size();
+			}
+		}
 		if (s_debugDrawBatches)
 		{
 			debugDrawAllBatches(this, constraints, bodies);
@@ -1080,5 +1561,8 @@ void btBatchedConstraints::setup(
 	else
 	{
 		setupSingleBatch(this, constraints->size());
+		m_numFullRebuildPhases = 0;
 	}
+	writeStats(this);
+	m_stats.setupNanoseconds = clock.getTimeNanoseconds();
 }
@@ -29,6 +29,11 @@ struct btBatchedConstraints
 	{
 		BATCHING_METHOD_SPATIAL_GRID_2D,
 		BATCHING_METHOD_SPATIAL_GRID_3D,
+		// carry the phase and batch of each constraint over from the previous setup, and only assign
+		// the constraints that are new or now conflict with another batch. The 2D or 3D spatial grid
+		// is used for the first setup and whenever the previous assignment is no longer good enough
+		BATCHING_METHOD_INCREMENTAL_SPATIAL_GRID_2D,
+		BATCHING_METHOD_INCREMENTAL_SPATIAL_GRID_3D,
 		BATCHING_METHOD_COUNT
 	};
 	struct Range
@@ -39,6 +44,39 @@ struct btBatchedConstraints
 		Range() : begin(0), end(0) {}
 		Range(int _beg, int _end) : begin(_beg), end(_end) {}
 	};
+	// batch quality and timing of the last setup
+	struct Stats
+	{
+		int numConstraintRows;
+		int numPhases;
+		int numBatches;
+		int minBatchRows;
+		int maxBatchRows;
+		int numReusedRows;      // rows that kept the batch of the previous setup
+		int numReassignedRows;  // rows that were new or conflicting and were assigned incrementally
+		bool fullRebuild;       // the batches were built from scratch
+		unsigned long long setupNanoseconds;
+
+		Stats()
+		{
+			numConstraintRows = 0;
+			numPhases = 0;
+			numBatches = 0;
+			minBatchRows = 0;
+			maxBatchRows = 0;
+			numReusedRows = 0;
+			numReassignedRows = 0;
+			fullRebuild = false;
+			setupNanoseconds = 0;
+		}
+	};
+	// phase and batch of a run of rows between the same two bodies in the previous setup
+	struct CachedAssignment
+	{
+		const void* bodies[2];  // original bodies of the solver bodies, NULL for the fixed body
+		int phase;
+		int batch;
+	};
 
 	btAlignedObjectArray<int> m_constraintIndices;
 	btAlignedObjectArray<Range> m_batches;        // each batch is a range of indices in the m_constraintIndices array
@@ -46,10 +84,24 @@ struct btBatchedConstraints
 	btAlignedObjectArray<char> m_phaseGrainSize;  // max grain size for each phase
 	btAlignedObjectArray<int> m_phaseOrder;       // phases can be done in any order, so we can randomize the order here
 	btIDebugDraw* m_debugDrawer;
+	Stats m_stats;
+	btAlignedObjectArray<CachedAssignment> m_cachedAssignments;  // runs of the previous setup in constraint order, for incremental batching
+	int m_numFullRebuildPhases;                                  // number of phases of the last full rebuild
+	int m_numIncrementalSetups;                                  // number of incremental setups since the last full rebuild
+	int m_numReassignedRows;                                     // rows assigned incrementally since the last full rebuild
 
 	static bool s_debugDrawBatches;
+	static int s_incrementalRebuildInterval;             // do a full rebuild after this many incremental setups, 0 for never
+	static int s_incrementalMaxExtraPhases;              // phases an incremental setup may add to those of the last full rebuild
+	static btScalar s_incrementalMaxReassignedFraction;  // do a full rebuild when more of the rows than this got a new batch since the last one
 
-	btBatchedConstraints() { m_debugDrawer = NULL; }
+	btBatchedConstraints()
+	{
+		m_debugDrawer = NULL;
+		m_numFullRebuildPhases = 0;
+		m_numIncrementalSetups = 0;
+		m_numReassignedRows = 0;
+	}
 	void setup(btConstraintArray* constraints,
 			   const btAlignedObjectArray<btSolverBody>& bodies,
 			   BatchingMethod batchingMethod,
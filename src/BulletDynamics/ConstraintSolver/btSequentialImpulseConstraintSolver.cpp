@@ -32,6 +32,7 @@ subject to the following restrictions:
 #include <new>
 #include "LinearMath/btStackAlloc.h"
 #include "LinearMath/btQuickprof.h"
+#include "LinearMath/btThreads.h"
 //#include "btSolverBody.h"
 //#include "btSolverConstraint.h"
 #include "LinearMath/btAlignedObjectArray.h"
@@ -39,6 +40,36 @@ subject to the following restrictions:
 
 int gNumSplitImpulseRecoveries = 0;
 
+int btSequentialImpulseConstraintSolver::s_minimumContactManifoldsForParallelConversion = 100;
+bool btSequentialImpulseConstraintSolver::s_allowSingleThreadedBatchedConversion = false;
+
+static const int kContactRowSetupGrainSize = 50;  // manifolds
+static const int kJointConversionGrainSize = 20;  // joints
+
+// grows the pool like expandNonInitializing does, resizeNoInitialize would reallocate it whenever a step has a few more rows
+static void resizeConstraintPool(btConstraintArray& pool, int newSize)
+{
+	if (newSize > pool.capacity())
+	{
+		pool.reserve(btMax(newSize, pool.capacity() * 2));
+	}
+	pool.resizeNoInitialize(newSize);
+}
+
+// the conversion loops run in btParallelFor tasks with a task scheduler, unless the solver itself runs in a task (islands solved
+// in parallel), otherwise inline
+static void btSolverConversionParallelFor(int iBegin, int iEnd, int grainSize, const btIParallelForBody& body)
+{
+#if BT_THREADSAFE
+	if (btGetTaskScheduler() && !btThreadsAreRunning())
+	{
+		btParallelFor(iBegin, iEnd, grainSize, body);
+		return;
+	}
+#endif
+	body.forLoop(iBegin, iEnd);
+}
+
 #include "BulletDynamics/Dynamics/btRigidBody.h"
 
 //#define VERBOSE_RESIDUAL_PRINTF 1
@@ -797,7 +828,8 @@ void btSequentialImpulseConstraintSolver::setupContactConstraint(btSolverConstra
 	int solverBodyIdA, int solverBodyIdB,
 	btManifoldPoint& cp, const btContactSolverInfo& infoGlobal,
 	btScalar& relaxation,
-	const btVector3& rel_pos1, const btVector3& rel_pos2)
+	const btVector3& rel_pos1, const btVector3& rel_pos2,
+	bool applyWarmstartImpulse)
 {
 	//	const btVector3& pos1 = cp.getPositionWorldOnA();
 	//	const btVector3& pos2 = cp.getPositionWorldOnB();
@@ -924,10 +956,14 @@ void btSequentialImpulseConstraintSolver::setupContactConstraint(btSolverConstra
 	if (infoGlobal.m_solverMode & SOLVER_USE_WARMSTARTING)
 	{
 		solverConstraint.m_appliedImpulse = cp.m_appliedImpulse * infoGlobal.m_warmstartingFactor;
-		if (rb0)
-			bodyA->internalApplyImpulse(solverConstraint.m_contactNormal1 * bodyA->internalGetInvMass(), solverConstraint.m_angularComponentA, solverConstraint.m_appliedImpulse);
-		if (rb1)
-			bodyB->internalApplyImpulse(-solverConstraint.m_contactNormal2 * bodyB->internalGetInvMass(), -solverConstraint.m_angularComponentB, -(btScalar)solverConstraint.m_appliedImpulse);
+		//the batched conversion applies the impulses afterwards, in row order
+		if (applyWarmstartImpulse)
+		{
+			if (rb0)
+				bodyA->internalApplyImpulse(solverConstraint.m_contactNormal1 * bodyA->internalGetInvMass(), solverConstraint.m_angularComponentA, solverConstraint.m_appliedImpulse);
+			if (rb1)
+				bodyB->internalApplyImpulse(-solverConstraint.m_contactNormal2 * bodyB->internalGetInvMass(), -solverConstraint.m_angularComponentB, -(btScalar)solverConstraint.m_appliedImpulse);
+		}
 	}
 	else
 	{
@@ -999,7 +1035,26 @@ void btSequentialImpulseConstraintSolver::setFrictionConstraintImpulse(btSolverC
 	}
 }
 
-void btSequentialImpulseConstraintSolver::convertContact(btPersistentManifold* manifold, const btContactSolverInfo& infoGlobal)
+int btSequentialImpulseConstraintSolver::getRollingFrictionAxes(const btManifoldPoint& cp, btCollisionObject* colObj0, btCollisionObject* colObj1, btVector3* axes)
+{
+	btVector3 axis0, axis1;
+	btPlaneSpace1(cp.m_normalWorldOnB, axis0, axis1);
+	axis0.normalize();
+	axis1.normalize();
+
+	applyAnisotropicFriction(colObj0, axis0, btCollisionObject::CF_ANISOTROPIC_ROLLING_FRICTION);
+	applyAnisotropicFriction(colObj1, axis0, btCollisionObject::CF_ANISOTROPIC_ROLLING_FRICTION);
+	applyAnisotropicFriction(colObj0, axis1, btCollisionObject::CF_ANISOTROPIC_ROLLING_FRICTION);
+	applyAnisotropicFriction(colObj1, axis1, btCollisionObject::CF_ANISOTROPIC_ROLLING_FRICTION);
+	int numAxes = 0;
+	if (axis0.length() > 0.001)
+		axes[numAxes++] = axis0;
+	if (axis1.length() > 0.001)
+		axes[numAxes++] = axis1;
+	return numAxes;
+}
+
+bool btSequentialImpulseConstraintSolver::initContactManifoldConversion(btContactManifoldConversion& conversion, btPersistentManifold* manifold, const btContactSolverInfo& infoGlobal)
 {
 	btCollisionObject *colObj0 = 0, *colObj1 = 0;
 
@@ -1021,159 +1076,336 @@ void btSequentialImpulseConstraintSolver::convertContact(btPersistentManifold* m
 	int solverBodyIdA = getOrInitSolverBody(*colObj0, infoGlobal.m_timeStep);
 	int solverBodyIdB = getOrInitSolverBody(*colObj1, infoGlobal.m_timeStep);
 
-	//	btRigidBody* bodyA = btRigidBody::upcast(colObj0);
-	//	btRigidBody* bodyB = btRigidBody::upcast(colObj1);
-
 	btSolverBody* solverBodyA = &m_tmpSolverBodyPool[solverBodyIdA];
 	btSolverBody* solverBodyB = &m_tmpSolverBodyPool[solverBodyIdB];
 
 	///avoid collision response between two static objects
 	if (!solverBodyA || (solverBodyA->m_invMass.fuzzyZero() && (!solverBodyB || solverBodyB->m_invMass.fuzzyZero())))
-		return;
+		return false;
+
+	conversion.m_manifold = manifold;
+	conversion.m_colObj0 = colObj0;
+	conversion.m_colObj1 = colObj1;
+	conversion.m_solverBodyIdA = solverBodyIdA;
+	conversion.m_solverBodyIdB = solverBodyIdB;
+	conversion.m_contactIndex = -1;
+	conversion.m_frictionIndex = -1;
+	conversion.m_rollingFrictionIndex = -1;
+	conversion.m_numContacts = 0;
+	conversion.m_numRollingFrictions = 0;
+	return true;
+}
 
-	int rollingFriction = 1;
-	for (int j = 0; j < manifold->getNumContacts(); j++)
-	{
-		btManifoldPoint& cp = manifold->getContactPoint(j);
+int btSequentialImpulseConstraintSolver::setupContactRows(const btContactManifoldConversion& conversion, btManifoldPoint& cp, int contactIndex, int frictionIndex, int rollingFrictionIndex,
+	const btContactSolverInfo& infoGlobal, bool applyWarmstartImpulse)
+{
+	btCollisionObject* colObj0 = conversion.m_colObj0;
+	btCollisionObject* colObj1 = conversion.m_colObj1;
+	int solverBodyIdA = conversion.m_solverBodyIdA;
+	int solverBodyIdB = conversion.m_solverBodyIdB;
+	const btSolverBody* solverBodyA = &m_tmpSolverBodyPool[solverBodyIdA];
+	const btSolverBody* solverBodyB = &m_tmpSolverBodyPool[solverBodyIdB];
+
+	btVector3 rel_pos1;
+	btVector3 rel_pos2;
+	btScalar relaxation;
+
+	btSolverConstraint& solverConstraint = m_tmpSolverContactConstraintPool[contactIndex];
+	solverConstraint.m_solverBodyIdA = solverBodyIdA;
+	solverConstraint.m_solverBodyIdB = solverBodyIdB;
 
-		if (cp.getDistance() <= manifold->getContactProcessingThreshold())
-		{
-			btVector3 rel_pos1;
-			btVector3 rel_pos2;
-			btScalar relaxation;
+	solverConstraint.m_originalContactPoint = &cp;
+
+	const btVector3& pos1 = cp.getPositionWorldOnA();
+	const btVector3& pos2 = cp.getPositionWorldOnB();
+
+	rel_pos1 = pos1 - colObj0->getWorldTransform().getOrigin();
+	rel_pos2 = pos2 - colObj1->getWorldTransform().getOrigin();
+
+	btVector3 vel1;
+	btVector3 vel2;
+
+	solverBodyA->getVelocityInLocalPointNoDelta(rel_pos1, vel1);
+	solverBodyB->getVelocityInLocalPointNoDelta(rel_pos2, vel2);
 
-			int frictionIndex = m_tmpSolverContactConstraintPool.size();
-			btSolverConstraint& solverConstraint = m_tmpSolverContactConstraintPool.expandNonInitializing();
-			solverConstraint.m_solverBodyIdA = solverBodyIdA;
-			solverConstraint.m_solverBodyIdB = solverBodyIdB;
+	btVector3 vel = vel1 - vel2;
+	btScalar rel_vel = cp.m_normalWorldOnB.dot(vel);
 
-			solverConstraint.m_originalContactPoint = &cp;
+	setupContactConstraint(solverConstraint, solverBodyIdA, solverBodyIdB, cp, infoGlobal, relaxation, rel_pos1, rel_pos2, applyWarmstartImpulse);
 
-			const btVector3& pos1 = cp.getPositionWorldOnA();
-			const btVector3& pos2 = cp.getPositionWorldOnB();
+	/////setup the friction constraints
 
-			rel_pos1 = pos1 - colObj0->getWorldTransform().getOrigin();
-			rel_pos2 = pos2 - colObj1->getWorldTransform().getOrigin();
+	solverConstraint.m_frictionIndex = frictionIndex;
 
-			btVector3 vel1;
-			btVector3 vel2;
+	int numRollingFrictions = 0;
+	if (cp.m_combinedRollingFriction > 0.f)
+	{
+		btSolverConstraint* rollingFrictionConstraints = &m_tmpSolverContactRollingFrictionConstraintPool[rollingFrictionIndex];
+		rollingFrictionConstraints[0].m_frictionIndex = contactIndex;
+		setupTorsionalFrictionConstraint(rollingFrictionConstraints[0], cp.m_normalWorldOnB, solverBodyIdA, solverBodyIdB, cp, cp.m_combinedSpinningFriction, rel_pos1, rel_pos2, colObj0, colObj1, relaxation);
 
-			solverBodyA->getVelocityInLocalPointNoDelta(rel_pos1, vel1);
-			solverBodyB->getVelocityInLocalPointNoDelta(rel_pos2, vel2);
+		btVector3 axes[2];
+		int numAxes = getRollingFrictionAxes(cp, colObj0, colObj1, axes);
+		for (int i = 0; i < numAxes; i++)
+		{
+			rollingFrictionConstraints[1 + i].m_frictionIndex = contactIndex;
+			setupTorsionalFrictionConstraint(rollingFrictionConstraints[1 + i], axes[i], solverBodyIdA, solverBodyIdB, cp,
+				cp.m_combinedRollingFriction, rel_pos1, rel_pos2, colObj0, colObj1, relaxation);
+		}
+		numRollingFrictions = 1 + numAxes;
+	}
 
-			btVector3 vel = vel1 - vel2;
-			btScalar rel_vel = cp.m_normalWorldOnB.dot(vel);
+	///Bullet has several options to set the friction directions
+	///By default, each contact has only a single friction direction that is recomputed automatically very frame
+	///based on the relative linear velocity.
+	///If the relative velocity it zero, it will automatically compute a friction direction.
+
+	///You can also enable two friction directions, using the SOLVER_USE_2_FRICTION_DIRECTIONS.
+	///In that case, the second friction direction will be orthogonal to both contact normal and first friction direction.
+	///
+	///If you choose SOLVER_DISABLE_VELOCITY_DEPENDENT_FRICTION_DIRECTION, then the friction will be independent from the relative projected velocity.
+	///
+	///The user can manually override the friction directions for certain contacts using a contact callback,
+	///and use contactPoint.m_contactPointFlags |= BT_CONTACT_FLAG_LATERAL_FRICTION_INITIALIZED
+	///In that case, you can set the target relative motion in each friction direction (cp.m_contactMotion1 and cp.m_contactMotion2)
+	///this will give a conveyor belt effect
+	///
+
+	btSolverConstraint* frictionConstraints = &m_tmpSolverContactFrictionConstraintPool[frictionIndex];
+	frictionConstraints[0].m_frictionIndex = contactIndex;
+	if ((infoGlobal.m_solverMode & SOLVER_USE_2_FRICTION_DIRECTIONS))
+		frictionConstraints[1].m_frictionIndex = contactIndex;
 
-			setupContactConstraint(solverConstraint, solverBodyIdA, solverBodyIdB, cp, infoGlobal, relaxation, rel_pos1, rel_pos2);
+	if (!(infoGlobal.m_solverMode & SOLVER_ENABLE_FRICTION_DIRECTION_CACHING) || !(cp.m_contactPointFlags & BT_CONTACT_FLAG_LATERAL_FRICTION_INITIALIZED))
+	{
+		cp.m_lateralFrictionDir1 = vel - cp.m_normalWorldOnB * rel_vel;
+		btScalar lat_rel_vel = cp.m_lateralFrictionDir1.length2();
+		if (!(infoGlobal.m_solverMode & SOLVER_DISABLE_VELOCITY_DEPENDENT_FRICTION_DIRECTION) && lat_rel_vel > SIMD_EPSILON)
+		{
+			cp.m_lateralFrictionDir1 *= 1.f / btSqrt(lat_rel_vel);
+			applyAnisotropicFriction(colObj0, cp.m_lateralFrictionDir1, btCollisionObject::CF_ANISOTROPIC_FRICTION);
+			applyAnisotropicFriction(colObj1, cp.m_lateralFrictionDir1, btCollisionObject::CF_ANISOTROPIC_FRICTION);
+			setupFrictionConstraint(frictionConstraints[0], cp.m_lateralFrictionDir1, solverBodyIdA, solverBodyIdB, cp, rel_pos1, rel_pos2, colObj0, colObj1, relaxation, infoGlobal);
 
-			/////setup the friction constraints
+			if ((infoGlobal.m_solverMode & SOLVER_USE_2_FRICTION_DIRECTIONS))
+			{
+				cp.m_lateralFrictionDir2 = cp.m_lateralFrictionDir1.cross(cp.m_normalWorldOnB);
+				cp.m_lateralFrictionDir2.normalize();  //??
+				applyAnisotropicFriction(colObj0, cp.m_lateralFrictionDir2, btCollisionObject::CF_ANISOTROPIC_FRICTION);
+				applyAnisotropicFriction(colObj1, cp.m_lateralFrictionDir2, btCollisionObject::CF_ANISOTROPIC_FRICTION);
+				setupFrictionConstraint(frictionConstraints[1], cp.m_lateralFrictionDir2, solverBodyIdA, solverBodyIdB, cp, rel_pos1, rel_pos2, colObj0, colObj1, relaxation, infoGlobal);
+			}
+		}
+		else
+		{
+			btPlaneSpace1(cp.m_normalWorldOnB, cp.m_lateralFrictionDir1, cp.m_lateralFrictionDir2);
 
-			solverConstraint.m_frictionIndex = m_tmpSolverContactFrictionConstraintPool.size();
+			applyAnisotropicFriction(colObj0, cp.m_lateralFrictionDir1, btCollisionObject::CF_ANISOTROPIC_FRICTION);
+			applyAnisotropicFriction(colObj1, cp.m_lateralFrictionDir1, btCollisionObject::CF_ANISOTROPIC_FRICTION);
+			setupFrictionConstraint(frictionConstraints[0], cp.m_lateralFrictionDir1, solverBodyIdA, solverBodyIdB, cp, rel_pos1, rel_pos2, colObj0, colObj1, relaxation, infoGlobal);
 
-			if ((cp.m_combinedRollingFriction > 0.f) && (rollingFriction > 0))
+			if ((infoGlobal.m_solverMode & SOLVER_USE_2_FRICTION_DIRECTIONS))
 			{
-				{
-					addTorsionalFrictionConstraint(cp.m_normalWorldOnB, solverBodyIdA, solverBodyIdB, frictionIndex, cp, cp.m_combinedSpinningFriction, rel_pos1, rel_pos2, colObj0, colObj1, relaxation);
-					btVector3 axis0, axis1;
-					btPlaneSpace1(cp.m_normalWorldOnB, axis0, axis1);
-					axis0.normalize();
-					axis1.normalize();
-
-					applyAnisotropicFriction(colObj0, axis0, btCollisionObject::CF_ANISOTROPIC_ROLLING_FRICTION);
-					applyAnisotropicFriction(colObj1, axis0, btCollisionObject::CF_ANISOTROPIC_ROLLING_FRICTION);
-					applyAnisotropicFriction(colObj0, axis1, btCollisionObject::CF_ANISOTROPIC_ROLLING_FRICTION);
-					applyAnisotropicFriction(colObj1, axis1, btCollisionObject::CF_ANISOTROPIC_ROLLING_FRICTION);
-					if (axis0.length() > 0.001)
-						addTorsionalFrictionConstraint(axis0, solverBodyIdA, solverBodyIdB, frictionIndex, cp,
-							cp.m_combinedRollingFriction, rel_pos1, rel_pos2, colObj0, colObj1, relaxation);
-					if (axis1.length() > 0.001)
-						addTorsionalFrictionConstraint(axis1, solverBodyIdA, solverBodyIdB, frictionIndex, cp,
-							cp.m_combinedRollingFriction, rel_pos1, rel_pos2, colObj0, colObj1, relaxation);
-					}
-				}
+				applyAnisotropicFriction(colObj0, cp.m_lateralFrictionDir2, btCollisionObject::CF_ANISOTROPIC_FRICTION);
+				applyAnisotropicFriction(colObj1, cp.m_lateralFrictionDir2, btCollisionObject::CF_ANISOTROPIC_FRICTION);
+				setupFrictionConstraint(frictionConstraints[1], cp.m_lateralFrictionDir2, solverBodyIdA, solverBodyIdB, cp, rel_pos1, rel_pos2, colObj0, colObj1, relaxation, infoGlobal);
+			}
 
-			///Bullet has several options to set the friction directions
-			///By default, each contact has only a single friction direction that is recomputed automatically very frame
-			///based on the relative linear velocity.
-			///If the relative velocity it zero, it will automatically compute a friction direction.
-
-			///You can also enable two friction directions, using the SOLVER_USE_2_FRICTION_DIRECTIONS.
-			///In that case, the second friction direction will be orthogonal to both contact normal and first friction direction.
-			///
-			///If you choose SOLVER_DISABLE_VELOCITY_DEPENDENT_FRICTION_DIRECTION, then the friction will be independent from the relative projected velocity.
-			///
-			///The user can manually override the friction directions for certain contacts using a contact callback,
-			///and use contactPoint.m_contactPointFlags |= BT_CONTACT_FLAG_LATERAL_FRICTION_INITIALIZED
-			///In that case, you can set the target relative motion in each friction direction (cp.m_contactMotion1 and cp.m_contactMotion2)
-			///this will give a conveyor belt effect
-			///
-
-			if (!(infoGlobal.m_solverMode & SOLVER_ENABLE_FRICTION_DIRECTION_CACHING) || !(cp.m_contactPointFlags & BT_CONTACT_FLAG_LATERAL_FRICTION_INITIALIZED))
+			if ((infoGlobal.m_solverMode & SOLVER_USE_2_FRICTION_DIRECTIONS) && (infoGlobal.m_solverMode & SOLVER_DISABLE_VELOCITY_DEPENDENT_FRICTION_DIRECTION))
 			{
-				cp.m_lateralFrictionDir1 = vel - cp.m_normalWorldOnB * rel_vel;
-				btScalar lat_rel_vel = cp.m_lateralFrictionDir1.length2();
-				if (!(infoGlobal.m_solverMode & SOLVER_DISABLE_VELOCITY_DEPENDENT_FRICTION_DIRECTION) && lat_rel_vel > SIMD_EPSILON)
-				{
-					cp.m_lateralFrictionDir1 *= 1.f / btSqrt(lat_rel_vel);
-					applyAnisotropicFriction(colObj0, cp.m_lateralFrictionDir1, btCollisionObject::CF_ANISOTROPIC_FRICTION);
-					applyAnisotropicFriction(colObj1, cp.m_lateralFrictionDir1, btCollisionObject::CF_ANISOTROPIC_FRICTION);
-					addFrictionConstraint(cp.m_lateralFrictionDir1, solverBodyIdA, solverBodyIdB, frictionIndex, cp, rel_pos1, rel_pos2, colObj0, colObj1, relaxation, infoGlobal);
+				cp.m_contactPointFlags |= BT_CONTACT_FLAG_LATERAL_FRICTION_INITIALIZED;
+			}
+		}
+	}
+	else
+	{
+		setupFrictionConstraint(frictionConstraints[0], cp.m_lateralFrictionDir1, solverBodyIdA, solverBodyIdB, cp, rel_pos1, rel_pos2, colObj0, colObj1, relaxation, infoGlobal, cp.m_contactMotion1, cp.m_frictionCFM);
 
-					if ((infoGlobal.m_solverMode & SOLVER_USE_2_FRICTION_DIRECTIONS))
-					{
-						cp.m_lateralFrictionDir2 = cp.m_lateralFrictionDir1.cross(cp.m_normalWorldOnB);
-						cp.m_lateralFrictionDir2.normalize();  //??
-						applyAnisotropicFriction(colObj0, cp.m_lateralFrictionDir2, btCollisionObject::CF_ANISOTROPIC_FRICTION);
-						applyAnisotropicFriction(colObj1, cp.m_lateralFrictionDir2, btCollisionObject::CF_ANISOTROPIC_FRICTION);
-						addFrictionConstraint(cp.m_lateralFrictionDir2, solverBodyIdA, solverBodyIdB, frictionIndex, cp, rel_pos1, rel_pos2, colObj0, colObj1, relaxation, infoGlobal);
-					}
-				}
-				else
-				{
-					btPlaneSpace1(cp.m_normalWorldOnB, cp.m_lateralFrictionDir1, cp.m_lateralFrictionDir2);
+		if ((infoGlobal.m_solverMode & SOLVER_USE_2_FRICTION_DIRECTIONS))
+			setupFrictionConstraint(frictionConstraints[1], cp.m_lateralFrictionDir2, solverBodyIdA, solverBodyIdB, cp, rel_pos1, rel_pos2, colObj0, colObj1, relaxation, infoGlobal, cp.m_contactMotion2, cp.m_frictionCFM);
+	}
+	setFrictionConstraintImpulse(solverConstraint, solverBodyIdA, solverBodyIdB, cp, infoGlobal);
+	return numRollingFrictions;
+}
 
-					applyAnisotropicFriction(colObj0, cp.m_lateralFrictionDir1, btCollisionObject::CF_ANISOTROPIC_FRICTION);
-					applyAnisotropicFriction(colObj1, cp.m_lateralFrictionDir1, btCollisionObject::CF_ANISOTROPIC_FRICTION);
-					addFrictionConstraint(cp.m_lateralFrictionDir1, solverBodyIdA, solverBodyIdB, frictionIndex, cp, rel_pos1, rel_pos2, colObj0, colObj1, relaxation, infoGlobal);
+void btSequentialImpulseConstraintSolver::convertContact(btPersistentManifold* manifold, const btContactSolverInfo& infoGlobal)
+{
+	btContactManifoldConversion conversion;
+	if (!initContactManifoldConversion(conversion, manifold, infoGlobal))
+		return;
 
-					if ((infoGlobal.m_solverMode & SOLVER_USE_2_FRICTION_DIRECTIONS))
-					{
-						applyAnisotropicFriction(colObj0, cp.m_lateralFrictionDir2, btCollisionObject::CF_ANISOTROPIC_FRICTION);
-						applyAnisotropicFriction(colObj1, cp.m_lateralFrictionDir2, btCollisionObject::CF_ANISOTROPIC_FRICTION);
-						addFrictionConstraint(cp.m_lateralFrictionDir2, solverBodyIdA, solverBodyIdB, frictionIndex, cp, rel_pos1, rel_pos2, colObj0, colObj1, relaxation, infoGlobal);
-					}
+	int numFrictionDirections = (infoGlobal.m_solverMode & SOLVER_USE_2_FRICTION_DIRECTIONS) ? 2 : 1;
+	for (int j = 0; j < manifold->getNumContacts(); j++)
+	{
+		btManifoldPoint& cp = manifold->getContactPoint(j);
 
-					if ((infoGlobal.m_solverMode & SOLVER_USE_2_FRICTION_DIRECTIONS) && (infoGlobal.m_solverMode & SOLVER_DISABLE_VELOCITY_DEPENDENT_FRICTION_DIRECTION))
-					{
-						cp.m_contactPointFlags |= BT_CONTACT_FLAG_LATERAL_FRICTION_INITIALIZED;
-					}
-				}
+		if (cp.getDistance() <= manifold->getContactProcessingThreshold())
+		{
+			int numRollingFrictions = 0;
+			if (cp.m_combinedRollingFriction > 0.f)
+			{
+				btVector3 axes[2];
+				numRollingFrictions = 1 + getRollingFrictionAxes(cp, conversion.m_colObj0, conversion.m_colObj1, axes);
 			}
-			else
+
+			int contactIndex = m_tmpSolverContactConstraintPool.size();
+			int frictionIndex = m_tmpSolverContactFrictionConstraintPool.size();
+			int rollingFrictionIndex = m_tmpSolverContactRollingFrictionConstraintPool.size();
+			m_tmpSolverContactConstraintPool.expandNonInitializing();
+			for (int i = 0; i < numFrictionDirections; i++)
+				m_tmpSolverContactFrictionConstraintPool.expandNonInitializing();
+			for (int i = 0; i < numRollingFrictions; i++)
+				m_tmpSolverContactRollingFrictionConstraintPool.expandNonInitializing();
+
+			setupContactRows(conversion, cp, contactIndex, frictionIndex, rollingFrictionIndex, infoGlobal, true);
+		}
+	}
+}
+
+void btSequentialImpulseConstraintSolver::addContactManifoldForConversion(btPersistentManifold* manifold, const btContactSolverInfo& infoGlobal)
+{
+	btContactManifoldConversion conversion;
+	if (!initContactManifoldConversion(conversion, manifold, infoGlobal))
+		return;
+
+	// the rows are counted here while the manifold is in the cache, most manifolds of a large scene have none
+	for (int j = 0; j < manifold->getNumContacts(); j++)
+	{
+		const btManifoldPoint& cp = manifold->getContactPoint(j);
+		if (cp.getDistance() <= manifold->getContactProcessingThreshold())
+		{
+			conversion.m_numContacts++;
+			if (cp.m_combinedRollingFriction > 0.f)
 			{
-				addFrictionConstraint(cp.m_lateralFrictionDir1, solverBodyIdA, solverBodyIdB, frictionIndex, cp, rel_pos1, rel_pos2, colObj0, colObj1, relaxation, infoGlobal, cp.m_contactMotion1, cp.m_frictionCFM);
+				btVector3 axes[2];
+				conversion.m_numRollingFrictions += 1 + getRollingFrictionAxes(cp, conversion.m_colObj0, conversion.m_colObj1, axes);
+			}
+		}
+	}
+	if (conversion.m_numContacts)
+	{
+		m_contactManifoldConversions.push_back(conversion);
+	}
+}
 
-				if ((infoGlobal.m_solverMode & SOLVER_USE_2_FRICTION_DIRECTIONS))
-					addFrictionConstraint(cp.m_lateralFrictionDir2, solverBodyIdA, solverBodyIdB, frictionIndex, cp, rel_pos1, rel_pos2, colObj0, colObj1, relaxation, infoGlobal, cp.m_contactMotion2, cp.m_frictionCFM);
-				}
-			setFrictionConstraintImpulse(solverConstraint, solverBodyIdA, solverBodyIdB, cp, infoGlobal);
+void btSequentialImpulseConstraintSolver::internalSetupContactRows(int iBegin, int iEnd, const btContactSolverInfo& infoGlobal)
+{
+	int numFrictionDirections = (infoGlobal.m_solverMode & SOLVER_USE_2_FRICTION_DIRECTIONS) ? 2 : 1;
+	for (int i = iBegin; i < iEnd; i++)
+	{
+		const btContactManifoldConversion& conversion = m_contactManifoldConversions[i];
+		btPersistentManifold* manifold = conversion.m_manifold;
+		int contactIndex = conversion.m_contactIndex;
+		int frictionIndex = conversion.m_frictionIndex;
+		int rollingFrictionIndex = conversion.m_rollingFrictionIndex;
+		for (int j = 0; j < manifold->getNumContacts(); j++)
+		{
+			btManifoldPoint& cp = manifold->getContactPoint(j);
+			if (cp.getDistance() <= manifold->getContactProcessingThreshold())
+			{
+				rollingFrictionIndex += setupContactRows(conversion, cp, contactIndex, frictionIndex, rollingFrictionIndex, infoGlobal, false);
+				contactIndex++;
+				frictionIndex += numFrictionDirections;
 			}
 		}
+		btAssert(contactIndex == conversion.m_contactIndex + conversion.m_numContacts);
+		btAssert(rollingFrictionIndex == conversion.m_rollingFrictionIndex + conversion.m_numRollingFrictions);
 	}
+}
 
-void btSequentialImpulseConstraintSolver::convertContacts(btPersistentManifold** manifoldPtr, int numManifolds, const btContactSolverInfo& infoGlobal)
+struct btSetupContactRowsLoop : public btIParallelForBody
 {
-	int i;
-	btPersistentManifold* manifold = 0;
-	//			btCollisionObject* colObj0=0,*colObj1=0;
+	btSequentialImpulseConstraintSolver* m_solver;
+	const btContactSolverInfo* m_infoGlobal;
 
-	for (i = 0; i < numManifolds; i++)
+	btSetupContactRowsLoop(btSequentialImpulseConstraintSolver* solver, const btContactSolverInfo& infoGlobal)
+	{
+		m_solver = solver;
+		m_infoGlobal = &infoGlobal;
+	}
+	void forLoop(int iBegin, int iEnd) const BT_OVERRIDE
 	{
-		manifold = manifoldPtr[i];
+		m_solver->internalSetupContactRows(iBegin, iEnd, *m_infoGlobal);
+	}
+};
+
+void btSequentialImpulseConstraintSolver::convertAddedContactManifolds(const btContactSolverInfo& infoGlobal)
+{
+	BT_PROFILE("convertAddedContactManifolds");
+	int numManifolds = m_contactManifoldConversions.size();
+
+	// the rows of each manifold follow the rows of the manifolds added before, as with convertContact
+	int numFrictionDirections = (infoGlobal.m_solverMode & SOLVER_USE_2_FRICTION_DIRECTIONS) ? 2 : 1;
+	int firstContactIndex = m_tmpSolverContactConstraintPool.size();
+	int numContacts = firstContactIndex;
+	int numFrictions = m_tmpSolverContactFrictionConstraintPool.size();
+	int numRollingFrictions = m_tmpSolverContactRollingFrictionConstraintPool.size();
+	for (int i = 0; i < numManifolds; i++)
+	{
+		btContactManifoldConversion& conversion = m_contactManifoldConversions[i];
+		conversion.m_contactIndex = numContacts;
+		conversion.m_frictionIndex = numFrictions;
+		conversion.m_rollingFrictionIndex = numRollingFrictions;
+		numContacts += conversion.m_numContacts;
+		numFrictions += conversion.m_numContacts * numFrictionDirections;
+		numRollingFrictions += conversion.m_numRollingFrictions;
+	}
+	resizeConstraintPool(m_tmpSolverContactConstraintPool, numContacts);
+	resizeConstraintPool(m_tmpSolverContactFrictionConstraintPool, numFrictions);
+	resizeConstraintPool(m_tmpSolverContactRollingFrictionConstraintPool, numRollingFrictions);
+
+	{
+		btSetupContactRowsLoop loop(this, infoGlobal);
+		btSolverConversionParallelFor(0, numManifolds, kContactRowSetupGrainSize, loop);
+	}
+
+	// the warm starting impulses change the velocities of solver bodies shared between the tasks, they are applied here in row order
+	if (infoGlobal.m_solverMode & SOLVER_USE_WARMSTARTING)
+	{
+		for (int i = firstContactIndex; i < numContacts; i++)
+		{
+			const btSolverConstraint& solverConstraint = m_tmpSolverContactConstraintPool[i];
+			btSolverBody& bodyA = m_tmpSolverBodyPool[solverConstraint.m_solverBodyIdA];
+			btSolverBody& bodyB = m_tmpSolverBodyPool[solverConstraint.m_solverBodyIdB];
+			bodyA.internalApplyImpulse(solverConstraint.m_contactNormal1 * bodyA.internalGetInvMass(), solverConstraint.m_angularComponentA, solverConstraint.m_appliedImpulse);
+			bodyB.internalApplyImpulse(-solverConstraint.m_contactNormal2 * bodyB.internalGetInvMass(), -solverConstraint.m_angularComponentB, -(btScalar)solverConstraint.m_appliedImpulse);
+		}
+	}
+	m_contactManifoldConversions.resizeNoInitialize(0);
+}
+
+bool btSequentialImpulseConstraintSolver::useBatchedContactConversion(int numManifolds) const
+{
+	if (numManifolds < s_minimumContactManifoldsForParallelConversion)
+		return false;
+	if (s_allowSingleThreadedBatchedConversion)
+		return true;
+#if BT_THREADSAFE
+	btITaskScheduler* scheduler = btGetTaskScheduler();
+	return scheduler && scheduler->getNumThreads() > 1 && !btThreadsAreRunning();
+#else
+	return false;
+#endif
+}
+
+void btSequentialImpulseConstraintSolver::convertContacts(btPersistentManifold** manifoldPtr, int numManifolds, const btContactSolverInfo& infoGlobal)
+{
+	BT_PROFILE("convertContacts");
+	bool batched = useBatchedContactConversion(numManifolds);
+	for (int i = 0; i < numManifolds; i++)
+	{
+		btPersistentManifold* manifold = manifoldPtr[i];
 		// Disabled contact computation for softbody
-		if (manifold->getBody0()->getInternalType() == 8) 
+		if (manifold->getBody0()->getInternalType() == 8)
 			continue;
-		convertContact(manifold, infoGlobal);
+		if (batched)
+			addContactManifoldForConversion(manifold, infoGlobal);
+		else
+			convertContact(manifold, infoGlobal);
+	}
+	if (batched)
+	{
+		convertAddedContactManifolds(infoGlobal);
 	}
 }
 
@@ -1309,6 +1541,37 @@ void btSequentialImpulseConstraintSolver::convertJoint(btSolverConstraint* curre
 	}
 }
 
+void btSequentialImpulseConstraintSolver::internalConvertJoints(btTypedConstraint** constraints, int iBegin, int iEnd, const btContactSolverInfo& infoGlobal)
+{
+	for (int i = iBegin; i < iEnd; i++)
+	{
+		const btJointConversion& conversion = m_jointConversions[i];
+		if (conversion.m_solverConstraint >= 0)
+		{
+			btSolverConstraint* currentConstraintRow = &m_tmpSolverNonContactConstraintPool[conversion.m_solverConstraint];
+			convertJoint(currentConstraintRow, constraints[i], m_tmpConstraintSizesPool[i], conversion.m_solverBodyIdA, conversion.m_solverBodyIdB, infoGlobal);
+		}
+	}
+}
+
+struct btConvertJointsLoop : public btIParallelForBody
+{
+	btSequentialImpulseConstraintSolver* m_solver;
+	btTypedConstraint** m_constraints;
+	const btContactSolverInfo* m_infoGlobal;
+
+	btConvertJointsLoop(btSequentialImpulseConstraintSolver* solver, btTypedConstraint** constraints, const btContactSolverInfo& infoGlobal)
+	{
+		m_solver = solver;
+		m_constraints = constraints;
+		m_infoGlobal = &infoGlobal;
+	}
+	void forLoop(int iBegin, int iEnd) const BT_OVERRIDE
+	{
+		m_solver->internalConvertJoints(m_constraints, iBegin, iEnd, *m_infoGlobal);
+	}
+};
+
 void btSequentialImpulseConstraintSolver::convertJoints(btTypedConstraint** constraints, int numConstraints, const btContactSolverInfo& infoGlobal)
 {
 	BT_PROFILE("convertJoints");
@@ -1322,6 +1585,7 @@ void btSequentialImpulseConstraintSolver::convertJoints(btTypedConstraint** cons
 	int totalNumRows = 0;
 
 	m_tmpConstraintSizesPool.resizeNoInitialize(numConstraints);
+	m_jointConversions.resizeNoInitialize(numConstraints);
 	//calculate the total number of contraint rows
 	for (int i = 0; i < numConstraints; i++)
 	{
@@ -1344,33 +1608,28 @@ void btSequentialImpulseConstraintSolver::convertJoints(btTypedConstraint** cons
 			info1.m_numConstraintRows = 0;
 			info1.nub = 0;
 		}
-		totalNumRows += info1.m_numConstraintRows;
-	}
-	m_tmpSolverNonContactConstraintPool.resizeNoInitialize(totalNumRows);
-
-	///setup the btSolverConstraints
-	int currentRow = 0;
-
-	for (int i = 0; i < numConstraints; i++)
-	{
-		const btTypedConstraint::btConstraintInfo1& info1 = m_tmpConstraintSizesPool[i];
 
+		// the solver bodies are looked up here, in order, so convertJoint only reads shared data
+		btJointConversion& conversion = m_jointConversions[i];
+		conversion.m_solverConstraint = -1;
 		if (info1.m_numConstraintRows)
 		{
-			btAssert(currentRow < totalNumRows);
-
-			btSolverConstraint* currentConstraintRow = &m_tmpSolverNonContactConstraintPool[currentRow];
 			btTypedConstraint* constraint = constraints[i];
-			btRigidBody& rbA = constraint->getRigidBodyA();
-			btRigidBody& rbB = constraint->getRigidBodyB();
+			conversion.m_solverConstraint = totalNumRows;
+			conversion.m_solverBodyIdA = getOrInitSolverBody(constraint->getRigidBodyA(), infoGlobal.m_timeStep);
+			conversion.m_solverBodyIdB = getOrInitSolverBody(constraint->getRigidBodyB(), infoGlobal.m_timeStep);
 
-			int solverBodyIdA = getOrInitSolverBody(rbA, infoGlobal.m_timeStep);
-			int solverBodyIdB = getOrInitSolverBody(rbB, infoGlobal.m_timeStep);
-
-			convertJoint(currentConstraintRow, constraint, info1, solverBodyIdA, solverBodyIdB, infoGlobal);
+			int overrideNumSolverIterations = constraint->getOverrideNumSolverIterations() > 0 ? constraint->getOverrideNumSolverIterations() : infoGlobal.m_numIterations;
+			if (overrideNumSolverIterations > m_maxOverrideNumSolverIterations)
+				m_maxOverrideNumSolverIterations = overrideNumSolverIterations;
 		}
-		currentRow += info1.m_numConstraintRows;
+		totalNumRows += info1.m_numConstraintRows;
 	}
+	m_tmpSolverNonContactConstraintPool.resizeNoInitialize(totalNumRows);
+
+	///setup the btSolverConstraints
+	btConvertJointsLoop loop(this, constraints, infoGlobal);
+	btSolverConversionParallelFor(0, numConstraints, kJointConversionGrainSize, loop);
 }
 
 void btSequentialImpulseConstraintSolver::convertBodies(btCollisionObject** bodies, int numBodies, const btContactSolverInfo& infoGlobal)
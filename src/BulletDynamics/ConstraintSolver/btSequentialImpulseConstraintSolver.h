@@ -74,6 +74,30 @@ protected:
 	// index in this solver-local table, indexed by the uniqueId of the body.
 	btAlignedObjectArray<int> m_kinematicBodyUniqueIdToSolverBodyTable;  // only used for multithreading
 
+	// a contact manifold of the batched contact conversion, see convertAddedContactManifolds
+	struct btContactManifoldConversion
+	{
+		btPersistentManifold* m_manifold;
+		btCollisionObject* m_colObj0;  // redirection targets already applied
+		btCollisionObject* m_colObj1;
+		int m_solverBodyIdA;
+		int m_solverBodyIdB;
+		int m_contactIndex;          // first row in m_tmpSolverContactConstraintPool
+		int m_frictionIndex;         // first row in m_tmpSolverContactFrictionConstraintPool
+		int m_rollingFrictionIndex;  // first row in m_tmpSolverContactRollingFrictionConstraintPool
+		int m_numContacts;
+		int m_numRollingFrictions;
+	};
+	btAlignedObjectArray<btContactManifoldConversion> m_contactManifoldConversions;
+
+	struct btJointConversion
+	{
+		int m_solverConstraint;  // first row in m_tmpSolverNonContactConstraintPool, -1 for joints without rows
+		int m_solverBodyIdA;
+		int m_solverBodyIdB;
+	};
+	btAlignedObjectArray<btJointConversion> m_jointConversions;
+
 	btSingleConstraintRowSolver m_resolveSingleConstraintRowGeneric;
 	btSingleConstraintRowSolver m_resolveSingleConstraintRowLowerLimit;
 	btSingleConstraintRowSolver m_resolveSplitPenetrationImpulse;
@@ -97,10 +121,14 @@ protected:
 	btSolverConstraint& addTorsionalFrictionConstraint(const btVector3& normalAxis, int solverBodyIdA, int solverBodyIdB, int frictionIndex, btManifoldPoint& cp, btScalar torsionalFriction, const btVector3& rel_pos1, const btVector3& rel_pos2, btCollisionObject* colObj0, btCollisionObject* colObj1, btScalar relaxation, btScalar desiredVelocity = 0, btScalar cfmSlip = 0.f);
 
 	void setupContactConstraint(btSolverConstraint & solverConstraint, int solverBodyIdA, int solverBodyIdB, btManifoldPoint& cp,
-		const btContactSolverInfo& infoGlobal, btScalar& relaxation, const btVector3& rel_pos1, const btVector3& rel_pos2);
+		const btContactSolverInfo& infoGlobal, btScalar& relaxation, const btVector3& rel_pos1, const btVector3& rel_pos2,
+		bool applyWarmstartImpulse = true);
 
 	static void applyAnisotropicFriction(btCollisionObject * colObj, btVector3 & frictionDirection, int frictionMode);
 
+	///the rolling friction axes of a contact, besides the normal; returns how many are long enough to get a row
+	static int getRollingFrictionAxes(const btManifoldPoint& cp, btCollisionObject* colObj0, btCollisionObject* colObj1, btVector3* axes);
+
 	void setFrictionConstraintImpulse(btSolverConstraint & solverConstraint, int solverBodyIdA, int solverBodyIdB,
 		btManifoldPoint& cp, const btContactSolverInfo& infoGlobal);
 
@@ -113,6 +141,18 @@ protected:
 
 	void convertContact(btPersistentManifold * manifold, const btContactSolverInfo& infoGlobal);
 
+	///looks up the solver bodies of a manifold, returns false when both are static and the manifold gets no rows
+	bool initContactManifoldConversion(btContactManifoldConversion & conversion, btPersistentManifold * manifold, const btContactSolverInfo& infoGlobal);
+	///sets up the contact, friction and rolling friction rows of a contact point at the given rows, returns the number of rolling friction rows
+	int setupContactRows(const btContactManifoldConversion& conversion, btManifoldPoint& cp, int contactIndex, int frictionIndex, int rollingFrictionIndex,
+		const btContactSolverInfo& infoGlobal, bool applyWarmstartImpulse);
+
+	///batched contact conversion: the manifolds are added in order and their rows counted, convertAddedContactManifolds then sets them up
+	///in btParallelFor tasks. The rows come out in the same order and with the same values as with convertContact.
+	void addContactManifoldForConversion(btPersistentManifold * manifold, const btContactSolverInfo& infoGlobal);
+	void convertAddedContactManifolds(const btContactSolverInfo& infoGlobal);
+	bool useBatchedContactConversion(int numManifolds) const;
+
 	virtual void convertJoints(btTypedConstraint * *constraints, int numConstraints, const btContactSolverInfo& infoGlobal);
 	void convertJoint(btSolverConstraint * currentConstraintRow, btTypedConstraint * constraint, const btTypedConstraint::btConstraintInfo1& info1, int solverBodyIdA, int solverBodyIdB, const btContactSolverInfo& infoGlobal);
 
@@ -155,6 +195,9 @@ protected:
 public:
 	BT_DECLARE_ALIGNED_ALLOCATOR();
 
+	static int s_minimumContactManifoldsForParallelConversion;  // fewer manifolds are converted one by one with convertContact
+	static bool s_allowSingleThreadedBatchedConversion;          // batch the conversion without worker threads too, it then only costs a little more
+
 	btSequentialImpulseConstraintSolver();
 	virtual ~btSequentialImpulseConstraintSolver();
 
@@ -210,6 +253,10 @@ public:
 	btSingleConstraintRowSolver getSSE2ConstraintRowSolverLowerLimit();
 	btSingleConstraintRowSolver getSSE4_1ConstraintRowSolverLowerLimit();
 	btSolverAnalyticsData m_analyticsData;
+
+	// bodies of the btParallelFor loops of the contact and joint conversion
+	void internalSetupContactRows(int iBegin, int iEnd, const btContactSolverInfo& infoGlobal);
+	void internalConvertJoints(btTypedConstraint * *constraints, int iBegin, int iEnd, const btContactSolverInfo& infoGlobal);
 };
 
 #endif  //BT_SEQUENTIAL_IMPULSE_CONSTRAINT_SOLVER_H
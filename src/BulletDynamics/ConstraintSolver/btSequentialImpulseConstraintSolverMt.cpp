@@ -725,6 +725,11 @@ void btSequentialImpulseConstraintSolverMt::convertJoints(btTypedConstraint** co
 			params.m_solverConstraint = totalNumRows;
 			params.m_solverBodyA = getOrInitSolverBody(constraint->getRigidBodyA(), infoGlobal.m_timeStep);
 			params.m_solverBodyB = getOrInitSolverBody(constraint->getRigidBodyB(), infoGlobal.m_timeStep);
+
+			// updated here so that convertJoint doesn't write it from the tasks
+			int overrideNumSolverIterations = constraint->getOverrideNumSolverIterations() > 0 ? constraint->getOverrideNumSolverIterations() : infoGlobal.m_numIterations;
+			if (overrideNumSolverIterations > m_maxOverrideNumSolverIterations)
+				m_maxOverrideNumSolverIterations = overrideNumSolverIterations;
 		}
 		else
 		{
@@ -131,6 +131,10 @@ public:
 	btSequentialImpulseConstraintSolverMt();
 	virtual ~btSequentialImpulseConstraintSolverMt();
 
+	// batches of the last solve, see btBatchedConstraints::m_stats for their quality and setup time
+	const btBatchedConstraints& getBatchedContactConstraints() const { return m_batchedContactConstraints; }
+	const btBatchedConstraints& getBatchedJointConstraints() const { return m_batchedJointConstraints; }
+
 	btScalar resolveMultipleJointConstraints(const btAlignedObjectArray<int>& consIndices, int batchBegin, int batchEnd, int iteration);
 	btScalar resolveMultipleContactConstraints(const btAlignedObjectArray<int>& consIndices, int batchBegin, int batchEnd);
 	btScalar resolveMultipleContactSplitPenetrationImpulseConstraints(const btAlignedObjectArray<int>& consIndices, int batchBegin, int batchEnd);
@@ -784,6 +784,16 @@ void btDiscreteDynamicsWorld::calculateSimulationIslands()
 	getSimulationIslandManager()->storeIslandActivationState(getCollisionWorld());
 }
 
+void btDiscreteDynamicsWorld::setPersistentSimulationIslands(bool persistentIslands)
+{
+	m_islandManager->setPersistentIslands(persistentIslands);
+}
+
+bool btDiscreteDynamicsWorld::getPersistentSimulationIslands() const
+{
+	return m_islandManager->getPersistentIslands();
+}
+
 class btClosestNotMeConvexResultCallback : public btCollisionWorld::ClosestConvexResultCallback
 {
 public:
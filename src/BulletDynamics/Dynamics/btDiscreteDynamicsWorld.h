@@ -234,6 +234,12 @@ public:
 	{
 		return m_latencyMotionStateInterpolation;
 	}
+
+	///Keep the simulation islands from one step to the next and update them incrementally, instead of
+	///rebuilding them from scratch every step. Worth it for big worlds where the islands rarely change,
+	///see btSimulationIslandManager::setPersistentIslands
+	void setPersistentSimulationIslands(bool persistentIslands);
+	bool getPersistentSimulationIslands() const;
     
     btAlignedObjectArray<btRigidBody*>& getNonStaticRigidBodies()
     {
@@ -164,6 +164,7 @@ btDiscreteDynamicsWorldMt::btDiscreteDynamicsWorldMt(btDispatcher* dispatcher,
 		m_islandManager = im;
 	}
 	m_constraintSolverMt = constraintSolverMt;
+	m_keepWorkerThreadsAwake = false;
 }
 
 btDiscreteDynamicsWorldMt::~btDiscreteDynamicsWorldMt()
@@ -189,6 +190,81 @@ void btDiscreteDynamicsWorldMt::solveConstraints(btContactSolverInfo& solverInfo
 	m_constraintSolver->allSolved(solverInfo, m_debugDrawer);
 }
 
+struct UpdaterUniteManifoldIslands : public btIParallelForBody
+{
+	btPersistentManifold* const* manifolds;
+	btUnionFind* unionFind;
+
+	void forLoop(int iBegin, int iEnd) const BT_OVERRIDE
+	{
+		for (int i = iBegin; i < iEnd; ++i)
+		{
+			const btPersistentManifold* manifold = manifolds[i];
+			const btCollisionObject* colObj0 = manifold->getBody0();
+			const btCollisionObject* colObj1 = manifold->getBody1();
+
+			if (((colObj0) && (!(colObj0)->isStaticOrKinematicObject())) &&
+				((colObj1) && (!(colObj1)->isStaticOrKinematicObject())))
+			{
+				unionFind->uniteConcurrent((colObj0)->getIslandTag(), (colObj1)->getIslandTag());
+			}
+		}
+	}
+};
+
+struct UpdaterUniteConstraintIslands : public btIParallelForBody
+{
+	btTypedConstraint* const* constraints;
+	btUnionFind* unionFind;
+
+	void forLoop(int iBegin, int iEnd) const BT_OVERRIDE
+	{
+		for (int i = iBegin; i < iEnd; ++i)
+		{
+			const btTypedConstraint* constraint = constraints[i];
+			if (constraint->isEnabled())
+			{
+				const btRigidBody* colObj0 = &constraint->getRigidBodyA();
+				const btRigidBody* colObj1 = &constraint->getRigidBodyB();
+
+				if (((colObj0) && (!(colObj0)->isStaticOrKinematicObject())) &&
+					((colObj1) && (!(colObj1)->isStaticOrKinematicObject())))
+				{
+					unionFind->uniteConcurrent((colObj0)->getIslandTag(), (colObj1)->getIslandTag());
+				}
+			}
+		}
+	}
+};
+
+void btDiscreteDynamicsWorldMt::calculateSimulationIslands()
+{
+	BT_PROFILE("calculateSimulationIslands");
+
+	getSimulationIslandManager()->updateActivationState(getCollisionWorld(), getCollisionWorld()->getDispatcher());
+
+	btUnionFind* unionFind = &getSimulationIslandManager()->getUnionFind();
+	int grainSize = 256;  // num of iterations per task for task scheduler
+	if (m_predictiveManifolds.size() > 0)
+	{
+		//merge islands based on speculative contact manifolds too
+		UpdaterUniteManifoldIslands update;
+		update.manifolds = &m_predictiveManifolds[0];
+		update.unionFind = unionFind;
+		btParallelFor(0, m_predictiveManifolds.size(), grainSize, update);
+	}
+	if (m_constraints.size() > 0)
+	{
+		UpdaterUniteConstraintIslands update;
+		update.constraints = &m_constraints[0];
+		update.unionFind = unionFind;
+		btParallelFor(0, m_constraints.size(), grainSize, update);
+	}
+
+	//Store the island id in each body
+	getSimulationIslandManager()->storeIslandActivationState(getCollisionWorld());
+}
+
 struct UpdaterUnconstrainedMotion : public btIParallelForBody
 {
 	btScalar timeStep;
@@ -253,8 +329,14 @@ void btDiscreteDynamicsWorldMt::integrateTransforms(btScalar timeStep)
 
 int btDiscreteDynamicsWorldMt::stepSimulation(btScalar timeStep, int maxSubSteps, btScalar fixedTimeStep)
 {
+	btITaskScheduler* scheduler = btGetTaskScheduler();
+	if (scheduler && m_keepWorkerThreadsAwake)
+	{
+		// get the threads spinning while the serial part of the step runs
+		scheduler->wakeWorkerThreadsHint();
+	}
 	int numSubSteps = btDiscreteDynamicsWorld::stepSimulation(timeStep, maxSubSteps, fixedTimeStep);
-	if (btITaskScheduler* scheduler = btGetTaskScheduler())
+	if (scheduler && !m_keepWorkerThreadsAwake)
 	{
 		// tell Bullet's threads to sleep, so other threads can run
 		scheduler->sleepWorkerThreadsHint();
@@ -84,9 +84,12 @@ btDiscreteDynamicsWorldMt : public btDiscreteDynamicsWorld
 {
 protected:
 	btConstraintSolver* m_constraintSolverMt;
+	bool m_keepWorkerThreadsAwake;
 
 	virtual void solveConstraints(btContactSolverInfo & solverInfo) BT_OVERRIDE;
 
+	virtual void calculateSimulationIslands() BT_OVERRIDE;
+
 	virtual void predictUnconstraintMotion(btScalar timeStep) BT_OVERRIDE;
 
 	struct UpdaterCreatePredictiveContacts : public btIParallelForBody
@@ -126,6 +129,12 @@ public:
 	virtual ~btDiscreteDynamicsWorldMt();
 
 	virtual int stepSimulation(btScalar timeStep, int maxSubSteps, btScalar fixedTimeStep) BT_OVERRIDE;
+
+	///when enabled, worker threads are woken at the start of each step and are not told to sleep at the end of it,
+	///they keep spinning for the task scheduler's spin time instead (see btITaskScheduler::setWorkerSpinTime).
+	///Useful for high step rates where waking sleeping threads would dominate the step time.
+	void setKeepWorkerThreadsAwake(bool keepAwake) { m_keepWorkerThreadsAwake = keepAwake; }
+	bool getKeepWorkerThreadsAwake() const { return m_keepWorkerThreadsAwake; }
 };
 
 #endif  //BT_DISCRETE_DYNAMICS_WORLD_H
@@ -24,6 +24,7 @@ subject to the following restrictions:
 #include "BulletDynamics/ConstraintSolver/btSequentialImpulseConstraintSolverMt.h"  // for s_minimumContactManifoldsForBatching
 
 //#include <stdio.h>
+#include <string.h>  // for memcpy
 #include "LinearMath/btQuickprof.h"
 
 SIMD_FORCE_INLINE int calcBatchCost(int bodies, int manifolds, int constraints)
@@ -261,94 +262,394 @@ btSimulationIslandManagerMt::Island* btSimulationIslandManagerMt::allocateIsland
 	return island;
 }
 
-void btSimulationIslandManagerMt::buildIslands(btDispatcher* dispatcher, btCollisionWorld* collisionWorld)
-{
-	BT_PROFILE("buildIslands");
+static const int kIslandGrainSize = 256;   // iterations per task for the island building loops
+static const int kRadixBits = 8;
+static const int kRadixSize = 1 << kRadixBits;
+static const int kRadixBlockSize = 2048;  // elements per task for the radix sort
 
-	btCollisionObjectArray& collisionObjects = collisionWorld->getCollisionObjectArray();
+struct RadixHistogramLoop : public btIParallelForBody
+{
+	const btElement* m_items;
+	int m_numItems;
+	int m_shift;
+	int* m_counts;  // kRadixSize counts per block
 
-	//we are going to sort the unionfind array, and store the element id in the size
-	//afterwards, we clean unionfind, to make sure no-one uses it anymore
+	void forLoop(int iBegin, int iEnd) const BT_OVERRIDE
+	{
+		for (int iBlock = iBegin; iBlock < iEnd; ++iBlock)
+		{
+			int* counts = &m_counts[iBlock * kRadixSize];
+			for (int iDigit = 0; iDigit < kRadixSize; ++iDigit)
+			{
+				counts[iDigit] = 0;
+			}
+			int iItemEnd = btMin(m_numItems, (iBlock + 1) * kRadixBlockSize);
+			for (int i = iBlock * kRadixBlockSize; i < iItemEnd; ++i)
+			{
+				counts[(m_items[i].m_id >> m_shift) & (kRadixSize - 1)]++;
+			}
+		}
+	}
+};
 
-	getUnionFind().sortIslands();
-	int numElem = getUnionFind().getNumElements();
+struct RadixScatterLoop : public btIParallelForBody
+{
+	const btElement* m_src;
+	btElement* m_dest;
+	int m_numItems;
+	int m_shift;
+	const int* m_offsets;  // kRadixSize offsets per block
 
-	int endIslandIndex = 1;
-	int startIslandIndex;
+	void forLoop(int iBegin, int iEnd) const BT_OVERRIDE
+	{
+		int offsets[kRadixSize];
+		for (int iBlock = iBegin; iBlock < iEnd; ++iBlock)
+		{
+			for (int iDigit = 0; iDigit < kRadixSize; ++iDigit)
+			{
+				offsets[iDigit] = m_offsets[iBlock * kRadixSize + iDigit];
+			}
+			int iItemEnd = btMin(m_numItems, (iBlock + 1) * kRadixBlockSize);
+			for (int i = iBlock * kRadixBlockSize; i < iItemEnd; ++i)
+			{
+				const btElement& item = m_src[i];
+				m_dest[offsets[(item.m_id >> m_shift) & (kRadixSize - 1)]++] = item;
+			}
+		}
+	}
+};
 
-	//update the sleeping state for bodies, if all are sleeping
-	for (startIslandIndex = 0; startIslandIndex < numElem; startIslandIndex = endIslandIndex)
+// stable sort of elements by m_id, which must be in [0, maxId]
+static void radixSortElements(btElement* items, int numItems, int maxId, btAlignedObjectArray<btElement>* sortBuffer, btAlignedObjectArray<int>* radixCounts)
+{
+	if (numItems < 2)
+	{
+		return;
+	}
+	int numBlocks = (numItems + kRadixBlockSize - 1) / kRadixBlockSize;
+	sortBuffer->resizeNoInitialize(numItems);
+	radixCounts->resizeNoInitialize(numBlocks * kRadixSize);
+	int* counts = &(*radixCounts)[0];
+	btElement* src = items;
+	btElement* dest = &(*sortBuffer)[0];
+	int shift = 0;
+	do
 	{
-		int islandId = getUnionFind().getElement(startIslandIndex).m_id;
-		for (endIslandIndex = startIslandIndex + 1; (endIslandIndex < numElem) && (getUnionFind().getElement(endIslandIndex).m_id == islandId); endIslandIndex++)
+		RadixHistogramLoop histogramLoop;
+		histogramLoop.m_items = src;
+		histogramLoop.m_numItems = numItems;
+		histogramLoop.m_shift = shift;
+		histogramLoop.m_counts = counts;
+		btParallelFor(0, numBlocks, 1, histogramLoop);
+
+		// turn the counts into offsets, digit major so that each block keeps its items in order
+		int sum = 0;
+		for (int iDigit = 0; iDigit < kRadixSize; ++iDigit)
 		{
+			for (int iBlock = 0; iBlock < numBlocks; ++iBlock)
+			{
+				int count = counts[iBlock * kRadixSize + iDigit];
+				counts[iBlock * kRadixSize + iDigit] = sum;
+				sum += count;
+			}
 		}
 
-		//int numSleeping = 0;
+		RadixScatterLoop scatterLoop;
+		scatterLoop.m_src = src;
+		scatterLoop.m_dest = dest;
+		scatterLoop.m_numItems = numItems;
+		scatterLoop.m_shift = shift;
+		scatterLoop.m_offsets = counts;
+		btParallelFor(0, numBlocks, 1, scatterLoop);
 
-		bool allSleeping = true;
+		btSwap(src, dest);
+		shift += kRadixBits;
+	} while (shift < 32 && (maxId >> shift) > 0);
 
-		int idx;
-		for (idx = startIslandIndex; idx < endIslandIndex; idx++)
-		{
-			int i = getUnionFind().getElement(idx).m_sz;
+	if (src != items)
+	{
+		memcpy(items, src, sizeof(btElement) * numItems);
+	}
+}
 
-			btCollisionObject* colObj0 = collisionObjects[i];
-			if ((colObj0->getIslandTag() != islandId) && (colObj0->getIslandTag() != -1))
+// for elements sorted by m_id, starts[id] is the index of the first element with that id,
+// and elements [starts[id], starts[id + 1]) have that id. starts must hold numIds + 1 entries.
+struct KeyStartsLoop : public btIParallelForBody
+{
+	const btElement* m_sortedItems;
+	int m_numItems;
+	int m_numIds;
+	int* m_starts;
+
+	void forLoop(int iBegin, int iEnd) const BT_OVERRIDE
+	{
+		for (int i = iBegin; i < iEnd; ++i)
+		{
+			int prevId = i > 0 ? m_sortedItems[i - 1].m_id : -1;
+			for (int id = prevId + 1; id <= m_sortedItems[i].m_id; ++id)
 			{
-				//				printf("error in island management\n");
+				m_starts[id] = i;
 			}
-
-			btAssert((colObj0->getIslandTag() == islandId) || (colObj0->getIslandTag() == -1));
-			if (colObj0->getIslandTag() == islandId)
+			if (i == m_numItems - 1)
 			{
-				if (colObj0->getActivationState() == ACTIVE_TAG ||
-					colObj0->getActivationState() == DISABLE_DEACTIVATION)
+				for (int id = m_sortedItems[i].m_id + 1; id <= m_numIds; ++id)
 				{
-					allSleeping = false;
-					break;
+					m_starts[id] = m_numItems;
 				}
 			}
 		}
+	}
+};
+
+static void calcKeyStarts(const btElement* sortedItems, int numItems, int numIds, btAlignedObjectArray<int>* starts)
+{
+	starts->resizeNoInitialize(numIds + 1);
+	if (numItems == 0)
+	{
+		for (int id = 0; id <= numIds; ++id)
+		{
+			(*starts)[id] = 0;
+		}
+		return;
+	}
+	KeyStartsLoop loop;
+	loop.m_sortedItems = sortedItems;
+	loop.m_numItems = numItems;
+	loop.m_numIds = numIds;
+	loop.m_starts = &(*starts)[0];
+	btParallelFor(0, numItems, kIslandGrainSize, loop);
+}
 
-		if (allSleeping)
+struct IslandTagCountLoop : public btIParallelForBody
+{
+	btCollisionObject* const* m_objects;
+	int m_numObjects;
+	int* m_blockCounts;
+
+	void forLoop(int iBegin, int iEnd) const BT_OVERRIDE
+	{
+		for (int iBlock = iBegin; iBlock < iEnd; ++iBlock)
 		{
-			int idx;
-			for (idx = startIslandIndex; idx < endIslandIndex; idx++)
+			int count = 0;
+			int iObjEnd = btMin(m_numObjects, (iBlock + 1) * kRadixBlockSize);
+			for (int i = iBlock * kRadixBlockSize; i < iObjEnd; ++i)
 			{
-				int i = getUnionFind().getElement(idx).m_sz;
-				btCollisionObject* colObj0 = collisionObjects[i];
-				if ((colObj0->getIslandTag() != islandId) && (colObj0->getIslandTag() != -1))
+				if (!m_objects[i]->isStaticOrKinematicObject())
 				{
-					//					printf("error in island management\n");
+					count++;
 				}
+			}
+			m_blockCounts[iBlock] = count;
+		}
+	}
+};
 
-				btAssert((colObj0->getIslandTag() == islandId) || (colObj0->getIslandTag() == -1));
+struct IslandTagAssignLoop : public btIParallelForBody
+{
+	btCollisionObject* const* m_objects;
+	int m_numObjects;
+	const int* m_blockStarts;
 
-				if (colObj0->getIslandTag() == islandId)
+	void forLoop(int iBegin, int iEnd) const BT_OVERRIDE
+	{
+		for (int iBlock = iBegin; iBlock < iEnd; ++iBlock)
+		{
+			int index = m_blockStarts[iBlock];
+			int iObjEnd = btMin(m_numObjects, (iBlock + 1) * kRadixBlockSize);
+			for (int i = iBlock * kRadixBlockSize; i < iObjEnd; ++i)
+			{
+				btCollisionObject* collisionObject = m_objects[i];
+				if (!collisionObject->isStaticOrKinematicObject())
 				{
-					colObj0->setActivationState(ISLAND_SLEEPING);
+					collisionObject->setIslandTag(index++);
 				}
+				collisionObject->setCompanionId(-1);
+				collisionObject->setHitFraction(btScalar(1.));
 			}
 		}
-		else
+	}
+};
+
+struct UniteOverlappingPairsLoop : public btIParallelForBody
+{
+	const btBroadphasePair* m_pairs;
+	btUnionFind* m_unionFind;
+
+	void forLoop(int iBegin, int iEnd) const BT_OVERRIDE
+	{
+		for (int i = iBegin; i < iEnd; ++i)
 		{
-			int idx;
-			for (idx = startIslandIndex; idx < endIslandIndex; idx++)
+			const btBroadphasePair& collisionPair = m_pairs[i];
+			btCollisionObject* colObj0 = (btCollisionObject*)collisionPair.m_pProxy0->m_clientObject;
+			btCollisionObject* colObj1 = (btCollisionObject*)collisionPair.m_pProxy1->m_clientObject;
+
+			if (((colObj0) && ((colObj0)->mergesSimulationIslands())) &&
+				((colObj1) && ((colObj1)->mergesSimulationIslands())))
 			{
-				int i = getUnionFind().getElement(idx).m_sz;
+				m_unionFind->uniteConcurrent((colObj0)->getIslandTag(),
+											 (colObj1)->getIslandTag());
+			}
+		}
+	}
+};
 
-				btCollisionObject* colObj0 = collisionObjects[i];
-				if ((colObj0->getIslandTag() != islandId) && (colObj0->getIslandTag() != -1))
-				{
-					//					printf("error in island management\n");
-				}
+void btSimulationIslandManagerMt::updateActivationState(btCollisionWorld* colWorld, btDispatcher* dispatcher)
+{
+#ifdef STATIC_SIMULATION_ISLAND_OPTIMIZATION
+	if (getPersistentIslands())
+	{
+		btSimulationIslandManager::updateActivationState(colWorld, dispatcher);
+		return;
+	}
+	BT_PROFILE("updateActivationState");
+	btCollisionObjectArray& collisionObjects = colWorld->getCollisionObjectArray();
+	int numObjects = collisionObjects.size();
+	int numBlocks = (numObjects + kRadixBlockSize - 1) / kRadixBlockSize;
+	int index = 0;
+	if (numObjects > 0)
+	{
+		// put the index into m_controllers into m_tag, counting the non-static objects per block first
+		m_radixCounts.resizeNoInitialize(numBlocks);
+		IslandTagCountLoop countLoop;
+		countLoop.m_objects = &collisionObjects[0];
+		countLoop.m_numObjects = numObjects;
+		countLoop.m_blockCounts = &m_radixCounts[0];
+		btParallelFor(0, numBlocks, 1, countLoop);
+		for (int iBlock = 0; iBlock < numBlocks; ++iBlock)
+		{
+			int count = m_radixCounts[iBlock];
+			m_radixCounts[iBlock] = index;
+			index += count;
+		}
+		IslandTagAssignLoop assignLoop;
+		assignLoop.m_objects = &collisionObjects[0];
+		assignLoop.m_numObjects = numObjects;
+		assignLoop.m_blockStarts = &m_radixCounts[0];
+		btParallelFor(0, numBlocks, 1, assignLoop);
+	}
+	// do the union find
+	initUnionFind(index);
+
+	btOverlappingPairCache* pairCachePtr = colWorld->getPairCache();
+	int numOverlappingPairs = pairCachePtr->getNumOverlappingPairs();
+	if (numOverlappingPairs)
+	{
+		UniteOverlappingPairsLoop uniteLoop;
+		uniteLoop.m_pairs = pairCachePtr->getOverlappingPairArrayPtr();
+		uniteLoop.m_unionFind = &getUnionFind();
+		btParallelFor(0, numOverlappingPairs, kIslandGrainSize, uniteLoop);
+	}
+#else
+	btSimulationIslandManager::updateActivationState(colWorld, dispatcher);
+#endif  //STATIC_SIMULATION_ISLAND_OPTIMIZATION
+}
+
+struct StoreIslandTagLoop : public btIParallelForBody
+{
+	btCollisionObject* const* m_objects;
+	btUnionFind* m_unionFind;
+
+	void forLoop(int iBegin, int iEnd) const BT_OVERRIDE
+	{
+		for (int i = iBegin; i < iEnd; ++i)
+		{
+			btCollisionObject* collisionObject = m_objects[i];
+			if (!collisionObject->isStaticOrKinematicObject())
+			{
+				// the tag still holds the union find index from updateActivationState
+				int index = collisionObject->getIslandTag();
+				collisionObject->setIslandTag(m_unionFind->findConcurrent(index));
+				//Set the correct object offset in Collision Object Array
+				m_unionFind->getElement(index).m_sz = i;
+				collisionObject->setCompanionId(-1);
+			}
+			else
+			{
+				collisionObject->setIslandTag(-1);
+				collisionObject->setCompanionId(-2);
+			}
+		}
+	}
+};
+
+void btSimulationIslandManagerMt::storeIslandActivationState(btCollisionWorld* colWorld)
+{
+#ifdef STATIC_SIMULATION_ISLAND_OPTIMIZATION
+	if (getPersistentIslands())
+	{
+		btSimulationIslandManager::storeIslandActivationState(colWorld);
+		return;
+	}
+	BT_PROFILE("storeIslandActivationState");
+	btCollisionObjectArray& collisionObjects = colWorld->getCollisionObjectArray();
+	if (collisionObjects.size() > 0)
+	{
+		StoreIslandTagLoop loop;
+		loop.m_objects = &collisionObjects[0];
+		loop.m_unionFind = &getUnionFind();
+		btParallelFor(0, collisionObjects.size(), kIslandGrainSize, loop);
+	}
+#else
+	btSimulationIslandManager::storeIslandActivationState(colWorld);
+#endif  //STATIC_SIMULATION_ISLAND_OPTIMIZATION
+}
+
+struct FindIslandIdLoop : public btIParallelForBody
+{
+	btUnionFind* m_unionFind;
+
+	void forLoop(int iBegin, int iEnd) const BT_OVERRIDE
+	{
+		for (int i = iBegin; i < iEnd; ++i)
+		{
+			int islandId = m_unionFind->findConcurrent(i);
+			m_unionFind->getElement(i).m_id = islandId;
+#ifndef STATIC_SIMULATION_ISLAND_OPTIMIZATION
+			m_unionFind->getElement(i).m_sz = i;
+#endif  //STATIC_SIMULATION_ISLAND_OPTIMIZATION
+		}
+	}
+};
 
+struct UpdateIslandSleepingLoop : public btIParallelForBody
+{
+	const btElement* m_elements;
+	const int* m_islandStartFromId;
+	btCollisionObject* const* m_objects;
+
+	void forLoop(int iBegin, int iEnd) const BT_OVERRIDE
+	{
+		for (int islandId = iBegin; islandId < iEnd; ++islandId)
+		{
+			int startIslandIndex = m_islandStartFromId[islandId];
+			int endIslandIndex = m_islandStartFromId[islandId + 1];
+
+			bool allSleeping = true;
+			for (int idx = startIslandIndex; idx < endIslandIndex; idx++)
+			{
+				btCollisionObject* colObj0 = m_objects[m_elements[idx].m_sz];
 				btAssert((colObj0->getIslandTag() == islandId) || (colObj0->getIslandTag() == -1));
+				if (colObj0->getIslandTag() == islandId)
+				{
+					if (colObj0->getActivationState() == ACTIVE_TAG ||
+						colObj0->getActivationState() == DISABLE_DEACTIVATION)
+					{
+						allSleeping = false;
+						break;
+					}
+				}
+			}
 
+			for (int idx = startIslandIndex; idx < endIslandIndex; idx++)
+			{
+				btCollisionObject* colObj0 = m_objects[m_elements[idx].m_sz];
 				if (colObj0->getIslandTag() == islandId)
 				{
-					if (colObj0->getActivationState() == ISLAND_SLEEPING)
+					if (allSleeping)
+					{
+						colObj0->setActivationState(ISLAND_SLEEPING);
+					}
+					else if (colObj0->getActivationState() == ISLAND_SLEEPING)
 					{
 						colObj0->setActivationState(WANTS_DEACTIVATION);
 						colObj0->setDeactivationTime(0.f);
@@ -357,111 +658,356 @@ void btSimulationIslandManagerMt::buildIslands(btDispatcher* dispatcher, btColli
 			}
 		}
 	}
-}
+};
 
-void btSimulationIslandManagerMt::addBodiesToIslands(btCollisionWorld* collisionWorld)
+void btSimulationIslandManagerMt::buildIslands(btDispatcher* dispatcher, btCollisionWorld* collisionWorld)
 {
+	BT_PROFILE("buildIslands");
+
 	btCollisionObjectArray& collisionObjects = collisionWorld->getCollisionObjectArray();
-	int endIslandIndex = 1;
-	int startIslandIndex;
-	int numElem = getUnionFind().getNumElements();
+	btUnionFind& unionFind = getUnionFind();
+	if (getPersistentIslands())
+	{
+		// the persistent islands are already grouped, with island ids below the number of bodies
+		sortPersistentIslands();
+	}
+	int numElem = unionFind.getNumElements();
+	if (numElem == 0)
+	{
+		m_islandStartFromId.resizeNoInitialize(1);
+		m_islandStartFromId[0] = 0;
+		return;
+	}
 
-	// create explicit islands and add bodies to each
-	for (startIslandIndex = 0; startIslandIndex < numElem; startIslandIndex = endIslandIndex)
+	if (!getPersistentIslands())
 	{
-		int islandId = getUnionFind().getElement(startIslandIndex).m_id;
+		//we are going to sort the unionfind array, and store the element id in the size
+		//afterwards, we clean unionfind, to make sure no-one uses it anymore
+		FindIslandIdLoop loop;
+		loop.m_unionFind = &unionFind;
+		btParallelFor(0, numElem, kIslandGrainSize, loop);
+		// island ids are union find indices, a stable sort keeps the bodies of each island in collision object order
+		radixSortElements(&unionFind.getElement(0), numElem, numElem - 1, &m_sortBuffer, &m_radixCounts);
+	}
+	calcKeyStarts(&unionFind.getElement(0), numElem, numElem, &m_islandStartFromId);
 
-		// find end index
-		for (endIslandIndex = startIslandIndex; (endIslandIndex < numElem) && (getUnionFind().getElement(endIslandIndex).m_id == islandId); endIslandIndex++)
+	//update the sleeping state for bodies, if all are sleeping
+	UpdateIslandSleepingLoop loop;
+	loop.m_elements = &unionFind.getElement(0);
+	loop.m_islandStartFromId = &m_islandStartFromId[0];
+	loop.m_objects = &collisionObjects[0];
+	btParallelFor(0, numElem, kIslandGrainSize, loop);
+}
+
+struct FindAwakeIslandsLoop : public btIParallelForBody
+{
+	const btElement* m_elements;
+	const int* m_islandStartFromId;
+	btCollisionObject* const* m_objects;
+	int* m_islandBodyOffsetFromId;
+
+	void forLoop(int iBegin, int iEnd) const BT_OVERRIDE
+	{
+		for (int islandId = iBegin; islandId < iEnd; ++islandId)
 		{
+			// check if island is sleeping
+			bool islandSleeping = true;
+			for (int iElem = m_islandStartFromId[islandId]; iElem < m_islandStartFromId[islandId + 1]; iElem++)
+			{
+				if (m_objects[m_elements[iElem].m_sz]->isActive())
+				{
+					islandSleeping = false;
+					break;
+				}
+			}
+			m_islandBodyOffsetFromId[islandId] = islandSleeping ? -1 : 0;
 		}
-		// check if island is sleeping
-		bool islandSleeping = true;
-		for (int iElem = startIslandIndex; iElem < endIslandIndex; iElem++)
+	}
+};
+
+struct AddBodiesToIslandsLoop : public btIParallelForBody
+{
+	const btElement* m_elements;
+	const int* m_islandStartFromId;
+	const int* m_islandBodyOffsetFromId;
+	btCollisionObject* const* m_objects;
+	btSimulationIslandManagerMt::Island* const* m_lookupIslandFromId;
+
+	void forLoop(int iBegin, int iEnd) const BT_OVERRIDE
+	{
+		for (int islandId = iBegin; islandId < iEnd; ++islandId)
 		{
-			int i = getUnionFind().getElement(iElem).m_sz;
-			btCollisionObject* colObj = collisionObjects[i];
-			if (colObj->isActive())
+			int offset = m_islandBodyOffsetFromId[islandId];
+			if (offset >= 0)
 			{
-				islandSleeping = false;
+				btCollisionObject** bodies = &m_lookupIslandFromId[islandId]->bodyArray[offset];
+				for (int iElem = m_islandStartFromId[islandId]; iElem < m_islandStartFromId[islandId + 1]; iElem++)
+				{
+					*bodies++ = m_objects[m_elements[iElem].m_sz];
+				}
 			}
 		}
-		if (!islandSleeping)
+	}
+};
+
+void btSimulationIslandManagerMt::addBodiesToIslands(btCollisionWorld* collisionWorld)
+{
+	btCollisionObjectArray& collisionObjects = collisionWorld->getCollisionObjectArray();
+	int numElem = getUnionFind().getNumElements();
+	m_islandIndexFromId.resize(0);
+	m_islandIndexFromId.resize(numElem, -1);
+	if (numElem == 0)
+	{
+		return;
+	}
+	m_islandBodyOffsetFromId.resizeNoInitialize(numElem);
+	{
+		FindAwakeIslandsLoop loop;
+		loop.m_elements = &getUnionFind().getElement(0);
+		loop.m_islandStartFromId = &m_islandStartFromId[0];
+		loop.m_objects = &collisionObjects[0];
+		loop.m_islandBodyOffsetFromId = &m_islandBodyOffsetFromId[0];
+		btParallelFor(0, numElem, kIslandGrainSize, loop);
+	}
+	// create explicit islands, in order of island id
+	for (int islandId = 0; islandId < numElem; ++islandId)
+	{
+		int numBodies = m_islandStartFromId[islandId + 1] - m_islandStartFromId[islandId];
+		if (numBodies > 0 && m_islandBodyOffsetFromId[islandId] >= 0)
 		{
 			// want to count the number of bodies before allocating the island to optimize memory usage of the Island structures
-			int numBodies = endIslandIndex - startIslandIndex;
 			Island* island = allocateIsland(islandId, numBodies);
 			island->isSleeping = false;
+			// make room for the bodies, they are filled in below
+			m_islandBodyOffsetFromId[islandId] = island->bodyArray.size();
+			island->bodyArray.resizeNoInitialize(island->bodyArray.size() + numBodies);
+			// small islands share a batch island that was allocated earlier
+			int islandIndex = m_activeIslands.size() - 1;
+			while (islandIndex >= 0 && m_activeIslands[islandIndex] != island)
+			{
+				islandIndex--;
+			}
+			btAssert(islandIndex >= 0);
+			m_islandIndexFromId[islandId] = islandIndex;
+		}
+		else
+		{
+			m_islandBodyOffsetFromId[islandId] = -1;
+		}
+	}
+	// add bodies to islands
+	AddBodiesToIslandsLoop loop;
+	loop.m_elements = &getUnionFind().getElement(0);
+	loop.m_islandStartFromId = &m_islandStartFromId[0];
+	loop.m_islandBodyOffsetFromId = &m_islandBodyOffsetFromId[0];
+	loop.m_objects = &collisionObjects[0];
+	loop.m_lookupIslandFromId = &m_lookupIslandFromId[0];
+	btParallelFor(0, numElem, kIslandGrainSize, loop);
+}
+
+// copies the items grouped by island (sorted keys, see calcKeyStarts) to the end of each island's array
+template <typename T>
+struct AddItemsToIslandsLoop : public btIParallelForBody
+{
+	btSimulationIslandManagerMt::Island* const* m_islands;
+	btAlignedObjectArray<T*> btSimulationIslandManagerMt::Island::*m_islandArray;
+	T* const* m_items;
+	const btElement* m_sortedKeys;
+	const int* m_keyStarts;
 
-			// add bodies to island
-			for (int iElem = startIslandIndex; iElem < endIslandIndex; iElem++)
+	void forLoop(int iBegin, int iEnd) const BT_OVERRIDE
+	{
+		for (int iIsland = iBegin; iIsland < iEnd; ++iIsland)
+		{
+			int numItems = m_keyStarts[iIsland + 1] - m_keyStarts[iIsland];
+			if (numItems > 0)
 			{
-				int i = getUnionFind().getElement(iElem).m_sz;
-				btCollisionObject* colObj = collisionObjects[i];
-				island->bodyArray.push_back(colObj);
+				btAlignedObjectArray<T*>& islandArray = m_islands[iIsland]->*m_islandArray;
+				T** dest = &islandArray[islandArray.size() - numItems];
+				for (int i = m_keyStarts[iIsland]; i < m_keyStarts[iIsland + 1]; ++i)
+				{
+					*dest++ = m_items[m_sortedKeys[i].m_sz];
+				}
 			}
 		}
 	}
+};
+
+template <typename T>
+static void addItemsToIslands(btAlignedObjectArray<btSimulationIslandManagerMt::Island*>& islands,
+							  btAlignedObjectArray<T*> btSimulationIslandManagerMt::Island::*islandArray,
+							  T* const* items,
+							  btAlignedObjectArray<btElement>* keys,
+							  btAlignedObjectArray<int>* keyStarts,
+							  btAlignedObjectArray<btElement>* sortBuffer,
+							  btAlignedObjectArray<int>* radixCounts)
+{
+	// the keys are island indices, items that don't go in any island have key islands.size()
+	int numIslands = islands.size();
+	int numItems = keys->size();
+	if (numItems == 0 || numIslands == 0)
+	{
+		return;
+	}
+	radixSortElements(&(*keys)[0], numItems, numIslands, sortBuffer, radixCounts);
+	calcKeyStarts(&(*keys)[0], numItems, numIslands, keyStarts);
+	// make room serially, then copy in parallel
+	for (int iIsland = 0; iIsland < numIslands; ++iIsland)
+	{
+		btAlignedObjectArray<T*>& dest = islands[iIsland]->*islandArray;
+		dest.resizeNoInitialize(dest.size() + (*keyStarts)[iIsland + 1] - (*keyStarts)[iIsland]);
+	}
+	AddItemsToIslandsLoop<T> loop;
+	loop.m_islands = &islands[0];
+	loop.m_islandArray = islandArray;
+	loop.m_items = items;
+	loop.m_sortedKeys = &(*keys)[0];
+	loop.m_keyStarts = &(*keyStarts)[0];
+	btParallelFor(0, numIslands, 1, loop);
 }
 
+struct ManifoldIslandKeyLoop : public btIParallelForBody
+{
+	btPersistentManifold* const* m_manifolds;
+	btDispatcher* m_dispatcher;
+	const int* m_islandIndexFromId;
+	int m_noIsland;
+	btElement* m_keys;
+	unsigned char* m_needsActivation;
+
+	void forLoop(int iBegin, int iEnd) const BT_OVERRIDE
+	{
+		for (int i = iBegin; i < iEnd; ++i)
+		{
+			btPersistentManifold* manifold = m_manifolds[i];
+
+			const btCollisionObject* colObj0 = static_cast<const btCollisionObject*>(manifold->getBody0());
+			const btCollisionObject* colObj1 = static_cast<const btCollisionObject*>(manifold->getBody1());
+
+			int islandIndex = m_noIsland;
+			// kinematic objects are dealt with serially afterwards, they wake up the objects they touch
+			m_needsActivation[i] = colObj0->isKinematicObject() || colObj1->isKinematicObject();
+			///@todo: check sleeping conditions!
+			if (((colObj0) && colObj0->getActivationState() != ISLAND_SLEEPING) ||
+				((colObj1) && colObj1->getActivationState() != ISLAND_SLEEPING))
+			{
+				//filtering for response
+				if (m_dispatcher->needsResponse(colObj0, colObj1))
+				{
+					// scatter manifolds into various islands
+					int islandId = getIslandId(manifold);
+					// if island not sleeping,
+					if (islandId >= 0 && m_islandIndexFromId[islandId] >= 0)
+					{
+						islandIndex = m_islandIndexFromId[islandId];
+					}
+				}
+			}
+			m_keys[i].m_id = islandIndex;
+			m_keys[i].m_sz = i;
+		}
+	}
+};
+
 void btSimulationIslandManagerMt::addManifoldsToIslands(btDispatcher* dispatcher)
 {
-	// walk all the manifolds, activating bodies touched by kinematic objects, and add each manifold to its Island
 	int maxNumManifolds = dispatcher->getNumManifolds();
+	if (maxNumManifolds == 0)
+	{
+		return;
+	}
+	btPersistentManifold** manifolds = dispatcher->getInternalManifoldPointer();
+	m_islandKeys.resizeNoInitialize(maxNumManifolds);
+	m_needsActivation.resizeNoInitialize(maxNumManifolds);
+	{
+		ManifoldIslandKeyLoop loop;
+		loop.m_manifolds = manifolds;
+		loop.m_dispatcher = dispatcher;
+		loop.m_islandIndexFromId = m_islandIndexFromId.size() ? &m_islandIndexFromId[0] : NULL;
+		loop.m_noIsland = m_activeIslands.size();
+		loop.m_keys = &m_islandKeys[0];
+		loop.m_needsActivation = &m_needsActivation[0];
+		btParallelFor(0, maxNumManifolds, kIslandGrainSize, loop);
+	}
+	// walk the manifolds touching kinematic objects, activating bodies touched by kinematic objects.
+	// Only bodies of sleeping islands get activated here, so this doesn't change the islands the manifolds go to
 	for (int i = 0; i < maxNumManifolds; i++)
 	{
-		btPersistentManifold* manifold = dispatcher->getManifoldByIndexInternal(i);
+		if (m_needsActivation[i])
+		{
+			btPersistentManifold* manifold = manifolds[i];
 
-		const btCollisionObject* colObj0 = static_cast<const btCollisionObject*>(manifold->getBody0());
-		const btCollisionObject* colObj1 = static_cast<const btCollisionObject*>(manifold->getBody1());
+			btCollisionObject* colObj0 = const_cast<btCollisionObject*>(manifold->getBody0());
+			btCollisionObject* colObj1 = const_cast<btCollisionObject*>(manifold->getBody1());
 
-		///@todo: check sleeping conditions!
-		if (((colObj0) && colObj0->getActivationState() != ISLAND_SLEEPING) ||
-			((colObj1) && colObj1->getActivationState() != ISLAND_SLEEPING))
-		{
-			//kinematic objects don't merge islands, but wake up all connected objects
-			if (colObj0->isKinematicObject() && colObj0->getActivationState() != ISLAND_SLEEPING)
-			{
-				if (colObj0->hasContactResponse())
-					colObj1->activate();
-			}
-			if (colObj1->isKinematicObject() && colObj1->getActivationState() != ISLAND_SLEEPING)
-			{
-				if (colObj1->hasContactResponse())
-					colObj0->activate();
-			}
-			//filtering for response
-			if (dispatcher->needsResponse(colObj0, colObj1))
+			///@todo: check sleeping conditions!
+			if (((colObj0) && colObj0->getActivationState() != ISLAND_SLEEPING) ||
+				((colObj1) && colObj1->getActivationState() != ISLAND_SLEEPING))
 			{
-				// scatter manifolds into various islands
-				int islandId = getIslandId(manifold);
-				// if island not sleeping,
-				if (Island* island = getIsland(islandId))
+				//kinematic objects don't merge islands, but wake up all connected objects
+				if (colObj0->isKinematicObject() && colObj0->getActivationState() != ISLAND_SLEEPING)
 				{
-					island->manifoldArray.push_back(manifold);
+					if (colObj0->hasContactResponse())
+						colObj1->activate();
+				}
+				if (colObj1->isKinematicObject() && colObj1->getActivationState() != ISLAND_SLEEPING)
+				{
+					if (colObj1->hasContactResponse())
+						colObj0->activate();
 				}
 			}
 		}
 	}
+	// add each manifold to its Island, keeping the dispatcher's order within an island
+	addItemsToIslands(m_activeIslands, &Island::manifoldArray, manifolds, &m_islandKeys, &m_islandKeyStarts, &m_sortBuffer, &m_radixCounts);
 }
 
-void btSimulationIslandManagerMt::addConstraintsToIslands(btAlignedObjectArray<btTypedConstraint*>& constraints)
+struct ConstraintIslandKeyLoop : public btIParallelForBody
 {
-	// walk constraints
-	for (int i = 0; i < constraints.size(); i++)
+	btTypedConstraint* const* m_constraints;
+	const int* m_islandIndexFromId;
+	int m_noIsland;
+	btElement* m_keys;
+
+	void forLoop(int iBegin, int iEnd) const BT_OVERRIDE
 	{
-		// scatter constraints into various islands
-		btTypedConstraint* constraint = constraints[i];
-		if (constraint->isEnabled())
+		for (int i = iBegin; i < iEnd; ++i)
 		{
-			int islandId = btGetConstraintIslandId1(constraint);
-			// if island is not sleeping,
-			if (Island* island = getIsland(islandId))
+			btTypedConstraint* constraint = m_constraints[i];
+			int islandIndex = m_noIsland;
+			if (constraint->isEnabled())
 			{
-				island->constraintArray.push_back(constraint);
+				int islandId = btGetConstraintIslandId1(constraint);
+				// if island is not sleeping,
+				if (islandId >= 0 && m_islandIndexFromId[islandId] >= 0)
+				{
+					islandIndex = m_islandIndexFromId[islandId];
+				}
 			}
+			m_keys[i].m_id = islandIndex;
+			m_keys[i].m_sz = i;
 		}
 	}
+};
+
+void btSimulationIslandManagerMt::addConstraintsToIslands(btAlignedObjectArray<btTypedConstraint*>& constraints)
+{
+	int numConstraints = constraints.size();
+	if (numConstraints == 0)
+	{
+		return;
+	}
+	m_islandKeys.resizeNoInitialize(numConstraints);
+	{
+		ConstraintIslandKeyLoop loop;
+		loop.m_constraints = &constraints[0];
+		loop.m_islandIndexFromId = m_islandIndexFromId.size() ? &m_islandIndexFromId[0] : NULL;
+		loop.m_noIsland = m_activeIslands.size();
+		loop.m_keys = &m_islandKeys[0];
+		btParallelFor(0, numConstraints, kIslandGrainSize, loop);
+	}
+	// scatter constraints into various islands
+	addItemsToIslands(m_activeIslands, &Island::constraintArray, &constraints[0], &m_islandKeys, &m_islandKeyStarts, &m_sortBuffer, &m_radixCounts);
 }
 
 void btSimulationIslandManagerMt::mergeIslands()
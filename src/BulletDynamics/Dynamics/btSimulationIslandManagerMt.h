@@ -32,6 +32,11 @@ class btIDebugDraw;
 ///                       of islands. If only a single island exists, then no parallelism is
 ///                       possible.
 ///
+///                       The islands themselves are also built in parallel: the union find is done with
+///                       btUnionFind::uniteConcurrent, and the bodies, manifolds and constraints are grouped
+///                       by island with a stable parallel radix sort. The id of an island is the smallest
+///                       union find index in it, so the islands come out the same for any number of threads.
+///
 class btSimulationIslandManagerMt : public btSimulationIslandManager
 {
 public:
@@ -71,6 +76,16 @@ protected:
 	int m_batchIslandMinBodyCount;
 	IslandDispatchFunc m_islandDispatch;
 
+	// scratch space for building the islands in parallel
+	btAlignedObjectArray<int> m_islandStartFromId;       // first element of each island in the sorted union find, indexed by island id
+	btAlignedObjectArray<int> m_islandBodyOffsetFromId;  // where the bodies of an island go in its Island::bodyArray, -1 if sleeping
+	btAlignedObjectArray<int> m_islandIndexFromId;       // index in m_activeIslands, -1 if sleeping
+	btAlignedObjectArray<btElement> m_islandKeys;        // island index (m_id) and item index (m_sz) of manifolds and constraints
+	btAlignedObjectArray<int> m_islandKeyStarts;
+	btAlignedObjectArray<unsigned char> m_needsActivation;
+	btAlignedObjectArray<btElement> m_sortBuffer;
+	btAlignedObjectArray<int> m_radixCounts;
+
 	Island* getIsland(int id);
 	virtual Island* allocateIsland(int id, int numBodies);
 	virtual void initIslandPools();
@@ -88,6 +103,9 @@ public:
 										btAlignedObjectArray<btTypedConstraint*>& constraints,
 										const SolverParams& solverParams);
 
+	virtual void updateActivationState(btCollisionWorld* colWorld, btDispatcher* dispatcher) BT_OVERRIDE;
+	virtual void storeIslandActivationState(btCollisionWorld* world) BT_OVERRIDE;
+
 	virtual void buildIslands(btDispatcher* dispatcher, btCollisionWorld* colWorld);
 
 	int getMinimumSolverBatchSize() const
@@ -1418,6 +1418,9 @@ void btMultiBodyConstraintSolver::convertMultiBodyContact(btPersistentManifold*
 
 void btMultiBodyConstraintSolver::convertContacts(btPersistentManifold** manifoldPtr, int numManifolds, const btContactSolverInfo& infoGlobal)
 {
+	//the rigid body contacts go to the batched conversion of btSequentialImpulseConstraintSolver, the multibody contacts share
+	//the jacobian buffers of m_data and are converted one by one
+	bool batched = useBatchedContactConversion(numManifolds);
 	for (int i = 0; i < numManifolds; i++)
 	{
 		btPersistentManifold* manifold = manifoldPtr[i];
@@ -1426,13 +1429,20 @@ void btMultiBodyConstraintSolver::convertContacts(btPersistentManifold** manifol
 		if (!fcA && !fcB)
 		{
 			//the contact doesn't involve any Featherstone btMultiBody, so deal with the regular btRigidBody/btCollisionObject case
-			convertContact(manifold, infoGlobal);
+			if (batched)
+				addContactManifoldForConversion(manifold, infoGlobal);
+			else
+				convertContact(manifold, infoGlobal);
 		}
 		else
 		{
 			convertMultiBodyContact(manifold, infoGlobal);
 		}
 	}
+	if (batched)
+	{
+		convertAddedContactManifolds(infoGlobal);
+	}
 
 	//also convert the multibody constraints, if any
 
@@ -22,6 +22,110 @@ subject to the following restrictions:
 #include "btMultiBodyConstraint.h"
 #include "LinearMath/btIDebugDraw.h"
 #include "LinearMath/btSerializer.h"
+#include "LinearMath/btThreads.h"
+
+static const int kMultiBodyGrainSize = 4;  // multibodies per task, the forward dynamics of one multibody is already a fair amount of work
+
+// runs the per multibody loops in btParallelFor tasks when a task scheduler is set, otherwise inline
+static void btMultiBodyParallelFor(int iBegin, int iEnd, const btIParallelForBody& body)
+{
+#if BT_THREADSAFE
+	if (btGetTaskScheduler())
+	{
+		btParallelFor(iBegin, iEnd, kMultiBodyGrainSize, body);
+		return;
+	}
+#endif
+	body.forLoop(iBegin, iEnd);
+}
+
+static bool isMultiBodySleeping(const btMultiBody* bod)
+{
+	if (bod->getBaseCollider() && bod->getBaseCollider()->getActivationState() == ISLAND_SLEEPING)
+	{
+		return true;
+	}
+	for (int b = 0; b < bod->getNumLinks(); b++)
+	{
+		if (bod->getLink(b).m_collider && bod->getLink(b).m_collider->getActivationState() == ISLAND_SLEEPING)
+			return true;
+	}
+	return false;
+}
+
+struct UpdaterForwardKinematics : public btIParallelForBody
+{
+	btMultiBodyDynamicsWorld* world;
+	btMultiBody** multiBodies;
+
+	void forLoop(int iBegin, int iEnd) const BT_OVERRIDE
+	{
+		for (int i = iBegin; i < iEnd; ++i)
+		{
+			world->internalForwardKinematics(multiBodies[i]);
+		}
+	}
+};
+
+struct UpdaterStepVelocities : public btIParallelForBody
+{
+	btMultiBodyDynamicsWorld* world;
+	btMultiBody** multiBodies;
+	btScalar timeStep;
+
+	void forLoop(int iBegin, int iEnd) const BT_OVERRIDE
+	{
+		for (int i = iBegin; i < iEnd; ++i)
+		{
+			world->internalStepVelocities(multiBodies[i], timeStep);
+		}
+	}
+};
+
+struct UpdaterApplyDeltaVee : public btIParallelForBody
+{
+	btMultiBodyDynamicsWorld* world;
+	btMultiBody** multiBodies;
+	btScalar timeStep;
+
+	void forLoop(int iBegin, int iEnd) const BT_OVERRIDE
+	{
+		for (int i = iBegin; i < iEnd; ++i)
+		{
+			world->internalApplyDeltaVee(multiBodies[i], timeStep);
+		}
+	}
+};
+
+struct UpdaterIntegrateMultiBodyTransforms : public btIParallelForBody
+{
+	btMultiBodyDynamicsWorld* world;
+	btMultiBody** multiBodies;
+	btScalar timeStep;
+
+	void forLoop(int iBegin, int iEnd) const BT_OVERRIDE
+	{
+		for (int i = iBegin; i < iEnd; ++i)
+		{
+			world->internalIntegrateTransforms(multiBodies[i], timeStep);
+		}
+	}
+};
+
+struct UpdaterPredictMultiBodyTransforms : public btIParallelForBody
+{
+	btMultiBodyDynamicsWorld* world;
+	btMultiBody** multiBodies;
+	btScalar timeStep;
+
+	void forLoop(int iBegin, int iEnd) const BT_OVERRIDE
+	{
+		for (int i = iBegin; i < iEnd; ++i)
+		{
+			world->internalPredictTransforms(multiBodies[i], timeStep);
+		}
+	}
+};
 
 void btMultiBodyDynamicsWorld::addMultiBody(btMultiBody* body, int group, int mask)
 {
@@ -189,6 +293,11 @@ btMultiBodyDynamicsWorld::btMultiBodyDynamicsWorld(btDispatcher* dispatcher, btB
 	//	getSolverInfo().m_splitImpulse = false;
 	getSolverInfo().m_solverMode |= SOLVER_USE_2_FRICTION_DIRECTIONS;
 	m_solverMultiBodyIslandCallback = new MultiBodyInplaceSolverIslandCallback(constraintSolver, dispatcher);
+#if BT_THREADSAFE
+	m_threadScratch.resize(BT_MAX_THREAD_COUNT);
+#else
+	m_threadScratch.resize(1);
+#endif
 }
 
 btMultiBodyDynamicsWorld::~btMultiBodyDynamicsWorld()
@@ -212,13 +321,27 @@ void btMultiBodyDynamicsWorld::setConstraintSolver(btConstraintSolver* solver)
 	btDiscreteDynamicsWorld::setConstraintSolver(solver);
 }
 
+btMultiBodyDynamicsWorld::btMultiBodyScratch& btMultiBodyDynamicsWorld::getThreadScratch()
+{
+#if BT_THREADSAFE
+	return m_threadScratch[btGetCurrentThreadIndex()];
+#else
+	return m_threadScratch[0];
+#endif
+}
+
 void btMultiBodyDynamicsWorld::forwardKinematics()
 {
-	for (int b = 0; b < m_multiBodies.size(); b++)
-	{
-		btMultiBody* bod = m_multiBodies[b];
-		bod->forwardKinematics(m_scratch_world_to_local, m_scratch_local_origin);
-	}
+	UpdaterForwardKinematics update;
+	update.world = this;
+	update.multiBodies = m_multiBodies.size() ? &m_multiBodies[0] : 0;
+	btMultiBodyParallelFor(0, m_multiBodies.size(), update);
+}
+
+void btMultiBodyDynamicsWorld::internalForwardKinematics(btMultiBody* bod)
+{
+	btMultiBodyScratch& scratch = getThreadScratch();
+	bod->forwardKinematics(scratch.m_world_to_local, scratch.m_local_origin);
 }
 void btMultiBodyDynamicsWorld::solveConstraints(btContactSolverInfo& solverInfo)
 {
@@ -239,50 +362,25 @@ void btMultiBodyDynamicsWorld::solveInternalConstraints(btContactSolverInfo& sol
 	m_constraintSolver->allSolved(solverInfo, m_debugDrawer);
     {
         BT_PROFILE("btMultiBody stepVelocities");
-        for (int i = 0; i < this->m_multiBodies.size(); i++)
-        {
-            btMultiBody* bod = m_multiBodies[i];
-            
-            bool isSleeping = false;
-            
-            if (bod->getBaseCollider() && bod->getBaseCollider()->getActivationState() == ISLAND_SLEEPING)
-            {
-                isSleeping = true;
-            }
-            for (int b = 0; b < bod->getNumLinks(); b++)
-            {
-                if (bod->getLink(b).m_collider && bod->getLink(b).m_collider->getActivationState() == ISLAND_SLEEPING)
-                    isSleeping = true;
-            }
-            
-            if (!isSleeping)
-            {
-                //useless? they get resized in stepVelocities once again (AND DIFFERENTLY)
-                m_scratch_r.resize(bod->getNumLinks() + 1);  //multidof? ("Y"s use it and it is used to store qdd)
-                m_scratch_v.resize(bod->getNumLinks() + 1);
-                m_scratch_m.resize(bod->getNumLinks() + 1);
-                
-                if (bod->internalNeedsJointFeedback())
-                {
-                    if (!bod->isUsingRK4Integration())
-                    {
-                        if (bod->internalNeedsJointFeedback())
-                        {
-                            bool isConstraintPass = true;
-                            bod->computeAccelerationsArticulatedBodyAlgorithmMultiDof(solverInfo.m_timeStep, m_scratch_r, m_scratch_v, m_scratch_m, isConstraintPass,
-                                                                                      getSolverInfo().m_jointFeedbackInWorldSpace,
-                                                                                      getSolverInfo().m_jointFeedbackInJointFrame);
-                        }
-                    }
-                }
-            }
-        }
+        UpdaterApplyDeltaVee update;
+        update.world = this;
+        update.multiBodies = m_multiBodies.size() ? &m_multiBodies[0] : 0;
+        update.timeStep = solverInfo.m_timeStep;
+        btMultiBodyParallelFor(0, m_multiBodies.size(), update);
     }
-    for (int i = 0; i < this->m_multiBodies.size(); i++)
+}
+
+void btMultiBodyDynamicsWorld::internalApplyDeltaVee(btMultiBody* bod, btScalar timeStep)
+{
+    if (!isMultiBodySleeping(bod) && bod->internalNeedsJointFeedback() && !bod->isUsingRK4Integration())
     {
-        btMultiBody* bod = m_multiBodies[i];
-        bod->processDeltaVeeMultiDof2();
+        btMultiBodyScratch& scratch = getThreadScratch();
+        bool isConstraintPass = true;
+        bod->computeAccelerationsArticulatedBodyAlgorithmMultiDof(timeStep, scratch.m_r, scratch.m_v, scratch.m_m, isConstraintPass,
+                                                                  getSolverInfo().m_jointFeedbackInWorldSpace,
+                                                                  getSolverInfo().m_jointFeedbackInJointFrame);
     }
+    bod->processDeltaVeeMultiDof2();
 }
 
 void btMultiBodyDynamicsWorld::solveExternalForces(btContactSolverInfo& solverInfo)
@@ -353,222 +451,211 @@ void btMultiBodyDynamicsWorld::solveExternalForces(btContactSolverInfo& solverIn
     
     {
         BT_PROFILE("btMultiBody stepVelocities");
-        for (int i = 0; i < this->m_multiBodies.size(); i++)
+        UpdaterStepVelocities update;
+        update.world = this;
+        update.multiBodies = m_multiBodies.size() ? &m_multiBodies[0] : 0;
+        update.timeStep = solverInfo.m_timeStep;
+        btMultiBodyParallelFor(0, m_multiBodies.size(), update);
+    }
+}
+
+void btMultiBodyDynamicsWorld::internalStepVelocities(btMultiBody* bod, btScalar timeStep)
+{
+    if (isMultiBodySleeping(bod))
+        return;
+
+    btMultiBodyScratch& scratch = getThreadScratch();
+    bool doNotUpdatePos = false;
+    bool isConstraintPass = false;
+    {
+        if (!bod->isUsingRK4Integration())
         {
-            btMultiBody* bod = m_multiBodies[i];
-            
-            bool isSleeping = false;
+            bod->computeAccelerationsArticulatedBodyAlgorithmMultiDof(timeStep,
+                                                                      scratch.m_r, scratch.m_v, scratch.m_m,isConstraintPass,
+                                                                      getSolverInfo().m_jointFeedbackInWorldSpace,
+                                                                      getSolverInfo().m_jointFeedbackInJointFrame);
+        }
+        else
+        {
+            //
+            int numDofs = bod->getNumDofs() + 6;
+            int numPosVars = bod->getNumPosVars() + 7;
+            btAlignedObjectArray<btScalar>& scratch_r2 = scratch.m_rk4;
+            scratch_r2.resize(2 * numPosVars + 8 * numDofs);
+            //convenience
+            btScalar* pMem = &scratch_r2[0];
+            btScalar* scratch_q0 = pMem;
+            pMem += numPosVars;
+            btScalar* scratch_qx = pMem;
+            pMem += numPosVars;
+            btScalar* scratch_qd0 = pMem;
+            pMem += numDofs;
+            btScalar* scratch_qd1 = pMem;
+            pMem += numDofs;
+            btScalar* scratch_qd2 = pMem;
+            pMem += numDofs;
+            btScalar* scratch_qd3 = pMem;
+            pMem += numDofs;
+            btScalar* scratch_qdd0 = pMem;
+            pMem += numDofs;
+            btScalar* scratch_qdd1 = pMem;
+            pMem += numDofs;
+            btScalar* scratch_qdd2 = pMem;
+            pMem += numDofs;
+            btScalar* scratch_qdd3 = pMem;
+            pMem += numDofs;
+            btAssert((pMem - (2 * numPosVars + 8 * numDofs)) == &scratch_r2[0]);
             
-            if (bod->getBaseCollider() && bod->getBaseCollider()->getActivationState() == ISLAND_SLEEPING)
+            /////
+            //copy q0 to scratch_q0 and qd0 to scratch_qd0
+            scratch_q0[0] = bod->getWorldToBaseRot().x();
+            scratch_q0[1] = bod->getWorldToBaseRot().y();
+            scratch_q0[2] = bod->getWorldToBaseRot().z();
+            scratch_q0[3] = bod->getWorldToBaseRot().w();
+            scratch_q0[4] = bod->getBasePos().x();
+            scratch_q0[5] = bod->getBasePos().y();
+            scratch_q0[6] = bod->getBasePos().z();
+            //
+            for (int link = 0; link < bod->getNumLinks(); ++link)
             {
-                isSleeping = true;
+                for (int dof = 0; dof < bod->getLink(link).m_posVarCount; ++dof)
+                    scratch_q0[7 + bod->getLink(link).m_cfgOffset + dof] = bod->getLink(link).m_jointPos[dof];
             }
-            for (int b = 0; b < bod->getNumLinks(); b++)
+            //
+            for (int dof = 0; dof < numDofs; ++dof)
+                scratch_qd0[dof] = bod->getVelocityVector()[dof];
+            ////
+            struct
             {
-                if (bod->getLink(b).m_collider && bod->getLink(b).m_collider->getActivationState() == ISLAND_SLEEPING)
-                    isSleeping = true;
-            }
-            
-            if (!isSleeping)
+                btMultiBody* bod;
+                btScalar *scratch_qx, *scratch_q0;
+                
+                void operator()()
+                {
+                    for (int dof = 0; dof < bod->getNumPosVars() + 7; ++dof)
+                        scratch_qx[dof] = scratch_q0[dof];
+                }
+            } pResetQx = {bod, scratch_qx, scratch_q0};
+            //
+            struct
             {
-                //useless? they get resized in stepVelocities once again (AND DIFFERENTLY)
-                m_scratch_r.resize(bod->getNumLinks() + 1);  //multidof? ("Y"s use it and it is used to store qdd)
-                m_scratch_v.resize(bod->getNumLinks() + 1);
-                m_scratch_m.resize(bod->getNumLinks() + 1);
-                bool doNotUpdatePos = false;
-                bool isConstraintPass = false;
+                void operator()(btScalar dt, const btScalar* pDer, const btScalar* pCurVal, btScalar* pVal, int size)
                 {
-                    if (!bod->isUsingRK4Integration())
-                    {
-                        bod->computeAccelerationsArticulatedBodyAlgorithmMultiDof(solverInfo.m_timeStep,
-                                                                                  m_scratch_r, m_scratch_v, m_scratch_m,isConstraintPass,
-                                                                                  getSolverInfo().m_jointFeedbackInWorldSpace,
-                                                                                  getSolverInfo().m_jointFeedbackInJointFrame);
-                    }
-                    else
-                    {
-                        //
-                        int numDofs = bod->getNumDofs() + 6;
-                        int numPosVars = bod->getNumPosVars() + 7;
-                        btAlignedObjectArray<btScalar> scratch_r2;
-                        scratch_r2.resize(2 * numPosVars + 8 * numDofs);
-                        //convenience
-                        btScalar* pMem = &scratch_r2[0];
-                        btScalar* scratch_q0 = pMem;
-                        pMem += numPosVars;
-                        btScalar* scratch_qx = pMem;
-                        pMem += numPosVars;
-                        btScalar* scratch_qd0 = pMem;
-                        pMem += numDofs;
-                        btScalar* scratch_qd1 = pMem;
-                        pMem += numDofs;
-                        btScalar* scratch_qd2 = pMem;
-                        pMem += numDofs;
-                        btScalar* scratch_qd3 = pMem;
-                        pMem += numDofs;
-                        btScalar* scratch_qdd0 = pMem;
-                        pMem += numDofs;
-                        btScalar* scratch_qdd1 = pMem;
-                        pMem += numDofs;
-                        btScalar* scratch_qdd2 = pMem;
-                        pMem += numDofs;
-                        btScalar* scratch_qdd3 = pMem;
-                        pMem += numDofs;
-                        btAssert((pMem - (2 * numPosVars + 8 * numDofs)) == &scratch_r2[0]);
-                        
-                        /////
-                        //copy q0 to scratch_q0 and qd0 to scratch_qd0
-                        scratch_q0[0] = bod->getWorldToBaseRot().x();
-                        scratch_q0[1] = bod->getWorldToBaseRot().y();
-                        scratch_q0[2] = bod->getWorldToBaseRot().z();
-                        scratch_q0[3] = bod->getWorldToBaseRot().w();
-                        scratch_q0[4] = bod->getBasePos().x();
-                        scratch_q0[5] = bod->getBasePos().y();
-                        scratch_q0[6] = bod->getBasePos().z();
-                        //
-                        for (int link = 0; link < bod->getNumLinks(); ++link)
-                        {
-                            for (int dof = 0; dof < bod->getLink(link).m_posVarCount; ++dof)
-                                scratch_q0[7 + bod->getLink(link).m_cfgOffset + dof] = bod->getLink(link).m_jointPos[dof];
-                        }
-                        //
-                        for (int dof = 0; dof < numDofs; ++dof)
-                            scratch_qd0[dof] = bod->getVelocityVector()[dof];
-                        ////
-                        struct
-                        {
-                            btMultiBody* bod;
-                            btScalar *scratch_qx, *scratch_q0;
-                            
-                            void operator()()
-                            {
-                                for (int dof = 0; dof < bod->getNumPosVars() + 7; ++dof)
-                                    scratch_qx[dof] = scratch_q0[dof];
-                            }
-                        } pResetQx = {bod, scratch_qx, scratch_q0};
-                        //
-                        struct
-                        {
-                            void operator()(btScalar dt, const btScalar* pDer, const btScalar* pCurVal, btScalar* pVal, int size)
-                            {
-                                for (int i = 0; i < size; ++i)
-                                    pVal[i] = pCurVal[i] + dt * pDer[i];
-                            }
-                            
-                        } pEulerIntegrate;
-                        //
-                        struct
-                        {
-                            void operator()(btMultiBody* pBody, const btScalar* pData)
-                            {
-                                btScalar* pVel = const_cast<btScalar*>(pBody->getVelocityVector());
-                                
-                                for (int i = 0; i < pBody->getNumDofs() + 6; ++i)
-                                    pVel[i] = pData[i];
-                            }
-                        } pCopyToVelocityVector;
-                        //
-                        struct
-                        {
-                            void operator()(const btScalar* pSrc, btScalar* pDst, int start, int size)
-                            {
-                                for (int i = 0; i < size; ++i)
-                                    pDst[i] = pSrc[start + i];
-                            }
-                        } pCopy;
-                        //
-                        
-                        btScalar h = solverInfo.m_timeStep;
-#define output &m_scratch_r[bod->getNumDofs()]
-                        //calc qdd0 from: q0 & qd0
-                        bod->computeAccelerationsArticulatedBodyAlgorithmMultiDof(0., m_scratch_r, m_scratch_v, m_scratch_m,
-                                                                                  isConstraintPass,getSolverInfo().m_jointFeedbackInWorldSpace,
-                                                                                  getSolverInfo().m_jointFeedbackInJointFrame);
-                        pCopy(output, scratch_qdd0, 0, numDofs);
-                        //calc q1 = q0 + h/2 * qd0
-                        pResetQx();
-                        bod->stepPositionsMultiDof(btScalar(.5) * h, scratch_qx, scratch_qd0);
-                        //calc qd1 = qd0 + h/2 * qdd0
-                        pEulerIntegrate(btScalar(.5) * h, scratch_qdd0, scratch_qd0, scratch_qd1, numDofs);
-                        //
-                        //calc qdd1 from: q1 & qd1
-                        pCopyToVelocityVector(bod, scratch_qd1);
-                        bod->computeAccelerationsArticulatedBodyAlgorithmMultiDof(0., m_scratch_r, m_scratch_v, m_scratch_m,
-                                                                                  isConstraintPass,getSolverInfo().m_jointFeedbackInWorldSpace,
-                                                                                  getSolverInfo().m_jointFeedbackInJointFrame);
-                        pCopy(output, scratch_qdd1, 0, numDofs);
-                        //calc q2 = q0 + h/2 * qd1
-                        pResetQx();
-                        bod->stepPositionsMultiDof(btScalar(.5) * h, scratch_qx, scratch_qd1);
-                        //calc qd2 = qd0 + h/2 * qdd1
-                        pEulerIntegrate(btScalar(.5) * h, scratch_qdd1, scratch_qd0, scratch_qd2, numDofs);
-                        //
-                        //calc qdd2 from: q2 & qd2
-                        pCopyToVelocityVector(bod, scratch_qd2);
-                        bod->computeAccelerationsArticulatedBodyAlgorithmMultiDof(0., m_scratch_r, m_scratch_v, m_scratch_m,
-                                                                                  isConstraintPass,getSolverInfo().m_jointFeedbackInWorldSpace,
-                                                                                  getSolverInfo().m_jointFeedbackInJointFrame);
-                        pCopy(output, scratch_qdd2, 0, numDofs);
-                        //calc q3 = q0 + h * qd2
-                        pResetQx();
-                        bod->stepPositionsMultiDof(h, scratch_qx, scratch_qd2);
-                        //calc qd3 = qd0 + h * qdd2
-                        pEulerIntegrate(h, scratch_qdd2, scratch_qd0, scratch_qd3, numDofs);
-                        //
-                        //calc qdd3 from: q3 & qd3
-                        pCopyToVelocityVector(bod, scratch_qd3);
-                        bod->computeAccelerationsArticulatedBodyAlgorithmMultiDof(0., m_scratch_r, m_scratch_v, m_scratch_m,
-                                                                                  isConstraintPass,getSolverInfo().m_jointFeedbackInWorldSpace,
-                                                                                  getSolverInfo().m_jointFeedbackInJointFrame);
-                        pCopy(output, scratch_qdd3, 0, numDofs);
-                        
-                        //
-                        //calc q = q0 + h/6(qd0 + 2*(qd1 + qd2) + qd3)
-                        //calc qd = qd0 + h/6(qdd0 + 2*(qdd1 + qdd2) + qdd3)
-                        btAlignedObjectArray<btScalar> delta_q;
-                        delta_q.resize(numDofs);
-                        btAlignedObjectArray<btScalar> delta_qd;
-                        delta_qd.resize(numDofs);
-                        for (int i = 0; i < numDofs; ++i)
-                        {
-                            delta_q[i] = h / btScalar(6.) * (scratch_qd0[i] + 2 * scratch_qd1[i] + 2 * scratch_qd2[i] + scratch_qd3[i]);
-                            delta_qd[i] = h / btScalar(6.) * (scratch_qdd0[i] + 2 * scratch_qdd1[i] + 2 * scratch_qdd2[i] + scratch_qdd3[i]);
-                            //delta_q[i] = h*scratch_qd0[i];
-                            //delta_qd[i] = h*scratch_qdd0[i];
-                        }
-                        //
-                        pCopyToVelocityVector(bod, scratch_qd0);
-                        bod->applyDeltaVeeMultiDof(&delta_qd[0], 1);
-                        //
-                        if (!doNotUpdatePos)
-                        {
-                            btScalar* pRealBuf = const_cast<btScalar*>(bod->getVelocityVector());
-                            pRealBuf += 6 + bod->getNumDofs() + bod->getNumDofs() * bod->getNumDofs();
-                            
-                            for (int i = 0; i < numDofs; ++i)
-                                pRealBuf[i] = delta_q[i];
-                            
-                            //bod->stepPositionsMultiDof(1, 0, &delta_q[0]);
-                            bod->setPosUpdated(true);
-                        }
-                        
-                        //ugly hack which resets the cached data to t0 (needed for constraint solver)
-                        {
-                            for (int link = 0; link < bod->getNumLinks(); ++link)
-                                bod->getLink(link).updateCacheMultiDof();
-                            bod->computeAccelerationsArticulatedBodyAlgorithmMultiDof(0, m_scratch_r, m_scratch_v, m_scratch_m,
-                                                                                      isConstraintPass,getSolverInfo().m_jointFeedbackInWorldSpace,
-                                                                                      getSolverInfo().m_jointFeedbackInJointFrame);
-                        }
-                    }
+                    for (int i = 0; i < size; ++i)
+                        pVal[i] = pCurVal[i] + dt * pDer[i];
                 }
                 
-#ifndef BT_USE_VIRTUAL_CLEARFORCES_AND_GRAVITY
-                bod->clearForcesAndTorques();
-#endif         //BT_USE_VIRTUAL_CLEARFORCES_AND_GRAVITY
-            }  //if (!isSleeping)
+            } pEulerIntegrate;
+            //
+            struct
+            {
+                void operator()(btMultiBody* pBody, const btScalar* pData)
+                {
+                    btScalar* pVel = const_cast<btScalar*>(pBody->getVelocityVector());
+                    
+                    for (int i = 0; i < pBody->getNumDofs() + 6; ++i)
+                        pVel[i] = pData[i];
+                }
+            } pCopyToVelocityVector;
+            //
+            struct
+            {
+                void operator()(const btScalar* pSrc, btScalar* pDst, int start, int size)
+                {
+                    for (int i = 0; i < size; ++i)
+                        pDst[i] = pSrc[start + i];
+                }
+            } pCopy;
+            //
+            
+            btScalar h = timeStep;
+#define output &scratch.m_r[bod->getNumDofs()]
+            //calc qdd0 from: q0 & qd0
+            bod->computeAccelerationsArticulatedBodyAlgorithmMultiDof(0., scratch.m_r, scratch.m_v, scratch.m_m,
+                                                                      isConstraintPass,getSolverInfo().m_jointFeedbackInWorldSpace,
+                                                                      getSolverInfo().m_jointFeedbackInJointFrame);
+            pCopy(output, scratch_qdd0, 0, numDofs);
+            //calc q1 = q0 + h/2 * qd0
+            pResetQx();
+            bod->stepPositionsMultiDof(btScalar(.5) * h, scratch_qx, scratch_qd0);
+            //calc qd1 = qd0 + h/2 * qdd0
+            pEulerIntegrate(btScalar(.5) * h, scratch_qdd0, scratch_qd0, scratch_qd1, numDofs);
+            //
+            //calc qdd1 from: q1 & qd1
+            pCopyToVelocityVector(bod, scratch_qd1);
+            bod->computeAccelerationsArticulatedBodyAlgorithmMultiDof(0., scratch.m_r, scratch.m_v, scratch.m_m,
+                                                                      isConstraintPass,getSolverInfo().m_jointFeedbackInWorldSpace,
+                                                                      getSolverInfo().m_jointFeedbackInJointFrame);
+            pCopy(output, scratch_qdd1, 0, numDofs);
+            //calc q2 = q0 + h/2 * qd1
+            pResetQx();
+            bod->stepPositionsMultiDof(btScalar(.5) * h, scratch_qx, scratch_qd1);
+            //calc qd2 = qd0 + h/2 * qdd1
+            pEulerIntegrate(btScalar(.5) * h, scratch_qdd1, scratch_qd0, scratch_qd2, numDofs);
+            //
+            //calc qdd2 from: q2 & qd2
+            pCopyToVelocityVector(bod, scratch_qd2);
+            bod->computeAccelerationsArticulatedBodyAlgorithmMultiDof(0., scratch.m_r, scratch.m_v, scratch.m_m,
+                                                                      isConstraintPass,getSolverInfo().m_jointFeedbackInWorldSpace,
+                                                                      getSolverInfo().m_jointFeedbackInJointFrame);
+            pCopy(output, scratch_qdd2, 0, numDofs);
+            //calc q3 = q0 + h * qd2
+            pResetQx();
+            bod->stepPositionsMultiDof(h, scratch_qx, scratch_qd2);
+            //calc qd3 = qd0 + h * qdd2
+            pEulerIntegrate(h, scratch_qdd2, scratch_qd0, scratch_qd3, numDofs);
+            //
+            //calc qdd3 from: q3 & qd3
+            pCopyToVelocityVector(bod, scratch_qd3);
+            bod->computeAccelerationsArticulatedBodyAlgorithmMultiDof(0., scratch.m_r, scratch.m_v, scratch.m_m,
+                                                                      isConstraintPass,getSolverInfo().m_jointFeedbackInWorldSpace,
+                                                                      getSolverInfo().m_jointFeedbackInJointFrame);
+            pCopy(output, scratch_qdd3, 0, numDofs);
+            
+            //
+            //calc q = q0 + h/6(qd0 + 2*(qd1 + qd2) + qd3)
+            //calc qd = qd0 + h/6(qdd0 + 2*(qdd1 + qdd2) + qdd3)
+            btAlignedObjectArray<btScalar> delta_q;
+            delta_q.resize(numDofs);
+            btAlignedObjectArray<btScalar> delta_qd;
+            delta_qd.resize(numDofs);
+            for (int i = 0; i < numDofs; ++i)
+            {
+                delta_q[i] = h / btScalar(6.) * (scratch_qd0[i] + 2 * scratch_qd1[i] + 2 * scratch_qd2[i] + scratch_qd3[i]);
+                delta_qd[i] = h / btScalar(6.) * (scratch_qdd0[i] + 2 * scratch_qdd1[i] + 2 * scratch_qdd2[i] + scratch_qdd3[i]);
+                //delta_q[i] = h*scratch_qd0[i];
+                //delta_qd[i] = h*scratch_qdd0[i];
+            }
+            //
+            pCopyToVelocityVector(bod, scratch_qd0);
+            bod->applyDeltaVeeMultiDof(&delta_qd[0], 1);
+            //
+            if (!doNotUpdatePos)
+            {
+                btScalar* pRealBuf = const_cast<btScalar*>(bod->getVelocityVector());
+                pRealBuf += 6 + bod->getNumDofs() + bod->getNumDofs() * bod->getNumDofs();
+                
+                for (int i = 0; i < numDofs; ++i)
+                    pRealBuf[i] = delta_q[i];
+                
+                //bod->stepPositionsMultiDof(1, 0, &delta_q[0]);
+                bod->setPosUpdated(true);
+            }
+            
+            //ugly hack which resets the cached data to t0 (needed for constraint solver)
+            {
+                for (int link = 0; link < bod->getNumLinks(); ++link)
+                    bod->getLink(link).updateCacheMultiDof();
+                bod->computeAccelerationsArticulatedBodyAlgorithmMultiDof(0, scratch.m_r, scratch.m_v, scratch.m_m,
+                                                                          isConstraintPass,getSolverInfo().m_jointFeedbackInWorldSpace,
+                                                                          getSolverInfo().m_jointFeedbackInJointFrame);
+            }
         }
     }
+    
+#ifndef BT_USE_VIRTUAL_CLEARFORCES_AND_GRAVITY
+    bod->clearForcesAndTorques();
+#endif         //BT_USE_VIRTUAL_CLEARFORCES_AND_GRAVITY
 }
 
 
@@ -580,85 +667,66 @@ void btMultiBodyDynamicsWorld::integrateTransforms(btScalar timeStep)
 
 void btMultiBodyDynamicsWorld::integrateMultiBodyTransforms(btScalar timeStep)
 {
-		BT_PROFILE("btMultiBody stepPositions");
-		//integrate and update the Featherstone hierarchies
-
-		for (int b = 0; b < m_multiBodies.size(); b++)
-		{
-			btMultiBody* bod = m_multiBodies[b];
-			bool isSleeping = false;
-			if (bod->getBaseCollider() && bod->getBaseCollider()->getActivationState() == ISLAND_SLEEPING)
-			{
-				isSleeping = true;
-			}
-			for (int b = 0; b < bod->getNumLinks(); b++)
-			{
-				if (bod->getLink(b).m_collider && bod->getLink(b).m_collider->getActivationState() == ISLAND_SLEEPING)
-					isSleeping = true;
-			}
-
-			if (!isSleeping)
-			{
-				bod->addSplitV();
-				int nLinks = bod->getNumLinks();
-
-				///base + num m_links
-                if (!bod->isPosUpdated())
-                    bod->stepPositionsMultiDof(timeStep);
-                else
-                {
-                    btScalar* pRealBuf = const_cast<btScalar*>(bod->getVelocityVector());
-                    pRealBuf += 6 + bod->getNumDofs() + bod->getNumDofs() * bod->getNumDofs();
+	BT_PROFILE("btMultiBody stepPositions");
+	//integrate and update the Featherstone hierarchies
+	UpdaterIntegrateMultiBodyTransforms update;
+	update.world = this;
+	update.multiBodies = m_multiBodies.size() ? &m_multiBodies[0] : 0;
+	update.timeStep = timeStep;
+	btMultiBodyParallelFor(0, m_multiBodies.size(), update);
+}
 
-                    bod->stepPositionsMultiDof(1, 0, pRealBuf);
-                    bod->setPosUpdated(false);
-                }
+void btMultiBodyDynamicsWorld::internalIntegrateTransforms(btMultiBody* bod, btScalar timeStep)
+{
+	if (!isMultiBodySleeping(bod))
+	{
+		bod->addSplitV();
 
+		///base + num m_links
+		if (!bod->isPosUpdated())
+			bod->stepPositionsMultiDof(timeStep);
+		else
+		{
+			btScalar* pRealBuf = const_cast<btScalar*>(bod->getVelocityVector());
+			pRealBuf += 6 + bod->getNumDofs() + bod->getNumDofs() * bod->getNumDofs();
 
-				m_scratch_world_to_local.resize(nLinks + 1);
-				m_scratch_local_origin.resize(nLinks + 1);
-                bod->updateCollisionObjectWorldTransforms(m_scratch_world_to_local, m_scratch_local_origin);
-				bod->substractSplitV();
-			}
-			else
-			{
-				bod->clearVelocities();
-			}
+			bod->stepPositionsMultiDof(1, 0, pRealBuf);
+			bod->setPosUpdated(false);
 		}
+
+		btMultiBodyScratch& scratch = getThreadScratch();
+		bod->updateCollisionObjectWorldTransforms(scratch.m_world_to_local, scratch.m_local_origin);
+		bod->substractSplitV();
+	}
+	else
+	{
+		bod->clearVelocities();
+	}
 }
 
 void btMultiBodyDynamicsWorld::predictMultiBodyTransforms(btScalar timeStep)
 {
-    BT_PROFILE("btMultiBody stepPositions");
-    //integrate and update the Featherstone hierarchies
-    
-    for (int b = 0; b < m_multiBodies.size(); b++)
-    {
-        btMultiBody* bod = m_multiBodies[b];
-        bool isSleeping = false;
-        if (bod->getBaseCollider() && bod->getBaseCollider()->getActivationState() == ISLAND_SLEEPING)
-        {
-            isSleeping = true;
-        }
-        for (int b = 0; b < bod->getNumLinks(); b++)
-        {
-            if (bod->getLink(b).m_collider && bod->getLink(b).m_collider->getActivationState() == ISLAND_SLEEPING)
-                isSleeping = true;
-        }
-        
-        if (!isSleeping)
-        {
-            int nLinks = bod->getNumLinks();
-            bod->predictPositionsMultiDof(timeStep);
-            m_scratch_world_to_local.resize(nLinks + 1);
-            m_scratch_local_origin.resize(nLinks + 1);
-            bod->updateCollisionObjectInterpolationWorldTransforms(m_scratch_world_to_local, m_scratch_local_origin);
-        }
-        else
-        {
-            bod->clearVelocities();
-        }
-    }
+	BT_PROFILE("btMultiBody stepPositions");
+	//integrate and update the Featherstone hierarchies
+	UpdaterPredictMultiBodyTransforms update;
+	update.world = this;
+	update.multiBodies = m_multiBodies.size() ? &m_multiBodies[0] : 0;
+	update.timeStep = timeStep;
+	btMultiBodyParallelFor(0, m_multiBodies.size(), update);
+}
+
+void btMultiBodyDynamicsWorld::internalPredictTransforms(btMultiBody* bod, btScalar timeStep)
+{
+	if (!isMultiBodySleeping(bod))
+	{
+		bod->predictPositionsMultiDof(timeStep);
+		btMultiBodyScratch& scratch = getThreadScratch();
+		bod->updateCollisionObjectInterpolationWorldTransforms(scratch.m_world_to_local, scratch.m_local_origin);
+	}
+	else
+	{
+		bod->clearVelocities();
+	}
 }
 
 void btMultiBodyDynamicsWorld::addMultiBodyConstraint(btMultiBodyConstraint* constraint)
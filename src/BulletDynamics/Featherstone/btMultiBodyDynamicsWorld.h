@@ -46,6 +46,20 @@ protected:
 	btAlignedObjectArray<btVector3> m_scratch_v;
 	btAlignedObjectArray<btMatrix3x3> m_scratch_m;
 
+	///scratch of the per multibody loops, one per thread since the loops run in btParallelFor tasks
+	struct btMultiBodyScratch
+	{
+		btAlignedObjectArray<btQuaternion> m_world_to_local;
+		btAlignedObjectArray<btVector3> m_local_origin;
+		btAlignedObjectArray<btScalar> m_r;
+		btAlignedObjectArray<btVector3> m_v;
+		btAlignedObjectArray<btMatrix3x3> m_m;
+		btAlignedObjectArray<btScalar> m_rk4;
+	};
+	btAlignedObjectArray<btMultiBodyScratch> m_threadScratch;
+
+	btMultiBodyScratch& getThreadScratch();
+
 	virtual void calculateSimulationIslands();
 	virtual void updateActivationState(btScalar timeStep);
 	
@@ -122,5 +136,12 @@ public:
     void buildIslands();
 
 	virtual void saveKinematicState(btScalar timeStep);
+
+	// per multibody steps, public so that the btParallelFor loops can call them
+	void internalForwardKinematics(btMultiBody* bod);
+	void internalStepVelocities(btMultiBody* bod, btScalar timeStep);
+	void internalApplyDeltaVee(btMultiBody* bod, btScalar timeStep);
+	void internalIntegrateTransforms(btMultiBody* bod, btScalar timeStep);
+	void internalPredictTransforms(btMultiBody* bod, btScalar timeStep);
 };
 #endif  //BT_MULTIBODY_DYNAMICS_WORLD_H
@@ -67,7 +67,8 @@ public:
 			// temp = A*p
 			A.multiply(p, temp);
 			A.project(temp);
-			if (this->dot(p, temp) < 0)
+			btScalar p_dot_Ap = this->dot(p, temp);
+			if (p_dot_Ap < 0)
 			{
 				if (verbose)
 					std::cout << "Encountered negative direction in CG!" << std::endl;
@@ -78,7 +79,7 @@ public:
 				return k;
 			}
 			// alpha = r^T * z / (p^T * A * p)
-			btScalar alpha = r_dot_z_new / this->dot(p, temp);
+			btScalar alpha = r_dot_z_new / p_dot_Ap;
 			//  x += alpha * p;
 			this->multAndAddTo(alpha, p, x);
 			//  r -= alpha * temp;
@@ -97,7 +98,8 @@ public:
 			}
 
 			btScalar beta = r_dot_z_new / r_dot_z;
-			p = this->multAndAdd(beta, p, z);
+			// p = beta * p + z;
+			this->scaleAndAddTo(beta, p, z);
 		}
 		if (verbose)
 		{
@@ -20,6 +20,8 @@ subject to the following restrictions:
 #include "btDefaultSoftBodySolver.h"
 #include "BulletCollision/CollisionShapes/btCapsuleShape.h"
 #include "BulletSoftBody/btSoftBody.h"
+#include "LinearMath/btThreads.h"
+#include "LinearMath/btQuickprof.h"
 #include <BulletCable/btCable.h>
 
 btDefaultSoftBodySolver::btDefaultSoftBodySolver()
@@ -44,16 +46,43 @@ void btDefaultSoftBodySolver::optimize(btAlignedObjectArray<btSoftBody *> &softB
 	m_softBodySet.copyFromArray(softBodies);
 }
 
-void btDefaultSoftBodySolver::updateSoftBodies()
+// Runs a per soft body loop in btParallelFor tasks, one soft body per task, or inline without a task scheduler
+static void btSoftBodyParallelFor(int iBegin, int iEnd, const btIParallelForBody &body)
 {
-	for (int i = 0; i < m_softBodySet.size(); i++)
+#if BT_THREADSAFE
+	if (btGetTaskScheduler())
 	{
-		btSoftBody *psb = (btSoftBody *)m_softBodySet[i];
-		if (psb->isActive())
+		btParallelFor(iBegin, iEnd, 1, body);
+		return;
+	}
+#endif
+	body.forLoop(iBegin, iEnd);
+}
+
+struct btIntegrateSoftBodyMotionLoop : public btIParallelForBody
+{
+	btAlignedObjectArray<btSoftBody *> &m_softBodySet;
+
+	btIntegrateSoftBodyMotionLoop(btAlignedObjectArray<btSoftBody *> &softBodySet) : m_softBodySet(softBodySet) {}
+
+	void forLoop(int iBegin, int iEnd) const BT_OVERRIDE
+	{
+		for (int i = iBegin; i < iEnd; ++i)
 		{
-			psb->integrateMotion();
+			btSoftBody *psb = m_softBodySet[i];
+			if (psb->isActive())
+			{
+				psb->integrateMotion();
+			}
 		}
 	}
+};
+
+void btDefaultSoftBodySolver::updateSoftBodies()
+{
+	BT_PROFILE("btDefaultSoftBodySolver::updateSoftBodies");
+	btIntegrateSoftBodyMotionLoop loop(m_softBodySet);
+	btSoftBodyParallelFor(0, m_softBodySet.size(), loop);
 }  // updateSoftBodies
 
 bool btDefaultSoftBodySolver::checkInitialized()
@@ -61,35 +90,47 @@ bool btDefaultSoftBodySolver::checkInitialized()
 	return true;
 }
 
-void btDefaultSoftBodySolver::solveConstraints(btScalar solverdt)
+struct btSolveSoftBodyConstraintsLoop : public btIParallelForBody
 {
-	// Solve constraints for non-solver softbodies
-	
-	omp_set_dynamic(0);      // Explicitly disable dynamic teams
-	omp_set_num_threads(numThread);  // Use numThread threads for all consecutive parallel regions
-	#pragma omp parallel for	
-	for (int i = 0; i < m_softBodySet.size(); ++i)
-	{
-		btSoftBody *psb = static_cast<btSoftBody *>(m_softBodySet[i]);
-		btCable *cable = (btCable *)psb;
+	btAlignedObjectArray<btSoftBody *> &m_softBodySet;
+	btScalar m_solverdt;
 
-		// grows/shrinks only in physic
-		if (cable != nullptr && psb->isActive())
-		{
-			cable->updateLength(solverdt);
-		}
+	btSolveSoftBodyConstraintsLoop(btAlignedObjectArray<btSoftBody *> &softBodySet, btScalar solverdt) : m_softBodySet(softBodySet), m_solverdt(solverdt) {}
 
-		if (psb->isActive())
+	void forLoop(int iBegin, int iEnd) const BT_OVERRIDE
+	{
+		for (int i = iBegin; i < iEnd; ++i)
 		{
-			psb->solveConstraints();
+			btSoftBody *psb = static_cast<btSoftBody *>(m_softBodySet[i]);
+			btCable *cable = psb->m_cableModel ? static_cast<btCable *>(psb) : nullptr;
+
+			// grows/shrinks only in physic
+			if (cable != nullptr && psb->isActive())
+			{
+				cable->updateLength(m_solverdt);
+			}
+
+			if (psb->isActive())
+			{
+				psb->solveConstraints();
+			}
+
+			if (cable != nullptr)
+			{
+				cable->updateNodeData();
+			}
 		}
-		
-		if (cable != nullptr)
-		{
-			cable->updateNodeData();
-		}	
 	}
-} 
+};
+
+void btDefaultSoftBodySolver::solveConstraints(btScalar solverdt)
+{
+	BT_PROFILE("btDefaultSoftBodySolver::solveConstraints");
+	// Solve constraints for non-solver softbodies
+	// One soft body per task, the threads come from the task scheduler shared with the rest of the world
+	btSolveSoftBodyConstraintsLoop loop(m_softBodySet, solverdt);
+	btSoftBodyParallelFor(0, m_softBodySet.size(), loop);
+}
 // btDefaultSoftBodySolver::solveConstraints
 
 void btDefaultSoftBodySolver::copySoftBodyToVertexBuffer(const btSoftBody *const softBody, btVertexBufferDescriptor *vertexBuffer)
@@ -151,15 +192,45 @@ void btDefaultSoftBodySolver::processCollision(btSoftBody *softBody, const btCol
 	softBody->defaultCollisionHandler(collisionObjectWrap);
 }  // btDefaultSoftBodySolver::processCollision
 
+struct btPredictSoftBodyMotionLoop : public btIParallelForBody
+{
+	btAlignedObjectArray<btSoftBody *> &m_softBodySet;
+	btScalar m_timeStep;
+
+	btPredictSoftBodyMotionLoop(btAlignedObjectArray<btSoftBody *> &softBodySet, btScalar timeStep) : m_softBodySet(softBodySet), m_timeStep(timeStep) {}
+
+	void forLoop(int iBegin, int iEnd) const BT_OVERRIDE
+	{
+		for (int i = iBegin; i < iEnd; ++i)
+		{
+			btSoftBody *psb = m_softBodySet[i];
+			if (psb->isActive())
+			{
+				psb->predictMotion(m_timeStep);
+			}
+		}
+	}
+};
+
 void btDefaultSoftBodySolver::predictMotion(btScalar timeStep)
 {
+	BT_PROFILE("btDefaultSoftBodySolver::predictMotion");
+	// The broadphase is not thread safe, the soft bodies leave their aabb update to the serial pass below,
+	// which updates the broadphase in the same order as the sequential loop did
+	for (int i = 0; i < m_softBodySet.size(); ++i)
+	{
+		m_softBodySet[i]->m_bDeferBroadphaseUpdate = true;
+	}
+	btPredictSoftBodyMotionLoop loop(m_softBodySet, timeStep);
+	btSoftBodyParallelFor(0, m_softBodySet.size(), loop);
 	for (int i = 0; i < m_softBodySet.size(); ++i)
 	{
 		btSoftBody *psb = m_softBodySet[i];
-
-		if (psb->isActive())
+		psb->m_bDeferBroadphaseUpdate = false;
+		// only bodies with nodes in their node tree have new bounds
+		if (psb->isActive() && psb->m_ndbvt.m_root)
 		{
-			psb->predictMotion(timeStep);
+			psb->updateBroadphaseAabb();
 		}
 	}
 }
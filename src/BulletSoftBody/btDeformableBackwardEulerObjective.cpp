@@ -18,10 +18,13 @@
 #include "LinearMath/btQuickprof.h"
 
 btDeformableBackwardEulerObjective::btDeformableBackwardEulerObjective(btAlignedObjectArray<btSoftBody*>& softBodies, const TVStack& backup_v)
-	: m_softBodies(softBodies), m_projection(softBodies), m_backupVelocity(backup_v), m_implicit(false)
+	: m_softBodies(softBodies), m_projection(softBodies), m_backupVelocity(backup_v), m_implicit(false), m_useAssembledMatrix(false)
 {
 	m_massPreconditioner = new MassPreconditioner(m_softBodies);
 	m_KKTPreconditioner = new KKTPreconditioner(m_softBodies, m_projection, m_lf, m_dt, m_implicit);
+	m_blockJacobiPreconditioner = new BlockJacobiPreconditioner();
+	m_incompleteCholeskyPreconditioner = new IncompleteCholeskyPreconditioner();
+	m_multigridPreconditioner = new MultigridPreconditioner();
 	m_preconditioner = m_KKTPreconditioner;
 }
 
@@ -29,6 +32,9 @@ btDeformableBackwardEulerObjective::~btDeformableBackwardEulerObjective()
 {
 	delete m_KKTPreconditioner;
 	delete m_massPreconditioner;
+	delete m_blockJacobiPreconditioner;
+	delete m_incompleteCholeskyPreconditioner;
+	delete m_multigridPreconditioner;
 }
 
 void btDeformableBackwardEulerObjective::reinitialize(bool nodeUpdated, btScalar dt)
@@ -69,27 +75,48 @@ void btDeformableBackwardEulerObjective::setDt(btScalar dt)
 void btDeformableBackwardEulerObjective::multiply(const TVStack& x, TVStack& b) const
 {
 	BT_PROFILE("multiply");
-	// add in the mass term
-	size_t counter = 0;
-	for (int i = 0; i < m_softBodies.size(); ++i)
+	if (m_useAssembledMatrix)
 	{
-		btSoftBody* psb = m_softBodies[i];
-		for (int j = 0; j < psb->m_nodes.size(); ++j)
+		btAssert(m_matrix.getNumRows() == m_nodes.size());
+		m_matrix.multiply(x, b);
+		// forces that cannot be assembled are still applied matrix free
+		for (int i = 0; i < m_lf.size(); ++i)
 		{
-			const btSoftBody::Node& node = psb->m_nodes[j];
-			b[counter] = (node.m_im == 0) ? btVector3(0, 0, 0) : x[counter] / node.m_im;
-			++counter;
+			if (m_lf[i]->canAssembleForceDifferential())
+			{
+				continue;
+			}
+			m_lf[i]->addScaledDampingForceDifferential(-m_dt, x, b);
+			if (m_implicit || m_lf[i]->getForceType() == BT_MOUSE_PICKING_FORCE)
+			{
+				m_lf[i]->addScaledElasticForceDifferential(-m_dt * m_dt, x, b);
+			}
 		}
 	}
-
-	for (int i = 0; i < m_lf.size(); ++i)
+	else
 	{
-		// add damping matrix
-		m_lf[i]->addScaledDampingForceDifferential(-m_dt, x, b);
-        // Always integrate picking force implicitly for stability.
-        if (m_implicit || m_lf[i]->getForceType() == BT_MOUSE_PICKING_FORCE)
+		// add in the mass term
+		size_t counter = 0;
+		for (int i = 0; i < m_softBodies.size(); ++i)
 		{
-			m_lf[i]->addScaledElasticForceDifferential(-m_dt * m_dt, x, b);
+			btSoftBody* psb = m_softBodies[i];
+			for (int j = 0; j < psb->m_nodes.size(); ++j)
+			{
+				const btSoftBody::Node& node = psb->m_nodes[j];
+				b[counter] = (node.m_im == 0) ? btVector3(0, 0, 0) : x[counter] / node.m_im;
+				++counter;
+			}
+		}
+
+		for (int i = 0; i < m_lf.size(); ++i)
+		{
+			// add damping matrix
+			m_lf[i]->addScaledDampingForceDifferential(-m_dt, x, b);
+			// Always integrate picking force implicitly for stability.
+			if (m_implicit || m_lf[i]->getForceType() == BT_MOUSE_PICKING_FORCE)
+			{
+				m_lf[i]->addScaledElasticForceDifferential(-m_dt * m_dt, x, b);
+			}
 		}
 	}
 	int offset = m_nodes.size();
@@ -121,6 +148,41 @@ void btDeformableBackwardEulerObjective::multiply(const TVStack& x, TVStack& b)
 	}
 }
 
+void btDeformableBackwardEulerObjective::assembleMatrix()
+{
+	bool buildPreconditioner = m_preconditioner->needsAssembledMatrix();
+	if (!m_useAssembledMatrix && !buildPreconditioner)
+	{
+		return;
+	}
+	BT_PROFILE("assembleMatrix");
+	m_matrix.reset(m_nodes.size());
+	// every row gets a diagonal block, also the ones of nodes with infinite mass
+	for (int i = 0; i < m_nodes.size(); ++i)
+	{
+		const btSoftBody::Node* node = m_nodes[i];
+		btScalar mass = (node->m_im == 0) ? 0 : 1 / node->m_im;
+		m_matrix.addBlock(i, i, btMatrix3x3(mass, 0, 0, 0, mass, 0, 0, 0, mass));
+	}
+	for (int i = 0; i < m_lf.size(); ++i)
+	{
+		if (!m_lf[i]->canAssembleForceDifferential())
+		{
+			continue;
+		}
+		m_lf[i]->addScaledDampingForceDifferentialBlocks(-m_dt, m_matrix);
+		if (m_implicit || m_lf[i]->getForceType() == BT_MOUSE_PICKING_FORCE)
+		{
+			m_lf[i]->addScaledElasticForceDifferentialBlocks(-m_dt * m_dt, m_matrix);
+		}
+	}
+	m_matrix.finalize();
+	if (buildPreconditioner)
+	{
+		m_preconditioner->buildFromMatrix(m_matrix);
+	}
+}
+
 void btDeformableBackwardEulerObjective::updateVelocity(const TVStack& dv)
 {
 	for (int i = 0; i < m_softBodies.size(); ++i)
@@ -25,6 +25,7 @@
 #include "btDeformableNeoHookeanForce.h"
 #include "btDeformableContactProjection.h"
 #include "btPreconditioner.h"
+#include "btDeformableBlockMatrix.h"
 // #include "btDeformableMultiBodyDynamicsWorld.h"
 #include "LinearMath/btQuickprof.h"
 
@@ -34,7 +35,10 @@ public:
 	enum _
 	{
 		Mass_preconditioner,
-		KKT_preconditioner
+		KKT_preconditioner,
+		Block_Jacobi_preconditioner,
+		Incomplete_Cholesky_preconditioner,
+		Multigrid_preconditioner
 	};
 
 	typedef btAlignedObjectArray<btVector3> TVStack;
@@ -48,6 +52,11 @@ public:
 	bool m_implicit;
 	MassPreconditioner* m_massPreconditioner;
 	KKTPreconditioner* m_KKTPreconditioner;
+	BlockJacobiPreconditioner* m_blockJacobiPreconditioner;
+	IncompleteCholeskyPreconditioner* m_incompleteCholeskyPreconditioner;
+	MultigridPreconditioner* m_multigridPreconditioner;
+	bool m_useAssembledMatrix;  // multiply with m_matrix instead of evaluating the force differentials in every iteration
+	btDeformableBlockMatrix m_matrix;
 
 	btDeformableBackwardEulerObjective(btAlignedObjectArray<btSoftBody*>& softBodies, const TVStack& backup_v);
 
@@ -73,6 +82,10 @@ public:
 	// perform A*x = b
 	void multiply(const TVStack& x, TVStack& b) const;
 
+	// assemble the mass and the force differentials that multiply applies into m_matrix and rebuild the
+	// preconditioner from it if it needs one, needs to be called after every change of the state, i.e. once per Newton step
+	void assembleMatrix();
+
 	// set initial guess for CG solve
 	void initialGuess(TVStack& dv, const TVStack& residual);
 
@@ -101,6 +114,19 @@ public:
 	void precondition(const TVStack& x, TVStack& b)
 	{
 		m_preconditioner->operator()(x, b);
+		if (m_preconditioner->needsAssembledMatrix())
+		{
+			// the block preconditioners couple the directions of a node, keep b in the constrained space
+			// like the mass preconditioner does
+			for (int i = 0; i < m_nodes.size(); ++i)
+			{
+				if (m_nodes[i]->m_im == 0)
+				{
+					b[i].setZero();
+				}
+			}
+			m_projection.project(b);
+		}
 	}
 
 	// reindex all the vertices
@@ -136,6 +162,11 @@ public:
 		m_implicit = implicit;
 	}
 
+	void setUseAssembledMatrix(bool useAssembledMatrix)
+	{
+		m_useAssembledMatrix = useAssembledMatrix;
+	}
+
 	// Calculate the total potential energy in the system
 	btScalar totalEnergy(btScalar dt);
 
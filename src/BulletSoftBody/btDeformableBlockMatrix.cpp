@@ -0,0 +1,210 @@
+/*
+ Bullet Continuous Collision Detection and Physics Library
+ Copyright (c) 2019 Google Inc. http://bulletphysics.org
+ This software is provided 'as-is', without any express or implied warranty.
+ In no event will the authors be held liable for any damages arising from the use of this software.
+ Permission is granted to anyone to use this software for any purpose,
+ including commercial applications, and to alter it and redistribute it freely,
+ subject to the following restrictions:
+ 1. The origin of this software must not be misrepresented; you must not claim that you wrote the original software. If you use this software in a product, an acknowledgment in the product documentation would be appreciated but is not required.
+ 2. Altered source versions must be plainly marked as such, and must not be misrepresented as being the original software.
+ 3. This notice may not be removed or altered from any source distribution.
+ */
+
+#include "btDeformableBlockMatrix.h"
+#include "LinearMath/btThreads.h"
+#include "LinearMath/btQuickprof.h"
+
+static const int kBlockRowGrainSize = 256;
+
+// Runs a loop over block rows in btParallelFor tasks, or inline for small matrices and without a task scheduler
+static void btBlockRowParallelFor(int iBegin, int iEnd, const btIParallelForBody& body)
+{
+#if BT_THREADSAFE
+	if (iEnd - iBegin > kBlockRowGrainSize && btGetTaskScheduler())
+	{
+		btParallelFor(iBegin, iEnd, kBlockRowGrainSize, body);
+		return;
+	}
+#endif
+	body.forLoop(iBegin, iEnd);
+}
+
+struct btSortBlockRowsLoop : public btIParallelForBody
+{
+	btDeformableBlockMatrix* m_matrix;
+
+	btSortBlockRowsLoop(btDeformableBlockMatrix* matrix) : m_matrix(matrix) {}
+
+	void forLoop(int iBegin, int iEnd) const BT_OVERRIDE
+	{
+		m_matrix->internalSortRows(iBegin, iEnd);
+	}
+};
+
+struct btMultiplyBlockRowsLoop : public btIParallelForBody
+{
+	const btDeformableBlockMatrix* m_matrix;
+	const btDeformableBlockMatrix::TVStack& m_x;
+	btDeformableBlockMatrix::TVStack& m_b;
+
+	btMultiplyBlockRowsLoop(const btDeformableBlockMatrix* matrix, const btDeformableBlockMatrix::TVStack& x, btDeformableBlockMatrix::TVStack& b)
+		: m_matrix(matrix), m_x(x), m_b(b) {}
+
+	void forLoop(int iBegin, int iEnd) const BT_OVERRIDE
+	{
+		m_matrix->internalMultiply(m_x, m_b, iBegin, iEnd);
+	}
+};
+
+btDeformableBlockMatrix::btDeformableBlockMatrix()
+	: m_numRows(0)
+{
+	m_rowOffsets.push_back(0);
+}
+
+void btDeformableBlockMatrix::reset(int numRows)
+{
+	m_numRows = numRows;
+	m_tripletRows.resizeNoInitialize(0);
+	m_tripletCols.resizeNoInitialize(0);
+	m_tripletBlocks.resizeNoInitialize(0);
+	m_cols.resizeNoInitialize(0);
+	m_blocks.resizeNoInitialize(0);
+	m_rowOffsets.resize(numRows + 1);
+	m_diagonal.resize(numRows);
+	for (int i = 0; i <= numRows; ++i)
+	{
+		m_rowOffsets[i] = 0;
+	}
+	for (int i = 0; i < numRows; ++i)
+	{
+		m_diagonal[i] = -1;
+	}
+}
+
+void btDeformableBlockMatrix::finalize()
+{
+	BT_PROFILE("btDeformableBlockMatrix::finalize");
+	int numTriplets = m_tripletRows.size();
+
+	// bucket the triplets by row, keeping the order they were added in within a row
+	m_rowCounts.resize(m_numRows);
+	for (int i = 0; i < m_numRows; ++i)
+	{
+		m_rowCounts[i] = 0;
+	}
+	for (int i = 0; i < numTriplets; ++i)
+	{
+		m_rowCounts[m_tripletRows[i]]++;
+	}
+	int offset = 0;
+	for (int i = 0; i < m_numRows; ++i)
+	{
+		m_rowOffsets[i] = offset;
+		offset += m_rowCounts[i];
+		m_rowCounts[i] = m_rowOffsets[i];
+	}
+	m_rowOffsets[m_numRows] = offset;
+	m_tripletOrder.resizeNoInitialize(numTriplets);
+	for (int i = 0; i < numTriplets; ++i)
+	{
+		m_tripletOrder[m_rowCounts[m_tripletRows[i]]++] = i;
+	}
+
+	// sort and merge each row in place of its bucket
+	m_cols.resizeNoInitialize(numTriplets);
+	m_blocks.resizeNoInitialize(numTriplets);
+	btSortBlockRowsLoop loop(this);
+	btBlockRowParallelFor(0, m_numRows, loop);
+
+	// close the gaps left by merged duplicates
+	int numBlocks = 0;
+	for (int i = 0; i < m_numRows; ++i)
+	{
+		int begin = m_rowOffsets[i];
+		int count = m_rowCounts[i];
+		if (begin != numBlocks)
+		{
+			for (int k = 0; k < count; ++k)
+			{
+				m_cols[numBlocks + k] = m_cols[begin + k];
+				m_blocks[numBlocks + k] = m_blocks[begin + k];
+			}
+			if (m_diagonal[i] >= 0)
+			{
+				m_diagonal[i] -= begin - numBlocks;
+			}
+		}
+		m_rowOffsets[i] = numBlocks;
+		numBlocks += count;
+	}
+	m_rowOffsets[m_numRows] = numBlocks;
+	m_cols.resizeNoInitialize(numBlocks);
+	m_blocks.resizeNoInitialize(numBlocks);
+}
+
+void btDeformableBlockMatrix::internalSortRows(int iBegin, int iEnd)
+{
+	for (int row = iBegin; row < iEnd; ++row)
+	{
+		int begin = m_rowOffsets[row];
+		int end = m_rowOffsets[row + 1];
+		// rows are short, a stable insertion sort keeps duplicates in the order they were added
+		for (int i = begin + 1; i < end; ++i)
+		{
+			int triplet = m_tripletOrder[i];
+			int col = m_tripletCols[triplet];
+			int j = i - 1;
+			while (j >= begin && m_tripletCols[m_tripletOrder[j]] > col)
+			{
+				m_tripletOrder[j + 1] = m_tripletOrder[j];
+				--j;
+			}
+			m_tripletOrder[j + 1] = triplet;
+		}
+		int count = 0;
+		m_diagonal[row] = -1;
+		for (int i = begin; i < end; ++i)
+		{
+			int triplet = m_tripletOrder[i];
+			int col = m_tripletCols[triplet];
+			if (count > 0 && m_cols[begin + count - 1] == col)
+			{
+				m_blocks[begin + count - 1] += m_tripletBlocks[triplet];
+			}
+			else
+			{
+				if (col == row)
+				{
+					m_diagonal[row] = begin + count;
+				}
+				m_cols[begin + count] = col;
+				m_blocks[begin + count] = m_tripletBlocks[triplet];
+				++count;
+			}
+		}
+		m_rowCounts[row] = count;
+	}
+}
+
+void btDeformableBlockMatrix::multiply(const TVStack& x, TVStack& b) const
+{
+	BT_PROFILE("btDeformableBlockMatrix::multiply");
+	btAssert(x.size() >= m_numRows && b.size() >= m_numRows);
+	btMultiplyBlockRowsLoop loop(this, x, b);
+	btBlockRowParallelFor(0, m_numRows, loop);
+}
+
+void btDeformableBlockMatrix::internalMultiply(const TVStack& x, TVStack& b, int iBegin, int iEnd) const
+{
+	for (int row = iBegin; row < iEnd; ++row)
+	{
+		btVector3 sum(0, 0, 0);
+		for (int k = m_rowOffsets[row]; k < m_rowOffsets[row + 1]; ++k)
+		{
+			sum += m_blocks[k] * x[m_cols[k]];
+		}
+		b[row] = sum;
+	}
+}
@@ -0,0 +1,96 @@
+/*
+ Bullet Continuous Collision Detection and Physics Library
+ Copyright (c) 2019 Google Inc. http://bulletphysics.org
+ This software is provided 'as-is', without any express or implied warranty.
+ In no event will the authors be held liable for any damages arising from the use of this software.
+ Permission is granted to anyone to use this software for any purpose,
+ including commercial applications, and to alter it and redistribute it freely,
+ subject to the following restrictions:
+ 1. The origin of this software must not be misrepresented; you must not claim that you wrote the original software. If you use this software in a product, an acknowledgment in the product documentation would be appreciated but is not required.
+ 2. Altered source versions must be plainly marked as such, and must not be misrepresented as being the original software.
+ 3. This notice may not be removed or altered from any source distribution.
+ */
+
+#ifndef BT_DEFORMABLE_BLOCK_MATRIX_H
+#define BT_DEFORMABLE_BLOCK_MATRIX_H
+
+#include "LinearMath/btAlignedObjectArray.h"
+#include "LinearMath/btMatrix3x3.h"
+
+// A square sparse matrix of 3x3 blocks in compressed row storage, one block row per deformable node.
+// Blocks are added as (row, column, block) triplets, finalize() sorts them into rows and sums the duplicates
+// in the order they were added, so the assembled matrix does not depend on the number of threads.
+class btDeformableBlockMatrix
+{
+public:
+	typedef btAlignedObjectArray<btVector3> TVStack;
+
+	btDeformableBlockMatrix();
+
+	// remove all blocks and resize to numRows x numRows blocks
+	void reset(int numRows);
+
+	// add a block, blocks at the same position are summed by finalize()
+	void addBlock(int row, int col, const btMatrix3x3& block)
+	{
+		btAssert(row >= 0 && row < m_numRows && col >= 0 && col < m_numRows);
+		m_tripletRows.push_back(row);
+		m_tripletCols.push_back(col);
+		m_tripletBlocks.push_back(block);
+	}
+
+	// build the compressed rows from the blocks added since reset()
+	void finalize();
+
+	// b = A * x for the first getNumRows() entries of b
+	void multiply(const TVStack& x, TVStack& b) const;
+
+	int getNumRows() const
+	{
+		return m_numRows;
+	}
+
+	int getNumBlocks() const
+	{
+		return m_blocks.size();
+	}
+
+	// blocks of row i are stored in [getRowBegin(i), getRowBegin(i + 1)), sorted by column
+	int getRowBegin(int row) const
+	{
+		return m_rowOffsets[row];
+	}
+
+	int getColumn(int index) const
+	{
+		return m_cols[index];
+	}
+
+	const btMatrix3x3& getBlock(int index) const
+	{
+		return m_blocks[index];
+	}
+
+	// index of the diagonal block of a row, or -1 if the row has none
+	int getDiagonalIndex(int row) const
+	{
+		return m_diagonal[row];
+	}
+
+	void internalSortRows(int iBegin, int iEnd);
+	void internalMultiply(const TVStack& x, TVStack& b, int iBegin, int iEnd) const;
+
+private:
+	int m_numRows;
+	btAlignedObjectArray<int> m_tripletRows;
+	btAlignedObjectArray<int> m_tripletCols;
+	btAlignedObjectArray<btMatrix3x3> m_tripletBlocks;
+	btAlignedObjectArray<int> m_tripletOrder;  // triplet indices bucketed by row
+	btAlignedObjectArray<int> m_rowCounts;     // number of distinct columns per row
+	btAlignedObjectArray<int> m_rowOffsets;
+	btAlignedObjectArray<int> m_cols;
+	btAlignedObjectArray<btMatrix3x3> m_blocks;
+	btAlignedObjectArray<int> m_diagonal;
+};
+
+#endif  //BT_DEFORMABLE_BLOCK_MATRIX_H
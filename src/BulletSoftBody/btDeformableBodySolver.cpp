@@ -20,7 +20,7 @@
 #include "LinearMath/btQuickprof.h"
 static const int kMaxConjugateGradientIterations = 300;
 btDeformableBodySolver::btDeformableBodySolver()
-	: m_numNodes(0), m_cg(kMaxConjugateGradientIterations), m_cr(kMaxConjugateGradientIterations), m_maxNewtonIterations(1), m_newtonTolerance(1e-4), m_lineSearch(false), m_useProjection(false)
+	: m_numNodes(0), m_cg(kMaxConjugateGradientIterations), m_cr(kMaxConjugateGradientIterations), m_maxNewtonIterations(1), m_newtonTolerance(1e-4), m_lineSearch(false), m_preconditionerOverride(-1), m_numKrylovIterations(0), m_numKrylovSolves(0), m_useProjection(false)
 {
 	m_objective = new btDeformableBackwardEulerObjective(m_softBodies, m_backupVelocity);
 	m_reducedSolver = false;
@@ -165,7 +165,9 @@ void btDeformableBodySolver::updateEnergy(btScalar scale)
 
 btScalar btDeformableBodySolver::computeDescentStep(TVStack& ddv, const TVStack& residual, bool verbose)
 {
-	m_cg.solve(*m_objective, ddv, residual, false);
+	m_objective->assembleMatrix();
+	m_numKrylovIterations += m_cg.solve(*m_objective, ddv, residual, false);
+	++m_numKrylovSolves;
 	btScalar inner_product = m_cg.dot(residual, m_ddv);
 	btScalar res_norm = m_objective->computeNorm(residual);
 	btScalar tol = 1e-5 * res_norm * m_objective->computeNorm(m_ddv);
@@ -213,10 +215,12 @@ void btDeformableBodySolver::updateDv(btScalar scale)
 
 void btDeformableBodySolver::computeStep(TVStack& ddv, const TVStack& residual)
 {
+	m_objective->assembleMatrix();
 	if (m_useProjection)
-		m_cg.solve(*m_objective, ddv, residual, false);
+		m_numKrylovIterations += m_cg.solve(*m_objective, ddv, residual, false);
 	else
-		m_cr.solve(*m_objective, ddv, residual, false);
+		m_numKrylovIterations += m_cr.solve(*m_objective, ddv, residual, false);
+	++m_numKrylovSolves;
 }
 
 void btDeformableBodySolver::reinitialize(const btAlignedObjectArray<btSoftBody*>& softBodies, btScalar dt)
@@ -47,6 +47,9 @@ protected:
 	btScalar m_newtonTolerance;                                    // stop newton iterations if f(x) < m_newtonTolerance
 	bool m_lineSearch;                                             // If true, use newton's method with line search under implicit scheme
 	bool m_reducedSolver;																					 // flag for reduced soft body solver
+	int m_preconditionerOverride;                                  // preconditioner chosen with setPreconditionerOverride, -1 for the default of the world
+	int m_numKrylovIterations;                                     // CG/CR iterations since resetKrylovStatistics
+	int m_numKrylovSolves;                                         // CG/CR solves since resetKrylovStatistics
 public:
 	// handles data related to objective function
 	btDeformableBackwardEulerObjective* m_objective;
@@ -180,13 +183,65 @@ public:
 			case btDeformableBackwardEulerObjective::KKT_preconditioner:
 				m_objective->m_preconditioner = m_objective->m_KKTPreconditioner;
 				break;
-			
+
+			case btDeformableBackwardEulerObjective::Block_Jacobi_preconditioner:
+				m_objective->m_preconditioner = m_objective->m_blockJacobiPreconditioner;
+				break;
+
+			case btDeformableBackwardEulerObjective::Incomplete_Cholesky_preconditioner:
+				m_objective->m_preconditioner = m_objective->m_incompleteCholeskyPreconditioner;
+				break;
+
+			case btDeformableBackwardEulerObjective::Multigrid_preconditioner:
+				m_objective->m_preconditioner = m_objective->m_multigridPreconditioner;
+				break;
+
 			default:
 				btAssert(false);
 				break;
 		}
 	}
 
+	// Use the given preconditioner instead of the one btDeformableMultiBodyDynamicsWorld picks every step
+	// (mass with projection, KKT with Lagrange multipliers), -1 restores the default.
+	// Block Jacobi, incomplete Cholesky and multigrid are built from the assembled matrix of every Newton step.
+	virtual void setPreconditionerOverride(int opt)
+	{
+		m_preconditionerOverride = opt;
+		if (opt >= 0)
+		{
+			setPreconditioner(opt);
+		}
+	}
+
+	int getPreconditionerOverride() const
+	{
+		return m_preconditionerOverride;
+	}
+
+	int getNumKrylovIterations() const
+	{
+		return m_numKrylovIterations;
+	}
+
+	int getNumKrylovSolves() const
+	{
+		return m_numKrylovSolves;
+	}
+
+	void resetKrylovStatistics()
+	{
+		m_numKrylovIterations = 0;
+		m_numKrylovSolves = 0;
+	}
+
+	// If true, the mass and the force differentials are assembled into a sparse block matrix once per Newton step
+	// and the Krylov iterations multiply with it, instead of evaluating every force in every iteration
+	virtual void setUseAssembledMatrix(bool useAssembledMatrix)
+	{
+		m_objective->setUseAssembledMatrix(useAssembledMatrix);
+	}
+
 	virtual btAlignedObjectArray<btDeformableLagrangianForce*>* getLagrangianForceArray()
 	{
 		return &(m_objective->m_lf);
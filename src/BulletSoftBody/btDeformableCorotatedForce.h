@@ -115,6 +115,12 @@ public:
 
 	virtual void buildDampingForceDifferentialDiagonal(btScalar scale, TVStack& diagA) {}
 
+	// the differentials are zero, so there are no blocks to add
+	virtual bool canAssembleForceDifferential()
+	{
+		return true;
+	}
+
 	virtual btDeformableLagrangianForceType getForceType()
 	{
 		return BT_COROTATED_FORCE;
@@ -52,6 +52,12 @@ public:
 
 	virtual void buildDampingForceDifferentialDiagonal(btScalar scale, TVStack& diagA) {}
 
+	// the differentials are zero, so there are no blocks to add
+	virtual bool canAssembleForceDifferential()
+	{
+		return true;
+	}
+
 	virtual void addScaledGravityForce(btScalar scale, TVStack& force)
 	{
 		int numNodes = getNumNodes();
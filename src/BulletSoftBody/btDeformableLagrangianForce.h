@@ -17,6 +17,7 @@
 #define BT_DEFORMABLE_LAGRANGIAN_FORCE_H
 
 #include "btSoftBody.h"
+#include "btDeformableBlockMatrix.h"
 #include <LinearMath/btHashMap.h>
 #include <iostream>
 
@@ -68,6 +69,19 @@ public:
 
 	virtual void addScaledHessian(btScalar scale) {}
 
+	// true if the force differentials can be added to an assembled matrix with the two functions below,
+	// otherwise the objective keeps applying them matrix free when the assembled matrix is used
+	virtual bool canAssembleForceDifferential()
+	{
+		return false;
+	}
+
+	// add the blocks of the scaled damping force differential to A
+	virtual void addScaledDampingForceDifferentialBlocks(btScalar scale, btDeformableBlockMatrix& A) {}
+
+	// add the blocks of the scaled elastic force differential to A
+	virtual void addScaledElasticForceDifferentialBlocks(btScalar scale, btDeformableBlockMatrix& A) {}
+
 	virtual btDeformableLagrangianForceType getForceType() = 0;
 
 	virtual void reinitialize(bool nodeUpdated)
@@ -110,6 +124,53 @@ public:
 		return btMatrix3x3(c1, c2, c3).transpose();
 	}
 
+	// Add the 16 blocks of the scaled force differential of a tetrahedron to A.
+	// dPdF[3 * r + c] is the stress differential for a unit change of the deformation gradient entry F[r][c].
+	// Corotated forces pass the rotation R, their dF is R^T * dDs * Dm^-1 and their force R * dP * Dm^-T.
+	void addScaledTetraDifferentialBlocks(btScalar scale, const btSoftBody::Tetra& tetra, const btMatrix3x3* dPdF, btDeformableBlockMatrix& A, const btMatrix3x3* corotation = 0)
+	{
+		// a unit change of node b along axis e changes F by (R^T e) * h_b^T, and the force on node a is -R * dP * h_a
+		const btMatrix3x3& Dm_inverse = tetra.m_Dm_inverse;
+		btVector3 h[4];
+		h[1] = Dm_inverse[0];
+		h[2] = Dm_inverse[1];
+		h[3] = Dm_inverse[2];
+		h[0] = -(h[1] + h[2] + h[3]);
+		btScalar scale1 = -scale * tetra.m_element_measure;
+		btMatrix3x3 blocks[4][4];
+		for (int b = 0; b < 4; ++b)
+		{
+			btMatrix3x3 G[3];
+			for (int r = 0; r < 3; ++r)
+			{
+				G[r] = dPdF[3 * r] * h[b][0] + dPdF[3 * r + 1] * h[b][1] + dPdF[3 * r + 2] * h[b][2];
+			}
+			for (int e = 0; e < 3; ++e)
+			{
+				btMatrix3x3 dP = corotation ? G[0] * (*corotation)[e][0] + G[1] * (*corotation)[e][1] + G[2] * (*corotation)[e][2] : G[e];
+				for (int a = 0; a < 4; ++a)
+				{
+					btVector3 df = dP * h[a];
+					if (corotation)
+					{
+						df = *corotation * df;
+					}
+					df *= scale1;
+					blocks[a][b][0][e] = df[0];
+					blocks[a][b][1][e] = df[1];
+					blocks[a][b][2][e] = df[2];
+				}
+			}
+		}
+		for (int a = 0; a < 4; ++a)
+		{
+			for (int b = 0; b < 4; ++b)
+			{
+				A.addBlock(tetra.m_n[a]->index, tetra.m_n[b]->index, blocks[a][b]);
+			}
+		}
+	}
+
 	// Calculate the incremental deformable generated from the current velocity
 	virtual btMatrix3x3 DsFromVelocity(const btSoftBody::Node* n0, const btSoftBody::Node* n1, const btSoftBody::Node* n2, const btSoftBody::Node* n3)
 	{
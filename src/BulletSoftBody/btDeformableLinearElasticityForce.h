@@ -387,6 +387,73 @@ public:
 		}
 	}
 
+	virtual bool canAssembleForceDifferential()
+	{
+		return true;
+	}
+
+	virtual void addScaledDampingForceDifferentialBlocks(btScalar scale, btDeformableBlockMatrix& A)
+	{
+		if (m_damping_alpha == 0 && m_damping_beta == 0)
+			return;
+		btScalar mu_damp = m_damping_beta * m_mu;
+		btScalar lambda_damp = m_damping_beta * m_lambda;
+		// the damping stress is linear in dF and the same for every tetrahedron
+		btMatrix3x3 dPdF[9];
+		for (int k = 0; k < 9; ++k)
+		{
+			btMatrix3x3 dF(0, 0, 0, 0, 0, 0, 0, 0, 0);
+			dF[k / 3][k % 3] = 1;
+			dPdF[k] = (dF + dF.transpose()) * mu_damp + btMatrix3x3::getIdentity() * ((dF[0][0] + dF[1][1] + dF[2][2]) * lambda_damp);
+		}
+		for (int i = 0; i < m_softBodies.size(); ++i)
+		{
+			btSoftBody* psb = m_softBodies[i];
+			if (!psb->isActive())
+			{
+				continue;
+			}
+			for (int j = 0; j < psb->m_tetras.size(); ++j)
+			{
+				bool close_to_flat = (psb->m_tetraScratches[j].m_J < TETRA_FLAT_THRESHOLD);
+				addScaledTetraDifferentialBlocks(scale, psb->m_tetras[j], dPdF, A, close_to_flat ? 0 : &psb->m_tetraScratches[j].m_corotation);
+			}
+			for (int j = 0; j < psb->m_nodes.size(); ++j)
+			{
+				const btSoftBody::Node& node = psb->m_nodes[j];
+				if (node.m_im > 0)
+				{
+					btScalar d = -scale / node.m_im * m_damping_alpha;
+					A.addBlock(node.index, node.index, btMatrix3x3(d, 0, 0, 0, d, 0, 0, 0, d));
+				}
+			}
+		}
+	}
+
+	virtual void addScaledElasticForceDifferentialBlocks(btScalar scale, btDeformableBlockMatrix& A)
+	{
+		// the stress is linear in the corotated dF and the same for every tetrahedron
+		btMatrix3x3 dPdF[9];
+		for (int k = 0; k < 9; ++k)
+		{
+			btMatrix3x3 dF(0, 0, 0, 0, 0, 0, 0, 0, 0);
+			dF[k / 3][k % 3] = 1;
+			dPdF[k] = (dF + dF.transpose()) * m_mu + btMatrix3x3::getIdentity() * m_lambda * (dF[0][0] + dF[1][1] + dF[2][2]);
+		}
+		for (int i = 0; i < m_softBodies.size(); ++i)
+		{
+			btSoftBody* psb = m_softBodies[i];
+			if (!psb->isActive())
+			{
+				continue;
+			}
+			for (int j = 0; j < psb->m_tetras.size(); ++j)
+			{
+				addScaledTetraDifferentialBlocks(scale, psb->m_tetras[j], dPdF, A, &psb->m_tetraScratches[j].m_corotation);
+			}
+		}
+	}
+
 	void firstPiola(const btSoftBody::TetraScratch& s, btMatrix3x3& P)
 	{
 		btMatrix3x3 corotated_F = s.m_corotation.transpose() * s.m_F;
@@ -17,6 +17,7 @@
 #define BT_MASS_SPRING_H
 
 #include "btDeformableLagrangianForce.h"
+#include "btSoftBodyInternals.h"
 
 class btDeformableMassSpringForce : public btDeformableLagrangianForce
 {
@@ -292,6 +293,81 @@ public:
 		}
 	}
 
+	virtual bool canAssembleForceDifferential()
+	{
+		return true;
+	}
+
+	virtual void addScaledDampingForceDifferentialBlocks(btScalar scale, btDeformableBlockMatrix& A)
+	{
+		btMatrix3x3 I;
+		I.setIdentity();
+		for (int i = 0; i < m_softBodies.size(); ++i)
+		{
+			btSoftBody* psb = m_softBodies[i];
+			if (!psb->isActive())
+			{
+				continue;
+			}
+			btScalar scaled_k_damp = m_dampingStiffness * scale;
+			for (int j = 0; j < psb->m_links.size(); ++j)
+			{
+				const btSoftBody::Link& link = psb->m_links[j];
+				btSoftBody::Node* node1 = link.m_n[0];
+				btSoftBody::Node* node2 = link.m_n[1];
+				btMatrix3x3 K = I;
+				if (m_momentum_conserving)
+				{
+					if ((node2->m_x - node1->m_x).norm() > SIMD_EPSILON)
+					{
+						btVector3 dir = (node2->m_x - node1->m_x).normalized();
+						K = OuterProduct(dir, dir);
+					}
+				}
+				// df1 = scaled_k_damp * K * (dv2 - dv1), df2 = -df1
+				A.addBlock(node1->index, node1->index, K * -scaled_k_damp);
+				A.addBlock(node1->index, node2->index, K * scaled_k_damp);
+				A.addBlock(node2->index, node1->index, K * scaled_k_damp);
+				A.addBlock(node2->index, node2->index, K * -scaled_k_damp);
+			}
+		}
+	}
+
+	virtual void addScaledElasticForceDifferentialBlocks(btScalar scale, btDeformableBlockMatrix& A)
+	{
+		btMatrix3x3 I;
+		I.setIdentity();
+		for (int i = 0; i < m_softBodies.size(); ++i)
+		{
+			const btSoftBody* psb = m_softBodies[i];
+			if (!psb->isActive())
+			{
+				continue;
+			}
+			for (int j = 0; j < psb->m_links.size(); ++j)
+			{
+				const btSoftBody::Link& link = psb->m_links[j];
+				btSoftBody::Node* node1 = link.m_n[0];
+				btSoftBody::Node* node2 = link.m_n[1];
+				btVector3 dir = (node1->m_q - node2->m_q);
+				btScalar dir_norm = dir.norm();
+				if (dir_norm <= SIMD_EPSILON)
+				{
+					continue;
+				}
+				btVector3 dir_normalized = dir / dir_norm;
+				btScalar scaled_k = scale * (link.m_bbending ? m_bendingStiffness : m_elasticStiffness);
+				btScalar stretch = (dir_norm - link.m_rl) / dir_norm;
+				// df1 = -scaled_k * K * (dx1 - dx2), df2 = -df1
+				btMatrix3x3 K = OuterProduct(dir_normalized, dir_normalized) * (1 - stretch) + I * stretch;
+				A.addBlock(node1->index, node1->index, K * -scaled_k);
+				A.addBlock(node1->index, node2->index, K * scaled_k);
+				A.addBlock(node2->index, node1->index, K * scaled_k);
+				A.addBlock(node2->index, node2->index, K * -scaled_k);
+			}
+		}
+	}
+
 	virtual btDeformableLagrangianForceType getForceType()
 	{
 		return BT_MASSSPRING_FORCE;
@@ -464,13 +464,19 @@ void btDeformableMultiBodyDynamicsWorld::reinitialize(btScalar timeStep)
 	{
 		m_deformableBodySolver->m_useProjection = true;
 		m_deformableBodySolver->setStrainLimiting(true);
-		m_deformableBodySolver->setPreconditioner(btDeformableBackwardEulerObjective::Mass_preconditioner);
+		if (m_deformableBodySolver->getPreconditionerOverride() < 0)
+		{
+			m_deformableBodySolver->setPreconditioner(btDeformableBackwardEulerObjective::Mass_preconditioner);
+		}
 	}
 	else
 	{
 		m_deformableBodySolver->m_useProjection = false;
 		m_deformableBodySolver->setStrainLimiting(false);
-		m_deformableBodySolver->setPreconditioner(btDeformableBackwardEulerObjective::KKT_preconditioner);
+		if (m_deformableBodySolver->getPreconditionerOverride() < 0)
+		{
+			m_deformableBodySolver->setPreconditioner(btDeformableBackwardEulerObjective::KKT_preconditioner);
+		}
 	}
 }
 
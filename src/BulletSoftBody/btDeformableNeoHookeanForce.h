@@ -355,6 +355,62 @@ public:
 		}
 	}
 
+	virtual bool canAssembleForceDifferential()
+	{
+		return true;
+	}
+
+	virtual void addScaledDampingForceDifferentialBlocks(btScalar scale, btDeformableBlockMatrix& A)
+	{
+		if (m_mu_damp == 0 && m_lambda_damp == 0)
+			return;
+		btMatrix3x3 I;
+		I.setIdentity();
+		// the damping stress is linear in dF and the same for every tetrahedron
+		btMatrix3x3 dPdF[9];
+		for (int k = 0; k < 9; ++k)
+		{
+			btMatrix3x3 dF(0, 0, 0, 0, 0, 0, 0, 0, 0);
+			dF[k / 3][k % 3] = 1;
+			dPdF[k] = (dF + dF.transpose()) * m_mu_damp + I * (dF[0][0] + dF[1][1] + dF[2][2]) * m_lambda_damp;
+		}
+		for (int i = 0; i < m_softBodies.size(); ++i)
+		{
+			btSoftBody* psb = m_softBodies[i];
+			if (!psb->isActive())
+			{
+				continue;
+			}
+			for (int j = 0; j < psb->m_tetras.size(); ++j)
+			{
+				addScaledTetraDifferentialBlocks(scale, psb->m_tetras[j], dPdF, A);
+			}
+		}
+	}
+
+	virtual void addScaledElasticForceDifferentialBlocks(btScalar scale, btDeformableBlockMatrix& A)
+	{
+		btMatrix3x3 dPdF[9];
+		for (int i = 0; i < m_softBodies.size(); ++i)
+		{
+			btSoftBody* psb = m_softBodies[i];
+			if (!psb->isActive())
+			{
+				continue;
+			}
+			for (int j = 0; j < psb->m_tetras.size(); ++j)
+			{
+				for (int k = 0; k < 9; ++k)
+				{
+					btMatrix3x3 dF(0, 0, 0, 0, 0, 0, 0, 0, 0);
+					dF[k / 3][k % 3] = 1;
+					firstPiolaDifferential(psb->m_tetraScratches[j], dF, dPdF[k]);
+				}
+				addScaledTetraDifferentialBlocks(scale, psb->m_tetras[j], dPdF, A);
+			}
+		}
+	}
+
 	void firstPiola(const btSoftBody::TetraScratch& s, btMatrix3x3& P)
 	{
 		btScalar c1 = (m_mu * (1. - 1. / (s.m_trace + 1.)));
@@ -22,6 +22,92 @@
 #include <LinearMath/btVector3.h>
 #include <LinearMath/btScalar.h>
 #include "LinearMath/btQuickprof.h"
+#include "LinearMath/btThreads.h"
+
+// vectors are processed in chunks of this many nodes, dot products sum the chunks in order so the result does not depend on the number of threads
+static const int kKrylovChunkSize = 1024;
+
+// Runs a loop over vector chunks in btParallelFor tasks, or inline for short vectors and without a task scheduler
+static inline void btKrylovParallelFor(int numEntries, const btIParallelForBody& body)
+{
+	int numChunks = (numEntries + kKrylovChunkSize - 1) / kKrylovChunkSize;
+#if BT_THREADSAFE
+	if (numChunks > 1 && btGetTaskScheduler())
+	{
+		btParallelFor(0, numChunks, 1, body);
+		return;
+	}
+#endif
+	body.forLoop(0, numChunks);
+}
+
+struct btKrylovDotLoop : public btIParallelForBody
+{
+	const btAlignedObjectArray<btVector3>& m_a;
+	const btAlignedObjectArray<btVector3>& m_b;
+	btScalar* m_partialSums;
+
+	btKrylovDotLoop(const btAlignedObjectArray<btVector3>& a, const btAlignedObjectArray<btVector3>& b, btScalar* partialSums)
+		: m_a(a), m_b(b), m_partialSums(partialSums) {}
+
+	void forLoop(int iBegin, int iEnd) const BT_OVERRIDE
+	{
+		for (int chunk = iBegin; chunk < iEnd; ++chunk)
+		{
+			int end = btMin(m_a.size(), (chunk + 1) * kKrylovChunkSize);
+			btScalar ans(0);
+			for (int i = chunk * kKrylovChunkSize; i < end; ++i)
+				ans += m_a[i].dot(m_b[i]);
+			m_partialSums[chunk] = ans;
+		}
+	}
+};
+
+struct btKrylovMaxAbsLoop : public btIParallelForBody
+{
+	const btAlignedObjectArray<btVector3>& m_a;
+	btScalar* m_partialMax;
+
+	btKrylovMaxAbsLoop(const btAlignedObjectArray<btVector3>& a, btScalar* partialMax)
+		: m_a(a), m_partialMax(partialMax) {}
+
+	void forLoop(int iBegin, int iEnd) const BT_OVERRIDE
+	{
+		for (int chunk = iBegin; chunk < iEnd; ++chunk)
+		{
+			int end = btMin(m_a.size(), (chunk + 1) * kKrylovChunkSize);
+			btScalar ret = 0;
+			for (int i = chunk * kKrylovChunkSize; i < end; ++i)
+			{
+				for (int d = 0; d < 3; ++d)
+				{
+					ret = btMax(ret, btFabs(m_a[i][d]));
+				}
+			}
+			m_partialMax[chunk] = ret;
+		}
+	}
+};
+
+// result = s * a + t * b
+struct btKrylovLinearCombinationLoop : public btIParallelForBody
+{
+	btScalar m_s;
+	const btAlignedObjectArray<btVector3>& m_a;
+	btScalar m_t;
+	const btAlignedObjectArray<btVector3>& m_b;
+	btAlignedObjectArray<btVector3>& m_result;
+
+	btKrylovLinearCombinationLoop(btScalar s, const btAlignedObjectArray<btVector3>& a, btScalar t, const btAlignedObjectArray<btVector3>& b, btAlignedObjectArray<btVector3>& result)
+		: m_s(s), m_a(a), m_t(t), m_b(b), m_result(result) {}
+
+	void forLoop(int iBegin, int iEnd) const BT_OVERRIDE
+	{
+		int end = btMin(m_a.size(), iEnd * kKrylovChunkSize);
+		for (int i = iBegin * kKrylovChunkSize; i < end; ++i)
+			m_result[i] = m_s * m_a[i] + m_t * m_b[i];
+	}
+};
 
 template <class MatrixX>
 class btKrylovSolver
@@ -31,6 +117,8 @@ class btKrylovSolver
 public:
 	int m_maxIterations;
 	btScalar m_tolerance;
+	btAlignedObjectArray<btScalar> m_partialSums;  // per chunk results of dot and norm
+
 	btKrylovSolver(int maxIterations, btScalar tolerance)
 		: m_maxIterations(maxIterations), m_tolerance(tolerance)
 	{
@@ -48,10 +136,8 @@ public:
 		btAssert(a.size() == b.size());
 		TVStack c;
 		c.resize(a.size());
-		for (int i = 0; i < a.size(); ++i)
-		{
-			c[i] = a[i] - b[i];
-		}
+		btKrylovLinearCombinationLoop loop(1, a, -1, b, c);
+		btKrylovParallelFor(a.size(), loop);
 		return c;
 	}
 
@@ -62,22 +148,46 @@ public:
 
 	virtual SIMD_FORCE_INLINE btScalar norm(const TVStack& a)
 	{
+		int numChunks = (a.size() + kKrylovChunkSize - 1) / kKrylovChunkSize;
 		btScalar ret = 0;
-		for (int i = 0; i < a.size(); ++i)
+		if (numChunks <= 1)
 		{
-			for (int d = 0; d < 3; ++d)
+			for (int i = 0; i < a.size(); ++i)
 			{
-				ret = btMax(ret, btFabs(a[i][d]));
+				for (int d = 0; d < 3; ++d)
+				{
+					ret = btMax(ret, btFabs(a[i][d]));
+				}
 			}
+			return ret;
+		}
+		m_partialSums.resizeNoInitialize(numChunks);
+		btKrylovMaxAbsLoop loop(a, &m_partialSums[0]);
+		btKrylovParallelFor(a.size(), loop);
+		for (int i = 0; i < numChunks; ++i)
+		{
+			ret = btMax(ret, m_partialSums[i]);
 		}
 		return ret;
 	}
 
 	virtual SIMD_FORCE_INLINE btScalar dot(const TVStack& a, const TVStack& b)
 	{
+		btAssert(a.size() == b.size());
+		int numChunks = (a.size() + kKrylovChunkSize - 1) / kKrylovChunkSize;
+		if (numChunks <= 1)
+		{
+			btScalar ans(0);
+			for (int i = 0; i < a.size(); ++i)
+				ans += a[i].dot(b[i]);
+			return ans;
+		}
+		m_partialSums.resizeNoInitialize(numChunks);
+		btKrylovDotLoop loop(a, b, &m_partialSums[0]);
+		btKrylovParallelFor(a.size(), loop);
 		btScalar ans(0);
-		for (int i = 0; i < a.size(); ++i)
-			ans += a[i].dot(b[i]);
+		for (int i = 0; i < numChunks; ++i)
+			ans += m_partialSums[i];
 		return ans;
 	}
 
@@ -85,8 +195,8 @@ public:
 	{
 		//        result += s*a
 		btAssert(a.size() == result.size());
-		for (int i = 0; i < a.size(); ++i)
-			result[i] += s * a[i];
+		btKrylovLinearCombinationLoop loop(1, result, s, a, result);
+		btKrylovParallelFor(a.size(), loop);
 	}
 
 	virtual SIMD_FORCE_INLINE TVStack multAndAdd(btScalar s, const TVStack& a, const TVStack& b)
@@ -94,11 +204,19 @@ public:
 		// result = a*s + b
 		TVStack result;
 		result.resize(a.size());
-		for (int i = 0; i < a.size(); ++i)
-			result[i] = s * a[i] + b[i];
+		btKrylovLinearCombinationLoop loop(s, a, 1, b, result);
+		btKrylovParallelFor(a.size(), loop);
 		return result;
 	}
 
+	virtual SIMD_FORCE_INLINE void scaleAndAddTo(btScalar s, TVStack& a, const TVStack& b)
+	{
+		// a = a*s + b, without the temporary of multAndAdd
+		btAssert(a.size() == b.size());
+		btKrylovLinearCombinationLoop loop(s, a, 1, b, a);
+		btKrylovParallelFor(a.size(), loop);
+	}
+
 	virtual SIMD_FORCE_INLINE void setTolerance(btScalar tolerance)
 	{
 		m_tolerance = tolerance;
@@ -0,0 +1,457 @@
+/*
+ Bullet Continuous Collision Detection and Physics Library
+ Copyright (c) 2019 Google Inc. http://bulletphysics.org
+ This software is provided 'as-is', without any express or implied warranty.
+ In no event will the authors be held liable for any damages arising from the use of this software.
+ Permission is granted to anyone to use this software for any purpose,
+ including commercial applications, and to alter it and redistribute it freely,
+ subject to the following restrictions:
+ 1. The origin of this software must not be misrepresented; you must not claim that you wrote the original software. If you use this software in a product, an acknowledgment in the product documentation would be appreciated but is not required.
+ 2. Altered source versions must be plainly marked as such, and must not be misrepresented as being the original software.
+ 3. This notice may not be removed or altered from any source distribution.
+ */
+
+#include "btDeformableLagrangianForce.h"
+#include "btDeformableContactProjection.h"
+#include "btPreconditioner.h"
+#include "LinearMath/btThreads.h"
+#include "LinearMath/btQuickprof.h"
+
+static const int kPreconditionerGrainSize = 256;
+
+// Runs a loop over nodes in btParallelFor tasks, or inline for small systems and without a task scheduler
+static void btPreconditionerParallelFor(int iBegin, int iEnd, const btIParallelForBody& body)
+{
+#if BT_THREADSAFE
+	if (iEnd - iBegin > kPreconditionerGrainSize && btGetTaskScheduler())
+	{
+		btParallelFor(iBegin, iEnd, kPreconditionerGrainSize, body);
+		return;
+	}
+#endif
+	body.forLoop(iBegin, iEnd);
+}
+
+// Inverts a block if its leading principal minors are positive
+static bool btInvertPositiveDefinite(const btMatrix3x3& m, btMatrix3x3& inverse)
+{
+	btScalar s = 0;
+	for (int r = 0; r < 3; ++r)
+	{
+		for (int c = 0; c < 3; ++c)
+		{
+			s = btMax(s, btFabs(m[r][c]));
+		}
+	}
+	btScalar eps = SIMD_EPSILON * s;
+	if (!(m[0][0] > eps) || !(m[0][0] * m[1][1] - m[0][1] * m[1][0] > eps * s) || !(m.determinant() > eps * s * s))
+	{
+		return false;
+	}
+	inverse = m.inverse();
+	return true;
+}
+
+// Inverse of a diagonal block. A block that is not positive definite falls back to the inverse of its
+// diagonal entries, so the preconditioner stays positive for CG.
+static btMatrix3x3 btPreconditionerBlockInverse(const btMatrix3x3& m)
+{
+	btMatrix3x3 inverse;
+	if (btInvertPositiveDefinite(m, inverse))
+	{
+		return inverse;
+	}
+	inverse.setValue(0, 0, 0, 0, 0, 0, 0, 0, 0);
+	for (int d = 0; d < 3; ++d)
+	{
+		btScalar a = btFabs(m[d][d]);
+		inverse[d][d] = (a > SIMD_EPSILON) ? 1 / a : 0;
+	}
+	return inverse;
+}
+
+struct btBlockJacobiBuildLoop : public btIParallelForBody
+{
+	BlockJacobiPreconditioner* m_preconditioner;
+	const btDeformableBlockMatrix& m_A;
+
+	btBlockJacobiBuildLoop(BlockJacobiPreconditioner* preconditioner, const btDeformableBlockMatrix& A)
+		: m_preconditioner(preconditioner), m_A(A) {}
+
+	void forLoop(int iBegin, int iEnd) const BT_OVERRIDE
+	{
+		m_preconditioner->internalBuild(m_A, iBegin, iEnd);
+	}
+};
+
+struct btBlockJacobiApplyLoop : public btIParallelForBody
+{
+	const BlockJacobiPreconditioner* m_preconditioner;
+	const Preconditioner::TVStack& m_x;
+	Preconditioner::TVStack& m_b;
+
+	btBlockJacobiApplyLoop(const BlockJacobiPreconditioner* preconditioner, const Preconditioner::TVStack& x, Preconditioner::TVStack& b)
+		: m_preconditioner(preconditioner), m_x(x), m_b(b) {}
+
+	void forLoop(int iBegin, int iEnd) const BT_OVERRIDE
+	{
+		m_preconditioner->internalApply(m_x, m_b, iBegin, iEnd);
+	}
+};
+
+void BlockJacobiPreconditioner::buildFromMatrix(const btDeformableBlockMatrix& A)
+{
+	BT_PROFILE("BlockJacobiPreconditioner::buildFromMatrix");
+	m_inverseDiagonal.resizeNoInitialize(A.getNumRows());
+	btBlockJacobiBuildLoop loop(this, A);
+	btPreconditionerParallelFor(0, A.getNumRows(), loop);
+}
+
+void BlockJacobiPreconditioner::internalBuild(const btDeformableBlockMatrix& A, int iBegin, int iEnd)
+{
+	for (int i = iBegin; i < iEnd; ++i)
+	{
+		int diagonal = A.getDiagonalIndex(i);
+		if (diagonal < 0)
+		{
+			m_inverseDiagonal[i].setValue(0, 0, 0, 0, 0, 0, 0, 0, 0);
+		}
+		else
+		{
+			m_inverseDiagonal[i] = btPreconditionerBlockInverse(A.getBlock(diagonal));
+		}
+	}
+}
+
+void BlockJacobiPreconditioner::operator()(const TVStack& x, TVStack& b)
+{
+	btAssert(b.size() == x.size());
+	btAssert(m_inverseDiagonal.size() <= x.size());
+	btBlockJacobiApplyLoop loop(this, x, b);
+	btPreconditionerParallelFor(0, m_inverseDiagonal.size(), loop);
+	for (int i = m_inverseDiagonal.size(); i < b.size(); ++i)
+	{
+		b[i] = x[i];
+	}
+}
+
+void BlockJacobiPreconditioner::internalApply(const TVStack& x, TVStack& b, int iBegin, int iEnd) const
+{
+	for (int i = iBegin; i < iEnd; ++i)
+	{
+		b[i] = m_inverseDiagonal[i] * x[i];
+	}
+}
+
+void IncompleteCholeskyPreconditioner::buildFromMatrix(const btDeformableBlockMatrix& A)
+{
+	BT_PROFILE("IncompleteCholeskyPreconditioner::buildFromMatrix");
+	int numRows = A.getNumRows();
+	int numBlocks = A.getNumBlocks();
+	m_rowOffsets.resizeNoInitialize(numRows + 1);
+	m_diagonal.resizeNoInitialize(numRows);
+	m_cols.resizeNoInitialize(numBlocks);
+	m_factor.resizeNoInitialize(numBlocks);
+	m_inverseDiagonal.resizeNoInitialize(numRows);
+	for (int i = 0; i <= numRows; ++i)
+	{
+		m_rowOffsets[i] = A.getRowBegin(i);
+	}
+	for (int i = 0; i < numRows; ++i)
+	{
+		m_diagonal[i] = A.getDiagonalIndex(i);
+		btAssert(m_diagonal[i] >= 0);
+	}
+	for (int k = 0; k < numBlocks; ++k)
+	{
+		m_cols[k] = A.getColumn(k);
+		m_factor[k] = A.getBlock(k);
+	}
+
+	// row by row elimination restricted to the pattern of A, which for a symmetric A gives L = U^T * D^-1
+	for (int i = 0; i < numRows; ++i)
+	{
+		int rowEnd = m_rowOffsets[i + 1];
+		for (int p = m_rowOffsets[i]; p < m_diagonal[i]; ++p)
+		{
+			int k = m_cols[p];
+			btMatrix3x3 L_ik = m_factor[p] * m_inverseDiagonal[k];
+			m_factor[p] = L_ik;
+			// subtract L_ik * U_kj from the entries of row i right of column k
+			int q = m_diagonal[k] + 1;
+			int qEnd = m_rowOffsets[k + 1];
+			for (int r = p + 1; r < rowEnd && q < qEnd;)
+			{
+				if (m_cols[r] < m_cols[q])
+				{
+					++r;
+				}
+				else if (m_cols[q] < m_cols[r])
+				{
+					++q;
+				}
+				else
+				{
+					m_factor[r] -= L_ik * m_factor[q];
+					++r;
+					++q;
+				}
+			}
+		}
+		if (!btInvertPositiveDefinite(m_factor[m_diagonal[i]], m_inverseDiagonal[i]))
+		{
+			// the elimination broke down, keep the original pivot
+			m_factor[m_diagonal[i]] = A.getBlock(m_diagonal[i]);
+			m_inverseDiagonal[i] = btPreconditionerBlockInverse(m_factor[m_diagonal[i]]);
+		}
+	}
+}
+
+void IncompleteCholeskyPreconditioner::solve(const TVStack& x, TVStack& b) const
+{
+	int numRows = m_diagonal.size();
+	// L * y = x
+	for (int i = 0; i < numRows; ++i)
+	{
+		btVector3 y = x[i];
+		for (int p = m_rowOffsets[i]; p < m_diagonal[i]; ++p)
+		{
+			y -= m_factor[p] * b[m_cols[p]];
+		}
+		b[i] = y;
+	}
+	// D * L^T * b = y
+	for (int i = numRows - 1; i >= 0; --i)
+	{
+		btVector3 y = b[i];
+		for (int p = m_diagonal[i] + 1; p < m_rowOffsets[i + 1]; ++p)
+		{
+			y -= m_factor[p] * b[m_cols[p]];
+		}
+		b[i] = m_inverseDiagonal[i] * y;
+	}
+}
+
+void IncompleteCholeskyPreconditioner::operator()(const TVStack& x, TVStack& b)
+{
+	BT_PROFILE("IncompleteCholeskyPreconditioner");
+	btAssert(b.size() == x.size());
+	btAssert(m_diagonal.size() <= x.size());
+	solve(x, b);
+	for (int i = m_diagonal.size(); i < b.size(); ++i)
+	{
+		b[i] = x[i];
+	}
+}
+
+struct btMultigridSmoothLoop : public btIParallelForBody
+{
+	MultigridPreconditioner* m_preconditioner;
+	const Preconditioner::TVStack& m_x;
+	Preconditioner::TVStack& m_b;
+
+	btMultigridSmoothLoop(MultigridPreconditioner* preconditioner, const Preconditioner::TVStack& x, Preconditioner::TVStack& b)
+		: m_preconditioner(preconditioner), m_x(x), m_b(b) {}
+
+	void forLoop(int iBegin, int iEnd) const BT_OVERRIDE
+	{
+		m_preconditioner->internalSmooth(m_x, m_b, iBegin, iEnd);
+	}
+};
+
+struct btMultigridRestrictLoop : public btIParallelForBody
+{
+	MultigridPreconditioner* m_preconditioner;
+
+	btMultigridRestrictLoop(MultigridPreconditioner* preconditioner) : m_preconditioner(preconditioner) {}
+
+	void forLoop(int iBegin, int iEnd) const BT_OVERRIDE
+	{
+		m_preconditioner->internalRestrict(iBegin, iEnd);
+	}
+};
+
+struct btMultigridProlongateLoop : public btIParallelForBody
+{
+	const MultigridPreconditioner* m_preconditioner;
+	Preconditioner::TVStack& m_b;
+
+	btMultigridProlongateLoop(const MultigridPreconditioner* preconditioner, Preconditioner::TVStack& b)
+		: m_preconditioner(preconditioner), m_b(b) {}
+
+	void forLoop(int iBegin, int iEnd) const BT_OVERRIDE
+	{
+		m_preconditioner->internalProlongate(m_b, iBegin, iEnd);
+	}
+};
+
+void MultigridPreconditioner::buildFromMatrix(const btDeformableBlockMatrix& A)
+{
+	BT_PROFILE("MultigridPreconditioner::buildFromMatrix");
+	m_matrix = &A;
+	int numRows = A.getNumRows();
+	m_smoother.buildFromMatrix(A);
+
+	// a node whose neighbors are all free starts an aggregate with them
+	m_aggregate.resizeNoInitialize(numRows);
+	for (int i = 0; i < numRows; ++i)
+	{
+		m_aggregate[i] = -1;
+	}
+	int numAggregates = 0;
+	for (int i = 0; i < numRows; ++i)
+	{
+		if (m_aggregate[i] >= 0)
+		{
+			continue;
+		}
+		bool free = true;
+		for (int k = A.getRowBegin(i); k < A.getRowBegin(i + 1) && free; ++k)
+		{
+			free = (m_aggregate[A.getColumn(k)] < 0);
+		}
+		if (free)
+		{
+			for (int k = A.getRowBegin(i); k < A.getRowBegin(i + 1); ++k)
+			{
+				m_aggregate[A.getColumn(k)] = numAggregates;
+			}
+			m_aggregate[i] = numAggregates;
+			++numAggregates;
+		}
+	}
+	// the remaining nodes join the aggregate of a neighbor from the first pass
+	m_aggregateOffsets.resizeNoInitialize(numRows);
+	for (int i = 0; i < numRows; ++i)
+	{
+		int aggregate = m_aggregate[i];
+		for (int k = A.getRowBegin(i); k < A.getRowBegin(i + 1) && aggregate < 0; ++k)
+		{
+			aggregate = m_aggregate[A.getColumn(k)];
+		}
+		m_aggregateOffsets[i] = aggregate;
+	}
+	for (int i = 0; i < numRows; ++i)
+	{
+		m_aggregate[i] = (m_aggregateOffsets[i] >= 0) ? m_aggregateOffsets[i] : numAggregates++;
+	}
+
+	// list the nodes of each aggregate
+	m_aggregateOffsets.resize(numAggregates + 1);
+	for (int i = 0; i <= numAggregates; ++i)
+	{
+		m_aggregateOffsets[i] = 0;
+	}
+	for (int i = 0; i < numRows; ++i)
+	{
+		m_aggregateOffsets[m_aggregate[i] + 1]++;
+	}
+	for (int i = 0; i < numAggregates; ++i)
+	{
+		m_aggregateOffsets[i + 1] += m_aggregateOffsets[i];
+	}
+	m_aggregateNodes.resizeNoInitialize(numRows);
+	for (int i = 0; i < numRows; ++i)
+	{
+		m_aggregateNodes[m_aggregateOffsets[m_aggregate[i]]++] = i;
+	}
+	for (int i = numAggregates; i > 0; --i)
+	{
+		m_aggregateOffsets[i] = m_aggregateOffsets[i - 1];
+	}
+	m_aggregateOffsets[0] = 0;
+
+	// Galerkin coarse matrix
+	m_coarseMatrix.reset(numAggregates);
+	for (int i = 0; i < numRows; ++i)
+	{
+		for (int k = A.getRowBegin(i); k < A.getRowBegin(i + 1); ++k)
+		{
+			m_coarseMatrix.addBlock(m_aggregate[i], m_aggregate[A.getColumn(k)], A.getBlock(k));
+		}
+	}
+	m_coarseMatrix.finalize();
+	m_coarseSolver.buildFromMatrix(m_coarseMatrix);
+
+	m_residual.resize(numRows);
+	m_coarseResidual.resize(numAggregates);
+	m_coarseCorrection.resize(numAggregates);
+}
+
+void MultigridPreconditioner::internalSmooth(const TVStack& x, TVStack& b, int iBegin, int iEnd)
+{
+	// m_residual holds A * b
+	for (int i = iBegin; i < iEnd; ++i)
+	{
+		b[i] += m_smoothingWeight * (m_smoother.getInverseDiagonal(i) * (x[i] - m_residual[i]));
+	}
+}
+
+void MultigridPreconditioner::internalRestrict(int iBegin, int iEnd)
+{
+	// m_residual holds x - A * b
+	for (int i = iBegin; i < iEnd; ++i)
+	{
+		btVector3 sum(0, 0, 0);
+		for (int k = m_aggregateOffsets[i]; k < m_aggregateOffsets[i + 1]; ++k)
+		{
+			sum += m_residual[m_aggregateNodes[k]];
+		}
+		m_coarseResidual[i] = sum;
+	}
+}
+
+void MultigridPreconditioner::internalProlongate(TVStack& b, int iBegin, int iEnd) const
+{
+	for (int i = iBegin; i < iEnd; ++i)
+	{
+		b[i] += m_coarseCorrection[m_aggregate[i]];
+	}
+}
+
+void MultigridPreconditioner::operator()(const TVStack& x, TVStack& b)
+{
+	BT_PROFILE("MultigridPreconditioner");
+	btAssert(b.size() == x.size());
+	btAssert(m_matrix && m_matrix->getNumRows() <= x.size());
+	int numRows = m_matrix->getNumRows();
+	btMultigridSmoothLoop smoothLoop(this, x, b);
+
+	// pre-smoothing from b = 0
+	for (int i = 0; i < numRows; ++i)
+	{
+		b[i].setZero();
+		m_residual[i].setZero();
+	}
+	for (int sweep = 0; sweep < m_numSmoothingSweeps; ++sweep)
+	{
+		if (sweep > 0)
+		{
+			m_matrix->multiply(b, m_residual);
+		}
+		btPreconditionerParallelFor(0, numRows, smoothLoop);
+	}
+
+	// coarse correction
+	m_matrix->multiply(b, m_residual);
+	for (int i = 0; i < numRows; ++i)
+	{
+		m_residual[i] = x[i] - m_residual[i];
+	}
+	btMultigridRestrictLoop restrictLoop(this);
+	btPreconditionerParallelFor(0, m_coarseMatrix.getNumRows(), restrictLoop);
+	m_coarseSolver.solve(m_coarseResidual, m_coarseCorrection);
+	btMultigridProlongateLoop prolongateLoop(this, b);
+	btPreconditionerParallelFor(0, numRows, prolongateLoop);
+
+	// post-smoothing
+	for (int sweep = 0; sweep < m_numSmoothingSweeps; ++sweep)
+	{
+		m_matrix->multiply(b, m_residual);
+		btPreconditionerParallelFor(0, numRows, smoothLoop);
+	}
+	for (int i = numRows; i < b.size(); ++i)
+	{
+		b[i] = x[i];
+	}
+}
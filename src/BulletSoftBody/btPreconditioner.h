@@ -16,6 +16,8 @@
 #ifndef BT_PRECONDITIONER_H
 #define BT_PRECONDITIONER_H
 
+#include "btDeformableBlockMatrix.h"
+
 class Preconditioner
 {
 public:
@@ -23,6 +25,15 @@ public:
 	virtual void operator()(const TVStack& x, TVStack& b) = 0;
 	virtual void reinitialize(bool nodeUpdated) = 0;
 	virtual ~Preconditioner() {}
+
+	// true if the preconditioner is built from the assembled matrix of the objective
+	virtual bool needsAssembledMatrix() const
+	{
+		return false;
+	}
+
+	// rebuild from the assembled matrix, called after every assembly. A stays alive and unchanged until the next call.
+	virtual void buildFromMatrix(const btDeformableBlockMatrix& A) {}
 };
 
 class DefaultPreconditioner : public Preconditioner
@@ -282,4 +293,108 @@ public:
 #endif
 };
 
+// Inverts the 3x3 diagonal block of each node
+class BlockJacobiPreconditioner : public Preconditioner
+{
+	btAlignedObjectArray<btMatrix3x3> m_inverseDiagonal;
+
+public:
+	virtual bool needsAssembledMatrix() const
+	{
+		return true;
+	}
+
+	virtual void buildFromMatrix(const btDeformableBlockMatrix& A);
+
+	virtual void reinitialize(bool nodeUpdated) {}
+
+	virtual void operator()(const TVStack& x, TVStack& b);
+
+	const btMatrix3x3& getInverseDiagonal(int i) const
+	{
+		return m_inverseDiagonal[i];
+	}
+
+	void internalBuild(const btDeformableBlockMatrix& A, int iBegin, int iEnd);
+	void internalApply(const TVStack& x, TVStack& b, int iBegin, int iEnd) const;
+};
+
+// Block incomplete Cholesky factorization without fill-in, IC(0), stored as L * D * L^T with unit lower triangular L.
+// A pivot that is not positive definite, e.g. from an indefinite neo-Hookean Hessian, is replaced by the
+// original diagonal block. The triangular solves run on one thread.
+class IncompleteCholeskyPreconditioner : public Preconditioner
+{
+	btAlignedObjectArray<int> m_rowOffsets;
+	btAlignedObjectArray<int> m_cols;
+	btAlignedObjectArray<int> m_diagonal;
+	btAlignedObjectArray<btMatrix3x3> m_factor;  // L below the diagonal, D * L^T above it
+	btAlignedObjectArray<btMatrix3x3> m_inverseDiagonal;
+
+public:
+	virtual bool needsAssembledMatrix() const
+	{
+		return true;
+	}
+
+	virtual void buildFromMatrix(const btDeformableBlockMatrix& A);
+
+	virtual void reinitialize(bool nodeUpdated) {}
+
+	virtual void operator()(const TVStack& x, TVStack& b);
+
+	// solve L * D * L^T * b = x for the first getNumRows() entries
+	void solve(const TVStack& x, TVStack& b) const;
+
+	int getNumRows() const
+	{
+		return m_diagonal.size();
+	}
+};
+
+// Two-level multigrid V-cycle. The nodes are aggregated along the matrix graph, i.e. the tetrahedra and links of the mesh,
+// into groups of a node and its neighbors. The coarse matrix is the Galerkin product P^T * A * P with the piecewise constant
+// prolongation P and is solved with block IC(0). Damped block Jacobi sweeps smooth before and after the coarse correction,
+// which keeps the preconditioner symmetric for CG.
+class MultigridPreconditioner : public Preconditioner
+{
+	const btDeformableBlockMatrix* m_matrix;
+	BlockJacobiPreconditioner m_smoother;
+	btDeformableBlockMatrix m_coarseMatrix;
+	IncompleteCholeskyPreconditioner m_coarseSolver;
+	btAlignedObjectArray<int> m_aggregate;         // aggregate of each node
+	btAlignedObjectArray<int> m_aggregateOffsets;  // nodes of aggregate i are m_aggregateNodes[m_aggregateOffsets[i]..m_aggregateOffsets[i + 1])
+	btAlignedObjectArray<int> m_aggregateNodes;
+	TVStack m_residual;
+	TVStack m_coarseResidual;
+	TVStack m_coarseCorrection;
+	int m_numSmoothingSweeps;
+	btScalar m_smoothingWeight;
+
+public:
+	MultigridPreconditioner()
+		: m_matrix(0), m_numSmoothingSweeps(2), m_smoothingWeight(btScalar(2) / btScalar(3))
+	{
+	}
+
+	virtual bool needsAssembledMatrix() const
+	{
+		return true;
+	}
+
+	virtual void buildFromMatrix(const btDeformableBlockMatrix& A);
+
+	virtual void reinitialize(bool nodeUpdated) {}
+
+	virtual void operator()(const TVStack& x, TVStack& b);
+
+	int getNumAggregates() const
+	{
+		return m_coarseMatrix.getNumRows();
+	}
+
+	void internalSmooth(const TVStack& x, TVStack& b, int iBegin, int iEnd);
+	void internalRestrict(int iBegin, int iEnd);
+	void internalProlongate(TVStack& b, int iBegin, int iEnd) const;
+};
+
 #endif /* BT_PRECONDITIONER_H */
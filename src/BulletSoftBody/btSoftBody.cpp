@@ -18,6 +18,7 @@ subject to the following restrictions:
 #include "BulletSoftBody/btSoftBodySolvers.h"
 #include "btSoftBodyData.h"
 #include "LinearMath/btSerializer.h"
+#include "LinearMath/btThreads.h"
 #include "LinearMath/btImplicitQRSVD.h"
 #include "LinearMath/btAlignedAllocator.h"
 #include "BulletDynamics/Featherstone/btMultiBodyLinkCollider.h"
@@ -207,6 +208,8 @@ void btSoftBody::initDefaults()
 	m_tag = 0;
 	m_timeacc = 0;
 	m_bUpdateRtCst = true;
+	m_bDeferBroadphaseUpdate = false;
+	m_useLinkColoring = false;
 	m_bounds[0] = btVector3(0, 0, 0);
 	m_bounds[1] = btVector3(0, 0, 0);
 	m_worldTransform.setIdentity();
@@ -234,6 +237,7 @@ void btSoftBody::initDefaults()
 
 	// reduced flag
 	m_reducedModel = false;
+	m_cableModel = false;
 }
 
 //
@@ -1506,6 +1510,7 @@ void btSoftBody::randomizeConstraints()
 		btSwap(m_faces[i], m_faces[NEXTRAND % ni]);
 	}
 #undef NEXTRAND
+	m_linkColorOrder.resize(0);
 }
 
 void btSoftBody::updateState(const btAlignedObjectArray<btVector3>& q, const btAlignedObjectArray<btVector3>& v)
@@ -3060,12 +3065,9 @@ void btSoftBody::updateBounds()
 										csm);
 		m_bounds[0] = mins - mrg;
 		m_bounds[1] = maxs + mrg;
-		if (0 != getBroadphaseHandle())
+		if (!m_bDeferBroadphaseUpdate)
 		{
-			m_worldInfo->m_broadphase->setAabb(getBroadphaseHandle(),
-											   m_bounds[0],
-											   m_bounds[1],
-											   m_worldInfo->m_dispatcher);
+			updateBroadphaseAabb();
 		}
 	}
 	else
@@ -3075,6 +3077,18 @@ void btSoftBody::updateBounds()
 	}
 }
 
+//
+void btSoftBody::updateBroadphaseAabb()
+{
+	if (m_nodes.size() && 0 != getBroadphaseHandle())
+	{
+		m_worldInfo->m_broadphase->setAabb(getBroadphaseHandle(),
+										   m_bounds[0],
+										   m_bounds[1],
+										   m_worldInfo->m_dispatcher);
+	}
+}
+
 //
 void btSoftBody::updatePose()
 {
@@ -3188,6 +3202,71 @@ void btSoftBody::updateLinkConstants()
 		Material& m = *l.m_material;
 		l.m_c0 = (l.m_n[0]->m_im + l.m_n[1]->m_im) / m.m_kLST;
 	}
+	/* Colors		*/
+	m_linkColorOrder.resize(0);
+}
+
+//
+void btSoftBody::updateLinkColoring()
+{
+	const int nn = m_nodes.size();
+	const int nl = m_links.size();
+	if (nn == 0 || nl == 0)
+	{
+		m_linkColorOrder.resize(0);
+		m_linkColorOffsets.resize(0);
+		return;
+	}
+	const Node* nbase = &m_nodes[0];
+	/* Greedy coloring needs at most 2 * maxdegree - 1 colors	*/
+	btAlignedObjectArray<int> degree;
+	degree.resize(nn, 0);
+	int maxdegree = 0;
+	for (int i = 0; i < nl; ++i)
+	{
+		for (int j = 0; j < 2; ++j)
+		{
+			maxdegree = btMax(maxdegree, ++degree[int(m_links[i].m_n[j] - nbase)]);
+		}
+	}
+	const int nw = (2 * maxdegree + 31) / 32;
+	btAlignedObjectArray<unsigned int> used;
+	used.resize(nn * nw, 0);
+	btAlignedObjectArray<int> colors;
+	colors.resize(nl);
+	int ncolors = 0;
+	for (int i = 0; i < nl; ++i)
+	{
+		unsigned int* ua = &used[int(m_links[i].m_n[0] - nbase) * nw];
+		unsigned int* ub = &used[int(m_links[i].m_n[1] - nbase) * nw];
+		int c = 0;
+		while ((ua[c >> 5] | ub[c >> 5]) & (1u << (c & 31)))
+		{
+			++c;
+		}
+		ua[c >> 5] |= 1u << (c & 31);
+		ub[c >> 5] |= 1u << (c & 31);
+		colors[i] = c;
+		ncolors = btMax(ncolors, c + 1);
+	}
+	/* Sort the links by color, keeping their order within a color	*/
+	m_linkColorOffsets.resize(0);
+	m_linkColorOffsets.resize(ncolors + 1, 0);
+	for (int i = 0; i < nl; ++i)
+	{
+		++m_linkColorOffsets[colors[i] + 1];
+	}
+	for (int c = 0; c < ncolors; ++c)
+	{
+		m_linkColorOffsets[c + 1] += m_linkColorOffsets[c];
+	}
+	btAlignedObjectArray<int> fill;
+	fill.copyFromArray(m_linkColorOffsets);
+	m_linkColorOrder.resize(nl);
+	for (int i = 0; i < nl; ++i)
+	{
+		m_linkColorOrder[fill[colors[i]]++] = i;
+	}
 }
 
 void btSoftBody::updateConstants()
@@ -4039,26 +4118,96 @@ void btSoftBody::PSolve_SContacts(btSoftBody* psb, btScalar, btScalar ti)
 	}
 }
 
+// Links solved in parallel, one color at a time
+static const int kColoredLinksGrainSize = 256;
+
+static inline void PSolve_Link(btSoftBody::Link& l, btScalar kst)
+{
+	if (l.m_c0 > 0)
+	{
+		btSoftBody::Node& a = *l.m_n[0];
+		btSoftBody::Node& b = *l.m_n[1];
+		const btVector3 del = b.m_x - a.m_x;
+		const btScalar len = del.length2();
+		if (l.m_c1 + len > SIMD_EPSILON)
+		{
+			const btScalar k = ((l.m_c1 - len) / (l.m_c0 * (l.m_c1 + len))) * kst;
+			a.m_x -= del * (k * a.m_im);
+			b.m_x += del * (k * b.m_im);
+		}
+	}
+}
+
+static inline void VSolve_Link(btSoftBody::Link& l, btScalar kst)
+{
+	btSoftBody::Node** n = l.m_n;
+	const btScalar j = -btDot(l.m_c3, n[0]->m_v - n[1]->m_v) * l.m_c2 * kst;
+	n[0]->m_v += l.m_c3 * (j * n[0]->m_im);
+	n[1]->m_v -= l.m_c3 * (j * n[1]->m_im);
+}
+
+struct btColoredLinksLoop : public btIParallelForBody
+{
+	btSoftBody::Link* m_links;
+	const int* m_order;
+	btScalar m_kst;
+	bool m_positions;
+
+	void forLoop(int iBegin, int iEnd) const BT_OVERRIDE
+	{
+		for (int i = iBegin; i < iEnd; ++i)
+		{
+			btSoftBody::Link& l = m_links[m_order[i]];
+			if (m_positions)
+				PSolve_Link(l, m_kst);
+			else
+				VSolve_Link(l, m_kst);
+		}
+	}
+};
+
+static void solveColoredLinks(btSoftBody* psb, btScalar kst, bool positions)
+{
+	if (psb->m_linkColorOrder.size() != psb->m_links.size())
+	{
+		psb->updateLinkColoring();
+	}
+	if (psb->m_links.size() == 0)
+	{
+		return;
+	}
+	btColoredLinksLoop loop;
+	loop.m_links = &psb->m_links[0];
+	loop.m_order = &psb->m_linkColorOrder[0];
+	loop.m_kst = kst;
+	loop.m_positions = positions;
+	for (int c = 0, nc = psb->m_linkColorOffsets.size() - 1; c < nc; ++c)
+	{
+		const int iBegin = psb->m_linkColorOffsets[c];
+		const int iEnd = psb->m_linkColorOffsets[c + 1];
+#if BT_THREADSAFE
+		if (btGetTaskScheduler())
+		{
+			btParallelFor(iBegin, iEnd, kColoredLinksGrainSize, loop);
+			continue;
+		}
+#endif
+		loop.forLoop(iBegin, iEnd);
+	}
+}
+
 //
 void btSoftBody::PSolve_Links(btSoftBody* psb, btScalar kst, btScalar ti)
 {
 	BT_PROFILE("PSolve_Links");
+	if (psb->m_useLinkColoring)
+	{
+		solveColoredLinks(psb, kst, true);
+		return;
+	}
 	for (int i = 0, ni = psb->m_links.size(); i < ni; ++i)
 	{
-		Link& l = psb->m_links[i];
-		if (l.m_c0 > 0)
-		{
-			Node& a = *l.m_n[0];
-			Node& b = *l.m_n[1];
-			const btVector3 del = b.m_x - a.m_x;
-			const btScalar len = del.length2();
-			if (l.m_c1 + len > SIMD_EPSILON)
-			{
-				const btScalar k = ((l.m_c1 - len) / (l.m_c0 * (l.m_c1 + len))) * kst;
-				a.m_x -= del * (k * a.m_im);
-				b.m_x += del * (k * b.m_im);
-			}
-		}
+		PSolve_Link(psb->m_links[i], kst);
 	}
 }
 
@@ -4066,13 +4215,14 @@ void btSoftBody::PSolve_Links(btSoftBody* psb, btScalar kst, btScalar ti)
 void btSoftBody::VSolve_Links(btSoftBody* psb, btScalar kst)
 {
 	BT_PROFILE("VSolve_Links");
+	if (psb->m_useLinkColoring)
+	{
+		solveColoredLinks(psb, kst, false);
+		return;
+	}
 	for (int i = 0, ni = psb->m_links.size(); i < ni; ++i)
 	{
-		Link& l = psb->m_links[i];
-		Node** n = l.m_n;
-		const btScalar j = -btDot(l.m_c3, n[0]->m_v - n[1]->m_v) * l.m_c2 * kst;
-		n[0]->m_v += l.m_c3 * (j * n[0]->m_im);
-		n[1]->m_v -= l.m_c3 * (j * n[1]->m_im);
+		VSolve_Link(psb->m_links[i], kst);
 	}
 }
 
@@ -4120,6 +4270,16 @@ bool btSoftBody::useSelfCollision()
 	return m_useSelfCollision;
 }
 
+void btSoftBody::setUseLinkColoring(bool useLinkColoring)
+{
+	m_useLinkColoring = useLinkColoring;
+}
+
+bool btSoftBody::getUseLinkColoring() const
+{
+	return m_useLinkColoring;
+}
+
 //
 void btSoftBody::defaultCollisionHandler(const btCollisionObjectWrapper* pcoWrap)
 {
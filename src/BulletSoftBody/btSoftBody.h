@@ -903,6 +903,10 @@ public:
 	btScalar m_timeacc;             // Time accumulator
 	btVector3 m_bounds[2];          // Spatial bounds
 	bool m_bUpdateRtCst;            // Update runtime constants
+	bool m_bDeferBroadphaseUpdate;  // updateBounds leaves the broadphase aabb to updateBroadphaseAabb
+	bool m_useLinkColoring;         // Solve the links color by color
+	btAlignedObjectArray<int> m_linkColorOrder;    // Link indices grouped by color, the links of a color share no node
+	btAlignedObjectArray<int> m_linkColorOffsets;  // Start of each color in m_linkColorOrder, and the end
 	btDbvt m_ndbvt;                 // Nodes tree
 	btDbvt m_fdbvt;                 // Faces tree
 	btDbvntNode* m_fdbvnt;          // Faces tree with normals
@@ -930,6 +934,7 @@ public:
 	btScalar m_restLengthScale;
 
 	bool m_reducedModel;	// Reduced deformable model flag
+	bool m_cableModel;		// btCable flag
 	
 public:
 	btCollisionWorld* m_world;
@@ -1176,6 +1181,11 @@ public:
 	void defaultCollisionHandler(btSoftBody* psb);
 	void setSelfCollision(bool useSelfCollision);
 	bool useSelfCollision();
+	///setUseLinkColoring solves the links color by color, the links of a color share no node and are split
+	///across the task scheduler workers. It converges differently from the sequential sweep, but the result
+	///does not depend on the number of threads.
+	void setUseLinkColoring(bool useLinkColoring);
+	bool getUseLinkColoring() const;
 	void updateDeactivation(btScalar timeStep);
 	void setZeroVelocity();
 	bool wantsSleeping();
@@ -1268,9 +1278,11 @@ public:
 	virtual bool checkContact(const btCollisionObjectWrapper* colObjWrap, const btVector3& x, btScalar margin, btSoftBody::sCti& cti) const;
 	void updateNormals();
 	void updateBounds();
+	void updateBroadphaseAabb();
 	void updatePose();
 	void updateConstants();
 	void updateLinkConstants();
+	void updateLinkColoring();
 	void updateArea(bool averageArea = true);
 	void initializeClusters();
 	void updateClusters();
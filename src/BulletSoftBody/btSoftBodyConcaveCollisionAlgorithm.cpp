@@ -29,6 +29,7 @@ subject to the following restrictions:
 #include "LinearMath/btIDebugDraw.h"
 #include "BulletCollision/NarrowPhaseCollision/btSubSimplexConvexCast.h"
 #include "BulletSoftBody/btSoftBody.h"
+#include "BulletSoftBody/btSoftBodySolvers.h"
 
 #define BT_SOFTBODY_TRIANGLE_EXTRUSION btScalar(0.06)  //make this configurable
 
@@ -195,6 +196,21 @@ void btSoftBodyConcaveCollisionAlgorithm::processCollision(const btCollisionObje
 
 	if (triBody->getCollisionShape()->isConcave())
 	{
+		btSoftBody* softBody = m_isSwapped ? (btSoftBody*)body1Wrap->getCollisionObject() : (btSoftBody*)body0Wrap->getCollisionObject();
+		const int collisions = softBody->m_cfg.collisions;
+		// nodes sample a baked field of the whole mesh like a convex shape, the face and cluster contacts need the
+		// triangles
+		if ((collisions & btSoftBody::fCollision::RVSmask) == btSoftBody::fCollision::SDF_RD &&
+			!(collisions & (btSoftBody::fCollision::SDF_RDF | btSoftBody::fCollision::SDF_MDF)) &&
+			softBody->getWorldInfo()->m_sparsesdf.getBakedSdf(triBody->getCollisionShape()))
+		{
+			if (softBody->m_collisionDisabledObjects.findLinearSearch(triBody->getCollisionObject()) == softBody->m_collisionDisabledObjects.size())
+			{
+				softBody->getSoftBodySolver()->processCollision(softBody, triBody);
+			}
+			return;
+		}
+
 		const btConcaveShape* concaveShape = static_cast<const btConcaveShape*>(triBody->getCollisionShape());
 
 		//	if (convexBody->getCollisionShape()->isConvex())
@@ -40,6 +40,7 @@ public:
 		REDUCED_DEFORMABLE_SOLVER
 	};
 
+	// Kept for compatibility, the solver threads are set with btITaskScheduler::setNumThreads
 	int numThread = 6;
 
 protected:
@@ -18,7 +18,9 @@ subject to the following restrictions:
 #define BT_SPARSE_SDF_H
 
 #include "BulletCollision/CollisionDispatch/btCollisionObject.h"
+#include "BulletCollision/CollisionShapes/btMiniSDF.h"
 #include "BulletCollision/NarrowPhaseCollision/btGjkEpa2.h"
+#include "LinearMath/btThreads.h"
 
 // Fast Hash
 
@@ -54,12 +56,30 @@ inline unsigned int HsiehHash(const char* data, int len)
 	return hash;
 }
 
+///
+/// btSparseSdf -- signed distance field of collision shapes in shape space, sampled on a sparse grid of cells that are built
+/// on demand with GJK distance queries and cached.
+///
+/// Evaluate is thread safe. The cells are spread over kNumShards shards by their hash, each shard has its own spin mutex,
+/// hash buckets, LRU list and free list of cells. A missing cell is built outside of the lock, so a slow build does not
+/// block the queries of other threads. Cells are allocated in slabs of kCellsPerSlab cells. When a shard reaches its part
+/// of the memory budget, its least recently used cell is evicted, instead of resetting the whole field.
+/// Initialize, Reset, setMemoryBudget, GarbageCollect and RemoveReferences must not run concurrently with Evaluate.
+///
+/// Shapes with a baked btMiniSDF, see setBakedSdf, are sampled from it without locking and without building cells.
+/// This also works for concave shapes, which get no cells.
+///
 template <const int CELLSIZE>
 struct btSparseSdf
 {
 	//
 	// Inner types
 	//
+	enum
+	{
+		kNumShards = 16,
+		kCellsPerSlab = 32
+	};
 	struct IntFrac
 	{
 		int b;
@@ -73,20 +93,61 @@ struct btSparseSdf
 		int puid;
 		unsigned hash;
 		const btCollisionShape* pclient;
-		Cell* next;
+		Cell* next;     // hash bucket chain, or free list
+		Cell* lruPrev;  // towards the most recently used cell
+		Cell* lruNext;
+	};
+	struct Shard
+	{
+		btSpinMutex m_mutex;
+		btAlignedObjectArray<Cell*> m_buckets;
+		btAlignedObjectArray<Cell*> m_slabs;
+		Cell* m_freeCells;
+		Cell* m_lruHead;  // most recently used
+		Cell* m_lruTail;
+		int m_numCells;
+		int m_maxCells;
+		unsigned long long int m_numQueries;
+		unsigned long long int m_numHits;
+		unsigned long long int m_numBuilds;
+		unsigned long long int m_numEvictions;
+		char m_padding[64];  // keep the mutexes of neighboring shards off the same cache line
+
+		Shard() : m_freeCells(0), m_lruHead(0), m_lruTail(0), m_numCells(0), m_maxCells(1), m_numQueries(0), m_numHits(0), m_numBuilds(0), m_numEvictions(0) {}
+	};
+	struct BakedSdf
+	{
+		const btCollisionShape* m_shape;
+		const btMiniSDF* m_sdf;
+	};
+	struct Statistics
+	{
+		unsigned long long int m_numQueries;
+		unsigned long long int m_numHits;
+		unsigned long long int m_numBuilds;    // cells built, including the ones built twice by racing threads
+		unsigned long long int m_numEvictions;  // cells evicted to stay in the memory budget
+		int m_numCells;
+		size_t m_numBytes;  // memory of the cell slabs
+
+		btScalar getHitRate() const
+		{
+			return m_numQueries ? btScalar(m_numHits) / btScalar(m_numQueries) : btScalar(0);
+		}
 	};
 	//
 	// Fields
 	//
 
-	btAlignedObjectArray<Cell*> cells;
+	Shard m_shards[kNumShards];
+	btAlignedObjectArray<BakedSdf> m_bakedSdfs;  // few shapes, searched linearly
 	btScalar voxelsz;
 	btScalar m_defaultVoxelsz;
 	int puid;
-	int ncells;
-	int m_clampCells;
-	int nprobes;
-	int nqueries;
+	size_t m_maxBytes;
+
+	btSparseSdf() : voxelsz(0.25), m_defaultVoxelsz(0.25), puid(0), m_maxBytes(256 * 1024 * sizeof(Cell))
+	{
+	}
 
 	~btSparseSdf()
 	{
@@ -99,12 +160,16 @@ struct btSparseSdf
 	//
 	void Initialize(int hashsize = 2383, int clampCells = 256 * 1024)
 	{
-		//avoid a crash due to running out of memory, so clamp the maximum number of cells allocated
-		//if this limit is reached, the SDF is reset (at the cost of some performance during the reset)
-		m_clampCells = clampCells;
-		cells.resize(hashsize, 0);
+		//avoid a crash due to running out of memory, the cells take at most clampCells * sizeof(Cell) bytes,
+		//see setMemoryBudget
+		const int bucketsPerShard = btMax(1, hashsize / kNumShards);
+		for (int i = 0; i < kNumShards; ++i)
+		{
+			m_shards[i].m_buckets.resize(bucketsPerShard, 0);
+		}
 		m_defaultVoxelsz = 0.25;
 		Reset();
+		setMemoryBudget(size_t(clampCells) * sizeof(Cell));
 	}
 	//
 
@@ -113,153 +178,243 @@ struct btSparseSdf
 		m_defaultVoxelsz = sz;
 	}
 
+	// Limit the memory of the cells, every shard gets an equal part. Cells over the budget are evicted, least recently
+	// used first, and the field is reset if the slabs take more than the new budget.
+	void setMemoryBudget(size_t numBytes)
+	{
+		m_maxBytes = numBytes;
+		const int maxCellsPerShard = btMax(1, int(numBytes / sizeof(Cell) / kNumShards));
+		bool reset = false;
+		for (int i = 0; i < kNumShards; ++i)
+		{
+			Shard& shard = m_shards[i];
+			shard.m_maxCells = maxCellsPerShard;
+			reset |= (shard.m_slabs.size() * kCellsPerSlab > maxCellsPerShard + kCellsPerSlab);
+		}
+		if (reset)
+		{
+			Reset();
+		}
+	}
+
+	size_t getMemoryBudget() const
+	{
+		return m_maxBytes;
+	}
+
 	void Reset()
 	{
-		for (int i = 0, ni = cells.size(); i < ni; ++i)
+		for (int i = 0; i < kNumShards; ++i)
 		{
-			Cell* pc = cells[i];
-			cells[i] = 0;
-			while (pc)
+			Shard& shard = m_shards[i];
+			btMutexLock(&shard.m_mutex);
+			for (int j = 0; j < shard.m_buckets.size(); ++j)
 			{
-				Cell* pn = pc->next;
-				delete pc;
-				pc = pn;
+				shard.m_buckets[j] = 0;
+			}
+			for (int j = 0; j < shard.m_slabs.size(); ++j)
+			{
+				btAlignedFree(shard.m_slabs[j]);
 			}
+			shard.m_slabs.clear();
+			shard.m_freeCells = 0;
+			shard.m_lruHead = 0;
+			shard.m_lruTail = 0;
+			shard.m_numCells = 0;
+			btMutexUnlock(&shard.m_mutex);
 		}
 		voxelsz = m_defaultVoxelsz;
 		puid = 0;
-		ncells = 0;
-		nprobes = 1;
-		nqueries = 1;
 	}
 	//
 	void GarbageCollect(int lifetime = 256)
 	{
 		const int life = puid - lifetime;
-		for (int i = 0; i < cells.size(); ++i)
+		for (int i = 0; i < kNumShards; ++i)
 		{
-			Cell*& root = cells[i];
-			Cell* pp = 0;
-			Cell* pc = root;
-			while (pc)
+			Shard& shard = m_shards[i];
+			btMutexLock(&shard.m_mutex);
+			// cells are stamped with puid when used and moved to the head, so the stale ones are at the tail
+			while (shard.m_lruTail && shard.m_lruTail->puid < life)
 			{
-				Cell* pn = pc->next;
-				if (pc->puid < life)
-				{
-					if (pp)
-						pp->next = pn;
-					else
-						root = pn;
-					delete pc;
-					pc = pp;
-					--ncells;
-				}
-				pp = pc;
-				pc = pn;
+				RemoveCell(shard, shard.m_lruTail);
 			}
+			btMutexUnlock(&shard.m_mutex);
 		}
-		//printf("GC[%d]: %d cells, PpQ: %f\r\n",puid,ncells,nprobes/(btScalar)nqueries);
-		nqueries = 1;
-		nprobes = 1;
 		++puid;  ///@todo: Reset puid's when int range limit is reached	*/
-		/* else setup a priority list...						*/
 	}
 	//
 	int RemoveReferences(btCollisionShape* pcs)
 	{
 		int refcount = 0;
-		for (int i = 0; i < cells.size(); ++i)
+		for (int i = 0; i < kNumShards; ++i)
 		{
-			Cell*& root = cells[i];
-			Cell* pp = 0;
-			Cell* pc = root;
+			Shard& shard = m_shards[i];
+			btMutexLock(&shard.m_mutex);
+			Cell* pc = shard.m_lruHead;
 			while (pc)
 			{
-				Cell* pn = pc->next;
+				Cell* pn = pc->lruNext;
 				if (pc->pclient == pcs)
 				{
-					if (pp)
-						pp->next = pn;
-					else
-						root = pn;
-					delete pc;
-					pc = pp;
+					RemoveCell(shard, pc);
 					++refcount;
 				}
-				pp = pc;
 				pc = pn;
 			}
+			btMutexUnlock(&shard.m_mutex);
 		}
 		return (refcount);
 	}
 	//
+	// Sample the shape from sdf, baked in shape space with btMiniSDF::buildFromShape or loaded, instead of building cells.
+	// The field is shared read only by all soft bodies and threads, it is not owned and must stay alive while it is set.
+	// Outside of its domain, Evaluate returns the distance to the domain. A null sdf removes the shape.
+	// Must not run concurrently with Evaluate.
+	void setBakedSdf(const btCollisionShape* shape, const btMiniSDF* sdf)
+	{
+		btAssert(!sdf || sdf->isValid());
+		for (int i = 0; i < m_bakedSdfs.size(); ++i)
+		{
+			if (m_bakedSdfs[i].m_shape == shape)
+			{
+				if (sdf)
+				{
+					m_bakedSdfs[i].m_sdf = sdf;
+				}
+				else
+				{
+					m_bakedSdfs.swap(i, m_bakedSdfs.size() - 1);
+					m_bakedSdfs.pop_back();
+				}
+				return;
+			}
+		}
+		if (sdf)
+		{
+			BakedSdf baked;
+			baked.m_shape = shape;
+			baked.m_sdf = sdf;
+			m_bakedSdfs.push_back(baked);
+		}
+	}
+	//
+	const btMiniSDF* getBakedSdf(const btCollisionShape* shape) const
+	{
+		for (int i = 0; i < m_bakedSdfs.size(); ++i)
+		{
+			if (m_bakedSdfs[i].m_shape == shape)
+			{
+				return m_bakedSdfs[i].m_sdf;
+			}
+		}
+		return 0;
+	}
+	//
+	int getNumCells() const
+	{
+		int numCells = 0;
+		for (int i = 0; i < kNumShards; ++i)
+		{
+			numCells += m_shards[i].m_numCells;
+		}
+		return numCells;
+	}
+	//
+	Statistics getStatistics()
+	{
+		Statistics stats;
+		stats.m_numQueries = 0;
+		stats.m_numHits = 0;
+		stats.m_numBuilds = 0;
+		stats.m_numEvictions = 0;
+		stats.m_numCells = 0;
+		stats.m_numBytes = 0;
+		for (int i = 0; i < kNumShards; ++i)
+		{
+			Shard& shard = m_shards[i];
+			btMutexLock(&shard.m_mutex);
+			stats.m_numQueries += shard.m_numQueries;
+			stats.m_numHits += shard.m_numHits;
+			stats.m_numBuilds += shard.m_numBuilds;
+			stats.m_numEvictions += shard.m_numEvictions;
+			stats.m_numCells += shard.m_numCells;
+			stats.m_numBytes += size_t(shard.m_slabs.size()) * kCellsPerSlab * sizeof(Cell);
+			btMutexUnlock(&shard.m_mutex);
+		}
+		return stats;
+	}
+	//
+	void resetStatistics()
+	{
+		for (int i = 0; i < kNumShards; ++i)
+		{
+			Shard& shard = m_shards[i];
+			btMutexLock(&shard.m_mutex);
+			shard.m_numQueries = 0;
+			shard.m_numHits = 0;
+			shard.m_numBuilds = 0;
+			shard.m_numEvictions = 0;
+			btMutexUnlock(&shard.m_mutex);
+		}
+	}
+	//
 	btScalar Evaluate(const btVector3& x,
 					  const btCollisionShape* shape,
 					  btVector3& normal,
 					  btScalar margin)
 	{
+		if (const btMiniSDF* baked = getBakedSdf(shape))
+		{
+			return EvaluateBaked(*baked, x, normal, margin);
+		}
 		/* Lookup cell			*/
 		const btVector3 scx = x / voxelsz;
 		const IntFrac ix = Decompose(scx.x());
 		const IntFrac iy = Decompose(scx.y());
 		const IntFrac iz = Decompose(scx.z());
 		const unsigned h = Hash(ix.b, iy.b, iz.b, shape);
-		Cell*& root = cells[static_cast<int>(h % cells.size())];
-		Cell* c = root;
-		++nqueries;
-		while (c)
+		const int o[] = {ix.i, iy.i, iz.i};
+		Shard& shard = m_shards[h % kNumShards];
+		btScalar d[8];
+		btMutexLock(&shard.m_mutex);
+		++shard.m_numQueries;
+		Cell* c = FindCell(shard, h, ix.b, iy.b, iz.b, shape);
+		if (c)
 		{
-			++nprobes;
-			if ((c->hash == h) &&
-				(c->c[0] == ix.b) &&
-				(c->c[1] == iy.b) &&
-				(c->c[2] == iz.b) &&
-				(c->pclient == shape))
-			{
-				break;
-			}
-			else
-			{
-				// printf("c->hash/c[0][1][2]=%d,%d,%d,%d\n", c->hash, c->c[0], c->c[1],c->c[2]);
-				//printf("h,ixb,iyb,izb=%d,%d,%d,%d\n", h,ix.b, iy.b, iz.b);
-
-				c = c->next;
-			}
+			++shard.m_numHits;
 		}
-		if (!c)
+		else
 		{
-			++nprobes;
-			++ncells;
-			//int sz = sizeof(Cell);
-			if (ncells > m_clampCells)
+			btMutexUnlock(&shard.m_mutex);
+			Cell built;
+			built.pclient = shape;
+			built.hash = h;
+			built.c[0] = ix.b;
+			built.c[1] = iy.b;
+			built.c[2] = iz.b;
+			BuildCell(built);
+			btMutexLock(&shard.m_mutex);
+			++shard.m_numBuilds;
+			// another thread may have added the cell in the meantime
+			c = FindCell(shard, h, ix.b, iy.b, iz.b, shape);
+			if (!c)
 			{
-				//static int numResets = 0;
-				//numResets++;
-				//printf("numResets=%d\n",numResets);
-				Reset();
+				c = InsertCell(shard, built);
 			}
-
-			c = new Cell();
-			c->next = root;
-			root = c;
-			c->pclient = shape;
-			c->hash = h;
-			c->c[0] = ix.b;
-			c->c[1] = iy.b;
-			c->c[2] = iz.b;
-			BuildCell(*c);
 		}
 		c->puid = puid;
+		TouchCell(shard, c);
 		/* Extract infos		*/
-		const int o[] = {ix.i, iy.i, iz.i};
-		const btScalar d[] = {c->d[o[0] + 0][o[1] + 0][o[2] + 0],
-							  c->d[o[0] + 1][o[1] + 0][o[2] + 0],
-							  c->d[o[0] + 1][o[1] + 1][o[2] + 0],
-							  c->d[o[0] + 0][o[1] + 1][o[2] + 0],
-							  c->d[o[0] + 0][o[1] + 0][o[2] + 1],
-							  c->d[o[0] + 1][o[1] + 0][o[2] + 1],
-							  c->d[o[0] + 1][o[1] + 1][o[2] + 1],
-							  c->d[o[0] + 0][o[1] + 1][o[2] + 1]};
+		d[0] = c->d[o[0] + 0][o[1] + 0][o[2] + 0];
+		d[1] = c->d[o[0] + 1][o[1] + 0][o[2] + 0];
+		d[2] = c->d[o[0] + 1][o[1] + 1][o[2] + 0];
+		d[3] = c->d[o[0] + 0][o[1] + 1][o[2] + 0];
+		d[4] = c->d[o[0] + 0][o[1] + 0][o[2] + 1];
+		d[5] = c->d[o[0] + 1][o[1] + 0][o[2] + 1];
+		d[6] = c->d[o[0] + 1][o[1] + 1][o[2] + 1];
+		d[7] = c->d[o[0] + 0][o[1] + 1][o[2] + 1];
+		btMutexUnlock(&shard.m_mutex);
 		/* Normal	*/
 #if 1
 		const btScalar gx[] = {d[1] - d[0], d[2] - d[3],
@@ -286,6 +441,136 @@ struct btSparseSdf
 		return (Lerp(d0, d1, iz.f) - margin);
 	}
 	//
+	static btScalar EvaluateBaked(const btMiniSDF& sdf, const btVector3& x, btVector3& normal, btScalar margin)
+	{
+		double dist;
+		btVector3 gradient;
+		if (sdf.interpolate(0, dist, x, &gradient))
+		{
+			normal = gradient;
+			normal.safeNormalize();
+			return btScalar(dist) - margin;
+		}
+		// the shape is inside of the domain, so it is at least as far as the domain
+		btVector3 inside = x;
+		inside.setMax(sdf.m_domain.min());
+		inside.setMin(sdf.m_domain.max());
+		normal = x - inside;
+		const btScalar distance = normal.length();
+		normal.safeNormalize();
+		return distance - margin;
+	}
+	//
+	// Shard helpers, called with the shard locked
+	//
+	static inline Cell*& Bucket(Shard& shard, unsigned h)
+	{
+		return shard.m_buckets[static_cast<int>((h / kNumShards) % shard.m_buckets.size())];
+	}
+	//
+	static inline Cell* FindCell(Shard& shard, unsigned h, int x, int y, int z, const btCollisionShape* shape)
+	{
+		Cell* c = Bucket(shard, h);
+		while (c && !((c->hash == h) &&
+					  (c->c[0] == x) &&
+					  (c->c[1] == y) &&
+					  (c->c[2] == z) &&
+					  (c->pclient == shape)))
+		{
+			c = c->next;
+		}
+		return c;
+	}
+	//
+	static inline void TouchCell(Shard& shard, Cell* c)
+	{
+		if (shard.m_lruHead == c)
+		{
+			return;
+		}
+		// unlink and put in front
+		c->lruPrev->lruNext = c->lruNext;
+		if (c->lruNext)
+			c->lruNext->lruPrev = c->lruPrev;
+		else
+			shard.m_lruTail = c->lruPrev;
+		c->lruPrev = 0;
+		c->lruNext = shard.m_lruHead;
+		shard.m_lruHead->lruPrev = c;
+		shard.m_lruHead = c;
+	}
+	//
+	static Cell* InsertCell(Shard& shard, const Cell& built)
+	{
+		while (shard.m_numCells >= shard.m_maxCells && shard.m_lruTail)
+		{
+			RemoveCell(shard, shard.m_lruTail);
+			++shard.m_numEvictions;
+		}
+		if (!shard.m_freeCells)
+		{
+			Cell* slab = static_cast<Cell*>(btAlignedAlloc(sizeof(Cell) * kCellsPerSlab, 16));
+			shard.m_slabs.push_back(slab);
+			for (int i = kCellsPerSlab - 1; i >= 0; --i)
+			{
+				slab[i].next = shard.m_freeCells;
+				shard.m_freeCells = &slab[i];
+			}
+		}
+		Cell* c = shard.m_freeCells;
+		shard.m_freeCells = c->next;
+		*c = built;
+		Cell*& root = Bucket(shard, c->hash);
+		c->next = root;
+		root = c;
+		c->lruPrev = 0;
+		c->lruNext = shard.m_lruHead;
+		if (shard.m_lruHead)
+			shard.m_lruHead->lruPrev = c;
+		else
+			shard.m_lruTail = c;
+		shard.m_lruHead = c;
+		++shard.m_numCells;
+		if (shard.m_numCells > 2 * shard.m_buckets.size())
+		{
+			Rehash(shard, 2 * shard.m_buckets.size());
+		}
+		return c;
+	}
+	//
+	static void RemoveCell(Shard& shard, Cell* c)
+	{
+		Cell** pp = &Bucket(shard, c->hash);
+		while (*pp != c)
+		{
+			pp = &(*pp)->next;
+		}
+		*pp = c->next;
+		if (c->lruPrev)
+			c->lruPrev->lruNext = c->lruNext;
+		else
+			shard.m_lruHead = c->lruNext;
+		if (c->lruNext)
+			c->lruNext->lruPrev = c->lruPrev;
+		else
+			shard.m_lruTail = c->lruPrev;
+		c->next = shard.m_freeCells;
+		shard.m_freeCells = c;
+		--shard.m_numCells;
+	}
+	//
+	static void Rehash(Shard& shard, int numBuckets)
+	{
+		shard.m_buckets.resize(0);
+		shard.m_buckets.resize(numBuckets, 0);
+		for (Cell* c = shard.m_lruTail; c; c = c->lruPrev)
+		{
+			Cell*& root = Bucket(shard, c->hash);
+			c->next = root;
+			root = c;
+		}
+	}
+	//
 	void BuildCell(Cell& c)
 	{
 		const btVector3 org = btVector3((btScalar)c.c[0],
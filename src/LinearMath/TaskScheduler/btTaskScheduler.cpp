@@ -25,6 +25,10 @@ void btSpinPause()
 {
 #if defined(_WIN32)
 	YieldProcessor();
+#elif (defined(__GNUC__) || defined(__clang__)) && (defined(__i386__) || defined(__x86_64__))
+	__builtin_ia32_pause();
+#elif (defined(__GNUC__) || defined(__clang__)) && (defined(__arm__) || defined(__aarch64__))
+	__asm__ __volatile__("yield");
 #endif
 }
 
@@ -93,7 +97,16 @@ ThreadLocalStorage
 	WorkerThreadDirectives* m_directive;
 	JobQueue* m_queue;
 	btClock* m_clock;
+	btU64 m_sleepStartTime;
+	// spin times in microseconds, protected by m_mutex since setWorkerSpinTime changes them while the worker runs
 	unsigned int m_cooldownTime;
+	unsigned int m_minCooldownTime;
+	unsigned int m_maxCooldownTime;
+	// counters, protected by m_mutex
+	btU64 m_numWakeups;
+	btU64 m_numSpinHits;
+	btU64 m_numSleeps;
+	btU64 m_idleTime;
 };
 
 struct IJob
@@ -199,6 +212,9 @@ public:
 		m_queueLock = NULL;
 		m_headIndex = 0;
 		m_tailIndex = 0;
+		m_allocSize = 0;
+		// empty until the first clearQueue, workers still spinning may steal from it as soon as setNumThreads activates it
+		m_queueIsEmpty = true;
 		m_useSpinMutex = false;
 	}
 	~JobQueue()
@@ -359,11 +375,35 @@ static void WorkerThreadFunc(void* userPtr)
 	JobQueue* jobQueue = localStorage->m_queue;
 
 	bool shouldSleep = false;
+	bool cooledDown = false;
 	int threadId = localStorage->m_threadId;
+	bool waitedForWork = false;
+	btU64 idleTime = 0;
+	btU64 timeAsleep = localStorage->m_clock->getTimeMicroseconds() - localStorage->m_sleepStartTime;
+	unsigned int cooldownTime = 0;
 	while (!shouldSleep)
 	{
 		// do work
 		localStorage->m_mutex.lock();
+		if (waitedForWork)
+		{
+			// found more work while spinning, a wakeup was saved
+			localStorage->m_numSpinHits++;
+		}
+		else
+		{
+			localStorage->m_numWakeups++;
+			// adapt the cooldown time: if we were asleep for less than the longest cooldown,
+			// spinning a bit longer would have avoided the wakeup
+			if (localStorage->m_sleepStartTime > 0 && timeAsleep < localStorage->m_maxCooldownTime)
+			{
+				localStorage->m_cooldownTime = btMin(localStorage->m_cooldownTime * 2, localStorage->m_maxCooldownTime);
+			}
+		}
+		cooldownTime = localStorage->m_cooldownTime;
+		localStorage->m_idleTime += idleTime;
+		waitedForWork = true;
+		idleTime = 0;
 		while (IJob* job = jobQueue->consumeJob())
 		{
 			localStorage->m_status = WorkerThreadStatus::kWorking;
@@ -373,6 +413,7 @@ static void WorkerThreadFunc(void* userPtr)
 		localStorage->m_status = WorkerThreadStatus::kWaitingForWork;
 		localStorage->m_mutex.unlock();
 		btU64 clockStart = localStorage->m_clock->getTimeMicroseconds();
+		btU64 idleStart = clockStart;
 		// while queue is empty,
 		while (jobQueue->isQueueEmpty())
 		{
@@ -403,20 +444,30 @@ static void WorkerThreadFunc(void* userPtr)
 				}
 				// if no jobs incoming and queue has been empty for the cooldown time, sleep
 				btU64 timeElapsed = localStorage->m_clock->getTimeMicroseconds() - clockStart;
-				if (timeElapsed > localStorage->m_cooldownTime)
+				if (timeElapsed > cooldownTime)
 				{
 					shouldSleep = true;
+					cooledDown = true;
 					break;
 				}
 			}
 		}
+		idleTime = localStorage->m_clock->getTimeMicroseconds() - idleStart;
 	}
 	{
 		BT_PROFILE("sleep");
 		// go sleep
 		localStorage->m_mutex.lock();
 		localStorage->m_status = WorkerThreadStatus::kSleeping;
+		localStorage->m_idleTime += idleTime;
+		localStorage->m_numSleeps++;
+		if (cooledDown)
+		{
+			// spun for the whole cooldown without finding work, spin less next time
+			localStorage->m_cooldownTime = btMax(localStorage->m_cooldownTime / 2, localStorage->m_minCooldownTime);
+		}
 		localStorage->m_mutex.unlock();
+		localStorage->m_sleepStartTime = localStorage->m_clock->getTimeMicroseconds();
 	}
 }
 
@@ -434,6 +485,8 @@ class btTaskSchedulerDefault : public btITaskScheduler
 	int m_numActiveJobQueues;
 	int m_maxNumThreads;
 	int m_numJobs;
+	btU64 m_numParallelFor;
+	btU64 m_numJobsSubmitted;
 	static const int kFirstWorkerThreadId = 1;
 
 public:
@@ -441,6 +494,8 @@ public:
 	{
 		m_threadSupport = NULL;
 		m_workerDirective = NULL;
+		m_numParallelFor = 0;
+		m_numJobsSubmitted = 0;
 	}
 
 	virtual ~btTaskSchedulerDefault()
@@ -510,6 +565,13 @@ public:
 			storage.m_directive = m_workerDirective;
 			storage.m_status = WorkerThreadStatus::kSleeping;
 			storage.m_cooldownTime = 100;  // 100 microseconds, threads go to sleep after this long if they have nothing to do
+			storage.m_minCooldownTime = storage.m_cooldownTime;
+			storage.m_maxCooldownTime = storage.m_cooldownTime;
+			storage.m_sleepStartTime = 0;
+			storage.m_numWakeups = 0;
+			storage.m_numSpinHits = 0;
+			storage.m_numSleeps = 0;
+			storage.m_idleTime = 0;
 			storage.m_clock = &m_clock;
 			storage.m_queue = m_perThreadJobQueues[i];
 		}
@@ -570,11 +632,12 @@ public:
 		setWorkerDirectives(WorkerThreadDirectives::kStayAwakeButIdle);
 
 		btU64 clockStart = m_clock.getTimeMicroseconds();
-		// wait for workers to finish any jobs in progress
+		// wait for workers to finish any jobs in progress, counting every worker since one that was active before
+		// setNumThreads shrank the pool may still take a job from a neighbor queue
 		while (true)
 		{
 			int numWorkerJobsFinished = 0;
-			for (int iThread = kFirstWorkerThreadId; iThread < m_numThreads; ++iThread)
+			for (int iThread = kFirstWorkerThreadId; iThread < m_threadLocalStorage.size(); ++iThread)
 			{
 				ThreadLocalStorage* storage = &m_threadLocalStorage[iThread];
 				storage->m_mutex.lock();
@@ -641,9 +704,80 @@ public:
 		setWorkerDirectives(WorkerThreadDirectives::kGoToSleep);
 	}
 
+	virtual void wakeWorkerThreadsHint() BT_OVERRIDE
+	{
+		BT_PROFILE("wakeWorkerThreadsHint");
+		// hint the task scheduler that parallel work is coming, wake sleeping workers now so
+		// they are spinning (and not waiting on the thread support) when the jobs arrive
+		setWorkerDirectives(WorkerThreadDirectives::kStayAwakeButIdle);
+		for (int iWorker = 0; iWorker < m_numWorkerThreads; ++iWorker)
+		{
+			ThreadLocalStorage& storage = m_threadLocalStorage[kFirstWorkerThreadId + iWorker];
+			storage.m_mutex.lock();
+			bool isSleeping = (storage.m_status == WorkerThreadStatus::kSleeping);
+			if (isSleeping)
+			{
+				// mark as awake right away so wakeWorkers() doesn't start the thread a second time
+				storage.m_status = WorkerThreadStatus::kWaitingForWork;
+			}
+			storage.m_mutex.unlock();
+			if (isSleeping)
+			{
+				m_threadSupport->runTask(iWorker, &storage);
+			}
+		}
+	}
+
+	virtual void setWorkerSpinTime(unsigned int minMicroseconds, unsigned int maxMicroseconds) BT_OVERRIDE
+	{
+		unsigned int maxTime = btMax(minMicroseconds, maxMicroseconds);
+		for (int i = 0; i < m_threadLocalStorage.size(); ++i)
+		{
+			ThreadLocalStorage& storage = m_threadLocalStorage[i];
+			storage.m_mutex.lock();
+			storage.m_minCooldownTime = minMicroseconds;
+			storage.m_maxCooldownTime = maxTime;
+			storage.m_cooldownTime = btMax(btMin(storage.m_cooldownTime, maxTime), minMicroseconds);
+			storage.m_mutex.unlock();
+		}
+	}
+
+	virtual void getStats(btTaskSchedulerStats& stats) const BT_OVERRIDE
+	{
+		stats = btTaskSchedulerStats();
+		stats.m_numParallelFor = m_numParallelFor;
+		stats.m_numJobs = m_numJobsSubmitted;
+		for (int i = kFirstWorkerThreadId; i < m_threadLocalStorage.size(); ++i)
+		{
+			ThreadLocalStorage& storage = const_cast<ThreadLocalStorage&>(m_threadLocalStorage[i]);
+			storage.m_mutex.lock();
+			stats.m_numWakeups += storage.m_numWakeups;
+			stats.m_numSpinHits += storage.m_numSpinHits;
+			stats.m_numSleeps += storage.m_numSleeps;
+			stats.m_idleMicroseconds += storage.m_idleTime;
+			storage.m_mutex.unlock();
+		}
+	}
+
+	virtual void resetStats() BT_OVERRIDE
+	{
+		m_numParallelFor = 0;
+		m_numJobsSubmitted = 0;
+		for (int i = kFirstWorkerThreadId; i < m_threadLocalStorage.size(); ++i)
+		{
+			ThreadLocalStorage& storage = m_threadLocalStorage[i];
+			storage.m_mutex.lock();
+			storage.m_numWakeups = 0;
+			storage.m_numSpinHits = 0;
+			storage.m_numSleeps = 0;
+			storage.m_idleTime = 0;
+			storage.m_mutex.unlock();
+		}
+	}
+
 	void prepareWorkerThreads()
 	{
-		for (int i = kFirstWorkerThreadId; i < m_numThreads; ++i)
+		for (int i = kFirstWorkerThreadId; i < m_threadLocalStorage.size(); ++i)
 		{
 			ThreadLocalStorage& storage = m_threadLocalStorage[i];
 			storage.m_mutex.lock();
@@ -664,6 +798,8 @@ public:
 			typedef ParallelForJob JobType;
 			int jobCount = (iterationCount + grainSize - 1) / grainSize;
 			m_numJobs = jobCount;
+			m_numParallelFor++;
+			m_numJobsSubmitted += jobCount;
 			btAssert(jobCount >= 2);  // need more than one job for multithreading
 			int jobSize = sizeof(JobType);
 
@@ -717,6 +853,8 @@ public:
 			typedef ParallelSumJob JobType;
 			int jobCount = (iterationCount + grainSize - 1) / grainSize;
 			m_numJobs = jobCount;
+			m_numParallelFor++;
+			m_numJobsSubmitted += jobCount;
 			btAssert(jobCount >= 2);  // need more than one job for multithreading
 			int jobSize = sizeof(JobType);
 			for (int i = 0; i < m_numActiveJobQueues; ++i)
@@ -724,8 +862,8 @@ public:
 				m_jobQueues[i].clearQueue(jobCount, jobSize);
 			}
 
-			// initialize summation
-			for (int iThread = 0; iThread < m_numThreads; ++iThread)
+			// initialize summation, of every slot like the job counts in waitJobs
+			for (int iThread = 0; iThread < m_threadLocalStorage.size(); ++iThread)
 			{
 				m_threadLocalStorage[iThread].m_sumResult = btScalar(0);
 			}
@@ -759,7 +897,7 @@ public:
 
 			// add up all the thread sums
 			btScalar sum = btScalar(0);
-			for (int iThread = 0; iThread < m_numThreads; ++iThread)
+			for (int iThread = 0; iThread < m_threadLocalStorage.size(); ++iThread)
 			{
 				sum += m_threadLocalStorage[iThread].m_sumResult;
 			}
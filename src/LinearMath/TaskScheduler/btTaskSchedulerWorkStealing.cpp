@@ -0,0 +1,586 @@
+/*
+Bullet Continuous Collision Detection and Physics Library
+Copyright (c) 2003-2018 Erwin Coumans  http://bulletphysics.com
+
+This software is provided 'as-is', without any express or implied warranty.
+In no event will the authors be held liable for any damages arising from the use of this software.
+Permission is granted to anyone to use this software for any purpose,
+including commercial applications, and to alter it and redistribute it freely,
+subject to the following restrictions:
+
+1. The origin of this software must not be misrepresented; you must not claim that you wrote the original software. If you use this software in a product, an acknowledgment in the product documentation would be appreciated but is not required.
+2. Altered source versions must be plainly marked as such, and must not be misrepresented as being the original software.
+3. This notice may not be removed or altered from any source distribution.
+*/
+
+#include "LinearMath/btMinMax.h"
+#include "LinearMath/btAlignedObjectArray.h"
+#include "LinearMath/btThreads.h"
+#include "LinearMath/btQuickprof.h"
+
+// the work stealing deques need C++11 atomics (with GCC or Clang compile with -std=c++11)
+#if BT_THREADSAFE && (__cplusplus >= 201103L || (defined(_MSC_VER) && _MSC_VER >= 1700))
+
+#include "btThreadSupportInterface.h"
+#include <atomic>
+#include <new>
+
+typedef unsigned long long btU64;
+
+void btSpinPause();  // in btTaskScheduler.cpp
+
+//
+// Chase-Lev work stealing deque of iteration ranges. The owning thread pushes and takes at the bottom,
+// other threads steal from the top. Ranges are split in halves before being worked on, so a deque
+// never holds more than about log2(iterations / grainSize) ranges and a fixed capacity is enough.
+//
+// See "Dynamic Circular Work-Stealing Deque" (Chase, Lev 2005) and
+// "Correct and Efficient Work-Stealing for Weak Memory Models" (Le, Pop, Cohen, Zappa Nardelli 2013).
+//
+ATTRIBUTE_ALIGNED64(class)
+WorkStealingDeque
+{
+	static const int kCapacity = 128;  // must be a power of 2
+
+	std::atomic<long long> m_top;
+	char m_topPadding[64 - sizeof(std::atomic<long long>)];  // thieves write top, owner writes bottom
+	std::atomic<long long> m_bottom;
+	char m_bottomPadding[64 - sizeof(std::atomic<long long>)];
+	std::atomic<btU64> m_ranges[kCapacity];
+
+public:
+	static btU64 packRange(int iBegin, int iEnd) { return (btU64(unsigned(iBegin)) << 32) | btU64(unsigned(iEnd)); }
+	static int rangeBegin(btU64 range) { return int(unsigned(range >> 32)); }
+	static int rangeEnd(btU64 range) { return int(unsigned(range & 0xffffffff)); }
+
+	WorkStealingDeque()
+	{
+		m_top.store(0, std::memory_order_relaxed);
+		m_bottom.store(0, std::memory_order_relaxed);
+		for (int i = 0; i < kCapacity; ++i)
+		{
+			m_ranges[i].store(0, std::memory_order_relaxed);
+		}
+	}
+
+	// owner only
+	void push(btU64 range)
+	{
+		long long b = m_bottom.load(std::memory_order_relaxed);
+		long long t = m_top.load(std::memory_order_acquire);
+		btAssert(b - t < kCapacity);
+		(void)t;
+		m_ranges[b & (kCapacity - 1)].store(range, std::memory_order_relaxed);
+		std::atomic_thread_fence(std::memory_order_release);
+		m_bottom.store(b + 1, std::memory_order_relaxed);
+	}
+
+	// owner only
+	bool take(btU64* range)
+	{
+		long long b = m_bottom.load(std::memory_order_relaxed) - 1;
+		m_bottom.store(b, std::memory_order_relaxed);
+		std::atomic_thread_fence(std::memory_order_seq_cst);
+		long long t = m_top.load(std::memory_order_relaxed);
+		if (t > b)
+		{
+			// empty
+			m_bottom.store(b + 1, std::memory_order_relaxed);
+			return false;
+		}
+		*range = m_ranges[b & (kCapacity - 1)].load(std::memory_order_relaxed);
+		if (t == b)
+		{
+			// last range, race against thieves for it
+			bool won = m_top.compare_exchange_strong(t, t + 1, std::memory_order_seq_cst, std::memory_order_relaxed);
+			m_bottom.store(b + 1, std::memory_order_relaxed);
+			return won;
+		}
+		return true;
+	}
+
+	// any thread
+	bool steal(btU64* range)
+	{
+		long long t = m_top.load(std::memory_order_acquire);
+		std::atomic_thread_fence(std::memory_order_seq_cst);
+		long long b = m_bottom.load(std::memory_order_acquire);
+		if (t >= b)
+		{
+			return false;
+		}
+		*range = m_ranges[t & (kCapacity - 1)].load(std::memory_order_relaxed);
+		return m_top.compare_exchange_strong(t, t + 1, std::memory_order_seq_cst, std::memory_order_relaxed);
+	}
+};
+
+class btTaskSchedulerWorkStealing;
+
+struct WorkStealingWorkerStatus
+{
+	enum Type
+	{
+		kAwake,
+		kSleeping,
+	};
+};
+
+ATTRIBUTE_ALIGNED64(struct)
+WorkStealingThreadStorage
+{
+	btTaskSchedulerWorkStealing* m_scheduler;
+	int m_threadId;
+	unsigned int m_randomState;  // for picking steal victims
+	btScalar m_sumResult;
+	// protected by m_mutex
+	btSpinMutex m_mutex;
+	WorkStealingWorkerStatus::Type m_status;
+	btU64 m_numWakeups;
+	btU64 m_numSpinHits;
+	btU64 m_numSleeps;
+	btU64 m_numSteals;
+	btU64 m_idleTime;
+	// only touched by the owning thread, added to the counters above under m_mutex when it stops working
+	btU64 m_pendingSteals;
+	btU64 m_pendingIdleTime;
+	// spin times in microseconds, protected by m_mutex since setWorkerSpinTime changes them while the worker runs
+	unsigned int m_cooldownTime;
+	unsigned int m_minCooldownTime;
+	unsigned int m_maxCooldownTime;
+	// only touched by the worker thread
+	btU64 m_sleepStartTime;
+};
+
+
+//
+// btTaskSchedulerWorkStealing -- every thread (the main thread included) owns a deque. A parallelFor
+// pushes the whole range on the main thread's deque. Whoever takes a range splits it in halves until it is
+// no larger than the grain size, pushing the upper halves back on its own deque, and then runs it.
+// Idle threads steal the largest pending ranges from the top of other threads' deques, so a thread stuck on
+// an expensive iteration (a big island for example) does not hold up cheap iterations that were
+// queued behind it.
+//
+class btTaskSchedulerWorkStealing : public btITaskScheduler
+{
+	btThreadSupportInterface* m_threadSupport;
+	WorkStealingDeque* m_deques;  // one per thread, not copyable so not in a btAlignedObjectArray
+	btAlignedObjectArray<WorkStealingThreadStorage> m_threadStorage;
+	btSpinMutex m_antiNestingLock;  // prevent nested parallel-for
+	btClock m_clock;
+	int m_numThreads;
+	int m_maxNumThreads;
+
+	// current parallel loop
+	const btIParallelForBody* m_forBody;
+	const btIParallelSumBody* m_sumBody;
+	int m_grainSize;
+	std::atomic<int> m_numIterationsLeft;
+	std::atomic<int> m_isLoopActive;
+	std::atomic<int> m_goToSleep;
+
+	btU64 m_numParallelFor;
+	btU64 m_numJobs;
+	static const int kFirstWorkerThreadId = 1;
+
+	static void workerThreadFunc(void* userPtr)
+	{
+		WorkStealingThreadStorage* storage = static_cast<WorkStealingThreadStorage*>(userPtr);
+		storage->m_scheduler->workerLoop(*storage);
+	}
+
+	void runRange(WorkStealingThreadStorage& storage, btU64 range)
+	{
+		int iBegin = WorkStealingDeque::rangeBegin(range);
+		int iEnd = WorkStealingDeque::rangeEnd(range);
+		WorkStealingDeque& deque = m_deques[storage.m_threadId];
+		// split off the upper halves for other threads to steal
+		while (iEnd - iBegin > m_grainSize)
+		{
+			int iMid = iBegin + (iEnd - iBegin) / 2;
+			deque.push(WorkStealingDeque::packRange(iMid, iEnd));
+			iEnd = iMid;
+		}
+		if (m_forBody)
+		{
+			m_forBody->forLoop(iBegin, iEnd);
+		}
+		else
+		{
+			storage.m_sumResult += m_sumBody->sumLoop(iBegin, iEnd);
+		}
+		m_numIterationsLeft.fetch_sub(iEnd - iBegin, std::memory_order_acq_rel);
+	}
+
+	bool findRange(WorkStealingThreadStorage& storage, btU64* range)
+	{
+		if (m_deques[storage.m_threadId].take(range))
+		{
+			return true;
+		}
+		// workers above the active thread count, left over from a setNumThreads that shrank the pool, stay out
+		if (m_numThreads < 2 || storage.m_threadId >= m_numThreads)
+		{
+			return false;
+		}
+		// pick a random victim to start from
+		unsigned int x = storage.m_randomState;
+		x ^= x << 13;
+		x ^= x >> 17;
+		x ^= x << 5;
+		storage.m_randomState = x;
+		int iVictim = int(x % unsigned(m_numThreads));
+		for (int i = 0; i < m_numThreads; ++i)
+		{
+			if (iVictim != storage.m_threadId && m_deques[iVictim].steal(range))
+			{
+				storage.m_pendingSteals++;
+				return true;
+			}
+			iVictim = (iVictim + 1 < m_numThreads) ? iVictim + 1 : 0;
+		}
+		return false;
+	}
+
+	void workerLoop(WorkStealingThreadStorage& storage)
+	{
+		BT_PROFILE("WorkStealingThreadFunc");
+		btU64 timeAsleep = m_clock.getTimeMicroseconds() - storage.m_sleepStartTime;
+		storage.m_mutex.lock();
+		storage.m_numWakeups++;
+		// same adaptive cooldown as the default task scheduler
+		if (storage.m_sleepStartTime > 0 && timeAsleep < storage.m_maxCooldownTime)
+		{
+			storage.m_cooldownTime = btMin(storage.m_cooldownTime * 2, storage.m_maxCooldownTime);
+		}
+		unsigned int cooldownTime = storage.m_cooldownTime;
+		storage.m_mutex.unlock();
+		btU64 idleStart = m_clock.getTimeMicroseconds();
+		while (true)
+		{
+			btU64 range;
+			if (findRange(storage, &range))
+			{
+				storage.m_pendingIdleTime += m_clock.getTimeMicroseconds() - idleStart;
+				runRange(storage, range);
+				while (m_deques[storage.m_threadId].take(&range))
+				{
+					runRange(storage, range);
+				}
+				idleStart = m_clock.getTimeMicroseconds();
+				continue;
+			}
+			btSpinPause();
+			if (m_isLoopActive.load(std::memory_order_acquire))
+			{
+				// more work may show up on other deques any moment
+				continue;
+			}
+			btU64 timeIdle = m_clock.getTimeMicroseconds() - idleStart;
+			bool sleepNow = m_goToSleep.load(std::memory_order_acquire) != 0;
+			if (!sleepNow && timeIdle <= cooldownTime)
+			{
+				continue;
+			}
+			storage.m_mutex.lock();
+			if (m_isLoopActive.load(std::memory_order_acquire) && !m_goToSleep.load(std::memory_order_acquire))
+			{
+				// a loop started while we were deciding to sleep, parallelFor saw us awake so don't sleep now
+				storage.m_numSpinHits++;
+				cooldownTime = storage.m_cooldownTime;
+				storage.m_mutex.unlock();
+				continue;
+			}
+			storage.m_status = WorkStealingWorkerStatus::kSleeping;
+			storage.m_idleTime += storage.m_pendingIdleTime + m_clock.getTimeMicroseconds() - idleStart;
+			storage.m_numSteals += storage.m_pendingSteals;
+			storage.m_pendingIdleTime = 0;
+			storage.m_pendingSteals = 0;
+			storage.m_numSleeps++;
+			if (!sleepNow)
+			{
+				// spun for the whole cooldown without finding work, spin less next time
+				storage.m_cooldownTime = btMax(storage.m_cooldownTime / 2, storage.m_minCooldownTime);
+			}
+			storage.m_mutex.unlock();
+			break;
+		}
+		storage.m_sleepStartTime = m_clock.getTimeMicroseconds();
+	}
+
+	void wakeWorkers(int numWorkersToWake)
+	{
+		BT_PROFILE("wakeWorkers");
+		int numWoken = 0;
+		for (int i = kFirstWorkerThreadId; i < m_numThreads && numWoken < numWorkersToWake; ++i)
+		{
+			WorkStealingThreadStorage& storage = m_threadStorage[i];
+			storage.m_mutex.lock();
+			bool isSleeping = (storage.m_status == WorkStealingWorkerStatus::kSleeping);
+			if (isSleeping)
+			{
+				storage.m_status = WorkStealingWorkerStatus::kAwake;
+			}
+			else
+			{
+				// spinning workers between loops pick up work on their own
+				storage.m_numSpinHits++;
+			}
+			storage.m_mutex.unlock();
+			if (isSleeping)
+			{
+				m_threadSupport->runTask(i - kFirstWorkerThreadId, &storage);
+			}
+			numWoken++;
+		}
+	}
+
+	void runLoop(int iBegin, int iEnd, int grainSize)
+	{
+		int iterationCount = iEnd - iBegin;
+		int numJobs = (iterationCount + grainSize - 1) / grainSize;
+		m_numParallelFor++;
+		m_numJobs += numJobs;
+		m_grainSize = grainSize;
+		m_numIterationsLeft.store(iterationCount, std::memory_order_relaxed);
+		m_goToSleep.store(0, std::memory_order_relaxed);
+		// publishes the loop body and grain size to the workers
+		m_isLoopActive.store(1, std::memory_order_release);
+
+		WorkStealingThreadStorage& mainStorage = m_threadStorage[0];
+		WorkStealingDeque& mainDeque = m_deques[0];
+		mainDeque.push(WorkStealingDeque::packRange(iBegin, iEnd));
+		wakeWorkers(btMin(numJobs - 1, m_numThreads - 1));
+
+		// the main thread works too, until every iteration is done
+		while (m_numIterationsLeft.load(std::memory_order_acquire) > 0)
+		{
+			btU64 range;
+			if (findRange(mainStorage, &range))
+			{
+				runRange(mainStorage, range);
+			}
+			else
+			{
+				btSpinPause();
+			}
+		}
+		m_isLoopActive.store(0, std::memory_order_release);
+		mainStorage.m_mutex.lock();
+		mainStorage.m_numSteals += mainStorage.m_pendingSteals;
+		mainStorage.m_mutex.unlock();
+		mainStorage.m_pendingSteals = 0;
+	}
+
+public:
+	btTaskSchedulerWorkStealing() : btITaskScheduler("WorkStealing")
+	{
+		m_threadSupport = NULL;
+		m_deques = NULL;
+		m_forBody = NULL;
+		m_sumBody = NULL;
+		m_grainSize = 1;
+		m_numIterationsLeft.store(0);
+		m_isLoopActive.store(0);
+		m_goToSleep.store(1);
+		m_numParallelFor = 0;
+		m_numJobs = 0;
+	}
+
+	virtual ~btTaskSchedulerWorkStealing()
+	{
+		if (m_threadSupport)
+		{
+			m_goToSleep.store(1, std::memory_order_release);
+			m_threadSupport->waitForAllTasks();
+			delete m_threadSupport;
+			m_threadSupport = NULL;
+		}
+		if (m_deques)
+		{
+			for (int i = 0; i < m_maxNumThreads; ++i)
+			{
+				m_deques[i].~WorkStealingDeque();
+			}
+			btAlignedFree(m_deques);
+			m_deques = NULL;
+		}
+	}
+
+	void init()
+	{
+		btThreadSupportInterface::ConstructionInfo constructionInfo("WorkStealingTaskScheduler", workerThreadFunc);
+		m_threadSupport = btThreadSupportInterface::create(constructionInfo);
+		m_maxNumThreads = m_threadSupport->getNumWorkerThreads() + 1;
+		m_deques = static_cast<WorkStealingDeque*>(btAlignedAlloc(sizeof(WorkStealingDeque) * m_maxNumThreads, 64));
+		for (int i = 0; i < m_maxNumThreads; ++i)
+		{
+			new (&m_deques[i]) WorkStealingDeque();
+		}
+		m_threadStorage.resize(m_maxNumThreads);
+		for (int i = 0; i < m_maxNumThreads; ++i)
+		{
+			WorkStealingThreadStorage& storage = m_threadStorage[i];
+			storage.m_scheduler = this;
+			storage.m_threadId = i;
+			storage.m_randomState = 2463534242u + 977u * unsigned(i);
+			storage.m_sumResult = btScalar(0);
+			storage.m_status = WorkStealingWorkerStatus::kSleeping;
+			storage.m_numWakeups = 0;
+			storage.m_numSpinHits = 0;
+			storage.m_numSleeps = 0;
+			storage.m_numSteals = 0;
+			storage.m_idleTime = 0;
+			storage.m_pendingSteals = 0;
+			storage.m_pendingIdleTime = 0;
+			storage.m_cooldownTime = 100;  // 100 microseconds, like the default task scheduler
+			storage.m_minCooldownTime = storage.m_cooldownTime;
+			storage.m_maxCooldownTime = storage.m_cooldownTime;
+			storage.m_sleepStartTime = 0;
+		}
+		setNumThreads(m_threadSupport->getCacheFriendlyNumThreads());
+	}
+
+	virtual int getMaxNumThreads() const BT_OVERRIDE
+	{
+		return m_maxNumThreads;
+	}
+
+	virtual int getNumThreads() const BT_OVERRIDE
+	{
+		return m_numThreads;
+	}
+
+	virtual void setNumThreads(int numThreads) BT_OVERRIDE
+	{
+		m_numThreads = btMax(btMin(numThreads, m_maxNumThreads), 1);
+	}
+
+	virtual void sleepWorkerThreadsHint() BT_OVERRIDE
+	{
+		BT_PROFILE("sleepWorkerThreadsHint");
+		m_goToSleep.store(1, std::memory_order_release);
+	}
+
+	virtual void wakeWorkerThreadsHint() BT_OVERRIDE
+	{
+		BT_PROFILE("wakeWorkerThreadsHint");
+		m_goToSleep.store(0, std::memory_order_release);
+		wakeWorkers(m_numThreads - 1);
+	}
+
+	virtual void setWorkerSpinTime(unsigned int minMicroseconds, unsigned int maxMicroseconds) BT_OVERRIDE
+	{
+		unsigned int maxTime = btMax(minMicroseconds, maxMicroseconds);
+		for (int i = 0; i < m_threadStorage.size(); ++i)
+		{
+			WorkStealingThreadStorage& storage = m_threadStorage[i];
+			storage.m_mutex.lock();
+			storage.m_minCooldownTime = minMicroseconds;
+			storage.m_maxCooldownTime = maxTime;
+			storage.m_cooldownTime = btMax(btMin(storage.m_cooldownTime, maxTime), minMicroseconds);
+			storage.m_mutex.unlock();
+		}
+	}
+
+	virtual void getStats(btTaskSchedulerStats& stats) const BT_OVERRIDE
+	{
+		stats = btTaskSchedulerStats();
+		stats.m_numParallelFor = m_numParallelFor;
+		stats.m_numJobs = m_numJobs;
+		for (int i = 0; i < m_threadStorage.size(); ++i)
+		{
+			WorkStealingThreadStorage& storage = const_cast<WorkStealingThreadStorage&>(m_threadStorage[i]);
+			storage.m_mutex.lock();
+			stats.m_numWakeups += storage.m_numWakeups;
+			stats.m_numSpinHits += storage.m_numSpinHits;
+			stats.m_numSleeps += storage.m_numSleeps;
+			stats.m_numSteals += storage.m_numSteals;
+			stats.m_idleMicroseconds += storage.m_idleTime;
+			storage.m_mutex.unlock();
+		}
+	}
+
+	virtual void resetStats() BT_OVERRIDE
+	{
+		m_numParallelFor = 0;
+		m_numJobs = 0;
+		for (int i = 0; i < m_threadStorage.size(); ++i)
+		{
+			WorkStealingThreadStorage& storage = m_threadStorage[i];
+			storage.m_mutex.lock();
+			storage.m_numWakeups = 0;
+			storage.m_numSpinHits = 0;
+			storage.m_numSleeps = 0;
+			storage.m_numSteals = 0;
+			storage.m_idleTime = 0;
+			storage.m_mutex.unlock();
+		}
+	}
+
+	virtual void parallelFor(int iBegin, int iEnd, int grainSize, const btIParallelForBody& body) BT_OVERRIDE
+	{
+		BT_PROFILE("parallelFor_WorkStealing");
+		btAssert(iEnd >= iBegin);
+		btAssert(grainSize >= 1);
+		if (iEnd - iBegin > grainSize && m_numThreads > 1 && m_antiNestingLock.tryLock())
+		{
+			m_forBody = &body;
+			m_sumBody = NULL;
+			runLoop(iBegin, iEnd, grainSize);
+			m_antiNestingLock.unlock();
+		}
+		else
+		{
+			BT_PROFILE("parallelFor_mainThread");
+			// just run on main thread
+			body.forLoop(iBegin, iEnd);
+		}
+	}
+
+	virtual btScalar parallelSum(int iBegin, int iEnd, int grainSize, const btIParallelSumBody& body) BT_OVERRIDE
+	{
+		BT_PROFILE("parallelSum_WorkStealing");
+		btAssert(iEnd >= iBegin);
+		btAssert(grainSize >= 1);
+		if (iEnd - iBegin > grainSize && m_numThreads > 1 && m_antiNestingLock.tryLock())
+		{
+			// every slot, a worker that was active before setNumThreads shrank the pool may still run a range
+			for (int i = 0; i < m_threadStorage.size(); ++i)
+			{
+				m_threadStorage[i].m_sumResult = btScalar(0);
+			}
+			m_forBody = NULL;
+			m_sumBody = &body;
+			runLoop(iBegin, iEnd, grainSize);
+			btScalar sum = btScalar(0);
+			for (int i = 0; i < m_threadStorage.size(); ++i)
+			{
+				sum += m_threadStorage[i].m_sumResult;
+			}
+			m_antiNestingLock.unlock();
+			return sum;
+		}
+		else
+		{
+			BT_PROFILE("parallelSum_mainThread");
+			// just run on main thread
+			return body.sumLoop(iBegin, iEnd);
+		}
+	}
+};
+
+btITaskScheduler* btCreateWorkStealingTaskScheduler()
+{
+	btTaskSchedulerWorkStealing* ts = new btTaskSchedulerWorkStealing();
+	ts->init();
+	return ts;
+}
+
+#else  // #if BT_THREADSAFE && C++11
+
+btITaskScheduler* btCreateWorkStealingTaskScheduler()
+{
+	return NULL;
+}
+
+#endif
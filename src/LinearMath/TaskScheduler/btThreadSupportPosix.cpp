@@ -230,20 +230,25 @@ int btThreadSupportPosix::waitForResponse()
 
 	btAssert(m_activeThreadStatus.size());
 
-	// wait for any of the threads to finish
-	checkPThreadFunction(sem_wait(m_mainSemaphore));
-	// get at least one thread which has finished
 	size_t last = -1;
 
-	for (size_t t = 0; t < size_t(m_activeThreadStatus.size()); ++t)
+	// a thread started again by runTask before its previous task was collected posts once for each task, but shows one
+	// finished status, so a post may find no finished thread. Wait for the next one then.
+	while (last == size_t(-1))
 	{
-		m_cs->lock();
-		bool hasFinished = (2 == m_activeThreadStatus[t].m_status);
-		m_cs->unlock(); 
-		if (hasFinished)
+		// wait for any of the threads to finish
+		checkPThreadFunction(sem_wait(m_mainSemaphore));
+		// get at least one thread which has finished
+		for (size_t t = 0; t < size_t(m_activeThreadStatus.size()); ++t)
 		{
-			last = t;
-			break;
+			m_cs->lock();
+			bool hasFinished = (2 == m_activeThreadStatus[t].m_status);
+			m_cs->unlock();
+			if (hasFinished)
+			{
+				last = t;
+				break;
+			}
 		}
 	}
 
@@ -30,11 +30,12 @@ class btPoolAllocator
 	btSpinMutex m_mutex;  // only used if BT_THREADSAFE
 
 public:
-	btPoolAllocator(int elemSize, int maxElements)
+	///the elements keep the alignment of the pool when elemSize is a multiple of it
+	btPoolAllocator(int elemSize, int maxElements, int alignment = 16)
 		: m_elemSize(elemSize),
 		  m_maxElements(maxElements)
 	{
-		m_pool = (unsigned char*)btAlignedAlloc(static_cast<unsigned int>(m_elemSize * m_maxElements), 16);
+		m_pool = (unsigned char*)btAlignedAlloc(static_cast<unsigned int>(m_elemSize * m_maxElements), alignment);
 
 		unsigned char* p = m_pool;
 		m_firstFree = p;
@@ -103,6 +103,12 @@ void btSpinMutex::unlock()
 	std::atomic_store_explicit(aDest, int(0), std::memory_order_release);
 }
 
+bool btAtomicCompareAndSwapInternal(int* dest, int expected, int desired)
+{
+	std::atomic<int>* aDest = reinterpret_cast<std::atomic<int>*>(dest);
+	return std::atomic_compare_exchange_strong_explicit(aDest, &expected, desired, std::memory_order_acq_rel, std::memory_order_acquire);
+}
+
 #elif USE_MSVC_INTRINSICS
 
 #define WIN32_LEAN_AND_MEAN
@@ -133,6 +139,12 @@ void btSpinMutex::unlock()
 	_InterlockedExchange(aDest, 0);
 }
 
+bool btAtomicCompareAndSwapInternal(int* dest, int expected, int desired)
+{
+	volatile long* aDest = reinterpret_cast<long*>(dest);
+	return (expected == _InterlockedCompareExchange(aDest, desired, expected));
+}
+
 #elif USE_GCC_BUILTIN_ATOMICS
 
 #define THREAD_LOCAL_STATIC static __thread
@@ -160,6 +172,12 @@ void btSpinMutex::unlock()
 	__atomic_store_n(&mLock, int(0), __ATOMIC_RELEASE);
 }
 
+bool btAtomicCompareAndSwapInternal(int* dest, int expected, int desired)
+{
+	bool weak = false;
+	return __atomic_compare_exchange_n(dest, &expected, desired, weak, __ATOMIC_ACQ_REL, __ATOMIC_ACQUIRE);
+}
+
 #elif USE_GCC_BUILTIN_ATOMICS_OLD
 
 #define THREAD_LOCAL_STATIC static __thread
@@ -184,6 +202,11 @@ void btSpinMutex::unlock()
 	__sync_fetch_and_and(&mLock, int(0));
 }
 
+bool btAtomicCompareAndSwapInternal(int* dest, int expected, int desired)
+{
+	return __sync_bool_compare_and_swap(dest, expected, desired);
+}
+
 #else  //#elif USE_MSVC_INTRINSICS
 
 #error "no threading primitives defined -- unknown platform"
@@ -209,6 +232,16 @@ bool btSpinMutex::tryLock()
 	return true;
 }
 
+bool btAtomicCompareAndSwapInternal(int* dest, int expected, int desired)
+{
+	if (*dest == expected)
+	{
+		*dest = desired;
+		return true;
+	}
+	return false;
+}
+
 #define THREAD_LOCAL_STATIC static
 
 #endif  // #else //#if BT_THREADSAFE
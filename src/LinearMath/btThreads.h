@@ -95,6 +95,27 @@ SIMD_FORCE_INLINE bool btMutexTryLock(btSpinMutex* mutex)
 #endif  // #if BT_THREADSAFE
 }
 
+//
+// btAtomicCompareAndSwap -- for internal Bullet use only. If *dest equals expected it is set to desired and
+//                          true is returned, otherwise *dest is left alone and false is returned.
+//                          A plain compare and assign when BT_THREADSAFE is 0.
+//
+bool btAtomicCompareAndSwapInternal(int* dest, int expected, int desired);
+
+SIMD_FORCE_INLINE bool btAtomicCompareAndSwap(int* dest, int expected, int desired)
+{
+#if BT_THREADSAFE
+	return btAtomicCompareAndSwapInternal(dest, expected, desired);
+#else
+	if (*dest == expected)
+	{
+		*dest = desired;
+		return true;
+	}
+	return false;
+#endif  // #if BT_THREADSAFE
+}
+
 //
 // btIParallelForBody -- subclass this to express work that can be done in parallel
 //
@@ -116,6 +137,31 @@ public:
 	virtual btScalar sumLoop(int iBegin, int iEnd) const = 0;
 };
 
+//
+// btTaskSchedulerStats -- counters reported by btITaskScheduler::getStats()
+//
+struct btTaskSchedulerStats
+{
+	unsigned long long m_numParallelFor;    // parallelFor/parallelSum calls dispatched to worker threads
+	unsigned long long m_numJobs;           // jobs submitted to worker threads
+	unsigned long long m_numWakeups;        // times a sleeping worker thread had to be woken up
+	unsigned long long m_numSpinHits;       // times a spinning worker thread found new work without sleeping
+	unsigned long long m_numSleeps;         // times a worker thread went back to sleep
+	unsigned long long m_idleMicroseconds;  // time worker threads spent spinning on an empty job queue
+	unsigned long long m_numSteals;         // jobs taken from another thread's queue (work stealing scheduler only)
+
+	btTaskSchedulerStats()
+	{
+		m_numParallelFor = 0;
+		m_numJobs = 0;
+		m_numWakeups = 0;
+		m_numSpinHits = 0;
+		m_numSleeps = 0;
+		m_idleMicroseconds = 0;
+		m_numSteals = 0;
+	}
+};
+
 //
 // btITaskScheduler -- subclass this to implement a task scheduler that can dispatch work to
 //                     worker threads
@@ -133,6 +179,12 @@ public:
 	virtual void parallelFor(int iBegin, int iEnd, int grainSize, const btIParallelForBody& body) = 0;
 	virtual btScalar parallelSum(int iBegin, int iEnd, int grainSize, const btIParallelSumBody& body) = 0;
 	virtual void sleepWorkerThreadsHint() {}  // hint the task scheduler that we may not be using these threads for a little while
+	virtual void wakeWorkerThreadsHint() {}   // hint the task scheduler that parallel work is coming soon, so sleeping threads can be woken early
+	// time worker threads spin on an empty job queue before going to sleep. If minMicroseconds < maxMicroseconds the
+	// time adapts between the two: it grows when a thread is woken up shortly after falling asleep and shrinks when spinning was wasted
+	virtual void setWorkerSpinTime(unsigned int minMicroseconds, unsigned int maxMicroseconds) {}
+	virtual void getStats(btTaskSchedulerStats& stats) const { stats = btTaskSchedulerStats(); }
+	virtual void resetStats() {}
 
 	// internal use only
 	virtual void activate();
@@ -157,6 +209,11 @@ btITaskScheduler* btGetSequentialTaskScheduler();
 // create a default task scheduler (Win32 or pthreads based)
 btITaskScheduler* btCreateDefaultTaskScheduler();
 
+// create a work stealing task scheduler (Win32 or pthreads based, needs C++11 atomics, otherwise returns null)
+// each thread splits loop ranges on its own deque and idle threads steal from the others, which balances
+// loops with very uneven iterations better than the default task scheduler
+btITaskScheduler* btCreateWorkStealingTaskScheduler();
+
 // get OpenMP task scheduler (if available, otherwise returns null)
 btITaskScheduler* btGetOpenMPTaskScheduler();
 
@@ -53,6 +53,8 @@ subject to the following restrictions:
 #include "BulletCollision/BroadphaseCollision/btSimpleBroadphase.h"
 #include "BulletCollision/BroadphaseCollision/btAxisSweep3.h"
 #include "BulletCollision/BroadphaseCollision/btDbvtBroadphase.h"
+#include "BulletCollision/BroadphaseCollision/btSapBroadphase.h"
+#include "BulletCollision/BroadphaseCollision/btGridBroadphase.h"
 
 ///Math library & Utils
 #include "LinearMath/btQuaternion.h"
@@ -0,0 +1,298 @@
+/*
+Bullet Continuous Collision Detection and Physics Library
+Copyright (c) 2003-2018 Erwin Coumans  https://bulletphysics.org
+
+This software is provided 'as-is', without any express or implied warranty.
+In no event will the authors be held liable for any damages arising from the use of this software.
+Permission is granted to anyone to use this software for any purpose,
+including commercial applications, and to alter it and redistribute it freely,
+subject to the following restrictions:
+
+1. The origin of this software must not be misrepresented; you must not claim that you wrote the original software. If you use this software in a product, an acknowledgment in the product documentation would be appreciated but is not required.
+2. Altered source versions must be plainly marked as such, and must not be misrepresented as being the original software.
+3. This notice may not be removed or altered from any source distribution.
+*/
+
+#ifndef BROADPHASE_TEST_SCENE_H
+#define BROADPHASE_TEST_SCENE_H
+
+#include <BulletCollision/BroadphaseCollision/btBroadphaseInterface.h>
+#include <BulletCollision/BroadphaseCollision/btHashedOverlappingPairCacheMt.h>
+#include <LinearMath/btAabbUtil2.h>
+#include <LinearMath/btThreads.h>
+#include <gtest/gtest.h>
+
+#include "ThreadTest.h"
+
+// the same pairs in the same order, compared by uid so that the proxies of two scenes can be compared
+inline bool samePairOrder(btOverlappingPairCache* a, btOverlappingPairCache* b)
+{
+	if (a->getNumOverlappingPairs() != b->getNumOverlappingPairs())
+	{
+		return false;
+	}
+	for (int i = 0; i < a->getNumOverlappingPairs(); ++i)
+	{
+		const btBroadphasePair& pairA = a->getOverlappingPairArray()[i];
+		const btBroadphasePair& pairB = b->getOverlappingPairArray()[i];
+		if (pairA.m_pProxy0->getUid() != pairB.m_pProxy0->getUid() || pairA.m_pProxy1->getUid() != pairB.m_pProxy1->getUid())
+		{
+			return false;
+		}
+	}
+	return true;
+}
+
+struct PairKeyLess
+{
+	bool operator()(long long a, long long b) const { return a < b; }
+};
+
+// the same pairs in any order, compared by uid
+inline bool samePairs(btOverlappingPairCache* a, btOverlappingPairCache* b)
+{
+	btAlignedObjectArray<long long> keys[2];
+	btOverlappingPairCache* caches[2] = {a, b};
+	for (int c = 0; c < 2; ++c)
+	{
+		const btBroadphasePairArray& pairs = caches[c]->getOverlappingPairArray();
+		for (int i = 0; i < pairs.size(); ++i)
+		{
+			long long uid0 = pairs[i].m_pProxy0->getUid();
+			long long uid1 = pairs[i].m_pProxy1->getUid();
+			keys[c].push_back(uid0 < uid1 ? (uid0 << 32) | uid1 : (uid1 << 32) | uid0);
+		}
+		keys[c].quickSort(PairKeyLess());
+	}
+	if (keys[0].size() != keys[1].size())
+	{
+		return false;
+	}
+	for (int i = 0; i < keys[0].size(); ++i)
+	{
+		if (keys[0][i] != keys[1][i])
+		{
+			return false;
+		}
+	}
+	return true;
+}
+
+inline bool proxiesOverlap(const btBroadphaseProxy* proxy0, const btBroadphaseProxy* proxy1)
+{
+	return TestAabbAgainstAabb2(proxy0->m_aabbMin, proxy0->m_aabbMax, proxy1->m_aabbMin, proxy1->m_aabbMax);
+}
+
+///Proxies in a 60 x 30 x 60 box, moved, destroyed and created again at random with a fixed seed, so that two scenes
+///with the same settings do the same. The settings are set by the derived scenes before createProxies.
+template <class Broadphase>
+struct BroadphaseTestScene
+{
+	Broadphase* m_broadphase;
+	btAlignedObjectArray<btBroadphaseProxy*> m_proxies;  // NULL where a proxy was destroyed
+	unsigned int m_seed;
+	btVector3 m_origin;          // lowest corner of the box of the centers
+	btScalar m_minHalfExtent;    // the half extents are up to m_halfExtentRange larger than this
+	btScalar m_halfExtentRange;
+	int m_largePercent;          // proxies from a few to a hundred times larger than the others
+
+	BroadphaseTestScene(Broadphase* broadphase)
+		: m_broadphase(broadphase), m_seed(12345), m_origin(0, 0, 0), m_minHalfExtent(btScalar(0.5)), m_halfExtentRange(btScalar(1)), m_largePercent(0)
+	{
+	}
+
+	~BroadphaseTestScene()
+	{
+		delete m_broadphase;
+	}
+
+	void createProxies(int numProxies)
+	{
+		for (int i = 0; i < numProxies; ++i)
+		{
+			m_proxies.push_back(0);
+			create(m_proxies.size() - 1);
+		}
+	}
+
+	btScalar unitRand()
+	{
+		m_seed = m_seed * 1664525u + 1013904223u;
+		return btScalar(m_seed >> 8) / btScalar(1 << 24);
+	}
+
+	btVector3 randomPoint()
+	{
+		return m_origin + btVector3(unitRand(), unitRand() * btScalar(0.5), unitRand()) * btScalar(60);
+	}
+
+	void getAabb(const btVector3& center, btVector3& aabbMin, btVector3& aabbMax)
+	{
+		btVector3 halfExtents(m_minHalfExtent + unitRand() * m_halfExtentRange, m_minHalfExtent + unitRand() * m_halfExtentRange, m_minHalfExtent + unitRand() * m_halfExtentRange);
+		if (int(unitRand() * 100) < m_largePercent)
+		{
+			halfExtents *= btScalar(2) + unitRand() * unitRand() * btScalar(100);
+		}
+		aabbMin = center - halfExtents;
+		aabbMax = center + halfExtents;
+	}
+
+	void create(int index)
+	{
+		btVector3 aabbMin, aabbMax;
+		getAabb(randomPoint(), aabbMin, aabbMax);
+		m_proxies[index] = m_broadphase->createProxy(aabbMin, aabbMax, BOX_SHAPE_PROXYTYPE, NULL, btBroadphaseProxy::DefaultFilter, btBroadphaseProxy::AllFilter, NULL);
+	}
+
+	// every proxy moves a little with probability 'movePercent', jumps with 'jumpPercent' and is destroyed and created again with 'respawnPercent'
+	void move(int movePercent, int jumpPercent, int respawnPercent)
+	{
+		for (int i = 0; i < m_proxies.size(); ++i)
+		{
+			int r = int(unitRand() * 100);
+			btBroadphaseProxy* proxy = m_proxies[i];
+			btVector3 aabbMin, aabbMax;
+			if (proxy == NULL)
+			{
+				if (r < 50)
+				{
+					create(i);
+				}
+			}
+			else if (r < respawnPercent)
+			{
+				m_broadphase->destroyProxy(proxy, NULL);
+				m_proxies[i] = 0;
+				if (unitRand() < btScalar(0.5))
+				{
+					create(i);
+				}
+			}
+			else if (r < respawnPercent + jumpPercent)
+			{
+				getAabb(randomPoint(), aabbMin, aabbMax);
+				m_broadphase->setAabb(proxy, aabbMin, aabbMax, NULL);
+			}
+			else if (r < respawnPercent + jumpPercent + movePercent)
+			{
+				btVector3 delta(unitRand() - btScalar(0.5), unitRand() - btScalar(0.5), unitRand() - btScalar(0.5));
+				m_broadphase->setAabb(proxy, proxy->m_aabbMin + delta, proxy->m_aabbMax + delta, NULL);
+			}
+		}
+	}
+
+	void step(int movePercent, int jumpPercent, int respawnPercent)
+	{
+		move(movePercent, jumpPercent, respawnPercent);
+		m_broadphase->calculateOverlappingPairs(NULL);
+	}
+
+	int countOverlaps() const
+	{
+		int count = 0;
+		for (int i = 0; i < m_proxies.size(); ++i)
+		{
+			for (int j = i + 1; j < m_proxies.size(); ++j)
+			{
+				if (m_proxies[i] && m_proxies[j] && proxiesOverlap(m_proxies[i], m_proxies[j]))
+				{
+					count++;
+				}
+			}
+		}
+		return count;
+	}
+
+	// the pair cache holds the overlapping pairs and nothing else
+	bool pairsMatchOverlaps()
+	{
+		btOverlappingPairCache* cache = m_broadphase->getOverlappingPairCache();
+		const btBroadphasePairArray& pairs = cache->getOverlappingPairArray();
+		for (int i = 0; i < pairs.size(); ++i)
+		{
+			if (!proxiesOverlap(pairs[i].m_pProxy0, pairs[i].m_pProxy1))
+			{
+				return false;
+			}
+		}
+		return pairs.size() == countOverlaps();
+	}
+
+	// every overlapping pair is in the pair cache, for the broadphases that may keep pairs a while after they separate
+	bool pairsCoverOverlaps()
+	{
+		btOverlappingPairCache* cache = m_broadphase->getOverlappingPairCache();
+		for (int i = 0; i < m_proxies.size(); ++i)
+		{
+			for (int j = i + 1; j < m_proxies.size(); ++j)
+			{
+				if (m_proxies[i] && m_proxies[j] && proxiesOverlap(m_proxies[i], m_proxies[j]) && !cache->findPair(m_proxies[i], m_proxies[j]))
+				{
+					return false;
+				}
+			}
+		}
+		return true;
+	}
+
+	void destroyProxies()
+	{
+		for (int i = 0; i < m_proxies.size(); ++i)
+		{
+			if (m_proxies[i])
+			{
+				m_broadphase->destroyProxy(m_proxies[i], NULL);
+				m_proxies[i] = 0;
+			}
+		}
+	}
+};
+
+///The thread tests of a broadphase, for a scene type constructed from the number of proxies and the pair cache.
+///A test file instantiates them with INSTANTIATE_TYPED_TEST_CASE_P(Name, BroadphaseThreadTest, Scene).
+template <class Scene>
+class BroadphaseThreadTest : public ThreadTest
+{
+};
+
+TYPED_TEST_CASE_P(BroadphaseThreadTest);
+
+TYPED_TEST_P(BroadphaseThreadTest, SamePairsForAnyThreadCount)
+{
+	this->setNumThreads(1);
+	TypeParam single(4000, 0);
+	for (int i = 0; i < 10; ++i)
+	{
+		single.step(20, (i % 3) == 2 ? 30 : 0, 1);
+	}
+	int threadCounts[] = {2, 4, 16};
+	for (int t = 0; t < 3; ++t)
+	{
+		this->setNumThreads(threadCounts[t]);
+		TypeParam multi(4000, 0);
+		for (int i = 0; i < 10; ++i)
+		{
+			multi.step(20, (i % 3) == 2 ? 30 : 0, 1);
+		}
+		EXPECT_TRUE(samePairOrder(single.m_broadphase->getOverlappingPairCache(), multi.m_broadphase->getOverlappingPairCache()));
+	}
+}
+
+TYPED_TEST_P(BroadphaseThreadTest, ConcurrentPairCache)
+{
+	this->setNumThreads(16);
+	btHashedOverlappingPairCacheMt cache;
+	TypeParam scene(3000, &cache);
+	for (int i = 0; i < 10; ++i)
+	{
+		scene.step(20, (i % 3) == 2 ? 30 : 0, 1);
+		EXPECT_TRUE(scene.pairsMatchOverlaps());
+	}
+	// the proxies go before the cache
+	scene.destroyProxies();
+	EXPECT_EQ(0, cache.getNumOverlappingPairs());
+}
+
+REGISTER_TYPED_TEST_CASE_P(BroadphaseThreadTest, SamePairsForAnyThreadCount, ConcurrentPairCache);
+
+#endif  //BROADPHASE_TEST_SCENE_H
@@ -0,0 +1,162 @@
+#include <BulletCollision/CollisionDispatch/btCollisionDispatcher.h>
+#include <BulletCollision/CollisionDispatch/btCollisionWorld.h>
+#include <BulletCollision/CollisionDispatch/btDefaultCollisionConfiguration.h>
+#include <BulletCollision/BroadphaseCollision/btDbvtBroadphase.h>
+#include <BulletCollision/CollisionShapes/btBoxShape.h>
+#include <LinearMath/btPoolAllocator.h>
+#include <gtest/gtest.h>
+
+namespace
+{
+// the dispatcher gives the manifolds of other objects than rigid bodies room for the contacts of a soft body
+struct RigidObject : public btCollisionObject
+{
+	RigidObject()
+	{
+		m_internalType = CO_RIGID_BODY;
+	}
+};
+
+// a row of boxes on a static box, each one touching its neighbors
+struct DispatcherTestScene
+{
+	btDefaultCollisionConfiguration m_config;
+	btCollisionDispatcher m_dispatcher;
+	btDbvtBroadphase m_broadphase;
+	btCollisionWorld m_world;
+	btBoxShape m_groundShape;
+	btBoxShape m_boxShape;
+	RigidObject m_ground;
+	btAlignedObjectArray<btCollisionObject*> m_boxes;
+
+	DispatcherTestScene(int numBoxes, int dispatcherFlags)
+		: m_dispatcher(&m_config),
+		  m_world(&m_dispatcher, &m_broadphase, &m_config),
+		  m_groundShape(btVector3(100, 1, 100)),
+		  m_boxShape(btVector3(1, 1, 1))
+	{
+		m_dispatcher.setDispatcherFlags(m_dispatcher.getDispatcherFlags() | dispatcherFlags);
+		m_ground.setCollisionShape(&m_groundShape);
+		m_ground.getWorldTransform().setOrigin(btVector3(0, -1, 0));
+		m_world.addCollisionObject(&m_ground);
+		for (int i = 0; i < numBoxes; ++i)
+		{
+			btCollisionObject* box = new RigidObject();
+			box->setCollisionShape(&m_boxShape);
+			box->getWorldTransform().setOrigin(btVector3(btScalar(-50 + i * 1.95), btScalar(0.99), 0));
+			m_world.addCollisionObject(box);
+			m_boxes.push_back(box);
+		}
+	}
+
+	~DispatcherTestScene()
+	{
+		for (int i = 0; i < m_boxes.size(); ++i)
+		{
+			m_world.removeCollisionObject(m_boxes[i]);
+			delete m_boxes[i];
+		}
+		m_world.removeCollisionObject(&m_ground);
+	}
+};
+
+TEST(btCollisionDispatcherTest, ManifoldPointsFromPool)
+{
+	DispatcherTestScene scene(40, 0);
+	scene.m_world.performDiscreteCollisionDetection();
+
+	btPoolAllocator* pointPool = scene.m_dispatcher.getInternalManifoldPointPool();
+	int numManifolds = scene.m_dispatcher.getNumManifolds();
+	EXPECT_GE(numManifolds, 40);
+	EXPECT_EQ(pointPool->getUsedCount(), numManifolds);
+	EXPECT_EQ(pointPool->getElementSize() % 64, 0);
+	int numContacts = 0;
+	for (int i = 0; i < numManifolds; ++i)
+	{
+		btPersistentManifold* manifold = scene.m_dispatcher.getManifoldByIndexInternal(i);
+		EXPECT_TRUE(pointPool->validPtr(manifold->getPointCache()));
+		EXPECT_EQ((size_t)manifold->getPointCache() % 64, 0u);
+		EXPECT_EQ(manifold->getCacheSize(), MANIFOLD_CACHE_SIZE);
+		numContacts += manifold->getNumContacts();
+	}
+	EXPECT_GT(numContacts, 0);
+
+	// removing the boxes releases their manifolds and the points go back to the pool
+	for (int i = 0; i < scene.m_boxes.size(); ++i)
+	{
+		scene.m_world.removeCollisionObject(scene.m_boxes[i]);
+	}
+	EXPECT_EQ(scene.m_dispatcher.getNumManifolds(), 0);
+	EXPECT_EQ(pointPool->getUsedCount(), 0);
+	for (int i = 0; i < scene.m_boxes.size(); ++i)
+	{
+		scene.m_world.addCollisionObject(scene.m_boxes[i]);
+	}
+}
+
+TEST(btCollisionDispatcherTest, SameContactsWithoutPool)
+{
+	DispatcherTestScene pooled(40, 0);
+	DispatcherTestScene heap(40, btCollisionDispatcher::CD_DISABLE_MANIFOLD_POINT_POOL);
+	for (int step = 0; step < 3; ++step)
+	{
+		pooled.m_world.performDiscreteCollisionDetection();
+		heap.m_world.performDiscreteCollisionDetection();
+	}
+	EXPECT_EQ(heap.m_dispatcher.getInternalManifoldPointPool()->getUsedCount(), 0);
+	ASSERT_EQ(pooled.m_dispatcher.getNumManifolds(), heap.m_dispatcher.getNumManifolds());
+	for (int i = 0; i < pooled.m_dispatcher.getNumManifolds(); ++i)
+	{
+		const btPersistentManifold* manifold0 = pooled.m_dispatcher.getManifoldByIndexInternal(i);
+		const btPersistentManifold* manifold1 = heap.m_dispatcher.getManifoldByIndexInternal(i);
+		ASSERT_EQ(manifold0->getNumContacts(), manifold1->getNumContacts());
+		for (int j = 0; j < manifold0->getNumContacts(); ++j)
+		{
+			EXPECT_EQ(manifold0->getContactPoint(j).getDistance(), manifold1->getContactPoint(j).getDistance());
+			EXPECT_EQ(manifold0->getContactPoint(j).m_localPointA, manifold1->getContactPoint(j).m_localPointA);
+		}
+	}
+}
+
+TEST(btCollisionDispatcherTest, HeapPointsWhenPoolIsFull)
+{
+	btDefaultCollisionConstructionInfo info;
+	info.m_defaultMaxPersistentManifoldPoolSize = 8;
+	btDefaultCollisionConfiguration config(info);
+	btCollisionDispatcher dispatcher(&config);
+	btBoxShape shape(btVector3(1, 1, 1));
+	RigidObject objects[20];
+	btAlignedObjectArray<btPersistentManifold*> manifolds;
+	for (int i = 0; i < 20; ++i)
+	{
+		objects[i].setCollisionShape(&shape);
+	}
+	for (int i = 0; i + 1 < 20; ++i)
+	{
+		manifolds.push_back(dispatcher.getNewManifold(&objects[i], &objects[i + 1]));
+	}
+	EXPECT_EQ(dispatcher.getInternalManifoldPointPool()->getUsedCount(), 8);
+	for (int i = 0; i < manifolds.size(); ++i)
+	{
+		EXPECT_EQ(dispatcher.getInternalManifoldPointPool()->validPtr(manifolds[i]->getPointCache()), i < 8);
+		btManifoldPoint point(btVector3(0, 0, 0), btVector3(0, 0, 0), btVector3(0, 1, 0), 0);
+		for (int j = 0; j < MANIFOLD_CACHE_SIZE + 1; ++j)
+		{
+			point.m_localPointA.setX(btScalar(j));
+			manifolds[i]->addManifoldPoint(point);
+		}
+		EXPECT_EQ(manifolds[i]->getNumContacts(), MANIFOLD_CACHE_SIZE);
+	}
+	for (int i = 0; i < manifolds.size(); ++i)
+	{
+		dispatcher.releaseManifold(manifolds[i]);
+	}
+	EXPECT_EQ(dispatcher.getInternalManifoldPointPool()->getUsedCount(), 0);
+}
+}  // namespace
+
+int main(int argc, char** argv)
+{
+	::testing::InitGoogleTest(&argc, argv);
+	return RUN_ALL_TESTS();
+}
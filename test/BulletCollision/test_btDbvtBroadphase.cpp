@@ -0,0 +1,183 @@
+/*
+Bullet Continuous Collision Detection and Physics Library
+Copyright (c) 2003-2018 Erwin Coumans  https://bulletphysics.org
+
+This software is provided 'as-is', without any express or implied warranty.
+In no event will the authors be held liable for any damages arising from the use of this software.
+Permission is granted to anyone to use this software for any purpose,
+including commercial applications, and to alter it and redistribute it freely,
+subject to the following restrictions:
+
+1. The origin of this software must not be misrepresented; you must not claim that you wrote the original software. If you use this software in a product, an acknowledgment in the product documentation would be appreciated but is not required.
+2. Altered source versions must be plainly marked as such, and must not be misrepresented as being the original software.
+3. This notice may not be removed or altered from any source distribution.
+*/
+
+#include <BulletCollision/BroadphaseCollision/btDbvtBroadphase.h>
+#include <BulletCollision/BroadphaseCollision/btHashedOverlappingPairCacheMt.h>
+#include <gtest/gtest.h>
+
+#include "BroadphaseTestScene.h"
+
+namespace
+{
+struct DbvtTestScene : public BroadphaseTestScene<btDbvtBroadphase>
+{
+	DbvtTestScene(int numProxies, btOverlappingPairCache* pairCache, bool parallel)
+		: BroadphaseTestScene<btDbvtBroadphase>(new btDbvtBroadphase(pairCache))
+	{
+		m_broadphase->m_deferedcollide = true;
+		m_broadphase->m_parallelcollide = parallel;
+		// all the stale pairs go on every call, so that the pairs do not depend on the order of the pair array
+		m_broadphase->m_cupdates = 100;
+		createProxies(numProxies);
+	}
+};
+
+// the nodes hold the volumes of their children and link back to their parents, 'numLeaves' counts the leaves
+bool validNode(const btDbvtNode* node, const btDbvtNode* parent, int& numLeaves)
+{
+	if (node->parent != parent)
+	{
+		return false;
+	}
+	if (node->isleaf())
+	{
+		const btDbvtProxy* proxy = (const btDbvtProxy*)node->data;
+		numLeaves++;
+		return proxy->leaf == node && node->volume.Contain(btDbvtVolume::FromMM(proxy->m_aabbMin, proxy->m_aabbMax));
+	}
+	return node->volume.Contain(node->childs[0]->volume) && node->volume.Contain(node->childs[1]->volume) &&
+		   validNode(node->childs[0], node, numLeaves) && validNode(node->childs[1], node, numLeaves);
+}
+
+// both trees are valid, and every proxy has its leaf in the tree of its stage
+bool validTrees(const DbvtTestScene& scene)
+{
+	const btDbvtBroadphase* broadphase = scene.m_broadphase;
+	int numProxies = 0;
+	for (int i = 0; i < scene.m_proxies.size(); ++i)
+	{
+		const btDbvtProxy* proxy = (const btDbvtProxy*)scene.m_proxies[i];
+		if (proxy)
+		{
+			const btDbvtNode* root = proxy->leaf;
+			while (root->parent)
+			{
+				root = root->parent;
+			}
+			const int set = proxy->stage == btDbvtBroadphase::STAGECOUNT ? btDbvtBroadphase::FIXED_SET : btDbvtBroadphase::DYNAMIC_SET;
+			if (root != broadphase->m_sets[set].m_root)
+			{
+				return false;
+			}
+			numProxies++;
+		}
+	}
+	for (int s = 0; s < 2; ++s)
+	{
+		const btDbvt& tree = broadphase->m_sets[s];
+		int numLeaves = 0;
+		if (tree.m_root && !validNode(tree.m_root, NULL, numLeaves))
+		{
+			return false;
+		}
+		if (numLeaves != tree.m_leaves)
+		{
+			return false;
+		}
+		numProxies -= numLeaves;
+	}
+	return numProxies == 0;
+}
+
+// small motion with a burst every fifth step, the parallel collide needs DBVT_BP_PARALLEL_MINLEAVES dynamic leaves
+void stepScenes(DbvtTestScene& a, DbvtTestScene& b, int numSteps)
+{
+	for (int i = 0; i < numSteps; ++i)
+	{
+		a.step(40, (i % 5) == 4 ? 30 : 0, 1);
+		b.step(40, (i % 5) == 4 ? 30 : 0, 1);
+		EXPECT_GE(a.m_broadphase->m_sets[btDbvtBroadphase::DYNAMIC_SET].m_leaves, DBVT_BP_PARALLEL_MINLEAVES);
+	}
+}
+
+class DbvtBroadphaseThreadTest : public ThreadTest
+{
+};
+
+}  // namespace
+
+TEST(DbvtBroadphaseTest, ParallelCollideFindsSamePairs)
+{
+	btSetTaskScheduler(btGetSequentialTaskScheduler());
+	DbvtTestScene serial(6000, NULL, false);
+	DbvtTestScene parallel(6000, NULL, true);
+	for (int i = 0; i < 4; ++i)
+	{
+		stepScenes(serial, parallel, 3);
+		EXPECT_GT(parallel.m_broadphase->m_collidetasks.size(), 1);
+		EXPECT_TRUE(parallel.pairsCoverOverlaps());
+		EXPECT_TRUE(samePairs(serial.m_broadphase->getOverlappingPairCache(), parallel.m_broadphase->getOverlappingPairCache()));
+	}
+}
+
+TEST(DbvtBroadphaseTest, BudgetKeepsTreesValid)
+{
+	// budgets too small for the work of one call, so the optimization and the cleanup are carried over
+	int budgets[] = {1, 20, 200};
+	for (int b = 0; b < 3; ++b)
+	{
+		DbvtTestScene scene(2000, NULL, false);
+		scene.m_broadphase->m_cupdates = 10;
+		scene.m_broadphase->m_dupdates = 50;
+		scene.m_broadphase->setOptimizationBudget(budgets[b]);
+		bool carriedOver = false;
+		for (int i = 0; i < 20; ++i)
+		{
+			scene.step(20, (i % 5) == 4 ? 30 : 0, 1);
+			carriedOver = carriedOver || scene.m_broadphase->m_dynamicleft > 0 || scene.m_broadphase->m_cleanupleft > 0;
+			ASSERT_TRUE(validTrees(scene)) << "budget " << budgets[b] << " step " << i;
+			if ((i % 5) == 4)
+			{
+				EXPECT_TRUE(scene.pairsCoverOverlaps()) << "budget " << budgets[b] << " step " << i;
+			}
+			EXPECT_GT(scene.m_broadphase->getOptimizationTime(), 0);
+		}
+		EXPECT_TRUE(carriedOver || budgets[b] > 1);
+		// without the budget the work left is done and the trees stay valid
+		scene.m_broadphase->setOptimizationBudget(0);
+		for (int i = 0; i < 5; ++i)
+		{
+			scene.step(20, 0, 1);
+			ASSERT_TRUE(validTrees(scene));
+		}
+		EXPECT_TRUE(scene.pairsCoverOverlaps());
+	}
+}
+
+TEST_F(DbvtBroadphaseThreadTest, ParallelCollideFindsSamePairs)
+{
+	setNumThreads(1);
+	DbvtTestScene single(6000, NULL, true);
+	DbvtTestScene serial(6000, NULL, false);
+	stepScenes(single, serial, 10);
+	int threadCounts[] = {2, 4, 16};
+	for (int t = 0; t < 3; ++t)
+	{
+		setNumThreads(threadCounts[t]);
+		DbvtTestScene multi(6000, NULL, true);
+		btHashedOverlappingPairCacheMt cache;
+		DbvtTestScene concurrent(6000, &cache, true);
+		stepScenes(multi, concurrent, 10);
+		EXPECT_TRUE(samePairOrder(single.m_broadphase->getOverlappingPairCache(), multi.m_broadphase->getOverlappingPairCache()));
+		EXPECT_TRUE(samePairs(serial.m_broadphase->getOverlappingPairCache(), concurrent.m_broadphase->getOverlappingPairCache()));
+		concurrent.destroyProxies();
+	}
+}
+
+int main(int argc, char** argv)
+{
+	::testing::InitGoogleTest(&argc, argv);
+	return RUN_ALL_TESTS();
+}
@@ -0,0 +1,174 @@
+
+#include <BulletCollision/BroadphaseCollision/btGridBroadphase.h>
+#include <LinearMath/btAabbUtil2.h>
+#include <gtest/gtest.h>
+#include "BroadphaseTestScene.h"
+
+namespace
+{
+// small proxies, a given percentage of them from a few to a hundred times larger
+struct GridTestScene : public BroadphaseTestScene<btGridBroadphase>
+{
+	GridTestScene(int numProxies, btOverlappingPairCache* pairCache = 0, int largePercent = 5, btScalar cellSize = 0)
+		: BroadphaseTestScene<btGridBroadphase>(new btGridBroadphase(cellSize, pairCache))
+	{
+		m_origin = btVector3(-30, -10, -30);
+		m_minHalfExtent = btScalar(0.2);
+		m_halfExtentRange = btScalar(0.3);
+		m_largePercent = largePercent;
+		createProxies(numProxies);
+	}
+
+	int numLevels() const
+	{
+		int count = 0;
+		for (int level = 0; level <= btGridBroadphase::MAX_LEVELS; ++level)
+		{
+			count += m_broadphase->m_levelCellStarts[level + 1] > m_broadphase->m_levelCellStarts[level] ? 1 : 0;
+		}
+		return count;
+	}
+};
+
+// counts the visits of every proxy
+struct CountingAabbCallback : public btBroadphaseAabbCallback
+{
+	btAlignedObjectArray<int> m_visits;
+
+	virtual bool process(const btBroadphaseProxy* proxy)
+	{
+		m_visits[proxy->getUid()]++;
+		return true;
+	}
+};
+
+struct CountingRayCallback : public btBroadphaseRayCallback
+{
+	btAlignedObjectArray<int> m_visits;
+
+	CountingRayCallback(const btVector3& rayFrom, const btVector3& rayTo)
+	{
+		btVector3 direction = (rayTo - rayFrom).normalized();
+		m_rayDirectionInverse[0] = direction[0] == btScalar(0.0) ? btScalar(BT_LARGE_FLOAT) : btScalar(1.0) / direction[0];
+		m_rayDirectionInverse[1] = direction[1] == btScalar(0.0) ? btScalar(BT_LARGE_FLOAT) : btScalar(1.0) / direction[1];
+		m_rayDirectionInverse[2] = direction[2] == btScalar(0.0) ? btScalar(BT_LARGE_FLOAT) : btScalar(1.0) / direction[2];
+		m_signs[0] = m_rayDirectionInverse[0] < 0.0;
+		m_signs[1] = m_rayDirectionInverse[1] < 0.0;
+		m_signs[2] = m_rayDirectionInverse[2] < 0.0;
+		m_lambda_max = direction.dot(rayTo - rayFrom);
+	}
+
+	virtual bool process(const btBroadphaseProxy* proxy)
+	{
+		m_visits[proxy->getUid()]++;
+		return true;
+	}
+};
+
+// every proxy that overlaps the box, or that the ray or the swept box hits, is visited once, and no other one
+void checkQueries(GridTestScene& scene)
+{
+	int maxUid = 0;
+	for (int i = 0; i < scene.m_proxies.size(); ++i)
+	{
+		maxUid = scene.m_proxies[i] ? btMax(maxUid, scene.m_proxies[i]->getUid()) : maxUid;
+	}
+	for (int query = 0; query < 20; ++query)
+	{
+		btVector3 center = scene.randomPoint();
+		btVector3 halfExtents = btVector3(scene.unitRand(), scene.unitRand(), scene.unitRand()) * btScalar(query < 10 ? 2 : 30);
+		CountingAabbCallback aabbCallback;
+		aabbCallback.m_visits.resize(maxUid + 1, 0);
+		scene.m_broadphase->aabbTest(center - halfExtents, center + halfExtents, aabbCallback);
+
+		btVector3 rayFrom = scene.randomPoint();
+		btVector3 rayTo = (query % 4 == 0) ? rayFrom + btVector3(0, 0, 20) : scene.randomPoint();
+		btVector3 sweepMin(0, 0, 0);
+		btVector3 sweepMax(0, 0, 0);
+		if (query % 3 == 0)
+		{
+			sweepMin = -halfExtents * btScalar(0.1);
+			sweepMax = halfExtents * btScalar(0.1);
+		}
+		CountingRayCallback rayCallback(rayFrom, rayTo);
+		rayCallback.m_visits.resize(maxUid + 1, 0);
+		scene.m_broadphase->rayTest(rayFrom, rayTo, rayCallback, sweepMin, sweepMax);
+
+		for (int i = 0; i < scene.m_proxies.size(); ++i)
+		{
+			const btBroadphaseProxy* proxy = scene.m_proxies[i];
+			if (!proxy)
+			{
+				continue;
+			}
+			bool overlap = TestAabbAgainstAabb2(center - halfExtents, center + halfExtents, proxy->m_aabbMin, proxy->m_aabbMax);
+			EXPECT_EQ(overlap ? 1 : 0, aabbCallback.m_visits[proxy->getUid()]);
+
+			btVector3 bounds[2] = {proxy->m_aabbMin - sweepMax, proxy->m_aabbMax - sweepMin};
+			btScalar tmin = 1.f;
+			bool hit = btRayAabb2(rayFrom, rayCallback.m_rayDirectionInverse, rayCallback.m_signs, bounds, tmin, 0, rayCallback.m_lambda_max);
+			EXPECT_EQ(hit ? 1 : 0, rayCallback.m_visits[proxy->getUid()]);
+		}
+	}
+}
+
+}  // namespace
+
+INSTANTIATE_TYPED_TEST_CASE_P(Grid, BroadphaseThreadTest, GridTestScene);
+
+TEST(GridBroadphaseTest, FindsAllOverlaps)
+{
+	GridTestScene scene(3000, 0, 0);
+	scene.m_broadphase->calculateOverlappingPairs(NULL);
+	EXPECT_TRUE(scene.pairsMatchOverlaps());
+	for (int i = 0; i < 20; ++i)
+	{
+		// small motion, a burst every fifth step and a few proxies coming and going
+		scene.step(20, (i % 5) == 4 ? 30 : 0, 1);
+		EXPECT_TRUE(scene.pairsMatchOverlaps());
+	}
+	// the automatic cells are a little larger than the proxies
+	EXPECT_EQ(btScalar(1), scene.m_broadphase->m_gridCellSize);
+}
+
+TEST(GridBroadphaseTest, LargeProxies)
+{
+	GridTestScene scene(3000, 0, 10);
+	// planks across the scene, too large for any level with these small cells
+	for (int i = 0; i < 3; ++i)
+	{
+		btVector3 aabbMin(-40, -40, -40);
+		btVector3 aabbMax(40, 40, 40);
+		aabbMin[i] = btScalar(i);
+		aabbMax[i] = btScalar(i) + btScalar(0.5);
+		scene.m_proxies.push_back(scene.m_broadphase->createProxy(aabbMin, aabbMax, BOX_SHAPE_PROXYTYPE, NULL, btBroadphaseProxy::DefaultFilter, btBroadphaseProxy::AllFilter, NULL));
+	}
+	scene.m_broadphase->m_cellSize = btScalar(0.001);
+	scene.m_broadphase->calculateOverlappingPairs(NULL);
+	EXPECT_TRUE(scene.pairsMatchOverlaps());
+	EXPECT_GT(scene.numLevels(), 4);
+	EXPECT_GT(scene.m_broadphase->m_levelCellStarts[btGridBroadphase::MAX_LEVELS + 1], scene.m_broadphase->m_levelCellStarts[btGridBroadphase::MAX_LEVELS]);
+	for (int i = 0; i < 10; ++i)
+	{
+		scene.step(20, (i % 5) == 4 ? 30 : 0, 1);
+		EXPECT_TRUE(scene.pairsMatchOverlaps());
+	}
+}
+
+TEST(GridBroadphaseTest, Queries)
+{
+	GridTestScene scene(3000);
+	scene.m_broadphase->calculateOverlappingPairs(NULL);
+	checkQueries(scene);
+	// the proxies created, moved and destroyed since the last update
+	scene.move(10, 10, 5);
+	checkQueries(scene);
+	scene.m_broadphase->calculateOverlappingPairs(NULL);
+	checkQueries(scene);
+}
+
+int main(int argc, char** argv)
+{
+	::testing::InitGoogleTest(&argc, argv);
+	return RUN_ALL_TESTS();
+}
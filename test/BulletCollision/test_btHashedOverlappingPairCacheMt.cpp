@@ -0,0 +1,236 @@
+
+#include <BulletCollision/BroadphaseCollision/btHashedOverlappingPairCacheMt.h>
+#include <LinearMath/btThreads.h>
+#include <gtest/gtest.h>
+#include "BroadphaseTestScene.h"
+
+namespace
+{
+const int kNumProxies = 2000;
+
+struct PairCacheTestData
+{
+	btAlignedObjectArray<btBroadphaseProxy*> m_proxies;
+	btAlignedObjectArray<int> m_pairs;  // proxy index pairs, with duplicates
+	unsigned int m_seed;
+
+	PairCacheTestData() : m_seed(12345)
+	{
+		for (int i = 0; i < kNumProxies; ++i)
+		{
+			btBroadphaseProxy* proxy = new btBroadphaseProxy(btVector3(0, 0, 0), btVector3(1, 1, 1), NULL, btBroadphaseProxy::DefaultFilter, btBroadphaseProxy::AllFilter);
+			proxy->m_uniqueId = i + 2;
+			m_proxies.push_back(proxy);
+		}
+	}
+
+	~PairCacheTestData()
+	{
+		for (int i = 0; i < m_proxies.size(); ++i)
+		{
+			delete m_proxies[i];
+		}
+	}
+
+	int rand(int n)
+	{
+		m_seed = m_seed * 1664525u + 1013904223u;
+		return int((m_seed >> 8) % unsigned(n));
+	}
+
+	void makePairs(int numPairs)
+	{
+		m_pairs.resize(0);
+		for (int i = 0; i < numPairs; ++i)
+		{
+			int a = rand(kNumProxies);
+			int b = rand(kNumProxies - 1);
+			if (b >= a)
+			{
+				b++;
+			}
+			m_pairs.push_back(a);
+			m_pairs.push_back(b);
+			// every fourth pair twice, in the other proxy order
+			if ((i & 3) == 0)
+			{
+				m_pairs.push_back(b);
+				m_pairs.push_back(a);
+			}
+		}
+	}
+};
+
+struct ConcurrentPairLoop : public btIParallelForBody
+{
+	btHashedOverlappingPairCacheMt* m_cache;
+	const PairCacheTestData* m_data;
+	bool m_remove;
+
+	ConcurrentPairLoop(btHashedOverlappingPairCacheMt* cache, const PairCacheTestData* data, bool remove)
+		: m_cache(cache), m_data(data), m_remove(remove)
+	{
+	}
+	void forLoop(int iBegin, int iEnd) const BT_OVERRIDE
+	{
+		for (int i = iBegin; i < iEnd; ++i)
+		{
+			btBroadphaseProxy* proxy0 = m_data->m_proxies[m_data->m_pairs[2 * i]];
+			btBroadphaseProxy* proxy1 = m_data->m_proxies[m_data->m_pairs[2 * i + 1]];
+			if (m_remove)
+			{
+				m_cache->removeOverlappingPairConcurrent(proxy0, proxy1);
+			}
+			else
+			{
+				m_cache->addOverlappingPairConcurrent(proxy0, proxy1);
+			}
+		}
+	}
+};
+
+void concurrentPairs(btHashedOverlappingPairCacheMt* cache, const PairCacheTestData& data, bool remove)
+{
+	ConcurrentPairLoop loop(cache, &data, remove);
+	btParallelFor(0, data.m_pairs.size() / 2, 16, loop);
+	cache->flushConcurrentPairs(NULL);
+}
+
+void serialPairs(btHashedOverlappingPairCache* cache, const PairCacheTestData& data, bool remove)
+{
+	for (int i = 0; i < data.m_pairs.size(); i += 2)
+	{
+		btBroadphaseProxy* proxy0 = data.m_proxies[data.m_pairs[i]];
+		btBroadphaseProxy* proxy1 = data.m_proxies[data.m_pairs[i + 1]];
+		if (remove)
+		{
+			cache->removeOverlappingPair(proxy0, proxy1, NULL);
+		}
+		else
+		{
+			cache->addOverlappingPair(proxy0, proxy1);
+		}
+	}
+}
+
+bool samePairSet(btHashedOverlappingPairCache* a, btHashedOverlappingPairCache* b)
+{
+	if (a->getNumOverlappingPairs() != b->getNumOverlappingPairs())
+	{
+		return false;
+	}
+	const btBroadphasePairArray& pairs = a->getOverlappingPairArray();
+	for (int i = 0; i < pairs.size(); ++i)
+	{
+		if (b->findPair(pairs[i].m_pProxy0, pairs[i].m_pProxy1) == NULL)
+		{
+			return false;
+		}
+	}
+	return true;
+}
+
+// runs 'rounds' rounds of concurrent adds and removes with 'numThreads' threads, checks the pair set
+// against btHashedOverlappingPairCache after every round and returns the cache, which uses the proxies of 'data'
+btHashedOverlappingPairCacheMt* runRounds(PairCacheTestData& data, int numThreads, int concurrentCapacity, int rounds)
+{
+	btITaskScheduler* scheduler = btGetTaskScheduler();
+	if (numThreads <= scheduler->getMaxNumThreads())
+	{
+		scheduler->setNumThreads(numThreads);
+	}
+	btHashedOverlappingPairCacheMt* cache = new btHashedOverlappingPairCacheMt(concurrentCapacity);
+	btHashedOverlappingPairCache reference;
+	for (int round = 0; round < rounds; ++round)
+	{
+		data.makePairs(3000);
+		concurrentPairs(cache, data, false);
+		serialPairs(&reference, data, false);
+		EXPECT_TRUE(samePairSet(cache, &reference));
+
+		data.makePairs(3000);
+		concurrentPairs(cache, data, true);
+		serialPairs(&reference, data, true);
+		EXPECT_TRUE(samePairSet(cache, &reference));
+	}
+	return cache;
+}
+
+void checkMatchesSerialCache(int numThreads)
+{
+	PairCacheTestData data;
+	btHashedOverlappingPairCacheMt* cache = runRounds(data, numThreads, 8192, 10);
+	EXPECT_EQ(0, cache->getNumConcurrentOverflows());
+	delete cache;
+}
+
+void checkOverflowGrowsTable(int numThreads)
+{
+	PairCacheTestData data;
+	btHashedOverlappingPairCacheMt* cache = runRounds(data, numThreads, 100, 10);
+	EXPECT_GT(cache->getNumConcurrentOverflows(), 0);
+	EXPECT_GT(cache->getConcurrentCapacity(), 3000);
+	// the proxies of two test data objects differ, their uids are the same
+	PairCacheTestData referenceData;
+	btHashedOverlappingPairCacheMt* reference = runRounds(referenceData, numThreads, 8192, 10);
+	EXPECT_TRUE(samePairOrder(cache, reference));
+	delete reference;
+	delete cache;
+}
+
+// the concurrent adds and removes on the calling thread
+class PairCacheMtTest : public ::testing::Test
+{
+protected:
+	virtual void SetUp()
+	{
+		btSetTaskScheduler(btGetSequentialTaskScheduler());
+	}
+};
+
+class PairCacheMtThreadTest : public ThreadTest
+{
+};
+
+}  // namespace
+
+TEST_F(PairCacheMtTest, MatchesSerialCache)
+{
+	checkMatchesSerialCache(1);
+}
+
+TEST_F(PairCacheMtTest, OverflowGrowsTable)
+{
+	checkOverflowGrowsTable(1);
+}
+
+TEST_F(PairCacheMtThreadTest, MatchesSerialCache)
+{
+	checkMatchesSerialCache(16);
+}
+
+TEST_F(PairCacheMtThreadTest, OverflowGrowsTable)
+{
+	checkOverflowGrowsTable(16);
+}
+
+TEST_F(PairCacheMtThreadTest, SameOrderForAnyThreadCount)
+{
+	PairCacheTestData singleData;
+	btHashedOverlappingPairCacheMt* single = runRounds(singleData, 1, 8192, 5);
+	int threadCounts[] = {2, 4, 16};
+	for (int i = 0; i < 3; ++i)
+	{
+		PairCacheTestData multiData;
+		btHashedOverlappingPairCacheMt* multi = runRounds(multiData, threadCounts[i], 8192, 5);
+		EXPECT_TRUE(samePairOrder(single, multi));
+		delete multi;
+	}
+	delete single;
+}
+
+int main(int argc, char** argv)
+{
+	::testing::InitGoogleTest(&argc, argv);
+	return RUN_ALL_TESTS();
+}
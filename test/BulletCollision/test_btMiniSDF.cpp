@@ -0,0 +1,234 @@
+/*
+Bullet Continuous Collision Detection and Physics Library
+Copyright (c) 2003-2018 Erwin Coumans  https://bulletphysics.org
+
+This software is provided 'as-is', without any express or implied warranty.
+In no event will the authors be held liable for any damages arising from the use of this software.
+Permission is granted to anyone to use this software for any purpose,
+including commercial applications, and to alter it and redistribute it freely,
+subject to the following restrictions:
+
+1. The origin of this software must not be misrepresented; you must not claim that you wrote the original software. If you use this software in a product, an acknowledgment in the product documentation would be appreciated but is not required.
+2. Altered source versions must be plainly marked as such, and must not be misrepresented as being the original software.
+3. This notice may not be removed or altered from any source distribution.
+*/
+
+#include <BulletCollision/CollisionShapes/btBoxShape.h>
+#include <BulletCollision/CollisionShapes/btBvhTriangleMeshShape.h>
+#include <BulletCollision/CollisionShapes/btCompoundShape.h>
+#include <BulletCollision/CollisionShapes/btMiniSDF.h>
+#include <BulletCollision/CollisionShapes/btSphereShape.h>
+#include <BulletCollision/CollisionShapes/btTriangleMesh.h>
+#include <LinearMath/btThreads.h>
+#include <gtest/gtest.h>
+
+#include "ThreadTest.h"
+
+namespace
+{
+const int kResolution = 24;
+const btScalar kPadding = btScalar(0.5);
+
+// exact signed distance to a box centered at the origin
+btScalar boxDistance(const btVector3& halfExtents, const btVector3& x)
+{
+	btVector3 q = x.absolute() - halfExtents;
+	btVector3 outside(btMax(q[0], btScalar(0)), btMax(q[1], btScalar(0)), btMax(q[2], btScalar(0)));
+	return outside.length() + btMin(q[q.maxAxis()], btScalar(0));
+}
+
+btScalar sphereDistance(btScalar radius, const btVector3& x)
+{
+	return x.length() - radius;
+}
+
+// a closed mesh of the box, two triangles per face with outward winding
+void addBoxTriangles(const btVector3& h, btTriangleMesh& mesh)
+{
+	btVector3 v[8];
+	for (int i = 0; i < 8; ++i)
+	{
+		v[i] = btVector3(i & 1 ? h[0] : -h[0], i & 2 ? h[1] : -h[1], i & 4 ? h[2] : -h[2]);
+	}
+	const int faces[6][4] = {{0, 2, 3, 1}, {4, 5, 7, 6}, {0, 1, 5, 4}, {2, 6, 7, 3}, {0, 4, 6, 2}, {1, 3, 7, 5}};
+	for (int f = 0; f < 6; ++f)
+	{
+		mesh.addTriangle(v[faces[f][0]], v[faces[f][1]], v[faces[f][2]]);
+		mesh.addTriangle(v[faces[f][0]], v[faces[f][2]], v[faces[f][3]]);
+	}
+}
+
+// compares the baked field with the exact distance on a lattice that is not aligned with the nodes. The largest error
+// is at the edges and corners, where the distance is not smooth, and stays a fraction of a cell. Every point
+// further than a cell from the surface has the right sign.
+template <class Distance>
+void expectMatchesDistance(const btMiniSDF& sdf, const Distance& distance, btScalar maxError)
+{
+	ASSERT_TRUE(sdf.isValid());
+	const btScalar h = sdf.m_cell_size[0];
+	const btVector3 domainMin = sdf.m_domain.min();
+	const btVector3 extent = sdf.m_domain.max() - domainMin;
+	const int n = 23;
+	int numSamples = 0;
+	for (int k = 0; k < n; ++k)
+	{
+		for (int j = 0; j < n; ++j)
+		{
+			for (int i = 0; i < n; ++i)
+			{
+				btVector3 x = domainMin + extent * btVector3(btScalar(i) + btScalar(0.37), btScalar(j) + btScalar(0.61), btScalar(k) + btScalar(0.23)) / btScalar(n);
+				double baked = 0;
+				ASSERT_TRUE(sdf.interpolate(0, baked, x, NULL)) << x[0] << " " << x[1] << " " << x[2];
+				const btScalar exact = distance(x);
+				ASSERT_NEAR(exact, btScalar(baked), maxError) << x[0] << " " << x[1] << " " << x[2];
+				if (btFabs(exact) > h)
+				{
+					ASSERT_EQ(exact < 0, baked < 0) << x[0] << " " << x[1] << " " << x[2];
+				}
+				numSamples++;
+			}
+		}
+	}
+	EXPECT_EQ(n * n * n, numSamples);
+	double outside = 0;
+	EXPECT_FALSE(sdf.interpolate(0, outside, sdf.m_domain.max() + btVector3(h, h, h), NULL));
+}
+
+struct SphereDistance
+{
+	btScalar m_radius;
+	btScalar operator()(const btVector3& x) const { return sphereDistance(m_radius, x); }
+};
+
+struct BoxDistance
+{
+	btVector3 m_halfExtents;
+	btScalar operator()(const btVector3& x) const { return boxDistance(m_halfExtents, x); }
+};
+
+void expectSameField(const btMiniSDF& a, const btMiniSDF& b)
+{
+	ASSERT_TRUE(a.isValid());
+	ASSERT_TRUE(b.isValid());
+	for (int d = 0; d < 3; ++d)
+	{
+		ASSERT_EQ(a.m_resolution[d], b.m_resolution[d]);
+	}
+	ASSERT_EQ(a.m_domain.min(), b.m_domain.min());
+	ASSERT_EQ(a.m_domain.max(), b.m_domain.max());
+	ASSERT_EQ(a.m_nodes.size(), b.m_nodes.size());
+	for (int f = 0; f < a.m_nodes.size(); ++f)
+	{
+		ASSERT_EQ(a.m_nodes[f].size(), b.m_nodes[f].size());
+		for (int i = 0; i < a.m_nodes[f].size(); ++i)
+		{
+			ASSERT_EQ(a.m_nodes[f][i], b.m_nodes[f][i]) << "node " << i;
+		}
+	}
+}
+
+class MiniSDFThreadTest : public ThreadTest
+{
+};
+
+}  // namespace
+
+TEST(MiniSDFTest, SphereMatchesExactDistance)
+{
+	btSetTaskScheduler(btGetSequentialTaskScheduler());
+	btSphereShape sphere(1);
+	btMiniSDF sdf;
+	ASSERT_TRUE(sdf.buildFromShape(&sphere, kResolution, kPadding));
+	// the domain is the aabb grown by the padding, in whole cubic cells
+	EXPECT_LE(sdf.m_domain.min()[0], -1 - kPadding);
+	EXPECT_GE(sdf.m_domain.max()[0], 1 + kPadding);
+	EXPECT_NEAR(sdf.m_cell_size[0], (2 + 2 * kPadding) / kResolution, SIMD_EPSILON * 10);
+	SphereDistance distance;
+	distance.m_radius = 1;
+	expectMatchesDistance(sdf, distance, btScalar(0.01));
+}
+
+TEST(MiniSDFTest, BoxMatchesExactDistance)
+{
+	btSetTaskScheduler(btGetSequentialTaskScheduler());
+	btVector3 halfExtents(btScalar(1.5), btScalar(1), btScalar(0.5));
+	btBoxShape box(halfExtents);
+	btMiniSDF sdf;
+	ASSERT_TRUE(sdf.buildFromShape(&box, kResolution, kPadding));
+	BoxDistance distance;
+	distance.m_halfExtents = halfExtents;
+	expectMatchesDistance(sdf, distance, btScalar(0.08));
+}
+
+// the sign of a concave shape comes from the ray crossings of its closed mesh
+TEST(MiniSDFTest, BoxMeshMatchesExactDistance)
+{
+	btSetTaskScheduler(btGetSequentialTaskScheduler());
+	btVector3 halfExtents(btScalar(1.5), btScalar(1), btScalar(0.5));
+	btTriangleMesh mesh;
+	addBoxTriangles(halfExtents, mesh);
+	btBvhTriangleMeshShape shape(&mesh, true);
+	btMiniSDF sdf;
+	ASSERT_TRUE(sdf.buildFromShape(&shape, kResolution, kPadding));
+	BoxDistance distance;
+	distance.m_halfExtents = halfExtents;
+	expectMatchesDistance(sdf, distance, btScalar(0.08));
+}
+
+TEST(MiniSDFTest, RejectsCompound)
+{
+	btCompoundShape compound;
+	btMiniSDF sdf;
+	EXPECT_FALSE(sdf.buildFromShape(&compound, kResolution, kPadding));
+	EXPECT_FALSE(sdf.isValid());
+}
+
+TEST(MiniSDFTest, SerializeRoundTrip)
+{
+	btSetTaskScheduler(btGetSequentialTaskScheduler());
+	btBoxShape box(btVector3(1, 2, 3));
+	btMiniSDF sdf;
+	ASSERT_TRUE(sdf.buildFromShape(&box, 12, kPadding));
+	btAlignedObjectArray<char> data;
+	sdf.serialize(data);
+	btMiniSDF loaded;
+	ASSERT_TRUE(loaded.load(&data[0], data.size()));
+	expectSameField(sdf, loaded);
+	btVector3 x(btScalar(0.3), btScalar(-2.2), btScalar(1.7));
+	double a = 0, b = 0;
+	ASSERT_TRUE(sdf.interpolate(0, a, x, NULL));
+	ASSERT_TRUE(loaded.interpolate(0, b, x, NULL));
+	EXPECT_EQ(a, b);
+}
+
+// the nodes baked in parallel tasks are the same for any number of threads
+TEST_F(MiniSDFThreadTest, SameFieldForAnyThreadCount)
+{
+	btVector3 halfExtents(btScalar(1.5), btScalar(1), btScalar(0.5));
+	btTriangleMesh mesh;
+	addBoxTriangles(halfExtents, mesh);
+	btBvhTriangleMeshShape meshShape(&mesh, true);
+	btSphereShape sphere(1);
+	btCollisionShape* shapes[] = {&sphere, &meshShape};
+
+	for (int s = 0; s < 2; ++s)
+	{
+		setNumThreads(1);
+		btMiniSDF single;
+		ASSERT_TRUE(single.buildFromShape(shapes[s], kResolution, kPadding));
+		int threadCounts[] = {2, 4, 8};
+		for (int t = 0; t < 3; ++t)
+		{
+			setNumThreads(threadCounts[t]);
+			btMiniSDF multi;
+			ASSERT_TRUE(multi.buildFromShape(shapes[s], kResolution, kPadding));
+			expectSameField(single, multi);
+		}
+	}
+}
+
+int main(int argc, char** argv)
+{
+	::testing::InitGoogleTest(&argc, argv);
+	return RUN_ALL_TESTS();
+}
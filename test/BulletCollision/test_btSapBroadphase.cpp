@@ -0,0 +1,74 @@
+
+#include <BulletCollision/BroadphaseCollision/btSapBroadphase.h>
+#include <gtest/gtest.h>
+#include "BroadphaseTestScene.h"
+
+namespace
+{
+struct SapTestScene : public BroadphaseTestScene<btSapBroadphase>
+{
+	SapTestScene(int numProxies, btOverlappingPairCache* pairCache = 0)
+		: BroadphaseTestScene<btSapBroadphase>(new btSapBroadphase(pairCache))
+	{
+		createProxies(numProxies);
+	}
+};
+
+}  // namespace
+
+INSTANTIATE_TYPED_TEST_CASE_P(Sap, BroadphaseThreadTest, SapTestScene);
+
+TEST(SapBroadphaseTest, FindsAllOverlaps)
+{
+	SapTestScene scene(3000);
+	scene.m_broadphase->calculateOverlappingPairs(NULL);
+	EXPECT_TRUE(scene.pairsMatchOverlaps());
+	for (int i = 0; i < 20; ++i)
+	{
+		// small motion, a burst every fifth step and a few proxies coming and going
+		scene.step(20, (i % 5) == 4 ? 30 : 0, 1);
+		EXPECT_TRUE(scene.pairsMatchOverlaps());
+	}
+	EXPECT_GT(scene.m_broadphase->m_numIncrementalUpdates, 0);
+	EXPECT_GT(scene.m_broadphase->m_numRebuilds, 1);
+}
+
+TEST(SapBroadphaseTest, InsertionSortFallsBackToRadixSort)
+{
+	SapTestScene scene(3000);
+	scene.m_broadphase->calculateOverlappingPairs(NULL);
+	// few proxies, moving far
+	scene.m_broadphase->m_rebuildFraction = 1;
+	scene.m_broadphase->m_insertionShiftsPerProxy = 1;
+	int numRebuilds = scene.m_broadphase->m_numRebuilds;
+	scene.step(0, 10, 0);
+	EXPECT_EQ(numRebuilds + 1, scene.m_broadphase->m_numRebuilds);
+	EXPECT_TRUE(scene.pairsMatchOverlaps());
+}
+
+TEST(SapBroadphaseTest, LongProxies)
+{
+	SapTestScene scene(3000);
+	// planks across the scene, along every axis, that the backward pass of the moved proxies does not reach
+	for (int i = 0; i < 30; ++i)
+	{
+		btVector3 aabbMin = scene.randomPoint();
+		btVector3 aabbMax = aabbMin + btVector3(1, 1, 1);
+		aabbMin[i % 3] = -10;
+		aabbMax[i % 3] = 70;
+		scene.m_proxies.push_back(scene.m_broadphase->createProxy(aabbMin, aabbMax, BOX_SHAPE_PROXYTYPE, NULL, btBroadphaseProxy::DefaultFilter, btBroadphaseProxy::AllFilter, NULL));
+	}
+	scene.m_broadphase->calculateOverlappingPairs(NULL);
+	EXPECT_TRUE(scene.pairsMatchOverlaps());
+	for (int i = 0; i < 10; ++i)
+	{
+		scene.step(20, (i % 5) == 4 ? 30 : 0, 0);
+		EXPECT_TRUE(scene.pairsMatchOverlaps());
+	}
+}
+
+int main(int argc, char** argv)
+{
+	::testing::InitGoogleTest(&argc, argv);
+	return RUN_ALL_TESTS();
+}
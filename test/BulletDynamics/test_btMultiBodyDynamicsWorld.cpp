@@ -0,0 +1,163 @@
+#include <btBulletDynamicsCommon.h>
+#include <BulletDynamics/Featherstone/btMultiBody.h>
+#include <BulletDynamics/Featherstone/btMultiBodyConstraintSolver.h>
+#include <BulletDynamics/Featherstone/btMultiBodyDynamicsWorld.h>
+#include <BulletDynamics/Featherstone/btMultiBodyLinkCollider.h>
+#include <LinearMath/btThreads.h>
+#include <gtest/gtest.h>
+
+#include "ThreadTest.h"
+
+namespace
+{
+// a row of swinging multibody chains above a static ground, every other one with a fixed base and every fourth one integrated with RK4
+struct MultiBodyTestScene
+{
+	btDefaultCollisionConfiguration m_config;
+	btCollisionDispatcher m_dispatcher;
+	btDbvtBroadphase m_broadphase;
+	btMultiBodyConstraintSolver m_solver;
+	btMultiBodyDynamicsWorld m_world;
+	btBoxShape m_groundShape;
+	btBoxShape m_linkShape;
+	btRigidBody* m_ground;
+	btAlignedObjectArray<btMultiBody*> m_multiBodies;
+	btAlignedObjectArray<btMultiBodyLinkCollider*> m_colliders;
+
+	explicit MultiBodyTestScene(int numMultiBodies)
+		: m_dispatcher(&m_config),
+		  m_world(&m_dispatcher, &m_broadphase, &m_solver, &m_config),
+		  m_groundShape(btVector3(100, 1, 100)),
+		  m_linkShape(btVector3(btScalar(0.25), btScalar(0.1), btScalar(0.1)))
+	{
+		m_world.setGravity(btVector3(0, -10, 0));
+		btTransform groundTransform;
+		groundTransform.setIdentity();
+		groundTransform.setOrigin(btVector3(0, -1, 0));
+		m_ground = new btRigidBody(0, 0, &m_groundShape);
+		m_ground->setWorldTransform(groundTransform);
+		m_world.addRigidBody(m_ground);
+		for (int i = 0; i < numMultiBodies; ++i)
+		{
+			addChain(btVector3(btScalar(i * 1.5), 2, 0), i % 4 == 1, (i % 2) != 0);
+		}
+	}
+
+	~MultiBodyTestScene()
+	{
+		for (int i = 0; i < m_colliders.size(); ++i)
+		{
+			m_world.removeCollisionObject(m_colliders[i]);
+			delete m_colliders[i];
+		}
+		for (int i = 0; i < m_multiBodies.size(); ++i)
+		{
+			m_world.removeMultiBody(m_multiBodies[i]);
+			delete m_multiBodies[i];
+		}
+		m_world.removeRigidBody(m_ground);
+		delete m_ground;
+	}
+
+	void addChain(const btVector3& basePos, bool useRK4, bool fixedBase)
+	{
+		const int numLinks = 4;
+		btVector3 inertia;
+		m_linkShape.calculateLocalInertia(1, inertia);
+		btMultiBody* multiBody = new btMultiBody(numLinks, fixedBase ? 0 : 1, inertia, fixedBase, false);
+		multiBody->setBaseWorldTransform(btTransform(btQuaternion::getIdentity(), basePos));
+		for (int i = 0; i < numLinks; ++i)
+		{
+			multiBody->setupRevolute(i, 1, inertia, i - 1, btQuaternion(btVector3(0, 1, 0), btScalar(0.3)), btVector3(0, 0, 1), btVector3(btScalar(0.25), 0, 0), btVector3(btScalar(0.25), 0, 0), true);
+		}
+		multiBody->finalizeMultiDof();
+		multiBody->useRK4Integration(useRK4);
+		multiBody->setJointPos(0, btScalar(0.5));
+		m_world.addMultiBody(multiBody);
+		m_multiBodies.push_back(multiBody);
+
+		btAlignedObjectArray<btQuaternion> scratchRotations;
+		btAlignedObjectArray<btVector3> scratchOffsets;
+		multiBody->forwardKinematics(scratchRotations, scratchOffsets);
+		for (int i = -1; i < numLinks; ++i)
+		{
+			btMultiBodyLinkCollider* collider = new btMultiBodyLinkCollider(multiBody, i);
+			collider->setCollisionShape(&m_linkShape);
+			collider->setWorldTransform(i < 0 ? multiBody->getBaseWorldTransform() : multiBody->getLink(i).m_cachedWorldTransform);
+			m_world.addCollisionObject(collider, btBroadphaseProxy::DefaultFilter, btBroadphaseProxy::AllFilter);
+			if (i < 0)
+			{
+				multiBody->setBaseCollider(collider);
+			}
+			else
+			{
+				multiBody->getLink(i).m_collider = collider;
+			}
+			m_colliders.push_back(collider);
+		}
+	}
+
+	void step(int numSteps)
+	{
+		for (int i = 0; i < numSteps; ++i)
+		{
+			m_world.stepSimulation(btScalar(1. / 240.), 0);
+		}
+	}
+};
+
+void expectSameState(const MultiBodyTestScene& scene0, const MultiBodyTestScene& scene1)
+{
+	ASSERT_EQ(scene0.m_multiBodies.size(), scene1.m_multiBodies.size());
+	for (int i = 0; i < scene0.m_multiBodies.size(); ++i)
+	{
+		const btMultiBody* body0 = scene0.m_multiBodies[i];
+		const btMultiBody* body1 = scene1.m_multiBodies[i];
+		EXPECT_EQ(body0->getBasePos(), body1->getBasePos());
+		EXPECT_EQ(body0->getBaseVel(), body1->getBaseVel());
+		for (int j = 0; j < body0->getNumLinks(); ++j)
+		{
+			EXPECT_EQ(body0->getJointPos(j), body1->getJointPos(j));
+			EXPECT_EQ(body0->getJointVel(j), body1->getJointVel(j));
+		}
+	}
+	for (int i = 0; i < scene0.m_colliders.size(); ++i)
+	{
+		EXPECT_EQ(scene0.m_colliders[i]->getWorldTransform().getOrigin(), scene1.m_colliders[i]->getWorldTransform().getOrigin());
+	}
+}
+
+}  // namespace
+
+class MultiBodyDynamicsWorldThreadTest : public ThreadTest
+{
+};
+
+TEST(MultiBodyDynamicsWorldTest, ChainsSwingAndHitTheGround)
+{
+	btSetTaskScheduler(btGetSequentialTaskScheduler());
+	MultiBodyTestScene scene(24);
+	scene.step(240);
+	EXPECT_NE(scene.m_multiBodies[0]->getJointPos(0), btScalar(0.5));
+	EXPECT_GT(scene.m_dispatcher.getNumManifolds(), 0);
+}
+
+TEST_F(MultiBodyDynamicsWorldThreadTest, ParallelForwardDynamicsMatchesSerial)
+{
+	MultiBodyTestScene serial(24);
+	MultiBodyTestScene parallel(24);
+	for (int i = 0; i < 8; ++i)
+	{
+		btSetTaskScheduler(btGetSequentialTaskScheduler());
+		serial.step(30);
+		btSetTaskScheduler(m_scheduler);
+		parallel.step(30);
+		expectSameState(serial, parallel);
+	}
+}
+
+int main(int argc, char** argv)
+{
+	::testing::InitGoogleTest(&argc, argv);
+	return RUN_ALL_TESTS();
+}
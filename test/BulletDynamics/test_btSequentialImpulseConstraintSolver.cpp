@@ -0,0 +1,311 @@
+#include <btBulletDynamicsCommon.h>
+#include <BulletDynamics/Featherstone/btMultiBody.h>
+#include <BulletDynamics/Featherstone/btMultiBodyConstraintSolver.h>
+#include <BulletDynamics/Featherstone/btMultiBodyDynamicsWorld.h>
+#include <BulletDynamics/Featherstone/btMultiBodyLinkCollider.h>
+#include <LinearMath/btThreads.h>
+#include <gtest/gtest.h>
+#include <limits.h>
+
+#include "ThreadTest.h"
+
+namespace
+{
+// stacks of boxes, rolling spheres and a chain of hinged boxes on a static ground, optionally with a multibody chain falling on them
+struct SolverTestScene
+{
+	btDefaultCollisionConfiguration m_config;
+	btCollisionDispatcher m_dispatcher;
+	btDbvtBroadphase m_broadphase;
+	btConstraintSolver* m_solver;
+	btDiscreteDynamicsWorld* m_world;
+	btBoxShape m_groundShape;
+	btBoxShape m_boxShape;
+	btSphereShape m_sphereShape;
+	btAlignedObjectArray<btRigidBody*> m_bodies;
+	btAlignedObjectArray<btTypedConstraint*> m_joints;
+	btMultiBody* m_multiBody;
+	btAlignedObjectArray<btMultiBodyLinkCollider*> m_linkColliders;
+
+	SolverTestScene(bool withMultiBody, int solverMode)
+		: m_dispatcher(&m_config),
+		  m_groundShape(btVector3(50, 1, 50)),
+		  m_boxShape(btVector3(0.5, 0.5, 0.5)),
+		  m_sphereShape(0.5),
+		  m_multiBody(0)
+	{
+		if (withMultiBody)
+		{
+			btMultiBodyConstraintSolver* solver = new btMultiBodyConstraintSolver();
+			m_solver = solver;
+			m_world = new btMultiBodyDynamicsWorld(&m_dispatcher, &m_broadphase, solver, &m_config);
+		}
+		else
+		{
+			m_solver = new btSequentialImpulseConstraintSolver();
+			m_world = new btDiscreteDynamicsWorld(&m_dispatcher, &m_broadphase, m_solver, &m_config);
+		}
+		m_world->getSolverInfo().m_solverMode = solverMode;
+
+		addBody(&m_groundShape, 0, btVector3(0, -1, 0));
+		for (int x = 0; x < 8; ++x)
+		{
+			for (int z = 0; z < 8; ++z)
+			{
+				for (int y = 0; y < 3; ++y)
+				{
+					btRigidBody* box = addBody(&m_boxShape, 1, btVector3(btScalar(x * 1.5), btScalar(0.5 + y * 1.01), btScalar(z * 1.5)));
+					box->setFriction(btScalar(0.3 + 0.1 * ((x + y + z) % 4)));
+				}
+			}
+		}
+		for (int i = 0; i < 16; ++i)
+		{
+			btRigidBody* sphere = addBody(&m_sphereShape, 1, btVector3(btScalar(-3 - (i % 4) * 1.2), btScalar(0.5 + (i / 4) * 0.2), btScalar(i * 1.1)));
+			sphere->setLinearVelocity(btVector3(1, 0, btScalar(0.5)));
+			sphere->setRollingFriction(btScalar(0.05));
+			sphere->setSpinningFriction(btScalar(0.05));
+			if (i % 3 == 0)
+			{
+				sphere->setAnisotropicFriction(btVector3(1, 1, 0), btCollisionObject::CF_ANISOTROPIC_ROLLING_FRICTION);
+			}
+		}
+		btRigidBody* previous = 0;
+		for (int i = 0; i < 6; ++i)
+		{
+			btRigidBody* link = addBody(&m_boxShape, 1, btVector3(btScalar(14 + i * 1.05), btScalar(0.5), 4));
+			if (previous)
+			{
+				btHingeConstraint* hinge = new btHingeConstraint(*previous, *link, btVector3(btScalar(0.525), 0, 0), btVector3(btScalar(-0.525), 0, 0), btVector3(0, 0, 1), btVector3(0, 0, 1));
+				if (i % 2)
+				{
+					hinge->setOverrideNumSolverIterations(20);
+				}
+				m_world->addConstraint(hinge, true);
+				m_joints.push_back(hinge);
+			}
+			previous = link;
+		}
+		if (withMultiBody)
+		{
+			addMultiBody();
+		}
+	}
+
+	~SolverTestScene()
+	{
+		for (int i = 0; i < m_joints.size(); ++i)
+		{
+			m_world->removeConstraint(m_joints[i]);
+			delete m_joints[i];
+		}
+		for (int i = 0; i < m_bodies.size(); ++i)
+		{
+			m_world->removeRigidBody(m_bodies[i]);
+			delete m_bodies[i]->getMotionState();
+			delete m_bodies[i];
+		}
+		if (m_multiBody)
+		{
+			btMultiBodyDynamicsWorld* world = static_cast<btMultiBodyDynamicsWorld*>(m_world);
+			for (int i = 0; i < m_linkColliders.size(); ++i)
+			{
+				world->removeCollisionObject(m_linkColliders[i]);
+				delete m_linkColliders[i];
+			}
+			world->removeMultiBody(m_multiBody);
+			delete m_multiBody;
+		}
+		delete m_world;
+		delete m_solver;
+	}
+
+	btRigidBody* addBody(btCollisionShape* shape, btScalar mass, const btVector3& origin)
+	{
+		btVector3 inertia(0, 0, 0);
+		if (mass != 0)
+		{
+			shape->calculateLocalInertia(mass, inertia);
+		}
+		btTransform transform;
+		transform.setIdentity();
+		transform.setOrigin(origin);
+		btRigidBody* body = new btRigidBody(mass, new btDefaultMotionState(transform), shape, inertia);
+		body->setActivationState(DISABLE_DEACTIVATION);
+		m_world->addRigidBody(body);
+		m_bodies.push_back(body);
+		return body;
+	}
+
+	// a free floating chain of three boxes above the stacks
+	void addMultiBody()
+	{
+		const int numLinks = 2;
+		btVector3 inertia;
+		m_boxShape.calculateLocalInertia(1, inertia);
+		m_multiBody = new btMultiBody(numLinks, 1, inertia, false, false);
+		m_multiBody->setBaseWorldTransform(btTransform(btQuaternion::getIdentity(), btVector3(3, 5, 3)));
+		for (int i = 0; i < numLinks; ++i)
+		{
+			m_multiBody->setupRevolute(i, 1, inertia, i - 1, btQuaternion::getIdentity(), btVector3(0, 0, 1), btVector3(btScalar(0.55), 0, 0), btVector3(btScalar(0.55), 0, 0), true);
+		}
+		m_multiBody->finalizeMultiDof();
+		btMultiBodyDynamicsWorld* world = static_cast<btMultiBodyDynamicsWorld*>(m_world);
+		world->addMultiBody(m_multiBody);
+
+		btAlignedObjectArray<btQuaternion> scratchRotations;
+		btAlignedObjectArray<btVector3> scratchOffsets;
+		m_multiBody->forwardKinematics(scratchRotations, scratchOffsets);
+		for (int i = -1; i < numLinks; ++i)
+		{
+			btMultiBodyLinkCollider* collider = new btMultiBodyLinkCollider(m_multiBody, i);
+			collider->setCollisionShape(&m_boxShape);
+			collider->setWorldTransform(i < 0 ? m_multiBody->getBaseWorldTransform() : m_multiBody->getLink(i).m_cachedWorldTransform);
+			world->addCollisionObject(collider, btBroadphaseProxy::DefaultFilter, btBroadphaseProxy::AllFilter);
+			if (i < 0)
+			{
+				m_multiBody->setBaseCollider(collider);
+			}
+			else
+			{
+				m_multiBody->getLink(i).m_collider = collider;
+			}
+			m_linkColliders.push_back(collider);
+		}
+	}
+
+	void step(int numSteps)
+	{
+		for (int i = 0; i < numSteps; ++i)
+		{
+			m_world->stepSimulation(btScalar(1. / 60.), 0);
+		}
+	}
+};
+
+void expectSameState(const SolverTestScene& scene0, const SolverTestScene& scene1)
+{
+	ASSERT_EQ(scene0.m_bodies.size(), scene1.m_bodies.size());
+	for (int i = 0; i < scene0.m_bodies.size(); ++i)
+	{
+		const btRigidBody* body0 = scene0.m_bodies[i];
+		const btRigidBody* body1 = scene1.m_bodies[i];
+		EXPECT_EQ(body0->getWorldTransform().getOrigin(), body1->getWorldTransform().getOrigin());
+		EXPECT_EQ(body0->getWorldTransform().getRotation(), body1->getWorldTransform().getRotation());
+		EXPECT_EQ(body0->getLinearVelocity(), body1->getLinearVelocity());
+		EXPECT_EQ(body0->getAngularVelocity(), body1->getAngularVelocity());
+	}
+	if (scene0.m_multiBody)
+	{
+		EXPECT_EQ(scene0.m_multiBody->getBasePos(), scene1.m_multiBody->getBasePos());
+		for (int i = 0; i < scene0.m_multiBody->getNumLinks(); ++i)
+		{
+			EXPECT_EQ(scene0.m_multiBody->getJointPos(i), scene1.m_multiBody->getJointPos(i));
+		}
+	}
+}
+
+// steps a scene with the contacts converted one by one and one with the batched conversion, which runs on the calling
+// thread when 'singleThreaded' and otherwise in the btParallelFor tasks of the task scheduler
+void expectBatchedConversionMatchesSerial(bool withMultiBody, int solverMode, bool singleThreaded)
+{
+	SolverTestScene serial(withMultiBody, solverMode);
+	SolverTestScene batched(withMultiBody, solverMode);
+	for (int i = 0; i < 6; ++i)
+	{
+		btSequentialImpulseConstraintSolver::s_minimumContactManifoldsForParallelConversion = INT_MAX;
+		serial.step(10);
+		btSequentialImpulseConstraintSolver::s_minimumContactManifoldsForParallelConversion = 0;
+		btSequentialImpulseConstraintSolver::s_allowSingleThreadedBatchedConversion = singleThreaded;
+		batched.step(10);
+		btSequentialImpulseConstraintSolver::s_allowSingleThreadedBatchedConversion = false;
+		expectSameState(serial, batched);
+	}
+	EXPECT_GT(batched.m_dispatcher.getNumManifolds(), 100);
+}
+
+// puts back the conversion settings that the tests change
+struct SavedConversionSettings
+{
+	int m_minimumContactManifolds;
+
+	SavedConversionSettings()
+		: m_minimumContactManifolds(btSequentialImpulseConstraintSolver::s_minimumContactManifoldsForParallelConversion)
+	{
+	}
+	~SavedConversionSettings()
+	{
+		btSequentialImpulseConstraintSolver::s_minimumContactManifoldsForParallelConversion = m_minimumContactManifolds;
+		btSequentialImpulseConstraintSolver::s_allowSingleThreadedBatchedConversion = false;
+	}
+};
+
+class SolverConversionTest : public ::testing::Test
+{
+protected:
+	SavedConversionSettings m_savedSettings;
+
+	virtual void SetUp()
+	{
+		btSetTaskScheduler(btGetSequentialTaskScheduler());
+	}
+};
+
+class SolverConversionThreadTest : public ThreadTest
+{
+protected:
+	SavedConversionSettings m_savedSettings;
+
+	virtual void SetUp()
+	{
+		ThreadTest::SetUp();
+		if (!HasFatalFailure())
+		{
+			setNumThreads(4);
+		}
+	}
+
+	// the conversion is only batched by itself with worker threads, on a single core machine it is batched anyway
+	void expectParallelConversionMatchesSerial(bool withMultiBody, int solverMode)
+	{
+		expectBatchedConversionMatchesSerial(withMultiBody, solverMode, m_scheduler->getNumThreads() < 2);
+	}
+};
+
+}  // namespace
+
+TEST_F(SolverConversionTest, BatchedConversionMatchesSerial)
+{
+	expectBatchedConversionMatchesSerial(false, SOLVER_USE_WARMSTARTING | SOLVER_SIMD, true);
+}
+
+TEST_F(SolverConversionTest, BatchedConversionMatchesSerialTwoFrictionDirections)
+{
+	expectBatchedConversionMatchesSerial(false, SOLVER_USE_WARMSTARTING | SOLVER_SIMD | SOLVER_USE_2_FRICTION_DIRECTIONS | SOLVER_ENABLE_FRICTION_DIRECTION_CACHING | SOLVER_DISABLE_VELOCITY_DEPENDENT_FRICTION_DIRECTION, true);
+}
+
+TEST_F(SolverConversionTest, MultiBodySolverBatchedConversionMatchesSerial)
+{
+	expectBatchedConversionMatchesSerial(true, SOLVER_USE_WARMSTARTING | SOLVER_SIMD, true);
+}
+
+TEST_F(SolverConversionThreadTest, ParallelConversionMatchesSerial)
+{
+	expectParallelConversionMatchesSerial(false, SOLVER_USE_WARMSTARTING | SOLVER_SIMD);
+}
+
+TEST_F(SolverConversionThreadTest, ParallelConversionMatchesSerialTwoFrictionDirections)
+{
+	expectParallelConversionMatchesSerial(false, SOLVER_USE_WARMSTARTING | SOLVER_SIMD | SOLVER_USE_2_FRICTION_DIRECTIONS | SOLVER_ENABLE_FRICTION_DIRECTION_CACHING | SOLVER_DISABLE_VELOCITY_DEPENDENT_FRICTION_DIRECTION);
+}
+
+TEST_F(SolverConversionThreadTest, MultiBodySolverParallelConversionMatchesSerial)
+{
+	expectParallelConversionMatchesSerial(true, SOLVER_USE_WARMSTARTING | SOLVER_SIMD);
+}
+
+int main(int argc, char** argv)
+{
+	::testing::InitGoogleTest(&argc, argv);
+	return RUN_ALL_TESTS();
+}
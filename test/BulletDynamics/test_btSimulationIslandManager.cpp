@@ -0,0 +1,382 @@
+#include <btBulletDynamicsCommon.h>
+#include <BulletCollision/CollisionDispatch/btUnionFind.h>
+#include <BulletDynamics/Dynamics/btDiscreteDynamicsWorldMt.h>
+#include <BulletDynamics/Dynamics/btSimulationIslandManagerMt.h>
+#include <LinearMath/btThreads.h>
+#include <gtest/gtest.h>
+
+#include "ThreadTest.h"
+
+namespace
+{
+// the islands that btSimulationIslandManagerMt passed to the solver on the last step
+btAlignedObjectArray<btSimulationIslandManagerMt::Island> s_solvedIslands;
+
+void recordingIslandDispatch(btAlignedObjectArray<btSimulationIslandManagerMt::Island*>* islands, const btSimulationIslandManagerMt::SolverParams& solverParams)
+{
+	for (int i = 0; i < islands->size(); ++i)
+	{
+		s_solvedIslands.push_back(*(*islands)[i]);
+	}
+	btSimulationIslandManagerMt::parallelIslandDispatch(islands, solverParams);
+}
+
+// twelve stacks of three boxes on a static ground, the top boxes of stacks 0 and 1 and of stacks 8 and 9 held together
+// by point to point constraints
+struct IslandTestScene
+{
+	btDefaultCollisionConfiguration m_config;
+	btCollisionDispatcher m_dispatcher;
+	btDbvtBroadphase m_broadphase;
+	btSequentialImpulseConstraintSolver m_solver;
+	btConstraintSolverPoolMt* m_solverPool;
+	btDiscreteDynamicsWorld* m_world;
+	btBoxShape m_groundShape;
+	btBoxShape m_boxShape;
+	btBoxShape m_plankShape;
+	btAlignedObjectArray<btRigidBody*> m_bodies;  // NULL where a body was removed
+	btAlignedObjectArray<btTypedConstraint*> m_constraints;
+	btUnionFind m_unionFind;
+
+	IslandTestScene(bool multithreaded, bool persistentIslands)
+		: m_dispatcher(&m_config),
+		  m_solverPool(0),
+		  m_groundShape(btVector3(100, 1, 100)),
+		  m_boxShape(btVector3(btScalar(0.5), btScalar(0.5), btScalar(0.5))),
+		  m_plankShape(btVector3(2, btScalar(0.25), btScalar(0.5)))
+	{
+		if (multithreaded)
+		{
+			m_solverPool = new btConstraintSolverPoolMt(2);
+			m_world = new btDiscreteDynamicsWorldMt(&m_dispatcher, &m_broadphase, m_solverPool, NULL, &m_config);
+			// small islands still share a batch, but they are not merged after sorting them by size
+			btSimulationIslandManagerMt* islandManager = static_cast<btSimulationIslandManagerMt*>(m_world->getSimulationIslandManager());
+			islandManager->setMinimumSolverBatchSize(1);
+			islandManager->setIslandDispatchFunction(recordingIslandDispatch);
+		}
+		else
+		{
+			m_world = new btDiscreteDynamicsWorld(&m_dispatcher, &m_broadphase, &m_solver, &m_config);
+		}
+		m_world->setGravity(btVector3(0, -10, 0));
+		m_world->setPersistentSimulationIslands(persistentIslands);
+		addBody(0, &m_groundShape, btVector3(0, -1, 0));
+		for (int i = 0; i < 12; ++i)
+		{
+			for (int j = 0; j < 3; ++j)
+			{
+				addBody(1, &m_boxShape, btVector3(btScalar(i * 3), btScalar(j) + btScalar(0.5), 0));
+			}
+		}
+		addConstraint(stackBox(0, 2), stackBox(1, 2));
+		addConstraint(stackBox(8, 2), stackBox(9, 2));
+	}
+
+	~IslandTestScene()
+	{
+		for (int i = 0; i < m_constraints.size(); ++i)
+		{
+			if (m_constraints[i])
+			{
+				m_world->removeConstraint(m_constraints[i]);
+				delete m_constraints[i];
+			}
+		}
+		for (int i = 0; i < m_bodies.size(); ++i)
+		{
+			if (m_bodies[i])
+			{
+				m_world->removeRigidBody(m_bodies[i]);
+				delete m_bodies[i];
+			}
+		}
+		delete m_world;
+		delete m_solverPool;
+	}
+
+	btRigidBody* addBody(btScalar mass, btCollisionShape* shape, const btVector3& position)
+	{
+		btVector3 inertia(0, 0, 0);
+		if (mass != 0)
+		{
+			shape->calculateLocalInertia(mass, inertia);
+		}
+		btRigidBody* body = new btRigidBody(mass, 0, shape, inertia);
+		body->setWorldTransform(btTransform(btQuaternion::getIdentity(), position));
+		m_world->addRigidBody(body);
+		m_bodies.push_back(body);
+		return body;
+	}
+
+	// box 'level' from the bottom of stack 'stack'
+	btRigidBody* stackBox(int stack, int level)
+	{
+		return m_bodies[1 + stack * 3 + level];
+	}
+
+	void addConstraint(btRigidBody* body0, btRigidBody* body1)
+	{
+		btVector3 center = (body0->getCenterOfMassPosition() + body1->getCenterOfMassPosition()) * btScalar(0.5);
+		btTypedConstraint* constraint = new btPoint2PointConstraint(*body0, *body1, center - body0->getCenterOfMassPosition(), center - body1->getCenterOfMassPosition());
+		m_world->addConstraint(constraint);
+		m_constraints.push_back(constraint);
+	}
+
+	void removeConstraint(int index)
+	{
+		m_world->removeConstraint(m_constraints[index]);
+		delete m_constraints[index];
+		m_constraints[index] = 0;
+	}
+
+	void removeBody(btRigidBody* body)
+	{
+		int index = m_bodies.findLinearSearch(body);
+		m_world->removeRigidBody(body);
+		delete body;
+		m_bodies[index] = 0;
+	}
+
+	bool allSleeping() const
+	{
+		for (int i = 0; i < m_bodies.size(); ++i)
+		{
+			if (m_bodies[i] && !m_bodies[i]->isStaticObject() && m_bodies[i]->getActivationState() != ISLAND_SLEEPING)
+			{
+				return false;
+			}
+		}
+		return true;
+	}
+
+	// the islands from scratch: the pairs and enabled constraints of the last step united by collision object index
+	void rebuildIslands()
+	{
+		const btCollisionObjectArray& objects = m_world->getCollisionObjectArray();
+		m_unionFind.reset(objects.size());
+		btOverlappingPairCache* pairCache = m_world->getPairCache();
+		for (int i = 0; i < pairCache->getNumOverlappingPairs(); ++i)
+		{
+			const btBroadphasePair& pair = pairCache->getOverlappingPairArray()[i];
+			const btCollisionObject* colObj0 = static_cast<const btCollisionObject*>(pair.m_pProxy0->m_clientObject);
+			const btCollisionObject* colObj1 = static_cast<const btCollisionObject*>(pair.m_pProxy1->m_clientObject);
+			if (colObj0->mergesSimulationIslands() && colObj1->mergesSimulationIslands())
+			{
+				m_unionFind.unite(colObj0->getWorldArrayIndex(), colObj1->getWorldArrayIndex());
+			}
+		}
+		for (int i = 0; i < m_world->getNumConstraints(); ++i)
+		{
+			const btTypedConstraint* constraint = m_world->getConstraint(i);
+			if (constraint->isEnabled() && !constraint->getRigidBodyA().isStaticOrKinematicObject() && !constraint->getRigidBodyB().isStaticOrKinematicObject())
+			{
+				m_unionFind.unite(constraint->getRigidBodyA().getWorldArrayIndex(), constraint->getRigidBodyB().getWorldArrayIndex());
+			}
+		}
+	}
+
+	// the island tags of the world give every island of the rebuild one tag, and different ones if 'exact',
+	// otherwise the world may still have islands that came apart on the last step joined
+	void expectIslandsMatchRebuild(bool exact)
+	{
+		rebuildIslands();
+		const btCollisionObjectArray& objects = m_world->getCollisionObjectArray();
+		btAlignedObjectArray<int> rootTags;
+		rootTags.resize(objects.size(), -1);
+		btAlignedObjectArray<int> tagRoots;
+		tagRoots.resize(objects.size(), -1);
+		for (int i = 0; i < objects.size(); ++i)
+		{
+			int tag = objects[i]->getIslandTag();
+			if (objects[i]->isStaticOrKinematicObject())
+			{
+				EXPECT_EQ(-1, tag);
+				continue;
+			}
+			ASSERT_GE(tag, 0);
+			ASSERT_LT(tag, objects.size());
+			int root = m_unionFind.find(i);
+			if (rootTags[root] < 0)
+			{
+				rootTags[root] = tag;
+			}
+			EXPECT_EQ(rootTags[root], tag) << "body " << i << " is not in the island of the bodies it touches";
+			if (tagRoots[tag] < 0)
+			{
+				tagRoots[tag] = root;
+			}
+			if (exact)
+			{
+				EXPECT_EQ(tagRoots[tag], root) << "body " << i << " shares an island with bodies it does not touch";
+			}
+		}
+	}
+
+	// every island went to the solver whole, with its manifolds and constraints next to it. Rebuilt islands keep
+	// their bodies in collision object order, persistent ones in the order they joined.
+	void expectSolvedIslandsMatchTags()
+	{
+		const bool ordered = !m_world->getPersistentSimulationIslands();
+		const btCollisionObjectArray& objects = m_world->getCollisionObjectArray();
+		btAlignedObjectArray<int> tagBatches;
+		tagBatches.resize(objects.size(), -1);
+		btAlignedObjectArray<int> tagSizes;
+		tagSizes.resize(objects.size(), 0);
+		for (int i = 0; i < objects.size(); ++i)
+		{
+			if (objects[i]->getIslandTag() >= 0)
+			{
+				tagSizes[objects[i]->getIslandTag()]++;
+			}
+		}
+		for (int i = 0; i < s_solvedIslands.size(); ++i)
+		{
+			const btAlignedObjectArray<btCollisionObject*>& bodies = s_solvedIslands[i].bodyArray;
+			for (int j = 0; j < bodies.size(); ++j)
+			{
+				int tag = bodies[j]->getIslandTag();
+				ASSERT_GE(tag, 0);
+				if (j > 0 && bodies[j - 1]->getIslandTag() == tag)
+				{
+					if (ordered)
+					{
+						EXPECT_LT(bodies[j - 1]->getWorldArrayIndex(), bodies[j]->getWorldArrayIndex());
+					}
+					continue;
+				}
+				// the first body of the island
+				EXPECT_EQ(-1, tagBatches[tag]) << "island " << tag << " was split up or solved twice";
+				tagBatches[tag] = i;
+				EXPECT_LE(j + tagSizes[tag], bodies.size());
+				for (int k = j; k < j + tagSizes[tag] && k < bodies.size(); ++k)
+				{
+					EXPECT_EQ(tag, bodies[k]->getIslandTag());
+				}
+			}
+		}
+		for (int i = 0; i < s_solvedIslands.size(); ++i)
+		{
+			const btAlignedObjectArray<btPersistentManifold*>& manifolds = s_solvedIslands[i].manifoldArray;
+			for (int j = 0; j < manifolds.size(); ++j)
+			{
+				int tag = manifolds[j]->getBody0()->getIslandTag() >= 0 ? manifolds[j]->getBody0()->getIslandTag() : manifolds[j]->getBody1()->getIslandTag();
+				EXPECT_EQ(i, tagBatches[tag]);
+			}
+			const btAlignedObjectArray<btTypedConstraint*>& constraints = s_solvedIslands[i].constraintArray;
+			for (int j = 0; j < constraints.size(); ++j)
+			{
+				int tag = constraints[j]->getRigidBodyA().getIslandTag() >= 0 ? constraints[j]->getRigidBodyA().getIslandTag() : constraints[j]->getRigidBodyB().getIslandTag();
+				EXPECT_EQ(i, tagBatches[tag]);
+			}
+		}
+	}
+
+	void step(int numSteps, bool exact)
+	{
+		for (int i = 0; i < numSteps; ++i)
+		{
+			s_solvedIslands.resize(0);
+			m_world->stepSimulation(btScalar(1. / 60.), 0);
+			expectIslandsMatchRebuild(exact);
+			if (m_solverPool)
+			{
+				expectSolvedIslandsMatchTags();
+			}
+		}
+	}
+
+	// steps until everything sleeps, the persistent islands are then split where needed on the next steps
+	void settle(bool exact)
+	{
+		for (int i = 0; i < 1200 && !allSleeping(); ++i)
+		{
+			step(1, exact);
+		}
+		EXPECT_TRUE(allSleeping());
+		step(2, exact);
+		expectIslandsMatchRebuild(true);
+	}
+};
+
+// adds, removes, wakes and puts to sleep bodies across steps and checks the islands of every step against a rebuild.
+// Rebuilt islands must match exactly on every step, persistent ones once everything came to rest.
+void checkIslandsAcrossSteps(bool multithreaded, bool persistentIslands)
+{
+	const bool exact = !persistentIslands;
+	IslandTestScene scene(multithreaded, persistentIslands);
+	scene.settle(exact);
+
+	// take the middle box out of stack 3 and the top box off stack 6, the box above falls onto the one below
+	scene.removeBody(scene.stackBox(3, 1));
+	scene.stackBox(3, 2)->activate();
+	scene.removeBody(scene.stackBox(6, 2));
+	// without waking stack 7 its top box stays asleep in the air, in an island of its own
+	scene.removeBody(scene.stackBox(7, 1));
+	scene.step(1, exact);
+	// a plank dropped across stacks 10 and 11 joins their islands when it lands
+	scene.addBody(1, &scene.m_plankShape, btVector3(btScalar(31.5), 4, 0));
+	// wake stack 0 and the stack it is tied to, put stack 5 to sleep right after waking it
+	scene.stackBox(0, 0)->activate();
+	scene.stackBox(5, 0)->activate();
+	scene.step(10, exact);
+	for (int i = 0; i < 3; ++i)
+	{
+		scene.stackBox(5, i)->setActivationState(ISLAND_SLEEPING);
+	}
+	scene.step(10, exact);
+	scene.settle(exact);
+
+	// untie stacks 8 and 9, their island only comes apart once it is split
+	scene.removeConstraint(1);
+	scene.stackBox(8, 2)->activate();
+	scene.stackBox(9, 2)->activate();
+	// a box on its own, and another box onto stack 4
+	scene.addBody(1, &scene.m_boxShape, btVector3(-10, btScalar(0.5), 10));
+	scene.addBody(1, &scene.m_boxShape, btVector3(12, 5, 0));
+	scene.step(20, exact);
+	scene.settle(exact);
+}
+
+}  // namespace
+
+class SimulationIslandThreadTest : public ThreadTest
+{
+};
+
+TEST(SimulationIslandTest, RebuiltIslands)
+{
+	checkIslandsAcrossSteps(false, false);
+}
+
+TEST(SimulationIslandTest, PersistentIslands)
+{
+	checkIslandsAcrossSteps(false, true);
+}
+
+TEST(SimulationIslandTest, ParallelIslandsOnOneThread)
+{
+	btSetTaskScheduler(btGetSequentialTaskScheduler());
+	checkIslandsAcrossSteps(true, false);
+}
+
+TEST(SimulationIslandTest, ParallelPersistentIslandsOnOneThread)
+{
+	btSetTaskScheduler(btGetSequentialTaskScheduler());
+	checkIslandsAcrossSteps(true, true);
+}
+
+TEST_F(SimulationIslandThreadTest, ParallelIslands)
+{
+	checkIslandsAcrossSteps(true, false);
+}
+
+TEST_F(SimulationIslandThreadTest, ParallelPersistentIslands)
+{
+	checkIslandsAcrossSteps(true, true);
+}
+
+int main(int argc, char** argv)
+{
+	::testing::InitGoogleTest(&argc, argv);
+	return RUN_ALL_TESTS();
+}
@@ -0,0 +1,146 @@
+/*
+Bullet Continuous Collision Detection and Physics Library
+Copyright (c) 2003-2018 Erwin Coumans  https://bulletphysics.org
+
+This software is provided 'as-is', without any express or implied warranty.
+In no event will the authors be held liable for any damages arising from the use of this software.
+Permission is granted to anyone to use this software for any purpose,
+including commercial applications, and to alter it and redistribute it freely,
+subject to the following restrictions:
+
+1. The origin of this software must not be misrepresented; you must not claim that you wrote the original software. If you use this software in a product, an acknowledgment in the product documentation would be appreciated but is not required.
+2. Altered source versions must be plainly marked as such, and must not be misrepresented as being the original software.
+3. This notice may not be removed or altered from any source distribution.
+*/
+
+#ifndef DEFORMABLE_TEST_SYSTEM_H
+#define DEFORMABLE_TEST_SYSTEM_H
+
+#include <BulletSoftBody/btDeformableBlockMatrix.h>
+#include <LinearMath/btAlignedObjectArray.h>
+#include <LinearMath/btMatrix3x3.h>
+
+///The matrix of a nx x ny x nz grid of unit masses with springs along the edges and the face diagonals, one block row per node.
+///The springs are stiffer along x than along z and the diagonal ones couple the directions of a node, so the matrix is
+///symmetric positive definite but not diagonal within a block. The blocks are kept as the triplets of addBlock, in the
+///order they are added: every spring adds its four blocks, so the diagonal blocks are the sum of many triplets.
+struct DeformableTestSystem
+{
+	typedef btAlignedObjectArray<btVector3> TVStack;
+
+	int m_numRows;
+	btAlignedObjectArray<int> m_rows;
+	btAlignedObjectArray<int> m_cols;
+	btAlignedObjectArray<btMatrix3x3> m_blocks;
+
+	DeformableTestSystem(int nx, int ny, int nz)
+		: m_numRows(nx * ny * nz)
+	{
+		for (int i = 0; i < m_numRows; ++i)
+		{
+			add(i, i, btMatrix3x3::getIdentity());
+		}
+		const int offsets[][3] = {{1, 0, 0}, {0, 1, 0}, {0, 0, 1}, {1, 1, 0}, {1, 0, 1}, {0, 1, -1}};
+		for (int x = 0; x < nx; ++x)
+		{
+			for (int y = 0; y < ny; ++y)
+			{
+				for (int z = 0; z < nz; ++z)
+				{
+					for (int o = 0; o < 6; ++o)
+					{
+						int x1 = x + offsets[o][0], y1 = y + offsets[o][1], z1 = z + offsets[o][2];
+						if (x1 < nx && y1 < ny && z1 >= 0 && z1 < nz)
+						{
+							btVector3 d(btScalar(offsets[o][0]), btScalar(offsets[o][1]), btScalar(offsets[o][2]));
+							btScalar k = btScalar(1 + 40 * offsets[o][0] + 10 * offsets[o][1]) / d.length2();
+							addSpring((x * ny + y) * nz + z, (x1 * ny + y1) * nz + z1, d, k);
+						}
+					}
+				}
+			}
+		}
+	}
+
+	void add(int row, int col, const btMatrix3x3& block)
+	{
+		m_rows.push_back(row);
+		m_cols.push_back(col);
+		m_blocks.push_back(block);
+	}
+
+	// k * d * d^T between the nodes, i.e. the stiffness of a spring along d
+	void addSpring(int i, int j, const btVector3& d, btScalar k)
+	{
+		btMatrix3x3 block(d[0] * d[0], d[0] * d[1], d[0] * d[2], d[1] * d[0], d[1] * d[1], d[1] * d[2], d[2] * d[0], d[2] * d[1], d[2] * d[2]);
+		block = block * k;
+		add(i, i, block);
+		add(j, j, block);
+		add(i, j, block * btScalar(-1));
+		add(j, i, block * btScalar(-1));
+	}
+
+	void assemble(btDeformableBlockMatrix& A) const
+	{
+		A.reset(m_numRows);
+		for (int i = 0; i < m_blocks.size(); ++i)
+		{
+			A.addBlock(m_rows[i], m_cols[i], m_blocks[i]);
+		}
+		A.finalize();
+	}
+
+	// b = A * x from the triplets one by one
+	void multiply(const TVStack& x, TVStack& b) const
+	{
+		b.resize(m_numRows);
+		for (int i = 0; i < m_numRows; ++i)
+		{
+			b[i].setZero();
+		}
+		for (int i = 0; i < m_blocks.size(); ++i)
+		{
+			b[m_rows[i]] += m_blocks[i] * x[m_cols[i]];
+		}
+	}
+
+	// a vector with entries in [-1, 1) that is the same for every call with the same seed
+	void randomVector(unsigned int seed, TVStack& x) const
+	{
+		x.resize(m_numRows);
+		for (int i = 0; i < m_numRows; ++i)
+		{
+			for (int d = 0; d < 3; ++d)
+			{
+				seed = seed * 1664525u + 1013904223u;
+				x[i][d] = btScalar(seed >> 8) / btScalar(1 << 23) - 1;
+			}
+		}
+	}
+};
+
+///The matrix interface of btConjugateGradient for an assembled matrix, without constraints and preconditioner
+struct AssembledTestMatrix
+{
+	typedef btAlignedObjectArray<btVector3> TVStack;
+
+	const btDeformableBlockMatrix& m_A;
+
+	AssembledTestMatrix(const btDeformableBlockMatrix& A) : m_A(A) {}
+
+	void multiply(const TVStack& x, TVStack& b) const
+	{
+		m_A.multiply(x, b);
+	}
+
+	void project(TVStack& x) const
+	{
+	}
+
+	void precondition(const TVStack& x, TVStack& b) const
+	{
+		b = x;
+	}
+};
+
+#endif  //DEFORMABLE_TEST_SYSTEM_H
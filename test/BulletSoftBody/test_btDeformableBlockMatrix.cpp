@@ -0,0 +1,235 @@
+/*
+Bullet Continuous Collision Detection and Physics Library
+Copyright (c) 2003-2018 Erwin Coumans  https://bulletphysics.org
+
+This software is provided 'as-is', without any express or implied warranty.
+In no event will the authors be held liable for any damages arising from the use of this software.
+Permission is granted to anyone to use this software for any purpose,
+including commercial applications, and to alter it and redistribute it freely,
+subject to the following restrictions:
+
+1. The origin of this software must not be misrepresented; you must not claim that you wrote the original software. If you use this software in a product, an acknowledgment in the product documentation would be appreciated but is not required.
+2. Altered source versions must be plainly marked as such, and must not be misrepresented as being the original software.
+3. This notice may not be removed or altered from any source distribution.
+*/
+
+#include <BulletSoftBody/btConjugateGradient.h>
+#include <BulletSoftBody/btDeformableBlockMatrix.h>
+#include <LinearMath/btThreads.h>
+#include <gtest/gtest.h>
+
+#include "DeformableTestSystem.h"
+#include "ThreadTest.h"
+
+namespace
+{
+typedef btAlignedObjectArray<btVector3> TVStack;
+
+// the products sum the same terms in another order
+const btScalar kTolerance = SIMD_EPSILON * btScalar(1e4);
+
+void expectNear(const TVStack& expected, const TVStack& actual)
+{
+	ASSERT_EQ(expected.size(), actual.size());
+	for (int i = 0; i < expected.size(); ++i)
+	{
+		for (int d = 0; d < 3; ++d)
+		{
+			ASSERT_NEAR(expected[i][d], actual[i][d], kTolerance * (1 + btFabs(expected[i][d]))) << "row " << i << " axis " << d;
+		}
+	}
+}
+
+void expectSameMatrix(const btDeformableBlockMatrix& a, const btDeformableBlockMatrix& b)
+{
+	ASSERT_EQ(a.getNumRows(), b.getNumRows());
+	ASSERT_EQ(a.getNumBlocks(), b.getNumBlocks());
+	for (int i = 0; i <= a.getNumRows(); ++i)
+	{
+		ASSERT_EQ(a.getRowBegin(i), b.getRowBegin(i));
+	}
+	for (int i = 0; i < a.getNumBlocks(); ++i)
+	{
+		ASSERT_EQ(a.getColumn(i), b.getColumn(i));
+		ASSERT_TRUE(a.getBlock(i) == b.getBlock(i)) << "block " << i;
+	}
+}
+
+// solves A x = b with plain CG from x = 0
+int solve(const btDeformableBlockMatrix& A, const TVStack& b, TVStack& x)
+{
+	AssembledTestMatrix matrix(A);
+	btConjugateGradient<AssembledTestMatrix> cg(500);
+	x.resize(b.size());
+	for (int i = 0; i < x.size(); ++i)
+	{
+		x[i].setZero();
+	}
+	return cg.solve(matrix, x, b);
+}
+
+class DeformableBlockMatrixThreadTest : public ThreadTest
+{
+};
+
+}  // namespace
+
+TEST(DeformableBlockMatrixTest, MatchesDenseMatrix)
+{
+	DeformableTestSystem system(3, 3, 3);
+	const int n = 3 * system.m_numRows;
+	btAlignedObjectArray<btScalar> dense;
+	btAlignedObjectArray<bool> used;
+	dense.resize(n * n, 0);
+	used.resize(system.m_numRows * system.m_numRows, false);
+	for (int t = 0; t < system.m_blocks.size(); ++t)
+	{
+		for (int r = 0; r < 3; ++r)
+		{
+			for (int c = 0; c < 3; ++c)
+			{
+				dense[(3 * system.m_rows[t] + r) * n + 3 * system.m_cols[t] + c] += system.m_blocks[t][r][c];
+			}
+		}
+		used[system.m_rows[t] * system.m_numRows + system.m_cols[t]] = true;
+	}
+	btDeformableBlockMatrix A;
+	system.assemble(A);
+
+	// one block per position that a triplet was added at, sorted by column, with the sum of its triplets
+	int numBlocks = 0;
+	for (int row = 0; row < A.getNumRows(); ++row)
+	{
+		// every node has a mass
+		EXPECT_GE(A.getDiagonalIndex(row), 0);
+		for (int i = A.getRowBegin(row); i < A.getRowBegin(row + 1); ++i)
+		{
+			const int col = A.getColumn(i);
+			EXPECT_TRUE(used[row * system.m_numRows + col]);
+			if (i > A.getRowBegin(row))
+			{
+				EXPECT_LT(A.getColumn(i - 1), col);
+			}
+			if (col == row)
+			{
+				EXPECT_EQ(i, A.getDiagonalIndex(row));
+			}
+			for (int r = 0; r < 3; ++r)
+			{
+				for (int c = 0; c < 3; ++c)
+				{
+					btScalar expected = dense[(3 * row + r) * n + 3 * col + c];
+					EXPECT_NEAR(expected, A.getBlock(i)[r][c], kTolerance * (1 + btFabs(expected)));
+				}
+			}
+			numBlocks++;
+		}
+	}
+	int numUsed = 0;
+	for (int i = 0; i < used.size(); ++i)
+	{
+		numUsed += used[i] ? 1 : 0;
+	}
+	EXPECT_EQ(numUsed, numBlocks);
+	EXPECT_EQ(numUsed, A.getNumBlocks());
+
+	TVStack x, b;
+	system.randomVector(1, x);
+	b.resize(system.m_numRows);
+	A.multiply(x, b);
+	TVStack expected;
+	expected.resize(system.m_numRows);
+	for (int i = 0; i < system.m_numRows; ++i)
+	{
+		for (int r = 0; r < 3; ++r)
+		{
+			btScalar sum = 0;
+			for (int j = 0; j < n; ++j)
+			{
+				sum += dense[(3 * i + r) * n + j] * x[j / 3][j % 3];
+			}
+			expected[i][r] = sum;
+		}
+	}
+	expectNear(expected, b);
+}
+
+TEST(DeformableBlockMatrixTest, MultiplyMatchesTriplets)
+{
+	// more rows than one parallel chunk
+	DeformableTestSystem system(12, 12, 12);
+	btDeformableBlockMatrix A;
+	system.assemble(A);
+	TVStack x, b, expected;
+	system.randomVector(2, x);
+	b.resize(system.m_numRows);
+	A.multiply(x, b);
+	system.multiply(x, expected);
+	expectNear(expected, b);
+
+	// a matrix reset and assembled again is the same
+	btDeformableBlockMatrix B;
+	system.assemble(B);
+	system.assemble(B);
+	expectSameMatrix(A, B);
+}
+
+TEST(DeformableBlockMatrixTest, ConjugateGradientSolves)
+{
+	DeformableTestSystem system(12, 12, 12);
+	btDeformableBlockMatrix A;
+	system.assemble(A);
+	TVStack expected, b, x;
+	system.randomVector(3, expected);
+	system.multiply(expected, b);
+	int iterations = solve(A, b, x);
+	EXPECT_LT(iterations, 500);
+	for (int i = 0; i < x.size(); ++i)
+	{
+		for (int d = 0; d < 3; ++d)
+		{
+			ASSERT_NEAR(expected[i][d], x[i][d], btScalar(1e-3)) << "row " << i << " axis " << d;
+		}
+	}
+}
+
+// the assembly, the product and the Krylov dot products give the same bits for any number of threads
+TEST_F(DeformableBlockMatrixThreadTest, SameResultForAnyThreadCount)
+{
+	DeformableTestSystem system(12, 12, 12);
+	TVStack x, b;
+	system.randomVector(4, x);
+	system.multiply(x, b);
+
+	setNumThreads(1);
+	btDeformableBlockMatrix single;
+	system.assemble(single);
+	TVStack singleProduct, singleSolution;
+	singleProduct.resize(system.m_numRows);
+	single.multiply(x, singleProduct);
+	int singleIterations = solve(single, b, singleSolution);
+
+	int threadCounts[] = {2, 4, 8};
+	for (int t = 0; t < 3; ++t)
+	{
+		setNumThreads(threadCounts[t]);
+		btDeformableBlockMatrix multi;
+		system.assemble(multi);
+		expectSameMatrix(single, multi);
+		TVStack product, solution;
+		product.resize(system.m_numRows);
+		multi.multiply(x, product);
+		EXPECT_EQ(solve(multi, b, solution), singleIterations);
+		for (int i = 0; i < system.m_numRows; ++i)
+		{
+			ASSERT_EQ(singleProduct[i], product[i]) << "row " << i;
+			ASSERT_EQ(singleSolution[i], solution[i]) << "row " << i;
+		}
+	}
+}
+
+int main(int argc, char** argv)
+{
+	::testing::InitGoogleTest(&argc, argv);
+	return RUN_ALL_TESTS();
+}
@@ -0,0 +1,251 @@
+/*
+Bullet Continuous Collision Detection and Physics Library
+Copyright (c) 2003-2018 Erwin Coumans  https://bulletphysics.org
+
+This software is provided 'as-is', without any express or implied warranty.
+In no event will the authors be held liable for any damages arising from the use of this software.
+Permission is granted to anyone to use this software for any purpose,
+including commercial applications, and to alter it and redistribute it freely,
+subject to the following restrictions:
+
+1. The origin of this software must not be misrepresented; you must not claim that you wrote the original software. If you use this software in a product, an acknowledgment in the product documentation would be appreciated but is not required.
+2. Altered source versions must be plainly marked as such, and must not be misrepresented as being the original software.
+3. This notice may not be removed or altered from any source distribution.
+*/
+
+#include <BulletSoftBody/btConjugateGradient.h>
+#include <BulletSoftBody/btDeformableBackwardEulerObjective.h>
+#include <BulletSoftBody/btPreconditioner.h>
+#include <LinearMath/btThreads.h>
+#include <gtest/gtest.h>
+
+#include "DeformableTestSystem.h"
+#include "ThreadTest.h"
+
+namespace
+{
+typedef btAlignedObjectArray<btVector3> TVStack;
+
+const btScalar kTolerance = SIMD_EPSILON * btScalar(1e4);
+
+///The assembled matrix with one of the preconditioners
+struct PreconditionedTestMatrix : public AssembledTestMatrix
+{
+	Preconditioner* m_preconditioner;
+
+	PreconditionedTestMatrix(const btDeformableBlockMatrix& A, Preconditioner* preconditioner)
+		: AssembledTestMatrix(A), m_preconditioner(preconditioner)
+	{
+	}
+
+	void precondition(const TVStack& x, TVStack& b) const
+	{
+		(*m_preconditioner)(x, b);
+	}
+};
+
+enum PreconditionerType
+{
+	DEFAULT_PRECONDITIONER,
+	BLOCK_JACOBI_PRECONDITIONER,
+	INCOMPLETE_CHOLESKY_PRECONDITIONER,
+	MULTIGRID_PRECONDITIONER,
+	NUM_PRECONDITIONER_TYPES
+};
+
+const char* preconditionerName(int type)
+{
+	const char* names[] = {"default", "block Jacobi", "incomplete Cholesky", "multigrid"};
+	return names[type];
+}
+
+Preconditioner* createPreconditioner(int type, const btDeformableBlockMatrix& A)
+{
+	Preconditioner* preconditioner = NULL;
+	switch (type)
+	{
+		case BLOCK_JACOBI_PRECONDITIONER:
+			preconditioner = new BlockJacobiPreconditioner();
+			break;
+		case INCOMPLETE_CHOLESKY_PRECONDITIONER:
+			preconditioner = new IncompleteCholeskyPreconditioner();
+			break;
+		case MULTIGRID_PRECONDITIONER:
+			preconditioner = new MultigridPreconditioner();
+			break;
+		default:
+			preconditioner = new DefaultPreconditioner();
+	}
+	EXPECT_EQ(type != DEFAULT_PRECONDITIONER, preconditioner->needsAssembledMatrix());
+	preconditioner->buildFromMatrix(A);
+	return preconditioner;
+}
+
+// solves A x = b with preconditioned CG from x = 0
+int solve(const btDeformableBlockMatrix& A, Preconditioner* preconditioner, const TVStack& b, TVStack& x)
+{
+	PreconditionedTestMatrix matrix(A, preconditioner);
+	btConjugateGradient<PreconditionedTestMatrix> cg(500);
+	x.resize(b.size());
+	for (int i = 0; i < x.size(); ++i)
+	{
+		x[i].setZero();
+	}
+	return cg.solve(matrix, x, b);
+}
+
+btScalar dot(const TVStack& a, const TVStack& b)
+{
+	btScalar sum = 0;
+	for (int i = 0; i < a.size(); ++i)
+	{
+		sum += a[i].dot(b[i]);
+	}
+	return sum;
+}
+
+class PreconditionerThreadTest : public ThreadTest
+{
+};
+
+}  // namespace
+
+// every preconditioner reaches the solution, the incomplete Cholesky and the multigrid ones in fewer iterations than plain CG
+TEST(PreconditionerTest, ConjugateGradientSolves)
+{
+	DeformableTestSystem system(12, 12, 12);
+	btDeformableBlockMatrix A;
+	system.assemble(A);
+	TVStack expected, b;
+	system.randomVector(1, expected);
+	system.multiply(expected, b);
+	int iterations[NUM_PRECONDITIONER_TYPES];
+	for (int type = 0; type < NUM_PRECONDITIONER_TYPES; ++type)
+	{
+		Preconditioner* preconditioner = createPreconditioner(type, A);
+		TVStack x;
+		iterations[type] = solve(A, preconditioner, b, x);
+		delete preconditioner;
+		EXPECT_LT(iterations[type], 500) << preconditionerName(type);
+		for (int i = 0; i < x.size(); ++i)
+		{
+			for (int d = 0; d < 3; ++d)
+			{
+				ASSERT_NEAR(expected[i][d], x[i][d], btScalar(1e-3)) << preconditionerName(type) << " row " << i << " axis " << d;
+			}
+		}
+	}
+	EXPECT_LE(iterations[BLOCK_JACOBI_PRECONDITIONER], iterations[DEFAULT_PRECONDITIONER]);
+	EXPECT_LT(iterations[INCOMPLETE_CHOLESKY_PRECONDITIONER], iterations[BLOCK_JACOBI_PRECONDITIONER]);
+	EXPECT_LT(iterations[MULTIGRID_PRECONDITIONER], iterations[BLOCK_JACOBI_PRECONDITIONER]);
+}
+
+// CG needs a symmetric preconditioner, u . M v = v . M u
+TEST(PreconditionerTest, Symmetric)
+{
+	DeformableTestSystem system(10, 10, 10);
+	btDeformableBlockMatrix A;
+	system.assemble(A);
+	TVStack u, v, Mu, Mv;
+	system.randomVector(2, u);
+	system.randomVector(3, v);
+	Mu.resize(u.size());
+	Mv.resize(v.size());
+	for (int type = BLOCK_JACOBI_PRECONDITIONER; type < NUM_PRECONDITIONER_TYPES; ++type)
+	{
+		Preconditioner* preconditioner = createPreconditioner(type, A);
+		(*preconditioner)(u, Mu);
+		(*preconditioner)(v, Mv);
+		delete preconditioner;
+		btScalar uMv = dot(u, Mv);
+		EXPECT_NEAR(uMv, dot(v, Mu), kTolerance * (1 + btFabs(uMv))) << preconditionerName(type);
+	}
+}
+
+// a chain of nodes has no fill-in, so IC(0) is the exact factorization
+TEST(PreconditionerTest, IncompleteCholeskyExactWithoutFillIn)
+{
+	DeformableTestSystem system(40, 1, 1);
+	btDeformableBlockMatrix A;
+	system.assemble(A);
+	IncompleteCholeskyPreconditioner preconditioner;
+	preconditioner.buildFromMatrix(A);
+	EXPECT_EQ(A.getNumRows(), preconditioner.getNumRows());
+	TVStack x, b, solution;
+	system.randomVector(4, x);
+	system.multiply(x, b);
+	solution.resize(b.size());
+	preconditioner(b, solution);
+	for (int i = 0; i < x.size(); ++i)
+	{
+		for (int d = 0; d < 3; ++d)
+		{
+			ASSERT_NEAR(x[i][d], solution[i][d], kTolerance * (1 + btFabs(x[i][d]))) << "row " << i << " axis " << d;
+		}
+	}
+	TVStack iterated;
+	EXPECT_LE(solve(A, &preconditioner, b, iterated), 1);
+}
+
+// entries past the rows of the matrix, e.g. of the contact constraints, are passed through
+TEST(PreconditionerTest, ExtraEntriesPassedThrough)
+{
+	DeformableTestSystem system(4, 4, 4);
+	btDeformableBlockMatrix A;
+	system.assemble(A);
+	TVStack x, b;
+	system.randomVector(5, x);
+	x.push_back(btVector3(1, 2, 3));
+	b.resize(x.size());
+	for (int type = 0; type < NUM_PRECONDITIONER_TYPES; ++type)
+	{
+		Preconditioner* preconditioner = createPreconditioner(type, A);
+		(*preconditioner)(x, b);
+		delete preconditioner;
+		EXPECT_EQ(x[x.size() - 1], b[b.size() - 1]) << preconditionerName(type);
+	}
+}
+
+// the parallel loops of the preconditioners give the same bits for any number of threads
+TEST_F(PreconditionerThreadTest, SameResultForAnyThreadCount)
+{
+	DeformableTestSystem system(12, 12, 12);
+	btDeformableBlockMatrix A;
+	system.assemble(A);
+	TVStack x;
+	system.randomVector(6, x);
+
+	setNumThreads(1);
+	TVStack single[NUM_PRECONDITIONER_TYPES];
+	for (int type = BLOCK_JACOBI_PRECONDITIONER; type < NUM_PRECONDITIONER_TYPES; ++type)
+	{
+		Preconditioner* preconditioner = createPreconditioner(type, A);
+		single[type].resize(x.size());
+		(*preconditioner)(x, single[type]);
+		delete preconditioner;
+	}
+
+	int threadCounts[] = {2, 4, 8};
+	for (int t = 0; t < 3; ++t)
+	{
+		setNumThreads(threadCounts[t]);
+		for (int type = BLOCK_JACOBI_PRECONDITIONER; type < NUM_PRECONDITIONER_TYPES; ++type)
+		{
+			Preconditioner* preconditioner = createPreconditioner(type, A);
+			TVStack b;
+			b.resize(x.size());
+			(*preconditioner)(x, b);
+			delete preconditioner;
+			for (int i = 0; i < x.size(); ++i)
+			{
+				ASSERT_EQ(single[type][i], b[i]) << preconditionerName(type) << " row " << i;
+			}
+		}
+	}
+}
+
+int main(int argc, char** argv)
+{
+	::testing::InitGoogleTest(&argc, argv);
+	return RUN_ALL_TESTS();
+}
@@ -0,0 +1,207 @@
+/*
+Bullet Continuous Collision Detection and Physics Library
+Copyright (c) 2003-2018 Erwin Coumans  https://bulletphysics.org
+
+This software is provided 'as-is', without any express or implied warranty.
+In no event will the authors be held liable for any damages arising from the use of this software.
+Permission is granted to anyone to use this software for any purpose,
+including commercial applications, and to alter it and redistribute it freely,
+subject to the following restrictions:
+
+1. The origin of this software must not be misrepresented; you must not claim that you wrote the original software. If you use this software in a product, an acknowledgment in the product documentation would be appreciated but is not required.
+2. Altered source versions must be plainly marked as such, and must not be misrepresented as being the original software.
+3. This notice may not be removed or altered from any source distribution.
+*/
+
+#include <btBulletDynamicsCommon.h>
+#include <BulletDynamics/Featherstone/btMultiBodyConstraintSolver.h>
+#include <BulletSoftBody/btSoftBodyHelpers.h>
+#include <BulletSoftBody/btSoftBodyRigidBodyCollisionConfiguration.h>
+#include <BulletSoftBody/btSoftMultiBodyDynamicsWorld.h>
+#include <LinearMath/btThreads.h>
+#include <gtest/gtest.h>
+
+#include "ThreadTest.h"
+
+namespace
+{
+// cloth patches with bending constraints, pinned at two corners and swinging down onto a static ground
+struct ClothTestScene
+{
+	btSoftBodyRigidBodyCollisionConfiguration m_config;
+	btCollisionDispatcher m_dispatcher;
+	btDbvtBroadphase m_broadphase;
+	btMultiBodyConstraintSolver m_solver;
+	btSoftMultiBodyDynamicsWorld* m_world;
+	btBoxShape m_groundShape;
+	btRigidBody* m_ground;
+	btAlignedObjectArray<btSoftBody*> m_cloths;
+
+	ClothTestScene(int numCloths, bool useLinkColoring)
+		: m_dispatcher(&m_config),
+		  m_groundShape(btVector3(50, 1, 50))
+	{
+		m_world = new btSoftMultiBodyDynamicsWorld(&m_dispatcher, &m_broadphase, &m_solver, &m_config);
+		btSoftBodyWorldInfo& worldInfo = m_world->getWorldInfo();
+		worldInfo.m_broadphase = &m_broadphase;
+		worldInfo.m_dispatcher = &m_dispatcher;
+		worldInfo.m_gravity = btVector3(0, -10, 0);
+		worldInfo.m_sparsesdf.Initialize();
+		m_ground = new btRigidBody(0, 0, &m_groundShape);
+		m_ground->getWorldTransform().setOrigin(btVector3(0, -1, 0));
+		m_world->addRigidBody(m_ground);
+		for (int i = 0; i < numCloths; ++i)
+		{
+			btScalar y = btScalar(2 + i * 0.5);
+			btScalar x = btScalar(i * 0.3);
+			btSoftBody* cloth = btSoftBodyHelpers::CreatePatch(worldInfo, btVector3(x - 2, y, -2), btVector3(x + 2, y, -2), btVector3(x - 2, y, 2), btVector3(x + 2, y, 2), 12, 12, 1 + 2, true);
+			cloth->generateBendingConstraints(2);
+			cloth->m_cfg.piterations = 4;
+			cloth->m_cfg.viterations = 2;
+			cloth->setTotalMass(1);
+			cloth->setUseLinkColoring(useLinkColoring);
+			m_world->addSoftBody(cloth);
+			m_cloths.push_back(cloth);
+		}
+	}
+
+	~ClothTestScene()
+	{
+		for (int i = 0; i < m_cloths.size(); ++i)
+		{
+			m_world->removeSoftBody(m_cloths[i]);
+			delete m_cloths[i];
+		}
+		m_world->removeRigidBody(m_ground);
+		delete m_ground;
+		delete m_world;
+	}
+
+	void step(int numSteps)
+	{
+		for (int i = 0; i < numSteps; ++i)
+		{
+			m_world->stepSimulation(btScalar(1. / 60.), 0);
+		}
+	}
+
+	btScalar maxNodeDistance(const ClothTestScene& other) const
+	{
+		btScalar maxDistance = 0;
+		for (int i = 0; i < m_cloths.size(); ++i)
+		{
+			for (int j = 0; j < m_cloths[i]->m_nodes.size(); ++j)
+			{
+				maxDistance = btMax(maxDistance, m_cloths[i]->m_nodes[j].m_x.distance(other.m_cloths[i]->m_nodes[j].m_x));
+			}
+		}
+		return maxDistance;
+	}
+
+	// the largest stretch or compression of a link, relative to its rest length
+	btScalar maxLinkStretch() const
+	{
+		btScalar maxStretch = 0;
+		for (int i = 0; i < m_cloths.size(); ++i)
+		{
+			const btSoftBody::tLinkArray& links = m_cloths[i]->m_links;
+			for (int j = 0; j < links.size(); ++j)
+			{
+				btScalar length = links[j].m_n[0]->m_x.distance(links[j].m_n[1]->m_x);
+				maxStretch = btMax(maxStretch, btFabs(length - links[j].m_rl) / links[j].m_rl);
+			}
+		}
+		return maxStretch;
+	}
+};
+
+// every link in exactly one color, and no two links of a color on the same node
+void expectValidColoring(const btSoftBody* cloth)
+{
+	const int numLinks = cloth->m_links.size();
+	const btAlignedObjectArray<int>& offsets = cloth->m_linkColorOffsets;
+	const btAlignedObjectArray<int>& order = cloth->m_linkColorOrder;
+	ASSERT_GE(offsets.size(), 2);
+	ASSERT_EQ(numLinks, order.size());
+	EXPECT_EQ(0, offsets[0]);
+	EXPECT_EQ(numLinks, offsets[offsets.size() - 1]);
+	btAlignedObjectArray<int> linkColor;
+	linkColor.resize(numLinks, -1);
+	btAlignedObjectArray<int> nodeColor;
+	nodeColor.resize(cloth->m_nodes.size(), -1);
+	for (int c = 0; c + 1 < offsets.size(); ++c)
+	{
+		ASSERT_LT(offsets[c], offsets[c + 1]) << "empty color " << c;
+		for (int k = offsets[c]; k < offsets[c + 1]; ++k)
+		{
+			const int link = order[k];
+			ASSERT_TRUE(link >= 0 && link < numLinks);
+			EXPECT_EQ(-1, linkColor[link]) << "link " << link << " in two colors";
+			linkColor[link] = c;
+			for (int e = 0; e < 2; ++e)
+			{
+				const int node = int(cloth->m_links[link].m_n[e] - &cloth->m_nodes[0]);
+				EXPECT_NE(c, nodeColor[node]) << "two links of color " << c << " on node " << node;
+				nodeColor[node] = c;
+			}
+		}
+	}
+}
+
+class SoftBodyLinkColoringTest : public ::testing::Test
+{
+protected:
+	virtual void SetUp()
+	{
+		btSetTaskScheduler(btGetSequentialTaskScheduler());
+	}
+};
+
+class SoftBodyLinkColoringThreadTest : public ThreadTest
+{
+};
+
+}  // namespace
+
+TEST_F(SoftBodyLinkColoringTest, ValidColoring)
+{
+	ClothTestScene scene(1, true);
+	btSoftBody* cloth = scene.m_cloths[0];
+	cloth->updateLinkColoring();
+	expectValidColoring(cloth);
+
+	// the coloring is rebuilt for the new link order
+	cloth->randomizeConstraints();
+	scene.step(1);
+	expectValidColoring(cloth);
+}
+
+// the colored Gauss-Seidel sweep updates the links in another order, so it only converges to nearly the same cloth
+TEST_F(SoftBodyLinkColoringTest, ColoredSolveCloseToSequentialSolve)
+{
+	ClothTestScene sequential(3, false);
+	ClothTestScene colored(3, true);
+	sequential.step(60);
+	colored.step(60);
+	// the patches are 4 units wide
+	EXPECT_LT(sequential.maxNodeDistance(colored), btScalar(0.15));
+	EXPECT_LT(colored.maxLinkStretch(), sequential.maxLinkStretch() + btScalar(0.05));
+}
+
+// the colors are split across the workers, the result does not depend on the threads
+TEST_F(SoftBodyLinkColoringThreadTest, SameResultForAnyThreadCount)
+{
+	btSetTaskScheduler(btGetSequentialTaskScheduler());
+	ClothTestScene single(3, true);
+	single.step(30);
+	btSetTaskScheduler(m_scheduler);
+	ClothTestScene multi(3, true);
+	multi.step(30);
+	EXPECT_EQ(btScalar(0), single.maxNodeDistance(multi));
+}
+
+int main(int argc, char** argv)
+{
+	::testing::InitGoogleTest(&argc, argv);
+	return RUN_ALL_TESTS();
+}
@@ -0,0 +1,188 @@
+/*
+Bullet Continuous Collision Detection and Physics Library
+Copyright (c) 2003-2018 Erwin Coumans  https://bulletphysics.org
+
+This software is provided 'as-is', without any express or implied warranty.
+In no event will the authors be held liable for any damages arising from the use of this software.
+Permission is granted to anyone to use this software for any purpose,
+including commercial applications, and to alter it and redistribute it freely,
+subject to the following restrictions:
+
+1. The origin of this software must not be misrepresented; you must not claim that you wrote the original software. If you use this software in a product, an acknowledgment in the product documentation would be appreciated but is not required.
+2. Altered source versions must be plainly marked as such, and must not be misrepresented as being the original software.
+3. This notice may not be removed or altered from any source distribution.
+*/
+
+#include <BulletCollision/CollisionShapes/btBoxShape.h>
+#include <BulletCollision/CollisionShapes/btCapsuleShape.h>
+#include <BulletSoftBody/btSparseSDF.h>
+#include <LinearMath/btThreads.h>
+#include <gtest/gtest.h>
+
+#include "ThreadTest.h"
+
+namespace
+{
+typedef btSparseSdf<3> SparseSdf;
+
+struct SdfResult
+{
+	btScalar m_distance;
+	btVector3 m_normal;
+};
+
+// the queries on a grid around a box and a capsule, and their results from a field large enough to never evict
+struct SdfTestQueries
+{
+	btBoxShape m_box;
+	btCapsuleShape m_capsule;
+	btAlignedObjectArray<btVector3> m_points;
+	btAlignedObjectArray<const btCollisionShape*> m_shapes;
+	btAlignedObjectArray<SdfResult> m_expected;
+
+	SdfTestQueries();
+};
+
+// runs the queries several times over, query i * 7919 for index i so that every range of indices reaches all over the
+// grid, and ranges evaluated at the same time query the same cells
+struct EvaluateLoop : public btIParallelForBody
+{
+	SparseSdf* m_sdf;
+	const SdfTestQueries* m_queries;
+	btAlignedObjectArray<SdfResult>* m_results;
+
+	static int queryIndex(int i, int numQueries) { return int((long long)i * 7919 % numQueries); }
+
+	virtual void forLoop(int iBegin, int iEnd) const BT_OVERRIDE
+	{
+		for (int i = iBegin; i < iEnd; ++i)
+		{
+			const int q = queryIndex(i, m_queries->m_points.size());
+			SdfResult& result = (*m_results)[i];
+			result.m_distance = m_sdf->Evaluate(m_queries->m_points[q], m_queries->m_shapes[q], result.m_normal, btScalar(0.05));
+		}
+	}
+};
+
+SdfTestQueries::SdfTestQueries()
+	: m_box(btVector3(1, btScalar(0.5), btScalar(0.75))),
+	  m_capsule(btScalar(0.5), 1)
+{
+	const int n = 10;
+	for (int s = 0; s < 2; ++s)
+	{
+		for (int i = 0; i < n; ++i)
+		{
+			for (int j = 0; j < n; ++j)
+			{
+				for (int k = 0; k < n; ++k)
+				{
+					m_points.push_back(btVector3(btScalar(-2 + 4. * i / n), btScalar(-2 + 4. * j / n), btScalar(-2 + 4. * k / n)));
+					m_shapes.push_back(s ? static_cast<const btCollisionShape*>(&m_capsule) : &m_box);
+				}
+			}
+		}
+	}
+	SparseSdf sdf;
+	sdf.Initialize();
+	m_expected.resize(m_points.size());
+	for (int q = 0; q < m_points.size(); ++q)
+	{
+		m_expected[q].m_distance = sdf.Evaluate(m_points[q], m_shapes[q], m_expected[q].m_normal, btScalar(0.05));
+	}
+}
+
+// runs every query 'numPasses' times, with btParallelFor if 'parallel' and otherwise on the calling thread
+void evaluate(SparseSdf& sdf, const SdfTestQueries& queries, int numPasses, bool parallel, btAlignedObjectArray<SdfResult>& results)
+{
+	EvaluateLoop loop;
+	loop.m_sdf = &sdf;
+	loop.m_queries = &queries;
+	loop.m_results = &results;
+	results.resize(queries.m_points.size() * numPasses);
+	if (parallel)
+	{
+		btParallelFor(0, results.size(), 16, loop);
+	}
+	else
+	{
+		loop.forLoop(0, results.size());
+	}
+}
+
+void expectSameResults(const SdfTestQueries& queries, const btAlignedObjectArray<SdfResult>& results)
+{
+	for (int i = 0; i < results.size(); ++i)
+	{
+		const SdfResult& expected = queries.m_expected[EvaluateLoop::queryIndex(i, queries.m_points.size())];
+		ASSERT_EQ(expected.m_distance, results[i].m_distance) << "index " << i;
+		ASSERT_EQ(expected.m_normal, results[i].m_normal) << "index " << i;
+	}
+}
+
+// the cells never take more than the budget, and the slabs at most one partly used slab per shard more
+void expectWithinBudget(SparseSdf& sdf)
+{
+	const SparseSdf::Statistics stats = sdf.getStatistics();
+	EXPECT_LE(stats.m_numCells * sizeof(SparseSdf::Cell), sdf.getMemoryBudget());
+	EXPECT_LE(stats.m_numBytes, sdf.getMemoryBudget() + SparseSdf::kNumShards * SparseSdf::kCellsPerSlab * sizeof(SparseSdf::Cell));
+	EXPECT_GT(stats.m_numEvictions, 0u);
+}
+
+class SparseSdfTest : public ::testing::Test
+{
+protected:
+	SdfTestQueries m_queries;
+};
+
+class SparseSdfThreadTest : public ThreadTest
+{
+protected:
+	SdfTestQueries m_queries;
+};
+
+}  // namespace
+
+TEST_F(SparseSdfTest, SmallBudgetEvictsAndKeepsResults)
+{
+	SparseSdf sdf;
+	sdf.Initialize();
+	sdf.setMemoryBudget(64 * sizeof(SparseSdf::Cell));
+	btAlignedObjectArray<SdfResult> results;
+	evaluate(sdf, m_queries, 3, false, results);
+	expectSameResults(m_queries, results);
+	expectWithinBudget(sdf);
+}
+
+TEST_F(SparseSdfTest, ShrinkingTheBudgetKeepsResults)
+{
+	SparseSdf sdf;
+	sdf.Initialize();
+	btAlignedObjectArray<SdfResult> results;
+	evaluate(sdf, m_queries, 1, false, results);
+	EXPECT_EQ(0u, sdf.getStatistics().m_numEvictions);
+	sdf.setMemoryBudget(32 * sizeof(SparseSdf::Cell));
+	evaluate(sdf, m_queries, 2, false, results);
+	expectSameResults(m_queries, results);
+	expectWithinBudget(sdf);
+}
+
+TEST_F(SparseSdfThreadTest, ConcurrentEvaluateMatchesSingleThread)
+{
+	setNumThreads(8);
+	SparseSdf sdf;
+	sdf.Initialize();
+	sdf.setMemoryBudget(64 * sizeof(SparseSdf::Cell));
+	btAlignedObjectArray<SdfResult> results;
+	evaluate(sdf, m_queries, 4, true, results);
+	expectSameResults(m_queries, results);
+	expectWithinBudget(sdf);
+	const SparseSdf::Statistics stats = sdf.getStatistics();
+	EXPECT_EQ((unsigned long long)results.size(), stats.m_numQueries);
+}
+
+int main(int argc, char** argv)
+{
+	::testing::InitGoogleTest(&argc, argv);
+	return RUN_ALL_TESTS();
+}
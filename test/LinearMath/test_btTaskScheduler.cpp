@@ -0,0 +1,225 @@
+/*
+Bullet Continuous Collision Detection and Physics Library
+Copyright (c) 2003-2018 Erwin Coumans  https://bulletphysics.org
+
+This software is provided 'as-is', without any express or implied warranty.
+In no event will the authors be held liable for any damages arising from the use of this software.
+Permission is granted to anyone to use this software for any purpose,
+including commercial applications, and to alter it and redistribute it freely,
+subject to the following restrictions:
+
+1. The origin of this software must not be misrepresented; you must not claim that you wrote the original software. If you use this software in a product, an acknowledgment in the product documentation would be appreciated but is not required.
+2. Altered source versions must be plainly marked as such, and must not be misrepresented as being the original software.
+3. This notice may not be removed or altered from any source distribution.
+*/
+
+#include <LinearMath/btAlignedObjectArray.h>
+#include <LinearMath/btThreads.h>
+#include <gtest/gtest.h>
+
+#include "ThreadTest.h"
+
+namespace
+{
+// every 61st iteration does a lot more work than the others, so the ranges have to be stolen to balance the loop
+int unevenValue(int i)
+{
+	int n = (i % 61) == 0 ? 20000 : 10;
+	unsigned int x = unsigned(i) + 1;
+	for (int k = 0; k < n; ++k)
+	{
+		x = x * 1664525u + 1013904223u;
+	}
+	return int(x >> 28);
+}
+
+// the sum of the uneven values over [iBegin, iEnd), small enough to be exact in a float btScalar
+int unevenSum(int iBegin, int iEnd)
+{
+	int sum = 0;
+	for (int i = iBegin; i < iEnd; ++i)
+	{
+		sum += unevenValue(i);
+	}
+	return sum;
+}
+
+struct UnevenForBody : public btIParallelForBody
+{
+	btAlignedObjectArray<int>* m_values;
+	btAlignedObjectArray<int>* m_visits;
+
+	virtual void forLoop(int iBegin, int iEnd) const BT_OVERRIDE
+	{
+		for (int i = iBegin; i < iEnd; ++i)
+		{
+			(*m_values)[i] = unevenValue(i);
+			(*m_visits)[i]++;
+		}
+	}
+};
+
+struct UnevenSumBody : public btIParallelSumBody
+{
+	virtual btScalar sumLoop(int iBegin, int iEnd) const BT_OVERRIDE
+	{
+		return btScalar(unevenSum(iBegin, iEnd));
+	}
+};
+
+// each row runs a parallelSum over its own number of columns from inside the outer parallelFor
+struct NestedRowBody : public btIParallelForBody
+{
+	btAlignedObjectArray<int>* m_rowSums;
+
+	static int numColumns(int row) { return 50 + (row * 37) % 700; }
+
+	virtual void forLoop(int iBegin, int iEnd) const BT_OVERRIDE
+	{
+		for (int row = iBegin; row < iEnd; ++row)
+		{
+			UnevenSumBody columns;
+			(*m_rowSums)[row] = int(btParallelSum(row * 1000, row * 1000 + numColumns(row), 8, columns));
+		}
+	}
+};
+
+// each range of the outer parallelSum fills its values with a nested parallelFor and adds them up
+struct NestedSumBody : public btIParallelSumBody
+{
+	btAlignedObjectArray<int>* m_values;
+	btAlignedObjectArray<int>* m_visits;
+
+	virtual btScalar sumLoop(int iBegin, int iEnd) const BT_OVERRIDE
+	{
+		UnevenForBody inner;
+		inner.m_values = m_values;
+		inner.m_visits = m_visits;
+		btParallelFor(iBegin, iEnd, 4, inner);
+		int sum = 0;
+		for (int i = iBegin; i < iEnd; ++i)
+		{
+			sum += (*m_values)[i];
+		}
+		return btScalar(sum);
+	}
+};
+
+struct DefaultTaskScheduler
+{
+	static btITaskScheduler* create() { return btCreateDefaultTaskScheduler(); }
+};
+
+struct WorkStealingTaskScheduler
+{
+	static btITaskScheduler* create() { return btCreateWorkStealingTaskScheduler(); }
+};
+
+///The same loops on each task scheduler
+template <class Scheduler>
+class TaskSchedulerThreadTest : public ThreadTest
+{
+protected:
+	virtual btITaskScheduler* createTaskScheduler()
+	{
+		return Scheduler::create();
+	}
+
+	// every value written exactly once
+	void checkUnevenFor(int n, int grainSize)
+	{
+		btAlignedObjectArray<int> values;
+		btAlignedObjectArray<int> visits;
+		values.resize(n, -1);
+		visits.resize(n, 0);
+		UnevenForBody body;
+		body.m_values = &values;
+		body.m_visits = &visits;
+		btParallelFor(0, n, grainSize, body);
+		for (int i = 0; i < n; ++i)
+		{
+			ASSERT_EQ(1, visits[i]) << "iteration " << i;
+			ASSERT_EQ(unevenValue(i), values[i]) << "iteration " << i;
+		}
+	}
+
+	void checkUnevenSum(int n, int grainSize)
+	{
+		UnevenSumBody body;
+		EXPECT_EQ(unevenSum(0, n), int(btParallelSum(0, n, grainSize, body)));
+	}
+};
+
+typedef ::testing::Types<DefaultTaskScheduler, WorkStealingTaskScheduler> TaskSchedulers;
+TYPED_TEST_CASE(TaskSchedulerThreadTest, TaskSchedulers);
+
+}  // namespace
+
+TYPED_TEST(TaskSchedulerThreadTest, UnevenParallelFor)
+{
+	this->setNumThreads(8);
+	this->checkUnevenFor(5000, 1);
+	this->checkUnevenFor(5000, 64);
+	this->checkUnevenFor(7, 1);
+	this->checkUnevenFor(0, 1);
+}
+
+TYPED_TEST(TaskSchedulerThreadTest, UnevenParallelSum)
+{
+	this->setNumThreads(8);
+	this->checkUnevenSum(5000, 1);
+	this->checkUnevenSum(5000, 64);
+	this->checkUnevenSum(7, 1);
+	this->checkUnevenSum(0, 1);
+}
+
+TYPED_TEST(TaskSchedulerThreadTest, NestedLoops)
+{
+	this->setNumThreads(8);
+	btAlignedObjectArray<int> rowSums;
+	rowSums.resize(64, -1);
+	NestedRowBody rows;
+	rows.m_rowSums = &rowSums;
+	btParallelFor(0, rowSums.size(), 1, rows);
+	for (int row = 0; row < rowSums.size(); ++row)
+	{
+		EXPECT_EQ(unevenSum(row * 1000, row * 1000 + NestedRowBody::numColumns(row)), rowSums[row]) << "row " << row;
+	}
+
+	btAlignedObjectArray<int> values;
+	btAlignedObjectArray<int> visits;
+	values.resize(3000, -1);
+	visits.resize(3000, 0);
+	NestedSumBody sums;
+	sums.m_values = &values;
+	sums.m_visits = &visits;
+	EXPECT_EQ(unevenSum(0, values.size()), int(btParallelSum(0, values.size(), 50, sums)));
+	for (int i = 0; i < visits.size(); ++i)
+	{
+		ASSERT_EQ(1, visits[i]) << "iteration " << i;
+	}
+}
+
+// the thread count changes between loops while the workers of the previous loop are still spinning
+TYPED_TEST(TaskSchedulerThreadTest, SetNumThreadsWhileRunning)
+{
+	this->m_scheduler->setWorkerSpinTime(1000, 1000);
+	int threadCounts[] = {8, 2, 5, 1, 3, 8, 4};
+	for (int round = 0; round < 200; ++round)
+	{
+		this->setNumThreads(threadCounts[round % 7]);
+		this->checkUnevenFor(300 + round, 1);
+		this->setNumThreads(threadCounts[(round + 3) % 7]);
+		this->checkUnevenSum(300 + round, 1);
+		if (this->HasFatalFailure())
+		{
+			return;
+		}
+	}
+}
+
+int main(int argc, char** argv)
+{
+	::testing::InitGoogleTest(&argc, argv);
+	return RUN_ALL_TESTS();
+}
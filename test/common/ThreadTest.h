@@ -0,0 +1,59 @@
+/*
+Bullet Continuous Collision Detection and Physics Library
+Copyright (c) 2003-2018 Erwin Coumans  https://bulletphysics.org
+
+This software is provided 'as-is', without any express or implied warranty.
+In no event will the authors be held liable for any damages arising from the use of this software.
+Permission is granted to anyone to use this software for any purpose,
+including commercial applications, and to alter it and redistribute it freely,
+subject to the following restrictions:
+
+1. The origin of this software must not be misrepresented; you must not claim that you wrote the original software. If you use this software in a product, an acknowledgment in the product documentation would be appreciated but is not required.
+2. Altered source versions must be plainly marked as such, and must not be misrepresented as being the original software.
+3. This notice may not be removed or altered from any source distribution.
+*/
+
+#ifndef THREAD_TEST_H
+#define THREAD_TEST_H
+
+#include <LinearMath/btThreads.h>
+#include <LinearMath/btMinMax.h>
+#include <gtest/gtest.h>
+
+///Base fixture of the tests on several threads. They fail without a task scheduler, so the fixtures deriving from it
+///are named *ThreadTest and ADD_THREAD_TEST in test/CMakeLists.txt leaves them out of builds without BULLET2_MULTITHREADING.
+///SetUp makes m_scheduler the current task scheduler, TearDown puts the sequential one back.
+class ThreadTest : public ::testing::Test
+{
+protected:
+	btITaskScheduler* m_scheduler;
+
+	ThreadTest() : m_scheduler(0) {}
+
+	// override to test another task scheduler, returns null when it is not available in this build
+	virtual btITaskScheduler* createTaskScheduler()
+	{
+		return btCreateDefaultTaskScheduler();
+	}
+
+	virtual void SetUp()
+	{
+		m_scheduler = createTaskScheduler();
+		ASSERT_TRUE(m_scheduler != NULL) << "needs a BT_THREADSAFE build with a task scheduler";
+		btSetTaskScheduler(m_scheduler);
+	}
+	virtual void TearDown()
+	{
+		btSetTaskScheduler(btGetSequentialTaskScheduler());
+		delete m_scheduler;
+		m_scheduler = 0;
+	}
+
+	// clamped to the threads of the machine
+	void setNumThreads(int numThreads)
+	{
+		m_scheduler->setNumThreads(btMin(numThreads, m_scheduler->getMaxNumThreads()));
+	}
+};
+
+#endif  //THREAD_TEST_H